@@ -24,6 +24,19 @@ public:
 		std::array<double, N> wi;
 	};
 
+	/**
+	*	@brief	Quadrature sample directions, unit vectors stored as structure-of-arrays, and their weights.
+	*/
+	struct quadrature_directions {
+		static constexpr int count = 2 * N * N;
+
+		std::array<double, count> x, y, z;
+		std::array<double, count> w;
+	};
+
+	// Batch size used by integrate_batched()
+	static constexpr int batch_size = 64;
+
 public:
 	/**
 	*	@brief	Evaluate definite spherical integral.
@@ -63,6 +76,54 @@ public:
 		return integrate(f, generate_points());
 	}
 
+	/**
+	*	@brief	Evaluate definite spherical integral, evaluating the integrand in batches of up to batch_size directions.
+	*
+	* 	@param f	Batched function to integrate, f(int first, int count, T *out) writes the integrand for directions
+	*				first to first+count-1 of d to out.
+	* 	@param d	Precomputed quadrature directions, see generate_directions()
+	*/
+	template <typename T, typename F>
+	static T integrate_batched(const F &f, const quadrature_directions &d) {
+		T result = T(0);
+		T out[batch_size];
+
+		for (int first = 0; first < quadrature_directions::count; first += batch_size) {
+			const int count = glm::min(batch_size, quadrature_directions::count - first);
+			f(first, count, out);
+
+			for (int j = 0; j < count; ++j)
+				result += d.w[first + j] * out[j];
+		}
+
+		return result;
+	}
+
+	/**
+	*	@brief	Generates the sample directions and weights matching integrate().
+	*/
+	static quadrature_directions generate_directions(const quadrature_points &p) {
+		quadrature_directions d;
+
+		double t = glm::pi<double>() / static_cast<double>(N);
+
+		int idx = 0;
+		for (int j = 0; j < 2 * N; ++j) {
+			double phi = t * (static_cast<double>(j) + .5);
+			for (int i = 0; i < N; ++i, ++idx) {
+				double theta = glm::acos(p.xi[i]);
+				double sin_theta = glm::sin(theta);
+
+				d.x[idx] = sin_theta * glm::cos(phi);
+				d.y[idx] = sin_theta * glm::sin(phi);
+				d.z[idx] = glm::cos(theta);
+				d.w[idx] = t * p.wi[i];
+			}
+		}
+
+		return d;
+	}
+
 	static quadrature_points generate_points() {
 		quadrature_points q;
 
@@ -5,19 +5,67 @@
 
 #include "scatter.hpp"
 
+#include <string>
 
-int main() {
+template <typename Config>
+bool precompute(const std::string &output_path, const std::string &checkpoint_path) {
 	auto atmosphere = StE::Graphics::atmospherics_earth_properties({ 0,-6.371e+6,0 });
 
-	StE::Graphics::atmospherics_precompute_scattering aps(atmosphere);
+	StE::Graphics::atmospherics_precompute_scattering<Config> aps(atmosphere, checkpoint_path);
 
 //	aps.load("atmospherics_scatter_lut.bin");
 
-	aps.build_optical_length_lut();
-	aps.build_scatter_lut(9);
+	std::cout << "Precomputing " << Config::name << " LUT." << std::endl;
+
+	// Resume from the last completed order, if possible
+	const int completed_order = aps.load_checkpoint(Config::scatter_orders);
+	if (completed_order < 0)
+		aps.build_optical_length_lut();
+	if (completed_order < Config::scatter_orders)
+		aps.build_scatter_lut(glm::max(1, completed_order + 1), Config::scatter_orders);
 	aps.build_ambient_lut();
 
-	aps.write_out("atmospherics_scatter_lut.bin");
+	if (!aps.write_out(output_path)) {
+		std::cout << "Failed writing " << output_path << ", keeping checkpoint." << std::endl;
+		return false;
+	}
+
+	// The LUT is complete, a stale checkpoint would only be resumed into a finished run
+	aps.remove_checkpoint();
+
+	return true;
+}
+
+/*
+*	Usage: Fitting [--quick] [--no-checkpoint]
+*
+*	--quick				Reduced resolution and scattering orders, for validation runs. Writes atmospherics_scatter_lut.quick.bin.
+*	--no-checkpoint		Neither resumes from nor writes checkpoints.
+*/
+int main(int argc, char *argv[]) {
+	bool quick = false;
+	bool checkpoints = true;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--quick")
+			quick = true;
+		else if (arg == "--no-checkpoint")
+			checkpoints = false;
+		else {
+			std::cout << "Unknown argument " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	bool written;
+	if (quick) {
+		written = precompute<StE::Graphics::atmospherics_precompute_scattering_quick_config>("atmospherics_scatter_lut.quick.bin",
+																							checkpoints ? "atmospherics_scatter_lut.quick.ckpt" : "");
+	}
+	else {
+		written = precompute<StE::Graphics::atmospherics_precompute_scattering_full_config>("atmospherics_scatter_lut.bin",
+																						   checkpoints ? "atmospherics_scatter_lut.ckpt" : "");
+	}
 
-	return 0;
+	return written ? 0 : 1;
 }
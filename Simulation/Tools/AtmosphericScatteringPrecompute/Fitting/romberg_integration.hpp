@@ -4,6 +4,7 @@
 #pragma once
 
 #include <array>
+#include <vector>
 
 #include "function_traits.hpp"
 
@@ -72,6 +73,61 @@ public:
 		return Tk[N - 1];
 	}
 
+	/**
+	*	@brief	Evaluate definite integral, evaluating the integrand in batches.
+	*			Each refinement level's abscissae are handed to the integrand at once, allowing the integrand to be
+	*			written as a vectorizable loop.
+	*
+	* 	@param f	Batched function to integrate, f(const double *x, T *out, std::size_t count) writes f(x[i]) to out[i].
+	* 	@param a	Interval start
+	* 	@param b	Interval end
+	*/
+	template <typename T, typename F>
+	static T integrate_batched(const F &f, double a, double b) {
+		if (a >= b)
+			return T(0);
+
+		// Largest level evaluates 2^(N-2) new abscissae, and at least the 2 interval ends are evaluated
+		static constexpr std::size_t max_batch = N > 2 ? static_cast<std::size_t>(1) << (N - 2) : 2;
+		thread_local std::vector<double> x(max_batch);
+		thread_local std::vector<T> y(max_batch);
+
+		T t;
+		std::array<T, N> Tk;
+		Tk.fill(T(0));
+
+		x[0] = a;
+		x[1] = b;
+		f(x.data(), y.data(), 2);
+		Tk[0] = .5 * (b - a) * (y[0] + y[1]);
+
+		for (std::uint64_t n = 1; n < N; ++n) {
+			std::uint64_t k = static_cast<std::uint64_t>(1) << n;
+			double h = (b - a) / static_cast<double>(k);
+
+			// Partial sum of trapezoids, see trapezoid()
+			const auto count = static_cast<std::size_t>(k >> 1);
+			for (std::size_t i = 0; i < count; ++i)
+				x[i] = a + static_cast<double>(2 * i + 1) * h;
+			f(x.data(), y.data(), count);
+
+			T sum = T(0);
+			for (std::size_t i = 0; i < count; ++i)
+				sum += y[i];
+			t = .5 * Tk[0] + h * sum;
+
+			for (std::uint64_t m = 1; m <= n; ++m) {
+				T s = t + (t - Tk[m - 1]) / static_cast<double>((1 << 2 * m) - 1);
+				Tk[m - 1] = t;
+				t = s;
+			}
+
+			Tk[n] = t;
+		}
+
+		return Tk[N - 1];
+	}
+
 	/**
 	*	@brief	Evaluate definite unit sphere integral using O(2^(2N+1)) samples.
 	*
@@ -9,11 +9,16 @@
 
 #include "romberg_integration.hpp"
 #include "gaussian_quadrature_spherical_integration.hpp"
+#include "tiled_work_queue.hpp"
 
 #include <boost/crc.hpp>
 
 #include <limits>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <array>
 
 #include <future>
 #include <memory>
@@ -156,11 +161,10 @@ double_vec3<T> operator/(const T &lhs, const double_vec3<T> &rhs) {
 }
 
 
-namespace _detail {
-
-template<typename T>
-class _atmospherics_precompute_scattering_data {
-public:
+/**
+*	@brief	LUT resolutions and quadrature parameters of the production LUT
+*/
+struct atmospherics_precompute_scattering_full_config {
 	static constexpr int optical_length_size = 2048;
 	static constexpr int scatter_size0 = 48;
 	static constexpr int scatter_size1 = 384;
@@ -169,6 +173,51 @@ public:
 	static constexpr int ambient_size_1 = 384;
 	static constexpr int ambient_size_2 = 48;
 
+	// Romberg iterations used for the optical length and scatter integrals
+	static constexpr int optical_length_romberg_iterations = 14;
+	static constexpr int scatter_romberg_iterations = 7;
+	// Gaussian quadrature order of the spherical gather integrals
+	static constexpr int gather_quadrature_order = 24;
+
+	static constexpr int scatter_orders = 9;
+
+	static constexpr auto name = "full";
+};
+
+/**
+*	@brief	Reduced resolution LUT, for quick validation runs. Output is not meant for production use.
+*/
+struct atmospherics_precompute_scattering_quick_config {
+	static constexpr int optical_length_size = 256;
+	static constexpr int scatter_size0 = 8;
+	static constexpr int scatter_size1 = 32;
+	static constexpr int scatter_size2 = 32;
+	static constexpr int ambient_size_0 = 8;
+	static constexpr int ambient_size_1 = 32;
+	static constexpr int ambient_size_2 = 8;
+
+	static constexpr int optical_length_romberg_iterations = 10;
+	static constexpr int scatter_romberg_iterations = 5;
+	static constexpr int gather_quadrature_order = 12;
+
+	static constexpr int scatter_orders = 3;
+
+	static constexpr auto name = "quick";
+};
+
+namespace _detail {
+
+template<typename T, typename Config>
+class _atmospherics_precompute_scattering_data {
+public:
+	static constexpr int optical_length_size = Config::optical_length_size;
+	static constexpr int scatter_size0 = Config::scatter_size0;
+	static constexpr int scatter_size1 = Config::scatter_size1;
+	static constexpr int scatter_size2 = Config::scatter_size2;
+	static constexpr int ambient_size_0 = Config::ambient_size_0;
+	static constexpr int ambient_size_1 = Config::ambient_size_1;
+	static constexpr int ambient_size_2 = Config::ambient_size_2;
+
 	using optical_length_element = T;
 	using scatter_element = double_vec3<T>;
 	using ambient_element = glm::tvec3<T>;
@@ -325,7 +374,7 @@ public:
 			std::cout << "Warning! Hash mismatch!" << std::endl;
 	}
 
-	void write_out(const std::string &path) const {
+	bool write_out(const std::string &path) const {
 		memcpy(this->type, "ATMS SCT", 8);
 
 		boost::crc_32_type crc_computer;
@@ -335,32 +384,60 @@ public:
 		std::ofstream ofs(path, std::ios::binary);
 		ofs.write(reinterpret_cast<const char*>(this), sizeof(*this));
 		ofs.close();
+
+		return !ofs.fail();
 	}
 };
 
 }
 
+template <typename Config = atmospherics_precompute_scattering_full_config>
 class atmospherics_precompute_scattering {
 	using T = double;
-	using lut_t = _detail::_atmospherics_precompute_scattering_data<T>;
+	using lut_t = _detail::_atmospherics_precompute_scattering_data<T, Config>;
+
+	static constexpr int N = Config::scatter_romberg_iterations;
+	static constexpr int M = Config::gather_quadrature_order;
 
-	static constexpr int N = 7;
-	static constexpr int M = 24;
+	using quadrature_t = gaussian_quadrature_spherical_integration<M>;
 
 	struct temp_lut_t {
 		glm::tvec3<T> scatter[lut_t::scatter_size0][lut_t::scatter_size1][lut_t::scatter_size2];
 	};
 
+	struct checkpoint_header {
+		unsigned char type[8];
+		std::uint32_t version;
+		std::uint32_t lut_size;
+		std::uint32_t temp_lut_size;
+		// Last completed scattering order, 0 if only the optical length LUT was built
+		std::uint32_t order;
+		// See config_hash()
+		std::uint32_t config_hash;
+		std::uint32_t hash;
+	};
+	static constexpr std::uint32_t checkpoint_version = 2;
+	// Bump when the integrands change, invalidating checkpoints written by older builds
+	static constexpr std::int32_t integrands_version = 1;
+
 private:
 	atmospherics_properties<T> ap;
 	T Hmax;
 
-	gaussian_quadrature_spherical_integration<M>::quadrature_points quadrature_points;
+	typename quadrature_t::quadrature_points quadrature_points;
+	typename quadrature_t::quadrature_directions quadrature_directions;
+
+	// The gather phase functions depend only on the direction relative to the view vector, and are precomputed per
+	// quadrature direction along with their normalizers.
+	std::array<T, quadrature_t::quadrature_directions::count> gather_phase_r, gather_phase_m;
+	T gather_normalizer_r, gather_normalizer_m;
 
 	std::unique_ptr<lut_t> final_lut;
 	std::unique_ptr<temp_lut_t> last_scatter_lut;
 	std::unique_ptr<temp_lut_t> temp_lut;
 
+	std::string checkpoint_path;
+
 private:
 	static T cie_scattering_indicatrix(const T &x, const T &cos_x) {
 		return 1. + 10. * (exp(-3. * x) - exp(-3. * glm::pi<T>() / 2.)) + 0.45 * cos_x*cos_x;
@@ -369,6 +446,10 @@ private:
 		return cie_scattering_indicatrix(.0, 1.0);
 	}
 
+	static auto seconds_since(std::chrono::high_resolution_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
 	auto sample_last_scatter_value(const glm::dvec3 &idx) const {
 		auto coords = idx * glm::dvec3{ lut_t::scatter_size0 - 1, lut_t::scatter_size1 - 1, lut_t::scatter_size2 - 1 };
 		auto x = glm::floor(coords);
@@ -446,36 +527,33 @@ private:
 	}
 
 
-	template <int Chunks, int i>
-	void build_optical_length_lut(int lut, const T &H) {
-		static_assert(lut_t::optical_length_size % Chunks == 0, "");
-
-		int chunk = lut_t::optical_length_size / Chunks;
-
+	void optical_length(int lut, const glm::ivec2 &idx, const T &H) {
 		auto H_max = ap.max_height(H);
-		for (int x = chunk * i; x<chunk * (i + 1); ++x) {
-			for (int y = 0; y<lut_t::optical_length_size; ++y) {
-				auto h = lut_t::height_for_lut_idx(static_cast<T>(x) / static_cast<T>(lut_t::optical_length_size - 1), H_max);
-				auto phi = lut_t::view_zenith_for_lut_idx(static_cast<T>(y) / static_cast<T>(lut_t::optical_length_size - 1));
-
-				glm::tvec3<T> P0 = ap.center + glm::tvec3<T>{ 0, ap.radius + h, 0 };
-				glm::tvec3<T> V = { glm::sin(phi),glm::cos(phi),0 };
-				auto l0 = intersect_line_sphere(ap.center, ap.radius + H_max, P0 - decltype(P0){0, 0.1, 0}, V);
-				auto l1 = intersect_line_sphere(ap.center, ap.radius, P0 + decltype(P0){0, 0.1, 0}, V);
-				auto l = glm::min(l0, l1);
-
-				auto lambda = [&](double step) {
-					auto P = P0 + step * V;
-					auto hx = glm::length(P - ap.center) - ap.radius;
-					return glm::exp(-hx / H);// this->ap.pressure(hx, H);
-				};
-
-				auto val = romberg_integration<14>::integrate(lambda, 0, l);
-				final_lut->write_optical_length_value(lut, { x,y }, val);
+		auto h = lut_t::height_for_lut_idx(static_cast<T>(idx.x) / static_cast<T>(lut_t::optical_length_size - 1), H_max);
+		auto phi = lut_t::view_zenith_for_lut_idx(static_cast<T>(idx.y) / static_cast<T>(lut_t::optical_length_size - 1));
+
+		glm::tvec3<T> P0 = ap.center + glm::tvec3<T>{ 0, ap.radius + h, 0 };
+		glm::tvec3<T> V = { glm::sin(phi),glm::cos(phi),0 };
+		auto l0 = intersect_line_sphere(ap.center, ap.radius + H_max, P0 - decltype(P0){0, 0.1, 0}, V);
+		auto l1 = intersect_line_sphere(ap.center, ap.radius, P0 + decltype(P0){0, 0.1, 0}, V);
+		auto l = glm::min(l0, l1);
+
+		// Relative to the atmosphere center
+		const auto O = P0 - ap.center;
+		const T radius = ap.radius;
+
+		auto lambda = [&](const double *steps, T *out, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i) {
+				const T px = O.x + steps[i] * V.x;
+				const T py = O.y + steps[i] * V.y;
+				const T pz = O.z + steps[i] * V.z;
+				const T hx = std::sqrt(px*px + py*py + pz*pz) - radius;
+				out[i] = std::exp(-hx / H);// this->ap.pressure(hx, H);
 			}
-			if (x % 32 == 31)
-				std::cout << "x";
-		}
+		};
+
+		auto val = romberg_integration<Config::optical_length_romberg_iterations>::template integrate_batched<T>(lambda, 0, l);
+		final_lut->write_optical_length_value(lut, idx, val);
 	}
 
 
@@ -500,40 +578,38 @@ private:
 		if (glm::abs(glm::dot(Tangent, V)) > .95) Tangent = { 0,1,0 };
 		glm::tvec3<T> U = glm::normalize(glm::cross(Tangent, V));
 		Tangent = glm::normalize(glm::cross(U, V));
-		auto TBN = glm::tmat3x3<T>{ U, V, Tangent };
 
-		auto lambda = [&](double sample_theta, double sample_phi) {
-			T sin_theta = glm::sin(sample_theta);
-			auto omega = TBN * glm::tvec3<T>{ sin_theta * glm::cos(sample_phi), sin_theta * glm::sin(sample_phi), glm::cos(sample_theta) };
-
-			auto cos_phi = glm::dot(Y, omega);
-
-			auto c = -glm::dot(omega, V);
-			auto Fr = rayleigh_phase_function(c);
-			auto Fm = cornette_shanks_phase_function(c, ap.phase + .075);
-
-			auto sample = scatter_sample(k, h, cos_phi, cos_delta, omega, L);
-
-			return double_vec3<T>{ Fr * sample, Fm * sample};
-		};
-		auto normalizer_lambda = [&](double sample_theta, double sample_phi) {
-			T sin_theta = glm::sin(sample_theta);
-			auto omega = TBN * glm::tvec3<T>{ sin_theta * glm::cos(sample_phi), sin_theta * glm::sin(sample_phi), glm::cos(sample_theta) };
+		const auto &d = quadrature_directions;
+		auto lambda = [&](int first, int count, double_vec3<T> *out) {
+			T omega_x[quadrature_t::batch_size];
+			T omega_y[quadrature_t::batch_size];
+			T omega_z[quadrature_t::batch_size];
+			T cos_phi[quadrature_t::batch_size];
+
+			// Sample directions in world space, omega = TBN * d
+			for (int i = 0; i < count; ++i) {
+				const auto j = first + i;
+				omega_x[i] = U.x * d.x[j] + V.x * d.y[j] + Tangent.x * d.z[j];
+				omega_y[i] = U.y * d.x[j] + V.y * d.y[j] + Tangent.y * d.z[j];
+				omega_z[i] = U.z * d.x[j] + V.z * d.y[j] + Tangent.z * d.z[j];
+				cos_phi[i] = Y.x * omega_x[i] + Y.y * omega_y[i] + Y.z * omega_z[i];
+			}
 
-			auto c = -glm::dot(omega, V);
-			auto Fr = rayleigh_phase_function(c);
-			auto Fm = cornette_shanks_phase_function(c, ap.phase + .075);
+			for (int i = 0; i < count; ++i) {
+				const auto j = first + i;
+				const glm::tvec3<T> omega = { omega_x[i], omega_y[i], omega_z[i] };
+				auto sample = scatter_sample(k, h, cos_phi[i], cos_delta, omega, L);
 
-			return glm::tvec2<T>{ Fr, Fm };
+				out[i] = double_vec3<T>{ gather_phase_r[j] * sample, gather_phase_m[j] * sample };
+			}
 		};
 
-		auto result = gaussian_quadrature_spherical_integration<M>::integrate(lambda, quadrature_points);
-		auto normalizer = gaussian_quadrature_spherical_integration<M>::integrate(normalizer_lambda, quadrature_points);
+		auto result = quadrature_t::template integrate_batched<double_vec3<T>>(lambda, quadrature_directions);
 
-		result.v0 /= normalizer.x;
-		result.v1 /= normalizer.y;
+		result.v0 /= gather_normalizer_r;
+		result.v1 /= gather_normalizer_m;
 
-		return double_vec3<T>{ result.v0, result.v1 };
+		return result;
 	}
 
 	auto scatter(int k, const T &h0, const glm::tvec3<T> &V, const glm::tvec3<T> &L) const {
@@ -606,11 +682,14 @@ private:
 		return val;
 	}
 
-	void scatter(int k, const glm::ivec3 &idx,
-				 const T &h, const T &phi, const T &delta) const {
+	void scatter(int k, const glm::ivec3 &idx) const {
 		static_assert(N >= 1, "Expected positive N");
 		_assert(k >= 1);
 
+		auto h = lut_t::height_for_lut_idx(static_cast<T>(idx.x) / static_cast<T>(lut_t::scatter_size0 - 1), Hmax);
+		auto phi = lut_t::view_zenith_for_lut_idx(static_cast<T>(idx.y) / static_cast<T>(lut_t::scatter_size1 - 1));
+		auto delta = lut_t::sun_zenith_for_lut_idx(static_cast<T>(idx.z) / static_cast<T>(lut_t::scatter_size2 - 1));
+
 		glm::tvec3<T> V = { glm::sin(phi),glm::cos(phi),0 };
 		glm::tvec3<T> L = { glm::sin(delta),glm::cos(delta),0 };
 
@@ -622,8 +701,12 @@ private:
 		temp_lut->scatter[idx.x][idx.y][idx.z] = val;
 	}
 
-	void ambient(const glm::ivec3 &idx,
-				 const T &scatter_lut_idx_h, const T &scatter_lut_idx_delta, const T &delta, const T &NdotL) {
+	void ambient(const glm::ivec3 &idx) {
+		auto scatter_lut_idx_h = static_cast<T>(idx.x) / static_cast<T>(lut_t::ambient_size_0 - 1);
+		auto scatter_lut_idx_delta = static_cast<T>(idx.y) / static_cast<T>(lut_t::ambient_size_1 - 1);
+		auto delta = lut_t::sun_zenith_for_lut_idx(scatter_lut_idx_delta);
+		auto NdotL = lut_t::ambient_NdotL_for_lut_idx(static_cast<T>(idx.z) / static_cast<T>(lut_t::ambient_size_2 - 1));
+
 		glm::tvec3<T> L = { glm::sin(delta),glm::cos(delta),0 };
 
 		T angle = delta - glm::acos(NdotL);
@@ -631,32 +714,108 @@ private:
 
 		_assert(glm::abs(glm::dot(N, L) - NdotL) < 1e-15);
 
-		auto lambda = [&](double sample_theta, double sample_phi) {
-			T sin_theta = glm::sin(sample_theta);
-			auto omega = glm::tvec3<T>{ sin_theta * glm::cos(sample_phi), sin_theta * glm::sin(sample_phi), glm::cos(sample_theta) };
+		const auto &d = quadrature_directions;
+		auto lambda = [&](int first, int count, glm::tvec3<T> *out) {
+			T lambertian[quadrature_t::batch_size];
+			T decay[quadrature_t::batch_size];
 
-			auto lambertian = glm::dot(N, omega);
-			if (lambertian <= .0)
-				return glm::tvec3<T>(0);
+			for (int i = 0; i < count; ++i) {
+				const auto j = first + i;
+				lambertian[i] = N.x * d.x[j] + N.y * d.y[j] + N.z * d.z[j];
 
-			auto cos_phi = omega.y;
-			auto scatter_lut_y = lut_t::view_zenith_to_lut_idx(cos_phi);
+				const auto gamma = L.x * d.x[j] + L.y * d.y[j] + L.z * d.z[j];
+				decay[i] = cie_scattering_indicatrix(glm::acos(gamma), gamma) / cie_scattering_indicatrix_normalizer();
+			}
 
-			auto gamma = glm::dot(omega, L);
-			auto decay = cie_scattering_indicatrix(glm::acos(gamma), gamma) / cie_scattering_indicatrix_normalizer();
+			for (int i = 0; i < count; ++i) {
+				const auto j = first + i;
+				if (lambertian[i] <= .0) {
+					out[i] = glm::tvec3<T>(0);
+					continue;
+				}
 
-			auto sample = final_lut->sample_scatter_value({ scatter_lut_idx_h, scatter_lut_y, scatter_lut_idx_delta }, omega, L);
+				const glm::tvec3<T> omega = { d.x[j], d.y[j], d.z[j] };
+				auto scatter_lut_y = lut_t::view_zenith_to_lut_idx(omega.y);
+				auto sample = final_lut->sample_scatter_value({ scatter_lut_idx_h, scatter_lut_y, scatter_lut_idx_delta }, omega, L);
 
-			return lambertian * decay * sample;
+				out[i] = lambertian[i] * decay[i] * sample;
+			}
 		};
 
-		auto result = gaussian_quadrature_spherical_integration<M>::integrate(lambda, quadrature_points);
+		auto result = quadrature_t::template integrate_batched<glm::tvec3<T>>(lambda, quadrature_directions);
 
 		final_lut->write_ambient_value(idx, result);
 	}
 
+	std::uint32_t atmosphere_hash() const {
+		boost::crc_32_type crc_computer;
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(&ap), sizeof(ap));
+		return crc_computer.checksum();
+	}
+
+	/**
+	*	@brief	Identifies the configuration and code that computed the LUT. LUT sizes are validated separately.
+	*/
+	static std::uint32_t config_hash() {
+		const std::int32_t config[] = {
+			integrands_version,
+			Config::optical_length_romberg_iterations,
+			Config::scatter_romberg_iterations,
+			Config::gather_quadrature_order,
+			static_cast<std::int32_t>(sizeof(T)),
+		};
+
+		boost::crc_32_type crc_computer;
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(config), sizeof(config));
+		return crc_computer.checksum();
+	}
+
+	/**
+	*	@brief	Writes the LUT state after a completed scattering order, replacing the previous checkpoint.
+	*/
+	void write_checkpoint(int order) const {
+		if (checkpoint_path.empty())
+			return;
+
+		checkpoint_header header;
+		memcpy(header.type, "ATMS CKP", 8);
+		header.version = checkpoint_version;
+		header.lut_size = static_cast<std::uint32_t>(sizeof(lut_t));
+		header.temp_lut_size = static_cast<std::uint32_t>(sizeof(temp_lut_t));
+		header.order = order;
+		header.config_hash = config_hash();
+
+		boost::crc_32_type crc_computer;
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(final_lut.get()), sizeof(lut_t));
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(last_scatter_lut.get()), sizeof(temp_lut_t));
+		header.hash = crc_computer.checksum() ^ atmosphere_hash();
+
+		// Write to a temporary and replace, so an interrupted write never loses the previous checkpoint
+		const auto temp_path = checkpoint_path + ".tmp";
+		{
+			std::ofstream ofs(temp_path, std::ios::binary);
+			ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			ofs.write(reinterpret_cast<const char*>(final_lut.get()), sizeof(lut_t));
+			ofs.write(reinterpret_cast<const char*>(last_scatter_lut.get()), sizeof(temp_lut_t));
+			if (!ofs) {
+				std::cout << "Warning! Failed writing checkpoint " << temp_path << std::endl;
+				return;
+			}
+		}
+		std::remove(checkpoint_path.c_str());
+		std::rename(temp_path.c_str(), checkpoint_path.c_str());
+
+		std::cout << "Checkpoint written (order " << order << ")" << std::endl;
+	}
+
 public:
-	atmospherics_precompute_scattering(const atmospherics_properties<T> &ap) : ap(ap) {
+	/**
+	*	@param ap				Atmosphere properties
+	*	@param checkpoint_path	Checkpoint file path. Checkpoints are disabled if empty.
+	*/
+	atmospherics_precompute_scattering(const atmospherics_properties<T> &ap, const std::string &checkpoint_path = {})
+		: ap(ap), checkpoint_path(checkpoint_path)
+	{
 		final_lut = std::make_unique<lut_t>(ap);
 		temp_lut = std::make_unique<temp_lut_t>();
 		last_scatter_lut = std::make_unique<temp_lut_t>();
@@ -665,82 +824,103 @@ public:
 		auto Hmax_m = ap.max_height(ap.scale_height_aerosols());
 		Hmax = glm::max(Hmax_r, Hmax_m);
 
-		quadrature_points = gaussian_quadrature_spherical_integration<M>::generate_points();
+		quadrature_points = quadrature_t::generate_points();
+		quadrature_directions = quadrature_t::generate_directions(quadrature_points);
+
+		// In the gather frame the view vector is the y axis, see scatter_gather()
+		gather_normalizer_r = gather_normalizer_m = 0;
+		for (int i = 0; i < quadrature_t::quadrature_directions::count; ++i) {
+			auto c = -quadrature_directions.y[i];
+			gather_phase_r[i] = rayleigh_phase_function(c);
+			gather_phase_m[i] = cornette_shanks_phase_function(c, this->ap.phase + .075);
+
+			gather_normalizer_r += quadrature_directions.w[i] * gather_phase_r[i];
+			gather_normalizer_m += quadrature_directions.w[i] * gather_phase_m[i];
+		}
 	}
 
-	void build_optical_length_lut_air() {
-		auto H = ap.scale_height();
+	/**
+	*	@brief	Resumes from the checkpoint, if a valid checkpoint exists.
+	*
+	*	@param k_end	Requested scattering orders. Checkpoints past k_end are ignored.
+	*	@return	The last completed scattering order, 0 if only the optical length LUT was completed, or -1 if there is no
+	*			usable checkpoint.
+	*/
+	int load_checkpoint(int k_end) {
+		if (checkpoint_path.empty())
+			return -1;
+
+		std::ifstream ifs(checkpoint_path, std::ios::binary);
+		if (!ifs)
+			return -1;
+
+		checkpoint_header header;
+		ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!ifs ||
+			memcmp(header.type, "ATMS CKP", 8) != 0 ||
+			header.version != checkpoint_version ||
+			header.lut_size != sizeof(lut_t) ||
+			header.temp_lut_size != sizeof(temp_lut_t) ||
+			header.config_hash != config_hash() ||
+			static_cast<int>(header.order) > k_end) {
+			std::cout << "Ignoring incompatible checkpoint " << checkpoint_path << std::endl;
+			return -1;
+		}
 
-		auto f0 = std::async([this, H]() { build_optical_length_lut<4, 0>(0, H); });
-		auto f1 = std::async([this, H]() { build_optical_length_lut<4, 1>(0, H); });
-		auto f2 = std::async([this, H]() { build_optical_length_lut<4, 2>(0, H); });
-		auto f3 = std::async([this, H]() { build_optical_length_lut<4, 3>(0, H); });
+		auto lut = std::make_unique<lut_t>(ap);
+		auto last = std::make_unique<temp_lut_t>();
+		ifs.read(reinterpret_cast<char*>(lut.get()), sizeof(lut_t));
+		ifs.read(reinterpret_cast<char*>(last.get()), sizeof(temp_lut_t));
 
-		f0.get();
-		f1.get();
-		f2.get();
-		f3.get();
-	}
-	void build_optical_length_lut_aerosols() {
-		auto H = ap.scale_height_aerosols();
+		boost::crc_32_type crc_computer;
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(lut.get()), sizeof(lut_t));
+		crc_computer.process_bytes(reinterpret_cast<const std::uint8_t*>(last.get()), sizeof(temp_lut_t));
+		if (!ifs || header.hash != (crc_computer.checksum() ^ atmosphere_hash())) {
+			std::cout << "Ignoring corrupt or mismatched checkpoint " << checkpoint_path << std::endl;
+			return -1;
+		}
 
-		auto f0 = std::async([this, H]() { build_optical_length_lut<4, 0>(1, H); });
-		auto f1 = std::async([this, H]() { build_optical_length_lut<4, 1>(1, H); });
-		auto f2 = std::async([this, H]() { build_optical_length_lut<4, 2>(1, H); });
-		auto f3 = std::async([this, H]() { build_optical_length_lut<4, 3>(1, H); });
+		final_lut = std::move(lut);
+		last_scatter_lut = std::move(last);
 
-		f0.get();
-		f1.get();
-		f2.get();
-		f3.get();
+		std::cout << "Resuming from checkpoint " << checkpoint_path << " (order " << header.order << ")" << std::endl;
+
+		return static_cast<int>(header.order);
 	}
+
 	void build_optical_length_lut() {
 		std::cout << "Building Optical Length LUT..." << std::endl;
 
-		build_optical_length_lut_air();
-		build_optical_length_lut_aerosols();
-
-		std::cout << std::endl << "Done" << std::endl;
-	}
-
-	template <int Chunks, int i>
-	void build_scatter_lut_worker(int k) {
-		static_assert(lut_t::scatter_size0 % Chunks == 0, "");
+		const auto start = std::chrono::high_resolution_clock::now();
+		const glm::ivec3 extent = { lut_t::optical_length_size, lut_t::optical_length_size, 1 };
+		const glm::ivec3 tile = { 8, 256, 1 };
 
-		int chunk = lut_t::scatter_size0 / Chunks;
-		for (int x = chunk * i; x<chunk*(i+1); ++x) {
-			for (int y = 0; y<lut_t::scatter_size1; ++y) {
-				for (int z = 0; z<lut_t::scatter_size2; ++z) {
-					auto h = lut_t::height_for_lut_idx(static_cast<T>(x) / static_cast<T>(lut_t::scatter_size0 - 1), Hmax);
-					auto phi = lut_t::view_zenith_for_lut_idx(static_cast<T>(y) / static_cast<T>(lut_t::scatter_size1 - 1));
-					auto delta = lut_t::sun_zenith_for_lut_idx(static_cast<T>(z) / static_cast<T>(lut_t::scatter_size2 - 1));
+		auto H = ap.scale_height();
+		tiled_work_queue::run(extent, tile, [this, H](const glm::ivec3 &idx) { optical_length(0, { idx.x, idx.y }, H); });
+		auto Hm = ap.scale_height_aerosols();
+		tiled_work_queue::run(extent, tile, [this, Hm](const glm::ivec3 &idx) { optical_length(1, { idx.x, idx.y }, Hm); });
 
-					scatter(k, { x,y,z }, h, phi, delta);
-				}
+		std::cout << std::endl << "Done in " << seconds_since(start) << "s" << std::endl;
 
-				if (y % (lut_t::scatter_size1>>2) == (lut_t::scatter_size1>>2) - 1)
-					std::cout << "x";
-			}
-		}
+		write_checkpoint(0);
 	}
 
-	void build_scatter_lut(int k_end) {
-		assert(k_end >= 1);
+	/**
+	*	@brief	Builds scattering orders k_begin to k_end. Orders prior to k_begin are expected to be complete, see
+	*			load_checkpoint().
+	*/
+	void build_scatter_lut(int k_begin, int k_end) {
+		assert(k_begin >= 1 && k_end >= 1);
 
 		std::cout << std::endl << "Building scatter LUT..." << std::endl;
 
-		for (int i=1; i<=k_end; ++i) {
-			auto f0 = std::async([this, i]() { build_scatter_lut_worker<4, 0>(i); });
-			auto f1 = std::async([this, i]() { build_scatter_lut_worker<4, 1>(i); });
-			auto f2 = std::async([this, i]() { build_scatter_lut_worker<4, 2>(i); });
-			auto f3 = std::async([this, i]() { build_scatter_lut_worker<4, 3>(i); });
+		for (int i = k_begin; i <= k_end; ++i) {
+			const auto start = std::chrono::high_resolution_clock::now();
 
-			f0.get();
-			f1.get();
-			f2.get();
-			f3.get();
+			const glm::ivec3 extent = { lut_t::scatter_size0, lut_t::scatter_size1, lut_t::scatter_size2 };
+			tiled_work_queue::run(extent, { 1, 16, 32 }, [this, i](const glm::ivec3 &idx) { scatter(i, idx); });
 
-			std::cout << std::endl << "Scatter index " << i << " done." << std::endl;
+			std::cout << std::endl << "Scatter index " << i << " done in " << seconds_since(start) << "s." << std::endl;
 
 			double_vec3<T> max = { { 0,0,0 },{0,0,0} };
 			T max_len = T(0);
@@ -764,6 +944,9 @@ public:
 
 			std::swap(temp_lut, last_scatter_lut);
 
+			final_lut->set_scatter_index(i);
+			write_checkpoint(i);
+
 			std::cout << std::endl;
 		}
 
@@ -772,51 +955,36 @@ public:
 		std::cout << "Done" << std::endl;
 	}
 
-	template <int Chunks, int i>
-	void build_ambient_lut_worker() {
-		static_assert(lut_t::ambient_size_0 % Chunks == 0, "");
-
-		int chunk = lut_t::ambient_size_0 / Chunks;
-		for (int x = chunk * i; x < chunk*(i + 1); ++x) {
-			for (int y = 0; y < lut_t::ambient_size_1; ++y) {
-				for (int z = 0; z < lut_t::ambient_size_2; ++z) {
-					auto scatter_lut_idx_h = static_cast<T>(x) / static_cast<T>(lut_t::ambient_size_0 - 1);
-					auto scatter_lut_idx_delta = static_cast<T>(y) / static_cast<T>(lut_t::ambient_size_1 - 1);
-					auto delta = lut_t::sun_zenith_for_lut_idx(scatter_lut_idx_delta);
-					auto NdotL = lut_t::ambient_NdotL_for_lut_idx(static_cast<T>(z) / static_cast<T>(lut_t::ambient_size_2 - 1));
-
-					ambient({ x,y,z }, scatter_lut_idx_h, scatter_lut_idx_delta, delta, NdotL);
-				}
-
-				if (y % (lut_t::ambient_size_1) == (lut_t::ambient_size_1) - 1)
-					std::cout << "x";
-			}
-		}
-	}
-
 	void build_ambient_lut() {
 		std::cout << std::endl << "Building ambient LUT..." << std::endl;
 
-		auto f0 = std::async([this]() { build_ambient_lut_worker<4, 0>(); });
-		auto f1 = std::async([this]() { build_ambient_lut_worker<4, 1>(); });
-		auto f2 = std::async([this]() { build_ambient_lut_worker<4, 2>(); });
-		auto f3 = std::async([this]() { build_ambient_lut_worker<4, 3>(); });
-
-		f0.get();
-		f1.get();
-		f2.get();
-		f3.get();
+		const auto start = std::chrono::high_resolution_clock::now();
+		const glm::ivec3 extent = { lut_t::ambient_size_0, lut_t::ambient_size_1, lut_t::ambient_size_2 };
+		tiled_work_queue::run(extent, { 1, 16, lut_t::ambient_size_2 }, [this](const glm::ivec3 &idx) { ambient(idx); });
 
-		std::cout << "Done" << std::endl;
+		std::cout << std::endl << "Done in " << seconds_since(start) << "s" << std::endl;
 	}
 
 	void load(const std::string &path) {
 		final_lut->load(path);
 	}
 
-	void write_out(const std::string &path) const {
+	/**
+	*	@brief	Writes the final LUT.
+	*
+	*	@return	False if the LUT couldn't be written.
+	*/
+	bool write_out(const std::string &path) const {
 		std::cout << "Writing final LUT..." << std::endl;
-		final_lut->write_out(path);
+		return final_lut->write_out(path);
+	}
+
+	/**
+	*	@brief	Deletes the checkpoint, once the final LUT was written and it is no longer needed.
+	*/
+	void remove_checkpoint() const {
+		if (!checkpoint_path.empty())
+			std::remove(checkpoint_path.c_str());
 	}
 };
 
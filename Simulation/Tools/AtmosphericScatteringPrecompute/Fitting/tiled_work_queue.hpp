@@ -0,0 +1,70 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "stdafx.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace StE {
+
+/**
+*	@brief	Splits a 3D domain into tiles and processes the tiles on all hardware threads.
+*	Workers pull tiles off a shared counter, so tiles of uneven cost do not leave threads idle.
+*/
+class tiled_work_queue {
+public:
+	/**
+	*	@brief	Invokes f(const glm::ivec3 &idx) for every index in [0, extent). Blocks until done.
+	*	Prints a progress mark for every 1/32 of the tiles completed. Exceptions thrown by f are rethrown.
+	*
+	* 	@param extent	Domain size
+	* 	@param tile		Tile size
+	* 	@param f		Function to invoke
+	*/
+	template <typename F>
+	static void run(const glm::ivec3 &extent, glm::ivec3 tile, const F &f) {
+		tile = glm::clamp(tile, glm::ivec3(1), extent);
+		const auto tiles = (extent + tile - glm::ivec3(1)) / tile;
+		const int tiles_count = tiles.x * tiles.y * tiles.z;
+
+		std::atomic<int> next_tile{ 0 };
+		std::atomic<int> tiles_done{ 0 };
+		std::mutex progress_mutex;
+
+		auto worker = [&]() {
+			for (int t; (t = next_tile.fetch_add(1)) < tiles_count;) {
+				const glm::ivec3 tile_idx = { t % tiles.x, (t / tiles.x) % tiles.y, t / (tiles.x * tiles.y) };
+				const auto start = tile_idx * tile;
+				const auto end = glm::min(start + tile, extent);
+
+				for (int x = start.x; x < end.x; ++x)
+					for (int y = start.y; y < end.y; ++y)
+						for (int z = start.z; z < end.z; ++z)
+							f(glm::ivec3{ x, y, z });
+
+				// Progress
+				const int done = tiles_done.fetch_add(1) + 1;
+				if (done * 32 / tiles_count != (done - 1) * 32 / tiles_count) {
+					std::unique_lock<std::mutex> l(progress_mutex);
+					std::cout << "x" << std::flush;
+				}
+			}
+		};
+
+		const int workers_count = glm::max(1, glm::min(static_cast<int>(std::thread::hardware_concurrency()), tiles_count));
+		std::vector<std::future<void>> workers;
+		for (int i = 0; i < workers_count; ++i)
+			workers.push_back(std::async(std::launch::async, worker));
+		for (auto &w : workers)
+			w.get();
+	}
+};
+
+}
@@ -0,0 +1,108 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include <ostream>
+
+namespace StE {
+
+/**
+*	@brief	Collects the fit time and error of fitted table cells, and reports summary statistics.
+*	Recording is thread-safe.
+*/
+class fit_statistics {
+	using clock = std::chrono::high_resolution_clock;
+
+	struct cell_record {
+		int row, col;
+		double error;
+		double seconds;
+	};
+
+private:
+	mutable std::mutex m;
+	std::vector<cell_record> cells;
+	clock::time_point start{ clock::now() };
+
+public:
+	/**
+	*	@brief	Records a fitted cell
+	*
+	* 	@param row		Cell row
+	* 	@param col		Cell column
+	* 	@param error	Fit error, as reported by the solver
+	* 	@param elapsed	Time spent fitting the cell
+	*/
+	void record(int row, int col, double error, clock::duration elapsed) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+
+		std::unique_lock<std::mutex> l(m);
+		cells.push_back({ row, col, error, seconds });
+	}
+
+	/**
+	*	@brief	Prints fit time and error statistics.
+	*
+	* 	@param os				Output stream
+	* 	@param bad_fit_error	Fits with an error above this threshold are listed as bad fits
+	*/
+	void report(std::ostream &os, double bad_fit_error = std::numeric_limits<double>::infinity()) const {
+		std::unique_lock<std::mutex> l(m);
+
+		const double wall_time = std::chrono::duration<double>(clock::now() - start).count();
+		if (cells.empty()) {
+			os << "No cells fitted (" << wall_time << "s)" << std::endl;
+			return;
+		}
+
+		double fit_time = .0, max_fit_time = .0;
+		double error_sum = .0, error_squared_sum = .0;
+		int bad_fits = 0;
+		const cell_record *worst = &cells.front();
+		std::vector<double> errors;
+		errors.reserve(cells.size());
+		for (auto &c : cells) {
+			fit_time += c.seconds;
+			max_fit_time = std::max(max_fit_time, c.seconds);
+
+			error_sum += c.error;
+			error_squared_sum += c.error * c.error;
+			if (c.error > bad_fit_error)
+				++bad_fits;
+			if (c.error > worst->error)
+				worst = &c;
+
+			errors.push_back(c.error);
+		}
+		std::sort(errors.begin(), errors.end());
+
+		const double count = static_cast<double>(cells.size());
+		const auto percentile = [&](double p) {
+			return errors[std::min(errors.size() - 1, static_cast<std::size_t>(p * count))];
+		};
+
+		os << std::endl;
+		os << "Fitted " << cells.size() << " cells in " << wall_time << "s (" << fit_time << "s of fitting, "
+			<< fit_time / wall_time << "x parallelism)" << std::endl;
+		os << "  Fit time  - mean: " << fit_time / count << "s, max: " << max_fit_time << "s" << std::endl;
+		os << "  Fit error - mean: " << error_sum / count << ", RMS: " << std::sqrt(error_squared_sum / count)
+			<< ", median: " << percentile(.5) << ", 95th percentile: " << percentile(.95) << std::endl;
+		os << "  Worst fit - <" << worst->row << "," << worst->col << ">: " << worst->error << std::endl;
+		if (bad_fit_error < std::numeric_limits<double>::infinity()) {
+			os << "  Bad fits (error > " << bad_fit_error << "): " << bad_fits << std::endl;
+			for (auto &c : cells) {
+				if (c.error > bad_fit_error)
+					os << "    <" << c.row << "," << c.col << ">: " << c.error << std::endl;
+			}
+		}
+	}
+};
+
+}
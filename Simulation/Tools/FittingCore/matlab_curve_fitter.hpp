@@ -0,0 +1,116 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "engine.h"
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace StE {
+
+/**
+*	@brief	Fits curves using a MATLAB engine session.
+*	A single engine is shared by all threads, fits are serialized. On failure the engine is restarted and the fit
+*	retried.
+*/
+class matlab_curve_fitter {
+	static constexpr int max_tries = 3;
+
+private:
+	std::mutex m;
+	Engine *engine{ nullptr };
+
+private:
+	static Engine* open() {
+		void *vpDcom = nullptr;
+		int ret = 0;
+		return engOpenSingleUse(0, vpDcom, &ret);
+	}
+
+	void close() {
+		if (engine == nullptr)
+			return;
+
+		try {
+			engClose(engine);
+		}
+		catch (std::exception) {}
+		engine = nullptr;
+	}
+
+	bool eval(const std::string &cmd, int elements, double *p, double *rmse) {
+		if (engine == nullptr)
+			return false;
+
+		try {
+			if (engEvalString(engine, cmd.c_str()) != 0)
+				return false;
+
+			auto *rmsexp = engGetVariable(engine, "rmse");
+			if (rmsexp == nullptr)
+				return false;
+			*rmse = *reinterpret_cast<const double*>(mxGetData(rmsexp));
+			mxDestroyArray(rmsexp);
+
+			auto *mxp = engGetVariable(engine, "p");
+			if (mxp == nullptr)
+				return false;
+			if (mxGetNumberOfElements(mxp) != elements) {
+				mxDestroyArray(mxp);
+				return false;
+			}
+
+			const double *data = reinterpret_cast<const double*>(mxGetData(mxp));
+			std::copy(data, data + elements, p);
+			mxDestroyArray(mxp);
+		}
+		catch (std::exception) {
+			return false;
+		}
+
+		return true;
+	}
+
+public:
+	matlab_curve_fitter() : engine(open()) {}
+	~matlab_curve_fitter() noexcept { close(); }
+
+	matlab_curve_fitter(matlab_curve_fitter&&) = delete;
+	matlab_curve_fitter(const matlab_curve_fitter&) = delete;
+	matlab_curve_fitter &operator=(matlab_curve_fitter&&) = delete;
+	matlab_curve_fitter &operator=(const matlab_curve_fitter&) = delete;
+
+	/**
+	*	@brief	Evaluates a MATLAB fitting script. The script is expected to define the fitted coefficients, 'p', and the
+	*			fit's root-mean-square error, 'rmse'.
+	*			Throws std::runtime_error if the fit fails repeatedly.
+	*
+	* 	@param cmd		MATLAB script
+	* 	@param elements	Count of fitted coefficients
+	* 	@param p		Output coefficients
+	*
+	*	@return	Fit RMSE
+	*/
+	double fit(const std::string &cmd, int elements, double *p) {
+		std::unique_lock<std::mutex> l(m);
+
+		for (int itry = 0; itry < max_tries; ++itry) {
+			double rmse;
+			if (eval(cmd, elements, p, &rmse))
+				return rmse;
+
+			std::cout << "Matlab fitting error... Retrying..." << std::endl;
+			close();
+			engine = open();
+		}
+
+		throw std::runtime_error("Couldn't restart Matlab");
+	}
+};
+
+}
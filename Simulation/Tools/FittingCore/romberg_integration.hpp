@@ -0,0 +1,120 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace StE {
+
+/**
+*	@brief	Implementation of Romberg's method for numerical integration
+*/
+template <unsigned N>
+class romberg_integration {
+	static_assert(N > 0, "Iterations count must be positive.");
+
+private:
+	// Calculates the partial sum of trapezoids using half of n equally spaced segments between a and b.
+	template <typename T, typename F>
+	static T trapezoid(const F &f, double h, double a, double b, std::uint64_t n) {
+		T t = T(.0);
+
+		for (std::uint64_t i = 1; i<n; i += 2) {
+			double x = a + static_cast<double>(i) * h;
+			t += f(x);
+		}
+
+		return t;
+	}
+
+	template <typename T>
+	static void extrapolate(std::array<T, N> &Tk, T t, std::uint64_t n) {
+		for (std::uint64_t m = 1; m <= n; ++m) {
+			T s = t + (t - Tk[m - 1]) / static_cast<double>((1ull << 2ull * m) - 1);
+			Tk[m - 1] = t;
+			t = s;
+		}
+
+		Tk[n] = t;
+	}
+
+public:
+	/**
+	*	@brief	Evaluate definite integral
+	*
+	*	https://en.wikipedia.org/wiki/Romberg's_method
+	*
+	* 	@param f	Function to integrate
+	* 	@param a	Interval start
+	* 	@param b	Interval end
+	*/
+	template <typename T, typename F>
+	static T integrate(const F &f, double a, double b) {
+		if (a >= b)
+			return T(.0);
+
+		std::array<T, N> Tk;
+		Tk.fill(T(.0));
+
+		Tk[0] = .5 * (b - a) * (f(a) + f(b));
+
+		for (std::uint64_t n = 1; n < N; ++n) {
+			std::uint64_t k = static_cast<std::uint64_t>(1) << n;
+			double h = (b - a) / static_cast<double>(k);
+			extrapolate(Tk, .5 * Tk[0] + h * trapezoid<T>(f, h, a, b, k), n);
+		}
+
+		return Tk[N - 1];
+	}
+
+	/**
+	*	@brief	Evaluate definite integral, evaluating the integrand in batches.
+	*			Each refinement level's abscissae are handed to the integrand at once, allowing the integrand to be
+	*			written as a vectorizable loop.
+	*
+	* 	@param f	Batched function to integrate, f(const double *x, T *out, std::size_t count) writes f(x[i]) to out[i].
+	* 	@param a	Interval start
+	* 	@param b	Interval end
+	*/
+	template <typename T, typename F>
+	static T integrate_batched(const F &f, double a, double b) {
+		if (a >= b)
+			return T(.0);
+
+		// Largest level evaluates 2^(N-2) new abscissae, and at least the 2 interval ends are evaluated
+		static constexpr std::size_t max_batch = N > 2 ? static_cast<std::size_t>(1) << (N - 2) : 2;
+		thread_local std::vector<double> x(max_batch);
+		thread_local std::vector<T> y(max_batch);
+
+		std::array<T, N> Tk;
+		Tk.fill(T(.0));
+
+		x[0] = a;
+		x[1] = b;
+		f(x.data(), y.data(), 2);
+		Tk[0] = .5 * (b - a) * (y[0] + y[1]);
+
+		for (std::uint64_t n = 1; n < N; ++n) {
+			std::uint64_t k = static_cast<std::uint64_t>(1) << n;
+			double h = (b - a) / static_cast<double>(k);
+
+			// Partial sum of trapezoids, see trapezoid()
+			const auto count = static_cast<std::size_t>(k >> 1);
+			for (std::size_t i = 0; i < count; ++i)
+				x[i] = a + static_cast<double>(2 * i + 1) * h;
+			f(x.data(), y.data(), count);
+
+			T sum = T(.0);
+			for (std::size_t i = 0; i < count; ++i)
+				sum += y[i];
+			extrapolate(Tk, .5 * Tk[0] + h * sum, n);
+		}
+
+		return Tk[N - 1];
+	}
+};
+
+}
@@ -0,0 +1,124 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "fit_statistics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace StE {
+
+/**
+*	@brief	Fits the cells of a 2D table on all hardware threads.
+*
+*	Each row is fitted by a single worker, in column order, so a cell's fit can be seeded by the row's previous cell.
+*	With row-head seeding, a row's first cell is only fitted once the previous row's first cell was, so it can be
+*	seeded by it. Rows are handed out in order, and the fit proceeds as a wavefront down the table.
+*/
+class wavefront_solver {
+public:
+	/**
+	*	@brief	Invokes f(int row, int col) for every cell of the table. Blocks until done.
+	*	f returns the cell's fit error, which is recorded into stats along with the cell's fit time.
+	*	Prints a progress mark for every 1/32 of the cells fitted. Exceptions thrown by f are rethrown.
+	*
+	* 	@param rows				Table rows
+	* 	@param cols				Table columns
+	* 	@param seed_row_heads	Fit a row's first cell only after the previous row's first cell
+	* 	@param stats			Fit statistics
+	* 	@param f				Fitting function
+	*/
+	template <typename F>
+	static void run(int rows, int cols, bool seed_row_heads, fit_statistics &stats, const F &f) {
+		const int cells_count = rows * cols;
+		if (cells_count <= 0)
+			return;
+
+		std::atomic<int> next_row{ 0 };
+		std::atomic<int> cells_done{ 0 };
+		std::atomic<bool> failed{ false };
+		std::mutex m;
+		std::condition_variable heads_cv;
+		// Rows whose first cell was fitted. Row heads are fitted in order.
+		int heads_done = 0;
+
+		auto fit_cell = [&](int row, int col) {
+			const auto start = std::chrono::high_resolution_clock::now();
+			const double error = static_cast<double>(f(row, col));
+			stats.record(row, col, error, std::chrono::high_resolution_clock::now() - start);
+
+			// Progress
+			const int done = cells_done.fetch_add(1) + 1;
+			if (done * 32 / cells_count != (done - 1) * 32 / cells_count) {
+				std::unique_lock<std::mutex> l(m);
+				std::cout << "x" << std::flush;
+			}
+		};
+
+		auto worker = [&]() {
+			for (int row; (row = next_row.fetch_add(1)) < rows && !failed;) {
+				try {
+					if (seed_row_heads) {
+						{
+							std::unique_lock<std::mutex> l(m);
+							heads_cv.wait(l, [&]() { return heads_done >= row || failed; });
+						}
+						if (failed)
+							return;
+					}
+
+					fit_cell(row, 0);
+					{
+						std::unique_lock<std::mutex> l(m);
+						heads_done = row + 1;
+					}
+					heads_cv.notify_all();
+
+					for (int col = 1; col < cols && !failed; ++col)
+						fit_cell(row, col);
+				}
+				catch (...) {
+					// Release workers waiting on this row's head
+					{
+						std::unique_lock<std::mutex> l(m);
+						failed = true;
+					}
+					heads_cv.notify_all();
+					throw;
+				}
+			}
+		};
+
+		const int workers_count = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), rows));
+		std::vector<std::future<void>> workers;
+		for (int i = 0; i < workers_count; ++i)
+			workers.push_back(std::async(std::launch::async, worker));
+
+		std::exception_ptr error;
+		for (auto &w : workers) {
+			try {
+				w.get();
+			}
+			catch (...) {
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+		std::cout << std::endl;
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+};
+
+}
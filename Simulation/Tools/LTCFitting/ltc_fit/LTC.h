@@ -80,6 +80,34 @@ struct LTC {
 		return res;
 	}
 
+	// batched evaluation for count directions L, given as (Lx, Ly, Lz)
+	void evalBatch(const float* Lx, const float* Ly, const float* Lz, const int count, float* res) const
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			// Loriginal = normalize(invM * L)
+			float x = invM[0][0]*Lx[i] + invM[1][0]*Ly[i] + invM[2][0]*Lz[i];
+			float y = invM[0][1]*Lx[i] + invM[1][1]*Ly[i] + invM[2][1]*Lz[i];
+			float z = invM[0][2]*Lx[i] + invM[1][2]*Ly[i] + invM[2][2]*Lz[i];
+			const float rcpLength = 1.0f / sqrtf(x*x + y*y + z*z);
+			x *= rcpLength;
+			y *= rcpLength;
+			z *= rcpLength;
+
+			// L_ = M * Loriginal
+			const float lx = M[0][0]*x + M[1][0]*y + M[2][0]*z;
+			const float ly = M[0][1]*x + M[1][1]*y + M[2][1]*z;
+			const float lz = M[0][2]*x + M[1][2]*y + M[2][2]*z;
+
+			const float l = sqrtf(lx*lx + ly*ly + lz*lz);
+			const float Jacobian = detM / (l*l*l);
+
+			const float D = 1.0f / pi<float>() * glm::max<float>(0.0f, z);
+
+			res[i] = amplitude * D / Jacobian;
+		}
+	}
+
 	vec3 sample(const float U1, const float U2) const
 	{
 		const float theta = acosf(sqrtf(U1));
@@ -88,6 +116,23 @@ struct LTC {
 		return L;
 	}
 
+	// batched sampling, transforms count cosine-distributed directions (Dx, Dy, Dz) into the samples (Lx, Ly, Lz)
+	// see sample()
+	void sampleBatch(const float* Dx, const float* Dy, const float* Dz, const int count, float* Lx, float* Ly, float* Lz) const
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const float x = M[0][0]*Dx[i] + M[1][0]*Dy[i] + M[2][0]*Dz[i];
+			const float y = M[0][1]*Dx[i] + M[1][1]*Dy[i] + M[2][1]*Dz[i];
+			const float z = M[0][2]*Dx[i] + M[1][2]*Dy[i] + M[2][2]*Dz[i];
+			const float rcpLength = 1.0f / sqrtf(x*x + y*y + z*z);
+
+			Lx[i] = x * rcpLength;
+			Ly[i] = y * rcpLength;
+			Lz[i] = z * rcpLength;
+		}
+	}
+
 	void testNormalization() const
 	{
 		double sum = 0;
@@ -11,6 +11,14 @@ public:
 	// pdf is set to the PDF of sampling L
 	virtual float eval(const vec3& V, const vec3& L, const float alpha, float& pdf) const = 0;
 
+	// batched evaluation of the cosine-weighted BRDF for count directions L, given as (Lx, Ly, Lz)
+	// writes the evaluations into res and the PDFs of sampling L into pdf
+	virtual void evalBatch(const vec3& V, const float* Lx, const float* Ly, const float* Lz, const int count, const float alpha, float* res, float* pdf) const
+	{
+		for (int i = 0; i < count; ++i)
+			res[i] = eval(V, vec3(Lx[i], Ly[i], Lz[i]), alpha, pdf[i]);
+	}
+
 	// sampling
 	virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const = 0;
 };
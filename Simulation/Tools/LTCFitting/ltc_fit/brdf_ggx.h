@@ -45,6 +45,48 @@ public:
 		return res;
 	}
 
+	// branchless, so the loop vectorizes
+	// tan(acos(z)) is written as sqrt(1 - z^2) / z
+	virtual void evalBatch(const vec3& V, const float* Lx, const float* Ly, const float* Lz, const int count, const float alpha, float* res, float* pdf) const
+	{
+		if(V.z <= 0)
+		{
+			for (int i = 0; i < count; ++i)
+				res[i] = pdf[i] = 0;
+			return;
+		}
+
+		// masking
+		const float a_V = 1.0f / alpha / tanf(acosf(V.z));
+		const float LambdaV = (V.z<1.0f) ? 0.5f * (-1.0f + sqrtf(1.0f + 1.0f/a_V/a_V)) : 0.0f;
+		const float alpha2 = alpha*alpha;
+
+		for (int i = 0; i < count; ++i)
+		{
+			// shadowing
+			const float z = Lz[i];
+			const float LambdaL = 0.5f * (-1.0f + sqrtf(1.0f + alpha2 * (1.0f - z*z) / (z*z)));
+			const float G2 = (Lz[i] <= 0.0f) ? 0.0f : 1.0f / (1.0f + LambdaV + LambdaL);
+
+			// D
+			const float hx = V.x + Lx[i];
+			const float hy = V.y + Ly[i];
+			const float hz = V.z + Lz[i];
+			const float rcpLength = 1.0f / sqrtf(hx*hx + hy*hy + hz*hz);
+			const float Hx = hx * rcpLength;
+			const float Hy = hy * rcpLength;
+			const float Hz = hz * rcpLength;
+			const float slopex = Hx/Hz;
+			const float slopey = Hy/Hz;
+			float D = 1.0f / (1.0f + (slopex*slopex+slopey*slopey)/alpha2);
+			D = D*D;
+			D = D / (pi<float>() * alpha2 * Hz*Hz*Hz*Hz);
+
+			pdf[i] = fabsf(D * Hz / 4.0f / (V.x*Hx + V.y*Hy + V.z*Hz));
+			res[i] = D * G2 / 4.0f / V.z;
+		}
+	}
+
 	virtual vec3 sample(const vec3& V, const float alpha, const float U1, const float U2) const
 	{
 		const float phi = 2.0f*pi<float>() * U1;
@@ -14,7 +14,10 @@ using namespace glm;
 #include <fstream>
 #include <iomanip>
 
-#include <future>
+#include <vector>
+
+#include "wavefront_solver.hpp"
+#include "fit_statistics.hpp"
 
 #include "LTC.h"
 #include "brdf.h"
@@ -35,52 +38,78 @@ const int Nsample = 100;
 const float MIN_ALPHA = 0.0001f;
 
 
-// compute the norm (albedo) of the BRDF
-float computeNorm(const Brdf& brdf, const vec3& V, const float alpha)
+// directions sampled from the clamped cosine distribution, transformed by the LTC into its samples (see LTC::sample)
+// sample (i, j) is stored at i + j*Nsample
+struct CosineSamples
 {
-	float norm = 0.0;
+	vector<float> x, y, z;
 
-	for (int j = 0; j < Nsample; ++j)
-		for (int i = 0; i < Nsample; ++i)
-		{
-			const float U1 = (i + 0.5f) / (float)Nsample;
-			const float U2 = (j + 0.5f) / (float)Nsample;
+	CosineSamples() : x(Nsample*Nsample), y(Nsample*Nsample), z(Nsample*Nsample)
+	{
+		for (int j = 0; j < Nsample; ++j)
+			for (int i = 0; i < Nsample; ++i)
+			{
+				const float U1 = (i + 0.5f) / (float)Nsample;
+				const float U2 = (j + 0.5f) / (float)Nsample;
+
+				const float theta = acosf(sqrtf(U1));
+				const float phi = 2.0f*pi<float>() * U2;
+
+				x[i + j*Nsample] = sinf(theta)*cosf(phi);
+				y[i + j*Nsample] = sinf(theta)*sinf(phi);
+				z[i + j*Nsample] = cosf(theta);
+			}
+	}
+};
 
-			// sample
-			const vec3 L = brdf.sample(V, alpha, U1, U2);
+// BRDF samples of a configuration (V, alpha), along with their evaluation
+// independent of the LTC, so they are computed once and shared by the norm, average direction and error computations
+// sample (i, j) is stored at i + j*Nsample
+struct BrdfSamples
+{
+	vector<float> x, y, z;
+	vector<float> eval, pdf;
 
-			// eval
-			float pdf;
-			float eval = brdf.eval(V, L, alpha, pdf);
+	BrdfSamples(const Brdf& brdf, const vec3& V, const float alpha) :
+		x(Nsample*Nsample), y(Nsample*Nsample), z(Nsample*Nsample), eval(Nsample*Nsample), pdf(Nsample*Nsample)
+	{
+		for (int j = 0; j < Nsample; ++j)
+			for (int i = 0; i < Nsample; ++i)
+			{
+				const float U1 = (i + 0.5f) / (float)Nsample;
+				const float U2 = (j + 0.5f) / (float)Nsample;
 
-			// accumulate
-			norm += (pdf > 0) ? eval / pdf : 0.0f;
-		}
+				const vec3 L = brdf.sample(V, alpha, U1, U2);
+				x[i + j*Nsample] = L.x;
+				y[i + j*Nsample] = L.y;
+				z[i + j*Nsample] = L.z;
+			}
+
+		brdf.evalBatch(V, x.data(), y.data(), z.data(), Nsample*Nsample, alpha, eval.data(), pdf.data());
+	}
+};
+
+// compute the norm (albedo) of the BRDF
+float computeNorm(const BrdfSamples& samples)
+{
+	float norm = 0.0;
+
+	for (int k = 0; k < Nsample*Nsample; ++k)
+		norm += (samples.pdf[k] > 0) ? samples.eval[k] / samples.pdf[k] : 0.0f;
 
 	return norm / (float)(Nsample*Nsample);
 }
 
 // compute the average direction of the BRDF
-vec3 computeAverageDir(const Brdf& brdf, const vec3& V, const float alpha)
+vec3 computeAverageDir(const BrdfSamples& samples)
 {
 	vec3 averageDir = vec3(0, 0, 0);
 
-	for (int j = 0; j < Nsample; ++j)
-		for (int i = 0; i < Nsample; ++i)
-		{
-			const float U1 = (i + 0.5f) / (float)Nsample;
-			const float U2 = (j + 0.5f) / (float)Nsample;
-
-			// sample
-			const vec3 L = brdf.sample(V, alpha, U1, U2);
-
-			// eval
-			float pdf;
-			float eval = brdf.eval(V, L, alpha, pdf);
-
-			// accumulate
-			averageDir += (pdf > 0) ? eval / pdf * L : vec3(0, 0, 0);
-		}
+	for (int k = 0; k < Nsample*Nsample; ++k)
+	{
+		const vec3 L = vec3(samples.x[k], samples.y[k], samples.z[k]);
+		averageDir += (samples.pdf[k] > 0) ? samples.eval[k] / samples.pdf[k] * L : vec3(0, 0, 0);
+	}
 
 	// clear y component, which should be zero with isotropic BRDFs
 	averageDir.y = 0.0f;
@@ -90,54 +119,50 @@ vec3 computeAverageDir(const Brdf& brdf, const vec3& V, const float alpha)
 
 // compute the error between the BRDF and the LTC
 // using Multiple Importance Sampling
-float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha)
+float computeError(const LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha,
+				   const CosineSamples& cosineSamples, const BrdfSamples& brdfSamples)
 {
-	double error = 0.0;
+	const int count = Nsample*Nsample;
 
-	for (int j = 0; j < Nsample; ++j)
-		for (int i = 0; i < Nsample; ++i)
-		{
-			const float U1 = (i + 0.5f) / (float)Nsample;
-			const float U2 = (j + 0.5f) / (float)Nsample;
+	thread_local vector<float> Lx(count), Ly(count), Lz(count);
+	thread_local vector<float> eval_brdf(count), pdf_brdf(count), eval_ltc(count);
+	thread_local vector<float> eval_ltc_brdf_samples(count);
 
-			// importance sample LTC
-			{
-				// sample
-				const vec3 L = ltc.sample(U1, U2);
-
-				// error with MIS weight
-				float pdf_brdf;
-				float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
-				float eval_ltc = ltc.eval(L);
-				float pdf_ltc = eval_ltc / ltc.amplitude;
-				double error_ = abs(eval_brdf - eval_ltc);
-				error_ = error_*error_*error_;
-				error += error_ / (pdf_ltc + pdf_brdf);
-			}
+	// importance sample LTC
+	ltc.sampleBatch(cosineSamples.x.data(), cosineSamples.y.data(), cosineSamples.z.data(), count, Lx.data(), Ly.data(), Lz.data());
+	brdf.evalBatch(V, Lx.data(), Ly.data(), Lz.data(), count, alpha, eval_brdf.data(), pdf_brdf.data());
+	ltc.evalBatch(Lx.data(), Ly.data(), Lz.data(), count, eval_ltc.data());
 
-			// importance sample BRDF
-			{
-				// sample
-				const vec3 L = brdf.sample(V, alpha, U1, U2);
+	// importance sample BRDF
+	ltc.evalBatch(brdfSamples.x.data(), brdfSamples.y.data(), brdfSamples.z.data(), count, eval_ltc_brdf_samples.data());
 
-				// error with MIS weight
-				float pdf_brdf;
-				float eval_brdf = brdf.eval(V, L, alpha, pdf_brdf);
-				float eval_ltc = ltc.eval(L);
-				float pdf_ltc = eval_ltc / ltc.amplitude;
-				double error_ = abs(eval_brdf - eval_ltc);
-				error_ = error_*error_*error_;
-				error += error_ / (pdf_ltc + pdf_brdf);
-			}
+	double error = 0.0;
+	for (int k = 0; k < count; ++k)
+	{
+		// error with MIS weight
+		{
+			float pdf_ltc = eval_ltc[k] / ltc.amplitude;
+			double error_ = abs(eval_brdf[k] - eval_ltc[k]);
+			error_ = error_*error_*error_;
+			error += error_ / (pdf_ltc + pdf_brdf[k]);
+		}
+		{
+			float pdf_ltc = eval_ltc_brdf_samples[k] / ltc.amplitude;
+			double error_ = abs(brdfSamples.eval[k] - eval_ltc_brdf_samples[k]);
+			error_ = error_*error_*error_;
+			error += error_ / (pdf_ltc + brdfSamples.pdf[k]);
 		}
+	}
 
 	return (float)error / (float)(Nsample*Nsample);
 }
 
 struct FitLTC
 {
-	FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_) :
-		ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_)
+	FitLTC(LTC& ltc_, const Brdf& brdf, bool isotropic_, const vec3& V_, float alpha_,
+		   const CosineSamples& cosineSamples_, const BrdfSamples& brdfSamples_) :
+		ltc(ltc_), brdf(brdf), V(V_), alpha(alpha_), isotropic(isotropic_),
+		cosineSamples(cosineSamples_), brdfSamples(brdfSamples_)
 	{
 	}
 
@@ -168,7 +193,7 @@ struct FitLTC
 	float operator()(const float * params)
 	{
 		update(params);
-		return computeError(ltc, brdf, V, alpha);
+		return computeError(ltc, brdf, V, alpha, cosineSamples, brdfSamples);
 	}
 
 	const Brdf& brdf;
@@ -177,109 +202,119 @@ struct FitLTC
 
 	const vec3& V;
 	float alpha;
+
+	const CosineSamples& cosineSamples;
+	const BrdfSamples& brdfSamples;
 };
 
 // fit brute force
 // refine first guess by exploring parameter space
-void fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha, const float epsilon = 0.05f, const bool isotropic = false)
+// returns the fit error
+float fit(LTC& ltc, const Brdf& brdf, const vec3& V, const float alpha,
+		  const CosineSamples& cosineSamples, const BrdfSamples& brdfSamples,
+		  const float epsilon = 0.05f, const bool isotropic = false)
 {
 	float startFit[4] = { ltc.m11, ltc.m22, ltc.m13, ltc.m23 };
 	float resultFit[4];
 
-	FitLTC fitter(ltc, brdf, isotropic, V, alpha);
+	FitLTC fitter(ltc, brdf, isotropic, V, alpha, cosineSamples, brdfSamples);
 
 	// Find best-fit LTC lobe (scale, alphax, alphay)
 	float error = NelderMead<4>(resultFit, startFit, epsilon, 1e-6f, 150, fitter);
 
 	// Update LTC with best fitting values
 	fitter.update(resultFit);
+
+	return error;
 }
 
 // fit data
-void fitTab(mat3 * tab, float * tabAmplitude, const int N, const Brdf& brdf)
+// each alpha is fitted by increasing theta, with each fit seeded by the previous theta's fit. The first theta's fit is
+// seeded by the previous alpha's, so the alphas are fitted as a wavefront, in parallel.
+void fitTab(mat3 * tab, float * tabAmplitude, const int N, const Brdf& brdf, StE::fit_statistics& stats)
 {
-	LTC ltc;
+	const CosineSamples cosineSamples;
 
-	// loop over theta and alpha
-	for (int a = N - 1; a >= 0; --a)
-		for (int t = 0; t <= N - 1; ++t)
-		{
-			float theta = std::min<float>(1.57f, t / float(N - 1) * half_pi<float>());
-			const vec3 V = vec3(sin(theta), 0, cos(theta));
+	// fit state of each alpha
+	vector<LTC> ltcs(N);
 
-			// alpha = roughness^2
-			float roughness = a / float(N - 1);
-			float alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
+	// loop over alpha and theta
+	StE::wavefront_solver::run(N, N, true, stats, [&](int row, int t)
+	{
+		const int a = N - 1 - row;
+		LTC& ltc = ltcs[row];
+
+		float theta = std::min<float>(1.57f, t / float(N - 1) * half_pi<float>());
+		const vec3 V = vec3(sin(theta), 0, cos(theta));
+
+		// alpha = roughness^2
+		float roughness = a / float(N - 1);
+		float alpha = std::max<float>(roughness*roughness, MIN_ALPHA);
+
+		const BrdfSamples brdfSamples(brdf, V, alpha);
 
-			cout << "a = " << a << "\t t = " << t << endl;
-			//cout << "alpha = " << alpha << "\t theta = " << theta << endl;
-			//cout << endl;
+		ltc.amplitude = computeNorm(brdfSamples);
+		const vec3 averageDir = computeAverageDir(brdfSamples);
+		bool isotropic;
 
-			ltc.amplitude = computeNorm(brdf, V, alpha);
-			const vec3 averageDir = computeAverageDir(brdf, V, alpha);
-			bool isotropic;
+		// 1. first guess for the fit
+		// init the hemisphere in which the distribution is fitted
+		// if theta == 0 the lobe is rotationally symmetric and aligned with Z = (0 0 1)
+		if (t == 0)
+		{
+			ltc.X = vec3(1, 0, 0);
+			ltc.Y = vec3(0, 1, 0);
+			ltc.Z = vec3(0, 0, 1);
 
-			// 1. first guess for the fit
-			// init the hemisphere in which the distribution is fitted
-			// if theta == 0 the lobe is rotationally symmetric and aligned with Z = (0 0 1)
-			if (t == 0)
+			if (a == N - 1) // roughness = 1
 			{
-				ltc.X = vec3(1, 0, 0);
-				ltc.Y = vec3(0, 1, 0);
-				ltc.Z = vec3(0, 0, 1);
-
-				if (a == N - 1) // roughness = 1
-				{
-					ltc.m11 = 1.0f;
-					ltc.m22 = 1.0f;
-				}
-				else // init with roughness of previous fit
-				{
-					ltc.m11 = std::max<float>(tab[a + 1 + t*N][0][0], MIN_ALPHA);
-					ltc.m22 = std::max<float>(tab[a + 1 + t*N][1][1], MIN_ALPHA);
-				}
-
-				ltc.m13 = 0;
-				ltc.m23 = 0;
-				ltc.update();
-
-				isotropic = true;
+				ltc.m11 = 1.0f;
+				ltc.m22 = 1.0f;
 			}
-			// otherwise use previous configuration as first guess
-			else
+			else // init with roughness of previous fit
 			{
-				vec3 L = normalize(averageDir);
-				vec3 T1(L.z, 0, -L.x);
-				vec3 T2(0, 1, 0);
-				ltc.X = T1;
-				ltc.Y = T2;
-				ltc.Z = L;
+				ltc.m11 = std::max<float>(tab[a + 1 + t*N][0][0], MIN_ALPHA);
+				ltc.m22 = std::max<float>(tab[a + 1 + t*N][1][1], MIN_ALPHA);
+			}
 
-				ltc.update();
+			ltc.m13 = 0;
+			ltc.m23 = 0;
+			ltc.update();
 
-				isotropic = false;
-			}
+			isotropic = true;
+		}
+		// otherwise use previous configuration as first guess
+		else
+		{
+			vec3 L = normalize(averageDir);
+			vec3 T1(L.z, 0, -L.x);
+			vec3 T2(0, 1, 0);
+			ltc.X = T1;
+			ltc.Y = T2;
+			ltc.Z = L;
 
-			// 2. fit (explore parameter space and refine first guess)
-			float epsilon = 0.05f;
-			fit(ltc, brdf, V, alpha, epsilon, isotropic);
-
-			// copy data
-			tab[a + t*N] = ltc.M;
-			tabAmplitude[a + t*N] = ltc.amplitude;
-
-			// kill useless coefs in matrix and normalize
-			tab[a + t*N][0][1] = 0;
-			tab[a + t*N][1][0] = 0;
-			tab[a + t*N][2][1] = 0;
-			tab[a + t*N][1][2] = 0;
-			tab[a + t*N] = 1.0f / tab[a + t*N][2][2] * tab[a + t*N];
-
-			cout << tab[a + t*N][0][0] << "\t " << tab[a + t*N][1][0] << "\t " << tab[a + t*N][2][0] << endl;
-			cout << tab[a + t*N][0][1] << "\t " << tab[a + t*N][1][1] << "\t " << tab[a + t*N][2][1] << endl;
-			cout << tab[a + t*N][0][2] << "\t " << tab[a + t*N][1][2] << "\t " << tab[a + t*N][2][2] << endl;
-			cout << endl;
+			ltc.update();
+
+			isotropic = false;
 		}
+
+		// 2. fit (explore parameter space and refine first guess)
+		float epsilon = 0.05f;
+		float error = fit(ltc, brdf, V, alpha, cosineSamples, brdfSamples, epsilon, isotropic);
+
+		// copy data
+		tab[a + t*N] = ltc.M;
+		tabAmplitude[a + t*N] = ltc.amplitude;
+
+		// kill useless coefs in matrix and normalize
+		tab[a + t*N][0][1] = 0;
+		tab[a + t*N][1][0] = 0;
+		tab[a + t*N][2][1] = 0;
+		tab[a + t*N][1][2] = 0;
+		tab[a + t*N] = 1.0f / tab[a + t*N][2][2] * tab[a + t*N];
+
+		return error;
+	});
 }
 
 
@@ -295,7 +330,9 @@ int main()
 	float * tabAmplitude = new float[N*N];
 
 	// fit
-	fitTab(tab, tabAmplitude, N, brdf);
+	StE::fit_statistics stats;
+	fitTab(tab, tabAmplitude, N, brdf, stats);
+	stats.report(cout);
 
 	// export in C, matlab and DDS
 	//writeTabMatlab(tab, tabAmplitude, N);
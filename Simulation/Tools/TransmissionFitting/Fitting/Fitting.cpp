@@ -2,7 +2,6 @@
 //
 
 #include "stdafx.h"
-#include "engine.h"
 
 #define GLM_FORCE_AVX
 #define GLM_EXT_INCLUDED
@@ -12,81 +11,17 @@
 
 #include <boost/crc.hpp>
 
+#include "romberg_integration.hpp"
+#include "matlab_curve_fitter.hpp"
+#include "wavefront_solver.hpp"
+#include "fit_statistics.hpp"
+
 #include <cstdint>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <array>
-#include <vector>
 #include <cmath>
-#include <future>
-#include <complex>
-
-namespace StE {
-
-/**
-*	@brief	Implementation of Romberg's method for numerical integration
-*/
-template <unsigned N>
-class romberg_integration {
-	static_assert(N > 0, "Iterations count must be positive.");
-
-private:
-	// Calculates the partial sum of trapezoids using half of n equally spaced segments between a and b.
-	template <typename F>
-	static double trapezoid(const F &f, double h, double a, double b, std::uint64_t n) {
-		double t = .0;
-
-		for (std::uint64_t i = 1; i<n; i += 2) {
-			double x = a + static_cast<double>(i) * h;
-			t += f(x);
-		}
-
-		return t;
-	}
-
-public:
-	/**
-	*	@brief	Evaluate definite integral
-	*
-	*	https://en.wikipedia.org/wiki/Romberg's_method
-	*
-	* 	@param f	Function to integrate
-	* 	@param a	Interval start
-	* 	@param b	Interval end
-	*/
-	template <typename F>
-	static double integrate(const F &f, double a, double b) {
-		using T = double;
-
-		if (a >= b)
-			return T(.0);
-
-		T t;
-		std::array<T, N> Tk;
-		Tk.fill(T(.0));
-
-		Tk[0] = .5 * (b - a) * (f(a) + f(b));
-
-		for (std::uint64_t n = 1; n < N; ++n) {
-			std::uint64_t k = static_cast<std::uint64_t>(1) << n;
-			double h = (b - a) / static_cast<double>(k);
-			t = .5 * Tk[0] + h * trapezoid(f, h, a, b, k);
-
-			for (std::uint64_t m = 1; m <= n; ++m) {
-				T s = t + (t - Tk[m - 1]) / static_cast<double>((1ull << 2ull * m) - 1);
-				Tk[m - 1] = t;
-				t = s;
-			}
-
-			Tk[n] = t;
-		}
-
-		return static_cast<T>(Tk[N - 1]);
-	}
-};
-
-}
 
 struct transmission_fit_data {
 	// m*((erf(a*x - b) + 1) + c*x) + d
@@ -107,88 +42,37 @@ struct transmission_fit {
 	std::array<std::array<transmission_fit_data, M>, N> data;
 };
 
-using fitting_future = std::future<std::tuple<std::string, int, int>>;
-
-bool matlab_eval(const std::string &cmd, int x, int y, int elements, Engine *matlabEngine, transmission_fit *lut, double *rmse) {
-	try {
-		if (engEvalString(matlabEngine, cmd.c_str()) != 0)
-			return false;
-
-		auto *rmsexp = engGetVariable(matlabEngine, "rmse");
-		*rmse = *reinterpret_cast<const double*>(mxGetData(rmsexp));
-		mxDestroyArray(rmsexp);
-
-		auto *mxp = engGetVariable(matlabEngine, "p");
-		if (mxGetNumberOfElements(mxp) != elements) {
-			mxDestroyArray(mxp);
-			return false;
-		}
-
-		const double *p = reinterpret_cast<const double*>(mxGetData(mxp));
-		std::copy(p, p + elements, reinterpret_cast<double*>(&lut->data[x][y]));
-		mxDestroyArray(mxp);
-	}
-	catch (std::exception) {
-		return false;
-	}
-
-	return true;
-}
-
-void fit(fitting_future &future, Engine* &matlabEngine, transmission_fit *lut) {
-	if (!future.valid())
-		return;
-
-	auto fdata = future.get();
-
-	auto cmd = std::get<0>(fdata);
-	int x = std::get<1>(fdata);
-	int y = std::get<2>(fdata);
-
-	for (int itry = 0; itry < 3; ++itry) {
-		double rmse;
-		if (matlab_eval(cmd, x, y, 5, matlabEngine, lut, &rmse)) {
-			std::cout << "<" << x << "," << y << ">: RMSE: " << rmse << "   - Fit: " << lut->data[x][y].m << "*((erf(" << lut->data[x][y].a << "*x - " << lut->data[x][y].b << ") + 1) + " << lut->data[x][y].c << "*x) + " << lut->data[x][y].d << std::endl;
-			if (rmse > .075) {
-				std::cout << "Bad fit!" << std::endl;
-			}
-			return;
-		}
-
-		std::cout << "Matlab fitting error... Retrying..." << std::endl;
-		try {
-			engClose(matlabEngine);
-		}
-		catch (std::exception) {}
-
-		void * vpDcom = nullptr;
-		int ret = 0;
-		matlabEngine = engOpenSingleUse(0, vpDcom, &ret);
+/**
+*	@brief	Fresnel transmittance of the light direction l = (sin(theta_v), 0, cos(theta_v)) through the microfacets
+*			m = (sin(theta)cos(phi), sin(theta)sin(phi), cos(theta)), batched over phi.
+*			Writes the transmittance into x and the microfacet's visibility into y, both are 0 for invisible microfacets.
+*/
+void transmission_fresnel_batched(double theta_v, double theta, double r, const double *phi, glm::dvec2 *out, std::size_t count) {
+	const double lx = glm::sin(theta_v);
+	const double lz = glm::cos(theta_v);
+	const double sin_theta = glm::sin(theta);
+	const double cos_theta = glm::cos(theta);
+
+	const double sin_critical = glm::min<double>(1.0, r);
+	const double cos_critical = 1. - sin_critical * sin_critical;
+
+	// Branchless, so the loop vectorizes
+	for (std::size_t i = 0; i < count; ++i) {
+		// l.y = 0
+		const double cosx = lx * sin_theta * glm::cos(phi[i]) + lz * cos_theta;
+
+		// Past the critical angle the cosine of the transmitted angle, c, is imaginary, and both Fresnel terms are 1.
+		const double k = 1. - (1. - cosx * cosx) / (r*r);
+		const double c = glm::sqrt(glm::max(k, .0));
+		const double Rp = (cosx - r * c) / (cosx + r * c);
+		const double Rs = (c - r * cosx) / (r * cosx + c);
+		const double T = 1. - glm::clamp(.5 * (Rp*Rp + Rs*Rs), .0, 1.);
+
+		const bool visible = cosx > 0;
+		const bool transmits = visible && cosx * cosx > cos_critical * cos_critical && k > 0;
+
+		out[i] = glm::dvec2(transmits ? T : .0, visible ? 1. : .0);
 	}
-
-	throw new std::runtime_error("Couldn't restart Matlab");
-}
-
-bool V(const glm::dvec3 &m, const glm::dvec3 &l) {
-	double cos_gamma = glm::dot(m, l);
-	return cos_gamma > 0;
-}
-
-double transmission_fresnel(const glm::dvec3 &m, const glm::dvec3 &l, double r) {
-	double cosx = glm::dot(l, m);
-
-	double sin_critical = glm::min<double>(1.0, r);
-	double cos_critical = 1. - sin_critical * sin_critical;
-	if (cosx * cosx <= cos_critical * cos_critical)
-		return .0;
-
-	auto sinx2 = std::complex<double>(1) - cosx * cosx;
-	auto c = std::sqrt(std::complex<double>(1) - sinx2 / (r*r));
-
-	auto Rp = std::norm((cosx - r * c) / (cosx + r * c));
-	auto Rs = std::norm((c - r * cosx) / (r * cosx + c));
-
-	return 1. - glm::clamp(.5 * (Rp + Rs), .0, 1.);
 }
 
 double D(double cos_theta, double roughness) {
@@ -202,104 +86,82 @@ int main() {
 	constexpr double Rmax = 3.2;
 	auto *lut = new transmission_fit;
 
-	void * vpDcom = nullptr;
-	int ret = 0;
-	Engine* matlabEngine = engOpenSingleUse(0, vpDcom, &ret);
-
-	fitting_future futures[2];
+	StE::matlab_curve_fitter fitter;
+	StE::fit_statistics stats;
 
-	int it = 0;
 	constexpr double cos_theta_step = 1.0 / 100.;
-	for (int x = 0; x<transmission_fit::N; ++x) {
-		for (int y = 0; y<transmission_fit::M; ++y) {
-			double ior_ratio = static_cast<double>(x) / static_cast<double>(transmission_fit::N - 1) * (Rmax - Rmin) + Rmin;
-			double roughness = static_cast<double>(y) / static_cast<double>(transmission_fit::M - 1);
-			roughness = glm::max<double>(roughness, 1e-4);
-
-			double omega = glm::asin(glm::min<double>(1.0, ior_ratio));
-
-			std::cout << "Integrating - r: " << ior_ratio << ", roughness: " << roughness << std::endl;
-
-			futures[it % 2] = std::async([=]() {
-				std::string strx, stry;
-				for (double cos_theta = .0; cos_theta <= 1.0; 
-					 cos_theta = (cos_theta < 1 && cos_theta + cos_theta_step >= 1.) ? 1. : cos_theta + cos_theta_step) {
-					if (strx.length() > 0) {
-						strx += " ";
-						stry += " ";
-					}
-
-					double theta = glm::acos(cos_theta);
-
-					auto f = [&](double x, bool with_fresnel) {
-						auto g = [&](double theta_v, double theta, double phi) {
-							glm::dvec3 m = { glm::sin(theta) * glm::cos(phi), glm::sin(theta) * glm::sin(phi), glm::cos(theta) };
-							glm::dvec3 l = { glm::sin(theta_v), 0, glm::cos(theta_v) };
-
-							if (!V(m, l))
-								return .0;
-
-							return with_fresnel ? transmission_fresnel(m, l, ior_ratio) : 1.0;
-						};
-
-						auto intg = StE::romberg_integration<10>::integrate(std::bind(g, theta, x, std::placeholders::_1), 0, glm::two_pi<double>());
-						auto c = .5 * glm::sin(2 * x) * D(glm::cos(x), roughness);
+	StE::wavefront_solver::run(transmission_fit::N, transmission_fit::M, false, stats, [&](int x, int y) {
+		double ior_ratio = static_cast<double>(x) / static_cast<double>(transmission_fit::N - 1) * (Rmax - Rmin) + Rmin;
+		double roughness = static_cast<double>(y) / static_cast<double>(transmission_fit::M - 1);
+		roughness = glm::max<double>(roughness, 1e-4);
+
+		double omega = glm::asin(glm::min<double>(1.0, ior_ratio));
+
+		std::string strx, stry;
+		for (double cos_theta = .0; cos_theta <= 1.0;
+			 cos_theta = (cos_theta < 1 && cos_theta + cos_theta_step >= 1.) ? 1. : cos_theta + cos_theta_step) {
+			if (strx.length() > 0) {
+				strx += " ";
+				stry += " ";
+			}
 
-						return c * intg;
-					};
+			double theta = glm::acos(cos_theta);
 
-					double s = 0.;
-					double t = glm::half_pi<double>();
+			// Integrates the transmittance and the normalizer, the visible microfacets' projected area, together
+			auto f = [&](double x) {
+				auto g = [&](const double *phi, glm::dvec2 *out, std::size_t count) {
+					transmission_fresnel_batched(theta, x, ior_ratio, phi, out, count);
+				};
 
-					double numerical_integration = StE::romberg_integration<10>::integrate(std::bind(f, std::placeholders::_1, true), s, t);
-					double normalizer = StE::romberg_integration<10>::integrate(std::bind(f, std::placeholders::_1, false), s, t);
+				auto intg = StE::romberg_integration<10>::integrate_batched<glm::dvec2>(g, 0, glm::two_pi<double>());
+				auto c = .5 * glm::sin(2 * x) * D(glm::cos(x), roughness);
 
-					double res = normalizer > 0 ? numerical_integration / normalizer : .0;
-					if (std::isnan(res)) {
-						std::cout << "!! nan for " << omega <<  "," << roughness << " !!" << std::endl;
-						res = 1.0;
-					}
+				return c * intg;
+			};
 
-					strx += std::to_string(cos_theta);
-					stry += std::to_string(res);
-				}
+			double s = 0.;
+			double t = glm::half_pi<double>();
 
-				std::string cmd = "x=[" + strx + "];\ny=[" + stry + R"(];
-						w = ones(length(x),1); w(1) = 10; w(length(x))=100;
+			glm::dvec2 integrals = StE::romberg_integration<10>::integrate<glm::dvec2>(f, s, t);
+			double numerical_integration = integrals.x;
+			double normalizer = integrals.y;
 
-						[xData, yData, weights] = prepareCurveData( x, y, w );
+			double res = normalizer > 0 ? numerical_integration / normalizer : .0;
+			if (std::isnan(res)) {
+				std::cout << "!! nan for " << omega <<  "," << roughness << " !!" << std::endl;
+				res = 1.0;
+			}
 
-						ft = fittype( 'm*((erf(a*x - b) + 1) + c*x) + d', 'independent', 'x', 'dependent', 'y' );
-						opts = fitoptions( 'Method', 'NonlinearLeastSquares' );
-						opts.Display = 'Off';
-						opts.Lower = [-Inf -Inf 0 -Inf 0];
-						opts.MaxFunEvals = 6000;
-						opts.MaxIter = 4000;
-						opts.StartPoint = [0 0 0 0 .5];
-						opts.TolFun = 1e-07;
-						opts.Upper = [Inf Inf 1 Inf 1];
-						opts.Weights = weights;
+			strx += std::to_string(cos_theta);
+			stry += std::to_string(res);
+		}
 
-						[sf, sg] = fit(xData, yData, ft, opts);
+		std::string cmd = "x=[" + strx + "];\ny=[" + stry + R"(];
+				w = ones(length(x),1); w(1) = 10; w(length(x))=100;
 
-						p = coeffvalues(sf);
-						rmse = sg.rmse;
-					)";
+				[xData, yData, weights] = prepareCurveData( x, y, w );
 
-				return std::make_tuple(cmd, x, y);
-			});
+				ft = fittype( 'm*((erf(a*x - b) + 1) + c*x) + d', 'independent', 'x', 'dependent', 'y' );
+				opts = fitoptions( 'Method', 'NonlinearLeastSquares' );
+				opts.Display = 'Off';
+				opts.Lower = [-Inf -Inf 0 -Inf 0];
+				opts.MaxFunEvals = 6000;
+				opts.MaxIter = 4000;
+				opts.StartPoint = [0 0 0 0 .5];
+				opts.TolFun = 1e-07;
+				opts.Upper = [Inf Inf 1 Inf 1];
+				opts.Weights = weights;
 
-			++it;
-			fit(futures[it % 2], matlabEngine, lut);
+				[sf, sg] = fit(xData, yData, ft, opts);
 
-			std::cout << "iteration: " << std::to_string(it) << " (" << std::to_string(100.0*static_cast<double>(it) / static_cast<double>(transmission_fit::N*transmission_fit::N)) << "%)" << std::endl;
-		}
-	}
+				p = coeffvalues(sf);
+				rmse = sg.rmse;
+			)";
 
-	++it;
-	fit(futures[it % 2], matlabEngine, lut);
+		return fitter.fit(cmd, 5, reinterpret_cast<double*>(&lut->data[x][y]));
+	});
 
-	engClose(matlabEngine);
+	stats.report(std::cout, .075);
 
 	memcpy(lut->ndf_type, "GGX TRNS", 8);
 	lut->width = transmission_fit::N;
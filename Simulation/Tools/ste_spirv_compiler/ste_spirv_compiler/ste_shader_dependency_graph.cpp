@@ -0,0 +1,202 @@
+
+#include "stdafx.h"
+
+#include "ste_shader_dependency_graph.hpp"
+#include "ste_shader_factory.hpp"
+
+#include <crc32.h>
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <unordered_set>
+
+using namespace StE;
+
+ste_shader_dependency_graph::ste_shader_dependency_graph(const ste_shader_source_index &index,
+														 const boost::filesystem::path &db_path)
+	: index(index), db_path(db_path)
+{
+	load();
+}
+
+void ste_shader_dependency_graph::load() {
+	std::ifstream f(db_path.string(), std::ios::in);
+	if (!f)
+		return;
+
+	std::string line;
+	if (!std::getline(f, line) || line != std::string(file_name) + " " + std::to_string(format_version))
+		return;
+
+	// Discard everything on malformed input, the graph is rebuilt from the sources
+	const auto discard = [this]() {
+		files.clear();
+		programs.clear();
+	};
+
+	while (std::getline(f, line)) {
+		std::istringstream iss(line);
+		std::string type;
+		iss >> type;
+
+		if (type == "f") {
+			file_record r;
+			std::size_t includes_count;
+			std::string path;
+			if (!(iss >> r.hash >> r.size >> r.modification_time >> includes_count) || !std::getline(iss >> std::ws, path)) {
+				discard();
+				return;
+			}
+
+			r.includes.resize(includes_count);
+			for (auto &include : r.includes) {
+				if (!std::getline(f, include)) {
+					discard();
+					return;
+				}
+			}
+
+			files[path] = std::move(r);
+		}
+		else if (type == "p") {
+			std::uint32_t hash;
+			std::string name;
+			if (!(iss >> hash) || !std::getline(iss >> std::ws, name)) {
+				discard();
+				return;
+			}
+
+			programs[name] = hash;
+		}
+		else {
+			discard();
+			return;
+		}
+	}
+}
+
+void ste_shader_dependency_graph::save() const {
+	const auto temp_db_path = db_path.string() + ".tmp";
+	{
+		std::ofstream of;
+		of.exceptions(of.exceptions() | std::ios::failbit | std::ifstream::badbit);
+		of.open(temp_db_path, std::ios::out);
+
+		std::unique_lock<std::mutex> l(m);
+
+		of << file_name << " " << format_version << "\n";
+		for (auto &f : files) {
+			if (!f.second.scanned)
+				continue;
+
+			of << "f " << f.second.hash << " " << f.second.size << " " << f.second.modification_time << " " << f.second.includes.size() << " " << f.first << "\n";
+			for (auto &include : f.second.includes)
+				of << include << "\n";
+		}
+		for (auto &p : index.get_programs()) {
+			const auto it = programs.find(p.filename().string());
+			if (it != programs.end())
+				of << "p " << it->second << " " << it->first << "\n";
+		}
+	}
+
+	boost::filesystem::rename(temp_db_path, db_path);
+}
+
+const ste_shader_dependency_graph::file_record &ste_shader_dependency_graph::scan(const boost::filesystem::path &path) {
+	auto &r = files[path.string()];
+	if (r.scanned)
+		return r;
+
+	const auto size = boost::filesystem::file_size(path);
+	const auto modification_time = boost::filesystem::last_write_time(path);
+
+	// Reread only new or modified files
+	if (r.size != size || r.modification_time != modification_time || r.hash == 0) {
+		std::ifstream fs(path.string(), std::ios::in | std::ios::binary);
+		if (!fs) {
+			std::cerr << "Can not load " << path.string() << std::endl;
+			throw std::exception((std::string("Can not load ") + path.string()).c_str());
+		}
+		std::string content = std::string((std::istreambuf_iterator<char>(fs)), (std::istreambuf_iterator<char>()));
+
+		r.size = size;
+		r.modification_time = modification_time;
+		r.hash = crc32::crc32_fast(content.data(), content.size());
+		r.includes = ste_shader_factory::find_includes(std::move(content));
+
+		++files_read;
+	}
+
+	r.scanned = true;
+	return r;
+}
+
+ste_shader_dependency_graph::program_inputs ste_shader_dependency_graph::inputs(const boost::filesystem::path &program_path) {
+	std::vector<boost::filesystem::path> paths = { program_path };
+	std::unordered_set<std::string> visited = { program_path.string() };
+
+	std::unique_lock<std::mutex> l(m);
+
+	// Transitive closure of includes
+	for (std::size_t i = 0; i < paths.size(); ++i) {
+		const auto &r = scan(paths[i]);
+		for (auto &include : r.includes) {
+			const auto *include_path = index.resolve(include);
+			if (!include_path) {
+				std::cerr << "Can not load include " << include << std::endl;
+				throw std::exception((std::string("Can not load include ") + include).c_str());
+			}
+
+			if (visited.insert(include_path->string()).second)
+				paths.push_back(*include_path);
+		}
+	}
+
+	// Hash inputs in a stable order
+	std::sort(paths.begin(), paths.end());
+
+	program_inputs ret;
+	ret.count = paths.size();
+	ret.hash = crc32::crc32_fast(&format_version, sizeof(format_version));
+	for (auto &p : paths) {
+		const auto path_string = p.string();
+		const auto &r = files[path_string];
+
+		ret.hash = crc32::crc32_fast(path_string.data(), path_string.size(), ret.hash);
+		ret.hash = crc32::crc32_fast(&r.hash, sizeof(r.hash), ret.hash);
+		ret.modification_time = std::max(ret.modification_time, r.modification_time);
+		ret.size += r.size;
+	}
+
+	return ret;
+}
+
+bool ste_shader_dependency_graph::is_up_to_date(const boost::filesystem::path &program_path,
+												const program_inputs &inputs,
+												const boost::filesystem::path &output) const {
+	if (!boost::filesystem::exists(output))
+		return false;
+
+	std::unique_lock<std::mutex> l(m);
+
+	const auto it = programs.find(program_path.filename().string());
+	if (it != programs.end())
+		return it->second == inputs.hash;
+
+	// No record, compare modification times
+	return inputs.modification_time <= boost::filesystem::last_write_time(output);
+}
+
+void ste_shader_dependency_graph::record(const boost::filesystem::path &program_path, std::uint32_t inputs_hash) {
+	std::unique_lock<std::mutex> l(m);
+	programs[program_path.filename().string()] = inputs_hash;
+}
+
+void ste_shader_dependency_graph::invalidate(const boost::filesystem::path &program_path) {
+	std::unique_lock<std::mutex> l(m);
+	programs.erase(program_path.filename().string());
+}
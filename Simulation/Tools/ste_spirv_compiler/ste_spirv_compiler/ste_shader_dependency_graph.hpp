@@ -0,0 +1,105 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "stdafx.h"
+#include "ste_shader_source_index.hpp"
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+#include <boost/filesystem.hpp>
+
+namespace StE {
+
+/**
+ *	@brief	Persisted include graph of the shader sources, with content hashes.
+ *
+ *	Every source file is recorded with its size, modification time, CRC32 of its content and the names it includes.
+ *	Files whose size and modification time are unchanged are not reread. A program is up-to-date if the hash of its
+ *	transitive inputs matches the hash recorded when it was last compiled successfully.
+ */
+class ste_shader_dependency_graph {
+public:
+	static constexpr std::uint32_t format_version = 1;
+	static constexpr auto file_name = "ste_shader_dependencies";
+
+	struct program_inputs {
+		// Hash of the paths and contents of all transitive inputs
+		std::uint32_t hash{ 0 };
+		// Latest modification time of the inputs
+		std::time_t modification_time{ 0 };
+		std::size_t count{ 0 };
+		// Total size of the inputs, in bytes
+		std::uintmax_t size{ 0 };
+	};
+
+private:
+	struct file_record {
+		std::uint32_t hash{ 0 };
+		std::uintmax_t size{ 0 };
+		std::time_t modification_time{ 0 };
+		std::vector<std::string> includes;
+		bool scanned{ false };
+	};
+
+	const ste_shader_source_index &index;
+	boost::filesystem::path db_path;
+
+	mutable std::mutex m;
+	// Keyed by path
+	std::unordered_map<std::string, file_record> files;
+	// Keyed by program file name
+	std::unordered_map<std::string, std::uint32_t> programs;
+
+	std::size_t files_read{ 0 };
+
+private:
+	const file_record &scan(const boost::filesystem::path &path);
+	void load();
+
+public:
+	ste_shader_dependency_graph(const ste_shader_source_index &index, const boost::filesystem::path &db_path);
+
+	/**
+	 *	@brief	Computes a program's transitive inputs and their hash.
+	 *
+	 *	@throws	std::exception	If an include can not be resolved
+	 */
+	program_inputs inputs(const boost::filesystem::path &program_path);
+
+	/**
+	 *	@brief	Checks whether a program's compiled output is up-to-date with its inputs.
+	 *			Programs without a record fall back to comparing modification times.
+	 */
+	bool is_up_to_date(const boost::filesystem::path &program_path,
+					   const program_inputs &inputs,
+					   const boost::filesystem::path &output) const;
+
+	/**
+	 *	@brief	Records a successful compilation of a program. Thread-safe.
+	 */
+	void record(const boost::filesystem::path &program_path, std::uint32_t inputs_hash);
+	/**
+	 *	@brief	Drops a program's record, forcing recompilation. Thread-safe.
+	 */
+	void invalidate(const boost::filesystem::path &program_path);
+
+	/**
+	 *	@brief	Writes the graph. Only files and programs seen in this run are kept.
+	 */
+	void save() const;
+
+	/**
+	 *	@brief	Count of source files that were read, i.e. files that are new or were modified since the last run.
+	 */
+	auto get_files_read() const { return files_read; }
+};
+
+}
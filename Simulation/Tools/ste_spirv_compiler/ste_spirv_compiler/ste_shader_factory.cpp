@@ -55,7 +55,7 @@ std::string ste_shader_factory::load_source(const boost::filesystem::path &path)
 }
 
 std::string ste_shader_factory::compile_from_path(const boost::filesystem::path &path,
-												  const boost::filesystem::path &source_path,
+												  const ste_shader_source_index &index,
 												  shader_blob_header &header) {
 	static const std::vector<std::string> inject_extenions = { "#extension GL_GOOGLE_cpp_style_line_directive : enable" };
 
@@ -79,7 +79,7 @@ std::string ste_shader_factory::compile_from_path(const boost::filesystem::path
 				line += std::string("#line ") + std::to_string(i) + " \"" + path.string() + "\"";
 			}
 
-			parse_include(path, i, line, paths, source_path);
+			parse_include(path, i, line, paths, index);
 		}
 	}
 
@@ -134,9 +134,9 @@ bool ste_shader_factory::parse_parameters(std::string &line, shader_blob_header
 	return false;
 }
 
-std::vector<std::string> ste_shader_factory::find_includes(const boost::filesystem::path &path) {
+std::vector<std::string> ste_shader_factory::find_includes(std::string &&content) {
 	std::vector<std::string> ret;
-	std::string src = load_source(path);
+	std::string src = erase_multiline_comments(std::move(content));
 
 	std::string::size_type it = 0, end;
 	std::string name;
@@ -161,7 +161,7 @@ bool ste_shader_factory::parse_include(const boost::filesystem::path &path,
 									   int line,
 									   std::string &source,
 									   std::vector<std::string> &paths,
-									   const boost::filesystem::path &source_path) {
+									   const ste_shader_source_index &index) {
 	std::string::size_type it = 0, end;
 	std::string name;
 	std::string path_string = path.string();
@@ -182,7 +182,7 @@ bool ste_shader_factory::parse_include(const boost::filesystem::path &path,
 			}
 
 		boost::filesystem::path include_path;
-		bool has_path = resolve_program(file_name, &include_path, source_path);
+		bool has_path = resolve_program(file_name, &include_path, index);
 		if (!has_path) {
 			std::cerr << "Can not load include " << file_name << std::endl;
 			throw std::exception((std::string("Can not load include ") + file_name).c_str());
@@ -192,7 +192,7 @@ bool ste_shader_factory::parse_include(const boost::filesystem::path &path,
 		std::istringstream include_stream(include);
 		std::string include_line, include_src;
 		for (int i = 1; std::getline(include_stream, include_line); ++i, include_src += include_line + "\n") {
-			if (include_line[0] == '#') parse_include(include_path, i, include_line, paths, source_path);
+			if (include_line[0] == '#') parse_include(include_path, i, include_line, paths, index);
 		}
 
 		std::string include_path_string = include_path.string();
@@ -213,60 +213,23 @@ bool ste_shader_factory::parse_include(const boost::filesystem::path &path,
 
 bool ste_shader_factory::resolve_program(const std::string &program_name,
 										 boost::filesystem::path *path,
-										 const boost::filesystem::path &source_path) {
-	boost::filesystem::recursive_directory_iterator end;
-
-	const auto it = std::find_if(boost::filesystem::recursive_directory_iterator(source_path),
-								 end,
-								 [&program_name](const boost::filesystem::directory_entry& e) {
-		return e.path().filename() == program_name;
-	});
-	if (it == end)
+										 const ste_shader_source_index &index) {
+	const auto *p = index.resolve(program_name);
+	if (!p)
 		return false;
 
-	*path = it->path();
+	*path = *p;
 	return true;
 }
 
-std::chrono::system_clock::time_point ste_shader_factory::shader_modification_time(const boost::filesystem::path &path,
-																				   const boost::filesystem::path &source_path) {
-	std::chrono::system_clock::time_point modification_time;
-
-	std::vector<boost::filesystem::path> paths = { path };
-
-	for (unsigned i = 0; i < paths.size(); ++i) {
-		auto &p = paths[i];
-
-		auto includes = find_includes(p);
-		for (auto &include : includes) {
-			boost::filesystem::path i_path;
-			if (!resolve_program(include, &i_path, source_path)) {
-				std::cerr << "Can not load include " << include << std::endl;
-				throw std::exception((std::string("Can not load include ") + include).c_str());
-			}
-
-			if (std::find(paths.begin(), paths.end(), i_path) == paths.end())
-				paths.push_back(i_path);
-		}
-	}
-
-	for (auto &p : paths) {
-		auto timet = boost::filesystem::last_write_time(p);
-		std::chrono::system_clock::time_point sys_time_point = std::chrono::system_clock::from_time_t(timet);
-		if (sys_time_point > modification_time) modification_time = sys_time_point;
-	}
-
-	return modification_time;
-}
-
 std::string ste_shader_factory::compile_shader(const boost::filesystem::path &path,
-											   const boost::filesystem::path &source_path,
+											   const ste_shader_source_index &index,
 											   shader_blob_header &out) {
 	out = {};
 	out.magic = shader_blob_header().magic;
 
 	const auto shader_name = path.stem();
-	const auto src = compile_from_path(path, source_path, out);
+	const auto src = compile_from_path(path, index, out);
 	std::string temp_extension;
 
 	switch (out.type) {
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "stdafx.h"
+#include "ste_shader_source_index.hpp"
 
 #include <memory>
 #include <string>
@@ -57,25 +58,27 @@ class ste_shader_factory {
 private:
 	~ste_shader_factory() noexcept {}
 
-	static bool resolve_program(const std::string &program_name, boost::filesystem::path *path, const boost::filesystem::path &source_path);
+	static bool resolve_program(const std::string &program_name, boost::filesystem::path *path, const ste_shader_source_index &index);
 
 	static std::string erase_multiline_comments(std::string &&src);
 
 	static std::string load_source(const boost::filesystem::path &path);
 	static std::string compile_from_path(const boost::filesystem::path &path,
-										 const boost::filesystem::path &source_path,
+										 const ste_shader_source_index &index,
 										 shader_blob_header &);
 
-	static std::vector<std::string> find_includes(const boost::filesystem::path &path);
-	static bool parse_include(const boost::filesystem::path &, int, std::string &, std::vector<std::string> &, const boost::filesystem::path &);
+	static bool parse_include(const boost::filesystem::path &, int, std::string &, std::vector<std::string> &, const ste_shader_source_index &);
 	static bool parse_type(std::string &, shader_blob_header &);
 	static bool parse_parameters(std::string &, shader_blob_header &);
 	static std::string parse_directive(const std::string &, const std::string &, std::string::size_type &, std::string::size_type &);
 
 public:
-	static std::chrono::system_clock::time_point shader_modification_time(const boost::filesystem::path &path, const boost::filesystem::path &source_path);
+	/**
+	 *	@brief	Lists the names of the files included by a source file, given the file's content.
+	 */
+	static std::vector<std::string> find_includes(std::string &&content);
 	static std::string compile_shader(const boost::filesystem::path &path,
-									  const boost::filesystem::path &source_path,
+									  const ste_shader_source_index &index,
 									  shader_blob_header &out);
 };
 
@@ -0,0 +1,135 @@
+
+#include "stdafx.h"
+
+#include "ste_shader_pack_writer.hpp"
+
+#include <crc32.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace StE;
+
+bool ste_shader_pack_writer::read_module(const boost::filesystem::path &path, module_t &out) {
+	std::ifstream f(path.string(), std::ios::in | std::ios::binary);
+	if (!f)
+		return false;
+
+	std::vector<char> content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	if (content.size() < sizeof(shader_blob_header) ||
+		(content.size() - sizeof(shader_blob_header)) % sizeof(std::uint32_t) != 0)
+		return false;
+
+	std::memcpy(&out.header, content.data(), sizeof(shader_blob_header));
+	if (out.header.magic != shader_blob_header().magic)
+		return false;
+
+	out.name = path.filename().string();
+	out.code.assign(content.begin() + sizeof(shader_blob_header), content.end());
+	out.crc = crc32::crc32_fast(out.code.data(),
+								out.code.size(),
+								crc32::crc32_fast(&out.header, sizeof(out.header)));
+
+	return true;
+}
+
+bool ste_shader_pack_writer::is_up_to_date(const boost::filesystem::path &pack_path, std::uint32_t modules_count, std::uint32_t content_crc) {
+	if (!boost::filesystem::exists(pack_path))
+		return false;
+
+	std::ifstream f(pack_path.string(), std::ios::in | std::ios::binary);
+	pack_header header;
+	if (!f.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+
+	return header.magic == magic_value &&
+		header.version == format_version &&
+		header.modules_count == modules_count &&
+		header.content_crc == content_crc;
+}
+
+bool ste_shader_pack_writer::write_pack(const boost::filesystem::path &programs_path) {
+	const auto pack_path = programs_path / file_name;
+
+	// Read all compiled modules, sorted by name
+	std::vector<boost::filesystem::path> paths;
+	for (auto it = boost::filesystem::directory_iterator(programs_path); it != boost::filesystem::directory_iterator(); ++it) {
+		if (!boost::filesystem::is_regular_file(it->path()) ||
+			it->path().filename() == file_name)
+			continue;
+		paths.push_back(it->path());
+	}
+	std::sort(paths.begin(), paths.end(), [](const auto &a, const auto &b) {
+		return a.filename().string() < b.filename().string();
+	});
+
+	std::vector<module_t> modules;
+	modules.reserve(paths.size());
+	std::uint32_t content_crc = 0;
+	for (auto &p : paths) {
+		module_t m;
+		if (!read_module(p, m))
+			continue;
+
+		content_crc = crc32::crc32_fast(m.name.data(), m.name.size(), content_crc);
+		content_crc = crc32::crc32_fast(&m.crc, sizeof(m.crc), content_crc);
+		modules.push_back(std::move(m));
+	}
+
+	const auto modules_count = static_cast<std::uint32_t>(modules.size());
+	if (is_up_to_date(pack_path, modules_count, content_crc))
+		return false;
+
+	// Build index
+	std::vector<pack_entry> entries;
+	std::string names;
+	entries.reserve(modules.size());
+	for (auto &m : modules) {
+		pack_entry e = {};
+		e.name_offset = static_cast<std::uint32_t>(names.size());
+		e.name_length = static_cast<std::uint32_t>(m.name.size());
+		e.code_size = m.code.size();
+		e.crc = m.crc;
+		e.header = m.header;
+
+		names += m.name;
+		entries.push_back(e);
+	}
+
+	// Code follows the names, 4-byte aligned
+	const std::uint64_t code_start = sizeof(pack_header) + sizeof(pack_entry) * entries.size() + names.size();
+	const std::uint64_t padding = (sizeof(std::uint32_t) - code_start % sizeof(std::uint32_t)) % sizeof(std::uint32_t);
+	std::uint64_t code_offset = code_start + padding;
+	for (auto &e : entries) {
+		e.code_offset = code_offset;
+		code_offset += e.code_size;
+	}
+
+	pack_header header = {};
+	header.magic = magic_value;
+	header.version = format_version;
+	header.modules_count = modules_count;
+	header.names_size = static_cast<std::uint32_t>(names.size());
+	header.content_crc = content_crc;
+
+	// Write to a temporary and replace, the pack is never left partially written
+	const auto temp_pack_path = programs_path / (std::string(file_name) + ".tmp");
+	{
+		std::ofstream of;
+		of.exceptions(of.exceptions() | std::ios::failbit | std::ifstream::badbit);
+		of.open(temp_pack_path.string(), std::ios::out | std::ios::binary);
+
+		static const char zeros[sizeof(std::uint32_t)] = {};
+		of.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		of.write(reinterpret_cast<const char*>(entries.data()), sizeof(pack_entry) * entries.size());
+		of.write(names.data(), names.size());
+		of.write(zeros, padding);
+		for (auto &m : modules)
+			of.write(m.code.data(), m.code.size());
+	}
+	boost::filesystem::rename(temp_pack_path, pack_path);
+
+	return true;
+}
@@ -0,0 +1,74 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "stdafx.h"
+#include "ste_shader_factory.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+#include <boost/filesystem.hpp>
+
+namespace StE {
+
+/**
+ *	@brief	Writes the shader pack, consumed by the engine's ste_shader_pack, from the compiled shader modules.
+ *
+ *	Layout:	pack_header, pack_entry[modules_count] (sorted by module name), names, SPIR-v code (4-byte aligned).
+ *	Each entry carries a CRC32 of the module's blob header and code.
+ */
+class ste_shader_pack_writer {
+public:
+	static constexpr std::uint32_t magic_value = 0x4B505453;	// "STPK"
+	static constexpr std::uint32_t format_version = 1;
+	static constexpr auto file_name = "programs.stepack";
+
+	struct pack_header {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t modules_count;
+		std::uint32_t names_size;
+		std::uint32_t content_crc;
+		std::uint32_t reserved;
+	};
+
+	struct pack_entry {
+		std::uint32_t name_offset;
+		std::uint32_t name_length;
+		std::uint64_t code_offset;
+		std::uint64_t code_size;
+		std::uint32_t crc;
+		std::uint32_t reserved;
+		shader_blob_header header;
+	};
+
+	static_assert(sizeof(pack_header) == 24, "Unexpected pack_header layout");
+	static_assert(sizeof(pack_entry) == 48, "Unexpected pack_entry layout");
+
+private:
+	struct module_t {
+		std::string name;
+		shader_blob_header header;
+		std::vector<char> code;
+		std::uint32_t crc;
+	};
+
+	~ste_shader_pack_writer() noexcept {}
+
+	static bool read_module(const boost::filesystem::path &path, module_t &out);
+	static bool is_up_to_date(const boost::filesystem::path &pack_path, std::uint32_t modules_count, std::uint32_t content_crc);
+
+public:
+	/**
+	 *	@brief	Packs all modules in the programs directory. The pack is rewritten only if the modules have changed.
+	 *
+	 *	@return	True if the pack was written, false if it was up-to-date.
+	 */
+	static bool write_pack(const boost::filesystem::path &programs_path);
+};
+
+}
@@ -0,0 +1,28 @@
+
+#include "stdafx.h"
+
+#include "ste_shader_source_index.hpp"
+
+using namespace StE;
+
+bool ste_shader_source_index::is_program_extension(const std::string &ext) {
+	return ext == std::string(".vert") ||
+		ext == std::string(".frag") ||
+		ext == std::string(".geom") ||
+		ext == std::string(".comp") ||
+		ext == std::string(".tesc") ||
+		ext == std::string(".tese");
+}
+
+ste_shader_source_index::ste_shader_source_index(const boost::filesystem::path &source_path) : source_path(source_path) {
+	for (auto it = boost::filesystem::recursive_directory_iterator(source_path); it != boost::filesystem::recursive_directory_iterator(); ++it) {
+		if (!boost::filesystem::is_regular_file(it->status()))
+			continue;
+
+		const auto &path = it->path();
+		files.emplace(path.filename().string(), path);
+
+		if (is_program_extension(path.extension().string()))
+			programs.push_back(path);
+	}
+}
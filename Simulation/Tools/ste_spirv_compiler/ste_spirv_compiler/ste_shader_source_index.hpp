@@ -0,0 +1,50 @@
+// StE
+//  Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include "stdafx.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+#include <boost/filesystem.hpp>
+
+namespace StE {
+
+/**
+ *	@brief	Index of the shader source tree, built with a single walk of the tree.
+ *
+ *	Includes are referenced by file name alone, the index maps file names to paths. Like the compiler always did,
+ *	the first file found with a given name wins.
+ */
+class ste_shader_source_index {
+private:
+	boost::filesystem::path source_path;
+	std::unordered_map<std::string, boost::filesystem::path> files;
+	std::vector<boost::filesystem::path> programs;
+
+public:
+	static bool is_program_extension(const std::string &ext);
+
+	explicit ste_shader_source_index(const boost::filesystem::path &source_path);
+
+	/**
+	 *	@brief	Resolves a file name to a path in the source tree. Returns nullptr if no such file exists.
+	 */
+	const boost::filesystem::path *resolve(const std::string &file_name) const {
+		const auto it = files.find(file_name);
+		return it != files.end() ? &it->second : nullptr;
+	}
+
+	/**
+	 *	@brief	Shader program sources, i.e. all files with a program extension.
+	 */
+	const auto &get_programs() const { return programs; }
+	const auto &get_source_path() const { return source_path; }
+	auto size() const { return files.size(); }
+};
+
+}
@@ -3,6 +3,9 @@
 
 #include "stdafx.h"
 #include "ste_shader_factory.hpp"
+#include "ste_shader_pack_writer.hpp"
+#include "ste_shader_source_index.hpp"
+#include "ste_shader_dependency_graph.hpp"
 
 #include <glslang/Public/ShaderLang.h>
 #include <glslang/Include/ResourceLimits.h>
@@ -13,7 +16,13 @@
 #include <boost/filesystem.hpp>
 
 #include <iostream>
+#include <fstream>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 #include <vector>
 #include <list>
 #include <string>
@@ -327,7 +336,10 @@ struct compile_result_t {
     explicit compile_result_t(boost::filesystem::path path, std::string s) : cerr(s), code(2), path(path) {}
 };
 
-static constexpr unsigned up_to_date_code = 0xda7e;
+struct compile_job_t {
+    boost::filesystem::path path;
+    StE::ste_shader_dependency_graph::program_inputs inputs;
+};
 
 auto parm_to_path(std::string s) {
     if (s[0] == '\'' || s[0] == '\"') {
@@ -338,11 +350,81 @@ auto parm_to_path(std::string s) {
     return boost::filesystem::path(s);
 }
 
+auto elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+compile_result_t compile_program(const boost::filesystem::path &path,
+                                 const StE::ste_shader_source_index &index,
+                                 const boost::filesystem::path &shader_binary_output_path) {
+    auto name = path.stem().string();
+
+    try {
+        if (!boost::filesystem::exists(path)) {
+            return compile_result_t(path, path.string() + ": Fatal error - Does not exists\n");
+        }
+
+        auto output = shader_binary_output_path / path.filename();
+
+        // Compile StE shader
+        compile_result_t result = compile_result_t(path, 0);
+        StE::shader_blob_header header;
+        std::string glsl_source = StE::ste_shader_factory::compile_shader(path,
+                                                                          index,
+                                                                          header);
+
+        // Create SPIR-v compiler
+        EShLanguage compiler_language;
+        switch (header.type) {
+        case StE::ste_shader_type::vertex_program:		compiler_language = EShLangVertex; break;
+        case StE::ste_shader_type::geometry_program:	        compiler_language = EShLangGeometry; break;
+        case StE::ste_shader_type::fragment_program:	        compiler_language = EShLangFragment; break;
+        case StE::ste_shader_type::compute_program:		compiler_language = EShLangCompute; break;
+        case StE::ste_shader_type::tesselation_control_program:		compiler_language = EShLangTessControl; break;
+        case StE::ste_shader_type::tesselation_evaluation_program:	compiler_language = EShLangTessEvaluation; break;
+        default:
+            return compile_result_t(path, path.string() + ": Fatal error - Not an StE shader file\n");
+        }
+
+        // Generate SPIR-v binary
+        std::vector<unsigned int> spirv;
+        std::ostringstream cout;
+        {
+            ShaderCompUnit compUnit(compiler_language);
+            compUnit.addString(name,
+                               glsl_source.data());
+
+            // glslang is safe to use concurrently once ShInitialize() was called, each worker compiles with its own
+            // shader and program objects.
+            CompileAndLinkShaderUnits(compUnit,
+                                      spirv,
+                                      cout);
+
+            if (!spirv.size()) {
+                return compile_result_t(path, cout.str());
+            }
+        }
+
+        // Write compiled module with StE header
+        {
+            std::ofstream of;
+            of.exceptions(of.exceptions() | std::ios::failbit | std::ifstream::badbit);
+            of.open(output.string(), std::ios::out | std::ios::binary);
+            of.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            of.write(reinterpret_cast<const char*>(spirv.data()), sizeof(unsigned int) * spirv.size());
+        }
+
+        return result;
+    }
+    catch (std::exception e) {
+        return compile_result_t(path, path.string() + ": Fatal error - " + std::string(e.what()) + "\n");
+    }
+}
+
 int main(int argc,
          char *argv[],
          char *envp[]) {
     unsigned ret = 0;
-    std::vector<boost::filesystem::path> paths;
 
     if (argc != 2) {
         std::cerr << "Expected arguments: [path_prefix]" << std::endl;
@@ -354,138 +436,107 @@ int main(int argc,
     const boost::filesystem::path temp_path = prefix_path / boost::filesystem::path(R"(temp)");
     const boost::filesystem::path source_path = prefix_path / boost::filesystem::path(R"(src)");
 
-    // Find all source files
-    {
-        for (auto it = boost::filesystem::recursive_directory_iterator(source_path); it != boost::filesystem::recursive_directory_iterator(); ++it) {
-            auto ext = it->path().extension().string();
-            if (!ext.length())
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Index all source files, includes are resolved against the index
+    const StE::ste_shader_source_index index(source_path);
+    const auto index_time = elapsed_ms(start);
+
+    // Make sure programs output and temp directories exist
+    if (!boost::filesystem::exists(shader_binary_output_path))
+        boost::filesystem::create_directory(shader_binary_output_path);
+    if (!boost::filesystem::exists(temp_path))
+        boost::filesystem::create_directory(temp_path);
+
+    // Find programs whose inputs have changed
+    StE::ste_shader_dependency_graph graph(index, temp_path / StE::ste_shader_dependency_graph::file_name);
+    std::vector<compile_job_t> jobs;
+    for (auto &path : index.get_programs()) {
+        try {
+            const auto inputs = graph.inputs(path);
+            if (graph.is_up_to_date(path, inputs, shader_binary_output_path / path.filename())) {
+                graph.record(path, inputs.hash);
                 continue;
+            }
 
-            if (ext == std::string(".vert") ||
-                ext == std::string(".frag") ||
-                ext == std::string(".geom") ||
-                ext == std::string(".comp") ||
-                ext == std::string(".tesc") ||
-                ext == std::string(".tese"))
-                paths.push_back(it->path());
+            jobs.push_back({ path, inputs });
+        }
+        catch (std::exception e) {
+            std::cout << path.filename().string() << "..." << std::endl;
+            std::cout << path.string() << ": Fatal error - " << std::string(e.what()) << std::endl << std::flush;
+            graph.invalidate(path);
+            ret = 1;
         }
     }
+    const auto scan_time = elapsed_ms(start) - index_time;
 
-    // Make sure programs output directory exists
-    if (!boost::filesystem::exists(shader_binary_output_path))
-        boost::filesystem::create_directory(shader_binary_output_path);
+    // Largest programs first, to keep the tail short
+    std::sort(jobs.begin(), jobs.end(), [](const auto &a, const auto &b) {
+        return a.inputs.size > b.inputs.size;
+    });
 
     // Init
     ShInitialize();
 
-    // Submit async tasks (in chunks)
-    for (std::size_t path_idx = 0; path_idx < paths.size();) {
-        std::vector<std::pair<std::string, std::future<compile_result_t>>> futures;
-        std::mutex m;
-
-        for (std::size_t t=0; path_idx < paths.size() && t<std::thread::hardware_concurrency()*2; ++path_idx, ++t) {
-            const auto &path = paths[path_idx];
-
-            auto name = path.stem().string();
-            auto f = std::async(std::launch::async, [path, &temp_path, &shader_binary_output_path, &source_path, &m]() -> compile_result_t {
-                auto name = path.stem().string();
-
-                try {
-                    if (!boost::filesystem::exists(path)) {
-                        return compile_result_t(path, path.string() + ": Fatal error - Does not exists\n");
-                    }
-
-                    auto spirv_temp_output = temp_path / (std::string("compiled_blob_") + path.filename().string());
-                    auto output = shader_binary_output_path / path.filename();
-
-                    // Check modification time of shader and dependencies
-                    // Ignore if up-to-date
-                    if (boost::filesystem::exists(output)) {
-                        const auto target_modification_time = std::chrono::system_clock::from_time_t(boost::filesystem::last_write_time(output));
-                        const auto source_modification_time = StE::ste_shader_factory::shader_modification_time(path, source_path);
-                        if (source_modification_time <= target_modification_time)
-                            return compile_result_t(path, up_to_date_code);
-                    }
-
-                    // Compile StE shader
-                    compile_result_t result = compile_result_t(path, 0);
-                    StE::shader_blob_header header;
-                    std::string glsl_source = StE::ste_shader_factory::compile_shader(path,
-                                                                                      source_path,
-                                                                                      header);
-
-                    // Create SPIR-v compiler
-                    EShLanguage compiler_language;
-                    switch (header.type) {
-                    case StE::ste_shader_type::vertex_program:		compiler_language = EShLangVertex; break;
-                    case StE::ste_shader_type::geometry_program:	        compiler_language = EShLangGeometry; break;
-                    case StE::ste_shader_type::fragment_program:	        compiler_language = EShLangFragment; break;
-                    case StE::ste_shader_type::compute_program:		compiler_language = EShLangCompute; break;
-                    case StE::ste_shader_type::tesselation_control_program:		compiler_language = EShLangTessControl; break;
-                    case StE::ste_shader_type::tesselation_evaluation_program:	compiler_language = EShLangTessEvaluation; break;
-                    default:
-                        return compile_result_t(path, path.string() + ": Fatal error - Not an StE shader file\n");
-                    }
-
-                    // Generate SPIR-v binary
-                    std::vector<unsigned int> spirv;
-                    std::ostringstream cout;
-                    {
-                        ShaderCompUnit compUnit(compiler_language);
-                        compUnit.addString(name,
-                                           glsl_source.data());
-
-                        std::unique_lock<std::mutex> l(m);
-
-                        CompileAndLinkShaderUnits(compUnit,
-                                                  spirv,
-                                                  cout);
-
-                        if (!spirv.size()) {
-                            return compile_result_t(path, cout.str());
-                        }
-                    }
-
-                    // Write compiled module with StE header
-                    {
-                        std::ofstream of;
-                        of.exceptions(of.exceptions() | std::ios::failbit | std::ifstream::badbit);
-                        of.open(output.string(), std::ios::out | std::ios::binary);
-                        of.write(reinterpret_cast<const char*>(&header), sizeof(header));
-                        of.write(reinterpret_cast<const char*>(spirv.data()), sizeof(unsigned int) * spirv.size());
-                    }
-
-                    return result;
+    // Workers pull programs off a shared queue until it drains
+    {
+        std::atomic<std::size_t> next_job{ 0 };
+        std::mutex output_mutex;
+
+        const auto worker = [&]() {
+            for (std::size_t i; (i = next_job.fetch_add(1)) < jobs.size();) {
+                const auto &job = jobs[i];
+                const auto r = compile_program(job.path, index, shader_binary_output_path);
+
+                if (r.code == 0)
+                    graph.record(job.path, job.inputs.hash);
+                else
+                    graph.invalidate(job.path);
+
+                std::unique_lock<std::mutex> l(output_mutex);
+                std::cout << job.path.filename().string() << "..." << std::endl << std::flush;
+                if (r.code != 0) {
+                    std::cout << r.cerr << std::flush;
+                    ret = 1;
                 }
-                catch (std::exception e) {
-                    return compile_result_t(path, path.string() + ": Fatal error - " + std::string(e.what()) + "\n");
+                else {
+                    auto output = shader_binary_output_path / r.path.filename();
+                    std::cout << "Binary installed " << output.string() << "." << std::endl << std::flush;
                 }
-            });
+            }
+        };
+
+        const auto workers_count = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), jobs.size());
+        std::vector<std::future<void>> workers;
+        for (std::size_t t = 0; t < workers_count; ++t)
+            workers.push_back(std::async(std::launch::async, worker));
+        for (auto &f : workers)
+            f.get();
+    }
 
-            futures.emplace_back(path.filename().string(),
-                                 std::move(f));
-        }
+    ShFinalize();
 
-        // Wait
-        for (auto &f : futures) {
-            const auto r = f.second.get();
-            if (r.code == up_to_date_code) {
-                continue;
-            }
+    try {
+        graph.save();
+    }
+    catch (std::exception e) {
+        std::cout << "Couldn't write shader dependency graph - " << std::string(e.what()) << std::endl << std::flush;
+    }
 
-            std::cout << f.first << "..." << std::endl << std::flush;
-            if (r.code != 0) {
-                std::cout << r.cerr << std::flush;
-                ret = 1;
-            }
-            else {
-                auto output = shader_binary_output_path / r.path.filename();
-                std::cout << "Binary installed " << output.string() << "." << std::endl << std::flush;
-            }
+    // Pack all compiled modules
+    try {
+        if (StE::ste_shader_pack_writer::write_pack(shader_binary_output_path)) {
+            auto output = shader_binary_output_path / StE::ste_shader_pack_writer::file_name;
+            std::cout << "Shader pack installed " << output.string() << "." << std::endl << std::flush;
         }
     }
+    catch (std::exception e) {
+        std::cout << "Shader pack: Fatal error - " << std::string(e.what()) << std::endl << std::flush;
+        ret = 1;
+    }
 
-    ShFinalize();
+    std::cout << index.get_programs().size() << " programs, " << jobs.size() << " out-of-date (" << graph.get_files_read() << " source files read). "
+        << "Index " << index_time << "ms, dependency scan " << scan_time << "ms, total " << elapsed_ms(start) << "ms." << std::endl << std::flush;
 
     return ret;
 }
@@ -0,0 +1,407 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <device_memory_tlsf.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::gl;
+
+namespace {
+
+// Same granularity as device_memory_heap
+constexpr int granularity_log2 = 7;
+using tlsf = device_memory_tlsf<granularity_log2>;
+using size_type = tlsf::size_type;
+constexpr size_type unit = tlsf::granularity;
+
+/**
+ *	@brief	First-fit allocator over a sorted vector of blocks, as used by device_memory_heap before device_memory_tlsf.
+ *			Kept as the baseline the TLSF allocator is measured against.
+ */
+class first_fit_heap {
+private:
+	struct block_t {
+		size_type offset, size;
+		bool operator<(const block_t &o) const { return offset < o.offset; }
+	};
+
+	size_type total_size;
+	lib::vector<block_t> blocks;
+
+	static size_type align(size_type x, size_type alignment) {
+		return (x + alignment - 1) / alignment * alignment;
+	}
+
+public:
+	first_fit_heap(size_type size) : total_size(size) {}
+
+	bool allocate(size_type size, size_type alignment, size_type &offset) {
+		alignment = std::max(alignment, unit);
+		size = align(size, alignment);
+		if (total_size < size)
+			return false;
+
+		size_type start = 0;
+		for (auto it = blocks.begin();; ++it) {
+			const bool last = it == blocks.end();
+			const auto end = last ? total_size : it->offset;
+
+			start = align(start, alignment);
+			if (end > start && end - start >= size) {
+				blocks.insert(it, { start, size });
+				offset = start;
+				return true;
+			}
+			if (last)
+				return false;
+			start = it->offset + it->size;
+		}
+	}
+
+	void deallocate(size_type offset) {
+		const auto it = std::lower_bound(blocks.begin(), blocks.end(), block_t{ offset, 0 });
+		assert(it != blocks.end() && it->offset == offset);
+		blocks.erase(it);
+	}
+
+	device_memory_fragmentation_report fragmentation_report() const {
+		device_memory_fragmentation_report report;
+		size_type start = 0, largest = 0, free = 0;
+		for (std::size_t i = 0; i <= blocks.size(); ++i) {
+			const auto end = i < blocks.size() ? blocks[i].offset : total_size;
+			if (end > start) {
+				++report.free_blocks_count;
+				largest = std::max(largest, end - start);
+				free += end - start;
+			}
+			if (i < blocks.size())
+				start = blocks[i].offset + blocks[i].size;
+		}
+		report.free_bytes = byte_t(free);
+		report.largest_free_block = byte_t(largest);
+		report.allocated_blocks_count = blocks.size();
+		return report;
+	}
+
+	bool validate() const {
+		for (std::size_t i = 1; i < blocks.size(); ++i)
+			if (blocks[i - 1].offset + blocks[i - 1].size > blocks[i].offset)
+				return false;
+		return blocks.empty() || blocks.back().offset + blocks.back().size <= total_size;
+	}
+};
+
+/**
+ *	@brief	Tracks live allocations and checks they don't overlap
+ */
+class live_ranges {
+private:
+	std::map<size_type, size_type> ranges;
+
+public:
+	bool insert(size_type offset, size_type size) {
+		const auto next = ranges.lower_bound(offset);
+		if (next != ranges.end() && next->first < offset + size)
+			return false;
+		if (next != ranges.begin() && std::prev(next)->second > offset)
+			return false;
+		ranges.emplace(offset, offset + size);
+		return true;
+	}
+	void erase(size_type offset) { ranges.erase(offset); }
+};
+
+void alignment_test(tests::test_context &ctx) {
+	tlsf allocator(64 * 1024 * unit);
+	live_ranges ranges;
+
+	std::mt19937 gen(1);
+	bool aligned = true, disjoint = true, sized = true;
+	for (int i = 0; i < 1000; ++i) {
+		const auto size = (1 + gen() % 64) * unit;
+		const auto alignment = unit << (gen() % 10);
+
+		size_type offset;
+		const auto h = allocator.allocate(size, alignment, offset);
+		if (!ctx.check(h != tlsf::invalid_handle, "Allocation failed"))
+			break;
+
+		aligned &= offset % alignment == 0;
+		sized &= allocator.get_size(h) == size && allocator.get_offset(h) == offset &&
+			offset + size <= allocator.get_total_size();
+		disjoint &= ranges.insert(offset, size);
+
+		// Sub-granularity alignments are rounded up to the granularity
+		size_type small_offset;
+		const auto small = allocator.allocate(unit, 4, small_offset);
+		aligned &= small != tlsf::invalid_handle && small_offset % unit == 0;
+		if (small != tlsf::invalid_handle)
+			disjoint &= ranges.insert(small_offset, unit);
+	}
+	ctx.check(aligned, "Allocation offsets aren't aligned");
+	ctx.check(sized, "Allocation offsets or sizes don't match the request");
+	ctx.check(disjoint, "Allocations overlap");
+	ctx.check(allocator.validate(), "Invariants broken after aligned allocations");
+}
+
+void split_coalesce_test(tests::test_context &ctx) {
+	const auto total = 64 * unit;
+	tlsf allocator(total);
+
+	const auto report = [&]() { return allocator.fragmentation_report(); };
+	const auto free_blocks = [&]() { return report().free_blocks_count; };
+	const auto largest = [&]() { return static_cast<size_type>(report().largest_free_block); };
+
+	size_type a_offset, b_offset, c_offset;
+	const auto a = allocator.allocate(8 * unit, unit, a_offset);
+	const auto b = allocator.allocate(8 * unit, unit, b_offset);
+	const auto c = allocator.allocate(8 * unit, unit, c_offset);
+	ctx.check(a != tlsf::invalid_handle && b != tlsf::invalid_handle && c != tlsf::invalid_handle, "Allocation failed");
+	// Allocations split the tail of the single free block
+	ctx.check(a_offset == 0 && b_offset == 8 * unit && c_offset == 16 * unit, "Allocations aren't split off the head of the free range");
+	ctx.check(free_blocks() == 1 && largest() == total - 24 * unit, "Unexpected tail after splits");
+	ctx.check(allocator.get_allocated_size() == 24 * unit, "Unexpected allocated size");
+
+	// Freeing b, between two allocated blocks, can't coalesce
+	allocator.deallocate(b);
+	ctx.check(free_blocks() == 2 && allocator.validate(), "Freed block between allocations");
+	// Freeing a coalesces with b
+	allocator.deallocate(a);
+	ctx.check(free_blocks() == 2 && allocator.validate(), "Freed block isn't coalesced with its next neighbour");
+	// Freeing c coalesces with both neighbours
+	allocator.deallocate(c);
+	ctx.check(free_blocks() == 1 && largest() == total && allocator.get_allocated_size() == 0 && allocator.validate(),
+			  "Freed block isn't coalesced with both neighbours");
+
+	// The coalesced block fits the whole range again
+	size_type offset;
+	auto whole = allocator.allocate(total, unit, offset);
+	ctx.check(whole != tlsf::invalid_handle && offset == 0 && free_blocks() == 0, "Whole range can't be allocated after coalescing");
+	size_type more;
+	ctx.check(allocator.allocate(unit, unit, more) == tlsf::invalid_handle, "Allocated past the range");
+	allocator.deallocate(whole);
+
+	// Alignment padding is split back into the free lists and coalesced on deallocation
+	const auto head = allocator.allocate(unit, unit, offset);
+	const auto padded = allocator.allocate(8 * unit, 16 * unit, offset);
+	ctx.check(padded != tlsf::invalid_handle && offset == 16 * unit, "Aligned allocation isn't placed at the first aligned offset");
+	ctx.check(free_blocks() == 2 && allocator.validate(), "Alignment padding isn't split into a free block");
+	allocator.deallocate(head);
+	ctx.check(free_blocks() == 2 && largest() == total - 24 * unit && allocator.validate(), "Alignment padding isn't coalesced");
+	allocator.deallocate(padded);
+	ctx.check(free_blocks() == 1 && largest() == total && allocator.validate(), "Range isn't coalesced back into a single block");
+
+	// Requests that can't fit
+	ctx.check(allocator.allocate(total + unit, unit, offset) == tlsf::invalid_handle, "Allocated more than the range");
+	ctx.check(allocator.allocate(unit, ~static_cast<size_type>(0) / 2 + 1, offset) == tlsf::invalid_handle, "Allocated with an impossible alignment");
+}
+
+/**
+ *	@brief	Workload of allocations and deallocations, drawn up front so both allocators replay the same sequence
+ */
+struct workload_op {
+	// Allocation size, 0 for a deallocation
+	size_type size;
+	size_type alignment;
+	// Deallocation: Index of the live allocation, modulo the live count
+	std::uint32_t victim;
+};
+
+lib::vector<workload_op> create_workload(std::uint32_t ops, std::uint32_t target_live, std::uint32_t seed) {
+	std::mt19937 gen(seed);
+	lib::vector<workload_op> workload;
+	workload.reserve(ops);
+
+	std::uint32_t live = 0;
+	for (std::uint32_t i = 0; i < ops; ++i) {
+		const bool allocate = live == 0 || (live < target_live ? gen() % 4 != 0 : gen() % 2 == 0);
+		if (allocate) {
+			// Log-uniform sizes, from a single unit to 1024 units, and mostly small alignments
+			const auto size = static_cast<size_type>(std::exp2(std::uniform_real_distribution<double>(0, 10)(gen))) * unit;
+			const auto r = gen() % 16;
+			const auto alignment = r < 10 ? unit : r < 14 ? 8 * unit : 512 * unit;
+			workload.push_back({ size, alignment, 0 });
+			++live;
+		}
+		else {
+			workload.push_back({ 0, 0, static_cast<std::uint32_t>(gen()) });
+			--live;
+		}
+	}
+	return workload;
+}
+
+struct workload_result {
+	std::chrono::high_resolution_clock::duration elapsed{};
+	std::uint32_t failed{ 0 };
+	float max_fragmentation{ .0f };
+	bool disjoint{ true };
+	bool valid{ true };
+};
+
+/**
+ *	@brief	Replays a workload. Failed allocations are dropped, their deallocations free another live allocation.
+ *
+ *	@param	validate_every	Checks the allocator's invariants every that many operations, 0 to skip. Excluded from the timing.
+ */
+template <typename Allocator, typename Allocate, typename Deallocate>
+workload_result replay(Allocator &allocator,
+					   const lib::vector<workload_op> &workload,
+					   Allocate &&allocate,
+					   Deallocate &&deallocate,
+					   std::uint32_t validate_every,
+					   bool track_ranges) {
+	workload_result result;
+	live_ranges ranges;
+
+	// Live allocations: Offset and handle
+	lib::vector<std::pair<size_type, std::uint32_t>> live;
+	for (std::size_t i = 0; i < workload.size(); ++i) {
+		const auto &op = workload[i];
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		if (op.size) {
+			size_type offset;
+			std::uint32_t handle;
+			if (allocate(op.size, op.alignment, offset, handle)) {
+				live.push_back({ offset, handle });
+				result.elapsed += std::chrono::high_resolution_clock::now() - start;
+
+				if (track_ranges)
+					result.disjoint &= ranges.insert(offset, op.size) && offset % op.alignment == 0;
+			}
+			else {
+				result.elapsed += std::chrono::high_resolution_clock::now() - start;
+				++result.failed;
+				result.max_fragmentation = std::max(result.max_fragmentation, allocator.fragmentation_report().fragmentation());
+			}
+		}
+		else if (!live.empty()) {
+			const auto idx = op.victim % live.size();
+			const auto victim = live[idx];
+			live[idx] = live.back();
+			live.pop_back();
+
+			deallocate(victim.first, victim.second);
+			result.elapsed += std::chrono::high_resolution_clock::now() - start;
+
+			if (track_ranges)
+				ranges.erase(victim.first);
+		}
+
+		if (validate_every && i % validate_every == 0)
+			result.valid &= allocator.validate();
+	}
+
+	return result;
+}
+
+template <typename Allocator>
+workload_result replay_tlsf(Allocator &allocator, const lib::vector<workload_op> &workload, std::uint32_t validate_every, bool track_ranges) {
+	return replay(allocator, workload, [&](size_type size, size_type alignment, size_type &offset, std::uint32_t &handle) {
+		handle = allocator.allocate(size, alignment, offset);
+		return handle != tlsf::invalid_handle;
+	}, [&](size_type, std::uint32_t handle) {
+		allocator.deallocate(handle);
+	}, validate_every, track_ranges);
+}
+
+void random_sequence_test(tests::test_context &ctx) {
+	for (std::uint32_t seed = 0; seed < 4; ++seed) {
+		const auto total = 16 * 1024 * unit;
+		tlsf allocator(total);
+
+		// Small heap, allocations fail regularly
+		const auto workload = create_workload(20000, 256, seed);
+		const auto result = replay_tlsf(allocator, workload, 1, true);
+
+		std::ostringstream msg;
+		msg << "seed " << seed << ": ";
+		ctx.check(result.valid, msg.str() + "Invariants broken by a random sequence");
+		ctx.check(result.disjoint, msg.str() + "Allocations overlap or are misaligned");
+	}
+
+	// Allocating and freeing everything leaves a single free block
+	{
+		const auto total = 1024 * unit;
+		tlsf allocator(total);
+		lib::vector<tlsf::handle_type> handles;
+		std::mt19937 gen(7);
+		for (;;) {
+			size_type offset;
+			const auto h = allocator.allocate((1 + gen() % 8) * unit, unit << (gen() % 3), offset);
+			if (h == tlsf::invalid_handle)
+				break;
+			handles.push_back(h);
+		}
+		std::shuffle(handles.begin(), handles.end(), gen);
+		for (auto h : handles)
+			allocator.deallocate(h);
+
+		const auto report = allocator.fragmentation_report();
+		ctx.check(allocator.validate() && report.free_blocks_count == 1 && static_cast<size_type>(report.largest_free_block) == total,
+				  "Range isn't a single free block after freeing all allocations");
+	}
+}
+
+/**
+ *	@brief	Compares the TLSF allocator with the first-fit heap it replaced, on a workload with thousands of live allocations
+ */
+void first_fit_comparison(tests::test_context &ctx) {
+	const auto workload = create_workload(100000, 4000, 42);
+
+	// A heap large enough for the workload, and a smaller one where allocations fail
+	for (auto total : { 1024 * 1024 * unit, 384 * 1024 * unit }) {
+		tlsf tlsf_allocator(total);
+		const auto tlsf_result = replay_tlsf(tlsf_allocator, workload, 0, false);
+
+		first_fit_heap first_fit(total);
+		const auto first_fit_result = replay(first_fit, workload, [&](size_type size, size_type alignment, size_type &offset, std::uint32_t &) {
+			return first_fit.allocate(size, alignment, offset);
+		}, [&](size_type offset, std::uint32_t) {
+			first_fit.deallocate(offset);
+		}, 0, false);
+
+		ctx.check(tlsf_allocator.validate() && first_fit.validate(), "Invariants broken by the comparison workload");
+
+		const auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+		const auto tlsf_report = tlsf_allocator.fragmentation_report();
+		const auto first_fit_report = first_fit.fragmentation_report();
+		std::ostringstream msg;
+		msg << std::fixed << std::setprecision(2)
+			<< (total >> 20) << " MB heap, " << workload.size() << " operations: "
+			<< "TLSF " << ms(tlsf_result.elapsed) << " ms, " << tlsf_result.failed << " failed, "
+			<< tlsf_report.free_blocks_count << " free blocks, fragmentation " << tlsf_report.fragmentation()
+			<< " (max on failure " << tlsf_result.max_fragmentation << "); "
+			<< "first-fit " << ms(first_fit_result.elapsed) << " ms, " << first_fit_result.failed << " failed, "
+			<< first_fit_report.free_blocks_count << " free blocks, fragmentation " << first_fit_report.fragmentation()
+			<< " (max on failure " << first_fit_result.max_fragmentation << ")";
+		ctx.report(msg.str());
+	}
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void device_memory_tlsf_test(test_context &ctx) {
+	alignment_test(ctx);
+	split_coalesce_test(ctx);
+	random_sequence_test(ctx);
+	first_fit_comparison(ctx);
+}
+
+}
+}
@@ -0,0 +1,198 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <glyph_atlas_packer.hpp>
+
+#include <lib/vector.hpp>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::text;
+
+namespace {
+
+using benchmark_clock_t = std::chrono::high_resolution_clock;
+
+// Same as glyph_atlas
+constexpr std::uint32_t page_extent = 2048;
+constexpr std::uint32_t page_texel_bytes = 2;
+// Same as glyph::ttf_pixel_size and glyph::padding
+constexpr std::uint32_t glyph_pixel_size = 64;
+constexpr std::uint32_t glyph_padding = 16;
+
+struct placed_glyph {
+	std::uint32_t page;
+	glm::u32vec2 offset;
+	glm::u32vec2 extent;
+};
+
+/**
+ *	@brief	Glyph distance field extents at the glyph pixel size, padded like glyph_factory does.
+ *			A mix of latin glyphs, punctuation and CJK ideographs.
+ */
+lib::vector<glm::u32vec2> glyph_extents(std::size_t count, std::uint32_t seed) {
+	std::mt19937 gen(seed);
+	const auto px = glyph_pixel_size;
+
+	lib::vector<glm::u32vec2> extents(count);
+	for (auto &e : extents) {
+		glm::u32vec2 bitmap;
+		const auto kind = gen() % 10;
+		if (kind < 4) {
+			// Latin: Narrow, x-height to ascender+descender tall
+			bitmap = { px / 4 + gen() % (px / 2), px / 2 + gen() % (px / 2 + px / 4) };
+		}
+		else if (kind < 5) {
+			// Punctuation and diacritics
+			bitmap = { 4 + gen() % (px / 4), 4 + gen() % (px / 3) };
+		}
+		else {
+			// Ideographs: Close to square, nearly the full em
+			bitmap = { px - px / 8 + gen() % (px / 8), px - px / 8 + gen() % (px / 8) };
+		}
+		e = bitmap + glm::u32vec2(2 * glyph_padding);
+	}
+	return extents;
+}
+
+/**
+ *	@brief	Packs glyphs into pages, trying the most recent pages first and adding a page once a glyph fits in none,
+ *			as glyph_atlas does.
+ */
+lib::vector<placed_glyph> pack(const lib::vector<glm::u32vec2> &extents, lib::vector<glyph_atlas_packer> &pages) {
+	lib::vector<placed_glyph> placed;
+	placed.reserve(extents.size());
+
+	for (auto &extent : extents) {
+		placed_glyph g;
+		g.extent = extent;
+
+		bool found = false;
+		for (auto i = pages.size(); i-- > 0 && !found;) {
+			if (auto offset = pages[i].insert(extent)) {
+				g.page = static_cast<std::uint32_t>(i);
+				g.offset = offset.get();
+				found = true;
+			}
+		}
+		if (!found) {
+			pages.emplace_back(glm::u32vec2{ page_extent, page_extent });
+			g.page = static_cast<std::uint32_t>(pages.size() - 1);
+			g.offset = pages.back().insert(extent).get();
+		}
+
+		placed.push_back(g);
+	}
+
+	return placed;
+}
+
+bool overlap(const placed_glyph &a, const placed_glyph &b) {
+	return a.page == b.page &&
+		a.offset.x < b.offset.x + b.extent.x && b.offset.x < a.offset.x + a.extent.x &&
+		a.offset.y < b.offset.y + b.extent.y && b.offset.y < a.offset.y + a.extent.y;
+}
+
+void validate(tests::test_context &ctx, const lib::vector<placed_glyph> &placed, const lib::vector<glyph_atlas_packer> &pages) {
+	bool in_bounds = true;
+	lib::vector<std::uint64_t> area(pages.size(), 0);
+	lib::vector<lib::vector<const placed_glyph*>> per_page(pages.size());
+	for (auto &g : placed) {
+		in_bounds &= g.offset.x + g.extent.x <= page_extent && g.offset.y + g.extent.y <= page_extent;
+		area[g.page] += static_cast<std::uint64_t>(g.extent.x) * g.extent.y;
+		per_page[g.page].push_back(&g);
+	}
+	ctx.check(in_bounds, "Glyphs outside of their page");
+
+	bool disjoint = true;
+	for (auto &p : per_page)
+		for (std::size_t i = 0; i < p.size() && disjoint; ++i)
+			for (std::size_t j = i + 1; j < p.size() && disjoint; ++j)
+				disjoint = !overlap(*p[i], *p[j]);
+	ctx.check(disjoint, "Glyphs overlap");
+
+	bool occupancy = true;
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		const auto expected = static_cast<float>(area[i]) / (static_cast<float>(page_extent) * page_extent);
+		occupancy &= glm::abs(pages[i].occupancy() - expected) < 1e-5f;
+	}
+	ctx.check(occupancy, "Page occupancy doesn't match the packed glyphs");
+}
+
+void packer_test(tests::test_context &ctx) {
+	glyph_atlas_packer packer({ 256, 256 });
+
+	ctx.check(!packer.insert({ 257, 1 }) && !packer.insert({ 1, 257 }), "Rectangle larger than the page was packed");
+	ctx.check(!!packer.insert({ 256, 256 }), "Failed packing a rectangle the size of the page");
+	ctx.check(!packer.insert({ 1, 1 }), "Packed into a full page");
+
+	// Equal rectangles tile a page completely
+	glyph_atlas_packer tiles({ 256, 256 });
+	int count = 0;
+	while (tiles.insert({ 32, 32 }))
+		++count;
+	ctx.check(count == 64 && tiles.occupancy() == 1.f, "Equal rectangles didn't tile the page");
+
+	// Short rectangles don't go on a much taller shelf while there's room for a new shelf
+	glyph_atlas_packer shelves({ 256, 256 });
+	shelves.insert({ 16, 64 });
+	const auto short_offset = shelves.insert({ 16, 8 });
+	ctx.check(short_offset && short_offset.get().y == 64, "Short rectangle placed on a tall shelf");
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void glyph_atlas_packer_test(test_context &ctx) {
+	packer_test(ctx);
+
+	// 5k codepoints
+	constexpr std::size_t count = 5000;
+	const auto extents = glyph_extents(count, 11);
+
+	lib::vector<glyph_atlas_packer> pages;
+	const auto start = benchmark_clock_t::now();
+	const auto placed = pack(extents, pages);
+	const auto ms = std::chrono::duration<double, std::milli>(benchmark_clock_t::now() - start).count();
+
+	validate(ctx, placed, pages);
+
+	std::uint64_t glyphs_area = 0;
+	for (auto &e : extents)
+		glyphs_area += static_cast<std::uint64_t>(e.x) * e.y;
+	const auto pages_area = static_cast<std::uint64_t>(page_extent) * page_extent * pages.size();
+	const auto occupancy = static_cast<double>(glyphs_area) / static_cast<double>(pages_area);
+
+	// Every page but the last, which is still being filled, is well utilized
+	float full_pages_occupancy = 0;
+	for (std::size_t i = 0; i + 1 < pages.size(); ++i)
+		full_pages_occupancy += pages[i].occupancy();
+	full_pages_occupancy /= static_cast<float>(pages.size() - 1);
+
+	std::ostringstream occupancy_msg;
+	occupancy_msg << "Low atlas occupancy, " << full_pages_occupancy << " over " << pages.size() - 1 << " full pages";
+	ctx.check(pages.size() >= 2 && full_pages_occupancy > .75f, occupancy_msg.str());
+
+	// A glyph per r32_sfloat texture, as glyph_manager did before the atlas, versus r16_sfloat pages
+	const auto per_glyph_bytes = glyphs_area * 4;
+	const auto atlas_bytes = pages_area * page_texel_bytes;
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(2)
+		<< count << " glyphs packed in " << ms << " ms into " << pages.size() << " pages, occupancy " << occupancy
+		<< " (full pages " << full_pages_occupancy << ")"
+		<< ", " << atlas_bytes / (1024 * 1024) << " MB (per-glyph textures: " << count << " textures, "
+		<< per_glyph_bytes / (1024 * 1024) << " MB)";
+	ctx.report(msg.str());
+}
+
+}
+}
@@ -0,0 +1,197 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <glyph_distance_transform.hpp>
+#include "edtaa3func.hpp"
+
+#include <lib/vector.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::text;
+
+namespace {
+
+using benchmark_clock_t = std::chrono::high_resolution_clock;
+
+struct image {
+	std::uint32_t width, height;
+	lib::vector<std::uint8_t> coverage;
+	// Analytic signed distance, positive outside
+	lib::vector<double> distance;
+};
+
+/**
+ *	@brief	Anti-aliased disc, coverage supersampled 16x16 per pixel. Pixel (x,y) is centered at (x,y).
+ */
+image disc(std::uint32_t width, std::uint32_t height, glm::dvec2 center, double radius) {
+	constexpr int ss = 16;
+
+	image img;
+	img.width = width;
+	img.height = height;
+	img.coverage.resize(width * height);
+	img.distance.resize(width * height);
+	for (std::uint32_t y = 0; y < height; ++y) {
+		for (std::uint32_t x = 0; x < width; ++x) {
+			int covered = 0;
+			for (int sy = 0; sy < ss; ++sy) {
+				for (int sx = 0; sx < ss; ++sx) {
+					const glm::dvec2 p = { x - .5 + (sx + .5) / ss, y - .5 + (sy + .5) / ss };
+					covered += glm::length(p - center) <= radius ? 1 : 0;
+				}
+			}
+
+			const auto i = y * width + x;
+			img.coverage[i] = static_cast<std::uint8_t>((covered * 255 + ss * ss / 2) / (ss * ss));
+			img.distance[i] = glm::length(glm::dvec2(x, y) - center) - radius;
+		}
+	}
+	return img;
+}
+
+/**
+ *	@brief	Double precision edtaa3 signed distance field, as glyph_factory generated before glyph_distance_transform
+ */
+void edtaa3_distance_map(const std::uint8_t *img, std::uint32_t width, std::uint32_t height, float *out) {
+	const auto size = static_cast<std::size_t>(width) * height;
+	const int w = static_cast<int>(width);
+	const int h = static_cast<int>(height);
+
+	lib::vector<short> xdist(size), ydist(size);
+	lib::vector<double> gx(size, .0), gy(size, .0), data(size), outside(size), inside(size);
+
+	for (std::size_t i = 0; i < size; ++i)
+		data[i] = static_cast<double>(img[i]) / 255.0;
+
+	// Background
+	computegradient(data.data(), w, h, gx.data(), gy.data());
+	edtaa3(data.data(), gx.data(), gy.data(), w, h, xdist.data(), ydist.data(), outside.data());
+
+	// Foreground
+	std::fill(gx.begin(), gx.end(), .0);
+	std::fill(gy.begin(), gy.end(), .0);
+	for (auto &d : data)
+		d = 1.0 - d;
+	computegradient(data.data(), w, h, gx.data(), gy.data());
+	edtaa3(data.data(), gx.data(), gy.data(), w, h, xdist.data(), ydist.data(), inside.data());
+
+	for (std::size_t i = 0; i < size; ++i)
+		out[i] = static_cast<float>(std::max(.0, outside[i]) - std::max(.0, inside[i]));
+}
+
+/**
+ *	@brief	Absolute error against the analytic distance, accumulated per band of distances from the edge
+ */
+struct error_bands {
+	static constexpr int bands_count = 3;
+	static constexpr double bands[bands_count + 1] = { .0, 1.0, 3.0, 8.0 };
+
+	double sum[bands_count] = {};
+	double max[bands_count] = {};
+	std::size_t count[bands_count] = {};
+	bool sign{ true };
+
+	void add(const image &img, const float *sdf) {
+		for (std::size_t i = 0; i < img.distance.size(); ++i) {
+			const auto d = img.distance[i];
+			const auto err = glm::abs(static_cast<double>(sdf[i]) - d);
+			if (glm::abs(d) > .5)
+				sign &= (sdf[i] > 0) == (d > 0);
+
+			for (int b = 0; b < bands_count; ++b) {
+				if (glm::abs(d) >= bands[b] && glm::abs(d) < bands[b + 1]) {
+					sum[b] += err;
+					max[b] = std::max(max[b], err);
+					++count[b];
+				}
+			}
+		}
+	}
+
+	double mean(int b) const { return count[b] ? sum[b] / static_cast<double>(count[b]) : .0; }
+};
+constexpr double error_bands::bands[];
+
+void accuracy_test(tests::test_context &ctx) {
+	error_bands transform_errors, reference_errors;
+	glyph_distance_transform_scratch scratch;
+
+	for (int r = 10; r < 20; ++r) {
+		const auto img = disc(64, 72, { 31.3 + .07 * r, 35.6 - .05 * r }, static_cast<double>(r) + .1 * (r % 5));
+
+		lib::vector<float> sdf(img.coverage.size());
+		glyph_distance_transform::transform(img.coverage.data(), img.width, img.height, sdf.data(), scratch);
+		transform_errors.add(img, sdf.data());
+
+		edtaa3_distance_map(img.coverage.data(), img.width, img.height, sdf.data());
+		reference_errors.add(img, sdf.data());
+	}
+
+	ctx.check(transform_errors.sign, "Distance field sign doesn't match the disc");
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(3) << "mean / max error, transform vs edtaa3:";
+	for (int b = 0; b < error_bands::bands_count; ++b) {
+		const auto mean = transform_errors.mean(b);
+		const auto reference_mean = reference_errors.mean(b);
+
+		std::ostringstream band;
+		band << std::fixed << std::setprecision(3) << error_bands::bands[b] << "-" << error_bands::bands[b + 1] << "px";
+		msg << " " << band.str() << " " << mean << " / " << transform_errors.max[b] << " vs " << reference_mean << " / "
+			<< reference_errors.max[b] << ";";
+
+		// Not meaningfully less accurate than edtaa3
+		ctx.check(mean <= reference_mean * 1.5 + .005, band.str() + ": Mean error larger than edtaa3's");
+		ctx.check(transform_errors.max[b] <= reference_errors.max[b] * 1.5 + .02, band.str() + ": Max error larger than edtaa3's");
+	}
+	ctx.report(msg.str());
+}
+
+/**
+ *	@brief	Throughput on a glyph sized bitmap: A 64px glyph with 16 pixels of padding
+ */
+void throughput_benchmark(tests::test_context &ctx) {
+	const auto img = disc(96, 110, { 47.3, 54.8 }, 30.2);
+	lib::vector<float> sdf(img.coverage.size());
+
+	constexpr int transform_iterations = 400;
+	constexpr int reference_iterations = 40;
+
+	glyph_distance_transform_scratch scratch;
+	auto start = benchmark_clock_t::now();
+	for (int i = 0; i < transform_iterations; ++i)
+		glyph_distance_transform::transform(img.coverage.data(), img.width, img.height, sdf.data(), scratch);
+	const auto transform_s = std::chrono::duration<double>(benchmark_clock_t::now() - start).count();
+
+	start = benchmark_clock_t::now();
+	for (int i = 0; i < reference_iterations; ++i)
+		edtaa3_distance_map(img.coverage.data(), img.width, img.height, sdf.data());
+	const auto reference_s = std::chrono::duration<double>(benchmark_clock_t::now() - start).count();
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(0)
+		<< img.width << "x" << img.height << " glyph: transform " << transform_iterations / transform_s
+		<< " glyphs/s, edtaa3 " << reference_iterations / reference_s << " glyphs/s";
+	ctx.report(msg.str());
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void glyph_distance_transform_test(test_context &ctx) {
+	accuracy_test(ctx);
+	throughput_benchmark(ctx);
+}
+
+}
+}
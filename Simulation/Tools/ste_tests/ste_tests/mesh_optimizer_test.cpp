@@ -0,0 +1,257 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::graphics;
+
+namespace {
+
+using triangle = std::array<std::uint32_t, 3>;
+
+struct test_mesh {
+	std::string name;
+	lib::vector<std::uint32_t> indices;
+	lib::vector<object_vertex_data> vertices;
+};
+
+/**
+ *	@brief	Creates vertices, the vertex id is stored in the uv's x component.
+ */
+lib::vector<object_vertex_data> create_vertices(std::uint32_t count, const std::function<glm::vec3(std::uint32_t)> &position) {
+	lib::vector<object_vertex_data> vertices(count);
+	for (std::uint32_t i = 0; i < count; ++i) {
+		const auto p = position(i);
+		vertices[i].p() = { metre(p.x), metre(p.y), metre(p.z) };
+		vertices[i].uv() = { static_cast<float>(i), .0f };
+	}
+	return vertices;
+}
+std::uint32_t vertex_id(const object_vertex_data &v) {
+	return static_cast<std::uint32_t>(v.uv().x);
+}
+
+/**
+ *	@brief	A grid of n*n quads, triangles in row-major order
+ */
+test_mesh grid_mesh(std::uint32_t n) {
+	test_mesh mesh;
+	mesh.name = "grid " + std::to_string(n) + "x" + std::to_string(n);
+	mesh.vertices = create_vertices((n + 1) * (n + 1), [n](std::uint32_t i) {
+		return glm::vec3{ static_cast<float>(i % (n + 1)), static_cast<float>(i / (n + 1)), .0f };
+	});
+	for (std::uint32_t y = 0; y < n; ++y) {
+		for (std::uint32_t x = 0; x < n; ++x) {
+			const auto v = y * (n + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { v, v + 1, v + n + 1 });
+			mesh.indices.insert(mesh.indices.end(), { v + 1, v + n + 2, v + n + 1 });
+		}
+	}
+	return mesh;
+}
+
+/**
+ *	@brief	Shuffles the triangles of a mesh. Fisher-Yates over std::mt19937, independent of the standard library.
+ */
+test_mesh shuffled(test_mesh mesh, std::uint32_t seed) {
+	std::mt19937 gen(seed);
+	const auto count = static_cast<std::uint32_t>(mesh.indices.size() / 3);
+	for (auto i = count; i > 1; --i) {
+		const auto j = static_cast<std::uint32_t>(gen() % i);
+		for (int k = 0; k < 3; ++k)
+			std::swap(mesh.indices[3 * (i - 1) + k], mesh.indices[3 * j + k]);
+	}
+	mesh.name = "shuffled " + mesh.name;
+	return mesh;
+}
+
+/**
+ *	@brief	A sphere, triangles in latitude-major order. Poles are fans.
+ */
+test_mesh sphere_mesh(std::uint32_t rings, std::uint32_t segments) {
+	test_mesh mesh;
+	mesh.name = "sphere";
+	const auto pi = glm::pi<float>();
+	mesh.vertices = create_vertices(2 + (rings - 1) * segments, [=](std::uint32_t i) {
+		if (i == 0)
+			return glm::vec3{ 0, 0, 1 };
+		if (i == 1)
+			return glm::vec3{ 0, 0, -1 };
+		const auto r = (i - 2) / segments + 1;
+		const auto s = (i - 2) % segments;
+		const auto theta = pi * static_cast<float>(r) / static_cast<float>(rings);
+		const auto phi = 2.f * pi * static_cast<float>(s) / static_cast<float>(segments);
+		return glm::vec3{ glm::sin(theta) * glm::cos(phi), glm::sin(theta) * glm::sin(phi), glm::cos(theta) };
+	});
+
+	const auto ring_vertex = [=](std::uint32_t r, std::uint32_t s) { return 2 + (r - 1) * segments + s % segments; };
+	for (std::uint32_t s = 0; s < segments; ++s)
+		mesh.indices.insert(mesh.indices.end(), { 0, ring_vertex(1, s), ring_vertex(1, s + 1) });
+	for (std::uint32_t r = 1; r + 1 < rings; ++r) {
+		for (std::uint32_t s = 0; s < segments; ++s) {
+			mesh.indices.insert(mesh.indices.end(), { ring_vertex(r, s), ring_vertex(r + 1, s), ring_vertex(r + 1, s + 1) });
+			mesh.indices.insert(mesh.indices.end(), { ring_vertex(r, s), ring_vertex(r + 1, s + 1), ring_vertex(r, s + 1) });
+		}
+	}
+	for (std::uint32_t s = 0; s < segments; ++s)
+		mesh.indices.insert(mesh.indices.end(), { 1, ring_vertex(rings - 1, s + 1), ring_vertex(rings - 1, s) });
+
+	return mesh;
+}
+
+/**
+ *	@brief	Random triangles over a vertex pool, with unreferenced and degenerate vertices
+ */
+test_mesh random_mesh(std::uint32_t vertex_count, std::uint32_t triangles_count, std::uint32_t seed) {
+	test_mesh mesh;
+	mesh.name = "random";
+	std::mt19937 gen(seed);
+	mesh.vertices = create_vertices(vertex_count, [&](std::uint32_t) {
+		return glm::vec3{ static_cast<float>(gen() % 1000), static_cast<float>(gen() % 1000), static_cast<float>(gen() % 1000) };
+	});
+	// Only the first half of the vertices are referenced
+	for (std::uint32_t t = 0; t < triangles_count; ++t)
+		for (int k = 0; k < 3; ++k)
+			mesh.indices.push_back(static_cast<std::uint32_t>(gen() % (vertex_count / 2)));
+	return mesh;
+}
+
+lib::vector<triangle> sorted_triangles(const lib::vector<std::uint32_t> &indices) {
+	lib::vector<triangle> triangles;
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+		triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+float acmr(const lib::vector<std::uint32_t> &indices, const lib::vector<object_vertex_data> &vertices, std::uint32_t cache_size) {
+	return mesh_optimizer::analyze_vertex_cache(indices, static_cast<std::uint32_t>(vertices.size()), cache_size).acmr();
+}
+
+void vertex_cache_test(tests::test_context &ctx, const test_mesh &mesh, std::uint32_t cache_size, bool overdraw) {
+	std::ostringstream name;
+	name << mesh.name << ", cache size " << cache_size << (overdraw ? ", overdraw" : "");
+
+	auto indices = mesh.indices;
+	mesh_optimizer::optimize_vertex_cache(indices, mesh.vertices, cache_size, overdraw);
+
+	// Triangles, along with their winding, are only reordered
+	ctx.check(sorted_triangles(indices) == sorted_triangles(mesh.indices),
+			  name.str() + ": Output isn't a permutation of the input triangles");
+
+	// Deterministic
+	auto again = mesh.indices;
+	mesh_optimizer::optimize_vertex_cache(again, mesh.vertices, cache_size, overdraw);
+	ctx.check(again == indices, name.str() + ": Output isn't deterministic");
+
+	// Sorting clusters for overdraw gives up on some of the locality, between clusters
+	if (!overdraw) {
+		const auto before = acmr(mesh.indices, mesh.vertices, cache_size);
+		const auto after = acmr(indices, mesh.vertices, cache_size);
+		std::ostringstream msg;
+		msg << name.str() << ": ACMR increased from " << before << " to " << after;
+		ctx.check(after <= before, msg.str());
+	}
+}
+
+void vertex_fetch_test(tests::test_context &ctx, const test_mesh &mesh) {
+	auto indices = mesh.indices;
+	auto vertices = mesh.vertices;
+	mesh_optimizer::optimize_vertex_fetch(indices, vertices);
+
+	const auto name = mesh.name + ": ";
+
+	// Remap is a bijection between the referenced input vertices and the output vertices
+	lib::vector<std::uint32_t> referenced;
+	for (auto i : mesh.indices)
+		referenced.push_back(i);
+	std::sort(referenced.begin(), referenced.end());
+	referenced.erase(std::unique(referenced.begin(), referenced.end()), referenced.end());
+
+	lib::vector<std::uint32_t> ids;
+	for (auto &v : vertices)
+		ids.push_back(vertex_id(v));
+	std::sort(ids.begin(), ids.end());
+	ctx.check(ids == referenced, name + "Output vertices aren't the referenced input vertices, each once");
+
+	// Indices refer to the same vertices
+	bool same = indices.size() == mesh.indices.size();
+	for (std::size_t i = 0; same && i < indices.size(); ++i)
+		same = indices[i] < vertices.size() && vertex_id(vertices[indices[i]]) == mesh.indices[i];
+	ctx.check(same, name + "Remapped indices don't refer to the input vertices");
+
+	// Vertices are ordered by first use
+	std::uint32_t next = 0;
+	bool first_use = true;
+	for (auto i : indices) {
+		if (i == next)
+			++next;
+		else
+			first_use &= i < next;
+	}
+	ctx.check(first_use && next == vertices.size(), name + "Vertices aren't ordered by first use");
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void mesh_optimizer_test(test_context &ctx) {
+	const auto grid = grid_mesh(64);
+	const lib::vector<test_mesh> meshes = {
+		grid,
+		shuffled(grid, 1),
+		sphere_mesh(32, 48),
+		shuffled(sphere_mesh(32, 48), 2),
+		random_mesh(1024, 4096, 3),
+		grid_mesh(1),
+	};
+
+	for (auto &mesh : meshes) {
+		for (auto cache_size : { 8u, 16u, 32u }) {
+			vertex_cache_test(ctx, mesh, cache_size, false);
+			vertex_cache_test(ctx, mesh, cache_size, true);
+		}
+		vertex_fetch_test(ctx, mesh);
+	}
+
+	// On a grid, Tipsify clearly improves on the row-major order, which reloads every row's vertices
+	for (auto &mesh : { grid, shuffled(grid, 1) }) {
+		auto indices = mesh.indices;
+		mesh_optimizer::optimize_vertex_cache(indices, mesh.vertices);
+
+		const auto before = acmr(mesh.indices, mesh.vertices, mesh_optimizer::default_cache_size);
+		const auto after = acmr(indices, mesh.vertices, mesh_optimizer::default_cache_size);
+		std::ostringstream msg;
+		msg << mesh.name << ": Expected ACMR to drop, from " << before << " to " << after;
+		ctx.check(after < before * .9f && after < .8f, msg.str());
+	}
+
+	// Statistics of optimize() match the passes'
+	{
+		auto indices = grid.indices;
+		auto vertices = grid.vertices;
+		mesh_optimizer::statistics before, after;
+		mesh_optimizer::optimize(indices, vertices, mesh_optimizer::options(), &before, &after);
+
+		ctx.check(before.triangles == after.triangles && before.vertices == after.vertices && after.vertices == vertices.size(),
+				  "optimize() statistics don't count the mesh's triangles and vertices");
+		ctx.check(after.cache_misses == mesh_optimizer::analyze_vertex_cache(indices, static_cast<std::uint32_t>(vertices.size())).cache_misses &&
+				  after.cache_misses < before.cache_misses,
+				  "optimize() statistics don't match the output mesh");
+	}
+}
+
+}
+}
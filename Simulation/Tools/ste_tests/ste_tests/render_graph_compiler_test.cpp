@@ -0,0 +1,530 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <render_graph_compiler.hpp>
+#include <primary_renderer_graph.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+using namespace ste;
+using namespace ste::gl;
+
+namespace {
+
+using compiler = render_graph_compiler;
+
+constexpr auto no_stages = static_cast<pipeline_stage>(0);
+constexpr auto write_access_mask = access_flags::shader_write |
+	access_flags::color_attachment_write |
+	access_flags::depth_stencil_attachment_write |
+	access_flags::transfer_write |
+	access_flags::host_write |
+	access_flags::memory_write;
+
+bool contains(pipeline_stage set, pipeline_stage stages) {
+	return (set & stages) == stages;
+}
+bool contains(access_flags set, access_flags access) {
+	return (set & access) == access;
+}
+
+compiler::usage read(std::uint32_t resource, pipeline_stage stages, access_flags access, image_layout layout = image_layout::undefined) {
+	return { resource, stages, access, layout, false };
+}
+compiler::usage write(std::uint32_t resource, pipeline_stage stages, access_flags access, image_layout layout = image_layout::undefined) {
+	return { resource, stages, access, layout, true };
+}
+
+/*
+ *	primary_renderer's render graph, as declared by primary_renderer_graph
+ */
+
+using primary = graphics::primary_renderer_graph;
+
+lib::vector<compiler::pass> primary_renderer_passes(const primary::frame_state &frame) {
+	lib::vector<compiler::pass> passes;
+	for (auto &d : primary::declare(frame))
+		passes.push_back(d.usages);
+	return passes;
+}
+
+/**
+ *	@brief	Replays compiled plans and checks that every hazard between the passes' usages is synchronized, following
+ *			Vulkan's execution and memory dependency rules.
+ *
+ *	Usages are replayed in plan order, preceded by their pass's barriers. The replay carries over between plans, passes
+ *	of previous plans precede all of the current plan's passes.
+ *	A write must be made visible, by a barrier recorded after it or by a barrier chained to such a barrier, to the stages
+ *	and access of a following read. A write (or a layout transition) must be ordered, by a barrier recorded after them,
+ *	after the reads since the last write, or after the last write if there were none. Hazards between usages of a single pass are the pass's own responsibility.
+ */
+class plan_validator {
+private:
+	struct access_record {
+		std::uint64_t pass;
+		pipeline_stage stages;
+		access_flags access;
+		bool ordered;
+	};
+	struct tracked_resource {
+		bool written{ false };
+		access_record last_write;
+		pipeline_stage visible_stages{ no_stages };
+		access_flags visible_access{ access_flags::none };
+		lib::vector<access_record> reads;
+
+		bool layout_known{ false };
+		image_layout layout{ image_layout::undefined };
+	};
+
+	tests::test_context &ctx;
+	const char * const *resource_names;
+	const char * const *pass_names;
+
+	lib::vector<tracked_resource> resources;
+	// Global index of the first pass of the plan being replayed
+	std::uint64_t plan_base{ 0 };
+
+private:
+	std::string where(const compiler::compiled_pass &cp, std::uint32_t resource) const {
+		std::ostringstream ss;
+		ss << "pass '" << pass_names[cp.pass] << "', resource '" << resource_names[resource] << "'";
+		return ss.str();
+	}
+
+	/**
+	 *	@brief	A barrier's first synchronization scope. Pipeline barriers order all the preceding passes' commands, event
+	 *			waits only the commands that precede the set events.
+	 */
+	struct barrier_scope {
+		pipeline_stage src_stages;
+		// Global index of the last pass in the scope, and the stages of its scope
+		lib::vector<std::pair<std::uint64_t, pipeline_stage>> scope;
+
+		bool orders(const access_record &a) const {
+			if (!contains(src_stages, a.stages))
+				return false;
+			auto stages = no_stages;
+			for (auto &s : scope)
+				if (a.pass <= s.first)
+					stages = stages | s.second;
+			return contains(stages, a.stages);
+		}
+	};
+
+	void apply_barrier(const compiler::compiled_pass &cp, const compiler::barrier &b, const barrier_scope &scope, std::uint64_t pass) {
+		auto &r = resources[b.resource];
+		const auto w = where(cp, b.resource);
+
+		ctx.check(contains(scope.src_stages, b.src_stages), "Barrier's source stages aren't in its batch's at " + w);
+		if (r.layout_known)
+			ctx.check(b.old_layout == r.layout, "Barrier transitions from the wrong layout at " + w);
+
+		barrier_scope s = scope;
+		s.src_stages = b.src_stages & scope.src_stages;
+
+		// A barrier that orders reads the last write was made visible to, is chained to the barrier that made the write
+		// available. The write is visible to the barrier's destination as well.
+		bool chained = false;
+		for (auto &rd : r.reads) {
+			if (rd.pass < pass && s.orders(rd)) {
+				rd.ordered = true;
+				chained |= r.last_write.ordered && contains(r.visible_stages, rd.stages);
+			}
+		}
+		if (r.written && r.last_write.pass < pass &&
+			(chained || (s.orders(r.last_write) && contains(b.src_access, r.last_write.access)))) {
+			r.last_write.ordered = true;
+			r.visible_stages = r.visible_stages | b.dst_stages;
+			r.visible_access = r.visible_access | b.dst_access;
+		}
+
+		if (b.old_layout != b.new_layout) {
+			// Layout transitions write the image
+			check_write_ordered(cp, b.resource, pass);
+
+			r.written = true;
+			r.last_write = { pass, b.dst_stages, access_flags::none, false };
+			r.visible_stages = b.dst_stages;
+			r.visible_access = b.dst_access;
+			r.reads.clear();
+		}
+		r.layout_known = true;
+		r.layout = b.new_layout;
+	}
+
+	void check_write_ordered(const compiler::compiled_pass &cp, std::uint32_t resource, std::uint64_t pass) {
+		auto &r = resources[resource];
+
+		bool has_reads = false;
+		bool ordered = true;
+		for (auto &rd : r.reads) {
+			if (rd.pass == pass)
+				continue;
+			has_reads = true;
+			ordered &= rd.ordered;
+		}
+		if (!has_reads && r.written && r.last_write.pass != pass)
+			ordered = r.last_write.ordered;
+
+		ctx.check(ordered, "Unsynchronized write at " + where(cp, resource));
+	}
+
+	void apply_usage(const compiler::compiled_pass &cp, const compiler::usage &u, std::uint64_t pass) {
+		auto &r = resources[u.resource];
+		const auto w = where(cp, u.resource);
+
+		if (u.layout != image_layout::undefined) {
+			ctx.check(r.layout_known && r.layout == u.layout, "Image in the wrong layout at " + w);
+			r.layout_known = true;
+			r.layout = u.layout;
+		}
+
+		const auto write_access = u.access & write_access_mask;
+		const auto read_access = u.access ^ write_access;
+
+		if (read_access != access_flags::none) {
+			if (r.written && r.last_write.pass != pass) {
+				ctx.check(contains(r.visible_stages, u.stages) && contains(r.visible_access, read_access),
+						  "Read of a write that wasn't made visible at " + w);
+			}
+			r.reads.push_back({ pass, u.stages, read_access, false });
+		}
+
+		if (u.write || write_access != access_flags::none) {
+			check_write_ordered(cp, u.resource, pass);
+
+			r.written = true;
+			r.last_write = { pass, u.stages, write_access, false };
+			r.visible_stages = no_stages;
+			r.visible_access = access_flags::none;
+			r.reads.clear();
+		}
+	}
+
+public:
+	plan_validator(tests::test_context &ctx,
+				   std::size_t resources_count,
+				   const char * const *resource_names,
+				   const char * const *pass_names)
+		: ctx(ctx), resource_names(resource_names), pass_names(pass_names), resources(resources_count)
+	{}
+
+	void validate(const lib::vector<compiler::pass> &passes, const compiler::plan &plan) {
+		// Events
+		lib::vector<std::uint32_t> signaled_by(plan.events_count, compiler::invalid_index);
+		lib::vector<pipeline_stage> signal_stages(plan.events_count, no_stages);
+		lib::vector<bool> waited(plan.events_count, false);
+
+		for (std::uint32_t i = 0; i < plan.passes.size(); ++i) {
+			for (auto &s : plan.passes[i].signals) {
+				if (!ctx.check(s.event < plan.events_count, "Signaled event out of range"))
+					continue;
+				ctx.check(signaled_by[s.event] == compiler::invalid_index, "Event signaled more than once");
+				ctx.check(s.stages != no_stages, "Event signaled with no stages");
+				signaled_by[s.event] = i;
+				signal_stages[s.event] = s.stages;
+			}
+		}
+
+		for (std::uint32_t i = 0; i < plan.passes.size(); ++i) {
+			const auto &cp = plan.passes[i];
+			const auto pass = plan_base + i;
+
+			ctx.check(cp.pass < passes.size() && passes[cp.pass].enabled,
+					  "Disabled pass in plan");
+			ctx.check(i == 0 || plan.passes[i - 1].pass < cp.pass,
+					  "Plan isn't in submission order");
+			ctx.check(cp.wait_events.empty() == cp.wait_barrier.empty(),
+					  std::string("Events waited without a barrier, or vice versa, at pass '") + pass_names[cp.pass] + "'");
+
+			// Event wait. The wait's first synchronization scope is limited to the commands preceding the set events.
+			barrier_scope wait_scope = { cp.wait_barrier.src_stages, {} };
+			for (auto e : cp.wait_events) {
+				if (!ctx.check(e < plan.events_count && signaled_by[e] != compiler::invalid_index,
+							   std::string("Waiting on an event that is never set at pass '") + pass_names[cp.pass] + "'"))
+					continue;
+				// Split barriers are for producers that do not immediately precede the consumer
+				ctx.check(signaled_by[e] + 1 < i,
+						  std::string("Waiting on an event set by a preceding pass, or a succeeding one, at pass '") + pass_names[cp.pass] + "'");
+				ctx.check(!waited[e], "Event waited upon more than once");
+				waited[e] = true;
+
+				wait_scope.scope.emplace_back(plan_base + signaled_by[e], signal_stages[e]);
+			}
+			for (auto &b : cp.wait_barrier.barriers)
+				apply_barrier(cp, b, wait_scope, pass);
+
+			const barrier_scope pipeline_scope = { cp.barrier.src_stages, { { pass, cp.barrier.src_stages } } };
+			for (auto &b : cp.barrier.barriers)
+				apply_barrier(cp, b, pipeline_scope, pass);
+
+			for (auto &u : passes[cp.pass].usages)
+				apply_usage(cp, u, pass);
+		}
+
+		for (std::uint32_t e = 0; e < plan.events_count; ++e)
+			ctx.check(waited[e], "Event is set but never waited upon");
+
+		plan_base += plan.passes.size();
+	}
+};
+
+/*
+ *	Plan queries
+ */
+
+const compiler::compiled_pass *find_pass(const compiler::plan &plan, std::uint32_t pass) {
+	for (auto &cp : plan.passes)
+		if (cp.pass == pass)
+			return &cp;
+	return nullptr;
+}
+const compiler::barrier *find_barrier(const compiler::barrier_batch &batch, std::uint32_t resource) {
+	for (auto &b : batch.barriers)
+		if (b.resource == resource)
+			return &b;
+	return nullptr;
+}
+bool has_barriers(const compiler::plan &plan, std::uint32_t resource) {
+	for (auto &cp : plan.passes)
+		if (find_barrier(cp.barrier, resource) || find_barrier(cp.wait_barrier, resource))
+			return true;
+	return false;
+}
+
+/**
+ *	@brief	Checks that the wait barrier of pass 'consumer' synchronizes 'resource' with an event set by pass 'producer'
+ */
+const compiler::barrier *check_split_barrier(tests::test_context &ctx,
+											 const compiler::plan &plan,
+											 std::uint32_t producer,
+											 std::uint32_t consumer,
+											 std::uint32_t resource,
+											 const char * const *resource_names,
+											 const char * const *pass_names) {
+	std::ostringstream msg;
+	msg << "Expected '" << pass_names[consumer] << "' to wait on an event set by '" << pass_names[producer]
+		<< "' for '" << resource_names[resource] << "'";
+
+	const auto *p = find_pass(plan, producer);
+	const auto *c = find_pass(plan, consumer);
+	if (!ctx.check(p && c, msg.str()))
+		return nullptr;
+
+	const auto *b = find_barrier(c->wait_barrier, resource);
+	bool waits = false;
+	for (auto e : c->wait_events)
+		for (auto &s : p->signals)
+			waits |= s.event == e;
+
+	ctx.check(b && waits && !find_barrier(c->barrier, resource), msg.str());
+	return b;
+}
+
+void primary_renderer_test(tests::test_context &ctx) {
+	lib::vector<const char*> resource_names;
+	lib::vector<const char*> pass_names;
+	for (std::uint32_t r = 0; r < primary::resources_count; ++r)
+		resource_names.push_back(primary::resource_name(static_cast<primary::resource>(r)));
+	for (auto &d : primary::declare({ true, true, true }))
+		pass_names.push_back(d.name);
+
+	plan_validator validator(ctx, primary::resources_count, resource_names.data(), pass_names.data());
+	lib::vector<optional<compiler::resource_state>> states(primary::resources_count);
+
+	const auto compile = [&](const primary::frame_state &frame) {
+		const auto passes = primary_renderer_passes(frame);
+		auto plan = compiler::compile(passes, states);
+		validator.validate(passes, plan);
+
+		// Side effects aside, each pass of the primary renderer feeds a later pass. None are culled.
+		for (std::uint32_t p = 0; p < passes.size(); ++p)
+			ctx.check(!passes[p].enabled || find_pass(plan, p),
+					  std::string("Pass '") + pass_names[p] + "' was culled");
+		return plan;
+	};
+
+	// First frame: Resources states are unknown, atmospherics are updated and the scene voxelized
+	const auto first = compile({ true, true, true });
+	{
+		// Voxels are read by deferred, with a layout transition
+		const auto *b = check_split_barrier(ctx, first, primary::voxelizer, primary::deferred, primary::voxels, resource_names.data(), pass_names.data());
+		ctx.check(b &&
+				  b->old_layout == image_layout::general && b->new_layout == image_layout::shader_read_only_optimal &&
+				  contains(b->src_access, access_flags::shader_write) &&
+				  contains(b->dst_stages, pipeline_stage::fragment_shader),
+				  "Voxels aren't transitioned for deferred");
+	}
+
+	// Steady state
+	const auto steady = compile({ false, false, true });
+	{
+		// Adjacent producers use pipeline barriers
+		const auto *gb = find_pass(steady, primary::gbuffer);
+		const auto *b = gb ? find_barrier(gb->barrier, primary::idb) : nullptr;
+		ctx.check(b &&
+				  contains(b->src_stages, pipeline_stage::compute_shader) && contains(b->src_access, access_flags::shader_write) &&
+				  contains(b->dst_stages, pipeline_stage::draw_indirect) && contains(b->dst_access, access_flags::indirect_command_read),
+				  "Expected a pipeline barrier before 'gbuffer' for 'idb'");
+
+		const auto *h = find_pass(steady, primary::hiz);
+		b = h ? find_barrier(h->barrier, primary::depth_target) : nullptr;
+		ctx.check(b &&
+				  contains(b->src_stages, pipeline_stage::late_fragment_tests) && contains(b->src_access, access_flags::depth_stencil_attachment_write) &&
+				  contains(b->dst_stages, pipeline_stage::compute_shader) && contains(b->dst_access, access_flags::shader_read) &&
+				  b->old_layout == b->new_layout,
+				  "Expected a pipeline barrier before 'hiz' for 'depth_target'");
+
+		const auto *late = find_pass(steady, primary::geo_cull_late);
+		b = late ? find_barrier(late->barrier, primary::hiz_pyramid) : nullptr;
+		ctx.check(b && b->old_layout == image_layout::general && b->new_layout == image_layout::shader_read_only_optimal,
+				  "Expected a pipeline barrier transitioning 'hiz_pyramid' before 'geo_cull_late'");
+
+		// Non-adjacent producers use events
+		b = check_split_barrier(ctx, steady, primary::downsample_depth, primary::lll_gen, primary::downsampled_depth, resource_names.data(), pass_names.data());
+		ctx.check(b &&
+				  b->old_layout == image_layout::general && b->new_layout == image_layout::shader_read_only_optimal &&
+				  contains(b->dst_stages, pipeline_stage::compute_shader | pipeline_stage::fragment_shader),
+				  "Downsampled depth transition isn't made visible to both 'lll' and 'deferred'");
+
+		for (auto r : { primary::lll, primary::lll_heads, primary::lll_size }) {
+			b = check_split_barrier(ctx, steady, primary::lll_gen, primary::deferred, r, resource_names.data(), pass_names.data());
+			ctx.check(b &&
+					  contains(b->src_stages, pipeline_stage::compute_shader) && contains(b->src_access, access_flags::shader_write) &&
+					  contains(b->dst_stages, pipeline_stage::fragment_shader) && contains(b->dst_access, access_flags::shader_read),
+					  std::string("Linked light lists aren't made visible to 'deferred', resource '") + resource_names[r] + "'");
+		}
+		// The late phase continues the early phase's render, after the depth was read by hiz
+		const auto *gl = find_pass(steady, primary::gbuffer_late);
+		ctx.check(gl && (find_barrier(gl->barrier, primary::depth_target) || find_barrier(gl->wait_barrier, primary::depth_target)) &&
+				  (find_barrier(gl->barrier, primary::gbuffer_image) || find_barrier(gl->wait_barrier, primary::gbuffer_image)),
+				  "'gbuffer_late' isn't synchronized with the early phase's render");
+
+		b = check_split_barrier(ctx, steady, primary::gbuffer_late, primary::deferred, primary::gbuffer_image, resource_names.data(), pass_names.data());
+		ctx.check(b &&
+				  contains(b->src_stages, pipeline_stage::color_attachment_output) && contains(b->src_access, access_flags::color_attachment_write) &&
+				  contains(b->dst_stages, pipeline_stage::fragment_shader) && contains(b->dst_access, access_flags::shader_read),
+				  "The gbuffer isn't made visible to 'deferred'");
+		// One event per producer, the linked light lists and the gbuffer
+		const auto *d = find_pass(steady, primary::deferred);
+		ctx.check(d && d->wait_events.size() == 2, "'deferred' waits on an event per producer");
+
+		// Voxels are left read-only past the first frame
+		ctx.check(!has_barriers(steady, primary::voxels) && !has_barriers(steady, primary::voxel_assembly_list),
+				  "Voxels are synchronized past voxelization");
+	}
+
+	// Occlusion culling disabled, and reenabled
+	const auto no_occlusion = compile({ false, false, false });
+	ctx.check(!has_barriers(no_occlusion, primary::hiz_pyramid), "Hi-Z pyramid is synchronized without occlusion culling");
+	compile({ false, false, true });
+
+	// Atmospherics update past the first frame
+	{
+		const auto plan = compile({ true, false, true });
+		const auto *b = check_split_barrier(ctx, plan, primary::update_atmospherics, primary::preprocess_light, primary::atmospheric_buffer, resource_names.data(), pass_names.data());
+		ctx.check(b && contains(b->dst_stages, pipeline_stage::compute_shader | pipeline_stage::fragment_shader),
+				  "Atmospherics update isn't made visible to both 'preprocess_light' and 'deferred'");
+	}
+
+	// Cyclic execution: A steady state frame compiled without known states is synchronized as one compiled with the
+	// states of a previous steady state frame.
+	{
+		lib::vector<optional<compiler::resource_state>> unknown_states(primary::resources_count);
+		const auto passes = primary_renderer_passes({ false, false, true });
+		const auto cyclic = compiler::compile(passes, unknown_states);
+		const auto known = compiler::compile(passes, states);
+
+		bool same = cyclic.passes.size() == known.passes.size() && cyclic.events_count == known.events_count;
+		for (std::size_t i = 0; same && i < known.passes.size(); ++i) {
+			const auto &a = cyclic.passes[i];
+			const auto &b = known.passes[i];
+			same &= a.pass == b.pass &&
+				a.barrier.barriers.size() == b.barrier.barriers.size() &&
+				a.wait_barrier.barriers.size() == b.wait_barrier.barriers.size() &&
+				a.wait_events.size() == b.wait_events.size() &&
+				a.signals.size() == b.signals.size();
+			for (std::size_t j = 0; same && j < a.barrier.barriers.size(); ++j)
+				same &= a.barrier.barriers[j].resource == b.barrier.barriers[j].resource &&
+					a.barrier.barriers[j].src_stages == b.barrier.barriers[j].src_stages &&
+					a.barrier.barriers[j].dst_stages == b.barrier.barriers[j].dst_stages &&
+					a.barrier.barriers[j].old_layout == b.barrier.barriers[j].old_layout;
+		}
+		ctx.check(same, "Compiling with unknown states differs from the steady state");
+	}
+}
+
+/*
+ *	Culling
+ */
+
+const char *culling_resource_names[] = { "r0", "r1", "r2", "r3", "r4", "r5" };
+const char *culling_pass_names[] = { "p0", "p1", "p2", "p3", "p4", "p5", "p6", "p7" };
+
+void culling_test(tests::test_context &ctx) {
+	const auto compute = pipeline_stage::compute_shader;
+	const auto shader_read = access_flags::shader_read;
+	const auto shader_write = access_flags::shader_write;
+
+	lib::vector<compiler::pass> passes(8);
+	// Live, side effects
+	passes[0].usages = { write(0, compute, shader_write) };
+	passes[0].side_effects = true;
+	// Output is never read
+	passes[1].usages = { write(1, compute, shader_write) };
+	// Output is read only by a culled pass
+	passes[2].usages = { write(2, compute, shader_write) };
+	passes[3].usages = { read(2, compute, shader_read), write(3, compute, shader_write) };
+	// Output is read by a preceding live pass, i.e. in the next frame
+	passes[4].usages = { read(4, compute, shader_read) };
+	passes[4].side_effects = true;
+	passes[5].usages = { write(4, compute, shader_write) };
+	// Disabled, side effects notwithstanding
+	passes[6].usages = { write(5, compute, shader_write) };
+	passes[6].side_effects = true;
+	passes[6].enabled = false;
+	// Reads r0 from a non-adjacent producer, and r5 which is never written
+	passes[7].usages = { read(0, compute, shader_read), read(5, compute, shader_read) };
+	passes[7].side_effects = true;
+
+	plan_validator validator(ctx, 6, culling_resource_names, culling_pass_names);
+	lib::vector<optional<compiler::resource_state>> states(6);
+	for (int frame = 0; frame < 2; ++frame) {
+		const auto plan = compiler::compile(passes, states);
+		validator.validate(passes, plan);
+
+		lib::vector<std::uint32_t> live;
+		for (auto &cp : plan.passes)
+			live.push_back(cp.pass);
+		ctx.check(live == lib::vector<std::uint32_t>{ 0, 4, 5, 7 }, "Unexpected live passes");
+
+		for (auto r : { 1u, 2u, 3u, 5u })
+			ctx.check(!has_barriers(plan, r), std::string("Culled or disabled pass synchronized, resource '") + culling_resource_names[r] + "'");
+
+		check_split_barrier(ctx, plan, 0, 7, 0, culling_resource_names, culling_pass_names);
+
+		// The preceding frame's write needs no event
+		const auto *p4 = find_pass(plan, 4);
+		ctx.check(p4 && p4->wait_events.empty() && find_barrier(p4->barrier, 4),
+				  "Expected a pipeline barrier for a write of the previous frame");
+	}
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void render_graph_compiler_test(test_context &ctx) {
+	primary_renderer_test(ctx);
+	culling_test(ctx);
+}
+
+}
+}
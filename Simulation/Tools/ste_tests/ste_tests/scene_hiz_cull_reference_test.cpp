@@ -0,0 +1,234 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <scene_hiz_cull_reference.hpp>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::graphics;
+
+namespace {
+
+struct sphere {
+	glm::vec3 center;
+	float radius;
+};
+
+/**
+ *	@brief	Ray casts spheres into a reversed depth target, one ray through each pixel center
+ */
+class depth_caster {
+private:
+	glm::uvec2 extent;
+	glm::vec4 proj_xywz;
+
+public:
+	depth_caster(const glm::uvec2 &extent, float fovy, float near)
+		: extent(extent)
+	{
+		const auto aspect = static_cast<float>(extent.x) / static_cast<float>(extent.y);
+		const auto tan_half_fovy = glm::tan(fovy * .5f);
+		proj_xywz = { 1.f / (aspect * tan_half_fovy), -1.f / tan_half_fovy, near, -1.f };
+	}
+
+	const auto &projection_xywz() const { return proj_xywz; }
+
+	/**
+	 *	@brief	Depth of a sphere at a pixel, 0 (infinitely far) if the pixel's ray misses the sphere.
+	 */
+	float depth(const sphere &s, const glm::uvec2 &pixel) const {
+		const auto uv = (glm::vec2(pixel) + glm::vec2(.5f)) / glm::vec2(extent);
+		const auto ndc = uv * 2.f - 1.f;
+		// Eye space ray, at distance t along the view direction the ray is at z=-t
+		const auto dir = glm::vec3{ ndc.x / proj_xywz.x, ndc.y / proj_xywz.y, -1.f };
+
+		const auto a = glm::dot(dir, dir);
+		const auto b = glm::dot(dir, s.center);
+		const auto c = glm::dot(s.center, s.center) - s.radius * s.radius;
+		const auto disc = b * b - a * c;
+		if (disc < 0)
+			return .0f;
+
+		const auto t = (b - glm::sqrt(disc)) / a;
+		if (t <= proj_xywz.z)
+			return .0f;
+		return proj_xywz.z / t;
+	}
+};
+
+sphere random_sphere(std::mt19937 &gen, float min_radius, float max_radius) {
+	std::uniform_real_distribution<float> xy(-12.f, 12.f);
+	std::uniform_real_distribution<float> z(-40.f, -1.f);
+	std::uniform_real_distribution<float> r(min_radius, max_radius);
+
+	return { { xy(gen), xy(gen), z(gen) }, r(gen) };
+}
+
+/**
+ *	@brief	The test_sphere() footprint lookup relies on each pyramid texel holding at most the depth of every depth target
+ *			pixel it covers.
+ */
+void check_pyramid(tests::test_context &ctx,
+				   const scene_hiz_cull_reference::pyramid &hiz,
+				   const lib::vector<float> &depth,
+				   const glm::uvec2 &extent) {
+	bool conservative = true;
+	for (std::size_t l = 0; l < hiz.levels.size(); ++l) {
+		const auto size = hiz.extents[l];
+		for (std::uint32_t y = 0; y < extent.y; ++y) {
+			for (std::uint32_t x = 0; x < extent.x; ++x) {
+				const auto t = glm::min(glm::uvec2{ x, y } >> static_cast<std::uint32_t>(l + 1), size - glm::uvec2(1));
+				conservative &= hiz.texel(l, t) <= depth[y * extent.x + x];
+			}
+		}
+	}
+
+	std::ostringstream msg;
+	msg << "Pyramid of " << extent.x << "x" << extent.y << " holds a nearer depth than a pixel it covers";
+	ctx.check(conservative, msg.str());
+	ctx.check(hiz.extents.back() == glm::uvec2(1), "Pyramid mipmap chain is incomplete");
+}
+
+/**
+ *	@brief	Occlusion test must never cull a sphere that is visible through some pixel
+ */
+void check_conservativeness(tests::test_context &ctx,
+							const glm::uvec2 &extent,
+							std::mt19937 &gen) {
+	const depth_caster caster(extent, glm::radians(60.f), .1f);
+
+	// Occluders
+	lib::vector<float> depth(static_cast<std::size_t>(extent.x) * extent.y, .0f);
+	for (int i = 0; i < 24; ++i) {
+		const auto s = random_sphere(gen, 1.f, 6.f);
+		for (std::uint32_t y = 0; y < extent.y; ++y)
+			for (std::uint32_t x = 0; x < extent.x; ++x) {
+				auto &d = depth[y * extent.x + x];
+				d = std::max(d, caster.depth(s, { x, y }));
+			}
+	}
+
+	const auto hiz = scene_hiz_cull_reference::build_pyramid(depth, extent);
+	check_pyramid(ctx, hiz, depth, extent);
+
+	int culled = 0;
+	for (int i = 0; i < 400; ++i) {
+		const auto s = random_sphere(gen, .05f, 2.f);
+
+		bool visible = false;
+		for (std::uint32_t y = 0; y < extent.y && !visible; ++y)
+			for (std::uint32_t x = 0; x < extent.x && !visible; ++x)
+				visible = caster.depth(s, { x, y }) > depth[y * extent.x + x];
+
+		const auto unoccluded = scene_hiz_cull_reference::test_sphere(hiz, s.center, s.radius, caster.projection_xywz());
+		if (!unoccluded)
+			++culled;
+
+		if (visible) {
+			std::ostringstream msg;
+			msg << "Visible sphere <" << s.center.x << "," << s.center.y << "," << s.center.z << ">, radius " << s.radius
+				<< " culled on a " << extent.x << "x" << extent.y << " target";
+			ctx.check(unoccluded, msg.str());
+		}
+	}
+
+	// Guards against a test that never culls
+	ctx.check(culled > 0, "No sphere was culled");
+}
+
+/**
+ *	@brief	Draws compaction: Every cluster visible in this frame is drawn exactly once, and only clusters that passed the
+ *			early or late phase are drawn.
+ */
+void check_compaction(tests::test_context &ctx,
+					  std::mt19937 &gen,
+					  bool occlusion_culling) {
+	constexpr std::uint32_t clusters_count = 2000;
+	std::bernoulli_distribution coin(.5), likely(.8);
+
+	lib::vector<scene_hiz_cull_reference::cluster> clusters(clusters_count);
+	lib::vector<std::uint32_t> visibility(clusters_count);
+	for (std::uint32_t i = 0; i < clusters_count; ++i) {
+		auto &c = clusters[i];
+		c.in_frustum = likely(gen);
+		// A cluster's normal cone can be neither all back nor all front facing, but not both
+		c.back_facing = coin(gen) && coin(gen);
+		c.front_facing = !c.back_facing && coin(gen);
+		c.unoccluded = coin(gen);
+		visibility[i] = coin(gen) ? 1 : 0;
+	}
+
+	const auto result = scene_hiz_cull_reference::cull(clusters, visibility, occlusion_culling);
+
+	const auto unique = [](const lib::vector<std::uint32_t> &idb) {
+		return std::set<std::uint32_t>(idb.begin(), idb.end()).size() == idb.size();
+	};
+	ctx.check(unique(result.idb), "Duplicate draws in the early phase");
+	ctx.check(unique(result.late_idb), "Duplicate draws in the late phase");
+	ctx.check(unique(result.backface_idb), "Duplicate back face draws");
+
+	lib::vector<int> draws(clusters_count, 0);
+	for (auto i : result.idb) ++draws[i];
+	for (auto i : result.late_idb) ++draws[i];
+	std::set<std::uint32_t> backface_draws(result.backface_idb.begin(), result.backface_idb.end());
+
+	std::uint32_t expected_draws = 0;
+	bool visible_drawn = true, only_passing_drawn = true, backface_correct = true, visibility_correct = true;
+	for (std::uint32_t i = 0; i < clusters_count; ++i) {
+		const auto &c = clusters[i];
+		const bool front = c.in_frustum && !c.back_facing;
+		const bool visible = front && (!occlusion_culling || c.unoccluded);
+		const bool drawn = front && (!occlusion_culling || visibility[i] != 0 || c.unoccluded);
+
+		if (drawn)
+			++expected_draws;
+		if (visible && draws[i] != 1)
+			visible_drawn = false;
+		if (!drawn && draws[i] != 0)
+			only_passing_drawn = false;
+		if (backface_draws.count(i) != (c.in_frustum && !c.front_facing ? 1u : 0u))
+			backface_correct = false;
+		if (occlusion_culling && result.visibility[i] != (visible ? 1u : 0u))
+			visibility_correct = false;
+	}
+
+	const auto draws_count = static_cast<std::uint32_t>(result.idb.size() + result.late_idb.size());
+	std::ostringstream msg;
+	msg << "Compacted draw count " << draws_count << ", expected " << expected_draws;
+	ctx.check(draws_count == expected_draws, msg.str());
+	ctx.check(visible_drawn, "A visible cluster was not drawn exactly once");
+	ctx.check(only_passing_drawn, "A culled cluster was drawn");
+	ctx.check(backface_correct, "Back face draws mismatch");
+	ctx.check(visibility_correct, "Visibility for the next frame mismatch");
+	if (!occlusion_culling) {
+		ctx.check(result.late_idb.empty(), "Late phase ran without occlusion culling");
+		ctx.check(result.visibility == visibility, "Visibility changed without occlusion culling");
+	}
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void scene_hiz_cull_reference_test(test_context &ctx) {
+	std::mt19937 gen(1234);
+
+	// Power-of-two, odd and degenerate extents exercise the pyramid's footprints
+	const glm::uvec2 extents[] = { { 128, 64 }, { 97, 61 }, { 160, 90 }, { 33, 1 } };
+	for (auto &extent : extents)
+		check_conservativeness(ctx, extent, gen);
+
+	check_compaction(ctx, gen, true);
+	check_compaction(ctx, gen, false);
+}
+
+}
+}
@@ -0,0 +1,50 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+namespace ste {
+namespace tests {
+
+/**
+ *	@brief	Counts and reports failed checks of a test
+ */
+class test_context {
+private:
+	std::string name;
+	int checks{ 0 };
+	int failures{ 0 };
+
+public:
+	test_context(std::string name) : name(std::move(name)) {}
+
+	/**
+	 *	@brief	Records a check, printing msg if it failed.
+	 *
+	 *	@return	The check's result
+	 */
+	bool check(bool passed, const std::string &msg) {
+		++checks;
+		if (!passed) {
+			++failures;
+			std::cout << "  " << name << ": FAILED - " << msg << std::endl;
+		}
+		return passed;
+	}
+
+	/**
+	 *	@brief	Prints a measurement, e.g. a benchmark's result
+	 */
+	void report(const std::string &msg) const {
+		std::cout << "  " << name << ": " << msg << std::endl;
+	}
+
+	auto get_checks_count() const { return checks; }
+	auto get_failures_count() const { return failures; }
+};
+
+}
+}
@@ -0,0 +1,58 @@
+// ste_tests.cpp : CPU-side tests of engine components. Returns the count of failed tests.
+//
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <functional>
+#include <utility>
+
+namespace ste {
+namespace tests {
+
+void scene_hiz_cull_reference_test(test_context &);
+void render_graph_compiler_test(test_context &);
+void mesh_optimizer_test(test_context &);
+void device_memory_tlsf_test(test_context &);
+void work_stealing_deque_test(test_context &);
+void timer_wheel_test(test_context &);
+void glyph_atlas_packer_test(test_context &);
+void glyph_distance_transform_test(test_context &);
+void text_layout_cache_test(test_context &);
+void surface_convert_kernels_test(test_context &);
+void shader_dependency_graph_test(test_context &);
+
+}
+}
+
+int main() {
+	using namespace ste::tests;
+
+	const std::pair<const char*, std::function<void(test_context&)>> tests[] = {
+		{ "scene_hiz_cull_reference", scene_hiz_cull_reference_test },
+		{ "render_graph_compiler", render_graph_compiler_test },
+		{ "mesh_optimizer", mesh_optimizer_test },
+		{ "device_memory_tlsf", device_memory_tlsf_test },
+		{ "work_stealing_deque", work_stealing_deque_test },
+		{ "timer_wheel", timer_wheel_test },
+		{ "glyph_atlas_packer", glyph_atlas_packer_test },
+		{ "glyph_distance_transform", glyph_distance_transform_test },
+		{ "text_layout_cache", text_layout_cache_test },
+		{ "surface_convert_kernels", surface_convert_kernels_test },
+		{ "shader_dependency_graph", shader_dependency_graph_test },
+	};
+
+	int failed = 0;
+	for (auto &t : tests) {
+		test_context ctx(t.first);
+		t.second(ctx);
+
+		const bool passed = ctx.get_failures_count() == 0;
+		std::cout << (passed ? "PASSED " : "FAILED ") << t.first << " (" << ctx.get_checks_count() << " checks, "
+			<< ctx.get_failures_count() << " failed)" << std::endl;
+		if (!passed)
+			++failed;
+	}
+
+	return failed;
+}
@@ -0,0 +1,318 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <surface_convert_kernels.hpp>
+
+#include <lib/vector.hpp>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::resource;
+
+namespace {
+
+using benchmark_clock_t = std::chrono::high_resolution_clock;
+
+enum class encoding {
+	unorm8,
+	srgb8,
+	unorm16,
+	sfloat32,
+};
+
+/**
+ *	@brief	Block layout of a format: Byte offsets of the RGBA components, -1 for missing components
+ */
+struct format_layout {
+	gl::format format;
+	const char *name;
+	std::size_t bytes;
+	int offsets[4];
+	encoding e;
+};
+
+const format_layout r8g8b8a8_unorm = { gl::format::r8g8b8a8_unorm, "r8g8b8a8_unorm", 4, { 0, 1, 2, 3 }, encoding::unorm8 };
+const format_layout r8g8b8a8_srgb = { gl::format::r8g8b8a8_srgb, "r8g8b8a8_srgb", 4, { 0, 1, 2, 3 }, encoding::srgb8 };
+const format_layout b8g8r8a8_unorm = { gl::format::b8g8r8a8_unorm, "b8g8r8a8_unorm", 4, { 2, 1, 0, 3 }, encoding::unorm8 };
+const format_layout b8g8r8a8_srgb = { gl::format::b8g8r8a8_srgb, "b8g8r8a8_srgb", 4, { 2, 1, 0, 3 }, encoding::srgb8 };
+const format_layout r8g8b8_unorm = { gl::format::r8g8b8_unorm, "r8g8b8_unorm", 3, { 0, 1, 2, -1 }, encoding::unorm8 };
+const format_layout r8g8b8_srgb = { gl::format::r8g8b8_srgb, "r8g8b8_srgb", 3, { 0, 1, 2, -1 }, encoding::srgb8 };
+const format_layout b8g8r8_unorm = { gl::format::b8g8r8_unorm, "b8g8r8_unorm", 3, { 2, 1, 0, -1 }, encoding::unorm8 };
+const format_layout b8g8r8_srgb = { gl::format::b8g8r8_srgb, "b8g8r8_srgb", 3, { 2, 1, 0, -1 }, encoding::srgb8 };
+const format_layout r32g32b32a32_sfloat = { gl::format::r32g32b32a32_sfloat, "r32g32b32a32_sfloat", 16, { 0, 4, 8, 12 }, encoding::sfloat32 };
+const format_layout r8_unorm = { gl::format::r8_unorm, "r8_unorm", 1, { 0, -1, -1, -1 }, encoding::unorm8 };
+const format_layout r16_unorm = { gl::format::r16_unorm, "r16_unorm", 2, { 0, -1, -1, -1 }, encoding::unorm16 };
+
+struct format_pair {
+	const format_layout &src;
+	const format_layout &dst;
+};
+
+// Every pair surface_convert_kernels provides a kernel for
+const format_pair pairs[] = {
+	{ r8g8b8a8_unorm, r32g32b32a32_sfloat },
+	{ r8g8b8a8_srgb, r32g32b32a32_sfloat },
+	{ b8g8r8a8_unorm, r32g32b32a32_sfloat },
+	{ b8g8r8a8_srgb, r32g32b32a32_sfloat },
+	{ r8g8b8_unorm, r32g32b32a32_sfloat },
+	{ r8g8b8_srgb, r32g32b32a32_sfloat },
+	{ b8g8r8_unorm, r32g32b32a32_sfloat },
+	{ b8g8r8_srgb, r32g32b32a32_sfloat },
+
+	{ r32g32b32a32_sfloat, r8g8b8a8_unorm },
+	{ r32g32b32a32_sfloat, r8g8b8a8_srgb },
+	{ r32g32b32a32_sfloat, b8g8r8a8_unorm },
+	{ r32g32b32a32_sfloat, b8g8r8a8_srgb },
+	{ r32g32b32a32_sfloat, r8g8b8_unorm },
+	{ r32g32b32a32_sfloat, r8g8b8_srgb },
+	{ r32g32b32a32_sfloat, b8g8r8_unorm },
+	{ r32g32b32a32_sfloat, b8g8r8_srgb },
+
+	{ b8g8r8a8_unorm, r8g8b8a8_unorm },
+	{ b8g8r8a8_srgb, r8g8b8a8_srgb },
+	{ r8g8b8_unorm, r8g8b8a8_unorm },
+	{ r8g8b8_srgb, r8g8b8a8_srgb },
+	{ b8g8r8_unorm, r8g8b8a8_unorm },
+	{ b8g8r8_srgb, r8g8b8a8_srgb },
+
+	{ r8_unorm, r16_unorm },
+	{ r16_unorm, r8_unorm },
+};
+
+const char *isa_names[] = { "scalar", "sse41", "avx2" };
+
+double srgb_to_linear(double s) {
+	return s <= 0.04045 ?
+		s / 12.92 :
+		std::pow((s + 0.055) / 1.055, 2.4);
+}
+double linear_to_srgb(double l) {
+	return l <= 0.0031308 ?
+		l * 12.92 :
+		1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+/**
+ *	@brief	Double precision decode of a block's components. Missing components decode to 0, missing alpha to 1.
+ */
+void decode(const format_layout &l, const std::uint8_t *block, double rgba[4]) {
+	for (int c = 0; c < 4; ++c) {
+		const auto offset = l.offsets[c];
+		if (offset < 0) {
+			rgba[c] = c == 3 ? 1.0 : .0;
+			continue;
+		}
+
+		const auto *p = block + offset;
+		switch (l.e) {
+		case encoding::unorm8:
+			rgba[c] = static_cast<double>(*p) / 255.0;
+			break;
+		case encoding::srgb8:
+			// Alpha is linear
+			rgba[c] = c == 3 ? static_cast<double>(*p) / 255.0 : srgb_to_linear(static_cast<double>(*p) / 255.0);
+			break;
+		case encoding::unorm16: {
+			std::uint16_t v;
+			std::memcpy(&v, p, sizeof(v));
+			rgba[c] = static_cast<double>(v) / 65535.0;
+			break;
+		}
+		case encoding::sfloat32: {
+			float v;
+			std::memcpy(&v, p, sizeof(v));
+			rgba[c] = static_cast<double>(v);
+			break;
+		}
+		}
+	}
+}
+
+/**
+ *	@brief	Compares a converted block with the double precision conversion of the source block. Integer encodings must
+ *			round to nearest, unless the exact value is within rounding error of halfway between two codes.
+ */
+bool matches_reference(const format_layout &src, const format_layout &dst, const std::uint8_t *src_block, const std::uint8_t *dst_block) {
+	double rgba[4];
+	decode(src, src_block, rgba);
+
+	for (int c = 0; c < 4; ++c) {
+		const auto offset = dst.offsets[c];
+		if (offset < 0)
+			continue;
+
+		const auto *p = dst_block + offset;
+		double x = rgba[c];
+		if (dst.e == encoding::sfloat32) {
+			float v;
+			std::memcpy(&v, p, sizeof(v));
+			if (glm::abs(static_cast<double>(v) - x) > 1e-6)
+				return false;
+			continue;
+		}
+
+		// Clamped, NaNs to 0
+		x = x > .0 ? x : .0;
+		x = x < 1.0 ? x : 1.0;
+
+		double exact;
+		std::uint32_t code;
+		if (dst.e == encoding::unorm16) {
+			std::uint16_t v;
+			std::memcpy(&v, p, sizeof(v));
+			exact = x * 65535.0;
+			code = v;
+		}
+		else {
+			exact = (dst.e == encoding::srgb8 && c != 3 ? linear_to_srgb(x) : x) * 255.0;
+			code = *p;
+		}
+
+		const auto halfway = glm::abs(exact - glm::floor(exact) - .5) < 1e-4;
+		const auto expected = static_cast<std::uint32_t>(glm::floor(exact + .5));
+		if (code != expected && !(halfway && (code == expected - 1 || code == expected + 1)))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ *	@brief	Random source blocks. Float components are mostly in [0,1], including sRGB thresholds, with negative, larger
+ *			than 1, infinite, NaN and denormal values mixed in.
+ */
+lib::vector<std::uint8_t> source_blocks(const format_layout &l, std::size_t count, std::uint32_t seed) {
+	std::mt19937 gen(seed);
+	lib::vector<std::uint8_t> data(count * l.bytes);
+	if (l.e != encoding::sfloat32) {
+		for (auto &b : data)
+			b = static_cast<std::uint8_t>(gen());
+		return data;
+	}
+
+	std::uniform_real_distribution<float> unit(.0f, 1.f);
+	const float specials[] = {
+		-.0f, -1.f, 1.f, 1.5f, 1e20f, -1e-20f,
+		std::numeric_limits<float>::infinity(),
+		-std::numeric_limits<float>::infinity(),
+		std::numeric_limits<float>::quiet_NaN(),
+		std::numeric_limits<float>::denorm_min(),
+	};
+
+	for (std::size_t i = 0; i < count * 4; ++i) {
+		float v;
+		const auto kind = gen() % 16;
+		if (kind == 0)
+			v = specials[gen() % (sizeof(specials) / sizeof(specials[0]))];
+		else if (kind == 1)
+			v = static_cast<float>(srgb_to_linear((static_cast<double>(gen() % 255) + .5) / 255.0));
+		else
+			v = unit(gen);
+		std::memcpy(data.data() + i * 4, &v, sizeof(v));
+	}
+	return data;
+}
+
+/**
+ *	@brief	Every instruction set's kernel converts like the scalar kernel, bit for bit, and the scalar kernel matches the
+ *			double precision conversion. Counts not divisible by the vector widths and unaligned buffers exercise the
+ *			kernels' tails.
+ */
+void equivalence_test(tests::test_context &ctx, const format_pair &pair) {
+	const auto name = std::string(pair.src.name) + " -> " + pair.dst.name + ": ";
+	const auto supported = static_cast<int>(surface_convert_kernels::supported_isa());
+
+	const auto scalar = surface_convert_kernels::find(pair.src.format, pair.dst.format, surface_convert_kernels::isa::scalar);
+	ctx.check(!!scalar, name + "No kernel");
+	if (!scalar)
+		return;
+
+	const std::size_t counts[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 1000, 4099 };
+	for (std::size_t offset = 0; offset < 3; ++offset) {
+		for (auto count : counts) {
+			const auto blocks = source_blocks(pair.src, count, static_cast<std::uint32_t>(count * 3 + offset));
+
+			// Unaligned source and destination, guarded by canaries to catch writes past the end
+			constexpr std::uint8_t canary = 0xA5;
+			constexpr std::size_t guard = 64;
+			lib::vector<std::uint8_t> src(offset + blocks.size());
+			std::copy(blocks.begin(), blocks.end(), src.begin() + offset);
+
+			lib::vector<std::uint8_t> reference(offset + count * pair.dst.bytes + guard, canary);
+			scalar(src.data() + offset, reference.data() + offset, count);
+
+			bool exact = true;
+			for (std::size_t i = 0; i < count && exact; ++i)
+				exact = matches_reference(pair.src, pair.dst, blocks.data() + i * pair.src.bytes, reference.data() + offset + i * pair.dst.bytes);
+			ctx.check(exact, name + "Scalar kernel doesn't match the double precision conversion");
+
+			for (int isa = 1; isa <= supported; ++isa) {
+				const auto kernel = surface_convert_kernels::find(pair.src.format,
+																  pair.dst.format,
+																  static_cast<surface_convert_kernels::isa>(isa));
+				lib::vector<std::uint8_t> out(reference.size(), canary);
+				kernel(src.data() + offset, out.data() + offset, count);
+
+				std::ostringstream msg;
+				msg << name << isa_names[isa] << " kernel differs from the scalar kernel, " << count << " blocks at offset " << offset;
+				ctx.check(std::memcmp(out.data(), reference.data(), out.size()) == 0, msg.str());
+			}
+		}
+	}
+}
+
+/**
+ *	@brief	Throughput of a pair's kernel with each supported instruction set, converting a 2048x2048 surface
+ */
+void throughput_benchmark(tests::test_context &ctx, const format_pair &pair) {
+	constexpr std::size_t count = 2048 * 2048;
+	constexpr int iterations = 4;
+
+	const auto src = source_blocks(pair.src, count, 1);
+	lib::vector<std::uint8_t> dst(count * pair.dst.bytes);
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(0) << pair.src.name << " -> " << pair.dst.name << ", Mpixels/s:";
+	for (int isa = 0; isa <= static_cast<int>(surface_convert_kernels::supported_isa()); ++isa) {
+		const auto kernel = surface_convert_kernels::find(pair.src.format,
+														  pair.dst.format,
+														  static_cast<surface_convert_kernels::isa>(isa));
+		// Warm up
+		kernel(src.data(), dst.data(), count);
+
+		const auto start = benchmark_clock_t::now();
+		for (int i = 0; i < iterations; ++i)
+			kernel(src.data(), dst.data(), count);
+		const auto s = std::chrono::duration<double>(benchmark_clock_t::now() - start).count();
+
+		msg << " " << isa_names[isa] << " " << static_cast<double>(count) * iterations / s / 1e+6;
+	}
+	ctx.report(msg.str());
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void surface_convert_kernels_test(test_context &ctx) {
+	ctx.check(!surface_convert_kernels::find(gl::format::r8g8b8a8_unorm, gl::format::r16_unorm), "Kernel for a pair without a kernel");
+
+	for (auto &pair : pairs)
+		equivalence_test(ctx, pair);
+	for (auto &pair : pairs)
+		throughput_benchmark(ctx, pair);
+}
+
+}
+}
@@ -0,0 +1,247 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <text_layout_cache.hpp>
+
+#include <lib/vector.hpp>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+using namespace ste::text;
+
+namespace {
+
+using benchmark_clock_t = std::chrono::high_resolution_clock;
+
+const std::experimental::filesystem::path font_path =
+	std::experimental::filesystem::path(__FILE__).parent_path() / "../../../Data/ArchitectsDaughter.ttf";
+
+double elapsed_ms(benchmark_clock_t::time_point start) {
+	return std::chrono::duration<double, std::milli>(benchmark_clock_t::now() - start).count();
+}
+
+/**
+ *	@brief	Paragraphs of words, with colour, size, weight and stroke spans of a few to a few dozen characters, and
+ *			alignment and line height spans over whole lines.
+ */
+attributed_wstring multi_attribute_string(std::uint32_t length, std::uint32_t seed) {
+	std::mt19937 gen(seed);
+
+	lib::wstring plain;
+	plain.reserve(length);
+	while (plain.length() < length) {
+		const auto word = 1 + gen() % 9;
+		for (std::uint32_t i = 0; i < word && plain.length() < length; ++i)
+			plain += static_cast<wchar_t>(L'a' + gen() % 26);
+		if (plain.length() < length)
+			plain += gen() % 12 ? L' ' : L'\n';
+	}
+
+	attributed_wstring wstr(std::move(plain));
+
+	// Spans of a type, with gaps between them
+	const auto spans = [&](std::uint32_t max_length, auto &&make_attrib) {
+		for (auto i = static_cast<std::uint32_t>(gen() % max_length); i < length;) {
+			const auto l = std::min(1 + static_cast<std::uint32_t>(gen() % max_length), length - i);
+			wstr.add_attrib({ i, l }, make_attrib());
+			i += l + static_cast<std::uint32_t>(gen() % max_length);
+		}
+	};
+	spans(40, [&]() { return attributes::rgb(glm::u8vec4(gen() % 256, gen() % 256, gen() % 256, 255)); });
+	spans(60, [&]() { return attributes::size(12 + static_cast<int>(gen() % 4) * 4); });
+	spans(30, [&]() { return attributes::weight(gen() % 2 ? 700 : 300); });
+	spans(80, [&]() { return attributes::stroke({ 0, 0, 0, 255 }, 1.f + static_cast<float>(gen() % 3)); });
+
+	// Per line attributes
+	const auto &str = wstr.plain_string();
+	std::uint32_t line_start = 0;
+	for (std::uint32_t i = 0; i <= length; ++i) {
+		if (i < length && str[i] != L'\n')
+			continue;
+
+		const auto line = range<std::uint32_t>{ line_start, i - line_start };
+		if (line.length && gen() % 3 == 0)
+			wstr.add_attrib(line, gen() % 2 ? attributes::center : attributes::right);
+		if (line.length && gen() % 4 == 0)
+			wstr.add_attrib(line, attributes::line_height(1.5f));
+		line_start = i + 1;
+	}
+
+	return wstr;
+}
+
+/**
+ *	@brief	Resolves the style of every character with per character attribute lookups, as text_manager did before the
+ *			layout cache.
+ */
+lib::vector<text_layout_style> per_character_styles(const attributed_wstring &wstr, const font *default_font, int default_size) {
+	const auto length = static_cast<std::uint32_t>(wstr.length());
+
+	lib::vector<text_layout_style> styles(length);
+	for (std::uint32_t i = 0; i < length; ++i) {
+		const auto font_attrib = attributes::font::bind(wstr.attrib_of_type(attributes::attrib_type::font, { i,1 }));
+		const auto color_attrib = attributes::rgb::bind(wstr.attrib_of_type(attributes::attrib_type::color, { i,1 }));
+		const auto size_attrib = attributes::size::bind(wstr.attrib_of_type(attributes::attrib_type::size, { i,1 }));
+		const auto stroke_attrib = attributes::stroke::bind(wstr.attrib_of_type(attributes::attrib_type::stroke, { i,1 }));
+		const auto weight_attrib = attributes::weight::bind(wstr.attrib_of_type(attributes::attrib_type::weight, { i,1 }));
+		const auto alignment_attrib = attributes::align::bind(wstr.attrib_of_type(attributes::attrib_type::align, { i,1 }));
+		const auto line_height_attrib = attributes::line_height::bind(wstr.attrib_of_type(attributes::attrib_type::line_height, { i,1 }));
+
+		auto &style = styles[i];
+		style.f = font_attrib ? &font_attrib->get() : default_font;
+		style.size = size_attrib ? size_attrib->get() : default_size;
+		if (weight_attrib)
+			style.weight = weight_attrib->get();
+		if (color_attrib)
+			style.color = color_attrib->get();
+		if (stroke_attrib) {
+			style.stroke = true;
+			style.stroke_color = stroke_attrib->get_color();
+			style.stroke_width = stroke_attrib->get_width();
+		}
+		if (alignment_attrib) {
+			style.has_alignment = true;
+			style.alignment = alignment_attrib->get();
+		}
+		if (line_height_attrib) {
+			style.has_line_height = true;
+			style.line_height = line_height_attrib->get();
+		}
+	}
+
+	return styles;
+}
+
+bool same_style(text_layout_style a, const text_layout_style &b) {
+	// Runs reference interned fonts
+	if (*a.f != *b.f)
+		return false;
+	a.f = b.f;
+	return a == b;
+}
+
+void runs_test(tests::test_context &ctx, const attributed_wstring &wstr, const font &default_font) {
+	constexpr int default_size = 24;
+
+	text_layout_cache cache;
+	const auto k = cache.key(wstr, default_font, default_size);
+	const auto styles = per_character_styles(wstr, &default_font, default_size);
+
+	bool contiguous = !k.runs.empty() && k.runs.front().chars.start == 0;
+	bool maximal = true;
+	bool matches = true;
+	for (std::size_t r = 0; r < k.runs.size(); ++r) {
+		const auto &run = k.runs[r];
+		if (r) {
+			const auto &prev = k.runs[r - 1];
+			contiguous &= prev.chars.start + prev.chars.length == run.chars.start && run.chars.length > 0;
+			maximal &= prev.style != run.style;
+		}
+		for (auto i = run.chars.start; i < run.chars.start + run.chars.length && i < styles.size(); ++i)
+			matches &= same_style(styles[i], run.style);
+	}
+	contiguous &= !k.runs.empty() && k.runs.back().chars.start + k.runs.back().chars.length == wstr.length();
+
+	ctx.check(k.string == wstr.plain_string(), "Layout key string doesn't match the attributed string");
+	ctx.check(contiguous, "Style runs don't cover the string");
+	ctx.check(maximal, "Adjacent style runs share a style");
+	ctx.check(matches, "Style runs don't match per character attribute lookups");
+
+	// Same text, different style
+	auto restyled = wstr;
+	restyled.add_attrib({ static_cast<std::uint32_t>(wstr.length() / 2), 1 }, attributes::rgb(glm::u8vec4{ 1, 2, 3, 4 }));
+	ctx.check(!(cache.key(restyled, default_font, default_size) == k), "Restyled string has the same layout key");
+	ctx.check(!(cache.key(wstr, default_font, default_size + 1) == k), "Different default size has the same layout key");
+	ctx.check(cache.key(wstr, font(font_path), default_size) == k, "Equal default fonts give different layout keys");
+}
+
+void lru_test(tests::test_context &ctx, const font &default_font) {
+	text_layout_cache cache(2);
+	const auto key = [&](const wchar_t *s) { return cache.key(attributed_wstring(s), default_font, 24); };
+	const auto points = [](std::uint32_t n) {
+		lib::vector<glyph_point> p(n);
+		for (std::uint32_t i = 0; i < n; ++i)
+			p[i].data() = glm::u32vec4(i);
+		return p;
+	};
+
+	cache.insert(key(L"a"), points(1));
+	cache.insert(key(L"b"), points(2));
+	ctx.check(cache.get(key(L"a")) && cache.get(key(L"a"))->size() == 1, "Cached layout missing");
+
+	// "b" is least recently used
+	cache.insert(key(L"c"), points(3));
+	ctx.check(cache.size() == 2, "Cache exceeded its entries count");
+	ctx.check(!cache.get(key(L"b")), "Least recently used layout wasn't evicted");
+	ctx.check(cache.get(key(L"a")) && cache.get(key(L"c")) && cache.get(key(L"c"))->size() == 3, "Recently used layout evicted");
+	ctx.check(cache.get_hits_count() == 5 && cache.get_misses_count() == 1, "Wrong hits or misses count");
+
+	text_layout_cache disabled(0);
+	disabled.insert(key(L"a"), points(1));
+	ctx.check(disabled.size() == 0 && !disabled.get(key(L"a")), "Cache with no entries cached a layout");
+}
+
+/**
+ *	@brief	A 10k character string with about a thousand attributes: Resolving styles per character, resolving style runs and
+ *			looking up a cached layout.
+ */
+void benchmark(tests::test_context &ctx, const font &default_font) {
+	constexpr std::uint32_t length = 10000;
+	constexpr int iterations = 20;
+
+	const auto wstr = multi_attribute_string(length, 3);
+
+	std::size_t sink = 0;
+	auto start = benchmark_clock_t::now();
+	for (int i = 0; i < iterations; ++i)
+		sink += per_character_styles(wstr, &default_font, 24).size();
+	const auto per_character_ms = elapsed_ms(start) / iterations;
+
+	text_layout_cache cache;
+	std::size_t runs = 0;
+	start = benchmark_clock_t::now();
+	for (int i = 0; i < iterations; ++i)
+		runs = cache.key(wstr, default_font, 24).runs.size();
+	const auto key_ms = elapsed_ms(start) / iterations;
+
+	cache.insert(cache.key(wstr, default_font, 24), lib::vector<glyph_point>(length));
+	std::size_t hits = 0;
+	start = benchmark_clock_t::now();
+	for (int i = 0; i < iterations; ++i) {
+		const auto *points = cache.get(cache.key(wstr, default_font, 24));
+		hits += points && points->size() == length ? 1 : 0;
+	}
+	const auto hit_ms = elapsed_ms(start) / iterations;
+
+	ctx.check(sink == length * iterations && hits == iterations, "Benchmark layouts weren't cached");
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(3)
+		<< length << " characters, " << wstr.attribs().size() << " attributes, " << runs << " runs: per character attrib_of_type "
+		<< per_character_ms << " ms, style runs " << key_ms << " ms, cache hit (runs + lookup) " << hit_ms << " ms";
+	ctx.report(msg.str());
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void text_layout_cache_test(test_context &ctx) {
+	const font default_font(font_path);
+
+	runs_test(ctx, multi_attribute_string(2000, 1), default_font);
+	runs_test(ctx, multi_attribute_string(37, 2), default_font);
+	lru_test(ctx, default_font);
+
+	benchmark(ctx, default_font);
+}
+
+}
+}
@@ -0,0 +1,227 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <timer_wheel.hpp>
+
+#include <lib/vector.hpp>
+#include <chrono>
+#include <iomanip>
+#include <list>
+#include <random>
+#include <sstream>
+
+using namespace ste;
+
+namespace {
+
+using clock_t = std::chrono::high_resolution_clock;
+using wheel_t = timer_wheel<std::uint32_t>;
+using tick_t = wheel_t::tick_t;
+
+double elapsed_ms(clock_t::time_point start) {
+	return std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+}
+
+lib::vector<tick_t> random_deadlines(std::size_t count, tick_t start, tick_t max_delay, std::uint32_t seed) {
+	std::mt19937_64 gen(seed);
+	lib::vector<tick_t> deadlines(count);
+	for (auto &d : deadlines)
+		d = start + gen() % (max_delay + 1);
+	return deadlines;
+}
+
+/**
+ *	@brief	Tracks expirations of timers, ids index into deadlines.
+ */
+struct expirations {
+	const lib::vector<tick_t> &deadlines;
+	lib::vector<int> fired;
+	bool early{ false };
+	bool late{ false };
+
+	expirations(const lib::vector<tick_t> &deadlines) : deadlines(deadlines), fired(deadlines.size(), 0) {}
+
+	// Called for timers expired while advancing from 'from' up to, and including, 'to'
+	void expire(std::uint32_t id, tick_t from, tick_t to) {
+		++fired[id];
+		early |= deadlines[id] > to;
+		late |= deadlines[id] < from;
+	}
+
+	bool each_once() const {
+		for (auto f : fired)
+			if (f != 1)
+				return false;
+		return true;
+	}
+};
+
+/**
+ *	@brief	Advances one tick at a time, every timer must expire exactly on its deadline.
+ */
+void single_tick_test(tests::test_context &ctx, tick_t start, tick_t max_delay, std::uint32_t seed) {
+	std::ostringstream name;
+	name << "start " << start << ", delays up to " << max_delay << ": ";
+
+	const auto deadlines = random_deadlines(5000, start, max_delay, seed);
+	expirations e(deadlines);
+
+	wheel_t wheel(start);
+	for (std::uint32_t i = 0; i < deadlines.size(); ++i)
+		wheel.insert(deadlines[i], std::uint32_t(i));
+	ctx.check(wheel.size() == deadlines.size(), name.str() + "Wrong size after insertion");
+
+	for (tick_t t = start; t <= start + max_delay; ++t)
+		wheel.advance(t, [&](std::uint32_t id) { e.expire(id, t, t); });
+
+	ctx.check(e.each_once(), name.str() + "Timers didn't expire exactly once");
+	ctx.check(!e.early && !e.late, name.str() + "Timers didn't expire on their deadline");
+	ctx.check(wheel.empty(), name.str() + "Wheel isn't empty");
+}
+
+/**
+ *	@brief	Advances only to the wheel's next event tick, as the timer thread does. Deadlines span beyond the wheel's
+ *			range, which are clamped and re-cascaded. Timers are also inserted while the wheel advances, including
+ *			deadlines in the past.
+ *			Uses a small wheel, the full-sized wheel's range is too long to walk revolution by revolution.
+ */
+void next_event_test(tests::test_context &ctx, std::uint32_t seed) {
+	constexpr int levels = 3;
+	constexpr int slot_bits = 4;
+	using small_wheel_t = timer_wheel<std::uint32_t, levels, slot_bits>;
+
+	constexpr tick_t range = static_cast<tick_t>(1) << (levels * slot_bits);
+	constexpr tick_t max_delay = 4 * range;
+	const tick_t start = 1234;
+
+	auto deadlines = random_deadlines(4000, start, max_delay, seed);
+	// Deadlines clustered around level boundaries
+	for (int l = 1; l <= levels; ++l) {
+		const auto boundary = (start >> (slot_bits * l) << (slot_bits * l)) + (static_cast<tick_t>(1) << (slot_bits * l));
+		for (tick_t d = boundary - 2; d <= boundary + 2; ++d)
+			deadlines.push_back(d);
+	}
+	const auto initial = deadlines.size();
+	// Inserted later
+	std::mt19937_64 gen(seed);
+	for (int i = 0; i < 1000; ++i)
+		deadlines.push_back(start + gen() % max_delay);
+
+	expirations e(deadlines);
+	small_wheel_t wheel(start);
+	for (std::uint32_t i = 0; i < initial; ++i)
+		wheel.insert(deadlines[i], std::uint32_t(i));
+
+	auto next_insert = initial;
+	tick_t from = start;
+	std::size_t advances = 0;
+	bool next_event_not_late = true;
+	while (auto next = wheel.next_event_tick()) {
+		// Never sleeps past a deadline
+		for (std::uint32_t i = 0; i < next_insert; ++i)
+			if (!e.fired[i] && deadlines[i] < next.get() && deadlines[i] >= from)
+				next_event_not_late = false;
+
+		const auto to = next.get();
+		wheel.advance(to, [&](std::uint32_t id) { e.expire(id, from, to); });
+		from = to + 1;
+		++advances;
+
+		if (next_insert < deadlines.size() && advances % 4 == 0) {
+			// Past deadlines expire on the next advance
+			const auto id = static_cast<std::uint32_t>(next_insert++);
+			if (deadlines[id] < from)
+				deadlines[id] = from - 1 - deadlines[id] % 8;
+			wheel.insert(deadlines[id], std::uint32_t(id));
+		}
+	}
+	for (; next_insert < deadlines.size(); ++next_insert)
+		wheel.insert(deadlines[next_insert], static_cast<std::uint32_t>(next_insert));
+	const auto end = from + max_delay + range;
+	wheel.advance(end, [&](std::uint32_t id) { e.expire(id, 0, end); });
+
+	ctx.check(e.each_once(), "Timers didn't expire exactly once when advancing to event ticks");
+	ctx.check(!e.early, "Timers expired early when advancing to event ticks");
+	ctx.check(next_event_not_late, "Next event tick is later than a pending deadline");
+	ctx.check(wheel.empty(), "Wheel isn't empty");
+
+	// At most an event per expired timer, plus a cascade and a revolution event per revolution
+	const auto revolutions = (from - start) >> slot_bits;
+	std::ostringstream msg;
+	msg << "Too many wheel events, " << advances << " for " << deadlines.size() << " timers over " << revolutions
+		<< " revolutions";
+	ctx.check(advances <= deadlines.size() + 2 * (revolutions + 1), msg.str());
+}
+
+/**
+ *	@brief	100k pending timers, advanced frame by frame. Compared with walking a list of all pending timers every frame,
+ *			which the scheduler did before the wheel.
+ */
+void benchmark(tests::test_context &ctx) {
+	constexpr std::size_t count = 100000;
+	constexpr tick_t frame = 16;
+	constexpr tick_t max_delay = 2000;
+
+	const auto deadlines = random_deadlines(count, 0, max_delay, 7);
+
+	std::size_t wheel_fired = 0;
+	auto start = clock_t::now();
+	{
+		wheel_t wheel;
+		for (std::uint32_t i = 0; i < count; ++i)
+			wheel.insert(deadlines[i], std::uint32_t(i));
+		for (tick_t t = 0; t <= max_delay + frame; t += frame)
+			wheel.advance(t, [&](std::uint32_t) { ++wheel_fired; });
+	}
+	const auto wheel_ms = elapsed_ms(start);
+
+	std::size_t list_fired = 0;
+	start = clock_t::now();
+	{
+		std::list<std::pair<tick_t, std::uint32_t>> pending;
+		for (std::uint32_t i = 0; i < count; ++i)
+			pending.push_front({ deadlines[i], i });
+		for (tick_t t = 0; t <= max_delay + frame; t += frame) {
+			for (auto it = pending.begin(); it != pending.end();) {
+				if (it->first <= t) {
+					++list_fired;
+					it = pending.erase(it);
+				}
+				else
+					++it;
+			}
+		}
+	}
+	const auto list_ms = elapsed_ms(start);
+
+	ctx.check(wheel_fired == count && list_fired == count, "Benchmark timers didn't all expire");
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(2)
+		<< count << " timers over " << max_delay << " ticks, " << frame << " ticks per frame: timer_wheel " << wheel_ms
+		<< " ms, list walk " << list_ms << " ms";
+	ctx.report(msg.str());
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void timer_wheel_test(test_context &ctx) {
+	single_tick_test(ctx, 0, 300, 1);
+	single_tick_test(ctx, 0, 70000, 2);
+	// Not aligned to a revolution
+	single_tick_test(ctx, 65530, 70000, 3);
+
+	next_event_test(ctx, 4);
+	next_event_test(ctx, 5);
+
+	benchmark(ctx);
+}
+
+}
+}
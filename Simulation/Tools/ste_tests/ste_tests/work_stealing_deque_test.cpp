@@ -0,0 +1,240 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#include <stdafx.hpp>
+#include "ste_test.hpp"
+
+#include <lib/work_stealing_deque.hpp>
+#include <lib/concurrent_queue.hpp>
+#include <lib/vector.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace ste;
+
+namespace {
+
+using clock_t = std::chrono::high_resolution_clock;
+
+double elapsed_ms(clock_t::time_point start) {
+	return std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+}
+
+void ordering_test(tests::test_context &ctx) {
+	lib::work_stealing_deque<int> deque;
+
+	// Enough elements to grow the circular buffer a few times
+	constexpr int count = 1000;
+	for (int i = 0; i < count; ++i)
+		deque.push(int(i));
+
+	// Owner pops LIFO, thieves steal FIFO
+	bool fifo = true, lifo = true;
+	for (int i = 0; i < count / 2; ++i) {
+		const auto s = deque.steal();
+		fifo &= s && *s == i;
+	}
+	for (int i = count - 1; i >= count / 2; --i) {
+		const auto p = deque.pop();
+		lifo &= p && *p == i;
+	}
+	ctx.check(fifo, "Steals aren't FIFO");
+	ctx.check(lifo, "Pops aren't LIFO");
+	ctx.check(deque.is_empty_hint() && !deque.pop() && !deque.steal(), "Deque isn't empty");
+
+	// Wrap around the buffer
+	bool wrapped = true;
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < 48; ++i)
+			deque.push(int(i));
+		for (int i = 0; i < 48; ++i) {
+			const auto s = deque.steal();
+			wrapped &= s && *s == i;
+		}
+	}
+	ctx.check(wrapped && deque.is_empty_hint(), "Elements lost when wrapping around the buffer");
+}
+
+/**
+ *	@brief	The owner pushes and pops while thieves steal. Every element must be consumed exactly once.
+ *
+ *	@return	Elapsed time, in milliseconds
+ */
+double contended_deque(tests::test_context &ctx, int count, int thieves) {
+	lib::work_stealing_deque<int> deque;
+	lib::vector<std::atomic<int>> consumed(count);
+	for (auto &c : consumed)
+		c.store(0);
+
+	std::atomic<bool> done{ false };
+	std::atomic<int> remaining{ count };
+	lib::vector<std::thread> threads;
+
+	const auto start = clock_t::now();
+	for (int t = 0; t < thieves; ++t) {
+		threads.emplace_back([&]() {
+			while (!done.load(std::memory_order_acquire)) {
+				if (auto p = deque.steal()) {
+					consumed[*p].fetch_add(1);
+					remaining.fetch_sub(1);
+				}
+			}
+		});
+	}
+
+	// Owner: Pushes in batches, as a worker spawning tasks does, and pops half of each batch itself
+	constexpr int batch = 64;
+	for (int i = 0; i < count; i += batch) {
+		const auto end = std::min(i + batch, count);
+		for (int j = i; j < end; ++j)
+			deque.push(int(j));
+		for (int j = i; j < end; j += 2) {
+			if (auto p = deque.pop()) {
+				consumed[*p].fetch_add(1);
+				remaining.fetch_sub(1);
+			}
+		}
+	}
+	while (auto p = deque.pop()) {
+		consumed[*p].fetch_add(1);
+		remaining.fetch_sub(1);
+	}
+	while (remaining.load() > 0)
+		std::this_thread::yield();
+	const auto ms = elapsed_ms(start);
+
+	done.store(true, std::memory_order_release);
+	for (auto &t : threads)
+		t.join();
+
+	bool once = true;
+	for (auto &c : consumed)
+		once &= c.load() == 1;
+	ctx.check(once, "Elements weren't consumed exactly once with " + std::to_string(thieves) + " thieves");
+
+	return ms;
+}
+
+/**
+ *	@brief	Same workload through the shared concurrent_queue balanced_thread_pool used before the deques
+ */
+double contended_queue(tests::test_context &ctx, int count, int consumers) {
+	lib::concurrent_queue<int> queue;
+	lib::vector<std::atomic<int>> consumed(count);
+	for (auto &c : consumed)
+		c.store(0);
+
+	std::atomic<bool> done{ false };
+	std::atomic<int> remaining{ count };
+	lib::vector<std::thread> threads;
+
+	const auto start = clock_t::now();
+	for (int t = 0; t < consumers; ++t) {
+		threads.emplace_back([&]() {
+			while (!done.load(std::memory_order_acquire)) {
+				if (auto p = queue.pop()) {
+					consumed[*p].fetch_add(1);
+					remaining.fetch_sub(1);
+				}
+			}
+		});
+	}
+
+	constexpr int batch = 64;
+	for (int i = 0; i < count; i += batch) {
+		const auto end = std::min(i + batch, count);
+		for (int j = i; j < end; ++j)
+			queue.push(int(j));
+		for (int j = i; j < end; j += 2) {
+			if (auto p = queue.pop()) {
+				consumed[*p].fetch_add(1);
+				remaining.fetch_sub(1);
+			}
+		}
+	}
+	while (auto p = queue.pop()) {
+		consumed[*p].fetch_add(1);
+		remaining.fetch_sub(1);
+	}
+	while (remaining.load() > 0)
+		std::this_thread::yield();
+	const auto ms = elapsed_ms(start);
+
+	done.store(true, std::memory_order_release);
+	for (auto &t : threads)
+		t.join();
+
+	bool once = true;
+	for (auto &c : consumed)
+		once &= c.load() == 1;
+	ctx.check(once, "Queue elements weren't consumed exactly once");
+
+	return ms;
+}
+
+/**
+ *	@brief	Uncontended push/pop throughput of the owning thread
+ */
+void owner_benchmark(tests::test_context &ctx) {
+	constexpr int rounds = 2000;
+	constexpr int depth = 256;
+
+	lib::work_stealing_deque<int> deque;
+	auto start = clock_t::now();
+	for (int r = 0; r < rounds; ++r) {
+		for (int i = 0; i < depth; ++i)
+			deque.push(int(i));
+		while (deque.pop()) {}
+	}
+	const auto deque_ms = elapsed_ms(start);
+
+	lib::concurrent_queue<int> queue;
+	start = clock_t::now();
+	for (int r = 0; r < rounds; ++r) {
+		for (int i = 0; i < depth; ++i)
+			queue.push(int(i));
+		while (queue.pop()) {}
+	}
+	const auto queue_ms = elapsed_ms(start);
+
+	std::ostringstream msg;
+	msg << std::fixed << std::setprecision(2)
+		<< "owner push+pop, " << rounds * depth << " elements: work_stealing_deque " << deque_ms << " ms, concurrent_queue "
+		<< queue_ms << " ms";
+	ctx.report(msg.str());
+}
+
+}
+
+namespace ste {
+namespace tests {
+
+void work_stealing_deque_test(test_context &ctx) {
+	ordering_test(ctx);
+	owner_benchmark(ctx);
+
+	constexpr int count = 200000;
+	// A single thief, a quad-core's worth and every hardware thread busy
+	lib::vector<unsigned> consumers = { 1u, 3u, std::max(2u, std::thread::hardware_concurrency()) - 1 };
+	std::sort(consumers.begin(), consumers.end());
+	consumers.erase(std::unique(consumers.begin(), consumers.end()), consumers.end());
+
+	for (auto thieves : consumers) {
+		const auto deque_ms = contended_deque(ctx, count, static_cast<int>(thieves));
+		const auto queue_ms = contended_queue(ctx, count, static_cast<int>(thieves));
+
+		std::ostringstream msg;
+		msg << std::fixed << std::setprecision(2)
+			<< "owner and " << thieves << " consumers, " << count << " elements: work_stealing_deque " << deque_ms
+			<< " ms, concurrent_queue " << queue_ms << " ms";
+		ctx.report(msg.str());
+	}
+}
+
+}
+}
@@ -50,11 +50,11 @@ public:
 			   gl::device_pipeline_graphics_configurations{},
 			   std::move(fb_layout),
 			   "fullscreen_triangle.vert", "loading.frag"),
-		photo(resource::surface_factory::image_from_surface_2d<gl::format::r8g8b8a8_unorm>(rs.get_creating_context(),
-																						   resource::surface_convert::convert_2d<gl::format::r8g8b8a8_srgb>(resource::surface_io::load_surface_2d("Data/loading.jpeg", true)),
-																						   gl::image_usage::sampled,
-																						   gl::image_layout::shader_read_only_optimal,
-																						   "loading_background_photo"))
+		photo(resource::surface_factory::image_from_surface_2d_srgb<gl::format::r8g8b8a8_unorm>(rs.get_creating_context(),
+																								"Data/loading.jpeg",
+																								gl::image_usage::sampled,
+																								gl::image_layout::shader_read_only_optimal,
+																								"loading_background_photo"))
 	{
 		pipeline()["sam"] = gl::bind(gl::pipeline::combined_image_sampler(photo,
 																		  rs.get_creating_context().device().common_samplers_collection().linear_clamp_sampler()));
@@ -313,6 +313,7 @@ auto requested_device_features() {
 	requested_features.samplerAnisotropy = VK_TRUE;
 	requested_features.shaderStorageImageExtendedFormats = VK_TRUE;
 	requested_features.shaderImageGatherExtended = VK_TRUE;
+	requested_features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
 	requested_features.sparseBinding = VK_TRUE;
 	requested_features.sparseResidencyBuffer = VK_TRUE;
 	requested_features.tessellationShader = VK_TRUE;
@@ -9,8 +9,10 @@
 
 #pragma once
 
-#include <lru_cache_cacheable.hpp>
+#include <lru_cache_blob.hpp>
 #include <lru_cache_index.hpp>
+#include <lru_cache_hot_tier.hpp>
+#include <lru_cache_file_storage.hpp>
 
 #include <lib/concurrent_queue.hpp>
 #include <interruptible_thread.hpp>
@@ -18,39 +20,81 @@
 #include <condition_variable>
 #include <atomic>
 #include <mutex>
+#include <chrono>
 #include <anchored.hpp>
 
 namespace ste {
 
+/**
+ *	@brief	Snapshot of lru_cache counters
+ */
+struct lru_cache_statistics {
+	std::uint64_t hot_tier_hits;
+	std::uint64_t disk_tier_hits;
+	std::uint64_t misses;
+	std::uint64_t insertions;
+	std::uint64_t hot_tier_evictions;
+	std::uint64_t disk_tier_evictions;
+
+	byte_t hot_tier_size;
+	byte_t disk_tier_size;
+
+	// Mean latencies of get() and insert()
+	std::chrono::nanoseconds mean_get_latency;
+	std::chrono::nanoseconds mean_insert_latency;
+};
+
 /**
  *	@brief	LRU general purpose disk caching class
  *
  *	lru_cache provides thread safe, lock-free general purpose disk caching facilities. Fetching and sotiring operations can be ran asynchronously, however it is the consumer's responsibility to synchronize insertion of 
  *	items with identical keys.
  *	lru_cache (de)serializes using boost::serialization.
- *	lru_cache keeps an offline database (index) on disk.
+ *	lru_cache keeps an offline database (index) on disk. Index modifications are appended to a journal, which is 
+ *	compacted into the index by the background thread.
+ *	Recently used objects are also kept serialized in a size-bounded, in-memory hot tier, sparing disk access.
+ *	Serialized objects are kept by the storage backend, either a file per object (lru_cache_file_storage) or packed into
+ *	memory-mapped segment files (lru_cache_pack_storage).
  *
- *	@param K	key type
+ *	@param K		key type
+ *	@param Storage	storage backend
  */
-template <typename K>
+template <typename K, typename Storage = lru_cache_file_storage>
 class lru_cache : anchored {
 private:
 	using key_type = K;
-	using index_type = lru_cache_index<key_type>;
+	using index_type = lru_cache_index<key_type, Storage>;
 	using cacheable = typename index_type::val_type;
+	using hot_tier_type = lru_cache_hot_tier<key_type>;
+	using latency_clock_t = std::chrono::high_resolution_clock;
 
-	static constexpr std::uint64_t write_index_every_ops = 10;
+	// Upper bound on the background thread's sleep, guards against a missed notification
+	static constexpr auto background_thread_max_wait = std::chrono::milliseconds(100);
 
 private:
-	struct shared_data_t {
-		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> ops{ 0 };
+	struct counters_t {
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> hot_tier_hits{ 0 };
+		std::atomic<std::uint64_t> disk_tier_hits{ 0 };
+		std::atomic<std::uint64_t> misses{ 0 };
+		std::atomic<std::uint64_t> get_time_ns{ 0 };
+
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> insertions{ 0 };
+		std::atomic<std::uint64_t> insert_time_ns{ 0 };
 
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> disk_tier_evictions{ 0 };
+	};
+
+	struct shared_data_t {
 		mutable std::mutex m;
 		mutable std::condition_variable cv;
 
 		mutable lib::concurrent_queue<typename index_type::val_data_guard> accessed_queue;
+		// Replaced items, pending retirement
+		mutable lib::concurrent_queue<typename index_type::val_data_guard> retired_queue;
 
 		std::atomic<std::uint64_t> total_size{ 0 };
+
+		mutable counters_t counters;
 	};
 
 private:
@@ -59,6 +103,7 @@ private:
 	shared_data_t shared_data;
 
 	index_type index;
+	mutable hot_tier_type hot_tier;
 
 	interruptible_thread t;
 
@@ -76,6 +121,42 @@ private:
 		shared_data.cv.notify_one();
 	}
 
+	static std::uint64_t elapsed_ns(const latency_clock_t::time_point &start) {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency_clock_t::now() - start).count());
+	}
+
+	void process_index_updates() {
+		for (auto retired_item = shared_data.retired_queue.pop(); retired_item != nullptr; retired_item = shared_data.retired_queue.pop()) {
+			index.retire(**retired_item);
+			shared_data.total_size.fetch_sub(static_cast<std::size_t>((*retired_item)->get_size()), std::memory_order_relaxed);
+		}
+
+		for (auto accessed_item = shared_data.accessed_queue.pop(); accessed_item != nullptr; accessed_item = shared_data.accessed_queue.pop())
+			index.move_to_lru_front(**accessed_item);
+
+		auto ts = byte_t(shared_data.total_size.load(std::memory_order_relaxed));
+		while (ts > this->quota && this->quota) {
+			auto size = this->index.erase_back();
+			if (!size)
+				break;
+
+			ts = byte_t(shared_data.total_size.fetch_sub(static_cast<std::size_t>(size), std::memory_order_relaxed)) - size;
+			shared_data.counters.disk_tier_evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		try {
+			this->index.compact_storage();
+			this->index.flush_journal();
+		}
+#ifdef _DEBUG
+		catch (const std::exception &e) {
+			std::cerr << "lru_cache: Failed writing journal: " << e.what() << std::endl;
+#else
+		catch (const std::exception &) {
+#endif
+		}
+	}
+
 public:
 	lru_cache(lru_cache &&) = delete;
 	lru_cache(const lru_cache &) = delete;
@@ -86,49 +167,70 @@ public:
 	*	@brief	lru_cache ctor
 	*
 	* 	@param path		Cache directory
-	*	@param quota	Max size in bytes. 0 for unlimited.
+	*	@param quota			Max size in bytes. 0 for unlimited.
+	*	@param hot_tier_quota	Max size in bytes of the in-memory tier. 0 disables the tier.
 	*/
-	lru_cache(const std::experimental::filesystem::path &path, byte_t quota = 0_B)
+	lru_cache(const std::experimental::filesystem::path &path, byte_t quota = 0_B, byte_t hot_tier_quota = 0_B)
 		: path(path),
 		quota(quota),
 		index(path, shared_data.total_size),
+		hot_tier(hot_tier_quota),
 		t([this] ()
 	{
 		for (;;) {
-			if (interruptible_thread::is_interruption_flag_set()) return;
-
 			{
 				std::unique_lock<std::mutex> l(shared_data.m);
-				shared_data.cv.wait(l);
+				shared_data.cv.wait_for(l, background_thread_max_wait, [this]() {
+					return !shared_data.accessed_queue.is_empty_hint() ||
+						!shared_data.retired_queue.is_empty_hint() ||
+						interruptible_thread::is_interruption_flag_set();
+				});
 			}
 
-			auto accessed_item = shared_data.accessed_queue.pop();
-			while (accessed_item != nullptr) {
-				index.move_to_lru_front(**accessed_item);
-				accessed_item = shared_data.accessed_queue.pop();
-			}
-
-			auto ts = byte_t(shared_data.total_size.load(std::memory_order_relaxed));
-			while (ts > this->quota && this->quota) {
-				auto size = this->index.erase_back();
-				assert(size);
-				if (!size)
-					break;
+			process_index_updates();
 
-				ts = byte_t(shared_data.total_size.fetch_sub(static_cast<std::size_t>(size), std::memory_order_relaxed));
-			}
-
-			if (shared_data.ops.load(std::memory_order_relaxed) > write_index_every_ops) {
-				shared_data.ops.store(0, std::memory_order_release);
-
-				this->index.write_index();
-			}
+			// Interruption is checked only after processing, so that accesses pending on shutdown are not lost.
+			if (interruptible_thread::is_interruption_flag_set()) return;
 		}
 	}) 
 	{
 		std::experimental::filesystem::create_directory(path);
 	}
-	~lru_cache() noexcept { shutdown(); }
+	~lru_cache() noexcept {
+		shutdown();
+
+		using namespace text::attributes;
+		const auto stats = get_statistics();
+		ste_log() << b("LRU Cache: ") + i(lib::to_string(path.string())) + 
+			" - hot tier hits: " + lib::to_string(stats.hot_tier_hits) +
+			", disk tier hits: " + lib::to_string(stats.disk_tier_hits) +
+			", misses: " + lib::to_string(stats.misses) +
+			", mean get latency: " + lib::to_string(stats.mean_get_latency.count()) + "ns" + 
+			", mean insert latency: " + lib::to_string(stats.mean_insert_latency.count()) + "ns" << std::endl;
+	}
+
+	/**
+	*	@brief	Returns a snapshot of the cache's hit/miss and latency counters.
+	*/
+	lru_cache_statistics get_statistics() const {
+		const auto &c = shared_data.counters;
+
+		lru_cache_statistics stats;
+		stats.hot_tier_hits = c.hot_tier_hits.load(std::memory_order_relaxed);
+		stats.disk_tier_hits = c.disk_tier_hits.load(std::memory_order_relaxed);
+		stats.misses = c.misses.load(std::memory_order_relaxed);
+		stats.insertions = c.insertions.load(std::memory_order_relaxed);
+		stats.hot_tier_evictions = hot_tier.get_evictions_count();
+		stats.disk_tier_evictions = c.disk_tier_evictions.load(std::memory_order_relaxed);
+		stats.hot_tier_size = hot_tier.get_size();
+		stats.disk_tier_size = byte_t(static_cast<std::size_t>(shared_data.total_size.load(std::memory_order_relaxed)));
+
+		const auto gets = stats.hot_tier_hits + stats.disk_tier_hits + stats.misses;
+		stats.mean_get_latency = std::chrono::nanoseconds(gets ? c.get_time_ns.load(std::memory_order_relaxed) / gets : 0);
+		stats.mean_insert_latency = std::chrono::nanoseconds(stats.insertions ? c.insert_time_ns.load(std::memory_order_relaxed) / stats.insertions : 0);
+
+		return stats;
+	}
 
 	/**
 	*	@brief	Store an object in the cache
@@ -138,10 +240,16 @@ public:
 	*/
 	template <typename V>
 	void insert(const key_type &k, V &&v) {
+		const auto start = latency_clock_t::now();
+
+		typename index_type::val_data_guard replaced_guard{ 0 };
 		try {
-			cacheable item(k, path);
-			item.archive(std::forward<V>(v));
-			index.insert(k, std::move(item));
+			auto blob = lib::allocate_shared<lru_cache_blob>(lru_cache_serialize(std::forward<V>(v)));
+
+			cacheable item(k, index.storage.write(*blob));
+			replaced_guard = index.insert(k, std::move(item));
+
+			hot_tier.insert(k, lru_cache_blob_view(std::move(blob)));
 		}
 #ifdef _DEBUG
 		catch (const std::exception &e) {
@@ -152,6 +260,9 @@ public:
 			return;
 		}
 
+		if (replaced_guard.is_valid())
+			shared_data.retired_queue.push(std::move(replaced_guard));
+
 		std::atomic_thread_fence(std::memory_order_acquire);
 		auto val_guard = index.map.try_get(k);
 		if (!val_guard.is_valid())
@@ -162,7 +273,8 @@ public:
 		shared_data.total_size.fetch_add(static_cast<std::size_t>(item_size), std::memory_order_relaxed);
 		item_accessed(std::move(val_guard));
 
-		++shared_data.ops;
+		shared_data.counters.insertions.fetch_add(1, std::memory_order_relaxed);
+		shared_data.counters.insert_time_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
 	}
 
 	/**
@@ -172,18 +284,39 @@ public:
 	*/
 	template <typename V>
 	optional<V> get(const key_type &k) const {
+		const auto start = latency_clock_t::now();
+		auto &counters = shared_data.counters;
+
 		auto val_guard = this->index.map[k];
-		if (!val_guard.is_valid())
-			return none;
 
 		try {
-			auto v = val_guard->template unarchive<V>();
-			if (v) {
-				this->item_accessed(std::move(val_guard));
+			// Hot tier
+			auto hot_blob = hot_tier.get(k);
+			if (hot_blob) {
+				auto v = lru_cache_deserialize<V>(hot_blob.get());
+				// Keep the disk tier's LRU order coherent
+				if (val_guard.is_valid())
+					this->item_accessed(std::move(val_guard));
+
+				counters.hot_tier_hits.fetch_add(1, std::memory_order_relaxed);
+				counters.get_time_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
 				return std::move(v);
 			}
 
-			return none;
+			// Disk tier
+			if (val_guard.is_valid()) {
+				auto blob = index.storage.read(val_guard->get_record());
+				if (blob) {
+					auto v = lru_cache_deserialize<V>(blob.get());
+
+					hot_tier.insert(k, std::move(blob.get()));
+					this->item_accessed(std::move(val_guard));
+
+					counters.disk_tier_hits.fetch_add(1, std::memory_order_relaxed);
+					counters.get_time_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+					return std::move(v);
+				}
+			}
 		}
 #ifdef _DEBUG
 		catch (const std::exception &e) {
@@ -191,8 +324,11 @@ public:
 #else
 		catch (const std::exception &) {
 #endif
-			return none;
 		}
+
+		counters.misses.fetch_add(1, std::memory_order_relaxed);
+		counters.get_time_ns.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+		return none;
 	}
 };
 
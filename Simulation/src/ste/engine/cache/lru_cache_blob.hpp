@@ -0,0 +1,104 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+/**	@file	lru_cache_blob.hpp
+ *	@brief	lru_cache serialized objects
+ *
+ *	@author	Shlomi Steinberg
+ */
+
+#pragma once
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <lib/vector.hpp>
+#include <lib/shared_ptr.hpp>
+#include <streambuf>
+
+namespace ste {
+
+/**
+ *	@brief	Serialized cached object
+ */
+using lru_cache_blob = lib::vector<char>;
+
+/**
+ *	@brief	Read-only view of a serialized cached object. The view keeps its owner, i.e. the blob or the storage mapping
+ *			it points into, alive.
+ */
+struct lru_cache_blob_view {
+	const char *data{ nullptr };
+	std::size_t size{ 0 };
+	lib::shared_ptr<const void> owner;
+
+	lru_cache_blob_view() = default;
+	lru_cache_blob_view(const char *data, std::size_t size, lib::shared_ptr<const void> owner)
+		: data(data), size(size), owner(std::move(owner))
+	{}
+	lru_cache_blob_view(lib::shared_ptr<const lru_cache_blob> blob)
+		: data(blob->data()), size(blob->size()), owner(std::move(blob))
+	{}
+};
+
+namespace _detail {
+
+class lru_cache_blob_istreambuf : public std::streambuf {
+public:
+	lru_cache_blob_istreambuf(const char *data, std::size_t size) {
+		auto *p = const_cast<char*>(data);
+		setg(p, p, p + size);
+	}
+};
+
+class lru_cache_blob_ostreambuf : public std::streambuf {
+private:
+	lru_cache_blob &blob;
+
+protected:
+	int_type overflow(int_type c) override {
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+			blob.push_back(traits_type::to_char_type(c));
+		return traits_type::not_eof(c);
+	}
+	std::streamsize xsputn(const char_type *s, std::streamsize n) override {
+		blob.insert(blob.end(), s, s + n);
+		return n;
+	}
+
+public:
+	lru_cache_blob_ostreambuf(lru_cache_blob &blob) : blob(blob) {}
+};
+
+}
+
+/**
+ *	@brief	Serializes an object, using boost::serialization.
+ */
+template <typename V>
+lru_cache_blob lru_cache_serialize(V &&v) {
+	lru_cache_blob blob;
+	{
+		_detail::lru_cache_blob_ostreambuf sb(blob);
+		boost::archive::binary_oarchive oa(sb);
+		oa << std::forward<V>(v);
+	}
+
+	return blob;
+}
+
+/**
+ *	@brief	Deserializes an object serialized with lru_cache_serialize().
+ */
+template <typename V>
+V lru_cache_deserialize(const lru_cache_blob_view &view) {
+	_detail::lru_cache_blob_istreambuf sb(view.data, view.size);
+	boost::archive::binary_iarchive ia(sb);
+
+	V v;
+	ia >> v;
+
+	return v;
+}
+
+}
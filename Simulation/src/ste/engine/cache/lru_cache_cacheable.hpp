@@ -9,115 +9,66 @@
 
 #pragma once
 
-#include <boost/archive/basic_binary_iarchive.hpp>
-#include <boost/archive/basic_binary_oarchive.hpp>
-
-#include <filesystem>
-
-#include <lib/string.hpp>
-#include <fstream>
-#include <chrono>
+#include <lib/shared_ptr.hpp>
 #include <atomic>
-#include <lib/unique_ptr.hpp>
-#include <optional.hpp>
 
 namespace ste {
 
-template <typename K, typename lru_iterator_type>
+template <typename K, typename lru_iterator_type, typename Storage>
 class lru_cache_cacheable {
-private:
-	static constexpr auto archive_extension = ".stearchive";
+public:
+	using record_ptr = typename Storage::record_ptr;
+	using location_type = typename Storage::location_type;
 
+private:
 	K key;
-	byte_t size{ 0 };
+	// Accessed atomically, replaced on storage compaction
+	record_ptr rec;
 	lru_iterator_type lru_it;
 	std::atomic<bool> live{ false };
-
-	std::experimental::filesystem::path f;
+	// Set once the item was erased from, or replaced in, the index. A retired item is never made live again.
+	std::atomic<bool> retired{ false };
 
 public:
 	lru_cache_cacheable() = default;
 	lru_cache_cacheable(const K &k,
-						const std::experimental::filesystem::path &path) : lru_cache_cacheable() {
-		using namespace std::chrono;
-		auto tp = duration_cast<nanoseconds>(high_resolution_clock::now().time_since_epoch());
-		auto name = lib::to_string(tp.count()) + archive_extension;
-
-		f = path / name;
-		key = k;
-	}
-	lru_cache_cacheable(const K &k,
-						const std::experimental::filesystem::path &path,
-						const std::experimental::filesystem::path &file_name) : lru_cache_cacheable() {
-		f = path / file_name;
-		key = k;
-	}
-	~lru_cache_cacheable() noexcept {
-		if (!f.empty() && !live.load(std::memory_order_acquire)) {
-			std::error_code err;
-			std::experimental::filesystem::remove(f, err);
-		}
-	}
+						record_ptr rec) : key(k), rec(std::move(rec)) {}
+	~lru_cache_cacheable() noexcept {}
 
 	lru_cache_cacheable(lru_cache_cacheable &&c) noexcept
 		: key(std::move(c.key)),
-		size(c.size),
+		rec(std::atomic_load(&c.rec)),
 		lru_it(std::move(c.lru_it)),
 		live(c.live.load(std::memory_order_acquire)),
-		f(std::move(c.f))
+		retired(c.retired.load(std::memory_order_acquire))
 	{}
 	lru_cache_cacheable(const lru_cache_cacheable &c) noexcept
 		: key(c.key),
-		size(c.size),
+		rec(std::atomic_load(&c.rec)),
 		lru_it(c.lru_it),
 		live(c.live.load(std::memory_order_acquire)),
-		f(c.f)
+		retired(c.retired.load(std::memory_order_acquire))
 	{}
 
-	void replace(lru_cache_cacheable &&item) {
-		size = item.size;
-	}
-
 	void mark_live(const lru_iterator_type &it) {
 		lru_it = it;
 		live.store(true, std::memory_order_release);
-
-		std::error_code err;
-		size = byte_t(std::experimental::filesystem::file_size(f, err));
+		get_record()->set_persistent(true);
 	}
 	void mark_for_deletion() {
+		retired.store(true, std::memory_order_release);
 		live.store(false, std::memory_order_release);
+		get_record()->set_persistent(false);
 	}
 	bool is_live() const { return live.load(std::memory_order_acquire); }
+	bool is_retired() const { return retired.load(std::memory_order_acquire); }
 	const K &get_k() const { return key; }
-	auto get_size() const { return size; }
+	auto get_size() const { return get_record()->get_size(); }
 	lru_iterator_type& get_lru_it() { return lru_it; }
-	std::experimental::filesystem::path get_file_name() const { return f.filename(); }
-
-	template <typename V>
-	void archive(V &&v) {
-		{
-			std::ofstream ofs(f, std::ios::binary);
-			boost::archive::binary_oarchive oa(ofs);
-			oa << std::forward<V>(v);
-		}
+	location_type get_location() const { return get_record()->get_location(); }
 
-		std::error_code err;
-		size = byte_t(std::experimental::filesystem::file_size(f, err));
-	}
-	template <typename V>
-	optional<V> unarchive() const {
-		std::ifstream ifs(f, std::ios::binary);
-		if (ifs) {
-			boost::archive::binary_iarchive ia(ifs);
-			V v;
-			ia >> v;
-
-			return v;
-		}
-
-		return none;
-	}
+	record_ptr get_record() const { return std::atomic_load(&rec); }
+	void set_record(record_ptr r) { std::atomic_store(&rec, std::move(r)); }
 };
 
 }
@@ -0,0 +1,142 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+/**	@file	lru_cache_file_storage.hpp
+ *	@brief	lru_cache file-per-entry storage backend
+ *
+ *	@author	Shlomi Steinberg
+ */
+
+#pragma once
+
+#include <lru_cache_blob.hpp>
+
+#include <filesystem>
+
+#include <lib/string.hpp>
+#include <lib/shared_ptr.hpp>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+#include <optional.hpp>
+
+namespace ste {
+
+/**
+ *	@brief	lru_cache storage backend, storing each entry in its own archive file.
+ *
+ *	Storage backends store serialized objects and hand out records referencing them. A record is persistent while its
+ *	entry is live in the cache's index, the stored object is released once the last reference to a non-persistent
+ *	record is dropped. Backends expose a serializable location_type, written into the cache's index, from which records
+ *	are reopened.
+ */
+class lru_cache_file_storage {
+public:
+	// Archive file name
+	using location_type = lib::string;
+
+	class record {
+		friend class lru_cache_file_storage;
+
+	private:
+		std::experimental::filesystem::path f;
+		std::uint64_t size;
+		std::atomic<bool> persistent{ false };
+
+	public:
+		record(std::experimental::filesystem::path f, std::uint64_t size) : f(std::move(f)), size(size) {}
+		~record() noexcept {
+			if (!persistent.load(std::memory_order_acquire)) {
+				std::error_code err;
+				std::experimental::filesystem::remove(f, err);
+			}
+		}
+
+		record(record&&) = delete;
+		record &operator=(record&&) = delete;
+
+		void set_persistent(bool p) { persistent.store(p, std::memory_order_release); }
+		auto get_size() const { return byte_t(static_cast<std::size_t>(size)); }
+		location_type get_location() const { return lib::to_string(f.filename().string()); }
+	};
+	using record_ptr = lib::shared_ptr<record>;
+
+	/**
+	 *	@brief	Set of records to relocate on compaction. File storage never compacts.
+	 */
+	struct compaction_set {
+		bool empty() const { return true; }
+		bool contains(const record &) const { return false; }
+	};
+
+private:
+	static constexpr auto archive_extension = ".stearchive";
+
+	std::experimental::filesystem::path dir;
+
+public:
+	lru_cache_file_storage(const std::experimental::filesystem::path &dir) : dir(dir) {}
+
+	lru_cache_file_storage(lru_cache_file_storage&&) = delete;
+	lru_cache_file_storage &operator=(lru_cache_file_storage&&) = delete;
+
+	/**
+	 *	@brief	Stores a serialized object in a new archive file
+	 */
+	record_ptr write(const lru_cache_blob &blob) {
+		using namespace std::chrono;
+		auto tp = duration_cast<nanoseconds>(high_resolution_clock::now().time_since_epoch());
+		auto name = lib::to_string(tp.count()) + archive_extension;
+
+		auto rec = lib::allocate_shared<record>(dir / name, blob.size());
+		{
+			std::ofstream ofs(rec->f, std::ios::binary);
+			ofs.write(blob.data(), blob.size());
+			if (!ofs)
+				throw std::runtime_error("Failed writing archive");
+		}
+
+		return rec;
+	}
+
+	/**
+	 *	@brief	Reopens a record from its location, returns nullptr if the archive doesn't exist.
+	 */
+	record_ptr open(const location_type &location) {
+		auto f = dir / location;
+
+		std::error_code err;
+		auto size = std::experimental::filesystem::file_size(f, err);
+		if (err)
+			return nullptr;
+
+		return lib::allocate_shared<record>(std::move(f), static_cast<std::uint64_t>(size));
+	}
+
+	/**
+	 *	@brief	Called once the index has been loaded and all live records were opened.
+	 */
+	void loaded() {}
+
+	/**
+	 *	@brief	Reads the serialized object
+	 */
+	optional<lru_cache_blob_view> read(const record_ptr &rec) const {
+		std::ifstream ifs(rec->f, std::ios::binary);
+		if (!ifs)
+			return none;
+
+		auto blob = lib::allocate_shared<lru_cache_blob>(static_cast<std::size_t>(rec->size));
+		ifs.read(blob->data(), blob->size());
+		if (!ifs)
+			return none;
+
+		return lru_cache_blob_view(std::move(blob));
+	}
+
+	compaction_set compaction_candidates() { return {}; }
+	record_ptr relocate(const record &) { return nullptr; }
+};
+
+}
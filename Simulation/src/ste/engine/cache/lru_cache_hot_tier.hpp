@@ -0,0 +1,139 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+/**	@file	lru_cache_hot_tier.hpp
+ *	@brief	lru_cache in-memory tier
+ *
+ *	@author	Shlomi Steinberg
+ */
+
+#pragma once
+
+#include <lru_cache_blob.hpp>
+
+#include <lib/list.hpp>
+#include <lib/unordered_map.hpp>
+#include <lib/shared_ptr.hpp>
+#include <optional.hpp>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace ste {
+
+/**
+ *	@brief	Size-bounded, in-memory LRU tier of serialized objects, sitting in front of lru_cache's disk tier.
+ *			Sharded by key hash, each shard is guarded by its own lock and holds an equal part of the quota.
+ *
+ *	@param K	key type
+ */
+template <typename K>
+class lru_cache_hot_tier {
+private:
+	static constexpr std::size_t shards_count_log2 = 4;
+	static constexpr std::size_t shards_count = 1 << shards_count_log2;
+
+	struct entry {
+		K k;
+		lru_cache_blob_view blob;
+	};
+	using lru_list_type = lib::list<entry>;
+
+	struct shard_t {
+		alignas(std::hardware_destructive_interference_size) std::mutex m;
+		lru_list_type lru_list;
+		lib::unordered_map<K, typename lru_list_type::iterator> map;
+		std::size_t size{ 0 };
+	};
+
+private:
+	std::array<shard_t, shards_count> shards;
+	const std::size_t shard_quota;
+
+	std::atomic<std::uint64_t> total_size{ 0 };
+	std::atomic<std::uint64_t> evictions{ 0 };
+
+private:
+	shard_t &shard_for(const K &k) {
+		// Fibonacci hashing, decorrelates the shard index from the shard map's buckets
+		const auto h = static_cast<std::uint64_t>(std::hash<K>()(k));
+		return shards[static_cast<std::size_t>((h * 0x9E3779B97F4A7C15ull) >> (64 - shards_count_log2))];
+	}
+
+	void erase_entry(shard_t &s, typename lru_list_type::iterator it) {
+		const auto blob_size = it->blob.size;
+		s.size -= blob_size;
+		total_size.fetch_sub(blob_size, std::memory_order_relaxed);
+
+		s.map.erase(it->k);
+		s.lru_list.erase(it);
+	}
+
+public:
+	/**
+	*	@param quota	Max size in bytes
+	*/
+	lru_cache_hot_tier(byte_t quota) : shard_quota(static_cast<std::size_t>(quota) / shards_count) {}
+
+	lru_cache_hot_tier(lru_cache_hot_tier &&) = delete;
+	lru_cache_hot_tier &operator=(lru_cache_hot_tier &&) = delete;
+
+	/**
+	*	@brief	Looks up a key, and on hit moves it to the front of its shard's LRU list.
+	*
+	*	@return	The serialized object, or none on miss.
+	*/
+	optional<lru_cache_blob_view> get(const K &k) {
+		auto &s = shard_for(k);
+		std::unique_lock<std::mutex> l(s.m);
+
+		auto it = s.map.find(k);
+		if (it == s.map.end())
+			return none;
+
+		s.lru_list.splice(s.lru_list.begin(), s.lru_list, it->second);
+		return it->second->blob;
+	}
+
+	/**
+	*	@brief	Inserts, or replaces, a serialized object. Evicts least recently used objects from the shard as needed.
+	*			Objects larger than a shard's quota are not stored.
+	*/
+	void insert(const K &k, lru_cache_blob_view blob) {
+		auto &s = shard_for(k);
+		const auto blob_size = blob.size;
+
+		std::unique_lock<std::mutex> l(s.m);
+
+		auto it = s.map.find(k);
+		if (it != s.map.end())
+			erase_entry(s, it->second);
+		if (blob_size > shard_quota)
+			return;
+
+		while (s.size + blob_size > shard_quota) {
+			erase_entry(s, std::prev(s.lru_list.end()));
+			evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		s.lru_list.push_front({ k, std::move(blob) });
+		s.map.emplace(k, s.lru_list.begin());
+		s.size += blob_size;
+		total_size.fetch_add(blob_size, std::memory_order_relaxed);
+	}
+
+	void erase(const K &k) {
+		auto &s = shard_for(k);
+		std::unique_lock<std::mutex> l(s.m);
+
+		auto it = s.map.find(k);
+		if (it != s.map.end())
+			erase_entry(s, it->second);
+	}
+
+	auto get_size() const { return byte_t(static_cast<std::size_t>(total_size.load(std::memory_order_relaxed))); }
+	auto get_evictions_count() const { return evictions.load(std::memory_order_relaxed); }
+};
+
+}
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <lru_cache_cacheable.hpp>
+#include <lru_cache_journal.hpp>
 
 #include <log.hpp>
 #include <attributed_string.hpp>
@@ -22,48 +23,62 @@
 
 #include <lib/list.hpp>
 #include <lib/string.hpp>
+#include <lib/unordered_map.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include <exception>
 
 namespace ste {
 
-template <typename K>
+template <typename K, typename Storage>
 class lru_cache;
 
-template <typename K>
+template <typename K, typename Storage>
 class lru_cache_index {
 private:
-	friend class lru_cache<K>;
+	friend class lru_cache<K, Storage>;
 
 	static constexpr auto index_file = "index.dat";
+	static constexpr auto index_temp_file = "index.dat.tmp";
+
+	// The journal is compacted into the index once it holds more than max(min, ratio*items) records
+	static constexpr std::size_t journal_compaction_min_records = 1024;
+	static constexpr std::size_t journal_compaction_ratio = 2;
 
 	using key_type = K;
+	using storage_type = Storage;
+	using location_type = typename storage_type::location_type;
+	using journal_type = lru_cache_journal<key_type, location_type>;
 
 	struct lru_node {
 		friend class boost::serialization::access;
 		template<class Archive>
 		void serialize(Archive & ar, const unsigned int version) {
 			ar & k;
-			ar & name;
+			ar & location;
 		}
 
 		key_type k;
-		lib::string name;
+		location_type location;
 	};
 
 private:
 	using lru_list_type = lib::list<lru_node>;
 	using lru_list_iterator_type = typename lru_list_type::const_iterator;
-	using val_type = lru_cache_cacheable<key_type, lru_list_iterator_type>;
+	using val_type = lru_cache_cacheable<key_type, lru_list_iterator_type, storage_type>;
 
 	using res_kv_map = lib::concurrent_unordered_map<key_type, val_type>;
 	using val_data_guard = typename res_kv_map::value_data_guard_type;
 
+	storage_type storage;
+
 	lru_list_type lru_list;
 	res_kv_map map;
 
 	std::experimental::filesystem::path index_path;
+	std::experimental::filesystem::path index_temp_path;
+	journal_type journal;
 
 private:
 	friend class boost::serialization::access;
@@ -73,31 +88,110 @@ private:
 	}
 
 	void write_index() const {
-		std::ofstream ofs(index_path.string(), std::ios::binary);
-		boost::archive::binary_oarchive oa(ofs);
-		oa << *this;
+		{
+			std::ofstream ofs(index_temp_path.string(), std::ios::binary);
+			boost::archive::binary_oarchive oa(ofs);
+			oa << *this;
+		}
+
+		std::experimental::filesystem::rename(index_temp_path, index_path);
+	}
+
+	/**
+	*	@brief	Writes the index and discards the journal
+	*/
+	void compact() {
+		write_index();
+		journal.truncate();
+	}
+
+	/**
+	*	@brief	Appends journaled modifications to the journal file, and compacts the journal once it grows large
+	*/
+	void flush_journal() {
+		journal.flush();
+
+		const auto threshold = std::max(journal_compaction_min_records,
+										journal_compaction_ratio * lru_list.size());
+		if (journal.size() > threshold)
+			compact();
 	}
 
-	auto populate_map(const std::experimental::filesystem::path &path) {
+	void replay_journal() {
+		lib::unordered_map<key_type, typename lru_list_type::iterator> nodes;
+		for (auto it = lru_list.begin(); it != lru_list.end(); ++it)
+			nodes.emplace(it->k, it);
+
+		journal.replay([&](const typename journal_type::record &r) {
+			auto it = nodes.find(r.k);
+			switch (r.o) {
+			case journal_type::op::insert:
+				if (it != nodes.end()) {
+					it->second->location = r.location;
+					lru_list.splice(lru_list.begin(), lru_list, it->second);
+				}
+				else {
+					lru_list.push_front({ r.k, r.location });
+					nodes.emplace(r.k, lru_list.begin());
+				}
+				break;
+			case journal_type::op::relocate:
+				if (it != nodes.end())
+					it->second->location = r.location;
+				break;
+			case journal_type::op::touch:
+				if (it != nodes.end())
+					lru_list.splice(lru_list.begin(), lru_list, it->second);
+				break;
+			case journal_type::op::erase:
+				if (it != nodes.end()) {
+					lru_list.erase(it->second);
+					nodes.erase(it);
+				}
+				break;
+			}
+		});
+	}
+
+	auto populate_map() {
 		auto size = 0_B;
-		for (lru_list_iterator_type it = lru_list.begin(); it != lru_list.end(); ++it) {
+		for (lru_list_iterator_type it = lru_list.begin(); it != lru_list.end();) {
+			auto rec = storage.open(it->location);
+			if (rec == nullptr) {
+				// Stored object is gone, drop the node
+				it = lru_list.erase(it);
+				continue;
+			}
+
 			auto &k = it->k;
-			val_type v(k, path, it->name);
+			val_type v(k, std::move(rec));
 			v.mark_live(it);
 			size += v.get_size();
 			map.emplace(k, std::move(v));
+
+			++it;
 		}
 
 		return size;
 	}
 
-	lru_cache_index(const std::experimental::filesystem::path &path, std::atomic<std::uint64_t> &total_size) : index_path(path / index_file) {
-		if (std::experimental::filesystem::exists(index_path)) {
+	lru_cache_index(const std::experimental::filesystem::path &path, std::atomic<std::uint64_t> &total_size) 
+		: storage(path),
+		index_path(path / index_file),
+		index_temp_path(path / index_temp_file),
+		journal(path)
+	{
+		if (std::experimental::filesystem::exists(index_path) || journal.exists()) {
 			try {
-				std::ifstream ifs(index_path.string(), std::ios::binary);
-				boost::archive::binary_iarchive ia(ifs);
-				ia >> *this;
-				total_size = static_cast<std::uint64_t>(populate_map(path));
+				if (std::experimental::filesystem::exists(index_path)) {
+					std::ifstream ifs(index_path.string(), std::ios::binary);
+					boost::archive::binary_iarchive ia(ifs);
+					ia >> *this;
+				}
+				replay_journal();
+
+				total_size = static_cast<std::uint64_t>(populate_map());
+				compact();
 			} catch (const std::exception &e) {
 				using namespace text::attributes;
 				ste_log_warn() << b("LRU Cache: ") + "Failed reading index (Reason: " + e.what() + "). Clearing " + i(lib::to_string(path.string())) + "." << std::endl;
@@ -106,37 +200,87 @@ private:
 					std::experimental::filesystem::remove(it->path());
 			}
 		}
+
+		storage.loaded();
 	}
 
 	~lru_cache_index() noexcept {
 		try {
-			write_index();
-		} catch (std::runtime_error) {}
+			compact();
+		} catch (const std::exception &) {}
 	}
 
 	void move_to_lru_front(val_type &v) {
-		if (v.is_live())
+		if (v.is_retired())
+			return;
+
+		if (v.is_live()) {
 			lru_list.splice(lru_list.cbegin(), lru_list, v.get_lru_it());
+			journal.append(journal_type::op::touch, v.get_k());
+		}
 		else {
 			auto node = lru_node{
 				v.get_k(),
-				lib::to_string(v.get_file_name().string())
+				v.get_location()
 			};
-			lru_list.push_back(std::move(node));
+			journal.append(journal_type::op::insert, node.k, node.location);
+
+			lru_list.push_front(std::move(node));
 			v.mark_live(lru_list.cbegin());
 		}
 	}
 
-	void insert(const key_type &k, val_type &&v) {
+	/**
+	*	@brief	Inserts an item, replacing the existing item with the same key, if any.
+	*
+	*	@return	Guard to the replaced item, if any. Replaced items should be retired with retire().
+	*/
+	val_data_guard insert(const key_type &k, val_type &&v) {
 		auto val_guard = map[k];
-		if (!val_guard.is_valid()) {
-			// Key doesn't exist, insert new
-			map.emplace(k, std::move(v));
+		map.emplace(k, std::move(v));
+
+		return val_guard;
+	}
+
+	/**
+	*	@brief	Relocates live objects out of the storage's compaction candidates.
+	*			Readers holding the old records keep reading the old copies until they release them.
+	*/
+	void compact_storage() {
+		auto set = storage.compaction_candidates();
+		if (set.empty())
 			return;
+
+		for (auto it = lru_list.begin(); it != lru_list.end(); ++it) {
+			auto val_guard = map[it->k];
+			if (!val_guard.is_valid() ||
+				!val_guard->is_live() ||
+				val_guard->get_lru_it() != lru_list_iterator_type(it))
+				continue;
+
+			auto rec = val_guard->get_record();
+			if (!set.contains(*rec))
+				continue;
+
+			auto relocated = storage.relocate(*rec);
+			relocated->set_persistent(true);
+			val_guard->set_record(relocated);
+			rec->set_persistent(false);
+
+			it->location = relocated->get_location();
+			journal.append(journal_type::op::relocate, it->k, it->location);
 		}
+	}
 
-		// Key exists, replace with new data
-		val_guard->replace(std::move(v));
+	/**
+	*	@brief	Retires a replaced item. Its stored object is released once the last reference to it is released.
+	*/
+	void retire(val_type &v) {
+		if (v.is_live()) {
+			lru_list.erase(v.get_lru_it());
+			journal.append(journal_type::op::erase, v.get_k());
+		}
+		v.mark_for_deletion();
 	}
 
 	byte_t erase(const key_type &k) {
@@ -146,6 +290,7 @@ private:
 
 		map.remove(k);
 		lru_list.erase(val_guard->get_lru_it());
+		journal.append(journal_type::op::erase, k);
 		val_guard->mark_for_deletion();
 		return val_guard->get_size();
 	}
@@ -154,6 +299,13 @@ private:
 		if (!lru_list.size()) return 0_B;
 		auto k = lru_list.back().k;
 
+		// The back node might belong to an item that was replaced and is pending retirement
+		auto val_guard = map[k];
+		if (!val_guard.is_valid() || 
+			!val_guard->is_live() || 
+			val_guard->get_lru_it() != std::prev(lru_list.cend()))
+			return 0_B;
+
 		return erase(k);
 	}
 };
@@ -0,0 +1,146 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+/**	@file	lru_cache_journal.hpp
+ *	@brief	lru_cache append-only index journal
+ *
+ *	@author	Shlomi Steinberg
+ */
+
+#pragma once
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <filesystem>
+
+#include <lib/string.hpp>
+#include <lib/vector.hpp>
+#include <fstream>
+#include <exception>
+
+namespace ste {
+
+/**
+ *	@brief	Append-only journal of lru_cache index modifications.
+ *			Records are buffered and appended to the journal file in batches, each batch is a self-contained archive. A
+ *			torn trailing batch is discarded on replay.
+ *
+ *			Not thread-safe.
+ */
+template <typename K, typename Location>
+class lru_cache_journal {
+public:
+	enum class op : std::uint8_t {
+		// Item inserted (or replaced) and moved to LRU front
+		insert,
+		// Item moved to LRU front
+		touch,
+		// Item erased
+		erase,
+		// Item's stored object relocated, LRU position unchanged
+		relocate,
+	};
+
+	struct record {
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive & ar, const unsigned int version) {
+			ar & o;
+			ar & k;
+			ar & location;
+		}
+
+		op o;
+		K k;
+		Location location;
+	};
+
+private:
+	static constexpr auto journal_file = "index.journal";
+
+private:
+	std::experimental::filesystem::path journal_path;
+	lib::vector<record> pending;
+	std::size_t records_written{ 0 };
+
+public:
+	lru_cache_journal(const std::experimental::filesystem::path &path) : journal_path(path / journal_file) {}
+	~lru_cache_journal() noexcept {}
+
+	lru_cache_journal(lru_cache_journal&&) = default;
+	lru_cache_journal &operator=(lru_cache_journal&&) = default;
+
+	void append(op o, const K &k, Location location = {}) {
+		pending.push_back({ o, k, std::move(location) });
+	}
+
+	/**
+	 *	@brief	Appends all pending records to the journal file
+	 */
+	void flush() {
+		if (pending.empty())
+			return;
+
+		{
+			std::ofstream ofs(journal_path.string(), std::ios::binary | std::ios::app);
+			boost::archive::binary_oarchive oa(ofs);
+			oa << pending;
+		}
+
+		records_written += pending.size();
+		pending.clear();
+	}
+
+	/**
+	 *	@brief	Discards the journal, should be called once the journaled modifications were written to the index.
+	 */
+	void truncate() {
+		pending.clear();
+		records_written = 0;
+
+		std::error_code err;
+		std::experimental::filesystem::remove(journal_path, err);
+	}
+
+	bool exists() const { return std::experimental::filesystem::exists(journal_path); }
+
+	/**
+	 *	@brief	Count of journaled records, including pending records.
+	 */
+	auto size() const { return records_written + pending.size(); }
+
+	/**
+	 *	@brief	Replays the journal file, invoking f with every record in order.
+	 *			Stops at the first batch that fails reading.
+	 *
+	 *	@return	Count of replayed records
+	 */
+	template <typename F>
+	std::size_t replay(F &&f) const {
+		std::ifstream ifs(journal_path.string(), std::ios::binary);
+		if (!ifs)
+			return 0;
+
+		std::size_t count = 0;
+		while (ifs.peek() != std::ifstream::traits_type::eof()) {
+			lib::vector<record> batch;
+			try {
+				boost::archive::binary_iarchive ia(ifs);
+				ia >> batch;
+			}
+			catch (const std::exception &) {
+				break;
+			}
+
+			for (auto &r : batch)
+				f(r);
+			count += batch.size();
+		}
+
+		return count;
+	}
+};
+
+}
@@ -0,0 +1,328 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+/**	@file	lru_cache_pack_storage.hpp
+ *	@brief	lru_cache packed, memory-mapped storage backend
+ *
+ *	@author	Shlomi Steinberg
+ */
+
+#pragma once
+
+#include <lru_cache_blob.hpp>
+#include <mapped_file.hpp>
+
+#include <filesystem>
+
+#include <lib/string.hpp>
+#include <lib/shared_ptr.hpp>
+#include <lib/unordered_map.hpp>
+#include <lib/vector.hpp>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <optional.hpp>
+
+namespace ste {
+
+/**
+ *	@brief	lru_cache storage backend, packing entries into a few large, memory-mapped segment files.
+ *
+ *	Entries are appended to the active segment with a lock-free bump of its write cursor, and read in place from the
+ *	mapping, without copies. Once full, the active segment is sealed and a new one is created.
+ *	A segment file is removed once it holds no persistent entries. Sealed segments whose live entries occupy less than
+ *	a fraction of their capacity are compacted: Their live entries are relocated into the active segment, so that the
+ *	segment is removed once in-flight readers release it.
+ *
+ *	See lru_cache_file_storage for the storage backend protocol.
+ */
+class lru_cache_pack_storage {
+public:
+	struct location_type {
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive & ar, const unsigned int version) {
+			ar & segment;
+			ar & offset;
+			ar & size;
+		}
+
+		std::uint32_t segment;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+private:
+	static constexpr auto segment_extension = ".stepack";
+	static constexpr std::size_t segment_capacity = 16 * 1024 * 1024;
+	// Sealed segments with less than capacity/compaction_live_ratio_divisor live bytes are compacted
+	static constexpr std::uint64_t compaction_live_ratio_divisor = 2;
+	static constexpr std::size_t max_segments_compacted_per_pass = 2;
+
+	class segment {
+	private:
+		std::experimental::filesystem::path p;
+		mapped_file map;
+
+	public:
+		const std::uint32_t id;
+		std::atomic<std::uint64_t> cursor{ 0 };
+		std::atomic<std::uint64_t> live_bytes{ 0 };
+
+	public:
+		segment(std::experimental::filesystem::path path, std::uint32_t id, std::size_t capacity)
+			: p(std::move(path)), map(p, mapped_file::access::read_write, capacity), id(id)
+		{
+			if (!map.is_mapped())
+				throw std::runtime_error("Failed mapping segment");
+		}
+		~segment() noexcept {
+			if (live_bytes.load() == 0) {
+				map = mapped_file();
+
+				std::error_code err;
+				std::experimental::filesystem::remove(p, err);
+			}
+		}
+
+		segment(segment&&) = delete;
+		segment &operator=(segment&&) = delete;
+
+		char *data() { return map.data(); }
+		std::uint64_t capacity() const { return map.size(); }
+		bool is_full() const { return cursor.load(std::memory_order_relaxed) >= capacity(); }
+	};
+	using segment_ptr = lib::shared_ptr<segment>;
+
+public:
+	class record {
+		friend class lru_cache_pack_storage;
+
+	private:
+		segment_ptr seg;
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::atomic<bool> persistent{ false };
+
+	public:
+		record(segment_ptr seg, std::uint64_t offset, std::uint64_t size)
+			: seg(std::move(seg)), offset(offset), size(size)
+		{
+			this->seg->live_bytes.fetch_add(size);
+		}
+		~record() noexcept {
+			if (!persistent.load(std::memory_order_acquire))
+				seg->live_bytes.fetch_sub(size);
+		}
+
+		record(record&&) = delete;
+		record &operator=(record&&) = delete;
+
+		void set_persistent(bool p) { persistent.store(p, std::memory_order_release); }
+		auto get_size() const { return byte_t(static_cast<std::size_t>(size)); }
+		location_type get_location() const { return { seg->id, offset, size }; }
+	};
+	using record_ptr = lib::shared_ptr<record>;
+
+	/**
+	 *	@brief	Set of segments being compacted
+	 */
+	class compaction_set {
+		friend class lru_cache_pack_storage;
+
+	private:
+		lib::vector<segment_ptr> segments;
+
+	public:
+		bool empty() const { return segments.empty(); }
+		bool contains(const record &rec) const {
+			for (auto &s : segments)
+				if (s == rec.seg)
+					return true;
+			return false;
+		}
+	};
+
+private:
+	std::experimental::filesystem::path dir;
+
+	// Guards segments, active segment replacement and segment id allocation
+	mutable std::mutex m;
+	lib::unordered_map<std::uint32_t, segment_ptr> segments;
+	segment_ptr active;
+	std::uint32_t next_segment_id{ 0 };
+
+private:
+	std::experimental::filesystem::path segment_path(std::uint32_t id) const {
+		return dir / (lib::to_string(id) + segment_extension);
+	}
+
+	static bool parse_segment_id(const std::experimental::filesystem::path &p, std::uint32_t &id) {
+		if (p.extension() != segment_extension)
+			return false;
+
+		const auto stem = p.stem().string();
+		char *end;
+		const auto v = std::strtoul(stem.c_str(), &end, 10);
+		if (stem.empty() || *end != 0)
+			return false;
+
+		id = static_cast<std::uint32_t>(v);
+		return true;
+	}
+
+	// Creates a new active segment. Expects m to be locked.
+	void roll_active_segment(std::size_t min_capacity) {
+		const auto id = next_segment_id++;
+		auto seg = lib::allocate_shared<segment>(segment_path(id), id, std::max(segment_capacity, min_capacity));
+
+		segments[id] = seg;
+		std::atomic_store(&active, std::move(seg));
+	}
+
+public:
+	lru_cache_pack_storage(const std::experimental::filesystem::path &dir) : dir(dir) {
+		std::error_code err;
+		for (std::experimental::filesystem::directory_iterator end_it, it(dir, err); !err && it != end_it; ++it) {
+			std::uint32_t id;
+			if (parse_segment_id(it->path(), id))
+				next_segment_id = std::max(next_segment_id, id + 1);
+		}
+	}
+	~lru_cache_pack_storage() noexcept {}
+
+	lru_cache_pack_storage(lru_cache_pack_storage&&) = delete;
+	lru_cache_pack_storage &operator=(lru_cache_pack_storage&&) = delete;
+
+	/**
+	 *	@brief	Appends a serialized object to the active segment
+	 */
+	record_ptr write(const lru_cache_blob &blob) {
+		return write(blob.data(), blob.size());
+	}
+
+	record_ptr write(const char *data, std::uint64_t size) {
+		for (;;) {
+			auto seg = std::atomic_load(&active);
+			if (seg == nullptr) {
+				std::unique_lock<std::mutex> l(m);
+				if (std::atomic_load(&active) == nullptr)
+					roll_active_segment(static_cast<std::size_t>(size));
+				continue;
+			}
+
+			const auto offset = seg->cursor.fetch_add(size);
+			if (offset + size <= seg->capacity()) {
+				std::memcpy(seg->data() + offset, data, static_cast<std::size_t>(size));
+				return lib::allocate_shared<record>(std::move(seg), offset, size);
+			}
+
+			// Segment full, seal it and roll a new one
+			std::unique_lock<std::mutex> l(m);
+			if (std::atomic_load(&active) == seg)
+				roll_active_segment(static_cast<std::size_t>(size));
+		}
+	}
+
+	/**
+	 *	@brief	Reopens a record from its location, returns nullptr if the location is invalid.
+	 */
+	record_ptr open(const location_type &location) {
+		std::unique_lock<std::mutex> l(m);
+
+		auto it = segments.find(location.segment);
+		if (it == segments.end()) {
+			const auto p = segment_path(location.segment);
+			if (!std::experimental::filesystem::exists(p))
+				return nullptr;
+
+			try {
+				auto seg = lib::allocate_shared<segment>(p, location.segment, 0);
+				it = segments.emplace(location.segment, std::move(seg)).first;
+			}
+			catch (const std::exception &) {
+				return nullptr;
+			}
+		}
+
+		auto &seg = it->second;
+		if (location.offset + location.size > seg->capacity())
+			return nullptr;
+
+		// Keep the write cursor past all live entries
+		auto cursor = seg->cursor.load();
+		const auto end = location.offset + location.size;
+		while (cursor < end && !seg->cursor.compare_exchange_weak(cursor, end)) {}
+
+		return lib::allocate_shared<record>(seg, location.offset, location.size);
+	}
+
+	/**
+	 *	@brief	Called once the index has been loaded and all live records were opened.
+	 *			Removes unreferenced segment files, and reuses the last segment as the active segment if it has room.
+	 */
+	void loaded() {
+		std::unique_lock<std::mutex> l(m);
+
+		std::error_code err;
+		lib::vector<std::experimental::filesystem::path> unreferenced;
+		for (std::experimental::filesystem::directory_iterator end_it, it(dir, err); !err && it != end_it; ++it) {
+			std::uint32_t id;
+			if (parse_segment_id(it->path(), id) && segments.find(id) == segments.end())
+				unreferenced.push_back(it->path());
+		}
+		for (auto &p : unreferenced)
+			std::experimental::filesystem::remove(p, err);
+
+		segment_ptr last;
+		for (auto &s : segments)
+			if (last == nullptr || s.second->id > last->id)
+				last = s.second;
+		if (last != nullptr && !last->is_full())
+			std::atomic_store(&active, std::move(last));
+	}
+
+	/**
+	 *	@brief	Reads the serialized object, in place.
+	 */
+	optional<lru_cache_blob_view> read(const record_ptr &rec) const {
+		return lru_cache_blob_view(rec->seg->data() + rec->offset,
+								   static_cast<std::size_t>(rec->size),
+								   rec->seg);
+	}
+
+	/**
+	 *	@brief	Selects sealed segments for compaction. The segments are forgotten by the storage, live records in them
+	 *			should be relocated.
+	 */
+	compaction_set compaction_candidates() {
+		std::unique_lock<std::mutex> l(m);
+
+		const auto current_active = std::atomic_load(&active);
+
+		compaction_set set;
+		for (auto it = segments.begin(); it != segments.end() && set.segments.size() < max_segments_compacted_per_pass;) {
+			auto &seg = it->second;
+			const bool sealed = seg != current_active;
+			if (sealed && seg->live_bytes.load() < seg->capacity() / compaction_live_ratio_divisor) {
+				set.segments.push_back(seg);
+				it = segments.erase(it);
+			}
+			else
+				++it;
+		}
+
+		return set;
+	}
+
+	/**
+	 *	@brief	Copies a record's object into the active segment
+	 */
+	record_ptr relocate(const record &rec) {
+		return write(rec.seg->data() + rec.offset, rec.size);
+	}
+};
+
+}
@@ -0,0 +1,72 @@
+//	StE
+//  Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <command.hpp>
+#include <device_buffer_base.hpp>
+#include <vk_logical_device.hpp>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Indexed indirect draw, with the draw count read from a device buffer. Requires VK_KHR_draw_indirect_count.
+ */
+class cmd_draw_indexed_indirect_count : public command {
+private:
+	VkBuffer buffer;
+	byte_t offset;
+	VkBuffer count_buffer;
+	byte_t count_offset;
+	std::uint32_t max_draw_count;
+	byte_t stride;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR;
+
+public:
+	cmd_draw_indexed_indirect_count(cmd_draw_indexed_indirect_count &&) = default;
+	cmd_draw_indexed_indirect_count(const cmd_draw_indexed_indirect_count&) = default;
+	cmd_draw_indexed_indirect_count &operator=(cmd_draw_indexed_indirect_count &&) = default;
+	cmd_draw_indexed_indirect_count &operator=(const cmd_draw_indexed_indirect_count&) = default;
+
+	/**
+	 *	@param	count_buffer	Buffer holding the 32-bit draw count
+	 *	@param	count_offset	Offset, in elements of count_buffer, of the draw count
+	 *	@param	max_draw_count	Upper bound of the draw count
+	 */
+	cmd_draw_indexed_indirect_count(const device_buffer_base &buffer,
+									std::uint32_t offset,
+									const device_buffer_base &count_buffer,
+									std::uint32_t count_offset,
+									std::uint32_t max_draw_count,
+									const vk::vk_logical_device<> &device,
+									std::uint32_t stride = 1)
+		: buffer(buffer.get_buffer_handle()),
+		  offset(offset * buffer.get_element_size_bytes()),
+		  count_buffer(count_buffer.get_buffer_handle()),
+		  count_offset(count_offset * count_buffer.get_element_size_bytes()),
+		  max_draw_count(max_draw_count),
+		  stride(stride * buffer.get_element_size_bytes()),
+		  vkCmdDrawIndexedIndirectCountKHR(device.get_extensions_func_pointers().draw_indirect_count().vkCmdDrawIndexedIndirectCountKHR)
+	{
+		assert(device.get_extensions_func_pointers().draw_indirect_count().enabled);
+	}
+
+	virtual ~cmd_draw_indexed_indirect_count() noexcept {}
+
+private:
+	void operator()(const command_buffer &command_buffer, command_recorder &) && override final {
+		vkCmdDrawIndexedIndirectCountKHR(command_buffer,
+										 buffer,
+										 static_cast<std::size_t>(offset),
+										 count_buffer,
+										 static_cast<std::size_t>(count_offset),
+										 max_draw_count,
+										 static_cast<std::uint32_t>(stride));
+	}
+};
+
+}
+}
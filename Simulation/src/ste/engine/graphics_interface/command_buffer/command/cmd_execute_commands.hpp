@@ -25,10 +25,19 @@ public:
 	cmd_execute_commands(const command_buffer &buffer) {
 		buffers.push_back(buffer);
 	}
+	/**
+	*	@brief	Executes secondary command buffers.
+	*			The dependencies of the secondary buffers are moved to the executing command buffer, and are waited upon when it is submitted.
+	*/
 	cmd_execute_commands(const lib::vector<std::reference_wrapper<command_buffer>> &buffers) {
 		this->buffers.reserve(buffers.size());
-		for (auto &e : buffers)
+		for (auto &e : buffers) {
 			this->buffers.push_back(e.get());
+
+			for (auto &d : e.get().dependencies)
+				add_dependency(std::move(d));
+			e.get().dependencies.clear();
+		}
 	}
 	virtual ~cmd_execute_commands() noexcept {}
 
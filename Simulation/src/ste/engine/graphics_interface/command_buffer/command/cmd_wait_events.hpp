@@ -30,12 +30,12 @@ public:
 
 	cmd_wait_events(const std::initializer_list<VkEvent> &events,
 					const pipeline_barrier &barrier)
-		: barrier(barrier)
+		: cmd_wait_events(lib::vector<VkEvent>(events.begin(), events.end()), barrier)
+	{}
+	cmd_wait_events(lib::vector<VkEvent> &&events,
+					const pipeline_barrier &barrier)
+		: events(std::move(events)), barrier(barrier)
 	{
-		this->events.reserve(events.size());
-		for (auto &e : events)
-			this->events.push_back(e);
-
 		const auto &global = barrier.get_global_memory_barriers();
 		const auto &buffer = barrier.get_buffer_barriers();
 		const auto &image = barrier.get_image_barriers();
@@ -7,6 +7,7 @@
 #include <wait_semaphore.hpp>
 
 #include <lib/vector.hpp>
+#include <lib/shared_ptr.hpp>
 
 namespace ste {
 namespace gl {
@@ -18,6 +19,7 @@ class command {
 
 private:
 	lib::vector<wait_semaphore> dependencies;
+	lib::vector<lib::shared_ptr<void>> retained_resources;
 
 private:
 	virtual void operator()(const command_buffer &command_buffer, command_recorder &) && = 0;
@@ -38,6 +40,14 @@ public:
 	void add_dependency(wait_semaphore &&sem) { dependencies.emplace_back(std::move(sem)); }
 
 	auto extract_dependencies() && { return std::move(dependencies); }
+
+	/*
+	 *	@brief	Retains a resource used by the command. When recorded to a command buffer, the command buffer takes ownership of the resource,
+	 *			releasing it only once the command buffer is re-recorded or destroyed, i.e. after the device is done with it.
+	 */
+	void retain_resource(lib::shared_ptr<void> &&resource) { retained_resources.emplace_back(std::move(resource)); }
+
+	auto extract_retained_resources() && { return std::move(retained_resources); }
 };
 
 }
@@ -16,6 +16,7 @@
 #include <command_recorder.hpp>
 
 #include <lib/vector.hpp>
+#include <lib/shared_ptr.hpp>
 #include <allow_type_decay.hpp>
 
 namespace ste {
@@ -26,6 +27,7 @@ class ste_device_queue;
 class command_buffer : public allow_type_decay<command_buffer, vk::vk_command_buffer> {
 	friend command_recorder;
 	friend ste_device_queue;
+	friend class cmd_execute_commands;
 	template <typename UserData>
 	friend class ste_device_queue_batch;
 
@@ -35,6 +37,8 @@ protected:
 	ste_queue_descriptor queue_descriptor;
 
 	lib::vector<wait_semaphore> dependencies;
+	// Resources retained by recorded commands
+	lib::vector<lib::shared_ptr<void>> retained_resources;
 
 protected:
 	command_buffer(const vk::vk_command_pool<> &pool,
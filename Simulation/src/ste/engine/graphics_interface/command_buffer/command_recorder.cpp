@@ -24,5 +24,12 @@ command_recorder &command_recorder::operator<<(command &&cmd) {
 								std::make_move_iterator(deps.begin()), 
 								std::make_move_iterator(deps.end()));
 
+	// Command buffer takes ownership of resources retained by the command
+	auto retained = std::move(cmd).extract_retained_resources();
+	buffer->retained_resources.reserve(buffer->retained_resources.size() + retained.size());
+	buffer->retained_resources.insert(buffer->retained_resources.end(),
+									  std::make_move_iterator(retained.begin()),
+									  std::make_move_iterator(retained.end()));
+
 	return *this;
 }
@@ -30,6 +30,9 @@ private:
 		: buffer(&buffer),
 		  queue_descriptor(queue_descriptor) {
 		buffer.begin(std::forward<Ts>(ts)...);
+
+		// Recording resets the buffer, release resources retained by previously recorded commands
+		buffer.retained_resources.clear();
 	}
 
 public:
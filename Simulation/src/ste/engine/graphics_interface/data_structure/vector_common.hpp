@@ -8,9 +8,12 @@
 
 #include <command_recorder.hpp>
 #include <cmd_update_buffer.hpp>
+#include <cmd_copy_buffer.hpp>
+#include <ste_device_upload_arena.hpp>
 
 #include <lib/blob.hpp>
 #include <lib/vector.hpp>
+#include <cstring>
 
 namespace ste {
 namespace gl {
@@ -21,11 +24,28 @@ template <class vector>
 class vector_cmd_update_buffer : public command {
 	lib::vector<cmd_update_buffer> update_commands;
 
+	// Large updates are staged in the device's upload arena and copied with a single copy command
+	ste_device_upload_arena::allocation_ptr staging;
+	std::uint64_t location;
+	vector* v;
+
 public:
 	vector_cmd_update_buffer(const typename vector::value_type *data,
 							 std::size_t size,
 	                         std::uint64_t location,
-	                         vector* v) {
+	                         vector* v)
+		: location(location),
+		  v(v)
+	{
+		const auto bytes = size * sizeof(typename vector::value_type);
+		if (bytes > static_cast<std::size_t>(cmd_update_buffer::maximal_update_bytes)) {
+			staging = v->get().parent_context().device().upload_arena().allocate(byte_t(bytes));
+			if (staging) {
+				std::memcpy(staging->data(), data, bytes);
+				return;
+			}
+		}
+
 		// Calculate the maximal amount of elements possible to update in a single update buffer command
 		auto elements_per_chunk = static_cast<std::size_t>(cmd_update_buffer::maximal_update_bytes) / sizeof(typename vector::value_type);
 
@@ -48,6 +68,18 @@ public:
 
 private:
 	void operator()(const command_buffer&, command_recorder& recorder) && override final {
+		if (staging) {
+			// Copy from upload arena
+			buffer_copy_region_t range = { static_cast<std::size_t>(staging->get_offset()), static_cast<std::size_t>(location), staging->get_size() };
+			recorder << cmd_copy_buffer(staging->buffer(),
+										v->get(),
+										{ range });
+
+			// Hold the staging memory till the command buffer is done
+			this->retain_resource(std::move(staging));
+			return;
+		}
+
 		// Copy data
 		for (auto&& cmd : update_commands)
 			recorder << std::move(cmd);
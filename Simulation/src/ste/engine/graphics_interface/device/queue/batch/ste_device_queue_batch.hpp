@@ -49,6 +49,10 @@ protected:
 																					Base::wait_semaphores.end());
 		auto signal_semaphore_handles = Base::vk_semaphores(Base::signal_semaphores);
 
+		lib::vector<const semaphore*> wait_semaphores;
+		for (auto &s : Base::wait_semaphores)
+			wait_semaphores.push_back(&s.sem.get());
+
 		// Copy command buffers' handles for submission and prepare dependecies
 		lib::vector<vk::vk_command_buffer> command_buffers;
 		command_buffers.reserve(size());
@@ -56,14 +60,18 @@ protected:
 			// Add command buffer handle
 			command_buffers.push_back(static_cast<vk::vk_command_buffer>(b));
 			// Move dependencies
-			for (auto &&d : b.dependencies)
+			for (auto &&d : b.dependencies) {
+				wait_semaphores.push_back(&d.sem.get());
 				wait_semaphore_handles.emplace_back(std::move(d));
+			}
 		}
 
-		// Submit finalized buffers
+		// Submit finalized buffers, along with the timeline semaphores' values
 		q.submit(command_buffers,
 				 wait_semaphore_handles,
+				 Base::timeline_values(wait_semaphores),
 				 signal_semaphore_handles,
+				 Base::timeline_values(Base::signal_semaphores),
 				 &(*fence_strong)->get_fence());
 
 		// Signal fence's host-side future
@@ -14,6 +14,7 @@
 #include <lib/shared_ptr.hpp>
 #include <lib/vector.hpp>
 #include <type_traits>
+#include <algorithm>
 
 namespace ste {
 namespace gl {
@@ -67,6 +68,23 @@ protected:
 		return vk_sems;
 	}
 
+	/*
+	*	@brief	Collects the timeline values of a vector of semaphores, for submission.
+	*			Returns an empty vector if none of the semaphores is a timeline semaphore.
+	*/
+	template <typename Semaphore>
+	static auto timeline_values(const lib::vector<Semaphore*> &s) {
+		lib::vector<std::uint64_t> values;
+		if (std::none_of(s.begin(), s.end(), [](auto &sem) { return sem->is_timeline(); }))
+			return values;
+
+		values.reserve(s.size());
+		for (auto &sem : s)
+			values.push_back(sem->timeline_value());
+
+		return values;
+	}
+
 	/*
 	*	@brief	Should submit the batch to the supplied queue and signal fence's host-side status after submission.
 	*/
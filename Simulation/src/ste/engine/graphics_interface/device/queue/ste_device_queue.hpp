@@ -164,9 +164,13 @@ public:
 
 		try {
 			if (batch->queue_index == thread_queue_index()) {
-				// Host wait upon wait semaphores
-				for (auto &wait_sem : batch->wait_semaphores)
-					wait_sem.sem->wait_host();
+				// Host wait upon wait semaphores.
+				// A binary semaphore's signal must be submitted before a wait upon it is submitted. Timeline semaphores
+				// have no such restriction, the wait is resolved by the device.
+				for (auto &wait_sem : batch->wait_semaphores) {
+					if (!wait_sem.sem->is_timeline())
+						wait_sem.sem->wait_host();
+				}
 
 				// Submit
 				batch->submit(thread_queue());
@@ -11,6 +11,7 @@
 #include <ste_device_queue_descriptors.hpp>
 #include <ste_device_queue_selector_cache.hpp>
 #include <ste_device_sync_primitives_pools.hpp>
+#include <ste_device_upload_arena.hpp>
 #include <ste_queue_selector.hpp>
 #include <ste_device_pipeline_cache.hpp>
 #include <pipeline_binding_set_pool.hpp>
@@ -58,6 +59,8 @@ private:
 
 	// Synchronization primitive pools
 	lib::aligned_padded_ptr<ste_device_sync_primitives_pools> sync_primitives_pools;
+	// Host-to-device upload arena. Outlives the queues, which hold in-flight allocations.
+	mutable ste_device_upload_arena device_upload_arena;
 	// Presentation surface
 	lib::unique_ptr<ste_presentation_surface> presentation_surface{ nullptr };
 
@@ -95,6 +98,14 @@ private:
 		if (available_extensions.is_supported(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
 			extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+		// VK_KHR_timeline_semaphore
+		if (available_extensions.is_supported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+			extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+		// VK_KHR_draw_indirect_count
+		if (available_extensions.is_supported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+			extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
 #ifndef RENDER_DOC
 		// VK_KHR_get_memory_requirements2
 		if (available_extensions.is_supported(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME))
@@ -166,6 +177,8 @@ public:
 			   device_extensions(parameters,
 								 parameters.physical_device.get_extensions())),
 		sync_primitives_pools(device),
+		device_upload_arena(device,
+							parameters.upload_arena_size),
 		device_queues(create_queues(device,
 									queue_descriptors,
 									&*sync_primitives_pools)),
@@ -291,6 +304,11 @@ public:
 	*/
 	auto& get_sync_primitives_pools() const { return *sync_primitives_pools; }
 
+	/**
+	 *	@brief	Thread-safe ring-style upload arena, used to stage host-to-device transfers
+	 */
+	auto& upload_arena() const { return device_upload_arena; }
+
 	/**
 	*	@brief	Thread-safe pipeline cache generator
 	*/
@@ -28,12 +28,14 @@ private:
 	static constexpr auto shared_fence_pool_instance_name = "shared_fence_pool instance";
 	static constexpr auto event_pool_instance_name = "event_pool instance";
 	static constexpr auto semaphore_pool_instance_name = "semaphore_pool instance";
+	static constexpr auto binary_semaphore_pool_instance_name = "binary_semaphore_pool instance";
 
 private:
 	unique_fence_pool_t fence_pool;
 	shared_fence_pool_t shared_fence_pool;
 	event_pool_t event_pool;
 	semaphore_pool_t semaphore_pool;
+	semaphore_pool_t binary_semaphore_pool;
 
 public:
 	ste_device_sync_primitives_pools(const vk::vk_logical_device<>& device)
@@ -44,13 +46,24 @@ public:
 		  event_pool(device,
 					 event_pool_instance_name),
 		  semaphore_pool(device,
-						 semaphore_pool_instance_name)
+						 semaphore_pool_instance_name,
+						 device.get_extensions_func_pointers().timeline_semaphore().enabled),
+		  binary_semaphore_pool(device,
+								binary_semaphore_pool_instance_name,
+								false)
 	{}
 
 	auto& unique_fences() { return fence_pool; }
 	auto& shared_fences() { return shared_fence_pool; }
 	auto& events() { return event_pool; }
+	/**
+	 *	@brief	Semaphores for synchronizing queue submissions. Timeline semaphores, if supported by the device.
+	 */
 	auto& semaphores() { return semaphore_pool; }
+	/**
+	 *	@brief	Binary semaphores, as required by presentation.
+	 */
+	auto& binary_semaphores() { return binary_semaphore_pool; }
 };
 
 }
@@ -0,0 +1,280 @@
+//	StE
+//  Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <vulkan/vulkan.h>
+#include <vk_logical_device.hpp>
+#include <vk_device_memory.hpp>
+#include <vk_mmap.hpp>
+#include <vk_buffer_dense.hpp>
+#include <vk_result.hpp>
+#include <vk_exception.hpp>
+
+#include <device_buffer_base.hpp>
+#include <device_memory_exceptions.hpp>
+#include <buffer_usage.hpp>
+#include <memory_properties_flags.hpp>
+
+#include <lib/deque.hpp>
+#include <lib/shared_ptr.hpp>
+#include <lib/unique_ptr.hpp>
+#include <anchored.hpp>
+#include <mutex>
+#include <algorithm>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Persistently mapped, host-visible and coherent, ring-style upload arena.
+ *			Host-to-device transfers suballocate staging space from the arena, instead of creating a dedicated staging buffer per
+ *			upload.
+ *			
+ *			An allocation is released once the last reference to it is dropped. Allocations should be held by the batch, or the
+ *			command buffer, consuming them, and therefore are released only after the device is done with them. Allocations can
+ *			be released out-of-order, the arena reclaims space from the oldest allocation onwards.
+ *			Thread safe.
+ */
+class ste_device_upload_arena : anchored {
+public:
+	static constexpr std::uint64_t default_alignment = 256;
+
+	/**
+	 *	@brief	Arena buffer, a byte-sized elements buffer usable as a transfer source.
+	 */
+	class arena_buffer : public device_buffer_base {
+		friend class ste_device_upload_arena;
+
+	private:
+		vk::vk_buffer_dense<> buffer;
+
+	public:
+		arena_buffer(const vk::vk_logical_device<> &device, byte_t capacity)
+			: buffer(device,
+					 1_B,
+					 static_cast<std::uint64_t>(capacity),
+					 static_cast<VkBufferUsageFlags>(buffer_usage::transfer_src),
+					 "upload arena buffer")
+		{}
+
+		const vk::vk_buffer<> &get_buffer_handle() const override final { return buffer; }
+
+		std::uint64_t get_elements_count() const override final { return buffer.get_elements_count(); }
+		byte_t get_element_size_bytes() const override final { return 1_B; };
+		bool is_sparse() const override final { return false; };
+	};
+
+	/**
+	 *	@brief	An arena allocation. Releases its region back to the arena on destruction.
+	 */
+	class allocation {
+		friend class ste_device_upload_arena;
+
+	private:
+		struct ctor {};
+
+		ste_device_upload_arena *arena;
+		std::uint64_t region_id;
+		std::uint64_t offset;
+		byte_t size;
+
+	public:
+		allocation(ctor, ste_device_upload_arena *arena, std::uint64_t region_id, std::uint64_t offset, byte_t size)
+			: arena(arena), region_id(region_id), offset(offset), size(size)
+		{}
+		~allocation() noexcept {
+			arena->release(region_id);
+		}
+
+		allocation(allocation&&) = delete;
+		allocation &operator=(allocation&&) = delete;
+
+		/**
+		 *	@brief	Host pointer to the mapped allocation
+		 */
+		std::uint8_t* data() const { return arena->mapped_ptr() + offset; }
+		/**
+		 *	@brief	Offset, in bytes, of the allocation in the arena buffer
+		 */
+		auto get_offset() const { return offset; }
+		auto get_size() const { return size; }
+
+		/**
+		 *	@brief	The arena buffer. Use get_offset() to address the allocation.
+		 */
+		const arena_buffer& buffer() const { return arena->buffer; }
+	};
+	using allocation_ptr = lib::shared_ptr<allocation>;
+
+	struct statistics {
+		byte_t capacity;
+		// Bytes currently held by in-flight allocations, including alignment and wrap-around padding
+		byte_t in_flight;
+		// Maximal in-flight bytes, since the last call to sample_statistics()
+		byte_t high_water_mark;
+		// Count of allocations that could not be satisfied by the arena
+		std::uint64_t failed_allocations;
+	};
+
+private:
+	struct region_t {
+		// End of the region, in ring coordinates
+		std::uint64_t end;
+		bool released{ false };
+	};
+
+private:
+	arena_buffer buffer;
+	vk::vk_device_memory<> memory;
+	lib::unique_ptr<vk::vk_mmap<std::uint8_t>> mmap;
+	std::uint64_t capacity;
+
+	mutable std::mutex m;
+	// Ring write and reclaim positions. Monotonic, physical offset is position modulo capacity.
+	std::uint64_t head{ 0 };
+	std::uint64_t tail{ 0 };
+	// In-flight regions, oldest first. Region ids are monotonic, first_region_id is the id of the front region.
+	lib::deque<region_t> regions;
+	std::uint64_t first_region_id{ 0 };
+
+	std::uint64_t high_water_mark{ 0 };
+	std::uint64_t failed_allocations{ 0 };
+
+private:
+	static int find_memory_type(const vk::vk_logical_device<> &device,
+								const memory_requirements &requirements) {
+		static constexpr auto required_flags = memory_properties_flags::host_visible | memory_properties_flags::host_coherent;
+
+		// The specification guarantees a host visible and coherent memory type for buffers
+		auto &memory_properties = device.get_physical_device_descriptor().get_memory_properties();
+		for (std::uint32_t type = 0; type < memory_properties.memoryTypeCount; ++type) {
+			if (!(requirements.type_bits & (1 << type)))
+				continue;
+			const auto flags = static_cast<memory_properties_flags>(memory_properties.memoryTypes[type].propertyFlags);
+			if ((flags & required_flags) == required_flags)
+				return static_cast<int>(type);
+		}
+
+		throw device_memory_no_supported_heap_exception();
+	}
+
+	auto mapped_ptr() const { return mmap->get_mapped_ptr(); }
+
+	void release(std::uint64_t region_id) {
+		std::unique_lock<std::mutex> l(m);
+
+		assert(region_id >= first_region_id && region_id - first_region_id < regions.size());
+		regions[static_cast<std::size_t>(region_id - first_region_id)].released = true;
+
+		// Reclaim released regions, oldest first
+		while (!regions.empty() && regions.front().released) {
+			tail = regions.front().end;
+			regions.pop_front();
+			++first_region_id;
+		}
+
+		// Rewind an empty ring
+		if (regions.empty())
+			head = tail = 0;
+	}
+
+public:
+	/**
+	 *	@brief	Creates the arena, allocating a dedicated host-visible and coherent memory object and mapping it.
+	 *
+	 *	@throws device_memory_no_supported_heap_exception	If no compatible memory type is available
+	 *	@throws vk_memory_allocation_failed_exception	On device memory allocation failure
+	 *	@throws vk_exception	On Vulkan error
+	 *
+	 *	@param	device		Creating device
+	 *	@param	capacity	Arena capacity
+	 */
+	ste_device_upload_arena(const vk::vk_logical_device<> &device,
+							byte_t capacity)
+		: buffer(device, capacity),
+		memory(device,
+			   buffer.buffer.get_memory_requirements().bytes,
+			   find_memory_type(device, buffer.buffer.get_memory_requirements())),
+		capacity(static_cast<std::uint64_t>(capacity))
+	{
+		const vk::vk_result res = vkBindBufferMemory(device,
+													 buffer.buffer,
+													 memory,
+													 0);
+		if (!res) {
+			throw vk::vk_exception(res);
+		}
+
+		// Map persistently
+		mmap = memory.mmap<std::uint8_t>(0, this->capacity);
+	}
+	~ste_device_upload_arena() noexcept {
+		assert(regions.empty() && "Upload arena destroyed with in-flight allocations");
+	}
+
+	/**
+	 *	@brief	Suballocates staging space from the arena.
+	 *			Never blocks on the device: Returns nullptr if the arena has no room for the requested allocation, the caller
+	 *			should fall back to a dedicated staging buffer.
+	 *			
+	 *	@param	size		Allocation size in bytes
+	 *	@param	alignment	Allocation offset alignment, in bytes. Needs not be a power-of-two.
+	 */
+	allocation_ptr allocate(byte_t size, std::uint64_t alignment = default_alignment) {
+		const auto bytes = static_cast<std::uint64_t>(size);
+		alignment = std::max<std::uint64_t>(alignment, 1);
+
+		std::unique_lock<std::mutex> l(m);
+
+		// Align, wrapping around if the allocation doesn't fit at the end of the ring
+		const auto position = head % capacity;
+		auto offset = (position + alignment - 1) / alignment * alignment;
+		if (offset + bytes > capacity)
+			offset = 0;
+		const auto consumed = offset >= position ?
+			offset - position + bytes :
+			capacity - position + bytes;
+
+		if (bytes == 0 || head + consumed - tail > capacity) {
+			++failed_allocations;
+			return nullptr;
+		}
+
+		head += consumed;
+		regions.push_back({ head });
+		const auto region_id = first_region_id + regions.size() - 1;
+
+		high_water_mark = std::max(high_water_mark, head - tail);
+
+		return lib::allocate_shared<allocation>(allocation::ctor{},
+												this,
+												region_id,
+												offset,
+												size);
+	}
+
+	/**
+	 *	@brief	Returns arena usage statistics, and restarts tracking the high-water mark from the current usage.
+	 */
+	statistics sample_statistics() {
+		std::unique_lock<std::mutex> l(m);
+
+		statistics s;
+		s.capacity = byte_t(capacity);
+		s.in_flight = byte_t(head - tail);
+		s.high_water_mark = byte_t(high_water_mark);
+		s.failed_allocations = failed_allocations;
+
+		high_water_mark = head - tail;
+
+		return s;
+	}
+
+	auto get_capacity() const { return byte_t(capacity); }
+	auto& get_buffer() const { return buffer; }
+};
+
+}
+}
@@ -12,12 +12,15 @@ class device_memory_block {
 private:
 	byte_t offset;
 	byte_t bytes;
+	// Opaque handle used by the owning heap to locate the block
+	std::uint32_t heap_handle;
 
 public:
 	device_memory_block() = default;
 	device_memory_block(byte_t offset,
-						byte_t bytes)
-		: offset(offset), bytes(bytes) {}
+						byte_t bytes,
+						std::uint32_t heap_handle = 0)
+		: offset(offset), bytes(bytes), heap_handle(heap_handle) {}
 	~device_memory_block() noexcept {}
 
 	device_memory_block(device_memory_block &&) = default;
@@ -31,6 +34,7 @@ public:
 
 	auto get_offset() const { return offset; }
 	auto get_bytes() const { return bytes; }
+	auto get_heap_handle() const { return heap_handle; }
 };
 
 }
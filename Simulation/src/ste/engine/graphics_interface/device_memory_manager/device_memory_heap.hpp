@@ -8,11 +8,10 @@
 #include <vk_handle.hpp>
 #include <vk_device_memory.hpp>
 #include <device_memory_block.hpp>
+#include <device_memory_tlsf.hpp>
 #include <device_memory_exceptions.hpp>
 #include <unique_device_ptr.hpp>
 
-#include <lib/vector.hpp>
-
 namespace ste {
 namespace gl {
 
@@ -22,11 +21,14 @@ public:
 
 	using size_type = std::uint64_t;
 	using block_type = device_memory_block;
-	using blocks_list_t = lib::vector<block_type>;
 	using allocation_type = unique_device_ptr;
 
 	// Natively align allocations on vec4 boundaries
-	static constexpr size_type base_alignment = 128;
+	static constexpr int base_alignment_log2 = 7;
+	static constexpr size_type base_alignment = static_cast<size_type>(1) << base_alignment_log2;
+
+private:
+	using suballocator_t = device_memory_tlsf<base_alignment_log2>;
 
 private:
 	const allocator_t *owner;
@@ -34,7 +36,7 @@ private:
 
 	vk::vk_device_memory<> memory;
 
-	blocks_list_t blocks;
+	suballocator_t suballocator;
 	byte_t total_used_size{ 0 };
 
 public:
@@ -51,7 +53,10 @@ public:
 	device_memory_heap(const allocator_t *owner,
 					   std::uint32_t memory_type,
 					   vk::vk_device_memory<> &&m)
-		: owner(owner), memory_type(memory_type), memory(std::move(m))
+		: owner(owner), 
+		memory_type(memory_type), 
+		memory(std::move(m)),
+		suballocator(static_cast<size_type>(memory.get_size()))
 	{}
 
 	device_memory_heap(device_memory_heap &&) = delete;
@@ -61,16 +66,12 @@ public:
 	*	@brief	Deallocates an allocation
 	*/
 	void deallocate(const allocation_type &ptr) {
-		total_used_size -= ptr->get_bytes();
-		const auto it = std::lower_bound(blocks.begin(), blocks.end(), *ptr);
-
-		if (*it == *ptr) {
-			blocks.erase(it);
-			return;
-		}
-
+		const auto handle = ptr->get_heap_handle();
 		// Allocation not found in this heap!
-		assert(false);
+		assert(suballocator.get_offset(handle) == ptr->get_offset());
+
+		total_used_size -= ptr->get_bytes();
+		suballocator.deallocate(handle);
 	}
 
 	/**
@@ -91,44 +92,24 @@ public:
 			return allocation_type();
 		}
 
-		byte_t start = 0_B;
-		auto it = blocks.begin();
-		for (;;) {
-			const bool last = it == blocks.end();
-
-			auto end = memory.get_size();
-			decltype(end) len;
-			if (!last) {
-				end = it->get_offset();
-				len = it->get_bytes();
-			}
-
-			start = align(start, alignment);
-			if (end > start &&
-				end - start >= bytes) {
-				// Allocate
-				const block_type block(start, bytes);
-
-				blocks.insert(it, block);
-				total_used_size += bytes;
-
-				return allocation_type(&memory, 
-									   owner, 
-									   block,
-									   private_allocation,
-									   memory_type,
-									   tag());
-			}
-
-			if (last)
-				break;
-
-			++it;
-			start = end + len;
+		size_type offset;
+		const auto handle = suballocator.allocate(static_cast<size_type>(bytes), 
+												  std::max(alignment, base_alignment), 
+												  offset);
+		if (handle == suballocator_t::invalid_handle) {
+			// Too fragmented to fit
+			return allocation_type();
 		}
 
-		// Too fragmented to fit
-		return allocation_type();
+		const block_type block(byte_t(offset), bytes, handle);
+		total_used_size += bytes;
+
+		return allocation_type(&memory, 
+							   owner, 
+							   block,
+							   private_allocation,
+							   memory_type,
+							   tag());
 	}
 
 	auto& get_device_memory() const { return memory; }
@@ -142,6 +123,11 @@ public:
 	*/
 	byte_t get_heap_size() const { return memory.get_size(); }
 
+	/**
+	*	@brief	Returns a report of the heap's free space fragmentation.
+	*/
+	auto get_fragmentation_report() const { return suballocator.fragmentation_report(); }
+
 	std::uint64_t tag() const { return vk::vk_handle(get_device_memory()); }
 };
 
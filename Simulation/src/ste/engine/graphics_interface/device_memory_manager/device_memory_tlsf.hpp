@@ -0,0 +1,463 @@
+//	StE
+//  Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <bit_scan.hpp>
+
+#include <lib/vector.hpp>
+#include <array>
+#include <limits>
+#include <algorithm>
+
+namespace ste {
+namespace gl {
+
+/**
+*	@brief	Fragmentation statistics of a device memory heap
+*/
+struct device_memory_fragmentation_report {
+	byte_t free_bytes{ 0 };
+	byte_t largest_free_block{ 0 };
+	std::size_t free_blocks_count{ 0 };
+	std::size_t allocated_blocks_count{ 0 };
+
+	/**
+	*	@brief	Returns the fraction, in [0,1], of free memory that is not part of the largest free block.
+	*/
+	float fragmentation() const {
+		return free_bytes > 0_B ?
+			1.f - static_cast<float>(static_cast<double>(largest_free_block) / static_cast<double>(free_bytes)) :
+			.0f;
+	}
+
+	device_memory_fragmentation_report &operator+=(const device_memory_fragmentation_report &o) {
+		free_bytes += o.free_bytes;
+		largest_free_block = std::max(largest_free_block, o.largest_free_block);
+		free_blocks_count += o.free_blocks_count;
+		allocated_blocks_count += o.allocated_blocks_count;
+		return *this;
+	}
+};
+
+/**
+*	@brief	Two-level segregated fit (TLSF) allocator of a linear range of offsets.
+*			Manages offsets only and never touches the memory, it can be used for any device memory heap.
+*
+*			Free blocks are binned by size, a first level by power of two and a second level linearly subdividing each
+*			power of two. Bitmaps of non-empty bins yield a fitting free block with a couple of bit scans, and freed blocks
+*			are coalesced with their physical neighbours, making both allocation and deallocation O(1).
+*
+*			Not thread-safe.
+*
+*	@param granularity_log2	Log2 of the allocation granularity. All offsets and sizes are multiples of the granularity.
+*/
+template <int granularity_log2>
+class device_memory_tlsf {
+public:
+	using size_type = std::uint64_t;
+	using handle_type = std::uint32_t;
+
+	static constexpr size_type granularity = static_cast<size_type>(1) << granularity_log2;
+	static constexpr handle_type invalid_handle = std::numeric_limits<handle_type>::max();
+
+private:
+	// Second level subdivision count log2
+	static constexpr int sl_count_log2 = 5;
+	static constexpr size_type sl_count = static_cast<size_type>(1) << sl_count_log2;
+	static constexpr int fl_count = 64 - granularity_log2 - sl_count_log2 + 1;
+
+	struct block_t {
+		size_type offset;
+		size_type size;
+
+		// Physically adjacent blocks
+		handle_type prev_phys{ invalid_handle };
+		handle_type next_phys{ invalid_handle };
+		// Free list links, valid only for free blocks
+		handle_type prev_free{ invalid_handle };
+		handle_type next_free{ invalid_handle };
+
+		bool free{ false };
+	};
+
+private:
+	lib::vector<block_t> blocks;
+	// Recycled entries of blocks
+	lib::vector<handle_type> unused_handles;
+
+	std::uint64_t fl_bitmap{ 0 };
+	std::array<std::uint32_t, fl_count> sl_bitmaps;
+	std::array<std::array<handle_type, sl_count>, fl_count> free_heads;
+
+	size_type total_size;
+	size_type allocated_size{ 0 };
+	std::size_t allocated_blocks_count{ 0 };
+
+private:
+	/**
+	*	@brief	Maps a size to its bin, in granularity units.
+	*/
+	static void mapping(size_type units, int &fl, int &sl) {
+		if (units < sl_count) {
+			fl = 0;
+			sl = static_cast<int>(units);
+			return;
+		}
+
+		const auto msb = bit_scan_reverse(units);
+		fl = msb - sl_count_log2 + 1;
+		sl = static_cast<int>((units >> (msb - sl_count_log2)) ^ sl_count);
+	}
+
+	/**
+	*	@brief	Maps a size to the first bin whose blocks are all large enough to fit it, in granularity units.
+	*/
+	static bool mapping_search(size_type units, int &fl, int &sl) {
+		if (units >= sl_count) {
+			const auto round = (static_cast<size_type>(1) << (bit_scan_reverse(units) - sl_count_log2)) - 1;
+			if (units > std::numeric_limits<size_type>::max() - round)
+				return false;
+			units += round;
+		}
+
+		mapping(units, fl, sl);
+		return fl < fl_count;
+	}
+
+	handle_type create_block(size_type offset, size_type size) {
+		block_t b;
+		b.offset = offset;
+		b.size = size;
+
+		if (!unused_handles.empty()) {
+			const auto h = unused_handles.back();
+			unused_handles.pop_back();
+			blocks[h] = b;
+			return h;
+		}
+
+		blocks.push_back(b);
+		return static_cast<handle_type>(blocks.size() - 1);
+	}
+	void release_block(handle_type h) {
+		unused_handles.push_back(h);
+	}
+
+	void insert_free_block(handle_type h) {
+		auto &b = blocks[h];
+		int fl, sl;
+		mapping(b.size >> granularity_log2, fl, sl);
+
+		auto &head = free_heads[fl][sl];
+		b.free = true;
+		b.prev_free = invalid_handle;
+		b.next_free = head;
+		if (head != invalid_handle)
+			blocks[head].prev_free = h;
+		head = h;
+
+		fl_bitmap |= static_cast<std::uint64_t>(1) << fl;
+		sl_bitmaps[fl] |= static_cast<std::uint32_t>(1) << sl;
+	}
+	void remove_free_block(handle_type h) {
+		auto &b = blocks[h];
+		int fl, sl;
+		mapping(b.size >> granularity_log2, fl, sl);
+
+		if (b.prev_free != invalid_handle)
+			blocks[b.prev_free].next_free = b.next_free;
+		if (b.next_free != invalid_handle)
+			blocks[b.next_free].prev_free = b.prev_free;
+
+		auto &head = free_heads[fl][sl];
+		if (head == h) {
+			head = b.next_free;
+			if (head == invalid_handle) {
+				sl_bitmaps[fl] &= ~(static_cast<std::uint32_t>(1) << sl);
+				if (!sl_bitmaps[fl])
+					fl_bitmap &= ~(static_cast<std::uint64_t>(1) << fl);
+			}
+		}
+
+		b.free = false;
+		b.prev_free = b.next_free = invalid_handle;
+	}
+
+	/**
+	*	@brief	Finds a free block of at least the requested size, in granularity units.
+	*/
+	handle_type find_free_block(size_type units) const {
+		int fl, sl;
+		if (!mapping_search(units, fl, sl))
+			return invalid_handle;
+
+		// Non-empty bins in the same first level, at or above sl
+		auto sl_map = sl_bitmaps[fl] & (~static_cast<std::uint32_t>(0) << sl);
+		if (!sl_map) {
+			// Next non-empty first level
+			if (fl + 1 >= fl_count)
+				return invalid_handle;
+			const auto fl_map = fl_bitmap & (~static_cast<std::uint64_t>(0) << (fl + 1));
+			if (!fl_map)
+				return invalid_handle;
+
+			fl = bit_scan_forward(fl_map);
+			sl_map = sl_bitmaps[fl];
+		}
+		sl = bit_scan_forward(sl_map);
+
+		return free_heads[fl][sl];
+	}
+
+	/**
+	*	@brief	Splits the tail of a block, past size, into a new free block.
+	*/
+	void split_tail(handle_type h, size_type size) {
+		const auto remainder = blocks[h].size - size;
+		if (!remainder)
+			return;
+
+		const auto tail = create_block(blocks[h].offset + size, remainder);
+		auto &b = blocks[h];
+		auto &t = blocks[tail];
+
+		t.prev_phys = h;
+		t.next_phys = b.next_phys;
+		if (b.next_phys != invalid_handle)
+			blocks[b.next_phys].prev_phys = tail;
+		b.next_phys = tail;
+		b.size = size;
+
+		insert_free_block(tail);
+	}
+
+	/**
+	*	@brief	Splits the head of a block, up to size, into a new free block. Returns the handle of the remainder.
+	*/
+	handle_type split_head(handle_type h, size_type size) {
+		if (!size)
+			return h;
+
+		const auto tail = create_block(blocks[h].offset + size, blocks[h].size - size);
+		auto &b = blocks[h];
+		auto &t = blocks[tail];
+
+		t.prev_phys = h;
+		t.next_phys = b.next_phys;
+		if (b.next_phys != invalid_handle)
+			blocks[b.next_phys].prev_phys = tail;
+		b.next_phys = tail;
+		b.size = size;
+
+		insert_free_block(h);
+		return tail;
+	}
+
+	/**
+	*	@brief	Merges block next into its physical predecessor h.
+	*/
+	void merge(handle_type h, handle_type next) {
+		auto &b = blocks[h];
+		auto &n = blocks[next];
+
+		b.size += n.size;
+		b.next_phys = n.next_phys;
+		if (n.next_phys != invalid_handle)
+			blocks[n.next_phys].prev_phys = h;
+
+		release_block(next);
+	}
+
+public:
+	/**
+	*	@param size	Size of the managed range. Rounded down to the granularity.
+	*/
+	device_memory_tlsf(size_type size) : total_size(size >> granularity_log2 << granularity_log2) {
+		sl_bitmaps.fill(0);
+		for (auto &fl : free_heads)
+			fl.fill(invalid_handle);
+
+		if (total_size)
+			insert_free_block(create_block(0, total_size));
+	}
+
+	device_memory_tlsf(device_memory_tlsf&&) = default;
+	device_memory_tlsf &operator=(device_memory_tlsf&&) = default;
+
+	/**
+	*	@brief	Allocates a block.
+	*
+	*	@param size			Size, must be a non-zero multiple of the granularity
+	*	@param alignment	Offset alignment, a power of two
+	*	@param offset		Receives the allocated offset
+	*
+	*	@return	Handle to the allocated block, or invalid_handle if no free block can fit the allocation.
+	*/
+	handle_type allocate(size_type size, size_type alignment, size_type &offset) {
+		assert(size && !(size & (granularity - 1)));
+		alignment = std::max(alignment, granularity);
+
+		// Over-allocate to fit the alignment padding
+		const auto padding = alignment - granularity;
+		if (size > total_size || padding > total_size - size)
+			return invalid_handle;
+
+		auto h = find_free_block((size + padding) >> granularity_log2);
+		if (h == invalid_handle)
+			return invalid_handle;
+
+		remove_free_block(h);
+
+		// Split away the alignment padding, and the unused tail
+		const auto aligned_offset = (blocks[h].offset + alignment - 1) / alignment * alignment;
+		h = split_head(h, aligned_offset - blocks[h].offset);
+		split_tail(h, size);
+
+		allocated_size += size;
+		++allocated_blocks_count;
+
+		offset = blocks[h].offset;
+		return h;
+	}
+
+	/**
+	*	@brief	Deallocates a block, coalescing it with its free neighbours.
+	*/
+	void deallocate(handle_type h) {
+		assert(h < blocks.size() && !blocks[h].free);
+
+		allocated_size -= blocks[h].size;
+		--allocated_blocks_count;
+
+		const auto prev = blocks[h].prev_phys;
+		if (prev != invalid_handle && blocks[prev].free) {
+			remove_free_block(prev);
+			merge(prev, h);
+			h = prev;
+		}
+		const auto next = blocks[h].next_phys;
+		if (next != invalid_handle && blocks[next].free) {
+			remove_free_block(next);
+			merge(h, next);
+		}
+
+		insert_free_block(h);
+	}
+
+	auto get_offset(handle_type h) const { return blocks[h].offset; }
+	auto get_size(handle_type h) const { return blocks[h].size; }
+
+	/**
+	*	@brief	Returns the size of the managed range.
+	*/
+	auto get_total_size() const { return total_size; }
+	/**
+	*	@brief	Returns the sum of allocated sizes, including alignment padding.
+	*/
+	auto get_allocated_size() const { return allocated_size; }
+
+	/**
+	*	@brief	Generates a fragmentation report.
+	*			O(n) in the count of free blocks of the highest non-empty bin.
+	*/
+	device_memory_fragmentation_report fragmentation_report() const {
+		device_memory_fragmentation_report report;
+		report.free_bytes = byte_t(total_size - allocated_size);
+		report.free_blocks_count = blocks.size() - unused_handles.size() - allocated_blocks_count;
+		report.allocated_blocks_count = allocated_blocks_count;
+
+		if (fl_bitmap) {
+			const auto fl = bit_scan_reverse(fl_bitmap);
+			const auto sl = bit_scan_reverse(sl_bitmaps[fl]);
+
+			size_type largest = 0;
+			for (auto h = free_heads[fl][sl]; h != invalid_handle; h = blocks[h].next_free)
+				largest = std::max(largest, blocks[h].size);
+			report.largest_free_block = byte_t(largest);
+		}
+
+		return report;
+	}
+
+	/**
+	*	@brief	Verifies the allocator's invariants: The blocks tile the range with no two adjacent free blocks, every free
+	*			block is linked into the free list of its bin and the bitmaps mark exactly the non-empty bins.
+	*			O(n) in the count of blocks, meant for testing.
+	*/
+	bool validate() const {
+		lib::vector<bool> live(blocks.size(), true);
+		for (auto h : unused_handles) {
+			if (h >= blocks.size() || !live[h])
+				return false;
+			live[h] = false;
+		}
+
+		// Physical chain
+		handle_type first = invalid_handle;
+		std::size_t live_count = 0;
+		for (handle_type h = 0; h < blocks.size(); ++h) {
+			if (!live[h])
+				continue;
+			++live_count;
+			if (blocks[h].prev_phys == invalid_handle) {
+				if (first != invalid_handle)
+					return false;
+				first = h;
+			}
+		}
+		if (!total_size)
+			return live_count == 0;
+
+		size_type offset = 0;
+		size_type allocated = 0;
+		std::size_t allocated_count = 0, free_count = 0, chain_count = 0;
+		for (auto h = first, prev = invalid_handle; h != invalid_handle; prev = h, h = blocks[h].next_phys) {
+			const auto &b = blocks[h];
+			if (!live[h] || b.prev_phys != prev || b.offset != offset || !b.size || (b.size & (granularity - 1)))
+				return false;
+			if (b.free && prev != invalid_handle && blocks[prev].free)
+				return false;
+
+			if (b.free)
+				++free_count;
+			else {
+				allocated += b.size;
+				++allocated_count;
+			}
+			offset += b.size;
+			++chain_count;
+		}
+		if (offset != total_size || chain_count != live_count ||
+			allocated != allocated_size || allocated_count != allocated_blocks_count)
+			return false;
+
+		// Free lists and bitmaps
+		std::size_t listed = 0;
+		for (int fl = 0; fl < fl_count; ++fl) {
+			for (int sl = 0; sl < static_cast<int>(sl_count); ++sl) {
+				const bool bit = !!(sl_bitmaps[fl] & (static_cast<std::uint32_t>(1) << sl));
+				if (bit != (free_heads[fl][sl] != invalid_handle))
+					return false;
+
+				for (auto h = free_heads[fl][sl], prev = invalid_handle; h != invalid_handle; prev = h, h = blocks[h].next_free) {
+					int bfl, bsl;
+					mapping(blocks[h].size >> granularity_log2, bfl, bsl);
+					if (!live[h] || !blocks[h].free || blocks[h].prev_free != prev || bfl != fl || bsl != sl ||
+						++listed > free_count)
+						return false;
+				}
+			}
+
+			const bool bit = !!(fl_bitmap & (static_cast<std::uint64_t>(1) << fl));
+			if (bit != !!sl_bitmaps[fl])
+				return false;
+		}
+
+		return listed == free_count;
+	}
+};
+
+}
+}
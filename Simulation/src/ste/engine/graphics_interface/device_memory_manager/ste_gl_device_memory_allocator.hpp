@@ -452,6 +452,28 @@ public:
 
 		return total_allocated_memory;
 	}
+
+	/**
+	*	@brief	Returns the combined fragmentation report of all chunks of specified type.
+	*			Thread safe.
+	*
+	*	@param	type	Memory type
+	*/
+	auto get_fragmentation_report_of_type(const memory_type_t &type) const {
+		device_memory_fragmentation_report report;
+
+		assert(type < heaps.size());
+		auto &heap = heaps[type];
+
+		{
+			std::unique_lock<std::mutex> lock(heap.m);
+
+			for (auto it = heap.chunks.begin(); it != heap.chunks.end(); ++it)
+				report += it->second.get_fragmentation_report();
+		}
+
+		return report;
+	}
 };
 
 }
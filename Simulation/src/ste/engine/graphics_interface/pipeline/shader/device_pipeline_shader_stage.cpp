@@ -1,10 +1,61 @@
-
 #include <stdafx.hpp>
 #include <device_pipeline_shader_stage.hpp>
 #include <ste_shader_spirv_reflection.hpp>
+#include <ste_shader_spirv_reflection_cache_entry.hpp>
 
+using namespace ste;
 using namespace ste::gl;
 
 ste_shader_spirv_reflection_output device_pipeline_shader_stage::verify_spirv_and_read_bindings(const ste::lib::string &code) {
 	return ste_shader_spirv_reflection::parse(code);
 }
+
+lib::unique_ptr<const ste_shader_object> device_pipeline_shader_stage::load_shader_from_pack(const ste_context &ctx,
+																								const lib::string &name,
+																								const ste_shader_pack::module &module) {
+	verify_blob_header_sanity(module.header);
+	if (module.code_size % sizeof(std::uint32_t) != 0)
+		throw ste_shader_load_spirv_corrupt_or_incompatible();
+
+	// Reflection results are cached, keyed by the module's checksum, and the SPIR-v is parsed only on a cache miss.
+	const auto cache_key = lib::string("ste_shader_reflection") +
+		lib::to_string(ste_shader_spirv_reflection_cache_entry::format_version) + "_" +
+		lib::to_string(module.crc) + "_" +
+		lib::to_string(static_cast<std::uint64_t>(module.code_size));
+
+	auto &cache = ctx.engine().cache();
+	optional<ste_shader_spirv_reflection_cache_entry> entry;
+	try {
+		entry = cache.get<ste_shader_spirv_reflection_cache_entry>(cache_key);
+	}
+	catch (const std::exception &) {
+		entry = none;
+	}
+
+	if (!entry) {
+		ste_shader_spirv_reflection_cache_entry parsed;
+		parsed.output = ste_shader_spirv_reflection::parse(module.code,
+														   module.code_size / sizeof(std::uint32_t));
+		cache.insert(cache_key, parsed);
+
+		entry = std::move(parsed);
+	}
+
+	auto &stage_bindings = entry.get().output.bindings;
+	auto &parser_attachments = entry.get().output.attachments;
+
+	// Output attachments are relevant only for a fragment shader
+	const ste_shader_program_stage stage = module.header.type;
+	lib::vector<ste_shader_stage_attachment> stage_attachments = {};
+	if (stage == ste_shader_program_stage::fragment_program) {
+		stage_attachments = std::move(parser_attachments);
+	}
+
+	return lib::allocate_unique<const ste_shader_object>(ctx.device(),
+														 module.code,
+														 module.code_size,
+														 name.data(),
+														 stage,
+														 std::move(stage_bindings),
+														 std::move(stage_attachments));
+}
@@ -13,6 +13,7 @@
 #include <ste_shader_stage_binding.hpp>
 #include <ste_shader_program_stage.hpp>
 #include <ste_shader_blob_header.hpp>
+#include <ste_shader_pack.hpp>
 #include <ste_shader_exceptions.hpp>
 
 #include <ste_shader_spirv_reflection_output.hpp>
@@ -59,9 +60,17 @@ private:
 	}
 
 	static ste_shader_spirv_reflection_output verify_spirv_and_read_bindings(const lib::string &code);
+	static lib::unique_ptr<const ste_shader_object> load_shader_from_pack(const ste_context &ctx,
+																		  const lib::string &name,
+																		  const ste_shader_pack::module &module);
+
+	static lib::unique_ptr<const ste_shader_object> load_and_verify_shader_blob(const ste_context &ctx,
+																				const lib::string &name) {
+		// Prefer the shader pack, if available
+		auto pack_module = ctx.shader_pack().find(name);
+		if (pack_module)
+			return load_shader_from_pack(ctx, name, pack_module.get());
 
-	static auto load_and_verify_shader_blob(const ste_context &ctx,
-											const lib::string &name) {
 		const auto &modules_path = ctx.engine().storage().shader_module_dir_path();
 		auto path = modules_path / name;
 
@@ -112,8 +121,8 @@ private:
 
 public:
 	/**
-	*	@brief	Load a shader module named 'name' from the shader modules directory.
-	*			The shader modules directory path is specified by the context.
+	*	@brief	Load a shader module named 'name' from the context's shader pack, or, if not found in the pack, from the
+	*			shader modules directory. The shader modules directory path is specified by the context.
 	*
 	*	@throws std::ios_base::failure	On IO errors
 	*	@throws ste_shader_load_unrecognized_exception	If the shader module blob is corrupted or unrecognized by the loader
@@ -339,8 +339,13 @@ ste_shader_spirv_reflection_output ste_shader_spirv_reflection::parse(const lib:
 	spirv.resize(code.size() / 4);
 	memcpy(spirv.data(), code.data(), code.size());
 
+	return parse(spirv.data(), spirv.size());
+}
+
+ste_shader_spirv_reflection_output ste_shader_spirv_reflection::parse(const std::uint32_t *spirv, std::size_t words_count) {
 	// Verify magic and version
-	if (spirv[0] != spv::MagicNumber ||
+	if (words_count < 5 ||
+		spirv[0] != spv::MagicNumber ||
 		(spirv[1] >> 16) != (spv::Version >> 16)) {
 		throw ste_shader_load_spirv_corrupt_or_incompatible();
 	}
@@ -352,7 +357,7 @@ ste_shader_spirv_reflection_output ste_shader_spirv_reflection::parse(const lib:
 	lib::vector<const std::uint32_t *> postponed_ops;
 
 	// Read and parse bindings
-	for (std::size_t offset = 5; offset < spirv.size();) {
+	for (std::size_t offset = 5; offset < words_count;) {
 		const std::uint32_t *op = &spirv[offset];
 		const auto word_count = process_spirv_op(binds,
 												 op);
@@ -77,6 +77,11 @@ private:
 
 public:
 	static ste_shader_spirv_reflection_output parse(const lib::string &spirv_code);
+	/**
+	*	@param	spirv_code	SPIR-v code
+	*	@param	words_count	Code size in 32-bit words
+	*/
+	static ste_shader_spirv_reflection_output parse(const std::uint32_t *spirv_code, std::size_t words_count);
 };
 
 }
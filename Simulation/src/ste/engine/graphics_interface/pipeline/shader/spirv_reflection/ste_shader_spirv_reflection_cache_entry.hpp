@@ -0,0 +1,272 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <ste_shader_spirv_reflection_output.hpp>
+#include <ste_shader_stage_variable.hpp>
+#include <ste_shader_exceptions.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include <lib/string.hpp>
+#include <lib/unique_ptr.hpp>
+#include <string>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Serializable SPIR-v reflection output, allowing shader modules' reflection results to be cached instead of
+ *			reparsing the SPIR-v code.
+ */
+struct ste_shader_spirv_reflection_cache_entry {
+	static constexpr std::uint32_t format_version = 1;
+
+	ste_shader_spirv_reflection_output output;
+
+private:
+	enum class variable_kind : std::uint8_t {
+		opaque,
+		scalar,
+		matrix,
+		array,
+		structure,
+	};
+
+	template <class Archive>
+	static void save_string(Archive &ar, const lib::string &str) {
+		ar << std::string(str.begin(), str.end());
+	}
+	template <class Archive>
+	static lib::string load_string(Archive &ar) {
+		std::string str;
+		ar >> str;
+		return lib::string(str.begin(), str.end());
+	}
+
+	template <class Archive>
+	void save_variable(Archive &ar, const ste_shader_stage_variable *var) const {
+		variable_kind kind;
+		if (dynamic_cast<const ste_shader_stage_variable_scalar*>(var))
+			kind = variable_kind::scalar;
+		else if (dynamic_cast<const ste_shader_stage_variable_matrix*>(var))
+			kind = variable_kind::matrix;
+		else if (dynamic_cast<const ste_shader_stage_variable_array*>(var))
+			kind = variable_kind::array;
+		else if (dynamic_cast<const ste_shader_stage_variable_struct*>(var))
+			kind = variable_kind::structure;
+		else
+			kind = variable_kind::opaque;
+
+		ar << kind;
+		save_string(ar, var->name());
+		ar << static_cast<std::uint64_t>(var->offset());
+		save_string(ar, var->get_default_specialized_value());
+
+		switch (kind) {
+		case variable_kind::opaque:
+			ar << var->type();
+			break;
+		case variable_kind::scalar: {
+			auto *scalar = dynamic_cast<const ste_shader_stage_variable_scalar*>(var);
+			ar << scalar->type();
+			ar << static_cast<std::uint64_t>(scalar->width());
+			break;
+		}
+		case variable_kind::matrix: {
+			auto *matrix = dynamic_cast<const ste_shader_stage_variable_matrix*>(var);
+			save_variable(ar, matrix->underlying_variable());
+			ar << matrix->rows();
+			ar << matrix->columns();
+			ar << static_cast<std::uint64_t>(matrix->matrix_stride());
+			break;
+		}
+		case variable_kind::array: {
+			auto *array = dynamic_cast<const ste_shader_stage_variable_array*>(var);
+			save_variable(ar, array->underlying_variable());
+			ar << array->declared_size();
+			ar << static_cast<std::uint64_t>(array->stride());
+
+			// Array length specialization constants are referenced by their binding index
+			const bool length_spec_constant = array->length_spec_constant();
+			std::uint32_t spec_constant_bind_idx = 0;
+			if (length_spec_constant) {
+				for (auto &b : output.bindings) {
+					if (b.variable.get() == array->get_length_spec_constant_var()) {
+						spec_constant_bind_idx = b.bind_idx;
+						break;
+					}
+				}
+			}
+			ar << length_spec_constant;
+			ar << spec_constant_bind_idx;
+			break;
+		}
+		case variable_kind::structure: {
+			auto *structure = dynamic_cast<const ste_shader_stage_variable_struct*>(var);
+			ar << static_cast<std::uint64_t>(structure->count());
+			for (auto &e : *structure)
+				save_variable(ar, e.get());
+			break;
+		}
+		}
+	}
+
+	template <class Archive>
+	lib::unique_ptr<ste_shader_stage_variable> load_variable(Archive &ar) const {
+		variable_kind kind;
+		std::uint64_t offset;
+		ar >> kind;
+		auto name = load_string(ar);
+		ar >> offset;
+		auto default_specialized_value = load_string(ar);
+
+		lib::unique_ptr<ste_shader_stage_variable> var;
+		switch (kind) {
+		case variable_kind::opaque: {
+			ste_shader_stage_variable_type type;
+			ar >> type;
+			var = lib::allocate_unique<ste_shader_stage_variable_opaque>(type, name, byte_t(offset));
+			break;
+		}
+		case variable_kind::scalar: {
+			ste_shader_stage_variable_type type;
+			std::uint64_t width;
+			ar >> type;
+			ar >> width;
+			var = lib::allocate_unique<ste_shader_stage_variable_scalar>(type, name, byte_t(offset), byte_t(width));
+			break;
+		}
+		case variable_kind::matrix: {
+			auto scalar = load_variable(ar);
+			std::uint32_t rows, columns;
+			std::uint64_t matrix_stride;
+			ar >> rows;
+			ar >> columns;
+			ar >> matrix_stride;
+
+			if (!dynamic_cast<const ste_shader_stage_variable_scalar*>(scalar.get()))
+				throw ste_shader_load_unrecognized_exception();
+			lib::unique_ptr<ste_shader_stage_variable_scalar> scalar_var(static_cast<ste_shader_stage_variable_scalar*>(scalar.release()));
+			var = lib::allocate_unique<ste_shader_stage_variable_matrix>(std::move(scalar_var), name, byte_t(offset), rows, columns, byte_t(matrix_stride));
+			break;
+		}
+		case variable_kind::array: {
+			auto element = load_variable(ar);
+			std::uint32_t elements, spec_constant_bind_idx;
+			std::uint64_t stride;
+			bool length_spec_constant;
+			ar >> elements;
+			ar >> stride;
+			ar >> length_spec_constant;
+			ar >> spec_constant_bind_idx;
+
+			optional<const ste_shader_stage_variable_scalar*> length_specialization_constant;
+			if (length_spec_constant) {
+				for (auto &b : output.bindings) {
+					if (b.binding_type == ste_shader_stage_binding_type::spec_constant &&
+						b.bind_idx == spec_constant_bind_idx) {
+						if (auto ptr = dynamic_cast<const ste_shader_stage_variable_scalar*>(b.variable.get()))
+							length_specialization_constant = ptr;
+						break;
+					}
+				}
+
+				if (!length_specialization_constant)
+					throw ste_shader_load_unrecognized_exception();
+			}
+
+			var = lib::allocate_unique<ste_shader_stage_variable_array>(std::move(element), name, byte_t(offset), elements, byte_t(stride), length_specialization_constant);
+			break;
+		}
+		case variable_kind::structure: {
+			std::uint64_t count;
+			ar >> count;
+
+			lib::vector<lib::unique_ptr<ste_shader_stage_variable>> elements;
+			elements.reserve(static_cast<std::size_t>(count));
+			for (std::uint64_t i = 0; i < count; ++i)
+				elements.push_back(load_variable(ar));
+
+			var = lib::allocate_unique<ste_shader_stage_variable_struct>(std::move(elements), name, byte_t(offset));
+			break;
+		}
+		default:
+			throw ste_shader_load_unrecognized_exception();
+		}
+
+		if (default_specialized_value.size())
+			var->set_default_specialized_value(std::move(default_specialized_value));
+
+		return var;
+	}
+
+private:
+	friend class boost::serialization::access;
+
+	template <class Archive>
+	void save(Archive &ar, const unsigned int version) const {
+		ar << format_version;
+
+		ar << static_cast<std::uint64_t>(output.bindings.size());
+		for (auto &b : output.bindings) {
+			ar << b.set_idx;
+			ar << b.bind_idx;
+			ar << b.binding_type;
+			ar << b.block_layout;
+			save_variable(ar, b.variable.get());
+		}
+
+		ar << static_cast<std::uint64_t>(output.attachments.size());
+		for (auto &a : output.attachments) {
+			ar << a.location;
+			ar << a.block_layout;
+			save_variable(ar, a.variable.get());
+		}
+	}
+
+	template <class Archive>
+	void load(Archive &ar, const unsigned int version) {
+		std::uint32_t entry_version;
+		ar >> entry_version;
+		if (entry_version != format_version)
+			throw ste_shader_load_unrecognized_exception();
+
+		output = {};
+
+		std::uint64_t bindings_count;
+		ar >> bindings_count;
+		for (std::uint64_t i = 0; i < bindings_count; ++i) {
+			// Array length specialization constants reference previously loaded bindings
+			ste_shader_stage_binding b;
+			ar >> b.set_idx;
+			ar >> b.bind_idx;
+			ar >> b.binding_type;
+			ar >> b.block_layout;
+			b.variable = load_variable(ar);
+
+			output.bindings.push_back(std::move(b));
+		}
+
+		std::uint64_t attachments_count;
+		ar >> attachments_count;
+		for (std::uint64_t i = 0; i < attachments_count; ++i) {
+			ste_shader_stage_attachment a;
+			ar >> a.location;
+			ar >> a.block_layout;
+			a.variable = load_variable(ar);
+
+			output.attachments.push_back(std::move(a));
+		}
+	}
+
+	BOOST_SERIALIZATION_SPLIT_MEMBER()
+};
+
+}
+}
@@ -40,6 +40,23 @@ struct ste_shader_object {
 	{
 		assert(stage != ste_shader_program_stage::none);
 	}
+	ste_shader_object(const vk::vk_logical_device<> &device,
+					  const std::uint32_t *shader_code,
+					  std::size_t shader_code_size,
+					  const char *name,
+					  const ste_shader_program_stage &stage,
+					  lib::vector<ste_shader_stage_binding> &&stage_bindings,
+					  lib::vector<ste_shader_stage_attachment> &&stage_attachments = {})
+		: shader(device,
+				 shader_code,
+				 shader_code_size,
+				 name),
+		stage(stage),
+		stage_bindings(std::move(stage_bindings)),
+		stage_attachments(std::move(stage_attachments))
+	{
+		assert(stage != ste_shader_program_stage::none);
+	}
 
 	/**
 	*	@brief	Retrieve the stage flag for the shader module
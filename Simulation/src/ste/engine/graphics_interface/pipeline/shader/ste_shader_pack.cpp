@@ -0,0 +1,107 @@
+
+#include <stdafx.hpp>
+#include <ste_shader_pack.hpp>
+
+#include <log.hpp>
+#include <crc32.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ste;
+using namespace ste::gl;
+
+ste_shader_pack::ste_shader_pack(const std::experimental::filesystem::path &path) {
+	std::error_code err;
+	if (!std::experimental::filesystem::exists(path, err))
+		return;
+
+	try {
+		mapped_file file(path, mapped_file::access::read_only);
+		if (!file.is_mapped() || !open(std::move(file)))
+			ste_log_warn() << "Shader pack " << path.string() << " is corrupt or incompatible, ignoring." << std::endl;
+		else
+			ste_log() << "Mapped shader pack " << path.string() << " (" << modules_count << " modules)" << std::endl;
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't map shader pack " << path.string() << ": " << e.what() << std::endl;
+	}
+}
+
+bool ste_shader_pack::open(mapped_file &&file) {
+	const auto size = file.size();
+	if (size < sizeof(pack_header))
+		return false;
+
+	pack_header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != magic_value ||
+		header.version != format_version)
+		return false;
+
+	// Validate index
+	const std::size_t entries_offset = sizeof(pack_header);
+	const std::size_t names_offset = entries_offset + static_cast<std::size_t>(header.modules_count) * sizeof(pack_entry);
+	if (names_offset > size ||
+		size - names_offset < header.names_size)
+		return false;
+
+	const auto *pack_entries = reinterpret_cast<const pack_entry*>(file.data() + entries_offset);
+	for (std::uint32_t i = 0; i < header.modules_count; ++i) {
+		const auto &e = pack_entries[i];
+		if (e.name_offset > header.names_size ||
+			header.names_size - e.name_offset < e.name_length ||
+			e.code_offset % sizeof(std::uint32_t) != 0 ||
+			e.code_size % sizeof(std::uint32_t) != 0 ||
+			e.code_offset > size ||
+			size - e.code_offset < e.code_size)
+			return false;
+	}
+
+	map = std::move(file);
+	entries = reinterpret_cast<const pack_entry*>(map.data() + entries_offset);
+	names = map.data() + names_offset;
+	modules_count = header.modules_count;
+	pack_content_crc = header.content_crc;
+
+	return true;
+}
+
+optional<ste_shader_pack::module> ste_shader_pack::find(const lib::string &name) const {
+	if (!is_valid())
+		return none;
+
+	const auto entry_name = [this](const pack_entry &e) {
+		return std::make_pair(names + e.name_offset, static_cast<std::size_t>(e.name_length));
+	};
+	const auto compare = [&](const pack_entry &e, const lib::string &n) {
+		const auto en = entry_name(e);
+		const auto r = std::memcmp(en.first, n.data(), std::min(en.second, n.size()));
+		return r < 0 || (r == 0 && en.second < n.size());
+	};
+
+	// Index is sorted by name
+	const auto *end = entries + modules_count;
+	const auto *it = std::lower_bound(entries, end, name, compare);
+	if (it == end ||
+		it->name_length != name.size() ||
+		std::memcmp(names + it->name_offset, name.data(), name.size()) != 0)
+		return none;
+
+	module m;
+	m.header = it->header;
+	m.code = reinterpret_cast<const std::uint32_t*>(map.data() + it->code_offset);
+	m.code_size = static_cast<std::size_t>(it->code_size);
+	m.crc = it->crc;
+
+	// Verify
+	const auto crc = crc32::crc32_fast(m.code,
+									   m.code_size,
+									   crc32::crc32_fast(&m.header, sizeof(m.header)));
+	if (crc != m.crc) {
+		ste_log_warn() << "Shader pack module " << name << " failed verification, ignoring." << std::endl;
+		return none;
+	}
+
+	return m;
+}
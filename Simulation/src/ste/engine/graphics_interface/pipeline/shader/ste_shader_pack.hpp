@@ -0,0 +1,100 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <ste_shader_blob_header.hpp>
+
+#include <mapped_file.hpp>
+#include <optional.hpp>
+#include <lib/string.hpp>
+
+#include <filesystem>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Read-only, memory mapped, shader pack.
+ *
+ *	The pack is written by ste_spirv_compiler beside the shader modules and holds all compiled modules: An index,
+ *	sorted by module name, of the modules' blob headers, code ranges and CRC32 checksums, followed by the SPIR-v code.
+ *	Loading a module from the pack requires no file I/O. Modules are verified against their checksum when looked up.
+ *
+ *	Layout:	pack_header, pack_entry[modules_count], names (names_size bytes), SPIR-v code (4-byte aligned).
+ */
+class ste_shader_pack {
+public:
+	static constexpr std::uint32_t magic_value = 0x4B505453;	// "STPK"
+	static constexpr std::uint32_t format_version = 1;
+	static constexpr auto file_name = "programs.stepack";
+
+	struct pack_header {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t modules_count;
+		std::uint32_t names_size;
+		// CRC32 of the modules' checksums, identifies the pack's content
+		std::uint32_t content_crc;
+		std::uint32_t reserved;
+	};
+
+	struct pack_entry {
+		std::uint32_t name_offset;
+		std::uint32_t name_length;
+		std::uint64_t code_offset;
+		std::uint64_t code_size;
+		// CRC32 of the blob header and code
+		std::uint32_t crc;
+		std::uint32_t reserved;
+		ste_shader_blob_header header;
+	};
+
+	struct module {
+		ste_shader_blob_header header;
+		const std::uint32_t *code;
+		// Code size in bytes
+		std::size_t code_size;
+		std::uint32_t crc;
+	};
+
+private:
+	mapped_file map;
+	const pack_entry *entries{ nullptr };
+	const char *names{ nullptr };
+	std::uint32_t modules_count{ 0 };
+	std::uint32_t pack_content_crc{ 0 };
+
+private:
+	bool open(mapped_file &&file);
+
+public:
+	ste_shader_pack() = default;
+	/**
+	*	@brief	Maps a shader pack. If the pack doesn't exist or is corrupt, the pack is left invalid and modules should
+	*			be loaded from the shader modules directory.
+	*
+	*	@param path		Path to the pack file
+	*/
+	ste_shader_pack(const std::experimental::filesystem::path &path);
+	~ste_shader_pack() noexcept {}
+
+	ste_shader_pack(ste_shader_pack&&) = default;
+	ste_shader_pack &operator=(ste_shader_pack&&) = default;
+	ste_shader_pack(const ste_shader_pack&) = delete;
+	ste_shader_pack &operator=(const ste_shader_pack&) = delete;
+
+	/**
+	*	@brief	Looks up a module by name. Returns none if no such module exists in the pack, or if the module fails
+	*			verification.
+	*/
+	optional<module> find(const lib::string &name) const;
+
+	bool is_valid() const { return entries != nullptr; }
+	auto size() const { return modules_count; }
+	auto content_crc() const { return pack_content_crc; }
+};
+
+}
+}
@@ -160,6 +160,10 @@ public:
 		this->default_specialized_value = default_specialized_value;
 	}
 	/**
+	*	@brief	For specialization constants, returns the default value
+	*/
+	auto& get_default_specialized_value() const { return default_specialized_value; }
+	/**
 	*	@brief	For specialization constants, resets the specializable constant
 	*/
 	void reset_specialization() {
@@ -491,6 +495,10 @@ public:
 		return length_specialization_constant.get()->read_specialized_value<std::uint32_t>();
 	}
 	/*
+	*	@brief	Declared array length, ignoring specializations.
+	*/
+	auto declared_size() const { return array_elements; }
+	/*
 	*	@brief	Returns true if array length is a constant that can be specialized.
 	*/
 	bool length_spec_constant() const { return !!length_specialization_constant; }
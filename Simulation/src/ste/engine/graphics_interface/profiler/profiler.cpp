@@ -71,6 +71,8 @@ void profiler::end_segment() {
 		results.data.push_back(a);
 	}
 
+	results.upload_arena = ctx.get().device().upload_arena().sample_statistics();
+
 	segment_results_available_signal.emit(results);
 
 	// Clear and use for next segment
@@ -5,6 +5,7 @@
 
 #include <stdafx.hpp>
 #include <ste_context.hpp>
+#include <ste_device_upload_arena.hpp>
 
 #include <vk_query_pool.hpp>
 #include <command_recorder.hpp>
@@ -74,6 +75,9 @@ public:
 	struct segment_results_t {
 		std::uint64_t segment_idx;
 		lib::vector<segment_result_atom> data;
+
+		// Device upload arena statistics, high-water mark is tracked since the previous results
+		ste_device_upload_arena::statistics upload_arena;
 	};
 	using segment_results_available_signal_t = signal<segment_results_t>;
 
@@ -66,8 +66,8 @@ private:
 			image_presentation_sync_t sync_object = {
 				nullptr,
 				{
-					device->get_sync_primitives_pools().semaphores().claim(),
-					device->get_sync_primitives_pools().semaphores().claim()
+					device->get_sync_primitives_pools().binary_semaphores().claim(),
+					device->get_sync_primitives_pools().binary_semaphores().claim()
 				}
 			};
 			v.push_back(std::move(sync_object));
@@ -92,8 +92,8 @@ private:
 		}
 
 		// Acquire a couple of semaphores and a fence
-		auto semaphores = presentation_engine_sync_semaphores(device->get_sync_primitives_pools().semaphores().claim(),
-															  device->get_sync_primitives_pools().semaphores().claim());
+		auto semaphores = presentation_engine_sync_semaphores(device->get_sync_primitives_pools().binary_semaphores().claim(),
+															  device->get_sync_primitives_pools().binary_semaphores().claim());
 
 		// Wait for outstanding presentations
 		auto max_outstanding = std::min<std::uint32_t>(max_frame_lag,
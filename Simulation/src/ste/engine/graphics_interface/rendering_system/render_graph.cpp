@@ -0,0 +1,224 @@
+#include <stdafx.hpp>
+#include <render_graph.hpp>
+
+#include <cmd_pipeline_barrier.hpp>
+#include <cmd_wait_events.hpp>
+#include <cmd_set_event.hpp>
+#include <cmd_execute_commands.hpp>
+#include <ste_engine_exceptions.hpp>
+#include <task_future.hpp>
+
+#include <lib/shared_ptr.hpp>
+
+using namespace ste;
+using namespace ste::gl;
+
+render_graph::resource render_graph::import_resource(resource_t &&r) {
+	const auto key = r.key();
+	for (std::size_t i = 0; i < resources.size(); ++i)
+		if (resources[i].key() == key)
+			return resource(static_cast<std::uint32_t>(i));
+
+	resources.push_back(std::move(r));
+	return resource(static_cast<std::uint32_t>(resources.size() - 1));
+}
+
+void render_graph::add_usage(std::uint32_t pass,
+							 const resource &r,
+							 pipeline_stage stages,
+							 access_flags access,
+							 image_layout layout,
+							 bool write) {
+	if (resources[r.index].buffer)
+		layout = image_layout::undefined;
+	else if (layout == image_layout::undefined)
+		throw ste_engine_exception("Image usage must specify a layout");
+
+	auto &usages = passes[pass].usages;
+
+	// Merge multiple usages of a resource by a pass
+	for (auto &u : usages) {
+		if (u.resource != r.index)
+			continue;
+		if (u.layout != layout)
+			throw ste_engine_exception("Pass uses an image in multiple layouts");
+
+		u.stages = u.stages | stages;
+		u.access = u.access | access;
+		u.write = u.write || write;
+		return;
+	}
+
+	render_graph_compiler::usage u;
+	u.resource = r.index;
+	u.stages = stages;
+	u.access = access;
+	u.layout = layout;
+	u.write = write;
+	usages.push_back(u);
+}
+
+pipeline_barrier render_graph::create_barrier(const render_graph_compiler::barrier_batch &batch) const {
+	lib::vector<buffer_memory_barrier> buffer_barriers;
+	lib::vector<image_memory_barrier> image_barriers;
+	for (auto &b : batch.barriers) {
+		auto &r = resources[b.resource];
+		if (r.image) {
+			image_barriers.emplace_back(*r.image,
+										b.old_layout,
+										b.new_layout,
+										b.src_access,
+										b.dst_access);
+		}
+		else {
+			buffer_barriers.emplace_back(*r.buffer,
+										 b.src_access,
+										 b.dst_access);
+		}
+	}
+
+	return pipeline_barrier(batch.src_stages,
+							batch.dst_stages,
+							{},
+							buffer_barriers,
+							image_barriers);
+}
+
+lib::shared_ptr<render_graph::frame_command_pool_t> render_graph::claim_thread_command_pool(frame_command_pools_t &frame_pools) const {
+	std::unique_lock<std::mutex> l(frame_pools.m);
+
+	auto &pool = frame_pools.pools[std::this_thread::get_id()];
+	if (!pool)
+		pool = lib::allocate_shared<frame_command_pool_t>(frame_command_pool_t{ command_pools, command_pools->claim() });
+
+	return pool;
+}
+
+void render_graph::record_parallel_passes(frame_command_pools_t &frame_pools,
+										  const render_graph_compiler::plan &plan,
+										  std::size_t begin,
+										  std::size_t end,
+										  lib::vector<parallel_pass_t> &out) const {
+	lib::vector<task_future<parallel_pass_t>> futures;
+	futures.reserve(end - begin);
+	for (auto i = begin; i < end; ++i) {
+		auto &record = pass_records[plan.passes[i].pass].record;
+		futures.push_back(ctx.get().engine().task_scheduler().schedule_now([this, &frame_pools, &record]() {
+			auto pool = claim_thread_command_pool(frame_pools);
+			auto &buffer = pool->pool.get().allocate_secondary_buffer();
+			{
+				auto recorder = buffer.record(secondary_command_buffer_inheritance{});
+				record(recorder);
+			}
+
+			return parallel_pass_t{ &buffer, std::move(pool) };
+		}));
+	}
+
+	// Collect all the recordings before rethrowing, the tasks reference the frame's pools.
+	// Waiting on a task that was not yet picked up by a worker executes it in place.
+	std::exception_ptr exception;
+	for (std::size_t i = 0; i < futures.size(); ++i) {
+		try {
+			out[begin + i] = futures[i].get();
+		}
+		catch (...) {
+			exception = std::current_exception();
+		}
+	}
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void render_graph::record(command_recorder &recorder) {
+	// Fetch known resources states
+	lib::vector<optional<render_graph_compiler::resource_state>> resources_states(resources.size());
+	for (std::size_t i = 0; i < resources.size(); ++i) {
+		auto it = states.find(resources[i].key());
+		if (it != states.end())
+			resources_states[i] = it->second;
+	}
+
+	const auto plan = render_graph_compiler::compile(passes, resources_states);
+
+	for (std::size_t i = 0; i < resources.size(); ++i)
+		if (resources_states[i])
+			states[resources[i].key()] = resources_states[i].get();
+
+	// Claim events. The events are retained by the command buffer, and are returned to the pool only once the device is
+	// done with it.
+	using event_t = ste_device_sync_primitives_pools::event_pool_t::resource_t;
+	lib::vector<lib::shared_ptr<event_t>> events;
+	events.reserve(plan.events_count);
+	for (std::uint32_t i = 0; i < plan.events_count; ++i)
+		events.push_back(lib::allocate_shared<event_t>(ctx.get().device().get_sync_primitives_pools().events().claim()));
+
+	// Secondary buffers need to be allocated from pools of the queue family the graph is recorded for
+	const auto &queue_descriptor = recorder.get_queue_descriptor();
+	if (!command_pools || command_pools_family != queue_descriptor.family) {
+		const vk::vk_logical_device<> &device = ctx.get().device();
+		command_pools = lib::allocate_shared<command_pools_t>(device, queue_descriptor);
+		command_pools_family = queue_descriptor.family;
+	}
+
+	frame_command_pools_t frame_pools;
+	lib::vector<parallel_pass_t> parallel_passes(plan.passes.size());
+
+	for (std::size_t i = 0; i < plan.passes.size(); ++i) {
+		auto &p = plan.passes[i];
+		auto &record = pass_records[p.pass];
+
+		// Record a run of consecutive parallel passes concurrently. All preceding passes have been recorded by now.
+		if (record.parallel && !parallel_passes[i].buffer) {
+			auto end = i + 1;
+			while (end < plan.passes.size() && pass_records[plan.passes[end].pass].parallel)
+				++end;
+			record_parallel_passes(frame_pools, plan, i, end, parallel_passes);
+		}
+
+		// Synchronize
+		if (!p.wait_events.empty()) {
+			lib::vector<VkEvent> wait_events;
+			wait_events.reserve(p.wait_events.size());
+			for (auto &e : p.wait_events)
+				wait_events.push_back(events[e]->get());
+
+			const auto barrier = create_barrier(p.wait_barrier);
+			recorder << cmd_wait_events(std::move(wait_events), barrier);
+		}
+		if (!p.barrier.empty()) {
+			const auto barrier = create_barrier(p.barrier);
+			recorder << cmd_pipeline_barrier(barrier);
+		}
+
+		// Record pass
+		if (record.parallel) {
+			const auto execute = [&]() {
+				// The primary buffer holds onto the command pool, which is recycled only once the device is done with the frame
+				const lib::vector<std::reference_wrapper<command_buffer>> buffers = { *parallel_passes[i].buffer };
+				auto cmd = cmd_execute_commands(buffers);
+				cmd.retain_resource(parallel_passes[i].pool);
+				recorder << std::move(cmd);
+			};
+
+			if (record.scope)
+				record.scope(recorder, execute);
+			else
+				execute();
+		}
+		else {
+			record.record(recorder);
+		}
+
+		// Signal consumers
+		for (auto &s : p.signals) {
+			auto cmd = cmd_set_event(events[s.event]->get(), s.stages);
+			cmd.retain_resource(events[s.event]);
+			recorder << std::move(cmd);
+		}
+	}
+
+	resources.clear();
+	passes.clear();
+	pass_records.clear();
+}
@@ -0,0 +1,254 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <ste_context.hpp>
+#include <command_recorder.hpp>
+
+#include <render_graph_compiler.hpp>
+#include <render_graph_command_pool.hpp>
+#include <ste_resource_pool.hpp>
+
+#include <device_buffer_base.hpp>
+#include <device_image_base.hpp>
+#include <pipeline_barrier.hpp>
+
+#include <lib/vector.hpp>
+#include <lib/flat_map.hpp>
+#include <lib/shared_ptr.hpp>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <alias.hpp>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Render graph. Passes declare the resources they read and write, the graph infers the synchronization between them.
+ *
+ *	Passes and resources are declared anew each frame, and are recorded, in declaration order, with record().
+ *	The graph emits a single merged pipeline barrier before a pass, uses events for dependencies between passes that
+ *	are not adjacent, and culls passes whose outputs are unused.
+ *	Resources synchronization states are kept between frames. See render_graph_compiler for details.
+ *
+ *	Passes marked parallel are recorded into secondary command buffers on the task scheduler's workers. Consecutive
+ *	parallel passes are recorded concurrently, once all the preceding passes were recorded, and are executed, along with
+ *	the synchronization, from the primary command buffer. Each thread records into its own command pool, pools are
+ *	claimed per frame and are recycled once the device is done with the frame.
+ */
+class render_graph {
+public:
+	using record_func_t = std::function<void(command_recorder &)>;
+	using scope_func_t = std::function<void(command_recorder &, const std::function<void()> &)>;
+
+	/**
+	 *	@brief	Handle to a resource imported into the graph
+	 */
+	class resource {
+		friend class render_graph;
+
+	private:
+		std::uint32_t index;
+
+		resource(std::uint32_t index) : index(index) {}
+	};
+
+	class pass_builder {
+		friend class render_graph;
+
+	private:
+		render_graph *graph;
+		std::uint32_t pass;
+
+		pass_builder(render_graph *graph, std::uint32_t pass) : graph(graph), pass(pass) {}
+
+	public:
+		/**
+		 *	@brief	Declares a read of a resource
+		 *
+		 *	@param	stages	Pipeline stages accessing the resource
+		 *	@param	access	Access flags
+		 *	@param	layout	Layout the image is expected to be in. Ignored for buffers.
+		 */
+		pass_builder &read(const resource &r,
+						   pipeline_stage stages,
+						   access_flags access,
+						   image_layout layout = image_layout::undefined) {
+			graph->add_usage(pass, r, stages, access, layout, false);
+			return *this;
+		}
+		/**
+		 *	@brief	Declares a write to a resource, might also read the resource.
+		 *
+		 *	@param	stages	Pipeline stages accessing the resource
+		 *	@param	access	Access flags
+		 *	@param	layout	Layout the image is expected to be in. Ignored for buffers.
+		 */
+		pass_builder &write(const resource &r,
+							pipeline_stage stages,
+							access_flags access,
+							image_layout layout = image_layout::undefined) {
+			graph->add_usage(pass, r, stages, access, layout, true);
+			return *this;
+		}
+		/**
+		 *	@brief	Declares the usages of a pass description, along with its side effects and enabled state.
+		 *
+		 *	@param	description	Pass description, usages refer to resources by index into resources
+		 *	@param	resources	Graph resources
+		 */
+		pass_builder &declare(const render_graph_compiler::pass &description,
+							  const lib::vector<resource> &resources) {
+			for (auto &u : description.usages)
+				graph->add_usage(pass, resources[u.resource], u.stages, u.access, u.layout, u.write);
+			graph->passes[pass].side_effects |= description.side_effects;
+			graph->passes[pass].enabled = description.enabled;
+			return *this;
+		}
+
+		/**
+		 *	@brief	Marks the pass as having side effects, e.g. writing to attachments or resources not tracked by the
+		 *			graph. Such passes are never culled.
+		 */
+		pass_builder &side_effects() {
+			graph->passes[pass].side_effects = true;
+			return *this;
+		}
+		/**
+		 *	@brief	Enables or disables the pass for the current frame
+		 */
+		pass_builder &enabled(bool e) {
+			graph->passes[pass].enabled = e;
+			return *this;
+		}
+		/**
+		 *	@brief	Records the pass into a secondary command buffer on a worker thread, concurrently with adjacent parallel
+		 *			passes. The pass must not begin a render pass, and its recording must not depend on host state mutated
+		 *			by the recording of adjacent parallel passes.
+		 *
+		 *	@param	scope	Optional. Called on the primary command buffer with a functor that records the execution of the
+		 *					pass' secondary command buffer. Allows wrapping the execution, e.g. with profiler atoms.
+		 */
+		pass_builder &parallel(scope_func_t &&scope = {}) {
+			graph->pass_records[pass].parallel = true;
+			graph->pass_records[pass].scope = std::move(scope);
+			return *this;
+		}
+	};
+
+private:
+	struct resource_t {
+		const device_buffer_base *buffer;
+		const device_image_base *image;
+
+		const void *key() const { return buffer ? static_cast<const void*>(buffer) : static_cast<const void*>(image); }
+	};
+
+	struct pass_record_t {
+		record_func_t record;
+		bool parallel{ false };
+		scope_func_t scope;
+	};
+
+	using command_pools_t = ste_resource_pool<render_graph_command_pool>;
+
+	/**
+	 *	@brief	A command pool claimed for a frame. Holds onto the resource pool, so the claimed pool can be returned to it
+	 *			even after the graph was destroyed.
+	 */
+	struct frame_command_pool_t {
+		lib::shared_ptr<command_pools_t> owner;
+		command_pools_t::resource_t pool;
+	};
+	// Command pools claimed for a frame, per recording thread
+	struct frame_command_pools_t {
+		std::mutex m;
+		lib::flat_map<std::thread::id, lib::shared_ptr<frame_command_pool_t>> pools;
+	};
+
+	// A parallel pass' recorded secondary buffer and the command pool it was allocated from
+	struct parallel_pass_t {
+		command_buffer *buffer{ nullptr };
+		lib::shared_ptr<frame_command_pool_t> pool;
+	};
+
+private:
+	alias<const ste_context> ctx;
+
+	lib::vector<resource_t> resources;
+	lib::vector<render_graph_compiler::pass> passes;
+	lib::vector<pass_record_t> pass_records;
+
+	lib::flat_map<const void*, render_graph_compiler::resource_state> states;
+
+	lib::shared_ptr<command_pools_t> command_pools;
+	std::uint32_t command_pools_family{ 0 };
+
+private:
+	resource import_resource(resource_t &&r);
+	void add_usage(std::uint32_t pass,
+				   const resource &r,
+				   pipeline_stage stages,
+				   access_flags access,
+				   image_layout layout,
+				   bool write);
+
+	pipeline_barrier create_barrier(const render_graph_compiler::barrier_batch &batch) const;
+
+	lib::shared_ptr<frame_command_pool_t> claim_thread_command_pool(frame_command_pools_t &frame_pools) const;
+	void record_parallel_passes(frame_command_pools_t &frame_pools,
+								const render_graph_compiler::plan &plan,
+								std::size_t begin,
+								std::size_t end,
+								lib::vector<parallel_pass_t> &out) const;
+
+public:
+	render_graph(const ste_context &ctx) : ctx(ctx) {}
+	~render_graph() noexcept {}
+
+	render_graph(render_graph&&) = default;
+	render_graph &operator=(render_graph&&) = default;
+
+	/**
+	 *	@brief	Imports a buffer into the graph for the current frame. Importing a resource multiple times yields the same handle.
+	 */
+	resource import_buffer(const device_buffer_base &buffer) {
+		return import_resource({ &buffer, nullptr });
+	}
+	/**
+	 *	@brief	Imports an image into the graph for the current frame. Importing a resource multiple times yields the same handle.
+	 */
+	resource import_image(const device_image_base &image) {
+		return import_resource({ nullptr, &image });
+	}
+
+	/**
+	 *	@brief	Adds a pass to the current frame. Passes are recorded in the order they were added.
+	 *
+	 *	@param	f	Records the pass' commands
+	 */
+	pass_builder add_pass(record_func_t &&f) {
+		passes.emplace_back();
+		pass_records.push_back({ std::move(f) });
+
+		return pass_builder(this, static_cast<std::uint32_t>(passes.size() - 1));
+	}
+
+	/**
+	 *	@brief	Compiles the graph and records the live passes along with the required synchronization.
+	 *			Clears the declared passes and resources.
+	 */
+	void record(command_recorder &recorder);
+
+	/**
+	 *	@brief	Forgets the resources synchronization states. Should be called when tracked resources are recreated.
+	 */
+	void reset_resources_states() { states.clear(); }
+};
+
+}
+}
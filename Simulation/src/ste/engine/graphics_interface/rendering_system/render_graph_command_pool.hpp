@@ -0,0 +1,67 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <vk_logical_device.hpp>
+#include <ste_device_queue_descriptors.hpp>
+#include <ste_device_queue_command_pool.hpp>
+#include <ste_resource_pool_traits.hpp>
+#include <command_buffer.hpp>
+
+#include <lib/vector.hpp>
+#include <lib/unique_ptr.hpp>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Command pool used by a single thread to record a frame's worth of render graph passes into secondary command
+ *			buffers.
+ *
+ *			Secondary buffers are kept for the lifetime of the pool and handed out again once the pool is reset, i.e.
+ *			reclaimed from the resource pool after the device is done with the previous frame.
+ */
+class render_graph_command_pool : public ste_resource_pool_resetable_trait<const vk::vk_logical_device<> &, ste_queue_descriptor> {
+public:
+	using buffer_t = command_buffer_secondary<false>;
+
+private:
+	ste_device_queue_command_pool pool;
+	// Buffers need to be destroyed before the pool they were allocated from
+	lib::vector<lib::unique_ptr<buffer_t>> buffers;
+	std::size_t used{ 0 };
+
+public:
+	render_graph_command_pool(const vk::vk_logical_device<> &device,
+							  const ste_queue_descriptor &queue_descriptor)
+		: pool(device, queue_descriptor)
+	{}
+	~render_graph_command_pool() noexcept {}
+
+	render_graph_command_pool(render_graph_command_pool&&) = default;
+	render_graph_command_pool &operator=(render_graph_command_pool&&) = default;
+
+	/**
+	 *	@brief	Returns a secondary command buffer in the initial state, allocating a new one if all of the pool's buffers
+	 *			were already handed out since the last reset.
+	 */
+	buffer_t &allocate_secondary_buffer() {
+		if (used == buffers.size())
+			buffers.push_back(lib::allocate_unique<buffer_t>(pool.get().allocate_secondary_buffer()));
+
+		return *buffers[used++];
+	}
+
+	/**
+	 *	@brief	Resets the pool, returning all of its buffers to the initial state.
+	 */
+	void reset() override {
+		pool.reset();
+		used = 0;
+	}
+};
+
+}
+}
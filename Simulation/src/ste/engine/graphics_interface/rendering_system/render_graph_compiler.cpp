@@ -0,0 +1,303 @@
+#include <stdafx.hpp>
+#include <render_graph_compiler.hpp>
+
+using namespace ste;
+using namespace ste::gl;
+
+namespace {
+
+constexpr auto no_stages = static_cast<pipeline_stage>(0);
+constexpr auto write_access_mask = access_flags::shader_write |
+	access_flags::color_attachment_write |
+	access_flags::depth_stencil_attachment_write |
+	access_flags::transfer_write |
+	access_flags::host_write |
+	access_flags::memory_write |
+	access_flags::command_process_write_nvx;
+
+auto write_access(access_flags access) {
+	return access & write_access_mask;
+}
+auto read_access(access_flags access) {
+	return access ^ write_access(access);
+}
+
+bool is_write(const render_graph_compiler::usage &u) {
+	return u.write || write_access(u.access) != access_flags::none;
+}
+bool is_read(const render_graph_compiler::usage &u) {
+	return read_access(u.access) != access_flags::none;
+}
+bool needs_transition(const render_graph_compiler::usage &u, image_layout layout) {
+	return u.layout != image_layout::undefined && u.layout != layout;
+}
+
+bool contains(pipeline_stage set, pipeline_stage stages) {
+	return (set & stages) == stages;
+}
+bool contains(access_flags set, access_flags access) {
+	return (set & access) == access;
+}
+
+}
+
+lib::vector<std::uint32_t> render_graph_compiler::live_passes(const lib::vector<pass> &passes) {
+	lib::vector<bool> live(passes.size(), false);
+	for (std::size_t i = 0; i < passes.size(); ++i)
+		live[i] = passes[i].enabled && passes[i].side_effects;
+
+	// A pass is live if a live pass reads a resource it writes. As the graph executes cyclically, readers that precede the
+	// writer count as well.
+	for (bool changed = true; changed;) {
+		changed = false;
+
+		for (std::size_t i = 0; i < passes.size(); ++i) {
+			if (live[i] || !passes[i].enabled)
+				continue;
+
+			for (auto &u : passes[i].usages) {
+				if (!is_write(u))
+					continue;
+
+				for (std::size_t j = 0; j < passes.size() && !live[i]; ++j) {
+					if (!live[j])
+						continue;
+					for (auto &v : passes[j].usages) {
+						if (v.resource == u.resource && is_read(v)) {
+							live[i] = true;
+							break;
+						}
+					}
+				}
+				if (live[i]) {
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+
+	lib::vector<std::uint32_t> ret;
+	for (std::size_t i = 0; i < passes.size(); ++i)
+		if (live[i])
+			ret.push_back(static_cast<std::uint32_t>(i));
+
+	return ret;
+}
+
+void render_graph_compiler::simulate(const lib::vector<pass> &passes,
+									 const lib::vector<std::uint32_t> &live,
+									 lib::vector<tracked_state> &states,
+									 plan *out) {
+	// Union of the reads that follow a write or a layout transition, up to the next write. A single barrier makes the
+	// write visible to all of them.
+	const auto reads_until_next_write = [&](std::uint32_t live_idx, const usage &first, pipeline_stage &stages, access_flags &access) {
+		stages = first.stages;
+		access = read_access(first.access);
+
+		for (auto idx = live_idx + 1; idx < live.size(); ++idx) {
+			for (auto &v : passes[live[idx]].usages) {
+				if (v.resource != first.resource)
+					continue;
+				if (is_write(v) || needs_transition(v, first.layout))
+					return;
+
+				stages = stages | v.stages;
+				access = access | read_access(v.access);
+			}
+		}
+	};
+
+	for (std::uint32_t live_idx = 0; live_idx < live.size(); ++live_idx) {
+		const auto &p = passes[live[live_idx]];
+		lib::vector<pending_barrier> pending;
+
+		for (auto &u : p.usages) {
+			auto &t = states[u.resource];
+			auto &s = t.state;
+			const bool writes = is_write(u);
+
+			if (!t.known) {
+				// Nothing is known about the resource, adopt the usage's state
+				t.known = true;
+				s = resource_state{};
+				s.layout = u.layout;
+				if (writes) {
+					s.write_stages = u.stages;
+					s.write_access = write_access(u.access);
+					t.writer = live_idx;
+				}
+				else {
+					s.read_stages = u.stages;
+					t.reader = live_idx;
+				}
+				continue;
+			}
+
+			const bool transition = needs_transition(u, s.layout);
+			if (writes || transition) {
+				// Wait on reads since last write. If there were none, wait on the last write.
+				pending_barrier pb;
+				pb.b.resource = u.resource;
+				pb.b.old_layout = transition ? s.layout : u.layout;
+				pb.b.new_layout = u.layout;
+				if (s.read_stages != no_stages) {
+					pb.b.src_stages = s.read_stages;
+					pb.b.src_access = access_flags::none;
+					pb.producer = t.reader;
+				}
+				else if (s.write_stages != no_stages) {
+					pb.b.src_stages = s.write_stages;
+					pb.b.src_access = s.write_access;
+					pb.producer = t.writer;
+				}
+				else {
+					pb.b.src_stages = pipeline_stage::top_of_pipe;
+					pb.b.src_access = access_flags::none;
+					pb.producer = invalid_index;
+				}
+
+				if (writes) {
+					pb.b.dst_stages = u.stages;
+					pb.b.dst_access = u.access;
+
+					s.write_stages = u.stages;
+					s.write_access = write_access(u.access);
+					s.read_stages = no_stages;
+					s.visible_stages = no_stages;
+					s.visible_access = access_flags::none;
+					t.reader = invalid_index;
+				}
+				else {
+					// Read-only usage that transitions the layout. The transition is made visible to all the following reads.
+					reads_until_next_write(live_idx, u, pb.b.dst_stages, pb.b.dst_access);
+
+					s.write_stages = pb.b.dst_stages;
+					s.write_access = access_flags::none;
+					s.read_stages = u.stages;
+					s.visible_stages = pb.b.dst_stages;
+					s.visible_access = pb.b.dst_access;
+					t.reader = live_idx;
+				}
+				s.layout = transition ? u.layout : s.layout;
+				t.writer = live_idx;
+
+				pending.push_back(pb);
+				continue;
+			}
+
+			if (!is_read(u))
+				continue;
+
+			// Read. Needs a barrier only if the last write wasn't yet made visible to the usage.
+			if (s.write_stages != no_stages &&
+				!(contains(s.visible_stages, u.stages) && contains(s.visible_access, read_access(u.access)))) {
+				pending_barrier pb;
+				pb.b.resource = u.resource;
+				pb.b.old_layout = pb.b.new_layout = u.layout;
+				pb.b.src_stages = s.write_stages;
+				pb.b.src_access = s.write_access;
+				pb.producer = t.writer;
+				reads_until_next_write(live_idx, u, pb.b.dst_stages, pb.b.dst_access);
+
+				s.visible_stages = s.visible_stages | pb.b.dst_stages;
+				s.visible_access = s.visible_access | pb.b.dst_access;
+
+				pending.push_back(pb);
+			}
+
+			if (s.read_stages == no_stages)
+				t.reader = live_idx;
+			else if (t.reader != live_idx)
+				t.reader = invalid_index;
+			s.read_stages = s.read_stages | u.stages;
+		}
+
+		if (!out)
+			continue;
+
+		compiled_pass cp;
+		cp.pass = live[live_idx];
+
+		// Event per producing pass
+		lib::vector<std::pair<std::uint32_t, std::uint32_t>> producer_events;
+		for (auto &pb : pending) {
+			// Hazards within a pass are the pass's own responsibility
+			if (pb.producer == live_idx)
+				continue;
+
+			// Split the barrier when at least a single pass separates the producer and the consumer
+			const bool split = pb.producer != invalid_index && pb.producer + 1 < live_idx;
+			if (!split) {
+				cp.barrier.src_stages = cp.barrier.src_stages | pb.b.src_stages;
+				cp.barrier.dst_stages = cp.barrier.dst_stages | pb.b.dst_stages;
+				cp.barrier.barriers.push_back(pb.b);
+				continue;
+			}
+
+			auto it = std::find_if(producer_events.begin(), producer_events.end(), [&](const auto &e) {
+				return e.first == pb.producer;
+			});
+			if (it == producer_events.end()) {
+				const auto event = out->events_count++;
+				out->passes[pb.producer].signals.push_back({ event, no_stages });
+				cp.wait_events.push_back(event);
+
+				producer_events.emplace_back(pb.producer, event);
+				it = producer_events.end() - 1;
+			}
+
+			// Set the event once all the source stages are done
+			auto &signal = *std::find_if(out->passes[pb.producer].signals.begin(), out->passes[pb.producer].signals.end(), [&](const auto &e) {
+				return e.event == it->second;
+			});
+			signal.stages = signal.stages | pb.b.src_stages;
+
+			cp.wait_barrier.src_stages = cp.wait_barrier.src_stages | pb.b.src_stages;
+			cp.wait_barrier.dst_stages = cp.wait_barrier.dst_stages | pb.b.dst_stages;
+			cp.wait_barrier.barriers.push_back(pb.b);
+		}
+
+		out->passes.push_back(std::move(cp));
+	}
+}
+
+render_graph_compiler::plan render_graph_compiler::compile(const lib::vector<pass> &passes,
+														   lib::vector<optional<resource_state>> &resource_states) {
+	const auto live = live_passes(passes);
+
+	lib::vector<tracked_state> states(resource_states.size());
+	bool unknown_states = false;
+	for (std::size_t i = 0; i < resource_states.size(); ++i) {
+		if (resource_states[i]) {
+			states[i].known = true;
+			states[i].state = resource_states[i].get();
+		}
+		else {
+			unknown_states = true;
+		}
+	}
+
+	// Assume cyclic execution for resources with unknown state: A dry run yields their state at the end of the graph,
+	// which is then used as their initial state.
+	if (unknown_states) {
+		auto dry_run = states;
+		simulate(passes, live, dry_run, nullptr);
+
+		for (std::size_t i = 0; i < states.size(); ++i) {
+			if (!states[i].known && dry_run[i].known) {
+				states[i].known = true;
+				states[i].state = dry_run[i].state;
+			}
+		}
+	}
+
+	plan p;
+	simulate(passes, live, states, &p);
+
+	for (std::size_t i = 0; i < states.size(); ++i)
+		if (states[i].known)
+			resource_states[i] = states[i].state;
+
+	return p;
+}
@@ -0,0 +1,159 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <pipeline_stage.hpp>
+#include <access_flags.hpp>
+#include <image_layout.hpp>
+
+#include <lib/vector.hpp>
+#include <optional.hpp>
+
+namespace ste {
+namespace gl {
+
+/**
+ *	@brief	Compiles the resource usages declared by a render graph's passes into a synchronization plan.
+ *
+ *	The compiler works on plain descriptions, resources are referred to by index, and does not record any commands.
+ *	For each live pass it produces, at most, a single merged pipeline barrier and a single events wait preceding the pass,
+ *	and the events to set once the pass was recorded.
+ *
+ *	Synchronization is inferred per resource:
+ *	Writes (and image layout transitions) wait on all reads performed since the last write, or on the last write if there
+ *	were none. Reads wait on the last write, a single barrier makes the write visible to all the reads up to the next write.
+ *	Reads of a resource that is not written by the graph need no synchronization.
+ *	When the producing pass isn't the pass immediately preceding the consumer, the dependency is expressed as a split
+ *	barrier: An event set after the producer and waited upon before the consumer.
+ *
+ *	Resources states carry over between compilations, i.e. frames. Resources without a known state assume the graph is
+ *	executed cyclically, and start at the state they end the graph with.
+ *
+ *	Plans compiled for primary_renderer's graph are checked by the ste_tests tool.
+ */
+class render_graph_compiler {
+public:
+	static constexpr std::uint32_t invalid_index = 0xFFFFFFFF;
+
+	/**
+	 *	@brief	Resource synchronization state
+	 */
+	struct resource_state {
+		image_layout layout{ image_layout::undefined };
+
+		// Stages and access of the last write
+		pipeline_stage write_stages{ static_cast<pipeline_stage>(0) };
+		access_flags write_access{ access_flags::none };
+		// Stages that read the resource since the last write
+		pipeline_stage read_stages{ static_cast<pipeline_stage>(0) };
+		// Stages and access the last write was made visible to
+		pipeline_stage visible_stages{ static_cast<pipeline_stage>(0) };
+		access_flags visible_access{ access_flags::none };
+	};
+
+	/**
+	 *	@brief	A resource usage declared by a pass
+	 */
+	struct usage {
+		std::uint32_t resource;
+		pipeline_stage stages;
+		access_flags access;
+		// Layout the image is expected to be in. Ignored for buffers.
+		image_layout layout{ image_layout::undefined };
+		// Usage writes to the resource. Implied by write access flags.
+		bool write{ false };
+	};
+
+	struct pass {
+		lib::vector<usage> usages;
+		bool enabled{ true };
+		// Passes with side effects, i.e. passes that write to resources not tracked by the graph, are never culled
+		bool side_effects{ false };
+	};
+
+	struct barrier {
+		std::uint32_t resource;
+		pipeline_stage src_stages;
+		pipeline_stage dst_stages;
+		access_flags src_access;
+		access_flags dst_access;
+		image_layout old_layout;
+		image_layout new_layout;
+	};
+
+	/**
+	 *	@brief	A merged barrier
+	 */
+	struct barrier_batch {
+		pipeline_stage src_stages{ static_cast<pipeline_stage>(0) };
+		pipeline_stage dst_stages{ static_cast<pipeline_stage>(0) };
+		lib::vector<barrier> barriers;
+
+		bool empty() const { return barriers.empty(); }
+	};
+
+	struct event_signal {
+		std::uint32_t event;
+		pipeline_stage stages;
+	};
+
+	struct compiled_pass {
+		std::uint32_t pass;
+
+		// Pipeline barrier recorded before the pass
+		barrier_batch barrier;
+		// Events waited upon before the pass, and the barrier applied by the wait
+		lib::vector<std::uint32_t> wait_events;
+		barrier_batch wait_barrier;
+		// Events set after the pass
+		lib::vector<event_signal> signals;
+	};
+
+	struct plan {
+		// Live passes, in submission order
+		lib::vector<compiled_pass> passes;
+		std::uint32_t events_count{ 0 };
+	};
+
+private:
+	struct tracked_state {
+		resource_state state;
+		bool known{ false };
+
+		// Index, into the live passes, of the last writer and of the reader since the last write.
+		// invalid_index if the access predates the compiled passes or if there were multiple readers.
+		std::uint32_t writer{ invalid_index };
+		std::uint32_t reader{ invalid_index };
+	};
+
+	struct pending_barrier {
+		barrier b;
+		// Live pass index of the pass that produced the access the barrier waits upon, or invalid_index if unknown
+		std::uint32_t producer;
+	};
+
+private:
+	static lib::vector<std::uint32_t> live_passes(const lib::vector<pass> &passes);
+
+	static void simulate(const lib::vector<pass> &passes,
+						 const lib::vector<std::uint32_t> &live,
+						 lib::vector<tracked_state> &states,
+						 plan *out);
+
+public:
+	/**
+	 *	@brief	Compiles the passes.
+	 *
+	 *	@param	passes	Passes, in submission order
+	 *	@param	states	Resources states. Resources with no state assume cyclic execution of the graph.
+	 *					Updated with the resources states past the graph's execution.
+	 */
+	static plan compile(const lib::vector<pass> &passes,
+						lib::vector<optional<resource_state>> &states);
+};
+
+}
+}
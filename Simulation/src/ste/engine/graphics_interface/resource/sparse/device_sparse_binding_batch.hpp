@@ -41,6 +41,10 @@ protected:
 															   Base::wait_semaphores.end());
 		auto signal_semaphore_handles = Base::vk_semaphores(Base::signal_semaphores);
 
+		lib::vector<const semaphore*> wait_semaphores;
+		for (auto &s : Base::wait_semaphores)
+			wait_semaphores.push_back(&s.sem.get());
+
 		// Creates sparse binding commands
 		lib::vector<VkSparseBufferMemoryBindInfo> buffer_binds;
 		lib::vector<VkSparseImageMemoryBindInfo> image_binds;
@@ -62,7 +66,9 @@ protected:
 							 image_opaque_binds,
 							 wait_semaphore_handles,
 							 signal_semaphore_handles,
-							 &(*fence_strong)->get_fence());
+							 &(*fence_strong)->get_fence(),
+							 Base::timeline_values(wait_semaphores),
+							 Base::timeline_values(Base::signal_semaphores));
 
 		// Signal fence's host-side future
 		(*fence_strong)->signal();
@@ -3,9 +3,31 @@
 
 #include <ste_glfw_handle.hpp>
 
+#include <lib/vector.hpp>
+#include <cstring>
+
 using namespace ste;
 using namespace ste::gl;
 
+namespace {
+
+bool is_instance_extension_supported(const char *name) {
+	std::uint32_t count;
+	if (vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr) != VK_SUCCESS)
+		return false;
+
+	lib::vector<VkExtensionProperties> properties(count);
+	if (vkEnumerateInstanceExtensionProperties(nullptr, &count, properties.data()) != VK_SUCCESS)
+		return false;
+
+	for (auto &p : properties)
+		if (!std::strcmp(p.extensionName, name))
+			return true;
+	return false;
+}
+
+}
+
 vk::vk_instance<> ste_gl_context::create_vk_instance(const char *app_name,
 													 unsigned app_version,
 													 bool debug_context,
@@ -16,6 +38,10 @@ vk::vk_instance<> ste_gl_context::create_vk_instance(const char *app_name,
 	for (unsigned i = 0; i < count; ++i)
 		instance_extensions.push_back(extensions[i]);
 
+	// VK_KHR_get_physical_device_properties2, required by VK_KHR_timeline_semaphore
+	if (is_instance_extension_supported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+		instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
 	// Add debug layers and extensions
 	if (debug_context) {
 		auto instance_validation_layers = vk_instance_validation_layers();
@@ -31,6 +31,9 @@ struct ste_gl_device_creation_parameters {
 
 	bool allow_markers{ false };
 
+	// Capacity of the device's host-to-device upload arena
+	byte_t upload_arena_size{ 64_MB };
+
 	ste_presentation_surface_creation_parameters presentation_surface_parameters;
 };
 
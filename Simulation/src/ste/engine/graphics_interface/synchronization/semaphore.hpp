@@ -19,7 +19,7 @@ namespace ste {
 namespace gl {
 
 class semaphore
-	: public ste_resource_pool_resetable_trait<const vk::vk_logical_device<> &, const char*>,
+	: public ste_resource_pool_resetable_trait<const vk::vk_logical_device<> &, const char*, bool>,
 	  public allow_type_decay<semaphore, vk::vk_semaphore<>> {
 private:
 	using R = void;
@@ -28,14 +28,23 @@ private:
 	vk::vk_semaphore<> sem;
 	boundary<R> b;
 
+	// Value signaled, and waited upon, by the current use of a timeline semaphore
+	std::uint64_t value{ 1 };
+
 public:
 	/**
 	*	@brief	Construct a semaphore object
+	*
+	*	@param	timeline	Creates a timeline semaphore. Each use, i.e. each time the semaphore is claimed from a pool, signals
+	*						and waits upon a new value, so queue submissions can wait on the semaphore before its signal is
+	*						submitted. Must not be used for presentation.
 	*/
 	semaphore(const vk::vk_logical_device<> &device,
-			  const char *name)
+			  const char *name,
+			  bool timeline = false)
 		: sem(device,
-			  name) {}
+			  name,
+			  timeline) {}
 
 	~semaphore() noexcept {}
 
@@ -54,6 +63,8 @@ public:
 	*/
 	void reset() override {
 		b = boundary<R>();
+		if (is_timeline())
+			++value;
 	}
 
 	/**
@@ -80,6 +91,16 @@ public:
 		b.wait();
 	}
 
+	/**
+	*	@brief	Checks if the semaphore is a timeline semaphore
+	*/
+	bool is_timeline() const { return sem.is_timeline(); }
+
+	/**
+	*	@brief	The value the current use of a timeline semaphore signals and waits upon. Ignored for binary semaphores.
+	*/
+	auto timeline_value() const { return value; }
+
 	auto &get() const { return sem; }
 };
 
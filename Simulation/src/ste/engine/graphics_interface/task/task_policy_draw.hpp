@@ -12,6 +12,7 @@
 #include <cmd_draw_indexed.hpp>
 #include <cmd_draw_indirect.hpp>
 #include <cmd_draw_indexed_indirect.hpp>
+#include <cmd_draw_indexed_indirect_count.hpp>
 
 #include <inherit_from_types.hpp>
 
@@ -66,5 +67,20 @@ struct task_policy<cmd_draw_indexed_indirect> : task_policy_draw {
 	}
 };
 
+// Policy for indexed indirect draw with a draw count buffer
+template <>
+struct task_policy<cmd_draw_indexed_indirect_count> : task_policy_draw {
+	using interface_types = std::tuple<task_vertex_buffers_interface, task_index_buffer_interface, task_indirect_indexed_draw_buffer_interface>;
+	using interface = inherit_from_tuple_types<interface_types>;
+
+	template <typename Command, typename... CmdArgs>
+	static auto create_cmd(const interface *task, 
+						   CmdArgs&&... args) {
+		return Command(task->get_indirect_buffer(),
+					   task->get_indirect_offset(),
+					   std::forward<CmdArgs>(args)...);
+	}
+};
+
 }
 }
@@ -8,6 +8,7 @@
 #include <job.hpp>
 
 #include <surface.hpp>
+#include <opaque_surface.hpp>
 #include <surface_type_traits.hpp>
 #include <surface_utilities.hpp>
 
@@ -16,6 +17,7 @@
 #include <device_image_exceptions.hpp>
 
 #include <device_buffer.hpp>
+#include <ste_device_upload_arena.hpp>
 
 #include <pipeline_barrier.hpp>
 #include <image_memory_barrier.hpp>
@@ -27,12 +29,131 @@
 
 #include <cstring>
 #include <limits>
+#include <numeric>
 
 namespace ste {
 namespace gl {
 
 namespace _internal {
 
+/**
+*	@brief	Stages blocks written by a writer and copies them into the image, then transfers the image to the final queue
+*			and layout. Blocks till completion.
+*
+*	@param	regions		Regions to copy, buffer offsets are in blocks
+*	@param	blocks		Count of blocks to stage
+*	@param	writer		Callable, void(block_type *dst). Writes the staged blocks into dst.
+*/
+template <typename block_type, int dimensions, class allocation_policy, typename selector_policy, typename Writer>
+void stage_and_copy_to_image(const device_image<dimensions, allocation_policy> &image,
+							 lib::vector<buffer_image_copy_region_t> &&regions,
+							 std::uint64_t blocks,
+							 Writer &&writer,
+							 image_layout final_layout,
+							 ste_queue_selector<selector_policy> &&final_queue_selector,
+							 lib::vector<wait_semaphore> &&wait_semaphores,
+							 lib::vector<semaphore*> &&signal_semaphores) {
+	const ste_context &ctx = image.parent_context();
+	const auto block_bytes = format_id(image.get_format()).block_bytes;
+
+	// Try to stage in the device's upload arena. Copy offsets must be multiples of the block size and 4 bytes.
+	using staging_buffer_t = device_buffer<block_type, device_resource_allocation_policy_host_visible>;
+	const auto staging_bytes = blocks * static_cast<std::size_t>(block_bytes);
+	auto staging_allocation = ctx.device().upload_arena().allocate(byte_t(staging_bytes),
+																   std::lcm(static_cast<std::uint64_t>(block_bytes), std::uint64_t(4)));
+
+	// Select queue
+	auto queue_type = ste_queue_type::data_transfer_queue;
+	auto queue_selector = ste_queue_selector<ste_queue_selector_policy_flexible>(queue_type);
+	auto &q = ctx.device().select_queue(queue_selector);
+
+	auto semaphore = ctx.device().get_sync_primitives_pools().semaphores().claim();
+
+	// Enqueues mipmap copy on a transfer queue. The batch holds the staging memory till it completes.
+	auto copy_to_image = [&](auto &&batch, const device_buffer_base &src_buffer) {
+		auto copy_to_image_future = q.enqueue([&, semptr = &semaphore.get()]() {
+			// Record and submit a one-time batch
+			auto &command_buffer = batch->acquire_command_buffer();
+			{
+				auto recorder = command_buffer.record();
+
+				// Move to transfer layouts
+				auto barrier = pipeline_barrier(pipeline_stage::top_of_pipe | pipeline_stage::host,
+												pipeline_stage::transfer,
+												image_memory_barrier(image,
+																	 image_layout::undefined,
+																	 image_layout::transfer_dst_optimal,
+																	 access_flags::none,
+																	 access_flags::transfer_write),
+												buffer_memory_barrier(src_buffer,
+																	  access_flags::host_write,
+																	  access_flags::transfer_read));
+				recorder << cmd_pipeline_barrier(barrier);
+
+				// Copy to image
+				recorder << cmd_copy_buffer_to_image(src_buffer,
+													 image,
+													 image_layout::transfer_dst_optimal,
+													 regions);
+			}
+
+			batch->wait_semaphores = std::move(wait_semaphores);
+			batch->signal_semaphores.emplace_back(semptr);
+
+			ste_device_queue::submit_batch(std::move(batch));
+		});
+		copy_to_image_future.get();
+	};
+
+	if (staging_allocation) {
+		writer(reinterpret_cast<block_type*>(staging_allocation->data()));
+
+		// Arena buffer is addressed in bytes
+		for (auto &r : regions)
+			r.buffer_offset = static_cast<std::size_t>(staging_allocation->get_offset()) + r.buffer_offset * static_cast<std::size_t>(block_bytes);
+
+		const auto &arena_buffer = staging_allocation->buffer();
+		copy_to_image(q.allocate_batch<ste_device_upload_arena::allocation_ptr>(std::move(staging_allocation)),
+					  arena_buffer);
+	}
+	else {
+		// Upload arena exhausted, fall back to a dedicated staging buffer
+		staging_buffer_t staging_buffer(ctx,
+										blocks,
+										gl::buffer_usage::transfer_src,
+										"fill_image staging buffer");
+		{
+			auto mmap_blocks_ptr = staging_buffer.get_underlying_memory().template mmap<block_type>(0, blocks);
+			writer(mmap_blocks_ptr->get_mapped_ptr());
+			// Flush written memory
+			mmap_blocks_ptr->flush_ranges({ vk::vk_mapped_memory_range{ 0, blocks } });
+		}
+
+		auto batch = q.allocate_batch<staging_buffer_t>(std::move(staging_buffer));
+		const auto &staging = batch->user_data();
+		copy_to_image(std::move(batch),
+					  staging);
+	}
+
+	// Transfer ownership
+	pipeline_stage pipeline_stages_for_final_layout = all_possible_pipeline_stages_for_access_flags(access_flags_for_image_layout(final_layout));
+	lib::vector<wait_semaphore> queue_transfer_wait_semaphores;
+	queue_transfer_wait_semaphores.emplace_back(std::move(semaphore), pipeline_stage::bottom_of_pipe);
+	auto queue_transfer_future = queue_transfer(ctx,
+												image,
+												q,
+												ctx.device().select_queue(final_queue_selector),
+												image_layout::transfer_dst_optimal,
+												pipeline_stage::transfer,
+												final_layout,
+												pipeline_stages_for_final_layout,
+												std::move(queue_transfer_wait_semaphores),
+												std::move(signal_semaphores));
+
+	// Wait for completion
+	queue_transfer_future.get();
+}
+
 template <int dimensions, class allocation_policy, typename selector_policy, typename Surface>
 auto fill_image_array(const device_image<dimensions, allocation_policy> &image,
 					  Surface &&surface,
@@ -64,8 +185,6 @@ auto fill_image_array(const device_image<dimensions, allocation_policy> &image,
 
 	auto future = image.parent_context().engine().task_scheduler().schedule_now(
 		[=, &image, surface = std::move(surface), final_queue_selector = std::move(final_queue_selector), wait_semaphores = std::move(wait_semaphores), signal_semaphores = std::move(signal_semaphores)]() mutable {
-		const ste_context &ctx = image.parent_context();
-
 		const extent_type image_extent = resource::surface_utilities::extent(image.get_extent(), initial_level);
 		const extent_type surface_extent = surface.extent();
 
@@ -82,25 +201,7 @@ auto fill_image_array(const device_image<dimensions, allocation_policy> &image,
 			throw device_image_format_exception("Surface and image extent mismatch. Surface extent at level 0 must equal to image extent at level initial_level.");
 		}
 
-		const auto block_bytes = resource::surface_utilities::block_bytes<format>();
-
-		// Create staging buffer
-		using staging_buffer_t = device_buffer<block_type, device_resource_allocation_policy_host_visible>;
 		const auto blocks = surface.blocks_layer() * static_cast<std::uint64_t>(layers);
-		staging_buffer_t staging_buffer(ctx,
-										blocks,
-										gl::buffer_usage::transfer_src,
-										"fill_image staging buffer");
-
-		// Copy to destination image
-		{
-			auto mmap_blocks_ptr = staging_buffer.get_underlying_memory().template mmap<block_type>(0, blocks);
-			std::memcpy(mmap_blocks_ptr->get_mapped_ptr(),
-						surface.data(),
-						blocks * static_cast<std::size_t>(block_bytes));
-			// Flush written memory
-			mmap_blocks_ptr->flush_ranges({ vk::vk_mapped_memory_range{ 0, blocks } });
-		}
 
 		// Create regions to copy
 		lib::vector<buffer_image_copy_region_t> regions;
@@ -127,73 +228,51 @@ auto fill_image_array(const device_image<dimensions, allocation_policy> &image,
 			}
 		}
 
-		// Select queue
-		auto queue_type = ste_queue_type::data_transfer_queue;
-		auto queue_selector = ste_queue_selector<ste_queue_selector_policy_flexible>(queue_type);
-		auto &q = ctx.device().select_queue(queue_selector);
-
-		// Create a batch
-		auto batch = q.allocate_batch<staging_buffer_t>(std::move(staging_buffer));
-		auto semaphore = ctx.device().get_sync_primitives_pools().semaphores().claim();
-
-		// Enqueue mipmap copy on a transfer queue
-		auto copy_to_image_future = q.enqueue([&, semptr = &semaphore.get()]() {
-			// Record and submit a one-time batch
-			auto &command_buffer = batch->acquire_command_buffer();
-
-			const auto &dst_buffer = batch->user_data();
-			{
-				auto recorder = command_buffer.record();
-
-				// Move to transfer layouts
-				auto barrier = pipeline_barrier(pipeline_stage::top_of_pipe | pipeline_stage::host,
-												pipeline_stage::transfer,
-												image_memory_barrier(image,
-																	 image_layout::undefined,
-																	 image_layout::transfer_dst_optimal,
-																	 access_flags::none,
-																	 access_flags::transfer_write),
-												buffer_memory_barrier(dst_buffer,
-																	  access_flags::host_write,
-																	  access_flags::transfer_read));
-				recorder << cmd_pipeline_barrier(barrier);
-
-				// Copy to image
-				recorder << cmd_copy_buffer_to_image(dst_buffer,
-													 image,
-													 image_layout::transfer_dst_optimal,
-													 regions);
-			}
-
-			batch->wait_semaphores = std::move(wait_semaphores);
-			batch->signal_semaphores.emplace_back(semptr);
-
-			ste_device_queue::submit_batch(std::move(batch));
-		});
-		copy_to_image_future.get();
-
-		// Transfer ownership
-		pipeline_stage pipeline_stages_for_final_layout = all_possible_pipeline_stages_for_access_flags(access_flags_for_image_layout(final_layout));
-		lib::vector<wait_semaphore> queue_transfer_wait_semaphores;
-		queue_transfer_wait_semaphores.emplace_back(std::move(semaphore), pipeline_stage::bottom_of_pipe);
-		auto queue_transfer_future = queue_transfer(ctx,
-													image,
-													q,
-													ctx.device().select_queue(final_queue_selector),
-													image_layout::transfer_dst_optimal,
-													pipeline_stage::transfer,
-													final_layout,
-													pipeline_stages_for_final_layout,
-													std::move(queue_transfer_wait_semaphores),
-													std::move(signal_semaphores));
-
-		// Wait for completion
-		queue_transfer_future.get();
+		// Stage the surface and copy
+		stage_and_copy_to_image<block_type>(image,
+											std::move(regions),
+											blocks,
+											[&](block_type *dst) {
+												std::memcpy(dst, surface.data(), blocks * static_cast<std::size_t>(resource::surface_utilities::block_bytes<format>()));
+											},
+											final_layout,
+											std::move(final_queue_selector),
+											std::move(wait_semaphores),
+											std::move(signal_semaphores));
 	});
 
 	return make_job(std::move(future));
 }
 
+// Block of an opaque surface, sized at compile time to allow staging opaque surfaces
+template <std::size_t bytes>
+struct opaque_block {
+	std::uint8_t data[bytes];
+};
+
+template <std::size_t block_bytes, int dimensions, class allocation_policy, typename selector_policy>
+void stage_and_copy_opaque_to_image(const device_image<dimensions, allocation_policy> &image,
+									const resource::opaque_surface<dimensions> &surface,
+									lib::vector<buffer_image_copy_region_t> &&regions,
+									image_layout final_layout,
+									ste_queue_selector<selector_policy> &&final_queue_selector,
+									lib::vector<wait_semaphore> &&wait_semaphores,
+									lib::vector<semaphore*> &&signal_semaphores) {
+	using block_type = opaque_block<block_bytes>;
+
+	const auto blocks = surface.blocks_layer() * static_cast<std::uint64_t>(surface.layers());
+	stage_and_copy_to_image<block_type>(image,
+										std::move(regions),
+										blocks,
+										[&](block_type *dst) {
+											std::memcpy(dst, surface.data(), static_cast<std::size_t>(surface.bytes()));
+										},
+										final_layout,
+										std::move(final_queue_selector),
+										std::move(wait_semaphores),
+										std::move(signal_semaphores));
+}
+
 }
 
 /**
@@ -450,5 +529,139 @@ auto fill_image(const device_image<dimensions, allocation_policy> &image,
 										 std::move(signal_semaphores));
 }
 
+/**
+*	@brief	Copies image from an opaque surface into target image. All of the surface's layers and levels are copied. 
+*			Unlike typed surfaces, opaque surfaces can hold block-compressed formats.
+*
+*	@param	image				Target image
+*	@param	surface				Opaque surface to fill from
+*	@param	final_layout		Desired image layout. After job completion image will be in that layout.
+*	@param	final_queue_selector		After job completion image will be transfered to this queue
+*	@param	wait_semaphores		Array of pairs of semaphores upon which to wait before execution
+*	@param	signal_semaphores	Sempahores to signal once the command has completed execution
+*/
+template <class allocation_policy, typename selector_policy, int dimensions>
+auto fill_image(const device_image<dimensions, allocation_policy> &image,
+				resource::opaque_surface<dimensions> &&surface,
+				image_layout final_layout,
+				ste_queue_selector<selector_policy> &&final_queue_selector,
+				lib::vector<wait_semaphore> &&wait_semaphores = {},
+				lib::vector<semaphore*> &&signal_semaphores = {}) {
+	// Validate format and size
+	if (image.get_format() != surface.surface_format()) {
+		throw device_image_format_exception("Surface and image format mismatch");
+	}
+	if (surface.extent() != image.get_extent() || 
+		surface.levels() > image.get_mips() || 
+		surface.layers() > image.get_layers()) {
+		throw device_image_format_exception("Surface and image extent, levels or layers mismatch");
+	}
+
+	auto future = image.parent_context().engine().task_scheduler().schedule_now(
+		[=, &image, surface = std::move(surface), final_queue_selector = std::move(final_queue_selector), wait_semaphores = std::move(wait_semaphores), signal_semaphores = std::move(signal_semaphores)]() mutable {
+		// Create regions to copy
+		lib::vector<buffer_image_copy_region_t> regions;
+		regions.reserve(static_cast<std::size_t>(surface.layers()) * static_cast<std::size_t>(surface.levels()));
+		for (auto l = 0_layer; l < surface.layers(); ++l) {
+			for (auto m = 0_mip; m < surface.levels(); ++m) {
+				auto extent = surface.extent(m);
+
+				buffer_image_copy_region_t copy_region;
+				copy_region.buffer_offset = surface.offset_blocks(l, m);
+				copy_region.image_format = surface.surface_format();
+				copy_region.mip = m;
+				copy_region.base_layer = l;
+				copy_region.layers = 1_layer;
+				if constexpr (dimensions > 0) copy_region.extent.x = static_cast<std::uint32_t>(extent[0]);
+				if constexpr (dimensions > 1) copy_region.extent.y = static_cast<std::uint32_t>(extent[1]);
+				if constexpr (dimensions > 2) copy_region.extent.z = static_cast<std::uint32_t>(extent[2]);
+
+				regions.push_back(copy_region);
+			}
+		}
+
+		// Stage the surface and copy, staging blocks are sized by the format's block size
+		auto stage = [&](auto block_bytes) {
+			_internal::stage_and_copy_opaque_to_image<decltype(block_bytes)::value>(image,
+																				  surface,
+																				  std::move(regions),
+																				  final_layout,
+																				  std::move(final_queue_selector),
+																				  std::move(wait_semaphores),
+																				  std::move(signal_semaphores));
+		};
+		switch (static_cast<std::size_t>(surface.block_bytes())) {
+		case 1:		stage(std::integral_constant<std::size_t, 1>()); break;
+		case 2:		stage(std::integral_constant<std::size_t, 2>()); break;
+		case 3:		stage(std::integral_constant<std::size_t, 3>()); break;
+		case 4:		stage(std::integral_constant<std::size_t, 4>()); break;
+		case 6:		stage(std::integral_constant<std::size_t, 6>()); break;
+		case 8:		stage(std::integral_constant<std::size_t, 8>()); break;
+		case 12:	stage(std::integral_constant<std::size_t, 12>()); break;
+		case 16:	stage(std::integral_constant<std::size_t, 16>()); break;
+		case 24:	stage(std::integral_constant<std::size_t, 24>()); break;
+		case 32:	stage(std::integral_constant<std::size_t, 32>()); break;
+		default:
+			throw device_image_format_exception("Unsupported surface block size");
+		}
+	});
+
+	return make_job(std::move(future));
+}
+
+/**
+*	@brief	Fills the top level of a 2d image with blocks written directly into the staging memory by a writer, avoiding
+*			an intermediate surface. The writer is invoked on the task scheduler.
+*
+*	@param	image				Target image
+*	@param	writer				Callable, void(block_type *dst). Writes the level's blocks into dst, tightly packed in row-major order.
+*	@param	final_layout		Desired image layout. After job completion image will be in that layout.
+*	@param	final_queue_selector		After job completion image will be transfered to this queue
+*	@param	wait_semaphores		Array of pairs of semaphores upon which to wait before execution
+*	@param	signal_semaphores	Sempahores to signal once the command has completed execution
+*/
+template <gl::format format, class allocation_policy, typename selector_policy, typename Writer>
+auto fill_image_from_writer(const device_image<2, allocation_policy> &image,
+							Writer &&writer,
+							image_layout final_layout,
+							ste_queue_selector<selector_policy> &&final_queue_selector,
+							lib::vector<wait_semaphore> &&wait_semaphores = {},
+							lib::vector<semaphore*> &&signal_semaphores = {}) {
+	using block_type = typename gl::format_traits<format>::block_type;
+
+	static_assert(gl::format_traits<format>::block_extent.x == 1 && gl::format_traits<format>::block_extent.y == 1);
+
+	// Validate formats
+	if (image.get_format() != format) {
+		throw device_image_format_exception("Writer and image format mismatch");
+	}
+
+	auto future = image.parent_context().engine().task_scheduler().schedule_now(
+		[=, &image, writer = std::forward<Writer>(writer), final_queue_selector = std::move(final_queue_selector), wait_semaphores = std::move(wait_semaphores), signal_semaphores = std::move(signal_semaphores)]() mutable {
+		const auto extent = image.get_extent();
+		const auto blocks = static_cast<std::uint64_t>(extent.x) * static_cast<std::uint64_t>(extent.y);
+
+		buffer_image_copy_region_t copy_region;
+		copy_region.buffer_offset = 0;
+		copy_region.image_format = format;
+		copy_region.mip = 0_mip;
+		copy_region.base_layer = 0_layer;
+		copy_region.layers = 1_layer;
+		copy_region.extent.x = extent.x;
+		copy_region.extent.y = extent.y;
+
+		stage_and_copy_to_image<block_type>(image,
+											{ copy_region },
+											blocks,
+											writer,
+											final_layout,
+											std::move(final_queue_selector),
+											std::move(wait_semaphores),
+											std::move(signal_semaphores));
+	});
+
+	return make_job(std::move(future));
+}
+
 }
 }
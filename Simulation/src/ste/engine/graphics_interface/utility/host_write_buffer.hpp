@@ -6,6 +6,7 @@
 #include <stdafx.hpp>
 #include <ste_context.hpp>
 #include <ste_queue_type.hpp>
+#include <ste_device_upload_arena.hpp>
 
 #include <buffer_usage.hpp>
 #include <device_buffer.hpp>
@@ -26,6 +27,31 @@ namespace gl {
 
 namespace _internal {
 
+/**
+ *	@brief	Records a copy from an upload arena allocation into a buffer
+ */
+template <typename Container>
+void record_upload_arena_copy(command_recorder &recorder,
+							  const ste_device_upload_arena::allocation &src,
+							  Container &dst,
+							  std::size_t dst_offset) {
+	const auto &arena_buffer = src.buffer();
+
+	recorder << cmd_pipeline_barrier(pipeline_barrier(pipeline_stage::host,
+													  pipeline_stage::transfer,
+													  buffer_memory_barrier(arena_buffer,
+																			access_flags::host_write,
+																			access_flags::transfer_read,
+																			static_cast<std::uint64_t>(src.get_size()),
+																			src.get_offset())));
+
+	// Copy to live buffer
+	buffer_copy_region_t range = { static_cast<std::size_t>(src.get_offset()), dst_offset, src.get_size() };
+	recorder << cmd_copy_buffer(arena_buffer,
+								dst,
+								{ range });
+}
+
 template <typename Container>
 void host_write_buffer(const ste_context &ctx,
 					   Container &gl_container,
@@ -46,7 +72,34 @@ void host_write_buffer(const ste_context &ctx,
 	auto queue_type = ste_queue_type::data_transfer_queue;
 	auto queue_selector = ste_queue_selector<ste_queue_selector_policy_flexible>(queue_type);
 
-	// Staging buffer
+	// Try to stage in the device's upload arena
+	auto staging_allocation = ctx.device().upload_arena().allocate(copy_count * byte_t(sizeof(T)));
+	if (staging_allocation) {
+		std::memcpy(staging_allocation->data(), data, static_cast<std::size_t>(copy_count * sizeof(T)));
+
+		// Enqueue on a transfer queue
+		auto f = ctx.device().enqueue(queue_selector, [&, staging = std::move(staging_allocation)]() mutable {
+			// Create a batch, holding the allocation till the batch completes
+			auto batch = ste_device_queue::thread_allocate_batch<ste_device_upload_arena::allocation_ptr>(std::move(staging));
+			auto& command_buffer = batch->acquire_command_buffer();
+
+			// Record and submit a one-time batch
+			{
+				auto recorder = command_buffer.record();
+				record_upload_arena_copy(recorder,
+										 *batch->user_data(),
+										 gl_container,
+										 offset);
+			}
+			ste_device_queue::submit_batch(std::move(batch));
+		});
+
+		// Wait for submission
+		f.get();
+		return;
+	}
+
+	// Upload arena exhausted, fall back to a dedicated staging buffer
 	staging_buffer_t staging_buffer(ctx,
 									copy_count,
 									buffer_usage::transfer_src,
@@ -110,7 +163,40 @@ void host_write_buffer_and_resize(const ste_context &ctx,
 	const auto queue_type = ste_queue_type::data_transfer_sparse_queue;
 	const auto queue_selector = ste_queue_selector<ste_queue_selector_policy_flexible>(queue_type);
 
-	// Staging buffer
+	// Try to stage in the device's upload arena
+	auto staging_allocation = ctx.device().upload_arena().allocate(copy_count * byte_t(sizeof(T)));
+	if (staging_allocation) {
+		std::memcpy(staging_allocation->data(), data, static_cast<std::size_t>(copy_count * sizeof(T)));
+
+		// Enqueue on a transfer queue
+		auto f = ctx.device().enqueue(queue_selector, [=, &gl_container, staging = std::move(staging_allocation)]() mutable {
+			// Create a batch, holding the allocation till the batch completes
+			auto batch = ste_device_queue::thread_allocate_batch<ste_device_upload_arena::allocation_ptr>(std::move(staging));
+			auto& command_buffer = batch->acquire_command_buffer();
+
+			// Record and submit a one-time batch
+			{
+				auto recorder = command_buffer.record();
+
+				// Resize sparse buffer, if needed
+				if (gl_container.size() < copy_count + offset)
+					recorder << gl_container.resize_cmd(copy_count + offset);
+
+				record_upload_arena_copy(recorder,
+										 *batch->user_data(),
+										 gl_container,
+										 offset);
+			}
+
+			ste_device_queue::submit_batch(std::move(batch));
+		});
+
+		// Wait for submission
+		f.get();
+		return;
+	}
+
+	// Upload arena exhausted, fall back to a dedicated staging buffer
 	staging_buffer_t staging_buffer(ctx,
 									copy_count,
 									buffer_usage::transfer_src,
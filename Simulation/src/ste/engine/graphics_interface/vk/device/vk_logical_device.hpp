@@ -12,6 +12,7 @@
 #include <vk_extensions_proc_addr.hpp>
 
 #include <lib/vector.hpp>
+#include <algorithm>
 #include <allow_type_decay.hpp>
 #include <optional.hpp>
 #include <anchored.hpp>
@@ -53,6 +54,14 @@ public:
 		device_info.pQueueCreateInfos = &requested_queues[0];
 		device_info.pEnabledFeatures = &requested_features;
 
+		// The timelineSemaphore feature is required to be supported by devices exposing VK_KHR_timeline_semaphore
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features = {};
+		timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timeline_semaphore_features.pNext = nullptr;
+		timeline_semaphore_features.timelineSemaphore = VK_TRUE;
+		if (std::find(device_extensions.begin(), device_extensions.end(), VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) != device_extensions.end())
+			device_info.pNext = &timeline_semaphore_features;
+
 		VkDevice device;
 		const vk_result res = vkCreateDevice(physical_device, &device_info, &host_allocator::allocation_callbacks(), &device);
 		if (!res) {
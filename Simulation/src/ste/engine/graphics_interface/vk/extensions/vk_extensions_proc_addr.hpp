@@ -37,6 +37,19 @@ struct vk_khr_bind_memory2 {
 	PFN_vkBindImageMemory2KHR vkBindImageMemory2KHR;
 };
 
+struct vk_khr_timeline_semaphore {
+	bool enabled{ false };
+	PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR;
+	PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR;
+	PFN_vkSignalSemaphoreKHR vkSignalSemaphoreKHR;
+};
+
+struct vk_khr_draw_indirect_count {
+	bool enabled{ false };
+	PFN_vkCmdDrawIndirectCountKHR vkCmdDrawIndirectCountKHR;
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR;
+};
+
 }
 
 class vk_extensions_proc_addr {
@@ -44,6 +57,8 @@ private:
 	_internal::vk_ext_debug_marker ext_debug_marker;
 	_internal::vk_khr_get_memory_requirements2 khr_get_memory_requirements2;
 	_internal::vk_khr_bind_memory2 khr_bind_memory2;
+	_internal::vk_khr_timeline_semaphore khr_timeline_semaphore;
+	_internal::vk_khr_draw_indirect_count khr_draw_indirect_count;
 
 public:
 	vk_extensions_proc_addr() = default;
@@ -76,11 +91,30 @@ public:
 			khr_bind_memory2.vkBindBufferMemory2KHR = reinterpret_cast<PFN_vkBindBufferMemory2KHR>(vkGetDeviceProcAddr(device, "vkBindBufferMemory2KHR"));
 			khr_bind_memory2.vkBindImageMemory2KHR = reinterpret_cast<PFN_vkBindImageMemory2KHR>(vkGetDeviceProcAddr(device, "vkBindImageMemory2KHR"));
 		}
+
+		// VK_KHR_timeline_semaphore
+		khr_timeline_semaphore.enabled = std::find(device_extensions.begin(), device_extensions.end(), VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) != device_extensions.end();
+
+		if (khr_timeline_semaphore.enabled) {
+			khr_timeline_semaphore.vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+			khr_timeline_semaphore.vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+			khr_timeline_semaphore.vkSignalSemaphoreKHR = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(vkGetDeviceProcAddr(device, "vkSignalSemaphoreKHR"));
+		}
+
+		// VK_KHR_draw_indirect_count
+		khr_draw_indirect_count.enabled = std::find(device_extensions.begin(), device_extensions.end(), VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) != device_extensions.end();
+
+		if (khr_draw_indirect_count.enabled) {
+			khr_draw_indirect_count.vkCmdDrawIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndirectCountKHR"));
+			khr_draw_indirect_count.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
 	}
 
 	auto& debug_marker() const { return ext_debug_marker; }
 	auto& get_memory_requirements2() const { return khr_get_memory_requirements2; }
 	auto& get_bind_memory2() const { return khr_bind_memory2; }
+	auto& timeline_semaphore() const { return khr_timeline_semaphore; }
+	auto& draw_indirect_count() const { return khr_draw_indirect_count; }
 };
 
 }
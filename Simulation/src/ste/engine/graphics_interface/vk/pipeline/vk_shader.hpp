@@ -48,13 +48,26 @@ public:
 public:
 	vk_shader(const vk_logical_device<host_allocator> &device, 
 			  const lib::string &code,
+			  const char *name)
+		: vk_shader(device,
+					reinterpret_cast<const std::uint32_t*>(code.data()),
+					code.length(),
+					name)
+	{}
+	/**
+	*	@param	code		SPIR-v code, 4-byte aligned
+	*	@param	code_size	Code size in bytes
+	*/
+	vk_shader(const vk_logical_device<host_allocator> &device, 
+			  const std::uint32_t *code,
+			  std::size_t code_size,
 			  const char *name) : device(device) {
 		VkShaderModuleCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		create_info.pNext = nullptr;
 		create_info.flags = 0;
-		create_info.codeSize = code.length();
-		create_info.pCode = reinterpret_cast<const std::uint32_t*>(code.data());
+		create_info.codeSize = code_size;
+		create_info.pCode = code;
 
 		VkShaderModule shader_module;
 		const vk_result res = vkCreateShaderModule(device, &create_info, &host_allocator::allocation_callbacks(), &shader_module);
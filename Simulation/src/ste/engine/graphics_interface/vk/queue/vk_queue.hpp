@@ -34,6 +34,20 @@ private:
 	optional<VkQueue> queue;
 	ste_queue_family queue_family;
 
+private:
+	static auto timeline_semaphore_submit_info(const lib::vector<std::uint64_t> &wait_semaphores_values,
+											   const lib::vector<std::uint64_t> &signal_semaphores_values) {
+		VkTimelineSemaphoreSubmitInfoKHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		info.pNext = nullptr;
+		info.waitSemaphoreValueCount = static_cast<std::uint32_t>(wait_semaphores_values.size());
+		info.pWaitSemaphoreValues = wait_semaphores_values.data();
+		info.signalSemaphoreValueCount = static_cast<std::uint32_t>(signal_semaphores_values.size());
+		info.pSignalSemaphoreValues = signal_semaphores_values.data();
+
+		return info;
+	}
+
 public:
 	vk_queue(const vk_logical_device<host_allocator> &device,
 			 const ste_queue_family &queue_family,
@@ -82,6 +96,32 @@ public:
 				const lib::vector<wait_semaphore_t> &wait_semaphores,
 				const lib::vector<VkSemaphore> &signal_semaphores,
 				const vk_fence<host_allocator> *fence = nullptr) const {
+		submit(command_buffers,
+			   wait_semaphores, {},
+			   signal_semaphores, {},
+			   fence);
+	}
+
+	/**
+	*	@brief	Submits one or more command buffers for execution on the queue, waiting upon and signaling timeline semaphores.
+	*
+	*	@param	command_buffers			Command buffers to submit
+	*	@param	wait_semaphores			Array of pairs of semaphores upon which to wait before execution, and corresponsing pipeline
+	*									stages at which the wait occurs
+	*	@param	wait_semaphores_values	Timeline values to wait upon, per wait semaphore. Ignored for binary semaphores.
+	*	@param	signal_semaphores		Sempahores to signal once the commands have completed execution
+	*	@param	signal_semaphores_values	Timeline values to signal, per signal semaphore. Ignored for binary semaphores.
+	*	@param	fence					Optional fence, to be signaled when the commands have completed execution
+	*
+	*	The values arrays must either be empty, if none of the semaphores is a timeline semaphore, or match the semaphores
+	*	arrays in size.
+	*/
+	void submit(const lib::vector<vk_command_buffer> &command_buffers,
+				const lib::vector<wait_semaphore_t> &wait_semaphores,
+				const lib::vector<std::uint64_t> &wait_semaphores_values,
+				const lib::vector<VkSemaphore> &signal_semaphores,
+				const lib::vector<std::uint64_t> &signal_semaphores_values,
+				const vk_fence<host_allocator> *fence = nullptr) const {
 		lib::vector<VkCommandBuffer> cb;
 		lib::vector<VkSemaphore> wait;
 		lib::vector<VkPipelineStageFlags> stages;
@@ -102,9 +142,12 @@ public:
 		for (std::size_t i = 0; i < signal_semaphores.size(); ++i)
 			signal[i] = signal_semaphores[i];
 
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = timeline_semaphore_submit_info(wait_semaphores_values,
+																						signal_semaphores_values);
+
 		VkSubmitInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		info.pNext = nullptr;
+		info.pNext = wait_semaphores_values.size() || signal_semaphores_values.size() ? &timeline_info : nullptr;
 		info.waitSemaphoreCount = static_cast<std::uint32_t>(wait.size());
 		info.pWaitSemaphores = wait.data();
 		info.pWaitDstStageMask = stages.data();
@@ -142,13 +185,17 @@ public:
 	*	@param	wait_semaphores		Array of pairs of semaphores upon which to wait before execution
 	*	@param	signal_semaphores	Sempahores to signal once the command has completed execution
 	*	@param	fence				Optional fence, to be signaled when the command has completed execution
+	*	@param	wait_semaphores_values		Optional timeline values to wait upon, per wait semaphore. Ignored for binary semaphores.
+	*	@param	signal_semaphores_values	Optional timeline values to signal, per signal semaphore. Ignored for binary semaphores.
 	*/
 	void submit_bind_sparse(const lib::vector<VkSparseBufferMemoryBindInfo> &buffer_binds,
 							const lib::vector<VkSparseImageMemoryBindInfo> &image_binds,
 							const lib::vector<VkSparseImageOpaqueMemoryBindInfo> &image_opaque_binds,
 							const lib::vector<VkSemaphore> &wait_semaphores,
 							const lib::vector<VkSemaphore> &signal_semaphores,
-							const vk_fence<host_allocator> *fence = nullptr) const {
+							const vk_fence<host_allocator> *fence = nullptr,
+							const lib::vector<std::uint64_t> &wait_semaphores_values = {},
+							const lib::vector<std::uint64_t> &signal_semaphores_values = {}) const {
 		lib::vector<VkSemaphore> wait;
 		lib::vector<VkSemaphore> signal;
 
@@ -164,9 +211,12 @@ public:
 				signal.push_back(e);
 		}
 
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = timeline_semaphore_submit_info(wait_semaphores_values,
+																						signal_semaphores_values);
+
 		VkBindSparseInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
-		info.pNext = nullptr;
+		info.pNext = wait_semaphores_values.size() || signal_semaphores_values.size() ? &timeline_info : nullptr;
 		info.waitSemaphoreCount = static_cast<std::uint32_t>(wait.size());
 		info.pWaitSemaphores = wait.data();
 		info.bufferBindCount = static_cast<std::uint32_t>(buffer_binds.size());
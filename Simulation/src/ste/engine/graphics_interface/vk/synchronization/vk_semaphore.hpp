@@ -26,13 +26,26 @@ class vk_semaphore : public ste_resource_pool_const_trait<const vk_logical_devic
 private:
 	optional<VkSemaphore> semaphore;
 	alias<const vk_logical_device<host_allocator>> device;
+	bool timeline;
 
 public:
+	/**
+	 *	@brief	Creates a semaphore
+	 *
+	 *	@param	timeline	If true, creates a timeline semaphore with an initial value of 0. Requires VK_KHR_timeline_semaphore.
+	 */
 	vk_semaphore(const vk_logical_device<host_allocator> &device,
-				 const char *name) : device(device) {
+				 const char *name,
+				 bool timeline = false) : device(device), timeline(timeline) {
+		VkSemaphoreTypeCreateInfoKHR type_create_info = {};
+		type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		type_create_info.pNext = nullptr;
+		type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		type_create_info.initialValue = 0;
+
 		VkSemaphoreCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		create_info.pNext = nullptr;
+		create_info.pNext = timeline ? &type_create_info : nullptr;
 		create_info.flags = 0;
 
 		VkSemaphore semaphore;
@@ -59,6 +72,7 @@ public:
 
 		semaphore = std::move(o.semaphore);
 		device = std::move(o.device);
+		timeline = o.timeline;
 
 		return *this;
 	}
@@ -74,6 +88,7 @@ public:
 
 	auto& get_creating_device() const { return device.get(); }
 	auto& get() const { return semaphore.get(); }
+	bool is_timeline() const { return timeline; }
 };
 
 }
@@ -4,4 +4,4 @@
 
 using namespace ste;
 
-thread_local bool balanced_thread_pool::balanced_thread_pool_worker_thread_flag = false;
+thread_local balanced_thread_pool::worker_thread_data_t balanced_thread_pool::worker_thread_data;
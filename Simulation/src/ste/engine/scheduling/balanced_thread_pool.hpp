@@ -8,6 +8,7 @@
 #include <thread_pool_task.hpp>
 
 #include <lib/concurrent_queue.hpp>
+#include <lib/work_stealing_deque.hpp>
 #include <interruptible_thread.hpp>
 
 #include <thread_constants.hpp>
@@ -20,9 +21,11 @@
 #include <mutex>
 #include <future>
 #include <condition_variable>
+#include <functional>
 
 #include <lib/vector.hpp>
 #include <lib/shared_ptr.hpp>
+#include <lib/unique_ptr.hpp>
 #include <bitset>
 #include <atomic>
 #include <chrono>
@@ -33,26 +36,61 @@ class balanced_thread_pool {
 public:
 	using task_t = lib::shared_ptr<functor<>>;
 	using task_queue_t = lib::concurrent_queue<task_t>;
+	using task_deque_t = lib::work_stealing_deque<task_t>;
+
+	static_assert(std::is_same_v<task_queue_t::stored_ptr, task_deque_t::stored_ptr>, "Queue and deque stored pointer types mismatch");
 
 private:
-	struct shared_data_t {
+	/*
+	 *	@brief	Per-worker state. Only the owning worker pushes to and pops from its deque, idle workers steal from it.
+	 *			An idle worker parks on its own condition variable, so that an enqueue wakes a single worker.
+	 */
+	struct worker_slot_t {
+		task_deque_t deque;
+
 		alignas(std::hardware_destructive_interference_size) std::condition_variable notifier;
 		std::mutex m;
 
+		std::atomic<bool> parked{ false };
+		// Set while a worker thread, possibly an interrupted one that has yet to exit, owns the slot
+		std::atomic<bool> occupied{ false };
+	};
+
+	struct worker_t {
+		worker_slot_t *slot;
+		interruptible_thread thread;
+	};
+
+	struct worker_thread_data_t {
+		const balanced_thread_pool *pool{ nullptr };
+		worker_slot_t *slot{ nullptr };
+		std::uint32_t rand_state{ 0 };
+	};
+
+	struct shared_data_t {
 		std::atomic<std::uint32_t> requests_pending{ 0 };
 		std::atomic<std::uint32_t> active_workers{ 0 };
+		std::atomic<std::uint32_t> parked_workers{ 0 };
+
+		// One past the highest slot ever occupied, bounds the victim scans
+		std::atomic<std::uint32_t> slots_high_water{ 0 };
+		std::atomic<std::uint32_t> wake_cursor{ 0 };
 	};
 
 private:
-	static thread_local bool balanced_thread_pool_worker_thread_flag;
+	static thread_local worker_thread_data_t worker_thread_data;
 
 public:
-	static bool is_thread_pool_worker_thread() { return balanced_thread_pool_worker_thread_flag; }
+	static bool is_thread_pool_worker_thread() { return worker_thread_data.pool != nullptr; }
 
 private:
 	shared_data_t shared_data;
-	lib::vector<interruptible_thread> workers;
 
+	// Slots are allocated once, and never moved, as they are concurrently accessed by thieves and enqueuers.
+	lib::vector<lib::unique_ptr<worker_slot_t>> slots;
+	lib::vector<worker_t> workers;
+
+	// Tasks enqueued from non-worker threads
 	task_queue_t task_queue;
 
 	system_times sys_times;
@@ -63,23 +101,116 @@ private:
 	float idle_time_threshold_for_despawn_surplus_worker;
 
 private:
+	static std::uint32_t next_random() {
+		// xorshift32
+		auto &x = worker_thread_data.rand_state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return x;
+	}
+
+	worker_slot_t* acquire_free_slot() {
+		for (std::uint32_t i = 0; i < slots.size(); ++i) {
+			bool expected = false;
+			if (slots[i]->occupied.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+				auto hw = shared_data.slots_high_water.load(std::memory_order_relaxed);
+				while (hw < i + 1 && !shared_data.slots_high_water.compare_exchange_weak(hw, i + 1)) {}
+
+				return slots[i].get();
+			}
+		}
+
+		return nullptr;
+	}
+
+	task_queue_t::stored_ptr steal_task(const worker_slot_t *thief) {
+		const auto count = shared_data.slots_high_water.load(std::memory_order_acquire);
+		if (!count)
+			return nullptr;
+
+		// Randomize the first victim to spread contention
+		const auto start = next_random() % count;
+		for (std::uint32_t i = 0; i < count; ++i) {
+			auto *victim = slots[(start + i) % count].get();
+			if (victim == thief)
+				continue;
+
+			auto task = victim->deque.steal();
+			if (task != nullptr)
+				return task;
+		}
+
+		return nullptr;
+	}
+
+	task_queue_t::stored_ptr acquire_task(worker_slot_t *slot) {
+		// Own deque first, then the shared queue, and only then try to steal.
+		auto task = slot->deque.pop();
+		if (task == nullptr)
+			task = task_queue.pop();
+		if (task == nullptr)
+			task = steal_task(slot);
+
+		return task;
+	}
+
+	bool try_unpark(worker_slot_t *slot) {
+		if (!slot->parked.load(std::memory_order_relaxed) || !slot->parked.exchange(false))
+			return false;
+
+		shared_data.parked_workers.fetch_add(-1);
+		wake(slot);
+
+		return true;
+	}
+
+	static void wake(worker_slot_t *slot) {
+		// Acquiring the mutex guarantees the worker is either waiting, or yet to check its predicate
+		{
+			std::unique_lock<std::mutex> l(slot->m);
+		}
+		slot->notifier.notify_one();
+	}
+
+	void park(worker_slot_t *slot) {
+		slot->parked.store(true);
+		shared_data.parked_workers.fetch_add(1);
+
+		// Recheck after announcing that we are parked, an enqueuer might have missed us.
+		if (shared_data.requests_pending.load() == 0 && !interruptible_thread::is_interruption_flag_set()) {
+			std::unique_lock<std::mutex> l(slot->m);
+			slot->notifier.wait(l,
+								[&]() {
+									return !slot->parked.load() ||
+										interruptible_thread::is_interruption_flag_set();
+								});
+		}
+
+		if (slot->parked.exchange(false))
+			shared_data.parked_workers.fetch_add(-1);
+	}
+
 	void spawn_worker(int schedule_on_cpu = -1) {
-		workers.emplace_back([this]() {
-			// Set balanced thread pool worker flag for this thread
-			balanced_thread_pool::balanced_thread_pool_worker_thread_flag = true;
+		auto *slot = acquire_free_slot();
+		if (slot == nullptr)
+			return;
+
+		workers.push_back({ slot, interruptible_thread([this, slot]() {
+			// Set balanced thread pool worker data for this thread
+			balanced_thread_pool::worker_thread_data.pool = this;
+			balanced_thread_pool::worker_thread_data.slot = slot;
+			balanced_thread_pool::worker_thread_data.rand_state = static_cast<std::uint32_t>(std::hash<worker_slot_t*>()(slot)) | 1;
 
 			for (;;) {
-				if (interruptible_thread::is_interruption_flag_set()) return;
+				if (interruptible_thread::is_interruption_flag_set())
+					break;
 
-				task_queue_t::stored_ptr task;
-				{
+				auto task = acquire_task(slot);
+				if (task == nullptr) {
 					// Wait for tasks
-					std::unique_lock<std::mutex> l(shared_data.m);
-					shared_data.notifier.wait(l,
-											   [&]() {
-												   return interruptible_thread::is_interruption_flag_set() ||
-													   (task = task_queue.pop()) != nullptr;
-											   });
+					park(slot);
+					continue;
 				}
 
 				shared_data.active_workers.fetch_add(1);
@@ -89,14 +220,21 @@ private:
 					run_task(std::move(*task));
 					if (interruptible_thread::is_interruption_flag_set())
 						break;
-					task = task_queue.pop();
+					task = acquire_task(slot);
 				}
 
 				shared_data.active_workers.fetch_add(-1);
 			}
-		});
 
-		const auto t = &workers.back().get_thread();
+			// Hand over locally queued tasks and release the slot
+			for (auto task = slot->deque.pop(); task != nullptr; task = slot->deque.pop()) {
+				task_queue.push(std::move(task));
+				wake_one_parked_worker();
+			}
+			slot->occupied.store(false, std::memory_order_release);
+		}) });
+
+		const auto t = &workers.back().thread.get_thread();
 
 		thread_set_priority_low(t);
 		if (schedule_on_cpu >= 0) {
@@ -114,16 +252,36 @@ private:
 		auto ref = std::move(workers.back());
 		workers.pop_back();
 
-		ref.interrupt();
-		std::move(ref).detach();
+		ref.thread.interrupt();
+		wake(ref.slot);
+		std::move(ref.thread).detach();
+	}
+
+	void wake_one_parked_worker() {
+		if (shared_data.parked_workers.load() == 0)
+			return;
+
+		const auto count = shared_data.slots_high_water.load(std::memory_order_acquire);
+		const auto start = shared_data.wake_cursor.fetch_add(1, std::memory_order_relaxed);
+		for (std::uint32_t i = 0; i < count; ++i) {
+			if (try_unpark(slots[(start + i) % count].get()))
+				return;
+		}
 	}
 
 	void notify_workers_on_enqueue() {
-		const int pending = shared_data.requests_pending.fetch_add(1);
-		if (pending == 0)
-			shared_data.notifier.notify_one();
+		shared_data.requests_pending.fetch_add(1);
+		wake_one_parked_worker();
+	}
+
+	void push_task(task_t &&task) {
+		// Tasks enqueued by this pool's workers go to the local deque, to be stolen by idle workers.
+		if (worker_thread_data.pool == this)
+			worker_thread_data.slot->deque.push(std::move(task));
 		else
-			shared_data.notifier.notify_all();
+			task_queue.push(std::move(task));
+
+		notify_workers_on_enqueue();
 	}
 
 	void run_task(task_t &&task) {
@@ -141,13 +299,10 @@ private:
 		return std::max<unsigned>(std::thread::hardware_concurrency() * 4, 1u);
 	}
 
-	void notify_and_join_thread(interruptible_thread &w) {
-		w.interrupt();
-		do {
-			shared_data.notifier.notify_all();
-		} while (!shared_data.m.try_lock());
-		shared_data.m.unlock();
-		w.join();
+	void notify_and_join_thread(worker_t &w) {
+		w.thread.interrupt();
+		wake(w.slot);
+		w.thread.join();
 	}
 
 public:
@@ -155,6 +310,11 @@ public:
 		: idle_time_threshold_for_new_worker(idle_time_threshold_for_new_worker),
 		  kernel_time_thershold_for_despawn_extra_worker(kernel_time_thershold_for_despawn_extra_worker),
 		  idle_time_threshold_for_despawn_surplus_worker(idle_time_threshold_for_despawn_surplus_worker) {
+		const auto max_slots = max_worker_threads();
+		slots.reserve(max_slots);
+		for (unsigned i = 0; i < max_slots; ++i)
+			slots.push_back(lib::allocate_unique<worker_slot_t>());
+
 		const int threads = min_worker_threads();
 		const int max_threads = std::thread::hardware_concurrency();
 		for (int i = 0; i < threads; ++i)
@@ -164,9 +324,9 @@ public:
 	~balanced_thread_pool() {
 		// Interrupt all workers
 		for (auto &w : workers)
-			w.interrupt();
+			w.thread.interrupt();
 
-		// Keep notifying until all threads are interrupted
+		// Wake and join
 		for (auto &w : workers)
 			notify_and_join_thread(w);
 	}
@@ -183,10 +343,7 @@ public:
 	std::future<R> enqueue(const lib::shared_ptr<thread_pool_task<R>> &f) {
 		auto future = f->get_future();
 
-		auto copy = f;
-		task_queue.push(copy);
-
-		notify_workers_on_enqueue();
+		push_task(task_t(f));
 
 		return future;
 	}
@@ -197,13 +354,18 @@ public:
 	template <typename R>
 	std::future<R> enqueue(lib::shared_ptr<thread_pool_task<R>> &&f) {
 		auto future = f->get_future();
-		task_queue.push(std::move(f));
-
-		notify_workers_on_enqueue();
+		push_task(task_t(std::move(f)));
 
 		return future;
 	}
 
+	/*
+	 *	@brief	Enqueues a task, whose future, if any, was already retrieved
+	 */
+	void enqueue(task_t &&task) {
+		push_task(std::move(task));
+	}
+
 	auto get_workers_count() const { return workers.size(); }
 	auto get_pending_requests_count() const { return shared_data.requests_pending.load(std::memory_order_acquire); }
 	auto get_active_workers_count() const { return shared_data.active_workers.load(std::memory_order_acquire); }
@@ -217,7 +379,7 @@ public:
 	*	@brief	Checks if all requests have finished processing
 	*/
 	bool is_idle() const {
-		return get_pending_requests_count() == 0 && task_queue.is_empty_hint();
+		return get_pending_requests_count() == 0;
 	}
 
 	/*
@@ -241,7 +403,7 @@ public:
 
 		// Check for dead workers (e.g. exception thrown)
 		for (auto it = workers.begin(); it != workers.end();) {
-			if (it->is_terminated())
+			if (it->thread.is_terminated())
 				it = workers.erase(it);
 			else
 				++it;
@@ -9,9 +9,11 @@
 #include <function_traits.hpp>
 #include <thread_constants.hpp>
 #include <future_collection.hpp>
+#include <task_dependents.hpp>
 
 #include <alias.hpp>
 #include <lib/shared_ptr.hpp>
+#include <lib/vector.hpp>
 #include <future>
 #include <mutex>
 #include <shared_mutex>
@@ -22,9 +24,15 @@ namespace ste {
 
 class task_scheduler;
 
+namespace _detail {
+struct task_future_access;
+}
+
 /**
  *	@brief	Thread-safe wrapper around std::future. Used by ste::task_scheduler.
- *			For thread safety task_future employs finely-grained read-write locks
+ *			For thread safety task_future employs finely-grained read-write locks.
+ *			Futures created by ste::task_scheduler can be continued, via then() or when_all(), without any thread waiting on
+ *			them: The continuation is enqueued by the task that completes last.
  *
  *	@param R			Future return type
  *	@param is_shared	Indicates whether or not this is a shared_future
@@ -32,6 +40,7 @@ class task_scheduler;
 template <typename R, bool is_shared>
 class task_future_impl {
 	friend class task_scheduler;
+	friend struct _detail::task_future_access;
 	template <typename, bool>
 	friend class task_future_impl;
 
@@ -58,6 +67,7 @@ private:
 
 	alias<task_scheduler> sched;
 	lib::shared_ptr<functor<>> task;
+	lib::shared_ptr<task_dependents> dependents;
 	future_type future;
 
 private:
@@ -106,17 +116,24 @@ private:
 	}
 
 private:
-	task_future_impl(typename task_future_impl<R, false>::future_type &&f, alias<task_scheduler> sched, lib::shared_ptr<functor<>> &&task) : sched(sched), task(std::move(task)), future(std::move(f)) {}
-	task_future_impl(typename task_future_impl<R, true >::future_type &&f, alias<task_scheduler> sched, lib::shared_ptr<functor<>> &&task) : sched(sched), task(std::move(task)), future(std::move(f)) {}
+	task_future_impl(typename task_future_impl<R, false>::future_type &&f, 
+					 alias<task_scheduler> sched, 
+					 lib::shared_ptr<functor<>> &&task, 
+					 lib::shared_ptr<task_dependents> &&dependents) : sched(sched), task(std::move(task)), dependents(std::move(dependents)), future(std::move(f)) {}
+	task_future_impl(typename task_future_impl<R, true >::future_type &&f, 
+					 alias<task_scheduler> sched, 
+					 lib::shared_ptr<functor<>> &&task, 
+					 lib::shared_ptr<task_dependents> &&dependents) : sched(sched), task(std::move(task)), dependents(std::move(dependents)), future(std::move(f)) {}
 
 	task_future_impl(future_lock_guard<write_lock_type> &&l,
-					 task_future_impl &&other) : sched(other.sched), task(std::move(other.task)), future(std::move(other.future)) {}
+					 task_future_impl &&other) : sched(other.sched), task(std::move(other.task)), dependents(std::move(other.dependents)), future(std::move(other.future)) {}
 
 	template <bool b = is_shared>
 	task_future_impl(const typename task_future_impl<R, true>::future_type &f,
 					 alias<task_scheduler> sched,
 					 const lib::shared_ptr<functor<>> &task,
-					 std::enable_if_t<b>* = nullptr) : sched(sched), task(task), future(f) {}
+					 const lib::shared_ptr<task_dependents> &dependents,
+					 std::enable_if_t<b>* = nullptr) : sched(sched), task(task), dependents(dependents), future(f) {}
 
 	template <bool b = is_shared>
 	task_future_impl(future_lock_guard<read_lock_type> &&l,
@@ -124,6 +141,7 @@ private:
 					 std::enable_if_t<b>* = nullptr)
 		: sched(other.sched),
 		task(other.task),
+		dependents(other.dependents),
 		future(other.future) 
 	{}
 
@@ -149,10 +167,10 @@ public:
 	*
 	*	@param other	Future to copy. Must be a shared_future.
 	*/
-	template <bool b = is_shared>
-	task_future_impl(const task_future_impl &other,
-					 std::enable_if_t<b>* = nullptr) : task_future_impl(future_lock_guard<read_lock_type>(other.mutex),
-																		other) {}
+	task_future_impl(const task_future_impl &other) : task_future_impl(future_lock_guard<read_lock_type>(other.mutex),
+																	   other) {
+		static_assert(is_shared, "Only shared futures are copyable");
+	}
 
 	~task_future_impl() noexcept {}
 
@@ -164,13 +182,14 @@ public:
 	*	@param other	Future to move.
 	*/
 	task_future_impl &operator=(task_future_impl &&other) noexcept {
-		write_lock_type l0(mutex);
-		write_lock_type l1(other.mutex);
+		write_lock_type l0(mutex, std::defer_lock);
+		write_lock_type l1(other.mutex, std::defer_lock);
 
 		std::lock(l0, l1);
 
 		sched = other.sched;
 		task = std::move(other.task);
+		dependents = std::move(other.dependents);
 		future = std::move(other.future);
 
 		return *this;
@@ -212,11 +231,14 @@ public:
 
 	/**
 	*	@brief	Schedules a lambda after this future's completion. Moves from this future and creates a new future.
+	*			The lambda is enqueued once this future's task completes, and accepts the future's result, if any.
+	*			If the lambda returns a task_future, the returned future is unwrapped: It becomes ready once the inner
+	*			future is ready.
 	*
 	*	@param	lambda	Lambda expression
 	*/
 	template <typename L>
-	task_future_impl<typename function_traits<L>::result_t, is_shared> then(L &&lambda) &&;
+	auto then(L &&lambda) &&;
 
 	/**
 	*	@brief	Moves this future into a shared future.
@@ -230,6 +252,7 @@ public:
 		write_lock_type l(mutex);
 
 		sched = nullptr;
+		dependents = nullptr;
 		return std::move(future);
 	}
 };
@@ -242,4 +265,26 @@ using task_shared_future = task_future_impl<R, true>;
 template <typename R>
 using task_future_collection = future_collection<R, task_future>;
 
+/**
+*	@brief	Creates a future that becomes ready once all futures are ready. Consumes the futures. 
+*			No thread waits on the futures, the gathering task is enqueued once the last future completes.
+*
+*	@param	sched	Scheduler
+*	@param	futures	Futures to wait on
+*	@return	A future of a vector of the futures' results, in order. For void futures a void future.
+*/
+template <typename R, bool is_shared>
+auto when_all(task_scheduler &sched, lib::vector<task_future_impl<R, is_shared>> &&futures);
+
+/**
+*	@brief	Creates a future that becomes ready once all futures are ready. Consumes the futures. 
+*			No thread waits on the futures, the gathering task is enqueued once the last future completes.
+*
+*	@param	sched	Scheduler
+*	@param	futures	Futures to wait on, must not be void futures
+*	@return	A future of a tuple of the futures' results, in order.
+*/
+template <typename... Rs, bool... is_shared>
+auto when_all(task_scheduler &sched, task_future_impl<Rs, is_shared>&&... futures);
+
 }
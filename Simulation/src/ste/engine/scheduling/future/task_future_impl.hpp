@@ -7,48 +7,186 @@
 #include <task_future.hpp>
 #include <task_scheduler.hpp>
 
+#include <lib/vector.hpp>
+#include <lib/shared_ptr.hpp>
+
 #include <thread>
+#include <tuple>
+#include <exception>
 
 namespace ste {
 
 namespace _detail {
 
-template <typename R, bool is_shared, typename L>
-task_future_impl<typename function_traits<L>::result_t, is_shared> then(task_future_impl<R, is_shared> &&f, task_scheduler *sched, 
-																		L &&lambda,
-															 		 	std::enable_if_t<!std::is_void<R>::value>* = nullptr)  {
-	static_assert(function_traits<L>::arity == 1, "lambda must take 1 argument");
-
-	return sched->schedule_now<is_shared>([func = std::forward<L>(lambda), f = std::move(f), sched = sched]() mutable {
-		R r = f.get();
-		return func(std::move(r));
-	});
-}
+template <typename T>
+struct is_task_future : std::false_type {};
+template <typename R, bool is_shared>
+struct is_task_future<task_future_impl<R, is_shared>> : std::true_type {};
+
+template <typename T>
+static constexpr bool is_task_future_v = is_task_future<T>::value;
+
+struct task_future_access {
+	template <typename R, bool is_shared>
+	static auto dependents(const task_future_impl<R, is_shared> &f) {
+		typename task_future_impl<R, is_shared>::read_lock_type l(f.mutex);
+		return f.dependents;
+	}
+
+	template <typename R, bool is_shared>
+	static task_scheduler* scheduler(task_future_impl<R, is_shared> &f) {
+		typename task_future_impl<R, is_shared>::read_lock_type l(f.mutex);
+		return f.sched ? &f.sched.get() : nullptr;
+	}
+
+	template <bool shared, typename F>
+	static auto schedule_on_completion(task_scheduler *sched,
+									   const lib::vector<lib::shared_ptr<task_dependents>> &deps,
+									   F &&f) {
+		return sched->schedule_on_completion<shared>(deps, std::forward<F>(f));
+	}
 
+	template <typename R>
+	static void enqueue_on_completion(task_scheduler *sched,
+									  const lib::vector<lib::shared_ptr<task_dependents>> &deps,
+									  lib::shared_ptr<thread_pool_task<R>> task) {
+		sched->enqueue_on_completion(deps, std::move(task));
+	}
+
+	template <typename R, bool is_shared>
+	static task_future_impl<R, is_shared> create(std::future<R> &&f,
+												 task_scheduler *sched,
+												 lib::shared_ptr<task_dependents> &&dependents) {
+		return { std::move(f), sched, nullptr, std::move(dependents) };
+	}
+};
+
+/*
+ *	@brief	Gets the (ready) future's result and invokes the continuation with it.
+ */
 template <typename R, bool is_shared, typename L>
-task_future_impl<typename function_traits<L>::result_t, is_shared> then(task_future_impl<R, is_shared> &&f, task_scheduler *sched, 
-																		L &&lambda,
-															 		 	std::enable_if_t<std::is_void<R>::value>* = nullptr)  {
-	static_assert(function_traits<L>::arity == 0, "lambda can not take any arguments");
+decltype(auto) invoke_continuation(task_future_impl<R, is_shared> &f, L &func) {
+	if constexpr (std::is_void_v<R>) {
+		static_assert(function_traits<L>::arity == 0, "lambda can not take any arguments");
 
-	return sched->schedule_now<is_shared>([func = std::forward<L>(lambda), f = std::move(f), sched = sched]() mutable {
 		f.get();
 		return func();
-	});
+	}
+	else {
+		static_assert(function_traits<L>::arity == 1, "lambda must take 1 argument");
+
+		return func(f.get());
+	}
+}
+
+template <typename R, bool is_shared, typename L>
+auto then(task_future_impl<R, is_shared> &&f, L &&lambda) {
+	using T = typename function_traits<L>::result_t;
+
+	auto sched = task_future_access::scheduler(f);
+	assert(sched && "Future is not associated with a scheduler");
+
+	const lib::vector<lib::shared_ptr<task_dependents>> deps = { task_future_access::dependents(f) };
+
+	if constexpr (!is_task_future_v<T>) {
+		return task_future_access::schedule_on_completion<is_shared>(sched,
+																	 deps,
+																	 [func = std::forward<L>(lambda), f = std::move(f)]() mutable -> T {
+			return invoke_continuation(f, func);
+		});
+	}
+	else {
+		// Continuation returns a future: Unwrap it.
+		// A forwarding task is created now, and enqueued only once the future returned by the continuation completes.
+		using U = std::decay_t<decltype(std::declval<T>().get())>;
+		struct unwrap_state {
+			T inner;
+			std::exception_ptr exception;
+		};
+
+		auto state = lib::allocate_shared<unwrap_state>();
+		auto forward = lib::allocate_shared<thread_pool_task<U>>([state]() -> U {
+			if (state->exception)
+				std::rethrow_exception(state->exception);
+			return state->inner.get();
+		});
+		auto forward_future = forward->get_future();
+		auto forward_dependents = forward->get_dependents();
+
+		task_future_access::schedule_on_completion<false>(sched,
+														  deps,
+														  [func = std::forward<L>(lambda), f = std::move(f), state, forward, sched]() mutable {
+			lib::shared_ptr<task_dependents> inner_dependents;
+			try {
+				state->inner = invoke_continuation(f, func);
+				inner_dependents = task_future_access::dependents(state->inner);
+			}
+			catch (...) {
+				state->exception = std::current_exception();
+			}
+
+			task_future_access::enqueue_on_completion(sched, { inner_dependents }, std::move(forward));
+		});
+
+		return task_future_access::create<U, is_shared>(std::move(forward_future), sched, std::move(forward_dependents));
+	}
 }
 
 }
 
 template <typename R, bool is_shared>
 template <typename L>
-task_future_impl<typename function_traits<L>::result_t, is_shared> task_future_impl<R, is_shared>::then(L &&lambda) && {
-	return _detail::then<R, is_shared>(std::move(*this), this->sched, std::forward<L>(lambda));
+auto task_future_impl<R, is_shared>::then(L &&lambda) && {
+	return _detail::then<R, is_shared>(std::move(*this), std::forward<L>(lambda));
 }
 
 template <typename R, bool is_shared>
 task_future_impl<R, true> task_future_impl<R, is_shared>::shared() && {
-	return sched->schedule_now<true>([f = std::move(*this), sched = this->sched]() mutable -> R {
-		return f.get();
+	write_lock_type l(mutex);
+
+	if constexpr (is_shared)
+		return task_future_impl<R, true>(std::move(future), sched, std::move(task), std::move(dependents));
+	else
+		return task_future_impl<R, true>(future.share(), sched, std::move(task), std::move(dependents));
+}
+
+template <typename R, bool is_shared>
+auto when_all(task_scheduler &sched, lib::vector<task_future_impl<R, is_shared>> &&futures) {
+	lib::vector<lib::shared_ptr<task_dependents>> deps;
+	deps.reserve(futures.size());
+	for (auto &f : futures)
+		deps.push_back(_detail::task_future_access::dependents(f));
+
+	return _detail::task_future_access::schedule_on_completion<false>(&sched,
+																	  deps,
+																	  [futures = std::move(futures)]() mutable {
+		if constexpr (std::is_void_v<R>) {
+			for (auto &f : futures)
+				f.get();
+		}
+		else {
+			lib::vector<std::decay_t<R>> results;
+			results.reserve(futures.size());
+			for (auto &f : futures)
+				results.push_back(f.get());
+
+			return results;
+		}
+	});
+}
+
+template <typename... Rs, bool... is_shared>
+auto when_all(task_scheduler &sched, task_future_impl<Rs, is_shared>&&... futures) {
+	static_assert((!std::is_void_v<Rs> && ...), "void futures can not be joined into a tuple");
+
+	const lib::vector<lib::shared_ptr<task_dependents>> deps = { _detail::task_future_access::dependents(futures)... };
+
+	return _detail::task_future_access::schedule_on_completion<false>(&sched,
+																	  deps,
+																	  [fs = std::make_tuple(std::move(futures)...)]() mutable {
+		return std::apply([](auto&... f) {
+			return std::make_tuple(f.get()...);
+		}, fs);
 	});
 }
 
@@ -0,0 +1,72 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <function_wrapper.hpp>
+
+#include <lib/vector.hpp>
+#include <mutex>
+
+namespace ste {
+
+/**
+ *	@brief	Thread-safe list of continuations of a task, invoked once the task has completed.
+ *			Continuations attached before completion are invoked by the thread that completes the task, continuations
+ *			attached afterwards are invoked immediately by the attaching thread.
+ */
+class task_dependents {
+private:
+	using continuation_t = unique_function_wrapper<>;
+
+private:
+	mutable std::mutex m;
+	bool signaled{ false };
+	lib::vector<continuation_t> continuations;
+
+public:
+	task_dependents() = default;
+	task_dependents(task_dependents&&) = delete;
+	task_dependents &operator=(task_dependents&&) = delete;
+
+	/**
+	*	@brief	Attaches a continuation. Invokes the continuation immediately if already signaled.
+	*/
+	template <typename F>
+	void attach(F f) {
+		{
+			std::unique_lock<std::mutex> l(m);
+			if (!signaled) {
+				continuations.emplace_back(std::move(f));
+				return;
+			}
+		}
+
+		f();
+	}
+
+	/**
+	*	@brief	Signals completion and invokes all attached continuations.
+	*/
+	void signal() {
+		lib::vector<continuation_t> v;
+		{
+			std::unique_lock<std::mutex> l(m);
+			assert(!signaled);
+
+			signaled = true;
+			v = std::move(continuations);
+		}
+
+		for (auto &c : v)
+			c();
+	}
+
+	bool is_signaled() const {
+		std::unique_lock<std::mutex> l(m);
+		return signaled;
+	}
+};
+
+}
@@ -3,23 +3,91 @@
 #include <task_scheduler.hpp>
 #include <task_future.hpp>
 
+#include <limits>
+
 using namespace ste;
 
-void task_scheduler::enqueue_delayed() {
-	const auto now = std::chrono::high_resolution_clock::now();
-	for (auto it = delayed_tasks_list.begin(); it != delayed_tasks_list.end();) {
-		if (now >= it->run_at) {
-			schedule_now([f = std::move(it->f)](){ (*f)(); });
-			it = delayed_tasks_list.erase(it);
+task_scheduler::task_scheduler()
+	: timer_epoch(timer_clock_t::now()),
+	  timer_wakeup_tick(std::numeric_limits<timer_wheel_t::tick_t>::max()),
+	  timer_thread([this]() { timer_thread_main(); })
+{}
+
+task_scheduler::~task_scheduler() noexcept {
+	timer_thread.interrupt();
+	{
+		std::unique_lock<std::mutex> l(timer_mutex);
+	}
+	timer_notifier.notify_one();
+	timer_thread.join();
+}
+
+task_scheduler::timer_wheel_t::tick_t task_scheduler::time_point_to_tick(const timer_clock_t::time_point &tp,
+																				  bool round_up) const {
+	if (tp <= timer_epoch)
+		return 0;
+
+	const auto d = tp - timer_epoch;
+	auto ticks = std::chrono::duration_cast<timer_tick_duration_t>(d);
+	// Round deadlines up, a task should never fire early.
+	if (round_up && ticks < d)
+		++ticks;
+
+	return static_cast<timer_wheel_t::tick_t>(ticks.count());
+}
+
+void task_scheduler::push_delayed(const timer_clock_t::time_point &at, pool_t::task_t &&task) {
+	const auto tick = time_point_to_tick(at, true);
+	delayed_tasks_queue.push({ at, std::move(task) });
+
+	// Wake the timer thread only if it sleeps past the new deadline
+	if (tick < timer_wakeup_tick.load()) {
+		{
+			std::unique_lock<std::mutex> l(timer_mutex);
 		}
-		else
-			++it;
+		timer_notifier.notify_one();
 	}
+}
+
+void task_scheduler::timer_thread_main() {
+	for (;;) {
+		if (interruptible_thread::is_interruption_flag_set())
+			return;
+
+		const auto now_tick = time_point_to_tick(timer_clock_t::now(), false);
+
+		// Move newly delayed tasks into the wheel, overdue tasks are enqueued immediately
+		for (auto task = delayed_tasks_queue.pop(); task != nullptr; task = delayed_tasks_queue.pop()) {
+			const auto tick = time_point_to_tick(task->run_at, true);
+			if (tick <= now_tick)
+				pool.enqueue(std::move(task->f));
+			else
+				delayed_tasks_wheel.insert(tick, std::move(task->f));
+		}
 
-	for (auto task = delayed_tasks_queue.pop(); task != nullptr; task = delayed_tasks_queue.pop()) {
-		if (now >= task->run_at)
-			schedule_now([f = std::move(task->f)](){ (*f)(); });
-		else
-			delayed_tasks_list.push_front(std::move(*task));
+		// Expire
+		delayed_tasks_wheel.advance(now_tick, [this](pool_t::task_t &&f) {
+			pool.enqueue(std::move(f));
+		});
+
+		// Sleep until the next wheel event, or until a task is delayed
+		const auto next_tick = delayed_tasks_wheel.next_event_tick();
+
+		std::unique_lock<std::mutex> l(timer_mutex);
+		const auto wake_predicate = [this]() {
+			return !delayed_tasks_queue.is_empty_hint(std::memory_order_seq_cst) ||
+				interruptible_thread::is_interruption_flag_set();
+		};
+
+		if (next_tick) {
+			timer_wakeup_tick.store(next_tick.get());
+			timer_notifier.wait_until(l, 
+									  timer_epoch + timer_tick_duration_t(next_tick.get()),
+									  wake_predicate);
+		}
+		else {
+			timer_wakeup_tick.store(std::numeric_limits<timer_wheel_t::tick_t>::max());
+			timer_notifier.wait(l, wake_predicate);
+		}
 	}
 }
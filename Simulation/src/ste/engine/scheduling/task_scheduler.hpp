@@ -5,17 +5,23 @@
 
 #include <chrono>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include <type_traits>
 
 #include <task_future.hpp>
 #include <thread_pool_task.hpp>
+#include <task_dependents.hpp>
 
 #include <balanced_thread_pool.hpp>
+#include <timer_wheel.hpp>
+#include <interruptible_thread.hpp>
 #include <lib/concurrent_queue.hpp>
 #include <function_traits.hpp>
 
-#include <lib/list.hpp>
+#include <lib/vector.hpp>
 #include <lib/unique_ptr.hpp>
 #include <lib/shared_ptr.hpp>
 #include <anchored.hpp>
@@ -25,26 +31,89 @@ namespace ste {
 /**
  *	@brief	Thread-safe concurrent, wait-free task scheduler. 
  * 			Uses a load balancing thread pool. Returns task_futures that natively interruct with task_scheduler.
+ *
+ *			Delayed tasks are kept in a timing wheel, owned by a dedicated timer thread that sleeps until the earliest
+ *			deadline and enqueues expired tasks directly into the pool. Delayed tasks therefore fire on time regardless
+ *			of tick().
  */
 class task_scheduler : anchored {
+	friend struct _detail::task_future_access;
+
 private:
 	using pool_t = balanced_thread_pool;
+	using timer_clock_t = std::chrono::high_resolution_clock;
+	// Timer resolution
+	using timer_tick_duration_t = std::chrono::milliseconds;
 
 	struct delayed_task {
-		std::chrono::high_resolution_clock::time_point run_at;
-		lib::unique_ptr<functor<>> f;
+		timer_clock_t::time_point run_at;
+		pool_t::task_t f;
 	};
+	using timer_wheel_t = timer_wheel<pool_t::task_t>;
 
 private:
 	pool_t pool;
 
+	// Delayed tasks are pushed into the queue by the scheduling threads, and moved into the wheel by the timer thread.
 	lib::concurrent_queue<delayed_task> delayed_tasks_queue;
-	lib::list<delayed_task> delayed_tasks_list;
+	timer_wheel_t delayed_tasks_wheel;
+	const timer_clock_t::time_point timer_epoch;
+
+	std::mutex timer_mutex;
+	std::condition_variable timer_notifier;
+	// Tick the timer thread sleeps until, or max when sleeping indefinitely.
+	alignas(std::hardware_destructive_interference_size) std::atomic<timer_wheel_t::tick_t> timer_wakeup_tick;
+
+	interruptible_thread timer_thread;
+
+	timer_wheel_t::tick_t time_point_to_tick(const timer_clock_t::time_point &tp, bool round_up) const;
+	void push_delayed(const timer_clock_t::time_point &at, pool_t::task_t &&task);
+	void timer_thread_main();
+
+	/**
+	*	@brief	Enqueues a task once all dependencies have signaled. The task is enqueued by the thread that signals the last
+	*			dependency, no thread waits on the dependencies. Null dependencies are ignored.
+	*/
+	template <typename R>
+	void enqueue_on_completion(const lib::vector<lib::shared_ptr<task_dependents>> &deps,
+							   lib::shared_ptr<thread_pool_task<R>> task) {
+		auto counter = lib::allocate_shared<std::atomic<std::size_t>>(deps.size() + 1);
+		auto release = [this, counter, task = std::move(task)]() {
+			if (counter->fetch_add(-1) == 1)
+				pool.enqueue(balanced_thread_pool::task_t(task));
+		};
+
+		for (auto &d : deps) {
+			if (d != nullptr)
+				d->attach(release);
+			else
+				release();
+		}
+		release();
+	}
+
+	/**
+	*	@brief	Schedule task for execution once all dependencies have signaled.
+	*/
+	template <bool shared, typename F>
+	task_future_impl<typename function_traits<F>::result_t, shared> schedule_on_completion(const lib::vector<lib::shared_ptr<task_dependents>> &deps,
+																						   F &&f) {
+		using R = typename function_traits<F>::result_t;
+
+		auto task = lib::allocate_shared<thread_pool_task<R>>(std::forward<F>(f));
+		auto future = task->get_future();
+		auto dependents = task->get_dependents();
 
-	void enqueue_delayed();
+		enqueue_on_completion(deps, std::move(task));
+
+		// The future does not hold the task: Executing it in place, before its dependencies complete, would block.
+		return { std::move(future), this, nullptr, std::move(dependents) };
+	}
 
 public:
-	task_scheduler() = default;
+	task_scheduler();
+	~task_scheduler() noexcept;
+
 	task_scheduler(const task_scheduler &) = delete;
 	task_scheduler &operator=(const task_scheduler &) = delete;
 	task_scheduler(task_scheduler &&) = delete;
@@ -70,16 +139,16 @@ public:
 	}
 
 	/**
-	*	@brief	Load balances thread pool and enqueues delayed tasks
+	*	@brief	Load balances thread pool
 	*/
 	void tick() {
 		pool.load_balance();
-		enqueue_delayed();
 	}
 
 	/**
 	*	@brief	Schedule task in background for execution as soon as a worker is free.
-	*			Or, in case called from a worker thread (e.g. by another task), executes the task immediately.
+	*			Or, in case called from a worker thread (e.g. by another task), pushes the task onto that worker's local
+	*			deque, where it is either picked up by the same worker or stolen by an idle one.
 	*
 	*	@param f		Lambda to schedule
 	*	@param shared	If true returns a task_shared_future, otherwise a task_future.
@@ -89,9 +158,10 @@ public:
 		using R = typename function_traits<F>::result_t;
 
 		auto task = lib::allocate_shared<thread_pool_task<R>>(std::forward<F>(f));
+		auto dependents = task->get_dependents();
 		auto future = pool.enqueue(task);
 		
-		return { std::move(future), this, lib::shared_ptr<functor<>>(std::move(task)) };
+		return { std::move(future), this, lib::shared_ptr<functor<>>(std::move(task)), std::move(dependents) };
 	}
 
 	/**
@@ -107,9 +177,10 @@ public:
 		using R = typename function_traits<F>::result_t;
 		auto task = lib::allocate_shared<thread_pool_task<R>>(std::forward<F>(f));
 		auto future = task->get_future();
+		auto dependents = task->get_dependents();
 
-		delayed_tasks_queue.push({ at, std::move(task) });
-		return { std::move(future), this, nullptr };
+		push_delayed(at, std::move(task));
+		return { std::move(future), this, nullptr, std::move(dependents) };
 	}
 
 	/**
@@ -125,9 +196,10 @@ public:
 		using R = typename function_traits<F>::result_t;
 		auto task = lib::allocate_shared<thread_pool_task<R>>(std::forward<F>(f));
 		auto future = task->get_future();
+		auto dependents = task->get_dependents();
 
-		delayed_tasks_queue.push({ std::chrono::high_resolution_clock::now() + after, std::move(task) });
-		return { std::move(future), this, nullptr };
+		push_delayed(timer_clock_t::now() + std::chrono::duration_cast<timer_clock_t::duration>(after), std::move(task));
+		return { std::move(future), this, nullptr, std::move(dependents) };
 	}
 
 	/**
@@ -12,6 +12,9 @@
 #include <type_traits>
 #include <functor.hpp>
 
+#include <task_dependents.hpp>
+#include <lib/shared_ptr.hpp>
+
 namespace ste {
 
 namespace _detail {
@@ -102,6 +105,7 @@ class thread_pool_task : public functor<> {
 private:
 	unique_function_wrapper<> task;
 	std::future<R> future;
+	lib::shared_ptr<task_dependents> dependents;
 
 	std::atomic<std::uint8_t> executed{ 0 };
 
@@ -113,6 +117,7 @@ public:
 
 		std::promise<R> promise;
 		future = promise.get_future();
+		dependents = lib::allocate_shared<task_dependents>();
 
 		task = unique_function_wrapper<>([f = std::forward<F>(f), promise = std::move(promise)]() mutable {
 			try {
@@ -127,6 +132,7 @@ public:
 	~thread_pool_task() noexcept {}
 
 	auto get_future() { return std::move(future); }
+	const auto& get_dependents() const { return dependents; }
 
 	void operator()() override final {
 		// Only the first one here executes the task
@@ -135,6 +141,9 @@ public:
 			return;
 
 		task();
+
+		// Release continuations
+		dependents->signal();
 	}
 };
 
@@ -0,0 +1,189 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <optional.hpp>
+
+#include <lib/vector.hpp>
+#include <array>
+#include <bitset>
+#include <algorithm>
+
+namespace ste {
+
+/**
+ *	@brief	Hierarchical timing wheel.
+ *			Inserts in O(1), and advancing costs O(expired) plus the (amortized constant) cascading of entries from coarser
+ *			levels. Idle ticks are skipped.
+ *
+ *			Not thread-safe.
+ *
+ *	@param T			Payload type
+ *	@param levels		Count of wheel levels
+ *	@param slot_bits	log2 of slot count per level. The wheel spans 2^(levels*slot_bits) ticks, later deadlines are
+ *						clamped and re-cascaded with their real deadline.
+ */
+template <typename T, int levels = 4, int slot_bits = 8>
+class timer_wheel {
+	static_assert(levels > 0 && slot_bits > 0 && levels * slot_bits < 64, "Invalid wheel dimensions");
+
+public:
+	using tick_t = std::uint64_t;
+
+private:
+	static constexpr std::size_t slots_count = static_cast<std::size_t>(1) << slot_bits;
+	static constexpr tick_t slot_mask = static_cast<tick_t>(slots_count - 1);
+
+	struct entry {
+		tick_t deadline;
+		T payload;
+	};
+	using slot_t = lib::vector<entry>;
+
+	struct level_t {
+		std::array<slot_t, slots_count> slots;
+		std::bitset<slots_count> occupied;
+	};
+
+private:
+	std::array<level_t, levels> wheel;
+	// Next tick to be processed
+	tick_t current;
+	std::size_t entries_count{ 0 };
+
+private:
+	static constexpr tick_t level_span(int l) {
+		return static_cast<tick_t>(1) << (slot_bits * (l + 1));
+	}
+	static constexpr std::size_t slot_index(tick_t t, int l) {
+		return static_cast<std::size_t>((t >> (slot_bits * l)) & slot_mask);
+	}
+
+	void insert_entry(entry &&e) {
+		auto deadline = std::max(e.deadline, current);
+		const tick_t delta = deadline - current;
+
+		int l = 0;
+		while (l < levels - 1 && delta >= level_span(l))
+			++l;
+		if (delta >= level_span(levels - 1))
+			deadline = current + level_span(levels - 1) - 1;
+
+		const auto idx = slot_index(deadline, l);
+		wheel[l].slots[idx].push_back(std::move(e));
+		wheel[l].occupied.set(idx);
+	}
+
+	// Redistributes the current slot of level l into finer levels, coarser levels first.
+	void cascade(int l) {
+		const auto idx = slot_index(current, l);
+		if (idx == 0 && l + 1 < levels)
+			cascade(l + 1);
+
+		if (!wheel[l].occupied.test(idx))
+			return;
+
+		slot_t s = std::move(wheel[l].slots[idx]);
+		wheel[l].slots[idx] = slot_t();
+		wheel[l].occupied.reset(idx);
+
+		for (auto &e : s)
+			insert_entry(std::move(e));
+	}
+
+	bool coarse_levels_empty() const {
+		for (int l = 1; l < levels; ++l)
+			if (wheel[l].occupied.any())
+				return false;
+		return true;
+	}
+
+	// First occupied level 0 slot at or after idx, or slots_count if none.
+	std::size_t next_occupied_fine_slot(std::size_t idx) const {
+		for (; idx < slots_count; ++idx)
+			if (wheel[0].occupied.test(idx))
+				return idx;
+		return slots_count;
+	}
+
+public:
+	timer_wheel(tick_t start = 0) : current(start) {}
+
+	timer_wheel(timer_wheel&&) = default;
+	timer_wheel &operator=(timer_wheel&&) = default;
+
+	/**
+	*	@brief	Inserts an entry. Entries with a deadline in the past expire on the next advance.
+	*/
+	void insert(tick_t deadline, T &&payload) {
+		insert_entry({ deadline, std::move(payload) });
+		++entries_count;
+	}
+
+	/**
+	*	@brief	Advances the wheel up to, and including, tick 'to'. Invokes 'expire' with the payload of every entry whose
+	*			deadline has passed.
+	*/
+	template <typename F>
+	void advance(tick_t to, F &&expire) {
+		while (current <= to) {
+			if (entries_count == 0) {
+				current = to + 1;
+				break;
+			}
+
+			const auto idx = slot_index(current, 0);
+			if (idx == 0)
+				cascade(1);
+			else {
+				// Skip to the next occupied slot, or the next cascade boundary, whichever is earlier
+				const auto next = next_occupied_fine_slot(idx);
+				const auto skip_to = std::min(current - idx + next, to + 1);
+				if (skip_to != current) {
+					current = skip_to;
+					continue;
+				}
+			}
+
+			if (wheel[0].occupied.test(idx)) {
+				slot_t s = std::move(wheel[0].slots[idx]);
+				wheel[0].slots[idx] = slot_t();
+				wheel[0].occupied.reset(idx);
+
+				entries_count -= s.size();
+				for (auto &e : s)
+					expire(std::move(e.payload));
+			}
+
+			++current;
+		}
+	}
+
+	/**
+	*	@brief	Returns the next tick at which advancing the wheel might expire entries, or none if the wheel is empty.
+	*			Might be earlier than the earliest deadline, when coarse levels need to be cascaded.
+	*/
+	optional<tick_t> next_event_tick() const {
+		if (entries_count == 0)
+			return none;
+
+		const auto idx = slot_index(current, 0);
+		if (idx == 0 && !coarse_levels_empty())
+			return current;
+
+		const auto next = next_occupied_fine_slot(idx);
+		if (next < slots_count)
+			return current - idx + next;
+
+		// Next revolution
+		return (current | slot_mask) + 1;
+	}
+
+	auto size() const { return entries_count; }
+	bool empty() const { return entries_count == 0; }
+	auto current_tick() const { return current; }
+};
+
+}
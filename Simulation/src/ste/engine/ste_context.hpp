@@ -8,6 +8,7 @@
 #include <ste_device.hpp>
 #include <ste_gl_context.hpp>
 #include <ste_engine.hpp>
+#include <ste_shader_pack.hpp>
 #include <vk_exception.hpp>
 
 #include <anchored.hpp>
@@ -27,6 +28,7 @@ private:
 	const gl_context_t &gl_context;
 	gl_device_t &gl_device;
 	typename context_types::gl_device_memory_allocator engine_device_memory_allocator;
+	gl::ste_shader_pack engine_shader_pack;
 
 public:
 	ste_context_impl(ste_engine_impl<Types> &engine,
@@ -35,7 +37,8 @@ public:
 		: engine_reference(engine),
 		gl_context(gl_ctx),
 		gl_device(device),
-		engine_device_memory_allocator(device)
+		engine_device_memory_allocator(device),
+		engine_shader_pack(engine.storage().shader_module_dir_path() / gl::ste_shader_pack::file_name)
 	{}
 	~ste_context_impl() noexcept {
 		// Finish processing
@@ -70,6 +73,7 @@ public:
 	gl_device_t &device() const { return gl_device; }
 	auto &gl() const { return gl_context; }
 	auto &device_memory_allocator() const { return engine_device_memory_allocator; }
+	auto &shader_pack() const { return engine_shader_pack; }
 };
 
 }
@@ -7,6 +7,7 @@
 
 #include <task_scheduler.hpp>
 #include <lru_cache.hpp>
+#include <lru_cache_pack_storage.hpp>
 #include <ste_engine_storage_protocol.hpp>
 
 #include <ste_gl_device_memory_allocator.hpp>
@@ -17,7 +18,7 @@ namespace ste {
 
 struct ste_engine_types {
 	using task_scheduler_t = task_scheduler;
-	using cache_t = lru_cache<lib::string>;
+	using cache_t = lru_cache<lib::string, lru_cache_pack_storage>;
 
 	using storage_protocol = ste_engine_storage_protocol;
 	using gl_device_memory_allocator = gl::ste_gl_device_memory_allocator;
@@ -30,6 +31,7 @@ public:
 	using storage_protocol = typename engine_types::storage_protocol;
 
 	static constexpr byte_t cache_quota_size_bytes = 256_MB;
+	static constexpr byte_t cache_hot_tier_quota_size_bytes = 32_MB;
 
 private:
 	typename engine_types::task_scheduler_t engine_task_scheduler;
@@ -37,7 +39,7 @@ private:
 
 public:
 	ste_engine_impl()
-		: engine_cache(storage().cache_dir_path(), cache_quota_size_bytes)
+		: engine_cache(storage().cache_dir_path(), cache_quota_size_bytes, cache_hot_tier_quota_size_bytes)
 	{}
 	~ste_engine_impl() noexcept {}
 
@@ -2,6 +2,151 @@
 #include <stdafx.hpp>
 #include <atmospherics_lut_storage.hpp>
 
+#include <log.hpp>
+#include <chrono>
+
+using namespace ste;
 using namespace ste::graphics;
 
 const char *atmospherics_lut_storage::lut_path = R"(Data/atmospherics_lut.bin)";
+
+template <typename OpticalLengthSurface, typename ScatterSurface>
+atmospherics_lut_storage::luts_t atmospherics_lut_storage::make_luts(const ste_context &ctx,
+																	 OpticalLengthSurface &&optical_length,
+																	 ScatterSurface &&scatter,
+																	 ScatterSurface &&mie0_scatter,
+																	 ScatterSurface &&ambient,
+																	 bool fallback) {
+	static constexpr auto optical_length_format = atmospherics_precompute_scattering::optical_length_lut_format;
+	static constexpr auto scatter_format = atmospherics_precompute_scattering::scatter_lut_format;
+
+	const lib::string suffix = fallback ? " (fallback)" : "";
+
+	return luts_t{
+		ste_resource<gl::texture<gl::image_type::image_2d_array>>(ctx,
+																  resource::surface_factory::image_from_surface_2d_array<optical_length_format>(ctx,
+																																				std::move(optical_length),
+																																				gl::image_usage::sampled,
+																																				gl::image_layout::shader_read_only_optimal,
+																																				"atmospherics_optical_length_lut" + suffix,
+																																				false)),
+		ste_resource<gl::texture<gl::image_type::image_3d>>(ctx,
+															resource::surface_factory::image_from_surface_3d<scatter_format>(ctx,
+																															  std::move(scatter),
+																															  gl::image_usage::sampled,
+																															  gl::image_layout::shader_read_only_optimal,
+																															  "atmospherics_scatter_lut" + suffix,
+																															  false)),
+		ste_resource<gl::texture<gl::image_type::image_3d>>(ctx,
+															resource::surface_factory::image_from_surface_3d<scatter_format>(ctx,
+																															  std::move(mie0_scatter),
+																															  gl::image_usage::sampled,
+																															  gl::image_layout::shader_read_only_optimal,
+																															  "atmospherics_mie0_scatter_lut" + suffix,
+																															  false)),
+		ste_resource<gl::texture<gl::image_type::image_3d>>(ctx,
+															resource::surface_factory::image_from_surface_3d<scatter_format>(ctx,
+																															  std::move(ambient),
+																															  gl::image_usage::sampled,
+																															  gl::image_layout::shader_read_only_optimal,
+																															  "atmospherics_ambient_lut" + suffix,
+																															  false)),
+	};
+}
+
+atmospherics_lut_storage::luts_t atmospherics_lut_storage::create_luts(const ste_context &ctx,
+																	   const atmospherics_lut_container &container,
+																	   bool fallback) {
+	using table = atmospherics_lut_container::table;
+	auto &sched = ctx.engine().task_scheduler();
+
+	return make_luts(ctx,
+					 container.decode_optical_length_lut(fallback ? table::optical_length_fallback : table::optical_length, sched),
+					 container.decode_scatter_lut(fallback ? table::scatter_fallback : table::scatter, sched),
+					 container.decode_scatter_lut(fallback ? table::mie0_scatter_fallback : table::mie0_scatter, sched),
+					 container.decode_scatter_lut(fallback ? table::ambient_fallback : table::ambient, sched),
+					 fallback);
+}
+
+atmospherics_lut_storage::luts_t atmospherics_lut_storage::create_luts(const ste_context &ctx,
+																	   const atmospherics_precompute_scattering &source,
+																	   bool fallback) {
+	// Fallback LUTs are point sampled at the container's fallback resolution
+	const std::uint32_t optical_length_step = fallback ? atmospherics_lut_container::optical_length_fallback_factor : 1;
+	const std::uint32_t scatter_step = fallback ? atmospherics_lut_container::scatter_fallback_factor : 1;
+
+	return make_luts(ctx,
+					 source.create_optical_length_lut(optical_length_step),
+					 source.create_scatter_lut(scatter_step),
+					 source.create_mie0_scatter_lut(scatter_step),
+					 source.create_ambient_lut(scatter_step),
+					 fallback);
+}
+
+lib::unique_ptr<atmospherics_precompute_scattering> atmospherics_lut_storage::open_source_lut(const atmospherics_lut_container &container) {
+	if (container.is_valid())
+		return nullptr;
+	return lib::allocate_unique<atmospherics_precompute_scattering>(lut_path);
+}
+
+atmospherics_lut_storage::atmospherics_lut_storage(const ste_context &ctx)
+	: ctx(ctx),
+	container(atmospherics_lut_container::open_existing(lut_path)),
+	source_lut(open_source_lut(container)),
+	fallback_luts(container.is_valid() ?
+				  create_luts(ctx, container, true) :
+				  create_luts(ctx, *source_lut, true))
+{
+	// Stream in the full-resolution LUTs, converting the LUT first if needed
+	luts_future = ctx.engine().task_scheduler().schedule_now([this]() -> lib::unique_ptr<luts_t> {
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		lib::unique_ptr<luts_t> full_luts;
+		try {
+			if (!container.is_valid())
+				container = atmospherics_lut_container::convert(lut_path, *source_lut, this->ctx.get().engine().task_scheduler());
+
+			full_luts = container.is_valid() ?
+				lib::allocate_unique<luts_t>(create_luts(this->ctx.get(), container, false)) :
+				lib::allocate_unique<luts_t>(create_luts(this->ctx.get(), *source_lut, false));
+		}
+		catch (const std::exception &e) {
+			// Keep using the fallback LUTs
+			ste_log_error() << "Couldn't load atmospherics LUTs: " << e.what() << std::endl;
+			return nullptr;
+		}
+
+		// Wait for the upload to complete, so that swapping the LUTs in never stalls
+		full_luts->optical_length.get();
+		full_luts->scatter.get();
+		full_luts->mie0_scatter.get();
+		full_luts->ambient.get();
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+		ste_log() << "Streamed atmospherics LUTs in " << elapsed.count() << "ms" << std::endl;
+
+		return full_luts;
+	});
+}
+
+atmospherics_lut_storage::~atmospherics_lut_storage() noexcept {
+	// The loader references the storage
+	if (luts_future)
+		luts_future.get().wait();
+}
+
+void atmospherics_lut_storage::update() {
+	if (!luts_future ||
+		luts_future.get().wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	luts = luts_future.get().get();
+	luts_future = none;
+
+	// The loader is done with the sources
+	container = atmospherics_lut_container();
+	source_lut = nullptr;
+
+	if (luts)
+		storage_modified_signal.emit();
+}
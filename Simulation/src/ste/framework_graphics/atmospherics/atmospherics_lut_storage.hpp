@@ -6,70 +6,96 @@
 #include <storage.hpp>
 #include <ste_context.hpp>
 #include <ste_resource.hpp>
-#include <atmospherics_precompute_scattering.hpp>
+#include <atmospherics_lut_container.hpp>
 
 #include <texture.hpp>
 #include <surface_factory.hpp>
 
+#include <task_future.hpp>
+#include <signal.hpp>
+#include <alias.hpp>
+#include <optional.hpp>
 #include <lib/unique_ptr.hpp>
 
 namespace ste {
 namespace graphics {
 
+/**
+ *	@brief	Atmospherics LUTs storage.
+ *
+ *	The LUTs are read from an atmospherics_lut_container. Low-resolution fallback LUTs are uploaded on creation, while
+ *	the full-resolution LUTs are decoded and uploaded asynchronously. update() swaps in the full-resolution LUTs once
+ *	they are ready and emits the storage modified signal, consumers should then rebind the LUTs.
+ *
+ *	Without an up-to-date container, the fallback LUTs are sampled from the precomputed scattering LUT, and the LUT is
+ *	converted in the background. If the container can not be written the full-resolution LUTs are created from the LUT.
+ */
 class atmospherics_lut_storage : public gl::storage<atmospherics_lut_storage> {
 	static const char *lut_path;
 
+	struct luts_t {
+		ste_resource<gl::texture<gl::image_type::image_2d_array>> optical_length;
+		ste_resource<gl::texture<gl::image_type::image_3d>> scatter;
+		ste_resource<gl::texture<gl::image_type::image_3d>> mie0_scatter;
+		ste_resource<gl::texture<gl::image_type::image_3d>> ambient;
+	};
+
+private:
+	alias<const ste_context> ctx;
+	atmospherics_lut_container container;
+	// Used until the container is available
+	lib::unique_ptr<atmospherics_precompute_scattering> source_lut;
+
+	// Fallback LUTs are kept alive after the full-resolution LUTs are swapped in, as they might still be in use.
+	luts_t fallback_luts;
+	lib::unique_ptr<luts_t> luts;
+	optional<task_future<lib::unique_ptr<luts_t>>> luts_future;
+
+	mutable signal<> storage_modified_signal;
+
 private:
-	lib::unique_ptr<atmospherics_precompute_scattering> lut_loader;
+	template <typename OpticalLengthSurface, typename ScatterSurface>
+	static luts_t make_luts(const ste_context &ctx,
+							OpticalLengthSurface &&optical_length,
+							ScatterSurface &&scatter,
+							ScatterSurface &&mie0_scatter,
+							ScatterSurface &&ambient,
+							bool fallback);
+	static luts_t create_luts(const ste_context &ctx,
+							  const atmospherics_lut_container &container,
+							  bool fallback);
+	static luts_t create_luts(const ste_context &ctx,
+							  const atmospherics_precompute_scattering &source,
+							  bool fallback);
 
-	ste_resource<gl::texture<gl::image_type::image_2d_array>> atmospherics_optical_length_lut;
-	ste_resource<gl::texture<gl::image_type::image_3d>> atmospherics_scatter_lut;
-	ste_resource<gl::texture<gl::image_type::image_3d>> atmospherics_mie0_scatter_lut;
-	ste_resource<gl::texture<gl::image_type::image_3d>> atmospherics_ambient_lut;
+	static lib::unique_ptr<atmospherics_precompute_scattering> open_source_lut(const atmospherics_lut_container &container);
+
+	const luts_t &active_luts() const { return luts ? *luts : fallback_luts; }
 
 public:
-	atmospherics_lut_storage(const ste_context &ctx)
-		: lut_loader(lib::allocate_unique<atmospherics_precompute_scattering>(lut_path)),
-		atmospherics_optical_length_lut(ctx,
-										resource::surface_factory::image_from_surface_2d_array<gl::format::r32_sfloat>(ctx,
-																													   lut_loader->create_optical_length_lut(),
-																													   gl::image_usage::sampled,
-																													   gl::image_layout::shader_read_only_optimal,
-																													   "atmospherics_optical_length_lut",
-																													   false)),
-		atmospherics_scatter_lut(ctx,
-								 resource::surface_factory::image_from_surface_3d<gl::format::r32g32b32a32_sfloat>(ctx,
-																												   lut_loader->create_scatter_lut(),
-																												   gl::image_usage::sampled,
-																												   gl::image_layout::shader_read_only_optimal,
-																												   "atmospherics_scatter_lut",
-																												   false)),
-		atmospherics_mie0_scatter_lut(ctx,
-									  resource::surface_factory::image_from_surface_3d<gl::format::r32g32b32a32_sfloat>(ctx,
-																														lut_loader->create_mie0_scatter_lut(),
-																														gl::image_usage::sampled,
-																														gl::image_layout::shader_read_only_optimal,
-																														"atmospherics_mie0_scatter_lut",
-																														false)),
-		atmospherics_ambient_lut(ctx,
-								 resource::surface_factory::image_from_surface_3d<gl::format::r32g32b32a32_sfloat>(ctx,
-																												   lut_loader->create_ambient_lut(),
-																												   gl::image_usage::sampled,
-																												   gl::image_layout::shader_read_only_optimal,
-																												   "atmospherics_ambient_lut",
-																												   false))
-	{
-		lut_loader = nullptr;
-	}
+	atmospherics_lut_storage(const ste_context &ctx);
+	~atmospherics_lut_storage() noexcept;
+
+	/**
+	*	@brief	Swaps in the full-resolution LUTs, once loaded. Should be called once per frame, before binding the LUTs.
+	*/
+	void update();
+
+	/**
+	*	@brief	Returns true once the full-resolution LUTs are in use
+	*/
+	bool is_fully_loaded() const { return luts != nullptr; }
 
 	// Use linear_clamp sampler
-	auto& get_atmospherics_optical_length_lut() const { return atmospherics_optical_length_lut.get(); }
+	auto& get_atmospherics_optical_length_lut() const { return active_luts().optical_length.get(); }
 	// Use linear_clamp sampler
-	auto& get_atmospherics_scatter_lut() const { return atmospherics_scatter_lut.get(); }
+	auto& get_atmospherics_scatter_lut() const { return active_luts().scatter.get(); }
 	// Use linear_clamp sampler
-	auto& get_atmospherics_mie0_scatter_lut() const { return atmospherics_mie0_scatter_lut.get(); }
+	auto& get_atmospherics_mie0_scatter_lut() const { return active_luts().mie0_scatter.get(); }
 	// Use linear_clamp sampler
-	auto& get_atmospherics_ambient_lut() const { return atmospherics_ambient_lut.get(); }
+	auto& get_atmospherics_ambient_lut() const { return active_luts().ambient.get(); }
+
+	auto& get_storage_modified_signal() const { return storage_modified_signal; }
 };
 
 }
@@ -0,0 +1,436 @@
+
+#include <stdafx.hpp>
+#include <atmospherics_lut_container.hpp>
+
+#include <log.hpp>
+#include <crc32.h>
+#include <zlib.h>
+
+#include <lib/vector.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+using namespace ste;
+using namespace ste::graphics;
+
+namespace {
+
+using half4 = glm::tvec4<half_float::half>;
+
+static_assert(sizeof(atmospherics_lut_container::container_header) == 16);
+static_assert(sizeof(atmospherics_lut_container::table_descriptor) == 40);
+static_assert(sizeof(atmospherics_lut_container::chunk_entry) == 40);
+
+struct table_source {
+	gl::format format;
+	glm::u32vec3 extent;
+	std::uint32_t layers;
+	const std::uint8_t *data;
+	std::uint64_t bytes;
+};
+
+struct encoded_chunk {
+	atmospherics_lut_container::chunk_compression compression;
+	// Compressed bytes. Empty for uncompressed chunks, which are written straight from the source table.
+	lib::vector<std::uint8_t> data;
+	std::uint32_t crc;
+};
+
+template <typename Surface>
+table_source make_table_source(const Surface &surface) {
+	const auto extent = surface.extent();
+
+	table_source src;
+	src.format = surface.surface_format();
+	if constexpr (Surface::surface_dimensions() == 3)
+		src.extent = extent;
+	else
+		src.extent = { extent.x, extent.y, 1 };
+	src.layers = static_cast<std::uint32_t>(surface.layers());
+	src.data = reinterpret_cast<const std::uint8_t*>(surface.data());
+	src.bytes = static_cast<std::size_t>(surface.bytes());
+
+	return src;
+}
+
+auto downsample_optical_length_lut(const resource::surface_2d_array<atmospherics_precompute_scattering::optical_length_lut_format> &src,
+								   std::uint32_t factor) {
+	const auto src_extent = src.extent();
+	const auto extent = glm::max(src_extent / factor, glm::u32vec2(1));
+	resource::surface_2d_array<atmospherics_precompute_scattering::optical_length_lut_format> dst(extent, src.layers());
+
+	const auto *in = reinterpret_cast<const float*>(src.data());
+	auto *out = reinterpret_cast<float*>(dst.data());
+	for (std::uint32_t l = 0; l < static_cast<std::uint32_t>(src.layers()); ++l) {
+		const auto *layer = in + static_cast<std::size_t>(l) * src_extent.x * src_extent.y;
+		for (std::uint32_t y = 0; y < extent.y; ++y) {
+			for (std::uint32_t x = 0; x < extent.x; ++x) {
+				// Box filter
+				double sum = .0;
+				for (std::uint32_t j = 0; j < factor; ++j)
+					for (std::uint32_t i = 0; i < factor; ++i) {
+						const auto sx = std::min(x * factor + i, src_extent.x - 1);
+						const auto sy = std::min(y * factor + j, src_extent.y - 1);
+						sum += layer[static_cast<std::size_t>(sy) * src_extent.x + sx];
+					}
+
+				*out = static_cast<float>(sum / static_cast<double>(factor * factor));
+				++out;
+			}
+		}
+	}
+
+	return dst;
+}
+
+auto downsample_scatter_lut(const resource::surface_3d<atmospherics_precompute_scattering::scatter_lut_format> &src,
+							std::uint32_t factor) {
+	const auto src_extent = src.extent();
+	const auto extent = glm::max(src_extent / factor, glm::u32vec3(1));
+	resource::surface_3d<atmospherics_precompute_scattering::scatter_lut_format> dst(extent);
+
+	const auto *in = reinterpret_cast<const half4*>(src.data());
+	auto *out = reinterpret_cast<half4*>(dst.data());
+	for (std::uint32_t z = 0; z < extent.z; ++z) {
+		for (std::uint32_t y = 0; y < extent.y; ++y) {
+			for (std::uint32_t x = 0; x < extent.x; ++x) {
+				// Box filter
+				glm::vec4 sum = glm::vec4(.0f);
+				for (std::uint32_t k = 0; k < factor; ++k)
+					for (std::uint32_t j = 0; j < factor; ++j)
+						for (std::uint32_t i = 0; i < factor; ++i) {
+							const auto sx = std::min(x * factor + i, src_extent.x - 1);
+							const auto sy = std::min(y * factor + j, src_extent.y - 1);
+							const auto sz = std::min(z * factor + k, src_extent.z - 1);
+							const auto &v = in[(static_cast<std::size_t>(sz) * src_extent.y + sy) * src_extent.x + sx];
+							sum += glm::vec4{ static_cast<float>(v.x), static_cast<float>(v.y), static_cast<float>(v.z), static_cast<float>(v.w) };
+						}
+
+				sum /= static_cast<float>(factor * factor * factor);
+				*out = { half_float::half(sum.x), half_float::half(sum.y), half_float::half(sum.z), half_float::half(sum.w) };
+				++out;
+			}
+		}
+	}
+
+	return dst;
+}
+
+encoded_chunk encode_chunk(const std::uint8_t *data, std::uint64_t size, bool compress) {
+	encoded_chunk chunk;
+	chunk.compression = atmospherics_lut_container::chunk_compression::none;
+
+	if (compress) {
+		auto bound = compressBound(static_cast<uLong>(size));
+		chunk.data.resize(static_cast<std::size_t>(bound));
+		if (compress2(chunk.data.data(), &bound, data, static_cast<uLong>(size), Z_DEFAULT_COMPRESSION) == Z_OK &&
+			bound < size) {
+			chunk.data.resize(static_cast<std::size_t>(bound));
+			chunk.compression = atmospherics_lut_container::chunk_compression::deflate;
+		}
+		else {
+			// Store incompressible chunks as is
+			chunk.data = {};
+		}
+	}
+
+	chunk.crc = chunk.compression == atmospherics_lut_container::chunk_compression::none ?
+		crc32::crc32_fast(data, static_cast<std::size_t>(size)) :
+		crc32::crc32_fast(chunk.data.data(), chunk.data.size());
+
+	return chunk;
+}
+
+}
+
+atmospherics_lut_container::atmospherics_lut_container(const std::experimental::filesystem::path &path) {
+	std::error_code err;
+	if (!std::experimental::filesystem::exists(path, err))
+		return;
+
+	try {
+		mapped_file file(path, mapped_file::access::read_only);
+		if (!file.is_mapped() || !open(std::move(file)))
+			ste_log_warn() << "Atmospherics LUT container " << path.string() << " is corrupt or incompatible, ignoring." << std::endl;
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't map atmospherics LUT container " << path.string() << ": " << e.what() << std::endl;
+	}
+}
+
+bool atmospherics_lut_container::open(mapped_file &&file) {
+	const auto size = static_cast<std::uint64_t>(file.size());
+	if (size < sizeof(container_header))
+		return false;
+
+	container_header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != magic_value ||
+		header.version != format_version ||
+		header.tables_count != tables_count)
+		return false;
+
+	// Validate index
+	const std::uint64_t tables_offset = sizeof(container_header);
+	const std::uint64_t chunks_offset = tables_offset + tables_count * sizeof(table_descriptor);
+	const std::uint64_t data_offset = chunks_offset + static_cast<std::uint64_t>(header.chunks_count) * sizeof(chunk_entry);
+	if (data_offset > size)
+		return false;
+
+	const auto *container_tables = reinterpret_cast<const table_descriptor*>(file.data() + tables_offset);
+	const auto *container_chunks = reinterpret_cast<const chunk_entry*>(file.data() + chunks_offset);
+	for (std::uint32_t i = 0; i < tables_count; ++i) {
+		const auto &desc = container_tables[i];
+		const auto expected_format = static_cast<table>(i) == table::optical_length || static_cast<table>(i) == table::optical_length_fallback ?
+			atmospherics_precompute_scattering::optical_length_lut_format :
+			atmospherics_precompute_scattering::scatter_lut_format;
+		if (desc.format != expected_format ||
+			desc.first_chunk > header.chunks_count ||
+			header.chunks_count - desc.first_chunk < desc.chunks_count)
+			return false;
+
+		// Chunks must cover the table
+		std::uint64_t table_offset = 0;
+		for (std::uint32_t c = desc.first_chunk; c < desc.first_chunk + desc.chunks_count; ++c) {
+			const auto &chunk = container_chunks[c];
+			if (chunk.offset < data_offset ||
+				chunk.offset > size ||
+				size - chunk.offset < chunk.stored_size ||
+				chunk.table_offset != table_offset ||
+				desc.bytes - chunk.table_offset < chunk.size ||
+				(chunk.compression == chunk_compression::none && chunk.stored_size != chunk.size) ||
+				(chunk.compression != chunk_compression::none && chunk.compression != chunk_compression::deflate))
+				return false;
+
+			table_offset += chunk.size;
+		}
+		if (table_offset != desc.bytes)
+			return false;
+	}
+
+	map = std::move(file);
+	tables = reinterpret_cast<const table_descriptor*>(map.data() + tables_offset);
+	chunks = reinterpret_cast<const chunk_entry*>(map.data() + chunks_offset);
+
+	return true;
+}
+
+bool atmospherics_lut_container::decode_chunk(const chunk_entry &chunk, std::uint8_t *dst) const {
+	const auto *src = reinterpret_cast<const std::uint8_t*>(map.data() + chunk.offset);
+
+	// Verify
+	if (crc32::crc32_fast(src, static_cast<std::size_t>(chunk.stored_size)) != chunk.crc)
+		return false;
+
+	dst += chunk.table_offset;
+	if (chunk.compression == chunk_compression::none) {
+		std::memcpy(dst, src, static_cast<std::size_t>(chunk.size));
+		return true;
+	}
+
+	auto length = static_cast<uLongf>(chunk.size);
+	return uncompress(dst, &length, src, static_cast<uLong>(chunk.stored_size)) == Z_OK &&
+		length == chunk.size;
+}
+
+bool atmospherics_lut_container::decode(table t, void *dst, task_scheduler &sched) const {
+	const auto &desc = descriptor(t);
+	auto *out = reinterpret_cast<std::uint8_t*>(dst);
+
+	if (desc.chunks_count == 1)
+		return decode_chunk(chunks[desc.first_chunk], out);
+
+	lib::vector<task_future<bool>> futures;
+	futures.reserve(desc.chunks_count);
+	for (std::uint32_t c = desc.first_chunk; c < desc.first_chunk + desc.chunks_count; ++c) {
+		futures.push_back(sched.schedule_now([this, out, &chunk = chunks[c]]() {
+			return decode_chunk(chunk, out);
+		}));
+	}
+
+	bool verified = true;
+	for (auto &f : futures)
+		verified = f.get() && verified;
+
+	return verified;
+}
+
+std::experimental::filesystem::path atmospherics_lut_container::container_path(const std::experimental::filesystem::path &lut_path) {
+	auto p = lut_path;
+	p += extension;
+	return p;
+}
+
+atmospherics_lut_container atmospherics_lut_container::open_existing(const std::experimental::filesystem::path &lut_path) {
+	const auto path = container_path(lut_path);
+
+	// Stale containers are ignored
+	std::error_code err;
+	const bool has_lut = std::experimental::filesystem::exists(lut_path, err);
+	if (std::experimental::filesystem::exists(path, err) &&
+		(!has_lut || std::experimental::filesystem::last_write_time(path, err) >= std::experimental::filesystem::last_write_time(lut_path, err)))
+		return atmospherics_lut_container(path);
+
+	return atmospherics_lut_container();
+}
+
+atmospherics_lut_container atmospherics_lut_container::convert(const std::experimental::filesystem::path &lut_path,
+															   const atmospherics_precompute_scattering &source,
+															   task_scheduler &sched) {
+	const auto path = container_path(lut_path);
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	source.verify();
+	try {
+		write(path, source, sched);
+	}
+	catch (const atmospherics_lut_error &) {
+		// Logged by write()
+		return atmospherics_lut_container();
+	}
+
+	atmospherics_lut_container container(path);
+	if (!container.is_valid()) {
+		ste_log_warn() << "Written atmospherics LUT container " << path.string() << " is unreadable" << std::endl;
+		return container;
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+	ste_log() << "Converted atmospherics LUT " << lut_path.string() << " into " << path.string() << " (" << container.size() << " bytes) in " << elapsed.count() << "ms" << std::endl;
+
+	return container;
+}
+
+void atmospherics_lut_container::write(const std::experimental::filesystem::path &path,
+									   const atmospherics_precompute_scattering &source,
+									   task_scheduler &sched,
+									   bool compress) {
+	// Create the tables, in table order
+	const auto optical_length = source.create_optical_length_lut();
+	const auto scatter = source.create_scatter_lut();
+	const auto mie0_scatter = source.create_mie0_scatter_lut();
+	const auto ambient = source.create_ambient_lut();
+
+	const auto optical_length_fallback = downsample_optical_length_lut(optical_length, optical_length_fallback_factor);
+	const auto scatter_fallback = downsample_scatter_lut(scatter, scatter_fallback_factor);
+	const auto mie0_scatter_fallback = downsample_scatter_lut(mie0_scatter, scatter_fallback_factor);
+	const auto ambient_fallback = downsample_scatter_lut(ambient, scatter_fallback_factor);
+
+	const table_source sources[tables_count] = {
+		make_table_source(optical_length),
+		make_table_source(scatter),
+		make_table_source(mie0_scatter),
+		make_table_source(ambient),
+		make_table_source(optical_length_fallback),
+		make_table_source(scatter_fallback),
+		make_table_source(mie0_scatter_fallback),
+		make_table_source(ambient_fallback),
+	};
+
+	// Build index
+	table_descriptor descriptors[tables_count];
+	lib::vector<chunk_entry> entries;
+	for (std::uint32_t i = 0; i < tables_count; ++i) {
+		const auto &src = sources[i];
+		auto &desc = descriptors[i];
+
+		desc.format = src.format;
+		desc.extent[0] = src.extent.x;
+		desc.extent[1] = src.extent.y;
+		desc.extent[2] = src.extent.z;
+		desc.layers = src.layers;
+		desc.first_chunk = static_cast<std::uint32_t>(entries.size());
+		desc.reserved = 0;
+		desc.bytes = src.bytes;
+
+		for (std::uint64_t offset = 0; offset < src.bytes; offset += chunk_size) {
+			chunk_entry chunk = {};
+			chunk.table_offset = offset;
+			chunk.size = std::min(chunk_size, src.bytes - offset);
+			entries.push_back(chunk);
+		}
+		desc.chunks_count = static_cast<std::uint32_t>(entries.size()) - desc.first_chunk;
+	}
+
+	// Encode chunks in parallel
+	lib::vector<task_future<encoded_chunk>> futures;
+	futures.reserve(entries.size());
+	for (std::uint32_t i = 0; i < tables_count; ++i) {
+		const auto &src = sources[i];
+		const auto &desc = descriptors[i];
+		for (std::uint32_t c = desc.first_chunk; c < desc.first_chunk + desc.chunks_count; ++c) {
+			const auto *data = src.data + entries[c].table_offset;
+			const auto size = entries[c].size;
+			futures.push_back(sched.schedule_now([=]() {
+				return encode_chunk(data, size, compress);
+			}));
+		}
+	}
+
+	container_header header;
+	header.magic = magic_value;
+	header.version = format_version;
+	header.tables_count = tables_count;
+	header.chunks_count = static_cast<std::uint32_t>(entries.size());
+
+	const std::uint64_t data_offset = sizeof(container_header) + sizeof(descriptors) + entries.size() * sizeof(chunk_entry);
+
+	auto temp_path = path;
+	temp_path += ".tmp";
+	std::size_t retrieved_chunks = 0;
+	try {
+		std::ofstream of;
+		of.exceptions(of.exceptions() | std::ios::failbit | std::ios::badbit);
+		of.open(temp_path.string(), std::ios::binary | std::ios::out | std::ios::trunc);
+
+		// Write chunks' data, in order, as they are encoded. The index is written once complete.
+		of.seekp(static_cast<std::streamoff>(data_offset));
+		std::uint64_t offset = data_offset;
+		for (std::uint32_t i = 0; i < tables_count; ++i) {
+			const auto &src = sources[i];
+			const auto &desc = descriptors[i];
+			for (std::uint32_t c = desc.first_chunk; c < desc.first_chunk + desc.chunks_count; ++c) {
+				retrieved_chunks = c + 1;
+				auto encoded = futures[c].get();
+				auto &chunk = entries[c];
+
+				chunk.offset = offset;
+				chunk.compression = encoded.compression;
+				chunk.crc = encoded.crc;
+				if (encoded.compression == chunk_compression::none) {
+					chunk.stored_size = chunk.size;
+					of.write(reinterpret_cast<const char*>(src.data + chunk.table_offset), static_cast<std::streamsize>(chunk.size));
+				}
+				else {
+					chunk.stored_size = encoded.data.size();
+					of.write(reinterpret_cast<const char*>(encoded.data.data()), static_cast<std::streamsize>(encoded.data.size()));
+				}
+
+				offset += chunk.stored_size;
+			}
+		}
+
+		of.seekp(0);
+		of.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		of.write(reinterpret_cast<const char*>(descriptors), sizeof(descriptors));
+		of.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(chunk_entry)));
+		of.close();
+
+		std::experimental::filesystem::rename(temp_path, path);
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't write atmospherics LUT container " << path.string() << ": " << e.what() << std::endl;
+
+		// Pending encoders reference the tables
+		for (auto c = retrieved_chunks; c < futures.size(); ++c)
+			futures[c].wait();
+
+		// Remove partially written files
+		std::error_code err;
+		std::experimental::filesystem::remove(temp_path, err);
+
+		throw atmospherics_lut_error("Failed writing LUT container");
+	}
+}
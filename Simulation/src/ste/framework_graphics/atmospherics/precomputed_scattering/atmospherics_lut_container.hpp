@@ -0,0 +1,187 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <atmospherics_lut_error.hpp>
+#include <atmospherics_precompute_scattering.hpp>
+
+#include <surface.hpp>
+#include <format.hpp>
+#include <task_scheduler.hpp>
+
+#include <mapped_file.hpp>
+#include <filesystem>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	Read-only, memory mapped, container of the atmospherics LUTs.
+ *
+ *	The container holds the tables of atmospherics_precompute_scattering in their device formats, along with
+ *	low-resolution fallback tables that can be uploaded quickly while the full-resolution tables are streamed in.
+ *	Each table is split into chunks of up to chunk_size bytes, which are optionally deflate compressed and carry a CRC32
+ *	of their stored bytes. Chunks are verified and decoded in parallel.
+ *
+ *	Layout:	container_header, table_descriptor[tables_count], chunk_entry[chunks_count], chunks' data.
+ */
+class atmospherics_lut_container {
+public:
+	static constexpr std::uint32_t magic_value = 0x54554C41;	// "ALUT"
+	static constexpr std::uint32_t format_version = 1;
+	static constexpr auto extension = ".stelut";
+
+	// Decoded bytes per chunk
+	static constexpr std::uint64_t chunk_size = 4 * 1024 * 1024;
+
+	// Fallback tables are downsampled by these factors in each dimension
+	static constexpr std::uint32_t optical_length_fallback_factor = 8;
+	static constexpr std::uint32_t scatter_fallback_factor = 4;
+
+	enum class table : std::uint32_t {
+		optical_length,
+		scatter,
+		mie0_scatter,
+		ambient,
+		optical_length_fallback,
+		scatter_fallback,
+		mie0_scatter_fallback,
+		ambient_fallback,
+	};
+	static constexpr std::uint32_t tables_count = 8;
+
+	enum class chunk_compression : std::uint32_t {
+		none,
+		deflate,
+	};
+
+	struct container_header {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t tables_count;
+		std::uint32_t chunks_count;
+	};
+
+	struct table_descriptor {
+		gl::format format;
+		std::uint32_t extent[3];
+		std::uint32_t layers;
+		std::uint32_t first_chunk;
+		std::uint32_t chunks_count;
+		std::uint32_t reserved;
+		// Decoded size
+		std::uint64_t bytes;
+	};
+
+	struct chunk_entry {
+		std::uint64_t offset;
+		std::uint64_t stored_size;
+		// Offset and size of the decoded chunk in the table
+		std::uint64_t table_offset;
+		std::uint64_t size;
+		chunk_compression compression;
+		// CRC32 of the stored bytes
+		std::uint32_t crc;
+	};
+
+private:
+	mapped_file map;
+	const table_descriptor *tables{ nullptr };
+	const chunk_entry *chunks{ nullptr };
+
+private:
+	bool open(mapped_file &&file);
+	bool decode_chunk(const chunk_entry &chunk, std::uint8_t *dst) const;
+
+	static std::experimental::filesystem::path container_path(const std::experimental::filesystem::path &lut_path);
+
+	template <typename Surface>
+	Surface decode_surface(table t, Surface &&surface, task_scheduler &sched) const {
+		const auto &desc = descriptor(t);
+		if (desc.format != surface.surface_format() ||
+			desc.bytes != static_cast<std::size_t>(surface.bytes()))
+			throw atmospherics_lut_error("LUT container table mismatch");
+
+		if (!decode(t, surface.data(), sched))
+			throw atmospherics_lut_error("LUT container chunk verification failed");
+
+		return std::move(surface);
+	}
+
+public:
+	atmospherics_lut_container() = default;
+	/**
+	*	@brief	Maps a LUT container. If the container doesn't exist or is corrupt, the container is left invalid.
+	*
+	*	@param path		Path to the container file
+	*/
+	atmospherics_lut_container(const std::experimental::filesystem::path &path);
+	~atmospherics_lut_container() noexcept {}
+
+	atmospherics_lut_container(atmospherics_lut_container&&) = default;
+	atmospherics_lut_container &operator=(atmospherics_lut_container&&) = default;
+	atmospherics_lut_container(const atmospherics_lut_container&) = delete;
+	atmospherics_lut_container &operator=(const atmospherics_lut_container&) = delete;
+
+	/**
+	*	@brief	Opens the container of a precomputed scattering LUT. If no valid, up-to-date, container exists beside the
+	*			LUT, the returned container is invalid.
+	*/
+	static atmospherics_lut_container open_existing(const std::experimental::filesystem::path &lut_path);
+
+	/**
+	*	@brief	Converts a precomputed scattering LUT and writes its container beside the LUT.
+	*			Failure to write the container, e.g. on a read-only install, is logged and leaves the returned container
+	*			invalid, callers should then use the LUT directly.
+	*
+	*	@param	source	The LUT, read from lut_path
+	*
+	*	@throws	atmospherics_lut_error	If the LUT fails verification
+	*/
+	static atmospherics_lut_container convert(const std::experimental::filesystem::path &lut_path,
+											  const atmospherics_precompute_scattering &source,
+											  task_scheduler &sched);
+
+	/**
+	*	@brief	Writes a container from a precomputed scattering LUT. The container is written to a temporary file which
+	*			replaces the target on completion.
+	*
+	*	@param	compress	If set to true, chunks are deflate compressed, unless compression doesn't reduce their size.
+	*/
+	static void write(const std::experimental::filesystem::path &path,
+					  const atmospherics_precompute_scattering &source,
+					  task_scheduler &sched,
+					  bool compress = true);
+
+	/**
+	*	@brief	Decodes a table into dst, which must hold descriptor(t).bytes bytes. Chunks are verified and decoded on the
+	*			task scheduler.
+	*
+	*	@return	False if any of the table's chunks failed verification or decompression.
+	*/
+	bool decode(table t, void *dst, task_scheduler &sched) const;
+
+	auto decode_optical_length_lut(table t, task_scheduler &sched) const {
+		const auto &desc = descriptor(t);
+		return decode_surface(t,
+							  resource::surface_2d_array<atmospherics_precompute_scattering::optical_length_lut_format>(glm::u32vec2{ desc.extent[0], desc.extent[1] },
+																													   layers_t(desc.layers)),
+							  sched);
+	}
+	auto decode_scatter_lut(table t, task_scheduler &sched) const {
+		const auto &desc = descriptor(t);
+		return decode_surface(t,
+							  resource::surface_3d<atmospherics_precompute_scattering::scatter_lut_format>(glm::u32vec3{ desc.extent[0], desc.extent[1], desc.extent[2] }),
+							  sched);
+	}
+
+	const table_descriptor &descriptor(table t) const { return tables[static_cast<std::uint32_t>(t)]; }
+
+	bool is_valid() const { return tables != nullptr; }
+	auto size() const { return map.size(); }
+};
+
+}
+}
@@ -10,9 +10,11 @@
 #include <surface.hpp>
 
 #include <filesystem>
+#include <algorithm>
+#include <type_traits>
 
-#include <lib/unique_ptr.hpp>
-#include <fstream>
+#include <mapped_file.hpp>
+#include <half.hpp>
 #include <crc32.h>
 
 namespace ste {
@@ -105,17 +107,9 @@ public:
 	const auto *scatter_lut() const { return &data.scatter; }
 	const auto *ambient_lut() const { return &data.ambient; }
 
-	void load(const std::experimental::filesystem::path &path) {
-		std::ifstream ifs;
-		ifs.exceptions(ifs.exceptions() | std::ios::failbit);
-		ifs.open(path.string(), std::ios::binary | std::ios::in);
-
-		if (!ifs)
-			throw atmospherics_lut_error("Failed opening LUT");
-
-		if (!ifs.read(reinterpret_cast<char*>(this), sizeof(*this) / sizeof(char)))
+	void validate(std::size_t size) const {
+		if (size < sizeof(*this))
 			throw atmospherics_lut_error("Can not read LUT");
-		ifs.close();
 
 		if (this->sizeof_scalar != sizeof(T))
 			throw atmospherics_lut_error("Invalid scalar size");
@@ -128,8 +122,9 @@ public:
 			this->scatter_dims_1 != scatter_size1 ||
 			this->scatter_dims_2 != scatter_size2)
 			throw atmospherics_lut_error("LUT size zero");
+	}
 
-		// CRC checksum
+	void verify_checksum() const {
 		const auto checksum = crc32::crc32_fast(reinterpret_cast<const std::uint8_t*>(&data), sizeof(data));
 		if (this->hash != checksum)
 			throw atmospherics_lut_error("Hash mismatch");
@@ -138,6 +133,13 @@ public:
 
 }
 
+/**
+ *	@brief	Reads the precomputed scattering LUT, as written by the AtmosphericScatteringPrecompute tool.
+ *
+ *	The LUT is memory mapped and read in place. Only the LUT's header is validated on construction, see verify().
+ *	Scattering and ambient tables are created as half-float surfaces, the
+ *	optical length tables, which exceed the half-float range, as single-precision floats.
+ */
 class atmospherics_precompute_scattering {
 	using T = double;
 	using lut_data_t = _detail::_atmospherics_precompute_scattering_data<T>;
@@ -145,99 +147,116 @@ class atmospherics_precompute_scattering {
 	static constexpr int optical_length_air_lut_idx = 0;
 	static constexpr int optical_length_aerosols_lut_idx = 1;
 
+public:
+	static constexpr auto scatter_lut_format = gl::format::r16g16b16a16_sfloat;
+	static constexpr auto optical_length_lut_format = gl::format::r32_sfloat;
+
 private:
-	lib::unique_ptr<lut_data_t> data;
+	mapped_file file;
+	const lut_data_t *data{ nullptr };
 
 private:
-	void create_optical_length_lut(int lut_idx, float *lut) const {
-		for (int y = 0; y < lut_data_t::optical_length_size; ++y) {
-			for (int x = 0; x < lut_data_t::optical_length_size; ++x) {
-				*lut = static_cast<float>((*data->optical_length_lut(lut_idx))[x][y]);
-				++lut;
-			}
-		}
+	static glm::tvec4<half_float::half> to_half(const glm::tvec3<T> &v) {
+		return { half_float::half(static_cast<float>(v.x)),
+			half_float::half(static_cast<float>(v.y)),
+			half_float::half(static_cast<float>(v.z)),
+			half_float::half(.0f)
+		};
 	}
 
-public:
-	atmospherics_precompute_scattering(const std::experimental::filesystem::path &path) : data(lib::allocate_unique<lut_data_t>()) {
-		data->load(path);
+	static std::uint32_t sampled_extent(std::uint32_t size, std::uint32_t step) {
+		return std::max(size / step, 1u);
 	}
-	~atmospherics_precompute_scattering() noexcept {}
 
-	auto create_optical_length_lut() const {
-		resource::surface_2d_array<gl::format::r32_sfloat> lut_texture_array(glm::u32vec2{ lut_data_t::optical_length_size, lut_data_t::optical_length_size }, 2_layers);
-
-		auto* lut = reinterpret_cast<float*>(lut_texture_array.data());
-
-		create_optical_length_lut(optical_length_air_lut_idx, 
-								  lut);
-		create_optical_length_lut(optical_length_aerosols_lut_idx, 
-								  lut + lut_texture_array.offset_blocks(1_layer, 0_mip));
-
-		return lut_texture_array;
+	void create_optical_length_lut(int lut_idx, float *lut, std::uint32_t step) const {
+		const auto extent = sampled_extent(lut_data_t::optical_length_size, step);
+		for (std::uint32_t y = 0; y < extent; ++y) {
+			for (std::uint32_t x = 0; x < extent; ++x) {
+				*lut = static_cast<float>((*data->optical_length_lut(lut_idx))[x * step][y * step]);
+				++lut;
+			}
+		}
 	}
 
-	auto create_scatter_lut() const {
-		resource::surface_3d<gl::format::r32g32b32a32_sfloat> lut_texture(glm::u32vec3{ lut_data_t::scatter_size0, lut_data_t::scatter_size1, lut_data_t::scatter_size2 });
+	template <typename Lut, typename Element>
+	auto create_3d_lut(const Lut &src, std::uint32_t step, const Element &element) const {
+		using element_t = std::remove_extent_t<std::remove_extent_t<std::remove_extent_t<Lut>>>;
+		constexpr auto size0 = static_cast<std::uint32_t>(std::extent_v<Lut, 0>);
+		constexpr auto size1 = static_cast<std::uint32_t>(std::extent_v<Lut, 1>);
+		constexpr auto size2 = static_cast<std::uint32_t>(std::extent_v<Lut, 2>);
+
+		const glm::u32vec3 extent = { sampled_extent(size0, step), sampled_extent(size1, step), sampled_extent(size2, step) };
+		resource::surface_3d<scatter_lut_format> lut_texture(extent);
 
-		auto *lut = reinterpret_cast<glm::vec4*>(lut_texture.data());
+		auto *lut = reinterpret_cast<glm::tvec4<half_float::half>*>(lut_texture.data());
 
-		for (int z = 0; z < lut_data_t::scatter_size2; ++z)
-			for (int y = 0; y < lut_data_t::scatter_size1; ++y)
-				for (int x = 0; x < lut_data_t::scatter_size0; ++x) {
-					auto &v = (*data->scatter_lut())[x][y][z].v0;
+		for (std::uint32_t z = 0; z < extent.z; ++z)
+			for (std::uint32_t y = 0; y < extent.y; ++y)
+				for (std::uint32_t x = 0; x < extent.x; ++x) {
+					const element_t &v = src[x * step][y * step][z * step];
 
-					*lut = { static_cast<float>(v.x),
-						static_cast<float>(v.y),
-						static_cast<float>(v.z),
-						.0f
-					};
+					*lut = to_half(element(v));
 					++lut;
 				}
 
 		return lut_texture;
 	}
 
-	auto create_mie0_scatter_lut() const {
-		resource::surface_3d<gl::format::r32g32b32a32_sfloat> lut_texture(glm::u32vec3{ lut_data_t::scatter_size0, lut_data_t::scatter_size1, lut_data_t::scatter_size2 });
-
-		auto *lut = reinterpret_cast<glm::vec4*>(lut_texture.data());
+public:
+	atmospherics_precompute_scattering(const std::experimental::filesystem::path &path) {
+		std::error_code err;
+		if (!std::experimental::filesystem::exists(path, err))
+			throw atmospherics_lut_error("Failed opening LUT");
 
-		for (int z = 0; z < lut_data_t::scatter_size2; ++z)
-			for (int y = 0; y < lut_data_t::scatter_size1; ++y)
-				for (int x = 0; x < lut_data_t::scatter_size0; ++x) {
-					auto &v = (*data->scatter_lut())[x][y][z].v1;
+		file = mapped_file(path, mapped_file::access::read_only);
+		if (!file.is_mapped())
+			throw atmospherics_lut_error("Failed opening LUT");
 
-					*lut = { static_cast<float>(v.x),
-						static_cast<float>(v.y),
-						static_cast<float>(v.z),
-						.0f
-					};
-					++lut;
-				}
+		data = reinterpret_cast<const lut_data_t*>(file.data());
+		data->validate(file.size());
+	}
+	~atmospherics_precompute_scattering() noexcept {}
 
-		return lut_texture;
+	/**
+	*	@brief	Verifies the LUT's checksum. Reads the entire LUT.
+	*
+	*	@throws	atmospherics_lut_error	On checksum mismatch
+	*/
+	void verify() const {
+		data->verify_checksum();
 	}
 
-	auto create_ambient_lut() const {
-		resource::surface_3d<gl::format::r32g32b32a32_sfloat> lut_texture(glm::u32vec3{ lut_data_t::ambient_size_0, lut_data_t::ambient_size_1, lut_data_t::ambient_size_2 });
+	/*
+	 *	The table creation methods optionally point sample every step-th element in each dimension. Sampled tables only
+	 *	touch a fraction of the LUT, and are used as quick, low-resolution, stand-ins.
+	 */
 
-		auto *lut = reinterpret_cast<glm::vec4*>(lut_texture.data());
+	auto create_optical_length_lut(std::uint32_t step = 1) const {
+		const auto extent = sampled_extent(lut_data_t::optical_length_size, step);
+		resource::surface_2d_array<optical_length_lut_format> lut_texture_array(glm::u32vec2{ extent, extent }, 2_layers);
 
-		for (int z = 0; z < lut_data_t::ambient_size_2; ++z)
-			for (int y = 0; y < lut_data_t::ambient_size_1; ++y)
-				for (int x = 0; x < lut_data_t::ambient_size_0; ++x) {
-					auto &v = (*data->ambient_lut())[x][y][z];
+		auto* lut = reinterpret_cast<float*>(lut_texture_array.data());
 
-					*lut = { static_cast<float>(v.x),
-						static_cast<float>(v.y),
-						static_cast<float>(v.z),
-						.0f
-					};
-					++lut;
-				}
+		create_optical_length_lut(optical_length_air_lut_idx, 
+								  lut,
+								  step);
+		create_optical_length_lut(optical_length_aerosols_lut_idx, 
+								  lut + lut_texture_array.offset_blocks(1_layer, 0_mip),
+								  step);
 
-		return lut_texture;
+		return lut_texture_array;
+	}
+
+	auto create_scatter_lut(std::uint32_t step = 1) const {
+		return create_3d_lut(*data->scatter_lut(), step, [](const auto &e) -> auto& { return e.v0; });
+	}
+
+	auto create_mie0_scatter_lut(std::uint32_t step = 1) const {
+		return create_3d_lut(*data->scatter_lut(), step, [](const auto &e) -> auto& { return e.v1; });
+	}
+
+	auto create_ambient_lut(std::uint32_t step = 1) const {
+		return create_3d_lut(*data->ambient_lut(), step, [](const auto &e) -> auto& { return e; });
 	}
 };
 
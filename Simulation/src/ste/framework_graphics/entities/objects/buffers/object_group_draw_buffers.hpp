@@ -8,6 +8,7 @@
 #include <buffer_usage.hpp>
 #include <stable_vector.hpp>
 #include <mesh_descriptor.hpp>
+#include <draw_indexed_indirect_command_block.hpp>
 
 namespace ste {
 namespace graphics {
@@ -16,6 +17,9 @@ class object_group_draw_buffers {
 private:
 	mutable gl::stable_vector<mesh_descriptor> mesh_data_bo;
 	mutable gl::stable_vector<mesh_draw_params> mesh_draw_params_bo;
+	mutable gl::stable_vector<mesh_cluster> mesh_clusters_bo;
+	// Unculled whole-object draws, for passes that need all of the geometry
+	gl::stable_vector<gl::draw_indexed_indirect_command_block> draw_commands;
 	gl::stable_vector<object_vertex_data> vbo;
 	gl::stable_vector<std::uint32_t> indices;
 
@@ -27,6 +31,12 @@ public:
 		  mesh_draw_params_bo(ctx, 
 							  gl::buffer_usage::storage_buffer,
 							  "mesh_draw_params buffer"),
+		  mesh_clusters_bo(ctx,
+						   gl::buffer_usage::storage_buffer,
+						   "mesh_clusters buffer"),
+		  draw_commands(ctx,
+						gl::buffer_usage::indirect_buffer,
+						"object draw commands buffer"),
 		  vbo(ctx, 
 			  gl::buffer_usage::vertex_buffer,
 			  "vertex attributes buffer"),
@@ -38,6 +48,10 @@ public:
 	auto &get_mesh_data_buffer() const { return mesh_data_bo; }
 	auto &get_mesh_draw_params_buffer() { return mesh_draw_params_bo; }
 	auto &get_mesh_draw_params_buffer() const { return mesh_draw_params_bo; }
+	auto &get_mesh_clusters_buffer() { return mesh_clusters_bo; }
+	auto &get_mesh_clusters_buffer() const { return mesh_clusters_bo; }
+	auto &get_draw_commands_buffer() { return draw_commands; }
+	auto &get_draw_commands_buffer() const { return draw_commands; }
 
 	auto &get_vertex_buffer() { return vbo; }
 	auto &get_vertex_buffer() const { return vbo; }
@@ -27,5 +27,14 @@ struct mesh_draw_params : gl::std430<std::uint32_t, std::uint32_t, std::int32_t>
 	auto& vertex_offset() { return get<2>(); }
 };
 
+struct mesh_cluster : gl::std430<glm::vec4, glm::vec4, std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> {
+	auto& bounding_sphere() { return get<0>(); }
+	auto& normal_cone() { return get<1>(); }
+
+	auto& first_index() { return get<2>(); }
+	auto& count() { return get<3>(); }
+	auto& draw_id() { return get<4>(); }
+};
+
 }
 }
@@ -3,6 +3,7 @@
 #include <object_group.hpp>
 
 #include <mesh_descriptor.hpp>
+#include <mesh_meshlets.hpp>
 #include <material.hpp>
 
 #include <atomic>
@@ -25,6 +26,12 @@ void object_group::add_object(const ste_context &ctx,
 	assert(ind.size() && "Indices empty!");
 	assert(vertices.size() && "Vertices empty!");
 
+	// Meshlets, built now if the mesh wasn't supplied with precomputed meshlets
+	lib::vector<mesh_meshlet> built_meshlets;
+	if (obj->get_mesh().get_meshlets().empty())
+		built_meshlets = mesh_meshlet_builder::build(ind, vertices);
+	const auto &meshlets = built_meshlets.empty() ? obj->get_mesh().get_meshlets() : built_meshlets;
+
 	// Attach connection for object update
 	auto connection = make_connection(obj->signal_model_change(), [this](object* obj) {
 		this->signalled_objects.push_back(obj);
@@ -51,10 +58,34 @@ void object_group::add_object(const ste_context &ctx,
 	mdp.first_index() = static_cast<std::uint32_t>(draw_buffers.get_index_buffer().size());
 	mdp.vertex_offset() = static_cast<std::uint32_t>(draw_buffers.get_vertex_buffer().size());
 
+	const auto draw_id = static_cast<std::uint32_t>(objects.size());
+
+	// Unculled draw command of the whole object
+	gl::draw_indexed_indirect_command_block draw_command;
+	draw_command.index_count() = mdp.count();
+	draw_command.instance_count() = 1;
+	draw_command.first_index() = mdp.first_index();
+	draw_command.vertex_offset() = mdp.vertex_offset();
+	draw_command.first_instance() = draw_id;
+
+	// And the object's clusters
+	lib::vector<mesh_cluster> clusters;
+	clusters.reserve(meshlets.size());
+	for (auto &m : meshlets) {
+		mesh_cluster c;
+		c.bounding_sphere() = m.bounding_sphere;
+		c.normal_cone() = m.normal_cone;
+		c.first_index() = mdp.first_index() + m.first_index;
+		c.count() = m.index_count;
+		c.draw_id() = draw_id;
+		clusters.push_back(c);
+	}
+	clusters_count += clusters.size();
+
 	obj->md = md;
 	// Add to objects set
 	objects.insert(std::make_pair(obj,
-								  object_information{ objects.size(), std::move(connection) }));
+								  object_information{ draw_id, std::move(connection) }));
 	object_sizes.push_back(mdp.count());
 
 	// Append new vertex/index data
@@ -71,11 +102,19 @@ void object_group::add_object(const ste_context &ctx,
 																						gl::access_flags::transfer_write),
 															  gl::buffer_memory_barrier(draw_buffers.get_mesh_draw_params_buffer(),
 																						gl::access_flags::shader_read,
+																						gl::access_flags::transfer_write),
+															  gl::buffer_memory_barrier(draw_buffers.get_mesh_clusters_buffer(),
+																						gl::access_flags::shader_read,
+																						gl::access_flags::transfer_write),
+															  gl::buffer_memory_barrier(draw_buffers.get_draw_commands_buffer(),
+																						gl::access_flags::indirect_command_read,
 																						gl::access_flags::transfer_write)));
 	recorder << draw_buffers.get_vertex_buffer().push_back_cmd(ctx, vertices);
 	recorder << draw_buffers.get_index_buffer().push_back_cmd(ctx, ind);
 	recorder << draw_buffers.get_mesh_data_buffer().push_back_cmd(ctx, std::move(md));
 	recorder << draw_buffers.get_mesh_draw_params_buffer().push_back_cmd(ctx, std::move(mdp));
+	recorder << draw_buffers.get_mesh_clusters_buffer().push_back_cmd(ctx, clusters);
+	recorder << draw_buffers.get_draw_commands_buffer().push_back_cmd(ctx, std::move(draw_command));
 	recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
 															  gl::pipeline_stage::vertex_input | gl::pipeline_stage::draw_indirect | gl::pipeline_stage::vertex_shader | gl::pipeline_stage::compute_shader,
 															  gl::buffer_memory_barrier(draw_buffers.get_mesh_data_buffer(),
@@ -84,6 +123,12 @@ void object_group::add_object(const ste_context &ctx,
 															  gl::buffer_memory_barrier(draw_buffers.get_mesh_draw_params_buffer(),
 																						gl::access_flags::transfer_write,
 																						gl::access_flags::shader_read),
+															  gl::buffer_memory_barrier(draw_buffers.get_mesh_clusters_buffer(),
+																						gl::access_flags::transfer_write,
+																						gl::access_flags::shader_read),
+															  gl::buffer_memory_barrier(draw_buffers.get_draw_commands_buffer(),
+																						gl::access_flags::transfer_write,
+																						gl::access_flags::indirect_command_read),
 															  gl::buffer_memory_barrier(draw_buffers.get_vertex_buffer(),
 																						gl::access_flags::transfer_write,
 																						gl::access_flags::vertex_attribute_read),
@@ -99,6 +144,7 @@ void object_group::remove_all() {
 		o.first->signal_model_change().disconnect(&o.second.connection);
 	objects.clear();
 	signalled_objects.clear();
+	clusters_count = 0;
 }
 
 void object_group::update_dirty_buffers(gl::command_recorder &recorder) const {
@@ -33,6 +33,7 @@ private:
 	object_group_draw_buffers draw_buffers;
 	objects_map_type objects;
 	lib::vector<std::uint32_t> object_sizes;
+	std::size_t clusters_count{ 0 };
 
 	mutable lib::vector<object*> signalled_objects;
 	mutable std::mutex m;
@@ -52,6 +53,7 @@ public:
 
 	auto& object_size_list() const { return object_sizes; }
 	auto draw_count() const { return objects.size(); }
+	auto cluster_count() const { return clusters_count; }
 };
 
 }
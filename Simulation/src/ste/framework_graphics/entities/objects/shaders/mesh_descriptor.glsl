@@ -18,6 +18,18 @@ struct mesh_draw_params {
 	int vertex_offset;
 };
 
+struct mesh_cluster {
+	vec4 bounding_sphere;
+	// xyz axis, w cutoff
+	vec4 normal_cone;
+
+	uint first_index;
+	uint count;
+	uint draw_id;
+
+	uint _unused;
+};
+
 layout(std430, set=2, binding=2) restrict readonly buffer mesh_descriptors_binding {
 	mesh_descriptor mesh_descriptor_buffer[];
 };
@@ -26,9 +38,20 @@ layout(std430, set=2, binding=3) restrict readonly buffer mesh_draw_params_bindi
 	mesh_draw_params mesh_draw_params_buffer[];
 };
 
+layout(std430, set=2, binding=27) restrict readonly buffer mesh_clusters_binding {
+	mesh_cluster mesh_clusters_buffer[];
+};
+
 /**
 *	@brief	Applies a mesh model transform to a vertex
 */
 vec3 transform_model(mesh_descriptor mesh, vec3 v) {
 	return vec4(v, 1) * mesh.model_transform_matrix;
 }
+
+/**
+*	@brief	Applies a mesh model transform to a direction. The result is not normalized.
+*/
+vec3 transform_model_direction(mesh_descriptor mesh, vec3 dir) {
+	return vec4(dir, 0) * mesh.model_transform_matrix;
+}
@@ -7,6 +7,7 @@
 
 #include <object_vertex_data.hpp>
 #include <mesh_bounding_sphere.hpp>
+#include <mesh_meshlets.hpp>
 
 #include <lib/vector.hpp>
 #include <type_traits>
@@ -21,6 +22,10 @@ public:
 	virtual const lib::vector<object_vertex_data> &get_vertices() const = 0;
 	virtual const lib::vector<std::uint32_t> &get_indices() const = 0;
 	virtual const mesh_bounding_sphere &bounding_sphere() const = 0;
+	/**
+	 *	@brief	Precomputed meshlets, see mesh_meshlet_builder. Empty if none were provided.
+	 */
+	virtual const lib::vector<mesh_meshlet> &get_meshlets() const = 0;
 };
 
 enum class mesh_subdivion_mode {
@@ -34,12 +39,16 @@ class mesh : public mesh_generic {
 private:
 	lib::vector<object_vertex_data> vertices;
 	lib::vector<std::uint32_t> indices;
+	lib::vector<mesh_meshlet> meshlets;
 
 protected:
 	mesh_bounding_sphere sphere;
 
 private:
 	void calc_sphere() {
+		// Geometry changed, meshlets are stale
+		meshlets.clear();
+
 		if (!vertices.size()) {
 			sphere = mesh_bounding_sphere({ 0,0,0 }, .0f);
 			return;
@@ -68,6 +77,7 @@ public:
 	const lib::vector<object_vertex_data> &get_vertices() const override final { return vertices; }
 	const lib::vector<std::uint32_t> &get_indices() const override final { return indices; }
 	const mesh_bounding_sphere &bounding_sphere() const override final { return sphere; };
+	const lib::vector<mesh_meshlet> &get_meshlets() const override final { return meshlets; }
 
 	void set_vertices(const object_vertex_data *vert, int size) {
 		vertices = decltype(vertices)(vert, vert + size);
@@ -85,6 +95,14 @@ public:
 	template <typename T>
 	void set_indices(T &&ind) {
 		indices = decltype(indices)(std::forward<T>(ind));
+		meshlets.clear();
+	}
+	/**
+	 *	@brief	Sets the meshlets of the mesh's current vertices and indices. Any change to the geometry discards them.
+	 */
+	template <typename T>
+	void set_meshlets(T &&m) {
+		meshlets = decltype(meshlets)(std::forward<T>(m));
 	}
 
 	template <bool b = Mode == mesh_subdivion_mode::Triangles>
@@ -0,0 +1,131 @@
+
+#include <stdafx.hpp>
+#include <mesh_meshlets.hpp>
+
+#include <algorithm>
+#include <limits>
+
+using namespace ste;
+using namespace ste::graphics;
+
+namespace ste::graphics::_detail {
+
+mesh_meshlet mesh_meshlet_bounds(const lib::vector<std::uint32_t> &indices,
+								 const lib::vector<object_vertex_data> &vertices,
+								 const lib::vector<std::uint32_t> &meshlet_vertices,
+								 std::uint32_t first_index,
+								 std::uint32_t end_index) {
+	const auto position = [&](std::uint32_t i) { return vertices[i].p().v(); };
+
+	mesh_meshlet m;
+	m.first_index = first_index;
+	m.index_count = end_index - first_index;
+
+	// Bounding sphere, centered at the bounding box center
+	glm::vec3 min{ +std::numeric_limits<float>::infinity() };
+	glm::vec3 max{ -std::numeric_limits<float>::infinity() };
+	for (auto v : meshlet_vertices) {
+		min = glm::min(min, position(v));
+		max = glm::max(max, position(v));
+	}
+	const auto center = (min + max) * .5f;
+	float radius2 = .0f;
+	for (auto v : meshlet_vertices) {
+		const auto u = position(v) - center;
+		radius2 = glm::max(radius2, glm::dot(u, u));
+	}
+	m.bounding_sphere = glm::vec4{ center, glm::sqrt(radius2) };
+
+	// Normal cone. Geometric normals are oriented to agree with the shading normals.
+	lib::vector<glm::vec3> normals;
+	normals.reserve(m.index_count / 3);
+	glm::vec3 axis{ .0f };
+	for (auto i = first_index; i < end_index; i += 3) {
+		const auto i0 = indices[i + 0];
+		const auto i1 = indices[i + 1];
+		const auto i2 = indices[i + 2];
+
+		auto n = glm::cross(position(i1) - position(i0), position(i2) - position(i0));
+		const auto l = glm::length(n);
+		if (l <= std::numeric_limits<float>::epsilon())
+			continue;
+
+		const auto shading_normal = vertices[i0].extract_tangent_frame()[2] +
+			vertices[i1].extract_tangent_frame()[2] +
+			vertices[i2].extract_tangent_frame()[2];
+		if (glm::dot(n, shading_normal) < .0f)
+			n = -n;
+
+		// Area weighted
+		axis += n;
+		normals.push_back(n / l);
+	}
+
+	m.normal_cone = glm::vec4{ .0f, .0f, .0f, 1.f };
+	const auto axis_length = glm::length(axis);
+	if (normals.empty() || axis_length <= std::numeric_limits<float>::epsilon())
+		return m;
+	axis /= axis_length;
+
+	float min_dp = 1.f;
+	for (auto &n : normals)
+		min_dp = glm::min(min_dp, glm::dot(axis, n));
+
+	// Normals span more than a hemisphere, can not be culled.
+	if (min_dp <= .0f)
+		return m;
+
+	// Sine of the cone's half angle
+	m.normal_cone = glm::vec4{ axis, glm::sqrt(1.f - min_dp * min_dp) };
+
+	return m;
+}
+
+}
+
+lib::vector<mesh_meshlet> mesh_meshlet_builder::build(const lib::vector<std::uint32_t> &indices,
+													  const lib::vector<object_vertex_data> &vertices) {
+	lib::vector<mesh_meshlet> meshlets;
+	if (indices.size() < 3)
+		return meshlets;
+
+	const auto indices_count = static_cast<std::uint32_t>(indices.size() / 3 * 3);
+
+	// Per vertex, the id of the last meshlet that referenced it
+	lib::vector<std::uint32_t> vertex_meshlet(vertices.size(), 0);
+	lib::vector<std::uint32_t> meshlet_vertices;
+	meshlet_vertices.reserve(max_vertices);
+
+	std::uint32_t meshlet_id = 1;
+	std::uint32_t first_index = 0;
+	for (std::uint32_t i = 0; i < indices_count; i += 3) {
+		const auto i0 = indices[i + 0];
+		const auto i1 = indices[i + 1];
+		const auto i2 = indices[i + 2];
+
+		std::uint32_t new_vertices = 0;
+		new_vertices += vertex_meshlet[i0] != meshlet_id ? 1 : 0;
+		new_vertices += vertex_meshlet[i1] != meshlet_id && i1 != i0 ? 1 : 0;
+		new_vertices += vertex_meshlet[i2] != meshlet_id && i2 != i0 && i2 != i1 ? 1 : 0;
+
+		const auto triangles = (i - first_index) / 3;
+		if (meshlet_vertices.size() + new_vertices > max_vertices ||
+			triangles + 1 > max_triangles) {
+			meshlets.push_back(_detail::mesh_meshlet_bounds(indices, vertices, meshlet_vertices, first_index, i));
+
+			++meshlet_id;
+			meshlet_vertices.clear();
+			first_index = i;
+		}
+
+		for (auto v : { i0, i1, i2 }) {
+			if (vertex_meshlet[v] != meshlet_id) {
+				vertex_meshlet[v] = meshlet_id;
+				meshlet_vertices.push_back(v);
+			}
+		}
+	}
+	meshlets.push_back(_detail::mesh_meshlet_bounds(indices, vertices, meshlet_vertices, first_index, indices_count));
+
+	return meshlets;
+}
@@ -0,0 +1,50 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <object_vertex_data.hpp>
+
+#include <lib/vector.hpp>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	A cluster of a mesh's triangles: A contiguous range of the mesh's index buffer.
+ */
+struct mesh_meshlet {
+	std::uint32_t first_index;
+	std::uint32_t index_count;
+
+	// Object space bounding sphere, xyz center and w radius
+	glm::vec4 bounding_sphere;
+	// Normal cone, xyz axis and w cutoff. The meshlet is back-facing for any viewer at position e, with
+	// dot(c - e, axis) >= cutoff * length(c - e) + radius, where c is the bounding sphere center.
+	// A cutoff of 1 disables the test.
+	glm::vec4 normal_cone;
+};
+
+/**
+ *	@brief	Splits a triangle list into meshlets, for cluster culling.
+ *
+ *	Triangles are assigned greedily in index buffer order, a new meshlet is started once the next triangle would exceed the
+ *	meshlet vertices or triangles limits. Meshlets are thereby contiguous ranges of the index buffer and can be drawn directly.
+ *	The index buffer should be first optimized for vertex locality (see mesh_optimizer), which keeps meshlets compact.
+ *
+ *	Normal cones are oriented by the vertices' shading normals, so the test is independent of the triangle winding.
+ */
+class mesh_meshlet_builder {
+public:
+	static constexpr std::uint32_t max_vertices = 64;
+	static constexpr std::uint32_t max_triangles = 124;
+
+public:
+	static lib::vector<mesh_meshlet> build(const lib::vector<std::uint32_t> &indices,
+										   const lib::vector<object_vertex_data> &vertices);
+};
+
+}
+}
@@ -0,0 +1,245 @@
+
+#include <stdafx.hpp>
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+using namespace ste;
+using namespace ste::graphics;
+
+mesh_optimizer::statistics mesh_optimizer::analyze_vertex_cache(const lib::vector<std::uint32_t> &indices,
+																std::uint32_t vertex_count,
+																std::uint32_t cache_size) {
+	statistics s;
+	s.triangles = indices.size() / 3;
+
+	// FIFO cache, a vertex is cached if it was inserted less than cache_size insertions ago
+	lib::vector<std::uint64_t> inserted_at(vertex_count, 0);
+	lib::vector<bool> referenced(vertex_count, false);
+	std::uint64_t timestamp = cache_size + 1;
+	for (auto i : indices) {
+		if (!referenced[i]) {
+			referenced[i] = true;
+			++s.vertices;
+		}
+		if (timestamp - inserted_at[i] > cache_size) {
+			inserted_at[i] = timestamp++;
+			++s.cache_misses;
+		}
+	}
+
+	return s;
+}
+
+lib::vector<std::uint32_t> mesh_optimizer::tipsify(const lib::vector<std::uint32_t> &indices,
+												   std::uint32_t vertex_count,
+												   std::uint32_t cache_size,
+												   lib::vector<std::uint32_t> &clusters) {
+	const auto triangles_count = static_cast<std::uint32_t>(indices.size() / 3);
+
+	// Vertex-triangle adjacency, in CSR form
+	lib::vector<std::uint32_t> live(vertex_count, 0);
+	for (auto i : indices)
+		++live[i];
+	lib::vector<std::uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	std::partial_sum(live.begin(), live.end(), adjacency_offsets.begin() + 1);
+	lib::vector<std::uint32_t> adjacency(indices.size());
+	{
+		lib::vector<std::uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (std::uint32_t t = 0; t < triangles_count; ++t)
+			for (int j = 0; j < 3; ++j)
+				adjacency[cursor[indices[3 * t + j]]++] = t;
+	}
+
+	lib::vector<std::uint64_t> cache_time(vertex_count, 0);
+	lib::vector<bool> emitted(triangles_count, false);
+	lib::vector<std::uint32_t> dead_end_stack;
+	lib::vector<std::uint32_t> candidates;
+
+	lib::vector<std::uint32_t> out;
+	out.reserve(indices.size());
+	clusters.clear();
+
+	std::uint64_t timestamp = cache_size + 1;
+	std::uint32_t cursor = 0;
+
+	// Next vertex to fan around once the candidates are exhausted: Most recent dead-end vertex with live triangles, or the
+	// next such vertex in input order.
+	const auto skip_dead_end = [&]() -> std::int64_t {
+		while (!dead_end_stack.empty()) {
+			const auto d = dead_end_stack.back();
+			dead_end_stack.pop_back();
+			if (live[d] > 0)
+				return d;
+		}
+		for (; cursor < vertex_count; ++cursor) {
+			if (live[cursor] > 0)
+				return cursor;
+		}
+		return -1;
+	};
+
+	std::int64_t fanning = skip_dead_end();
+	if (fanning >= 0)
+		clusters.push_back(0);
+	while (fanning >= 0) {
+		candidates.clear();
+
+		// Emit the fanning vertex's live triangles
+		const auto f = static_cast<std::uint32_t>(fanning);
+		for (auto a = adjacency_offsets[f]; a < adjacency_offsets[f + 1]; ++a) {
+			const auto t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int j = 0; j < 3; ++j) {
+				const auto v = indices[3 * t + j];
+				out.push_back(v);
+				dead_end_stack.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (timestamp - cache_time[v] > cache_size)
+					cache_time[v] = timestamp++;
+			}
+			emitted[t] = true;
+		}
+
+		// Pick the candidate that will stay in cache while its remaining triangles are emitted, and that entered the cache
+		// the earliest.
+		std::int64_t next = -1;
+		std::int64_t best_priority = -1;
+		for (auto v : candidates) {
+			if (live[v] == 0)
+				continue;
+
+			std::int64_t priority = 0;
+			const auto age = static_cast<std::int64_t>(timestamp - cache_time[v]);
+			if (age + 2 * static_cast<std::int64_t>(live[v]) <= static_cast<std::int64_t>(cache_size))
+				priority = age;
+			if (priority > best_priority) {
+				best_priority = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0) {
+			// Dead end, starts a new cluster
+			next = skip_dead_end();
+			if (next >= 0)
+				clusters.push_back(static_cast<std::uint32_t>(out.size()));
+		}
+		fanning = next;
+	}
+
+	return out;
+}
+
+lib::vector<std::uint32_t> mesh_optimizer::sort_clusters(const lib::vector<std::uint32_t> &indices,
+														 const lib::vector<object_vertex_data> &vertices,
+														 const lib::vector<std::uint32_t> &clusters) {
+	struct cluster_t {
+		std::uint32_t start, end;
+		float key;
+	};
+
+	const auto position = [&](std::uint32_t i) { return vertices[i].p().v(); };
+
+	// Area weighted centroids and normals
+	glm::vec3 mesh_centroid{ .0f };
+	float mesh_area = .0f;
+	lib::vector<cluster_t> sorted;
+	lib::vector<glm::vec3> centroids, normals;
+	sorted.reserve(clusters.size());
+	for (std::size_t c = 0; c < clusters.size(); ++c) {
+		const auto start = clusters[c];
+		const auto end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<std::uint32_t>(indices.size());
+
+		glm::vec3 centroid{ .0f }, normal{ .0f };
+		float area = .0f;
+		for (auto i = start; i < end; i += 3) {
+			const auto p0 = position(indices[i + 0]);
+			const auto p1 = position(indices[i + 1]);
+			const auto p2 = position(indices[i + 2]);
+
+			const auto n = glm::cross(p1 - p0, p2 - p0);
+			const auto a = glm::length(n) * .5f;
+			centroid += (p0 + p1 + p2) * (a / 3.f);
+			normal += n;
+			area += a;
+		}
+
+		mesh_centroid += centroid;
+		mesh_area += area;
+		centroids.push_back(area > .0f ? centroid / area : position(indices[start]));
+		normals.push_back(glm::dot(normal, normal) > .0f ? glm::normalize(normal) : glm::vec3{ .0f });
+		sorted.push_back({ start, end, .0f });
+	}
+	if (mesh_area > .0f)
+		mesh_centroid /= mesh_area;
+
+	for (std::size_t c = 0; c < sorted.size(); ++c)
+		sorted[c].key = glm::dot(centroids[c] - mesh_centroid, normals[c]);
+
+	// Outer, outward facing, clusters first. Stable, keeps the result deterministic.
+	std::stable_sort(sorted.begin(), sorted.end(), [](const cluster_t &a, const cluster_t &b) {
+		return a.key > b.key;
+	});
+
+	lib::vector<std::uint32_t> out;
+	out.reserve(indices.size());
+	for (auto &c : sorted)
+		out.insert(out.end(), indices.begin() + c.start, indices.begin() + c.end);
+
+	return out;
+}
+
+void mesh_optimizer::optimize_vertex_cache(lib::vector<std::uint32_t> &indices,
+										   const lib::vector<object_vertex_data> &vertices,
+										   std::uint32_t cache_size,
+										   bool overdraw) {
+	if (indices.size() < 3)
+		return;
+
+	lib::vector<std::uint32_t> clusters;
+	indices = tipsify(indices, static_cast<std::uint32_t>(vertices.size()), cache_size, clusters);
+	if (overdraw && clusters.size() > 1)
+		indices = sort_clusters(indices, vertices, clusters);
+}
+
+void mesh_optimizer::optimize_vertex_fetch(lib::vector<std::uint32_t> &indices,
+										   lib::vector<object_vertex_data> &vertices) {
+	static constexpr auto unmapped = std::numeric_limits<std::uint32_t>::max();
+
+	lib::vector<std::uint32_t> remap(vertices.size(), unmapped);
+	lib::vector<object_vertex_data> out;
+	out.reserve(vertices.size());
+	for (auto &i : indices) {
+		if (remap[i] == unmapped) {
+			remap[i] = static_cast<std::uint32_t>(out.size());
+			out.push_back(vertices[i]);
+		}
+		i = remap[i];
+	}
+
+	vertices = std::move(out);
+}
+
+void mesh_optimizer::optimize(lib::vector<std::uint32_t> &indices,
+							  lib::vector<object_vertex_data> &vertices,
+							  const options &opts,
+							  statistics *before,
+							  statistics *after) {
+	if (before)
+		*before = analyze_vertex_cache(indices, static_cast<std::uint32_t>(vertices.size()), opts.cache_size);
+
+	if (opts.vertex_cache)
+		optimize_vertex_cache(indices, vertices, opts.cache_size, opts.overdraw);
+	if (opts.vertex_fetch)
+		optimize_vertex_fetch(indices, vertices);
+
+	if (after)
+		*after = analyze_vertex_cache(indices, static_cast<std::uint32_t>(vertices.size()), opts.cache_size);
+}
@@ -0,0 +1,113 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <object_vertex_data.hpp>
+
+#include <lib/vector.hpp>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	Triangle list optimizations for the post-transform vertex cache, overdraw and vertex fetch.
+ *
+ *	Triangles are reordered with Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+ *	Reduced Overdraw", 2007). The clusters Tipsify produces, split where it runs into a dead end, can then be sorted
+ *	front-to-back in an outward direction to reduce overdraw. Lastly vertices are reordered by first use.
+ *	All passes are deterministic, CPU-only and run in time linear in the mesh size.
+ */
+class mesh_optimizer {
+public:
+	static constexpr std::uint32_t default_cache_size = 16;
+
+	struct options {
+		bool vertex_cache{ true };
+		bool overdraw{ false };
+		bool vertex_fetch{ true };
+		// Simulated FIFO post-transform cache size, in vertices
+		std::uint32_t cache_size{ default_cache_size };
+
+		/**
+		 *	@brief	Packs the options into a key, used to identify processed meshes
+		 */
+		std::uint32_t key() const {
+			return (vertex_cache ? 1u : 0u) | (overdraw ? 2u : 0u) | (vertex_fetch ? 4u : 0u) | (cache_size << 8);
+		}
+	};
+
+	struct statistics {
+		std::uint64_t triangles{ 0 };
+		std::uint64_t vertices{ 0 };
+		std::uint64_t cache_misses{ 0 };
+
+		// Average cache miss ratio: Transformed vertices per triangle
+		float acmr() const { return triangles ? static_cast<float>(cache_misses) / static_cast<float>(triangles) : .0f; }
+		// Average transform to vertex ratio: Transformed vertices per vertex
+		float atvr() const { return vertices ? static_cast<float>(cache_misses) / static_cast<float>(vertices) : .0f; }
+
+		statistics &operator+=(const statistics &s) {
+			triangles += s.triangles;
+			vertices += s.vertices;
+			cache_misses += s.cache_misses;
+			return *this;
+		}
+	};
+
+private:
+	/**
+	 *	@brief	Tipsify. Returns the reordered indices, and the offsets into them of the clusters' starts.
+	 */
+	static lib::vector<std::uint32_t> tipsify(const lib::vector<std::uint32_t> &indices,
+											  std::uint32_t vertex_count,
+											  std::uint32_t cache_size,
+											  lib::vector<std::uint32_t> &clusters);
+
+	/**
+	 *	@brief	Sorts clusters by the projection of the offset of their centroid from the mesh centroid on their average
+	 *			normal, outer clusters first.
+	 */
+	static lib::vector<std::uint32_t> sort_clusters(const lib::vector<std::uint32_t> &indices,
+													const lib::vector<object_vertex_data> &vertices,
+													const lib::vector<std::uint32_t> &clusters);
+
+public:
+	/**
+	 *	@brief	Simulates a FIFO post-transform vertex cache
+	 */
+	static statistics analyze_vertex_cache(const lib::vector<std::uint32_t> &indices,
+										   std::uint32_t vertex_count,
+										   std::uint32_t cache_size = default_cache_size);
+
+	/**
+	 *	@brief	Reorders triangles for vertex cache locality, and optionally for reduced overdraw
+	 */
+	static void optimize_vertex_cache(lib::vector<std::uint32_t> &indices,
+									  const lib::vector<object_vertex_data> &vertices,
+									  std::uint32_t cache_size = default_cache_size,
+									  bool overdraw = false);
+
+	/**
+	 *	@brief	Reorders vertices by first use in the index buffer and remaps the indices. Unreferenced vertices are removed.
+	 */
+	static void optimize_vertex_fetch(lib::vector<std::uint32_t> &indices,
+									  lib::vector<object_vertex_data> &vertices);
+
+	/**
+	 *	@brief	Runs the passes selected by the options.
+	 *
+	 *	@param	before	Optional. Vertex cache statistics of the input mesh.
+	 *	@param	after	Optional. Vertex cache statistics of the output mesh.
+	 */
+	static void optimize(lib::vector<std::uint32_t> &indices,
+						 lib::vector<object_vertex_data> &vertices,
+						 const options &opts,
+						 statistics *before = nullptr,
+						 statistics *after = nullptr);
+};
+
+}
+}
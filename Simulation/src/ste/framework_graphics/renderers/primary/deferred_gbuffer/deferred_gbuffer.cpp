@@ -14,10 +14,23 @@ gl::framebuffer_layout deferred_gbuffer::create_fbo_layout() {
 	return scene_write_gbuffer_fragment::create_fb_layout();
 }
 
+gl::framebuffer_layout deferred_gbuffer::create_late_fbo_layout() {
+	return scene_write_gbuffer_late_fragment::create_fb_layout();
+}
+
 gl::framebuffer_layout deferred_gbuffer::create_depth_fbo_layout() {
 	return scene_prepopulate_depth_fragment<true>::create_fb_layout();
 }
 
+auto deferred_gbuffer::create_hiz_target(const ste_context &ctx, const glm::uvec2 &extent) {
+	const auto size = hiz_extent(extent);
+	return resource::surface_factory::image_empty_2d<gl::format::r32_sfloat>(ctx,
+																			 gl::image_usage::sampled | gl::image_usage::storage,
+																			 gl::image_layout::shader_read_only_optimal,
+																			 "gbuffer hi-z target",
+																			 size, 1_layers, resource::surface_utilities::max_levels(size));
+}
+
 deferred_gbuffer::deferred_gbuffer(const ste_context &ctx,
 								   const glm::uvec2 &extent,
 								   levels_t depth_levels)
@@ -41,6 +54,8 @@ deferred_gbuffer::deferred_gbuffer(const ste_context &ctx,
 																								  gl::image_layout::shader_read_only_optimal,
 																								  "gbuffer downsampled depth target",
 																								  extent / 2u, 1_layers, depth_buffer_levels)),
+	hiz_target(ctx,
+			   create_hiz_target(ctx, extent)),
 	gbuffer(resource::surface_factory::image_empty_2d<gl::format::r32g32b32a32_sfloat>(ctx,
 																					   gl::image_usage::sampled | gl::image_usage::color_attachment,
 																					   gl::image_layout::color_attachment_optimal,
@@ -56,6 +71,10 @@ deferred_gbuffer::deferred_gbuffer(const ste_context &ctx,
 		"gbuffer framebuffer",
 		create_fbo_layout(), 
 		extent),
+	late_fbo(ctx,
+			 "gbuffer late framebuffer",
+			 create_late_fbo_layout(),
+			 extent),
 	depth_fbo(ctx,
 			  "gbuffer depth framebuffer", 
 			  create_depth_fbo_layout(), 
@@ -69,6 +88,9 @@ deferred_gbuffer::deferred_gbuffer(const ste_context &ctx,
 	fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get(), glm::vec4(.0f));
 	fbo[0] = gl::framebuffer_attachment(gbuffer_level_0);
 	fbo[1] = gl::framebuffer_attachment(gbuffer_level_1);
+	late_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get());
+	late_fbo[0] = gl::framebuffer_attachment(gbuffer_level_0);
+	late_fbo[1] = gl::framebuffer_attachment(gbuffer_level_1);
 
 	depth_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get(), glm::vec4(.0f));
 	depth_backface_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(backface_depth_target.get(), glm::vec4(.0f));
@@ -99,6 +121,8 @@ void deferred_gbuffer::resize(const glm::uvec2 &extent) {
 																																						gl::image_layout::shader_read_only_optimal,
 																																						"gbuffer downsampled depth target",
 																																						extent / 2u, 1_layers, depth_buffer_levels));
+	hiz_target = ste_resource<gl::texture<gl::image_type::image_2d>>(ctx,
+																	 create_hiz_target(ctx, extent));
 	gbuffer = resource::surface_factory::image_empty_2d<gl::format::r32g32b32a32_sfloat>(ctx,
 																						 gl::image_usage::sampled | gl::image_usage::color_attachment,
 																						 gl::image_layout::color_attachment_optimal,
@@ -116,6 +140,10 @@ void deferred_gbuffer::resize(const glm::uvec2 &extent) {
 						  "gbuffer framebuffer",
 						  create_fbo_layout(),
 						  extent);
+	late_fbo = gl::framebuffer(ctx,
+							   "gbuffer late framebuffer",
+							   create_late_fbo_layout(),
+							   extent);
 	depth_fbo = gl::framebuffer(ctx,
 								"gbuffer depth framebuffer",
 								create_depth_fbo_layout(),
@@ -129,6 +157,9 @@ void deferred_gbuffer::resize(const glm::uvec2 &extent) {
 	fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get(), glm::vec4(.0f));
 	fbo[0] = gl::framebuffer_attachment(gbuffer_level_0);
 	fbo[1] = gl::framebuffer_attachment(gbuffer_level_1);
+	late_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get());
+	late_fbo[0] = gl::framebuffer_attachment(gbuffer_level_0);
+	late_fbo[1] = gl::framebuffer_attachment(gbuffer_level_1);
 
 	depth_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(depth_target.get(), glm::vec4(.0f));
 	depth_backface_fbo[gl::pipeline_depth_attachment_location] = gl::framebuffer_attachment(backface_depth_target.get(), glm::vec4(.0f));
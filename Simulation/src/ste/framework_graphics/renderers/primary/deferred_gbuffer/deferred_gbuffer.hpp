@@ -27,20 +27,26 @@ private:
 	ste_resource<gl::texture<gl::image_type::image_2d>> depth_target;
 	ste_resource<gl::texture<gl::image_type::image_2d>> backface_depth_target;
 	ste_resource<gl::texture<gl::image_type::image_2d>> downsampled_depth_target;
+	ste_resource<gl::texture<gl::image_type::image_2d>> hiz_target;
 
 	gl::texture<gl::image_type::image_2d_array> gbuffer;
 	gl::image_view<gl::image_type::image_2d> gbuffer_level_0;
 	gl::image_view<gl::image_type::image_2d> gbuffer_level_1;
 
-	gl::framebuffer fbo, depth_fbo, depth_backface_fbo;
+	gl::framebuffer fbo, late_fbo, depth_fbo, depth_backface_fbo;
 	glm::uvec2 extent;
 
 	mutable signal<> gbuffer_resized_signal;
 
 private:
 	gl::framebuffer_layout create_fbo_layout();
+	gl::framebuffer_layout create_late_fbo_layout();
 	gl::framebuffer_layout create_depth_fbo_layout();
 
+	// Hi-Z pyramid's level 0 is half the depth target's extent, rounded down, with a complete mipmap chain
+	static glm::uvec2 hiz_extent(const glm::uvec2 &extent) { return glm::max(extent / 2u, glm::uvec2(1)); }
+	static auto create_hiz_target(const ste_context &ctx, const glm::uvec2 &extent);
+
 public:
 	deferred_gbuffer(const ste_context &ctx,
 					 const glm::uvec2 &extent,
@@ -66,11 +72,13 @@ public:
 	auto& get_depth_target() const { return depth_target.get(); }
 	auto& get_backface_depth_target() const { return backface_depth_target.get(); }
 	auto& get_downsampled_depth_target() const { return downsampled_depth_target.get(); }
+	auto& get_hiz_target() const { return hiz_target.get(); }
 
 	auto& get_gbuffer_level0() const { return gbuffer_level_0; }
 	auto& get_gbuffer_level1() const { return gbuffer_level_1; }
 
 	auto& get_fbo() { return fbo; }
+	auto& get_late_fbo() { return late_fbo; }
 	auto& get_depth_fbo() { return depth_fbo; }
 	auto& get_depth_backface_fbo() { return depth_backface_fbo; }
 
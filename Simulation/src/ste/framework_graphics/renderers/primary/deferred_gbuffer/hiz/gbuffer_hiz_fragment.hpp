@@ -0,0 +1,114 @@
+//	StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <deferred_gbuffer.hpp>
+#include <fragment_compute.hpp>
+
+#include <task.hpp>
+#include <cmd_dispatch.hpp>
+#include <cmd_pipeline_barrier.hpp>
+
+#include <lib/vector.hpp>
+#include <connection.hpp>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	Builds the gbuffer's Hi-Z pyramid from the depth target, for occlusion culling.
+ *
+ *	The pyramid holds a complete mipmap chain of the farthest depth, every level is reduced from the previous one by a
+ *	dispatch of its own. See gbuffer_hiz.comp.
+ *	Only the barriers between the pyramid's levels are recorded, synchronization with the gbuffer's render passes is left
+ *	to the render graph.
+ */
+class gbuffer_hiz_fragment : public gl::fragment_compute<gbuffer_hiz_fragment> {
+	using Base = gl::fragment_compute<gbuffer_hiz_fragment>;
+
+private:
+	const deferred_gbuffer *gbuffer;
+
+	gl::task<gl::cmd_dispatch> dispatch_task;
+	connection<> gbuffer_depth_target_connection;
+
+	lib::vector<gl::image_view<gl::image_type::image_2d>> hiz_levels;
+
+private:
+	void attach_handles() {
+		auto& hiz = gbuffer->get_hiz_target().get_image();
+		auto levels = hiz.get_mips();
+
+		// Create view of individual levels
+		lib::vector<gl::image_view<gl::image_type::image_2d>> level_views;
+		level_views.reserve(static_cast<std::size_t>(levels));
+		for (auto l = 0_mip; l < levels; ++l)
+			level_views.emplace_back(hiz,
+									 hiz.get_format(),
+									 0_layer, l, 1_mip);
+		hiz_levels = std::move(level_views);
+
+		// Attach to pipeline
+		lib::vector<gl::pipeline::image> level_images;
+		level_images.reserve(static_cast<std::size_t>(levels));
+		for (auto l = 0_mip; l < levels; ++l)
+			level_images.emplace_back(hiz_levels[static_cast<std::size_t>(l)],
+									  gl::image_layout::general);
+
+		pipeline()["levels"] = static_cast<std::size_t>(levels);
+		pipeline()["hiz_levels"] = gl::bind(0, level_images);
+	}
+
+public:
+	gbuffer_hiz_fragment(const gl::rendering_system &rs,
+						 const deferred_gbuffer *gbuffer)
+		: Base(rs,
+			   "gbuffer_hiz.comp"),
+		gbuffer(gbuffer)
+	{
+		dispatch_task.attach_pipeline(pipeline());
+		attach_handles();
+
+		gbuffer_depth_target_connection = make_connection(gbuffer->get_gbuffer_modified_signal(), [this]() {
+			attach_handles();
+		});
+	}
+	~gbuffer_hiz_fragment() noexcept {}
+
+	gbuffer_hiz_fragment(gbuffer_hiz_fragment&&) = default;
+
+	static lib::string name() { return "gbuffer_hiz"; }
+
+	void record(gl::command_recorder &recorder) override final {
+		constexpr int jobs = 16;
+
+		auto& hiz = gbuffer->get_hiz_target().get_image();
+		auto levels = hiz.get_mips();
+
+		for (auto l = 0_mip; l < levels; ++l) {
+			if (l > 0_mip) {
+				// Wait for the previous level
+				recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
+																		  gl::pipeline_stage::compute_shader,
+																		  gl::image_memory_barrier(hiz,
+																								   gl::image_layout::general,
+																								   gl::image_layout::general,
+																								   gl::access_flags::shader_write,
+																								   gl::access_flags::shader_read,
+																								   l - 1_mip, 1_mip,
+																								   0_layer, 1_layers)));
+			}
+
+			auto extent = glm::max(static_cast<glm::ivec2>(hiz.get_extent()) >> static_cast<std::int32_t>(l), glm::ivec2(1));
+			auto workgroup = (extent + glm::ivec2(jobs - 1)) / jobs;
+
+			pipeline()["push_t.level"] = static_cast<std::int32_t>(l);
+			recorder << dispatch_task(workgroup.x, workgroup.y, 1);
+		}
+	}
+};
+
+}
+}
@@ -1,6 +1,8 @@
 ﻿
 #include <stdafx.hpp>
 #include <primary_renderer.hpp>
+#include <primary_renderer_graph.hpp>
+#include <ste_engine_exceptions.hpp>
 #include <host_read_buffer.hpp>
 #include <random>
 
@@ -33,6 +35,31 @@ void primary_renderer_atom(gl::profiler::profiler *profiler,
 	primary_renderer_atom(profiler, recorder, name, gl::pipeline_stage::bottom_of_pipe, std::forward<F>(f));
 }
 
+/**
+ *	@brief	Wraps a render graph pass' recording function with a profiler atom
+ */
+template <typename F>
+auto primary_renderer_pass(gl::profiler::profiler *profiler,
+						   lib::string name,
+						   F &&f) {
+	return [profiler, name = std::move(name), f = std::forward<F>(f)](gl::command_recorder &recorder) {
+		primary_renderer_atom(profiler, recorder, name,
+							  [&]() {
+			f(recorder);
+		});
+	};
+}
+
+/**
+ *	@brief	Wraps the execution of a parallel render graph pass with a profiler atom
+ */
+auto primary_renderer_parallel_pass_scope(gl::profiler::profiler *profiler,
+										  lib::string name) {
+	return [profiler, name = std::move(name)](gl::command_recorder &recorder, const std::function<void()> &execute) {
+		primary_renderer_atom(profiler, recorder, name, execute);
+	};
+}
+
 }
 
 primary_renderer::primary_renderer(const ste_context &ctx,
@@ -76,15 +103,28 @@ primary_renderer::primary_renderer(const ste_context &ctx,
 	downsample_depth(ctx,
 					 *this,
 					 &buffers.gbuffer.get()),
+	hiz(ctx,
+		*this,
+		&buffers.gbuffer.get()),
 	prepopulate_backface_depth(ctx,
 							   *this,
 							   this->s),
 	scene_write_gbuffer(ctx,
 						*this,
 						this->s, &buffers.gbuffer.get()),
+	scene_write_gbuffer_late(ctx,
+							 *this,
+							 this->s, &buffers.gbuffer.get()),
 	scene_geo_cull(ctx,
 				   *this,
-				   this->s, &this->s->properties().lights_storage()),
+				   this->s, &this->s->properties().lights_storage(),
+				   this->cam->get_projection_model(),
+				   scene_geo_cull_phase::early),
+	scene_geo_cull_late(ctx,
+						*this,
+						this->s, &this->s->properties().lights_storage(),
+						this->cam->get_projection_model(),
+						scene_geo_cull_phase::late),
 
 	linked_light_list_generator(ctx,
 								*this,
@@ -92,7 +132,9 @@ primary_renderer::primary_renderer(const ste_context &ctx,
 	light_preprocess(ctx,
 					 *this,
 					 &this->s->properties().lights_storage(),
-					 this->cam->get_projection_model())
+					 this->cam->get_projection_model()),
+
+	graph(ctx)
 {
 	// Attach a connection to swapchain's surface resize signal
 	resize_signal_connection = make_connection(ctx.device().get_queues_and_surface_recreate_signal(), [this, &ctx](auto) {
@@ -103,6 +145,9 @@ primary_renderer::primary_renderer(const ste_context &ctx,
 		// Send resize signal to interested fragments
 		hdr->resize(device().get_surface().extent());
 
+		// Resized resources are recreated, forget their synchronization states
+		graph.reset_resources_states();
+
 		// Reattach resized framebuffers and input images
 		reattach_framebuffers();
 	});
@@ -113,6 +158,8 @@ primary_renderer::primary_renderer(const ste_context &ctx,
 		buffers.invalidate_projection_buffer();
 
 		light_preprocess->update_projection_planes(projection);
+		scene_geo_cull->update_projection_planes(projection);
+		scene_geo_cull_late->update_projection_planes(projection);
 	});
 
 	// Attach framebuffers
@@ -123,6 +170,7 @@ void primary_renderer::reattach_framebuffers() {
 	// Attach gbuffer framebuffers
 	prepopulate_backface_depth->attach_framebuffer(buffers.gbuffer->get_depth_backface_fbo());
 	scene_write_gbuffer->attach_framebuffer(buffers.gbuffer->get_fbo());
+	scene_write_gbuffer_late->attach_framebuffer(buffers.gbuffer->get_late_fbo());
 
 	// Attach composer and hdr outputs
 	composer->attach_framebuffer(framebuffers.hdr_input_fb);
@@ -132,324 +180,133 @@ void primary_renderer::reattach_framebuffers() {
 }
 
 void primary_renderer::update(gl::command_recorder &recorder) {
-	recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::vertex_shader | gl::pipeline_stage::fragment_shader | gl::pipeline_stage::compute_shader,
-															  gl::pipeline_stage::transfer,
-															  gl::buffer_memory_barrier(s->properties().lights_storage().buffer(),
-																						gl::access_flags::shader_read,
-																						gl::access_flags::transfer_write),
-															  gl::buffer_memory_barrier(s->properties().materials_storage().buffer(),
-																						gl::access_flags::shader_read,
-																						gl::access_flags::transfer_write),
-															  gl::buffer_memory_barrier(s->properties().material_layers_storage().buffer(),
-																						gl::access_flags::shader_read,
-																						gl::access_flags::transfer_write),
-															  gl::buffer_memory_barrier(buffers.transform_buffers.get_view_buffer(),
-																						gl::access_flags::shader_read,
-																						gl::access_flags::transfer_write)));
-
 	// Update scene, light storage and objects
 	s->update_scene(recorder);
 
 	// Update buffers
 	buffers.update(recorder, cam);
 
-	recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
-															  gl::pipeline_stage::vertex_shader | gl::pipeline_stage::fragment_shader | gl::pipeline_stage::compute_shader,
-															  gl::buffer_memory_barrier(s->properties().lights_storage().buffer(),
-																						gl::access_flags::transfer_write,
-																						gl::access_flags::shader_read | gl::access_flags::shader_write),
-															  gl::buffer_memory_barrier(s->properties().materials_storage().buffer(),
-																						gl::access_flags::transfer_write,
-																						gl::access_flags::shader_read),
-															  gl::buffer_memory_barrier(s->properties().material_layers_storage().buffer(),
-																						gl::access_flags::transfer_write,
-																						gl::access_flags::shader_read),
-															  gl::buffer_memory_barrier(buffers.transform_buffers.get_view_buffer(),
-																						gl::access_flags::transfer_write,
-																						gl::access_flags::shader_read)));
-
-	// Update atmospheric properties (if needed)
-	auto atmoshperics_update = atmospherics_properties_update.get();
-	if (atmoshperics_update) {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::fragment_shader | gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::transfer,
-																  gl::buffer_memory_barrier(buffers.atmospheric_buffer.get(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::transfer_write)));
-		buffers.update_atmospheric_properties(recorder,
-											  atmoshperics_update.get());
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
-																  gl::pipeline_stage::fragment_shader | gl::pipeline_stage::compute_shader,
-																  gl::buffer_memory_barrier(buffers.atmospheric_buffer.get(),
-																							gl::access_flags::transfer_write,
-																							gl::access_flags::shader_read)));
-	}
-
 	// Update common binding set
 	buffers.update_common_binding_set(s);
 }
 
 void primary_renderer::render(gl::command_recorder &recorder) {
-	// Update data
-	_detail::primary_renderer_atom(profiler, recorder, "update", 
-								   [this, &recorder]() {
-		update(recorder);
-	});
-
-	// Render
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> preprocess_light",
-								   [this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::pipeline_stage::compute_shader,
-																  gl::buffer_memory_barrier(s->properties().lights_storage().get_active_ll(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::shader_read | gl::access_flags::shader_write)));
-	});
-
-	// Light preprocess
-	record_light_preprocess_fragment(recorder);
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> geo_cull",
-								   [this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::compute_shader,
-																  gl::buffer_memory_barrier(s->properties().lights_storage().get_active_ll(),
-																							gl::access_flags::shader_read | gl::access_flags::shader_write,
-																							gl::access_flags::shader_read),
-																  gl::buffer_memory_barrier(s->properties().lights_storage().get_active_ll_counter(),
-																							gl::access_flags::shader_read | gl::access_flags::shader_write,
-																							gl::access_flags::shader_read),
-																  gl::buffer_memory_barrier(s->properties().lights_storage().buffer(),
-																							gl::access_flags::shader_read | gl::access_flags::shader_write,
-																							gl::access_flags::shader_read)));
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::draw_indirect,
-																  gl::pipeline_stage::compute_shader,
-																  gl::buffer_memory_barrier(s->get_idb().get(),
-																							gl::access_flags::indirect_command_read,
-																							gl::access_flags::shader_write)));
-	});
-
-	// Scene geometry cull
-	record_scene_geometry_cull_fragment(recorder);
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> scene",
-								   [this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::draw_indirect,
-																  gl::buffer_memory_barrier(s->get_idb().get(),
-																							gl::access_flags::shader_write,
-																							gl::access_flags::indirect_command_read)));
-	});
-
-	// Draw scene to gbuffer
-	record_scene_fragment(recorder);
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> voxelizer",
-								   [this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::pipeline_stage::compute_shader,
-																  gl::image_memory_barrier(buffers.voxels->voxels_buffer_image().get_image(),
-																						   gl::image_layout::shader_read_only_optimal,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_read,
-																						   gl::access_flags::shader_write)));
-	});
-
-	// Voxelize scene
-	{
-		// TODO: Dynamic voxelization for dynamic parts of the scene
-		static bool voxelized = false;
-		if (!voxelized)
-			record_voxelizer_fragment(recorder);
-		voxelized = true;
+	auto &lights_storage = s->properties().lights_storage();
+	auto &lll_storage = buffers.linked_light_list_storage.get();
+	const bool occlusion_culling = this->occlusion_culling.load(std::memory_order_relaxed);
+
+	using graph_t = primary_renderer_graph;
+
+	// Without occlusion culling the early phase emits all visible clusters and the late phase is disabled
+	scene_geo_cull->set_occlusion_culling(occlusion_culling);
+
+	// Atmospheric properties are updated only if modified
+	auto atmospherics_update = atmospherics_properties_update.get();
+	// TODO: Dynamic voxelization for dynamic parts of the scene
+	static bool voxelized = false;
+
+	const auto declarations = graph_t::declare({ atmospherics_update != none, !voxelized, occlusion_culling });
+	voxelized = true;
+
+	// Import the resources tracked by the render graph
+	auto import_resource = [&](graph_t::resource r) {
+		switch (r) {
+		case graph_t::lights:				return graph.import_buffer(lights_storage.buffer());
+		case graph_t::active_ll:			return graph.import_buffer(lights_storage.get_active_ll());
+		case graph_t::active_ll_counter:	return graph.import_buffer(lights_storage.get_active_ll_counter());
+		case graph_t::materials:			return graph.import_buffer(s->properties().materials_storage().buffer());
+		case graph_t::material_layers:		return graph.import_buffer(s->properties().material_layers_storage().buffer());
+		case graph_t::view_buffer:			return graph.import_buffer(buffers.transform_buffers.get_view_buffer());
+		case graph_t::atmospheric_buffer:	return graph.import_buffer(buffers.atmospheric_buffer.get());
+		case graph_t::idb:					return graph.import_buffer(s->get_idb().get());
+		case graph_t::backface_idb:			return graph.import_buffer(s->get_backface_idb().get());
+		case graph_t::late_idb:				return graph.import_buffer(s->get_late_idb().get());
+		case graph_t::idb_counters:			return graph.import_buffer(s->get_idb_counters());
+		case graph_t::cluster_visibility:	return graph.import_buffer(s->get_cluster_visibility());
+		case graph_t::voxels:				return graph.import_image(buffers.voxels->voxels_buffer_image().get_image());
+		case graph_t::voxel_assembly_list:	return graph.import_buffer(buffers.voxels->voxel_assembly_list_buffer());
+		case graph_t::downsampled_depth:	return graph.import_image(buffers.gbuffer.get().get_downsampled_depth_target().get_image());
+		case graph_t::hiz_pyramid:			return graph.import_image(buffers.gbuffer.get().get_hiz_target().get_image());
+		case graph_t::depth_target:			return graph.import_image(buffers.gbuffer.get().get_depth_target().get_image());
+		case graph_t::gbuffer_image:		return graph.import_image(buffers.gbuffer.get().get_gbuffer().get_image());
+		case graph_t::lll:					return graph.import_buffer(lll_storage.linked_light_lists_buffer());
+		case graph_t::lll_counter:			return graph.import_buffer(lll_storage.linked_light_lists_counter_buffer());
+		case graph_t::lll_heads:			return graph.import_image(lll_storage.linked_light_lists_heads_map().get_image());
+		case graph_t::lll_size:				return graph.import_image(lll_storage.linked_light_lists_size_map().get_image());
+		default:
+			throw ste_engine_exception("Unknown render graph resource");
+		}
+	};
+	lib::vector<gl::render_graph::resource> resources;
+	resources.reserve(graph_t::resources_count);
+	for (std::uint32_t r = 0; r < graph_t::resources_count; ++r)
+		resources.push_back(import_resource(static_cast<graph_t::resource>(r)));
+
+	// Passes' recording functions
+	auto pass_record_func = [&](graph_t::pass p) -> gl::render_graph::record_func_t {
+		switch (p) {
+		case graph_t::update:
+			return [this](auto &recorder) { update(recorder); };
+		case graph_t::update_atmospherics:
+			return [this, atmospherics_update](auto &recorder) {
+				buffers.update_atmospheric_properties(recorder,
+													  atmospherics_update.get());
+			};
+		case graph_t::clear_ll:
+			return [this](auto &recorder) { s->properties().lights_storage().clear_active_ll(recorder); };
+		case graph_t::preprocess_light:
+			return [this](auto &recorder) { recorder << light_preprocess.get(); };
+		case graph_t::clear_idb:
+			return [this](auto &recorder) { scene_geo_cull->clear_idbs(recorder); };
+		case graph_t::geo_cull:
+			return [this](auto &recorder) { recorder << scene_geo_cull.get(); };
+		case graph_t::gbuffer:
+			return [this](auto &recorder) { recorder << scene_write_gbuffer.get(); };
+		case graph_t::hiz:
+			return [this](auto &recorder) { recorder << hiz.get(); };
+		case graph_t::geo_cull_late:
+			return [this](auto &recorder) { recorder << scene_geo_cull_late.get(); };
+		case graph_t::gbuffer_late:
+			return [this](auto &recorder) { recorder << scene_write_gbuffer_late.get(); };
+		case graph_t::voxelizer:
+			return [this](auto &recorder) { recorder << voxelizer.get(); };
+		case graph_t::downsample_depth:
+			return [this](auto &recorder) { recorder << downsample_depth.get(); };
+		case graph_t::clear_lll:
+			return [this](auto &recorder) { buffers.linked_light_list_storage.get().clear(recorder); };
+		case graph_t::lll_gen:
+			return [this](auto &recorder) { recorder << linked_light_list_generator.get(); };
+		case graph_t::backface_depth:
+			return [this](auto &recorder) { recorder << prepopulate_backface_depth.get(); };
+		case graph_t::deferred:
+			return [this](auto &recorder) { recorder << composer.get(); };
+		case graph_t::hdr:
+			return [this](auto &recorder) { recorder << hdr.get(); };
+		case graph_t::fxaa:
+			return [this](auto &recorder) { recorder << fxaa.get(); };
+		default:
+			throw ste_engine_exception("Unknown render graph pass");
+		}
+	};
+
+	// Add the passes, in submission order. Parallel passes are profiled around the execution of their secondary buffers.
+	for (std::uint32_t p = 0; p < graph_t::passes_count; ++p) {
+		auto &declaration = declarations[p];
+		auto f = pass_record_func(static_cast<graph_t::pass>(p));
+
+		if (declaration.parallel) {
+			graph.add_pass(std::move(f))
+				.declare(declaration.usages, resources)
+				.parallel(_detail::primary_renderer_parallel_pass_scope(profiler, declaration.name));
+		}
+		else {
+			graph.add_pass(_detail::primary_renderer_pass(profiler, declaration.name, std::move(f)))
+				.declare(declaration.usages, resources);
+		}
 	}
 
-	_detail::primary_renderer_atom(profiler, recorder, "-> downsample_depth",
-								   [this, &recorder]() {
-		// TODO: Event
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::compute_shader,
-																  gl::image_memory_barrier(buffers.gbuffer.get().get_downsampled_depth_target().get_image(),
-																						   gl::image_layout::shader_read_only_optimal,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_read,
-																						   gl::access_flags::shader_write)));
-	});
-
-	// Downsample depth
-	record_downsample_depth_fragment(recorder);
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> lll",
-								   [this, &recorder]() {
-		// TODO: Event
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::pipeline_stage::compute_shader,
-																  gl::image_memory_barrier(buffers.gbuffer.get().get_downsampled_depth_target().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::shader_read_only_optimal,
-																						   gl::access_flags::shader_write,
-																						   gl::access_flags::shader_read),
-																  gl::buffer_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_buffer(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::shader_write),
-																  gl::image_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_heads_map().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_read,
-																						   gl::access_flags::shader_read | gl::access_flags::shader_write),
-																  gl::image_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_size_map().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_read,
-																						   gl::access_flags::shader_read | gl::access_flags::shader_write)));
-	});
-
-	// Linked-light-list generator
-	record_linked_light_list_generator_fragment(recorder);
-
-	// Prepopulate back-face depth buffer
-	record_prepopulate_depth_backface_fragment(recorder);
-
-	_detail::primary_renderer_atom(profiler, recorder, "-> deferred",
-								   [this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::buffer_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_buffer(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::shader_write)));
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::image_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_heads_map().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_write,
-																						   gl::access_flags::shader_read),
-																  gl::image_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_size_map().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::general,
-																						   gl::access_flags::shader_write,
-																						   gl::access_flags::shader_read)));
-
-		// TODO: Event
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader,
-																  gl::pipeline_stage::fragment_shader,
-																  gl::image_memory_barrier(buffers.voxels->voxels_buffer_image().get_image(),
-																						   gl::image_layout::general,
-																						   gl::image_layout::shader_read_only_optimal,
-																						   gl::access_flags::shader_write,
-																						   gl::access_flags::shader_read)));
-	});
-
-	// Deferred compose
-	record_deferred_composer_fragment(recorder);
-
-	// Post-process, HDR tonemapping and FXAA
-	_detail::primary_renderer_atom(profiler, recorder, "hdr",
-								   [this, &recorder]() {
-		recorder << hdr.get();
-	});
-	_detail::primary_renderer_atom(profiler, recorder, "fxaa",
-								   [this, &recorder]() {
-		recorder << fxaa.get();
-	});
+	graph.record(recorder);
 
 	if (profiler)
 		profiler->end_segment();
 }
-
-void primary_renderer::record_light_preprocess_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "clear ll",
-								   [this, &recorder]() {
-		// Clear ll counter
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::pipeline_stage::transfer,
-																  gl::buffer_memory_barrier(s->properties().lights_storage().get_active_ll_counter(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::transfer_write)));
-		s->properties().lights_storage().clear_active_ll(recorder);
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
-																  gl::pipeline_stage::compute_shader,
-																  gl::buffer_memory_barrier(s->properties().lights_storage().get_active_ll_counter(),
-																							gl::access_flags::transfer_write,
-																							gl::access_flags::shader_read | gl::access_flags::shader_write)));
-	});
-
-	// Preprocess lights
-	_detail::primary_renderer_atom(profiler, recorder, "preprocess_light",
-								   [this, &recorder]() {
-		recorder << light_preprocess.get();
-	});
-}
-
-void primary_renderer::record_scene_geometry_cull_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "geo_cull",
-								   [this, &recorder]() {
-		recorder << scene_geo_cull.get();
-	});
-}
-
-void primary_renderer::record_voxelizer_fragment(gl::command_recorder &recorder) {
-	// Voxelize
-	_detail::primary_renderer_atom(profiler, recorder, "voxelizer",
-									[this, &recorder]() {
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																  gl::pipeline_stage::fragment_shader,
-																  gl::buffer_memory_barrier(buffers.voxels->voxel_assembly_list_buffer(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::shader_write)));
-		recorder << voxelizer.get();
-	});
-}
-
-void primary_renderer::record_downsample_depth_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "downsample_depth",
-								   [this, &recorder]() {
-		recorder << downsample_depth.get();
-	});
-}
-
-void primary_renderer::record_linked_light_list_generator_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "clear lll",
-									[this, &recorder]() {
-		// Clear lll counter
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																	gl::pipeline_stage::transfer,
-																	gl::buffer_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_counter_buffer(),
-																							gl::access_flags::shader_read,
-																							gl::access_flags::transfer_write)));
-		buffers.linked_light_list_storage.get().clear(recorder);
-		recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
-																	gl::pipeline_stage::compute_shader | gl::pipeline_stage::fragment_shader,
-																	gl::buffer_memory_barrier(buffers.linked_light_list_storage.get().linked_light_lists_counter_buffer(),
-																							gl::access_flags::transfer_write,
-																							gl::access_flags::shader_read | gl::access_flags::shader_write)));
-	});
-
-	// Preprocess lights
-	_detail::primary_renderer_atom(profiler, recorder, "lll",
-									[this, &recorder]() {
-		recorder << linked_light_list_generator.get();
-	});
-}
-
-void primary_renderer::record_scene_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "gbuffer",
-								   [this, &recorder]() {
-		recorder << scene_write_gbuffer.get();
-	});
-}
-
-void primary_renderer::record_prepopulate_depth_backface_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "backface_depth",
-								   [this, &recorder]() {
-		recorder << prepopulate_backface_depth.get();
-	});
-}
-
-void primary_renderer::record_deferred_composer_fragment(gl::command_recorder &recorder) {
-	_detail::primary_renderer_atom(profiler, recorder, "deferred",
-								   [this, &recorder]() {
-		recorder << composer.get();
-	});
-}
@@ -8,6 +8,7 @@
 #include <ste_resource.hpp>
 
 #include <rendering_system.hpp>
+#include <render_graph.hpp>
 #include <pipeline_external_binding_set.hpp>
 
 #include <scene.hpp>
@@ -26,12 +27,14 @@
 #include <linked_light_lists_gen_fragment.hpp>
 #include <light_preprocessor_fragment.hpp>
 #include <gbuffer_downsample_depth_fragment.hpp>
+#include <gbuffer_hiz_fragment.hpp>
 
 #include <profiler.hpp>
 
 #include <signal.hpp>
 #include <optional.hpp>
 #include <mutex>
+#include <atomic>
 
 namespace ste {
 namespace graphics {
@@ -82,15 +85,22 @@ private:
 	ste_resource<voxel_sparse_voxelizer> voxelizer;
 
 	ste_resource<gbuffer_downsample_depth_fragment> downsample_depth;
+	ste_resource<gbuffer_hiz_fragment> hiz;
 	ste_resource<scene_prepopulate_depth_back_face_fragment> prepopulate_backface_depth;
 	ste_resource<scene_write_gbuffer_fragment> scene_write_gbuffer;
+	ste_resource<scene_write_gbuffer_late_fragment> scene_write_gbuffer_late;
 	ste_resource<scene_geo_cull_fragment> scene_geo_cull;
+	ste_resource<scene_geo_cull_fragment> scene_geo_cull_late;
 
 	ste_resource<linked_light_lists_gen_fragment> linked_light_list_generator;
 	ste_resource<light_preprocessor_fragment> light_preprocess;
 
 private:
 	atmospherics_properties_update_t atmospherics_properties_update;
+	std::atomic<bool> occlusion_culling{ true };
+
+	// Fragments are recorded as render graph passes, the graph infers the barriers between them
+	gl::render_graph graph;
 
 private:
 	void reattach_framebuffers();
@@ -100,19 +110,6 @@ private:
 	 */
 	void update(gl::command_recorder &recorder);
 
-	/*
-	 *	Fragments' recording methods
-	 */
-
-	void record_light_preprocess_fragment(gl::command_recorder &recorder);
-	void record_scene_geometry_cull_fragment(gl::command_recorder &recorder);
-	void record_voxelizer_fragment(gl::command_recorder &recorder);
-	void record_downsample_depth_fragment(gl::command_recorder &recorder);
-	void record_linked_light_list_generator_fragment(gl::command_recorder &recorder);
-	void record_scene_fragment(gl::command_recorder &recorder);
-	void record_prepopulate_depth_backface_fragment(gl::command_recorder &recorder);
-	void record_deferred_composer_fragment(gl::command_recorder &recorder);
-	
 public:
 	primary_renderer(const ste_context &ctx,
 					 gl::framebuffer_layout &&fb_layout,
@@ -150,6 +147,14 @@ public:
 	*/
 	void set_gamma(float gamma) { hdr->set_gamma(gamma); }
 
+	/**
+	*	@brief	Enables or disables two-phase occlusion culling of the scene geometry. Defaults to enabled.
+	*
+	*			The clusters that were visible in the last frame are drawn first, the rest are then tested against the Hi-Z
+	*			pyramid of the resulting depth, and the visible ones are drawn.
+	*/
+	void set_occlusion_culling(bool enabled) { occlusion_culling.store(enabled, std::memory_order_relaxed); }
+
 	/*
 	 *	@brief		Attaches output framebuffer
 	 */
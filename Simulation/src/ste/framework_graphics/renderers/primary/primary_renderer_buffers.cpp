@@ -41,6 +41,7 @@ void primary_renderer_buffers::common_binding_set_bind_mesh_and_materials() {
 	// Mesh and material bindings
 	common_binding_set_collection["mesh_descriptors_binding"] = gl::bind(s->get_object_group().get_draw_buffers().get_mesh_data_buffer());
 	common_binding_set_collection["mesh_draw_params_binding"] = gl::bind(s->get_object_group().get_draw_buffers().get_mesh_draw_params_buffer());
+	common_binding_set_collection["mesh_clusters_binding"] = gl::bind(s->get_object_group().get_draw_buffers().get_mesh_clusters_buffer());
 	common_binding_set_collection["material_descriptors_binding"] = gl::bind(s->properties().materials_storage().buffer());
 	common_binding_set_collection["material_layer_descriptors_binding"] = gl::bind(s->properties().material_layers_storage().buffer());
 	common_binding_set_collection["material_sampler"] = gl::bind(ctx.get().device().common_samplers_collection().linear_mipmap_anisotropic16_sampler());
@@ -72,6 +73,8 @@ void primary_renderer_buffers::common_binding_set_bind_gbuffer() {
 																							   ctx.get().device().common_samplers_collection().linear_sampler()));
 	common_binding_set_collection["backface_depth_map"] = gl::bind(gl::pipeline::combined_image_sampler(gbuffer.get().get_backface_depth_target(),
 																										ctx.get().device().common_samplers_collection().linear_sampler()));
+	common_binding_set_collection["hiz_map"] = gl::bind(gl::pipeline::combined_image_sampler(gbuffer.get().get_hiz_target(),
+																							 ctx.get().device().common_samplers_collection().nearest_clamp_sampler()));
 	common_binding_set_collection["gbuffer"] = gl::bind(gl::pipeline::combined_image_sampler(gbuffer.get().get_gbuffer(),
 																							 ctx.get().device().common_samplers_collection().nearest_clamp_sampler()));
 }
@@ -111,6 +114,9 @@ void primary_renderer_buffers::update_common_binding_set(scene *s) {
 
 void primary_renderer_buffers::update(gl::command_recorder &recorder,
 									  const camera_t *cam) {
+	// Swap in streamed atmospherics LUTs, if ready
+	atmospherics_luts->update();
+
 	// Upload new camera transform data
 	transform_buffers.update_view_data(recorder, *cam);
 
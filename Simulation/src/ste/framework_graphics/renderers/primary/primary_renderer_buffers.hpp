@@ -46,6 +46,7 @@ private:
 
 	connection<> gbuffer_depth_target_connection;
 	connection<> lll_storage_connection;
+	connection<> atmospherics_luts_connection;
 
 	glm::uvec2 extent;
 	std::atomic_flag projection_data_up_to_date_flag;
@@ -107,6 +108,10 @@ public:
 		lll_storage_connection = make_connection(linked_light_list_storage->get_storage_modified_signal(), [&]() {
 			common_binding_set_bind_lll_buffers();
 		});
+		// Atmospherics LUTs are swapped in once streamed
+		atmospherics_luts_connection = make_connection(this->atmospherics_luts->get_storage_modified_signal(), [this]() {
+			common_binding_set_bind_atmospheric_buffers();
+		});
 	}
 	~primary_renderer_buffers() noexcept {}
 
@@ -0,0 +1,249 @@
+
+#include <stdafx.hpp>
+#include <primary_renderer_graph.hpp>
+
+using namespace ste;
+using namespace ste::graphics;
+using namespace ste::gl;
+
+namespace {
+
+render_graph_compiler::usage read(primary_renderer_graph::resource r,
+								  pipeline_stage stages,
+								  access_flags access,
+								  image_layout layout = image_layout::undefined) {
+	return { r, stages, access, layout, false };
+}
+render_graph_compiler::usage write(primary_renderer_graph::resource r,
+								   pipeline_stage stages,
+								   access_flags access,
+								   image_layout layout = image_layout::undefined) {
+	return { r, stages, access, layout, true };
+}
+
+const char *resource_names[] = {
+	"lights",
+	"active_ll",
+	"active_ll_counter",
+	"materials",
+	"material_layers",
+	"view_buffer",
+	"atmospheric_buffer",
+	"idb",
+	"backface_idb",
+	"late_idb",
+	"idb_counters",
+	"cluster_visibility",
+	"voxels",
+	"voxel_assembly_list",
+	"downsampled_depth",
+	"hiz_pyramid",
+	"depth_target",
+	"gbuffer_image",
+	"lll",
+	"lll_counter",
+	"lll_heads",
+	"lll_size",
+};
+static_assert(sizeof(resource_names) / sizeof(resource_names[0]) == primary_renderer_graph::resources_count);
+
+}
+
+const char *primary_renderer_graph::resource_name(resource r) {
+	return resource_names[r];
+}
+
+lib::vector<primary_renderer_graph::pass_declaration> primary_renderer_graph::declare(const frame_state &frame) {
+	const auto transfer = pipeline_stage::transfer;
+	const auto compute = pipeline_stage::compute_shader;
+	const auto vertex = pipeline_stage::vertex_shader;
+	const auto fragment = pipeline_stage::fragment_shader;
+	const auto fragment_tests = pipeline_stage::early_fragment_tests | pipeline_stage::late_fragment_tests;
+	const auto transfer_write = access_flags::transfer_write;
+	const auto shader_read = access_flags::shader_read;
+	const auto shader_write = access_flags::shader_write;
+	const auto shader_read_write = access_flags::shader_read | access_flags::shader_write;
+	const auto depth_read_write = access_flags::depth_stencil_attachment_read | access_flags::depth_stencil_attachment_write;
+	const auto shader_read_only = image_layout::shader_read_only_optimal;
+
+	lib::vector<pass_declaration> passes(passes_count);
+
+	// Update data
+	passes[update] = { "update", false };
+	passes[update].usages.usages = {
+		write(lights, transfer, transfer_write),
+		write(materials, transfer, transfer_write),
+		write(material_layers, transfer, transfer_write),
+		write(view_buffer, transfer, transfer_write),
+	};
+	passes[update].usages.side_effects = true;
+
+	// Update atmospheric properties (if needed)
+	passes[update_atmospherics] = { "update_atmospherics", false };
+	passes[update_atmospherics].usages.usages = {
+		write(atmospheric_buffer, transfer, transfer_write),
+	};
+	passes[update_atmospherics].usages.side_effects = true;
+	passes[update_atmospherics].usages.enabled = frame.atmospherics_update;
+
+	// Light preprocess
+	// The compute passes that follow the updates and precede the render passes are recorded in parallel.
+	passes[clear_ll] = { "clear ll", true };
+	passes[clear_ll].usages.usages = {
+		write(active_ll_counter, transfer, transfer_write),
+	};
+	passes[preprocess_light] = { "preprocess_light", true };
+	passes[preprocess_light].usages.usages = {
+		write(active_ll, compute, shader_read_write),
+		write(active_ll_counter, compute, shader_read_write),
+		write(lights, compute, shader_read_write),
+		read(view_buffer, compute, shader_read),
+		read(atmospheric_buffer, compute, shader_read),
+	};
+
+	// Scene geometry cull, early phase
+	passes[clear_idb] = { "clear idb", true };
+	passes[clear_idb].usages.usages = {
+		write(idb, transfer, transfer_write),
+		write(backface_idb, transfer, transfer_write),
+		write(late_idb, transfer, transfer_write),
+		write(idb_counters, transfer, transfer_write),
+		write(cluster_visibility, transfer, transfer_write),
+	};
+	passes[geo_cull] = { "geo_cull", true };
+	passes[geo_cull].usages.usages = {
+		read(active_ll, compute, shader_read),
+		read(active_ll_counter, compute, shader_read),
+		read(lights, compute, shader_read),
+		read(view_buffer, compute, shader_read),
+		read(cluster_visibility, compute, shader_read),
+		write(idb, compute, shader_write),
+		write(backface_idb, compute, shader_write),
+		write(idb_counters, compute, shader_read_write),
+	};
+
+	// Draw scene to gbuffer. The render pass leaves the attachments in shader_read_only_optimal layout.
+	passes[gbuffer] = { "gbuffer", false };
+	passes[gbuffer].usages.usages = {
+		read(idb, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(idb_counters, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(view_buffer, vertex, shader_read),
+		read(materials, fragment, shader_read),
+		read(material_layers, fragment, shader_read),
+		write(depth_target, fragment_tests, depth_read_write, shader_read_only),
+		write(gbuffer_image, pipeline_stage::color_attachment_output, access_flags::color_attachment_write, shader_read_only),
+	};
+	passes[gbuffer].usages.side_effects = true;
+
+	// Occlusion culling: Build Hi-Z pyramid from the early phase's depth, cull the remaining clusters against it and draw
+	// the visible ones.
+	passes[hiz] = { "hiz", true };
+	passes[hiz].usages.usages = {
+		read(depth_target, compute, shader_read, shader_read_only),
+		write(hiz_pyramid, compute, shader_read_write, image_layout::general),
+	};
+	passes[hiz].usages.enabled = frame.occlusion_culling;
+	passes[geo_cull_late] = { "geo_cull_late", true };
+	passes[geo_cull_late].usages.usages = {
+		read(hiz_pyramid, compute, shader_read, shader_read_only),
+		read(active_ll, compute, shader_read),
+		read(active_ll_counter, compute, shader_read),
+		read(lights, compute, shader_read),
+		read(view_buffer, compute, shader_read),
+		write(cluster_visibility, compute, shader_read_write),
+		write(late_idb, compute, shader_write),
+		write(idb_counters, compute, shader_read_write),
+	};
+	passes[geo_cull_late].usages.enabled = frame.occlusion_culling;
+	passes[gbuffer_late] = { "gbuffer_late", false };
+	passes[gbuffer_late].usages.usages = {
+		read(late_idb, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(idb_counters, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(view_buffer, vertex, shader_read),
+		read(materials, fragment, shader_read),
+		read(material_layers, fragment, shader_read),
+		// Continues the early phase's render
+		write(depth_target, fragment_tests, depth_read_write, shader_read_only),
+		write(gbuffer_image, pipeline_stage::color_attachment_output, access_flags::color_attachment_read | access_flags::color_attachment_write, shader_read_only),
+	};
+	passes[gbuffer_late].usages.side_effects = true;
+	passes[gbuffer_late].usages.enabled = frame.occlusion_culling;
+
+	// Voxelize scene
+	passes[voxelizer] = { "voxelizer", false };
+	passes[voxelizer].usages.usages = {
+		write(voxels, compute, shader_write, image_layout::general),
+		write(voxel_assembly_list, fragment | compute, shader_read_write),
+		read(view_buffer, vertex, shader_read),
+		read(materials, pipeline_stage::geometry_shader | fragment, shader_read),
+		read(material_layers, pipeline_stage::geometry_shader | fragment, shader_read),
+	};
+	passes[voxelizer].usages.enabled = frame.voxelize;
+
+	// Downsample depth
+	passes[downsample_depth] = { "downsample_depth", true };
+	passes[downsample_depth].usages.usages = {
+		read(depth_target, compute, shader_read, shader_read_only),
+		write(downsampled_depth, compute, shader_write, image_layout::general),
+	};
+
+	// Linked-light-list generator
+	passes[clear_lll] = { "clear lll", true };
+	passes[clear_lll].usages.usages = {
+		write(lll_counter, transfer, transfer_write),
+	};
+	passes[lll_gen] = { "lll", true };
+	passes[lll_gen].usages.usages = {
+		read(downsampled_depth, compute, shader_read, shader_read_only),
+		read(depth_target, compute, shader_read, shader_read_only),
+		write(lll, compute, shader_write),
+		write(lll_counter, compute, shader_read_write),
+		write(lll_heads, compute, shader_read_write, image_layout::general),
+		write(lll_size, compute, shader_read_write, image_layout::general),
+		read(active_ll, compute, shader_read),
+		read(active_ll_counter, compute, shader_read),
+		read(lights, compute, shader_read),
+		read(view_buffer, compute, shader_read),
+	};
+
+	// Prepopulate back-face depth buffer
+	passes[backface_depth] = { "backface_depth", false };
+	passes[backface_depth].usages.usages = {
+		read(backface_idb, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(idb_counters, pipeline_stage::draw_indirect, access_flags::indirect_command_read),
+		read(view_buffer, vertex, shader_read),
+		read(materials, fragment, shader_read),
+		read(material_layers, fragment, shader_read),
+	};
+	passes[backface_depth].usages.side_effects = true;
+
+	// Deferred compose
+	passes[deferred] = { "deferred", false };
+	passes[deferred].usages.usages = {
+		read(lll, fragment, shader_read),
+		read(lll_heads, fragment, shader_read, image_layout::general),
+		read(lll_size, fragment, shader_read, image_layout::general),
+		read(voxels, fragment, shader_read, shader_read_only),
+		read(downsampled_depth, fragment, shader_read, shader_read_only),
+		read(depth_target, fragment, shader_read, shader_read_only),
+		read(gbuffer_image, fragment, shader_read, shader_read_only),
+		read(lights, fragment, shader_read),
+		read(materials, fragment, shader_read),
+		read(material_layers, fragment, shader_read),
+		read(view_buffer, fragment, shader_read),
+		read(atmospheric_buffer, fragment, shader_read),
+	};
+	passes[deferred].usages.side_effects = true;
+
+	// Post-process, HDR tonemapping and FXAA
+	passes[hdr] = { "hdr", false };
+	passes[hdr].usages.usages = {
+		read(view_buffer, fragment | compute, shader_read),
+		read(depth_target, fragment | compute, shader_read, shader_read_only),
+	};
+	passes[hdr].usages.side_effects = true;
+	passes[fxaa] = { "fxaa", false };
+	passes[fxaa].usages.side_effects = true;
+
+	return passes;
+}
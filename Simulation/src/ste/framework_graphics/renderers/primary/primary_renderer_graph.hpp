@@ -0,0 +1,101 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <render_graph_compiler.hpp>
+
+#include <lib/vector.hpp>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	Declares primary_renderer's render graph: The resources tracked by the graph, the passes, in submission order,
+ *			and the resources each pass reads and writes.
+ *
+ *	The declaration refers to resources and passes by index and holds no device objects. primary_renderer imports the
+ *	resources and supplies the passes' recording functions, the ste_tests tool compiles the same declaration and checks the
+ *	resulting plans.
+ */
+class primary_renderer_graph {
+public:
+	enum resource : std::uint32_t {
+		lights,
+		active_ll,
+		active_ll_counter,
+		materials,
+		material_layers,
+		view_buffer,
+		atmospheric_buffer,
+		idb,
+		backface_idb,
+		late_idb,
+		idb_counters,
+		cluster_visibility,
+		voxels,
+		voxel_assembly_list,
+		downsampled_depth,
+		hiz_pyramid,
+		depth_target,
+		gbuffer_image,
+		lll,
+		lll_counter,
+		lll_heads,
+		lll_size,
+
+		resources_count
+	};
+
+	enum pass : std::uint32_t {
+		update,
+		update_atmospherics,
+		clear_ll,
+		preprocess_light,
+		clear_idb,
+		geo_cull,
+		gbuffer,
+		hiz,
+		geo_cull_late,
+		gbuffer_late,
+		voxelizer,
+		downsample_depth,
+		clear_lll,
+		lll_gen,
+		backface_depth,
+		deferred,
+		hdr,
+		fxaa,
+
+		passes_count
+	};
+
+	/**
+	 *	@brief	Frame state that enables or disables passes
+	 */
+	struct frame_state {
+		bool atmospherics_update;
+		bool voxelize;
+		bool occlusion_culling;
+	};
+
+	struct pass_declaration {
+		// Pass name, used for profiling
+		const char *name;
+		// Pass is recorded in parallel, see render_graph::pass_builder::parallel()
+		bool parallel;
+		gl::render_graph_compiler::pass usages;
+	};
+
+public:
+	static const char *resource_name(resource r);
+
+	/**
+	 *	@brief	Declares the graph's passes for a frame, indexed by pass.
+	 */
+	static lib::vector<pass_declaration> declare(const frame_state &frame);
+};
+
+}
+}
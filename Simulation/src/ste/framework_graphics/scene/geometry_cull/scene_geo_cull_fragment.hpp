@@ -9,10 +9,29 @@
 
 #include <scene.hpp>
 #include <light_storage.hpp>
+#include <primary_renderer_camera.hpp>
 
 namespace ste {
 namespace graphics {
 
+/**
+ *	@brief	Cull phase, see scene_geo_cull_fragment.
+ */
+enum class scene_geo_cull_phase : std::int32_t {
+	early = 0,
+	late = 1,
+};
+
+/**
+ *	@brief	Culls the scene's clusters against the view frustum, the normal cones and the active lights' ranges, and emits compacted
+ *			indirect draws of the visible clusters into the scene's indirect draw buffers: Clusters with front-facing triangles
+ *			into the idb, and clusters with back-facing triangles into the back-face idb.
+ *
+ *			With occlusion culling, the cull runs in two phases. The early phase emits into the idb only the clusters that were
+ *			visible in the last frame. Once those are drawn and the Hi-Z pyramid is built, the late phase tests the clusters
+ *			against the pyramid, emits the visible clusters that were not drawn by the early phase into the late idb, and
+ *			updates the clusters visibility for the next frame.
+ */
 class scene_geo_cull_fragment : public gl::fragment_compute<scene_geo_cull_fragment> {
 	using Base = gl::fragment_compute<scene_geo_cull_fragment>;
 
@@ -21,13 +40,14 @@ private:
 
 	scene *s;
 	const light_storage *ls;
-	std::size_t old_object_group_size{ 0 };
+	scene_geo_cull_phase phase;
+	std::size_t old_cluster_count{ 0 };
 
 private:
 	void commit_idbs(gl::command_recorder &recorder) {
-		auto size = s->get_object_group().draw_count();
-		if (size != old_object_group_size) {
-			old_object_group_size = size;
+		auto size = s->get_object_group().cluster_count();
+		if (size != old_cluster_count) {
+			old_cluster_count = size;
 			s->resize_indirect_command_buffers(get_creating_context(), 
 											   recorder, 
 											   size);
@@ -37,13 +57,24 @@ private:
 public:
 	scene_geo_cull_fragment(const gl::rendering_system &rs,
 							scene *s,
-							const light_storage *ls)
+							const light_storage *ls,
+							const primary_renderer_camera::projection_model_t &camera_projection,
+							scene_geo_cull_phase phase = scene_geo_cull_phase::early)
 		: Base(rs,
 			   "scene_geo_cull.comp"),
 		s(s),
-		ls(ls)
+		ls(ls),
+		phase(phase)
 	{
+		update_projection_planes(camera_projection);
+		set_occlusion_culling(true);
+
+		pipeline()["phase"] = static_cast<std::int32_t>(phase);
 		pipeline()["idb_data"] = gl::bind(s->get_idb().get());
+		pipeline()["backface_idb_data"] = gl::bind(s->get_backface_idb().get());
+		pipeline()["late_idb_data"] = gl::bind(s->get_late_idb().get());
+		pipeline()["idb_counters_data"] = gl::bind(s->get_idb_counters());
+		pipeline()["cluster_visibility_data"] = gl::bind(s->get_cluster_visibility());
 //		pipeline()["sidb_data"] = gl::bind(s->get_shadow_projection_buffers().idb.get());
 //		pipeline()["dsidb_data"] = gl::bind(s->get_directional_shadow_projection_buffers().idb.get());
 //
@@ -58,15 +89,37 @@ public:
 
 	static lib::string name() { return "geo_cull"; }
 
-	void record(gl::command_recorder &recorder) override final {
+	/**
+	 *	@brief	Updates the fragment's frustum planes push constants.
+	 *			Should be called whenever camera's projection model changes.
+	 */
+	void update_projection_planes(const primary_renderer_camera::projection_model_t &camera_projection);
+
+	/**
+	 *	@brief	Enables or disables occlusion culling. When disabled, the early phase emits all visible clusters and the late
+	 *			phase should not run.
+	 */
+	void set_occlusion_culling(bool enabled) {
+		pipeline()["push_t.occlusion_culling"] = static_cast<std::uint32_t>(enabled ? 1 : 0);
+	}
+
+	/**
+	 *	@brief	Resizes the indirect draw buffers, if needed, and clears the previous draws. Should precede the early phase.
+	 */
+	void clear_idbs(gl::command_recorder &recorder) {
+		assert(phase == scene_geo_cull_phase::early);
+
 		commit_idbs(recorder);
+		s->clear_indirect_command_buffers(recorder);
+	}
 
-		auto draw_count = s->get_object_group().draw_count();
+	void record(gl::command_recorder &recorder) override final {
+		const auto cluster_count = s->get_object_group().cluster_count();
 
 		constexpr int jobs = 128;
-		auto size = (draw_count + jobs - 1) / jobs;
+		auto size = (cluster_count + jobs - 1) / jobs;
 
-		pipeline()["mesh_descriptors_count_t.mesh_count"] = static_cast<std::uint32_t>(draw_count);
+		pipeline()["push_t.cluster_count"] = static_cast<std::uint32_t>(cluster_count);
 
 		recorder << dispatch_task(static_cast<std::uint32_t>(size), 1u, 1u);
 	}
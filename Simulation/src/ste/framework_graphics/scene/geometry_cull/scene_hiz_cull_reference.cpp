@@ -0,0 +1,147 @@
+
+#include <stdafx.hpp>
+#include <scene_hiz_cull_reference.hpp>
+
+#include <algorithm>
+
+using namespace ste;
+using namespace ste::graphics;
+
+scene_hiz_cull_reference::pyramid scene_hiz_cull_reference::build_pyramid(const lib::vector<float> &depth,
+																		  const glm::uvec2 &extent) {
+	assert(depth.size() == static_cast<std::size_t>(extent.x) * extent.y);
+
+	pyramid hiz;
+	hiz.depth_extent = extent;
+
+	// Level 0 is half the depth target, levels are rounded down, down to 1x1
+	auto level_size = glm::max(extent / 2u, glm::uvec2(1));
+	for (;;) {
+		hiz.extents.push_back(level_size);
+		if (level_size.x == 1 && level_size.y == 1)
+			break;
+		level_size = glm::max(level_size / 2u, glm::uvec2(1));
+	}
+	hiz.levels.resize(hiz.extents.size());
+
+	for (std::size_t l = 0; l < hiz.levels.size(); ++l) {
+		const auto input_size = l == 0 ? extent : hiz.extents[l - 1];
+		const auto fetch = [&](const glm::uvec2 &p) {
+			return l == 0 ?
+				depth[p.y * extent.x + p.x] :
+				hiz.texel(l - 1, p);
+		};
+
+		const auto size = hiz.extents[l];
+		auto &level = hiz.levels[l];
+		level.resize(static_cast<std::size_t>(size.x) * size.y);
+
+		for (std::uint32_t y = 0; y < size.y; ++y) {
+			for (std::uint32_t x = 0; x < size.x; ++x) {
+				const auto coords = glm::uvec2{ x, y };
+
+				// Footprint is 2x2, or 3 wide on the last row or column of an odd sized input
+				const auto p0 = coords * 2u;
+				auto p1 = p0 + glm::uvec2(1);
+				if (x == size.x - 1) p1.x += input_size.x & 1;
+				if (y == size.y - 1) p1.y += input_size.y & 1;
+				p1 = glm::min(p1, input_size - glm::uvec2(1));
+
+				float d = 1.f;
+				for (auto py = p0.y; py <= p1.y; ++py)
+					for (auto px = p0.x; px <= p1.x; ++px)
+						d = glm::min(d, fetch({ px, py }));
+
+				level[y * size.x + x] = d;
+			}
+		}
+	}
+
+	return hiz;
+}
+
+bool scene_hiz_cull_reference::test_sphere(const pyramid &hiz,
+										   const glm::vec3 &center,
+										   float radius,
+										   const glm::vec4 &proj_xywz) {
+	const auto p = glm::vec2{ proj_xywz.x, proj_xywz.y };
+	const auto n = proj_xywz.z;
+
+	// Distance along the view direction. Spheres that cross the near plane are visible.
+	const auto z = -center.z;
+	if (z - radius <= n)
+		return true;
+
+	// Bounds of the perspective-projected sphere, from the planes through the eye that are tangent to the sphere
+	// (Mara and McGuire, 2013).
+	const auto r2 = radius * radius;
+	const auto tx = glm::sqrt(center.x * center.x + z * z - r2);
+	const auto ty = glm::sqrt(center.y * center.y + z * z - r2);
+	const auto x = glm::vec2{ (center.x * tx - z * radius) / (center.x * radius + z * tx),
+							  (center.x * tx + z * radius) / (z * tx - center.x * radius) } * p.x;
+	const auto y = glm::vec2{ (center.y * ty - z * radius) / (center.y * radius + z * ty),
+							  (center.y * ty + z * radius) / (z * ty - center.y * radius) } * p.y;
+
+	const auto uv_min = glm::clamp(glm::vec2{ glm::min(x.x, x.y), glm::min(y.x, y.y) } * .5f + .5f, glm::vec2(0), glm::vec2(1));
+	const auto uv_max = glm::clamp(glm::vec2{ glm::max(x.x, x.y), glm::max(y.x, y.y) } * .5f + .5f, glm::vec2(0), glm::vec2(1));
+
+	// Footprint in depth target pixels
+	const auto depth_size = glm::ivec2(hiz.depth_extent);
+	const auto p0 = glm::min(glm::ivec2(uv_min * glm::vec2(depth_size)), depth_size - glm::ivec2(1));
+	const auto p1 = glm::min(glm::ivec2(uv_max * glm::vec2(depth_size)), depth_size - glm::ivec2(1));
+
+	// Pyramid level l texels cover 2^(l+1) pixels, choose the level where the footprint spans at most 2x2 texels
+	const auto extent = glm::max(p1.x - p0.x, p1.y - p0.y) + 1;
+	const auto levels = static_cast<int>(hiz.levels.size());
+	const auto level = glm::clamp(static_cast<int>(glm::ceil(glm::log2(static_cast<float>(extent)))) - 1, 0, levels - 1);
+
+	// The last texels of a level cover the remainder of the pixels
+	const auto size = glm::ivec2(hiz.extents[level]);
+	const auto t0 = glm::uvec2(glm::min(p0 >> (level + 1), size - glm::ivec2(1)));
+	const auto t1 = glm::uvec2(glm::min(p1 >> (level + 1), size - glm::ivec2(1)));
+
+	const auto d = glm::min(glm::min(hiz.texel(level, { t0.x, t0.y }),
+									 hiz.texel(level, { t1.x, t0.y })),
+							glm::min(hiz.texel(level, { t0.x, t1.y }),
+									 hiz.texel(level, { t1.x, t1.y })));
+
+	// Occluded if the sphere's closest point is behind the farthest depth of its footprint (depth is reversed)
+	const auto sphere_depth = -n / (center.z + radius);
+	return sphere_depth >= d;
+}
+
+scene_hiz_cull_reference::cull_result scene_hiz_cull_reference::cull(const lib::vector<cluster> &clusters,
+																	 const lib::vector<std::uint32_t> &visibility,
+																	 bool occlusion_culling) {
+	assert(clusters.size() == visibility.size());
+
+	cull_result result;
+	result.visibility = visibility;
+
+	// Early phase
+	for (std::uint32_t i = 0; i < clusters.size(); ++i) {
+		const auto &c = clusters[i];
+		if (!c.in_frustum)
+			continue;
+
+		if (!c.back_facing && (!occlusion_culling || visibility[i] != 0))
+			result.idb.push_back(i);
+		if (!c.front_facing)
+			result.backface_idb.push_back(i);
+	}
+
+	if (!occlusion_culling)
+		return result;
+
+	// Late phase
+	for (std::uint32_t i = 0; i < clusters.size(); ++i) {
+		const auto &c = clusters[i];
+		const bool visible = c.in_frustum && !c.back_facing && c.unoccluded;
+
+		result.visibility[i] = visible ? 1 : 0;
+		if (visible && visibility[i] == 0)
+			result.late_idb.push_back(i);
+	}
+
+	return result;
+}
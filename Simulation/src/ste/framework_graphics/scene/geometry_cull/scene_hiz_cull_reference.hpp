@@ -0,0 +1,92 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <lib/vector.hpp>
+
+namespace ste {
+namespace graphics {
+
+/**
+ *	@brief	CPU reference of the two-phase occlusion cull: The Hi-Z pyramid build of gbuffer_hiz.comp, and the Hi-Z sphere test
+ *			and indirect draws compaction of scene_geo_cull.comp. Mirrors the shaders, to validate their results against.
+ *
+ *	The shaders compact the draws with atomic counters, their order is unspecified. The reference emits the draws in
+ *	cluster order.
+ *	The reference's conservativeness and draws compaction are checked by the ste_tests tool.
+ */
+class scene_hiz_cull_reference {
+public:
+	/**
+	 *	@brief	Hi-Z pyramid. Level 0 is half the depth target's extent, rounded down, with a complete mipmap chain. Each texel
+	 *			holds the farthest (minimal, depth is reversed) depth of the depth target pixels it covers.
+	 */
+	struct pyramid {
+		glm::uvec2 depth_extent;
+		lib::vector<glm::uvec2> extents;
+		lib::vector<lib::vector<float>> levels;
+
+		float texel(std::size_t level, const glm::uvec2 &p) const {
+			return levels[level][p.y * extents[level].x + p.x];
+		}
+	};
+
+	/**
+	 *	@brief	A cluster's cull tests results
+	 */
+	struct cluster {
+		// Passes the frustum and lights' ranges tests
+		bool in_frustum;
+		// Normal cone tests
+		bool back_facing;
+		bool front_facing;
+		// Passes the Hi-Z test against the early phase's pyramid
+		bool unoccluded;
+	};
+
+	/**
+	 *	@brief	Compacted draws, as cluster indices, and the clusters visibility for the next frame
+	 */
+	struct cull_result {
+		lib::vector<std::uint32_t> idb;
+		lib::vector<std::uint32_t> backface_idb;
+		lib::vector<std::uint32_t> late_idb;
+		lib::vector<std::uint32_t> visibility;
+	};
+
+public:
+	/**
+	 *	@brief	Builds the Hi-Z pyramid of a depth target
+	 *
+	 *	@param	depth	Depth target, row-major
+	 *	@param	extent	Depth target extent
+	 */
+	static pyramid build_pyramid(const lib::vector<float> &depth,
+								 const glm::uvec2 &extent);
+
+	/**
+	 *	@brief	Tests an eye space bounding sphere against the Hi-Z pyramid. Returns false if the sphere is occluded.
+	 *
+	 *	@param	proj_xywz	Reversed infinite perspective projection, see camera_projection_reversed_infinite_perspective.
+	 */
+	static bool test_sphere(const pyramid &hiz,
+							const glm::vec3 &center,
+							float radius,
+							const glm::vec4 &proj_xywz);
+
+	/**
+	 *	@brief	Culls the clusters in two phases and compacts the draws.
+	 *
+	 *	@param	visibility			Per cluster, non-zero if the cluster was visible in the last frame
+	 *	@param	occlusion_culling	If false, only the early phase runs and emits all visible clusters
+	 */
+	static cull_result cull(const lib::vector<cluster> &clusters,
+							const lib::vector<std::uint32_t> &visibility,
+							bool occlusion_culling = true);
+};
+
+}
+}
@@ -7,6 +7,7 @@
 #include <fragment_graphics.hpp>
 
 #include <cmd_draw_indexed_indirect.hpp>
+#include <cmd_draw_indexed_indirect_count.hpp>
 
 #include <scene.hpp>
 #include <object_vertex_data.hpp>
@@ -20,6 +21,7 @@ class scene_prepopulate_depth_fragment : public gl::fragment_graphics<scene_prep
 
 private:
 	gl::task<gl::cmd_draw_indexed_indirect> draw_task;
+	gl::task<gl::cmd_draw_indexed_indirect_count> draw_count_task;
 
 	const scene *s;
 
@@ -31,10 +33,19 @@ public:
 			   "scene_transform.vert", "scene_prepopulate_depth.frag"),
 		s(s)
 	{
+		auto &idb = front_face ?
+			s->get_idb().get() :
+			s->get_backface_idb().get();
+
 		draw_task.attach_pipeline(pipeline());
 		draw_task.attach_vertex_buffer(s->get_object_group().get_draw_buffers().get_vertex_buffer());
 		draw_task.attach_index_buffer(s->get_object_group().get_draw_buffers().get_index_buffer());
-		draw_task.attach_indirect_buffer(s->get_idb().get());
+		draw_task.attach_indirect_buffer(idb);
+
+		draw_count_task.attach_pipeline(pipeline());
+		draw_count_task.attach_vertex_buffer(s->get_object_group().get_draw_buffers().get_vertex_buffer());
+		draw_count_task.attach_index_buffer(s->get_object_group().get_draw_buffers().get_index_buffer());
+		draw_count_task.attach_indirect_buffer(idb);
 	}
 	~scene_prepopulate_depth_fragment() noexcept {}
 
@@ -71,9 +82,18 @@ public:
 	}
 
 	void record(gl::command_recorder &recorder) override final {
-		const auto draw_count = s->get_object_group().draw_count();
-
-		recorder << draw_task(static_cast<std::uint32_t>(draw_count));
+		const auto max_draw_count = static_cast<std::uint32_t>(s->get_object_group().cluster_count());
+		const auto counter = front_face ? scene::idb_counter : scene::backface_idb_counter;
+
+		// Draws are compacted by the cluster cull. Without draw count buffers, the trailing commands are empty.
+		if (s->has_idb_draw_counts()) {
+			recorder << draw_count_task(s->get_idb_counters(), counter,
+										max_draw_count,
+										device());
+		}
+		else {
+			recorder << draw_task(max_draw_count);
+		}
 	}
 };
 
@@ -12,12 +12,22 @@
 #include <light_storage.hpp>
 
 #include <vector.hpp>
+#include <stable_vector.hpp>
+#include <array.hpp>
+#include <std430.hpp>
 #include <command_recorder.hpp>
+#include <cmd_fill_buffer.hpp>
 
 namespace ste {
 namespace graphics {
 
 class scene {
+public:
+	// Indices of the indirect draw buffers' counters
+	static constexpr std::uint32_t idb_counter = 0;
+	static constexpr std::uint32_t backface_idb_counter = 1;
+	static constexpr std::uint32_t late_idb_counter = 2;
+
 private:
 	static constexpr int shadow_pltt_size = max_active_lights_per_frame;
 	static constexpr int directional_shadow_pltt_size = max_active_directional_lights_per_frame;
@@ -26,7 +36,18 @@ private:
 	object_group objects;
 	scene_properties scene_props;
 
+	// Compacted draws of the visible clusters, front-facing and back-facing, the clusters found visible by the late occlusion
+	// cull, and their counts
 	object_group_indirect_command_buffer idb;
+	object_group_indirect_command_buffer backface_idb;
+	object_group_indirect_command_buffer late_idb;
+	gl::array<gl::std430<std::uint32_t>> idb_counters;
+	std::size_t idb_size{ 0 };
+	// Per cluster, non-zero if the cluster was visible in the last frame
+	gl::stable_vector<gl::std430<std::uint32_t>> cluster_visibility;
+
+	// Draw counts are read from the counters by the draws, when supported
+	bool idb_draw_counts;
 
 public:
 	scene(const ste_context &ctx)
@@ -34,7 +55,21 @@ public:
 		scene_props(ctx),
 		idb(ctx,
 			gl::buffer_usage::storage_buffer,
-			"indirect draw buffer")
+			"indirect draw buffer"),
+		backface_idb(ctx,
+					 gl::buffer_usage::storage_buffer,
+					 "back-face indirect draw buffer"),
+		late_idb(ctx,
+				 gl::buffer_usage::storage_buffer,
+				 "late indirect draw buffer"),
+		idb_counters(ctx,
+					 3,
+					 gl::buffer_usage::storage_buffer | gl::buffer_usage::indirect_buffer,
+					 "indirect draw buffer counters"),
+		cluster_visibility(ctx,
+						   gl::buffer_usage::storage_buffer,
+						   "cluster visibility buffer"),
+		idb_draw_counts(ctx.device().get_extensions_func_pointers().draw_indirect_count().enabled)
 	{}
 	~scene() noexcept {}
 
@@ -50,12 +85,53 @@ public:
 	const object_group &get_object_group() const { return objects; }
 
 	auto &get_idb() const { return idb; }
-
+	auto &get_backface_idb() const { return backface_idb; }
+	auto &get_late_idb() const { return late_idb; }
+	auto &get_idb_counters() const { return idb_counters; }
+	auto &get_cluster_visibility() const { return cluster_visibility; }
+
+	/**
+	 *	@brief	True if the draws read their draw counts from the indirect draw buffers' counters (VK_KHR_draw_indirect_count).
+	 *			Otherwise, draws are issued for all clusters and the trailing indirect draws are zeroed.
+	 */
+	bool has_idb_draw_counts() const { return idb_draw_counts; }
+
+	/**
+	 *	@brief	Resizes the indirect draw buffers to hold a draw per cluster. Clears the clusters visibility.
+	 */
 	void resize_indirect_command_buffers(const ste_context &ctx,
 										 gl::command_recorder &recorder,
 										 std::size_t size) {
+		idb_size = size;
 		recorder << idb.get().resize_cmd(ctx,
 										 size);
+		recorder << backface_idb.get().resize_cmd(ctx,
+												  size);
+		recorder << late_idb.get().resize_cmd(ctx,
+											  size);
+		recorder << cluster_visibility.resize_cmd(ctx,
+												  size);
+		if (size) {
+			recorder << gl::cmd_fill_buffer(gl::buffer_view(cluster_visibility, 0, size),
+											static_cast<std::uint32_t>(0));
+		}
+	}
+
+	/**
+	 *	@brief	Zeroes the indirect draw buffers' counters. Without draw count buffers, also zeroes the indirect draw buffers:
+	 *			Draws are compacted into the head of the buffers, the zeroed tail draws nothing.
+	 */
+	void clear_indirect_command_buffers(gl::command_recorder &recorder) const {
+		if (idb_size && !idb_draw_counts) {
+			recorder << gl::cmd_fill_buffer(gl::buffer_view(idb.get(), 0, idb_size),
+											static_cast<std::uint32_t>(0));
+			recorder << gl::cmd_fill_buffer(gl::buffer_view(backface_idb.get(), 0, idb_size),
+											static_cast<std::uint32_t>(0));
+			recorder << gl::cmd_fill_buffer(gl::buffer_view(late_idb.get(), 0, idb_size),
+											static_cast<std::uint32_t>(0));
+		}
+		recorder << gl::cmd_fill_buffer(gl::buffer_view(idb_counters),
+										static_cast<std::uint32_t>(0));
 	}
 };
 
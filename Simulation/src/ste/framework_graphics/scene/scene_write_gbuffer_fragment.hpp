@@ -6,6 +6,7 @@
 #include <stdafx.hpp>
 
 #include <cmd_draw_indexed_indirect.hpp>
+#include <cmd_draw_indexed_indirect_count.hpp>
 #include <deferred_gbuffer.hpp>
 
 #include <fragment_graphics.hpp>
@@ -15,43 +16,73 @@
 namespace ste {
 namespace graphics {
 
-class scene_write_gbuffer_fragment : public gl::fragment_graphics<scene_write_gbuffer_fragment> {
-	using Base = gl::fragment_graphics<scene_write_gbuffer_fragment>;
+/**
+ *	@brief	Draws the visible clusters into the gbuffer.
+ *
+ *	With occlusion culling the gbuffer is written in two phases: The early phase clears the gbuffer and draws the clusters
+ *	that were visible last frame, the late phase loads the gbuffer and draws the clusters that were found visible against
+ *	the early phase's Hi-Z pyramid.
+ */
+template <bool late>
+class scene_write_gbuffer_phase_fragment : public gl::fragment_graphics<scene_write_gbuffer_phase_fragment<late>> {
+	using Base = gl::fragment_graphics<scene_write_gbuffer_phase_fragment<late>>;
 
 private:
 	gl::task<gl::cmd_draw_indexed_indirect> draw_task;
+	gl::task<gl::cmd_draw_indexed_indirect_count> draw_count_task;
 
 	const scene *s;
 	const deferred_gbuffer *gbuffer;
 
 public:
-	scene_write_gbuffer_fragment(const gl::rendering_system &rs,
-								 const scene *s,
-								 const deferred_gbuffer *gbuffer)
+	scene_write_gbuffer_phase_fragment(const gl::rendering_system &rs,
+									   const scene *s,
+									   const deferred_gbuffer *gbuffer)
 		: Base(rs,
 			   gl::device_pipeline_graphics_configurations{},
 			   "scene_transform.vert", "scene_write_gbuffer.frag"),
 		s(s),
 		gbuffer(gbuffer)
 	{
-		draw_task.attach_pipeline(pipeline());
+		auto &idb = late ? s->get_late_idb().get() : s->get_idb().get();
+
+		draw_task.attach_pipeline(this->pipeline());
 		draw_task.attach_vertex_buffer(s->get_object_group().get_draw_buffers().get_vertex_buffer());
 		draw_task.attach_index_buffer(s->get_object_group().get_draw_buffers().get_index_buffer());
-		draw_task.attach_indirect_buffer(s->get_idb().get());
+		draw_task.attach_indirect_buffer(idb);
+
+		draw_count_task.attach_pipeline(this->pipeline());
+		draw_count_task.attach_vertex_buffer(s->get_object_group().get_draw_buffers().get_vertex_buffer());
+		draw_count_task.attach_index_buffer(s->get_object_group().get_draw_buffers().get_index_buffer());
+		draw_count_task.attach_indirect_buffer(idb);
 	}
-	~scene_write_gbuffer_fragment() noexcept {}
+	~scene_write_gbuffer_phase_fragment() noexcept {}
 
-	scene_write_gbuffer_fragment(scene_write_gbuffer_fragment&&) = default;
+	scene_write_gbuffer_phase_fragment(scene_write_gbuffer_phase_fragment&&) = default;
 
 	static auto create_fb_layout() {
 		gl::framebuffer_layout fb_layout;
-		fb_layout[gl::pipeline_depth_attachment_location] = gl::clear_store(gl::format::d32_sfloat,
-																			gl::image_layout::depth_stencil_attachment_optimal,
-																			gl::image_layout::shader_read_only_optimal);
-		fb_layout[0] = gl::ignore_store(gl::format::r32g32b32a32_sfloat,
-										gl::image_layout::shader_read_only_optimal);
-		fb_layout[1] = gl::ignore_store(gl::format::r32g32b32a32_sfloat,
-										gl::image_layout::shader_read_only_optimal);
+		if constexpr (!late) {
+			fb_layout[gl::pipeline_depth_attachment_location] = gl::clear_store(gl::format::d32_sfloat,
+																				gl::image_layout::depth_stencil_attachment_optimal,
+																				gl::image_layout::shader_read_only_optimal);
+			fb_layout[0] = gl::ignore_store(gl::format::r32g32b32a32_sfloat,
+											gl::image_layout::shader_read_only_optimal);
+			fb_layout[1] = gl::ignore_store(gl::format::r32g32b32a32_sfloat,
+											gl::image_layout::shader_read_only_optimal);
+		}
+		else {
+			// Continues the early phase's render
+			fb_layout[gl::pipeline_depth_attachment_location] = gl::load_store(gl::format::d32_sfloat,
+																			   gl::image_layout::shader_read_only_optimal,
+																			   gl::image_layout::shader_read_only_optimal);
+			fb_layout[0] = gl::load_store(gl::format::r32g32b32a32_sfloat,
+										  gl::image_layout::shader_read_only_optimal,
+										  gl::image_layout::shader_read_only_optimal);
+			fb_layout[1] = gl::load_store(gl::format::r32g32b32a32_sfloat,
+										  gl::image_layout::shader_read_only_optimal,
+										  gl::image_layout::shader_read_only_optimal);
+		}
 		return fb_layout;
 	}
 
@@ -70,18 +101,30 @@ public:
 	}
 
 	void attach_framebuffer(gl::framebuffer &fb) {
-		pipeline().attach_framebuffer(fb);
+		this->pipeline().attach_framebuffer(fb);
 	}
 	const auto& get_framebuffer_layout() const {
-		return pipeline().get_framebuffer_layout();
+		return this->pipeline().get_framebuffer_layout();
 	}
 
 	void record(gl::command_recorder &recorder) override final {
-		const auto draw_count = s->get_object_group().draw_count();
-		
-		recorder << draw_task(static_cast<std::uint32_t>(draw_count));
+		const auto max_draw_count = static_cast<std::uint32_t>(s->get_object_group().cluster_count());
+		const auto counter = late ? scene::late_idb_counter : scene::idb_counter;
+
+		// Draws are compacted by the cluster cull. Without draw count buffers, the trailing commands are empty.
+		if (s->has_idb_draw_counts()) {
+			recorder << draw_count_task(s->get_idb_counters(), counter,
+										max_draw_count,
+										this->device());
+		}
+		else {
+			recorder << draw_task(max_draw_count);
+		}
 	}
 };
 
+using scene_write_gbuffer_fragment = scene_write_gbuffer_phase_fragment<false>;
+using scene_write_gbuffer_late_fragment = scene_write_gbuffer_phase_fragment<true>;
+
 }
 }
@@ -183,6 +183,8 @@ void debug_gui_fragment::append_frame(float frame_time_ms,
 			float t = a.time_end_ms - a.time_start_ms;
 			times.emplace_back(a.name, t);
 		}
+
+		upload_arena_statistics = profiler_segment_results.get().upload_arena;
 	}
 
 	// Prepare new ImGUI frame
@@ -241,6 +243,15 @@ void debug_gui_fragment::append_frame(float frame_time_ms,
 			ImGui::Text(get_creating_context().device().physical_device().get_properties().deviceName);
 		}
 
+		// Write upload arena high-water mark
+		{
+			ImGui::SameLine(0, 75);
+			std::stringstream stream;
+			stream << "upload arena " << static_cast<std::size_t>(upload_arena_statistics.high_water_mark) / 1024 << " / "
+				<< static_cast<std::size_t>(upload_arena_statistics.capacity) / 1024 << " kB";
+			ImGui::Text(stream.str().c_str());
+		}
+
 		// Plot profiler timeline
 		{
 			ImGui::PlotTimeline(times);
@@ -63,6 +63,7 @@ private:
 
 	metre_vec3 camera_position;
 	lib::vector<float> frame_times;
+	gl::ste_device_upload_arena::statistics upload_arena_statistics{};
 
 	std::array<std::atomic_flag, 3> pointer_buttons_pressed_signals{ 0, 0, 0 };
 	std::atomic<float> pointer_wheel_signal_accumulator{ .0f };
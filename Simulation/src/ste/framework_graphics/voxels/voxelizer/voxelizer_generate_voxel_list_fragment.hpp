@@ -88,7 +88,8 @@ public:
 		for (std::uint32_t vc = 0; vc < max_vertices_count && offset + count < sizes.size(); ++count)
 			vc += sizes[offset + count];
 
-		draw_task.attach_indirect_buffer(s->get_idb().get(), offset);
+		// Voxelize all of the geometry, unculled
+		draw_task.attach_indirect_buffer(s->get_object_group().get_draw_buffers().get_draw_commands_buffer(), offset);
 
 		return offset + count == sizes.size();
 	}
@@ -14,11 +14,15 @@
 #include <surface_type_traits.hpp>
 #include <surface_convert.hpp>
 #include <surface_factory.hpp>
+#include <surface_baker.hpp>
+#include <surface_stream_decoder.hpp>
 
 #include <normal_map_from_height_map.hpp>
 
 #include <lib/string.hpp>
+#include <lib/unique_ptr.hpp>
 #include <algorithm>
+#include <chrono>
 
 using namespace ste;
 using namespace ste::resource;
@@ -43,6 +47,54 @@ void store_texture(const ste_context &ctx,
 	(*texmap)[name] = scene_properties->material_textures_storage().allocate_texture(std::move(t));
 }
 
+// Stores an uncompressed texture. If the texture is streamed, it is decoded straight into the upload's staging memory.
+template <gl::format format, typename Map>
+void store_texture(const ste_context &ctx,
+				   const std::string &name,
+				   lib::unique_ptr<surface_stream_decoder_2d> &&decoder,
+				   optional<opaque_surface<2>> &&surface,
+				   graphics::scene_properties *scene_properties,
+				   Map *texmap) {
+	if (!decoder) {
+		store_texture<format>(ctx, name, std::move(surface).get(), scene_properties, texmap);
+		return;
+	}
+
+	auto t = surface_factory::image_from_surface_2d<format>(ctx,
+															std::move(decoder),
+															gl::image_usage::sampled,
+															gl::image_layout::shader_read_only_optimal,
+															lib::string(name.begin(), name.end()));
+	(*texmap)[name] = scene_properties->material_textures_storage().allocate_texture(std::move(t));
+}
+
+template <typename Map>
+void store_baked_texture(const ste_context &ctx,
+						 const std::string &name,
+						 opaque_surface<2> &&surface,
+						 graphics::scene_properties *scene_properties,
+						 Map *texmap) {
+	auto t = surface_factory::image_from_opaque_surface_2d(ctx,
+														   std::move(surface),
+														   gl::image_usage::sampled,
+														   gl::image_layout::shader_read_only_optimal,
+														   lib::string(name.begin(), name.end()));
+	(*texmap)[name] = scene_properties->material_textures_storage().allocate_texture(std::move(t));
+}
+
+void log_baked_texture(const std::string &name,
+					   const opaque_surface<2> &surface,
+					   bool cached,
+					   std::chrono::high_resolution_clock::time_point start_time) {
+	// Uncompressed textures are stored as 8-bit per component and are mipmapped at runtime
+	const auto uncompressed_bytes = static_cast<std::size_t>(surface.extent().x) * static_cast<std::size_t>(surface.extent().y) *
+		(surface.surface_format() == gl::format::bc4_unorm_block ? 1 : 4) * 4 / 3;
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time);
+	ste_log() << "Loaded texture \"" << name << "\"" << (cached ? " (baked cache)" : " (baked)") << " in " << elapsed.count() << "ms, "
+		<< static_cast<std::size_t>(surface.bytes()) << " bytes of video memory (" << uncompressed_bytes << " bytes uncompressed)" << std::endl;
+}
+
 }
 
 void model_factory::add_object_to_object_group(const ste_context &ctx, 
@@ -57,16 +109,11 @@ void model_factory::add_object_to_object_group(const ste_context &ctx,
 	});
 }
 
-ste::task_future<void> model_factory::process_model_mesh(const ste_context &ctx,
-														 graphics::scene_properties *scene_properties,
-                                                         const vertex_attrib_type &attrib,
-														 const tinyobj::shape_t &shape,
-														 graphics::object_group *object_group,
-														 materials_type &materials,
-														 texture_map_type &textures,
-														 lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
-														 lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
-														 lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects) {
+model_factory::model_factory_mesh model_factory::process_model_mesh(const vertex_attrib_type &attrib,
+																	const tinyobj::shape_t &shape,
+																	const graphics::mesh_optimizer::options &optimization,
+																	graphics::mesh_optimizer::statistics *before,
+																	graphics::mesh_optimizer::statistics *after) {
 	lib::vector<model_factory_vertex> vertices;
 	lib::vector<std::uint32_t> vbo_indices;
 
@@ -186,72 +233,101 @@ ste::task_future<void> model_factory::process_model_mesh(const ste_context &ctx,
 		vbo_data.push_back(vo);
 	}
 
-	// Create async task that generates object, material and material layer
+	// Reorder for the post-transform vertex cache and vertex fetch
+	graphics::mesh_optimizer::optimize(vbo_indices,
+									   vbo_data,
+									   optimization,
+									   before,
+									   after);
+
+	// Split into meshlets for cluster culling
+	auto meshlets = graphics::mesh_meshlet_builder::build(vbo_indices, vbo_data);
+
+	return { std::move(vbo_data), std::move(vbo_indices), std::move(meshlets) };
+}
+
+void model_factory::create_model_object(const ste_context &ctx,
+										graphics::scene_properties *scene_properties,
+										const tinyobj::shape_t &shape,
+										graphics::object_group *object_group,
+										materials_type &materials,
+										const texture_map_type &textures,
+										model_factory_mesh &&mesh,
+										std::mutex &bookkeeping_mutex,
+										lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
+										lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
+										lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects) {
 	const int mat_idx = shape.mesh.material_ids.size() > 0 ? shape.mesh.material_ids[0] : -1;
 	auto &material = mat_idx >= 0 ? materials[mat_idx] : empty_mat;
 
-	return ctx.engine().task_scheduler().schedule_now([=, &ctx, vbo_data = std::move(vbo_data), vbo_indices = std::move(vbo_indices), &loaded_materials, &loaded_material_layers, &textures, &material]() {
-		// Read loaded textures, if any.
-		texture_t diff_map;
-		texture_t opacity_map;
-		texture_t specular_map;
-		texture_t normalmap;
-		texture_t roughness_map;
-		texture_t metallic_map;
-//		texture_t anisotropy_map;
-		texture_t thickness_map;
-		if (mat_idx >= 0) {
-			diff_map = textures[material.diffuse_texname];
-			opacity_map = textures[material.alpha_texname];
-			specular_map = textures[material.specular_texname];
-			normalmap = textures[material.bump_texname];
-			roughness_map = textures[material.unknown_parameter[roughness_map_key]];
-			metallic_map = textures[material.unknown_parameter[metallic_map_key]];
-//			anisotropy_map = textures[material.unknown_parameter[anisotropy_map_key]];
-			thickness_map = textures[material.unknown_parameter[thickness_map_key]];
-		}
+	const auto texture = [&](const std::string &name) {
+		auto it = textures.find(name);
+		return it != textures.end() ? it->second : texture_t();
+	};
+
+	// Read loaded textures, if any.
+	texture_t diff_map;
+	texture_t opacity_map;
+	texture_t specular_map;
+	texture_t normalmap;
+	texture_t roughness_map;
+	texture_t metallic_map;
+//	texture_t anisotropy_map;
+	texture_t thickness_map;
+	if (mat_idx >= 0) {
+		diff_map = texture(material.diffuse_texname);
+		opacity_map = texture(material.alpha_texname);
+		specular_map = texture(material.specular_texname);
+		normalmap = texture(material.bump_texname);
+		roughness_map = texture(material.unknown_parameter[roughness_map_key]);
+		metallic_map = texture(material.unknown_parameter[metallic_map_key]);
+//		anisotropy_map = texture(material.unknown_parameter[anisotropy_map_key]);
+		thickness_map = texture(material.unknown_parameter[thickness_map_key]);
+	}
 
-		// Allocate material and head layer
-		auto layer = scene_properties->material_layers_storage().allocate_layer();
-		auto mat = scene_properties->materials_storage().allocate_material(ctx,
-																		   layer.get());
-
-		// Set material textures
-		if (diff_map)		mat->set_texture(diff_map);
-		if (specular_map)	mat->set_cavity_map(specular_map);
-		if (normalmap)		mat->set_normal_map(normalmap);
-		if (opacity_map)	mat->set_mask_map(opacity_map);
-
-		if (roughness_map)	layer->set_roughness(roughness_map);
-		if (metallic_map)	layer->set_metallicity(metallic_map);
-//		if (anisotropy_map)	layer->set_anisotropy(anisotropy_map);
-		if (thickness_map)	layer->set_layer_thickness(thickness_map);
-
-		// Create mesh from vertices and indices
-		lib::unique_ptr<graphics::mesh<graphics::mesh_subdivion_mode::Triangles>> m = lib::allocate_unique<graphics::mesh<graphics::mesh_subdivion_mode::Triangles>>();
-		m->set_indices(std::move(vbo_indices));
-		m->set_vertices(std::move(vbo_data));
-
-		// Create object from mesh and material
-		lib::shared_ptr<graphics::object> obj = lib::allocate_shared<graphics::object>(std::move(m));
-		obj->set_material(mat.get());
-
-		// Add object to scene's object group
-		add_object_to_object_group(ctx,
-								   object_group,
-								   obj);
-
-		// Bookeeping
-		loaded_materials.push_back(std::move(mat));
-		loaded_material_layers.push_back(std::move(layer));
-		if (loaded_objects) 
-			loaded_objects->push_back(obj);
-	});
+	// Allocate material and head layer
+	auto layer = scene_properties->material_layers_storage().allocate_layer();
+	auto mat = scene_properties->materials_storage().allocate_material(ctx,
+																	   layer.get());
+
+	// Set material textures
+	if (diff_map)		mat->set_texture(diff_map);
+	if (specular_map)	mat->set_cavity_map(specular_map);
+	if (normalmap)		mat->set_normal_map(normalmap);
+	if (opacity_map)	mat->set_mask_map(opacity_map);
+
+	if (roughness_map)	layer->set_roughness(roughness_map);
+	if (metallic_map)	layer->set_metallicity(metallic_map);
+//	if (anisotropy_map)	layer->set_anisotropy(anisotropy_map);
+	if (thickness_map)	layer->set_layer_thickness(thickness_map);
+
+	// Create mesh from vertices and indices
+	lib::unique_ptr<graphics::mesh<graphics::mesh_subdivion_mode::Triangles>> m = lib::allocate_unique<graphics::mesh<graphics::mesh_subdivion_mode::Triangles>>();
+	m->set_indices(std::move(mesh.indices));
+	m->set_vertices(std::move(mesh.vertices));
+	m->set_meshlets(std::move(mesh.meshlets));
+
+	// Create object from mesh and material
+	lib::shared_ptr<graphics::object> obj = lib::allocate_shared<graphics::object>(std::move(m));
+	obj->set_material(mat.get());
+
+	// Add object to scene's object group
+	add_object_to_object_group(ctx,
+							   object_group,
+							   obj);
+
+	// Bookeeping
+	std::unique_lock<std::mutex> l(bookkeeping_mutex);
+	loaded_materials.push_back(std::move(mat));
+	loaded_material_layers.push_back(std::move(layer));
+	if (loaded_objects) 
+		loaded_objects->push_back(obj);
 }
 
 ste::task_future<void> model_factory::load_texture(const ste_context &ctx,
 												   const std::string &name,
 												   bool srgb,
+												   bool is_normal_map,
 												   bool is_displacement_map,
 												   graphics::scene_properties *scene_properties,
 												   texture_map_type *texmap,
@@ -263,19 +339,46 @@ ste::task_future<void> model_factory::load_texture(const ste_context &ctx,
 		std::replace(normalized_name.begin(), normalized_name.end(), '\\', '/');
 		std::experimental::filesystem::path full_path = dir / std::experimental::filesystem::path(normalized_name).make_preferred();
 
-		// Load surface from file
+		const auto start_time = std::chrono::high_resolution_clock::now();
+		auto &sched = ctx.engine().task_scheduler();
+
+		// Prefer baked textures. Normal maps generated from displacement maps depend on the normal map bias and are
+		// not cached.
+		if (!is_displacement_map) {
+			auto baked = surface_baker::read_cache(full_path);
+			if (baked) {
+				const auto format = baked.get().surface_format();
+				const bool compatible =
+					srgb ? format == surface_baker::baked_format(surface_baker::usage::albedo) :
+					is_normal_map ? format == surface_baker::baked_format(surface_baker::usage::normal_map) :
+					format == surface_baker::baked_format(surface_baker::usage::mask) || format == surface_baker::baked_format(surface_baker::usage::generic);
+
+				if (compatible) {
+					_detail::log_baked_texture(name, baked.get(), true, start_time);
+					_detail::store_baked_texture(ctx, name, std::move(baked).get(), scene_properties, texmap);
+					return;
+				}
+			}
+		}
+
+		// Open a stream of the file, when the file format allows. Streamed textures are decoded in strips that are
+		// converted, on the workers, straight into the format of the baked texture's source or into the staging memory of
+		// the uncompressed texture. Other files are loaded whole.
+		lib::unique_ptr<surface_stream_decoder_2d> decoder;
 		optional<opaque_surface<2>> surface;
 		try {
-			surface = surface_io::load_surface_2d(full_path, srgb);
+			decoder = surface_io::open_surface_2d_stream(full_path, srgb);
+			if (!decoder)
+				surface = surface_io::load_surface_2d(full_path, srgb);
 		}
 		catch (...) {}
 
-		if (!surface) {
+		if (!decoder && !surface) {
 			ste_log_warn() << "Couldn't load texture " << full_path.string() << std::endl;
 			return;
 		}
 
-		auto surface_format_traits = gl::format_id(surface.get().surface_format());
+		auto surface_format_traits = gl::format_id(decoder ? decoder->get_format() : surface.get().surface_format());
 
 		// Enforce correct normal maps and displacement maps. 
 		bool displacement = is_displacement_map;
@@ -290,21 +393,59 @@ ste::task_future<void> model_factory::load_texture(const ste_context &ctx,
 			}
 		}
 
-		// Create texture.
-		texture_t texture;
-		if (displacement) {
-			// We use normal maps, if a displacement map is provided, use it to generate a normal map.
-			auto normal_map = graphics::normal_map_from_height_map<gl::format::r8g8b8a8_unorm>()(surface_convert::convert_2d<gl::format::r8_unorm>(std::move(surface).get()), normal_map_bias);
-			_detail::store_texture<gl::format::r8g8b8a8_unorm>(ctx, name, std::move(normal_map), scene_properties, texmap);
+		// Bake, when possible, into block-compressed textures. sRGB single component textures have no block-compressed
+		// format and keep the uncompressed path.
+		try {
+			if (displacement) {
+				// We use normal maps, if a displacement map is provided, use it to generate a normal map.
+				auto height_map = decoder ?
+					decoder->decode_surface<gl::format::r8_unorm>(sched) :
+					surface_convert::convert_2d<gl::format::r8_unorm>(std::move(surface).get());
+				auto normal_map = graphics::normal_map_from_height_map<gl::format::r8g8b8a8_unorm>()(std::move(height_map), normal_map_bias);
+				auto baked = surface_baker::bake(std::move(normal_map), surface_baker::usage::normal_map, sched);
+
+				_detail::log_baked_texture(name, baked, false, start_time);
+				_detail::store_baked_texture(ctx, name, std::move(baked), scene_properties, texmap);
+				return;
+			}
+
+			// Displacement maps that look like normal maps are treated as normal maps
+			const bool normal_map = is_normal_map || is_displacement_map;
+
+			optional<surface_baker::usage> bake_usage;
+			if (srgb && surface_format_traits.elements >= 3)
+				bake_usage = surface_baker::usage::albedo;
+			else if (normal_map && surface_format_traits.elements >= 3)
+				bake_usage = surface_baker::usage::normal_map;
+			else if (!srgb && !normal_map)
+				bake_usage = surface_format_traits.elements == 1 ? surface_baker::usage::mask : surface_baker::usage::generic;
+
+			if (bake_usage && !surface_format_traits.is_compressed && !(surface_format_traits.elements == 1 && surface_format_traits.is_srgb)) {
+				auto baked = decoder ?
+					surface_baker::bake(*decoder, bake_usage.get(), sched) :
+					surface_baker::bake(std::move(surface).get(), bake_usage.get(), sched);
+				surface_baker::write_cache(full_path, baked);
+
+				_detail::log_baked_texture(name, baked, false, start_time);
+				_detail::store_baked_texture(ctx, name, std::move(baked), scene_properties, texmap);
+				return;
+			}
+		}
+		catch (const surface_error &e) {
+			ste_log_warn() << "Couldn't bake texture \"" << name << "\": " << e.what() << ". Bailing out..." << std::endl;
+			return;
 		}
-		else if (surface_format_traits.elements == 1 && surface_format_traits.is_srgb)
-			_detail::store_texture<gl::format::r8_srgb>(ctx, name, std::move(surface).get(), scene_properties, texmap);
+
+		// Create uncompressed texture.
+		texture_t texture;
+		if (surface_format_traits.elements == 1 && surface_format_traits.is_srgb)
+			_detail::store_texture<gl::format::r8_srgb>(ctx, name, std::move(decoder), std::move(surface), scene_properties, texmap);
 		else if (surface_format_traits.elements == 1 && !surface_format_traits.is_srgb)
-			_detail::store_texture<gl::format::r8_unorm>(ctx, name, std::move(surface).get(), scene_properties, texmap);
+			_detail::store_texture<gl::format::r8_unorm>(ctx, name, std::move(decoder), std::move(surface), scene_properties, texmap);
 		else if (surface_format_traits.elements >= 3 && surface_format_traits.is_srgb)
-			_detail::store_texture<gl::format::r8g8b8a8_srgb>(ctx, name, std::move(surface).get(), scene_properties, texmap);
+			_detail::store_texture<gl::format::r8g8b8a8_srgb>(ctx, name, std::move(decoder), std::move(surface), scene_properties, texmap);
 		else if (surface_format_traits.elements >= 3 && !surface_format_traits.is_srgb)
-			_detail::store_texture<gl::format::r8g8b8a8_unorm>(ctx, name, std::move(surface).get(), scene_properties, texmap);
+			_detail::store_texture<gl::format::r8g8b8a8_unorm>(ctx, name, std::move(decoder), std::move(surface), scene_properties, texmap);
 		else {
 			assert(false);
 		}
@@ -339,6 +480,7 @@ lib::vector<ste::task_future<void>> model_factory::load_textures(const ste_conte
 						   materials[mat_idx].unknown_parameter[thickness_map_key] })
 			if (str.length() && tex_map.find(str) == tex_map.end()) {
 				const bool srgb = str == materials[mat_idx].diffuse_texname;
+				const bool normal_map = str == materials[mat_idx].bump_texname;
 				const bool displacement = str == materials[mat_idx].displacement_texname;
 
 				// Create texture loading task.
@@ -346,6 +488,7 @@ lib::vector<ste::task_future<void>> model_factory::load_textures(const ste_conte
 				futures.push_back(load_texture(ctx,
 											   str,
 											   srgb,
+											   normal_map,
 											   displacement,
 											   scene_properties,
 											   &tex_map,
@@ -371,62 +514,128 @@ ste::task_future<void> model_factory::load_model_async(const ste_context &ctx,
 													   float normal_map_bias,
 													   lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
 													   lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
-													   lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects) {
-	// Create async task that handles model loading
-	return ctx.engine().task_scheduler().schedule_now([=, &loaded_materials, &loaded_material_layers, &ctx]() {
-		// Texture map
-		lib::unique_ptr<texture_map_type> textures = lib::allocate_unique<texture_map_type>();
+													   lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects,
+													   const graphics::mesh_optimizer::options &mesh_optimization) {
+	auto &sched = ctx.engine().task_scheduler();
+	const auto start_time = std::chrono::high_resolution_clock::now();
+
+	// Create async task that parses the model
+	auto parse_future = sched.schedule_now([=]() {
+		auto state = lib::allocate_shared<model_load_state>();
 
 		auto path_string = file_path.string();
-		ste_log() << "Loading OBJ model " << path_string << std::endl;
+		state->dir = lib::string(path_string.begin(), std::find_if(path_string.rbegin(), path_string.rend(), [](char c) { return c == '/' || c == '\\'; }).base());
+
+		// Try the binary mesh cache first
+		auto cached = model_mesh_cache::read(file_path, mesh_optimization.key());
+		if (cached) {
+			ste_log() << "Loading OBJ model " << path_string << " from mesh cache" << std::endl;
 
-		lib::string dir = { path_string.begin(), std::find_if(path_string.rbegin(), path_string.rend(), [](char c) { return c == '/' || c == '\\'; }).base() };
+			state->cached = true;
+			state->shapes = std::move(cached.get().shapes);
+			state->materials = std::move(cached.get().materials);
+			state->meshes = std::move(cached.get().meshes);
 
-		shapes_type shapes;
-		materials_type materials;
-        vertex_attrib_type attribs;
+			return state;
+		}
+
+		ste_log() << "Loading OBJ model " << path_string << std::endl;
 
 		// Load model
 		std::string err;
-		if (!tinyobj::LoadObj(&attribs,
-                              &shapes,
-							  &materials,
+		if (!tinyobj::LoadObj(&state->attribs,
+                              &state->shapes,
+							  &state->materials,
 							  &err, 
 							  path_string.c_str(), 
-							  dir.c_str())) {
+							  state->dir.c_str())) {
 			ste_log_error() << "Couldn't load model " << path_string << ": " << err;
 			throw resource_io_error("Could not load/parse model");
 		}
 
+		// Keep the parsed materials for the mesh cache, load_textures() modifies them
+		state->cache_materials = state->materials;
+		state->meshes.resize(state->shapes.size());
+		state->statistics_before.resize(state->shapes.size());
+		state->statistics_after.resize(state->shapes.size());
+
+		return state;
+	});
+
+	// Once parsed, build the loading task graph: Texture decode/upload and mesh processing all run in parallel, and each object is
+	// created and uploaded once its mesh and the textures are ready. No task waits on another.
+	return std::move(parse_future).then([=, &sched, &loaded_materials, &loaded_material_layers, &ctx](lib::shared_ptr<model_load_state> state) {
 		// Load all textures, in parallel
-		{
-			for (auto &f : load_textures(ctx, 
-										 shapes, 
-										 materials,
-										 scene_properties,
-										 *textures, 
-										 dir, 
-										 normal_map_bias))
-				f.get();
+		auto textures_loaded = when_all(sched, load_textures(ctx,
+															 state->shapes,
+															 state->materials,
+															 scene_properties,
+															 state->textures,
+															 state->dir,
+															 normal_map_bias))
+			.then([state]() -> const texture_map_type* {
+				return &state->textures;
+			})
+			.shared();
+
+		// Process all shapes, create materials and objects and add them to scene.
+		lib::vector<ste::task_future<void>> futures;
+		futures.reserve(state->shapes.size());
+		for (std::size_t i = 0; i < state->shapes.size(); ++i) {
+			auto mesh = sched.schedule_now([state, i, mesh_optimization]() {
+				if (state->cached)
+					return std::move(state->meshes[i]);
+
+				auto m = process_model_mesh(state->attribs,
+											state->shapes[i],
+											mesh_optimization,
+											&state->statistics_before[i],
+											&state->statistics_after[i]);
+				// Keep a copy for the mesh cache
+				state->meshes[i] = m;
+
+				return m;
+			});
+
+			auto object = when_all(sched, task_shared_future<const texture_map_type*>(textures_loaded), std::move(mesh))
+				.then([=, &ctx, &loaded_materials, &loaded_material_layers](std::tuple<const texture_map_type*, model_factory_mesh> data) {
+					create_model_object(ctx,
+										scene_properties,
+										state->shapes[i],
+										object_group,
+										state->materials,
+										*std::get<0>(data),
+										std::move(std::get<1>(data)),
+										state->bookkeeping_mutex,
+										loaded_materials,
+										loaded_material_layers,
+										loaded_objects);
+			});
+			futures.push_back(std::move(object));
 		}
 
-		// Once all textures are loaded, process all shapes, create materials and objects and add them to scene.
-		{
-			lib::vector<ste::task_future<void>> futures;
-			for (auto &shape : shapes)
-				futures.push_back(process_model_mesh(ctx,
-													 scene_properties,
-                                                     attribs,
-													 shape,
-													 object_group,
-													 materials,
-													 *textures,
-													 loaded_materials,
-													 loaded_material_layers,
-													 loaded_objects));
-
-			for (auto &f : futures)
-				f.get();
-		}
+		return when_all(sched, std::move(futures)).then([state, file_path, start_time, mesh_optimization]() {
+			const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time);
+			ste_log() << "Loaded OBJ model " << file_path.string() << (state->cached ? " (mesh cache)" : " (parsed)") << " in " << elapsed.count() << "ms" << std::endl;
+
+			if (state->cached)
+				return;
+
+			// Report vertex cache efficiency
+			graphics::mesh_optimizer::statistics before, after;
+			for (std::size_t i = 0; i < state->shapes.size(); ++i) {
+				before += state->statistics_before[i];
+				after += state->statistics_after[i];
+			}
+			ste_log() << "OBJ model " << file_path.string() << " vertex cache (" << mesh_optimization.cache_size << " entries): ACMR " 
+				<< before.acmr() << " -> " << after.acmr() << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+
+			// Write the mesh cache, so that the next load can skip parsing and processing
+			model_mesh_cache::write(file_path,
+									mesh_optimization.key(),
+									state->shapes,
+									state->cache_materials,
+									state->meshes);
+		});
 	});
 }
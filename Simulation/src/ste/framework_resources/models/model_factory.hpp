@@ -14,13 +14,19 @@
 #include <material.hpp>
 #include <material_layer.hpp>
 #include <material_texture.hpp>
+#include <object_vertex_data.hpp>
+#include <model_mesh_cache.hpp>
+#include <mesh_optimizer.hpp>
 
 #include <filesystem>
 
 #include <lib/unique_ptr.hpp>
+#include <lib/shared_ptr.hpp>
 #include <lib/unordered_map.hpp>
 #include <lib/vector.hpp>
+#include <lib/string.hpp>
 #include <future>
+#include <mutex>
 #include <hash_combine.hpp>
 
 #include <tiny_obj_loader.h>
@@ -55,6 +61,32 @@ private:
 	};
 	friend std::hash<ste::resource::model_factory::model_factory_vertex>;
 
+	using model_factory_mesh = model_mesh_cache::mesh;
+
+	/*
+	 *	@brief	Parsed model data, shared by all the loading tasks of a model.
+	 */
+	struct model_load_state {
+		shapes_type shapes;
+		materials_type materials;
+		vertex_attrib_type attribs;
+		texture_map_type textures;
+		lib::string dir;
+
+		// True if loaded from the binary mesh cache, in which case meshes holds the processed meshes. Otherwise meshes
+		// collects the processed meshes, and cache_materials the parsed materials, to write the cache.
+		bool cached{ false };
+		lib::vector<model_factory_mesh> meshes;
+		materials_type cache_materials;
+
+		// Per shape vertex cache statistics, before and after optimization
+		lib::vector<graphics::mesh_optimizer::statistics> statistics_before;
+		lib::vector<graphics::mesh_optimizer::statistics> statistics_after;
+
+		// Guards the output vectors
+		std::mutex bookkeeping_mutex;
+	};
+
 	constexpr static char roughness_map_key[] = "map_roughness";
 	constexpr static char metallic_map_key[] = "map_metallic";
 	constexpr static char anisotropy_map_key[] = "map_anisotropy";
@@ -72,6 +104,7 @@ private:
 	static ste::task_future<void> load_texture(const ste_context &,
 											   const std::string &,
 											   bool srgb,
+											   bool is_normal_map,
 											   bool is_displacement_map,
 											   graphics::scene_properties *,
 											   texture_map_type *texmap,
@@ -84,18 +117,29 @@ private:
 															 texture_map_type &tex_map,
 															 const std::experimental::filesystem::path &dir,
 															 float normal_map_bias);
-	static ste::task_future<void> process_model_mesh(const ste_context &ctx,
-													 graphics::scene_properties *,
-                                                     const vertex_attrib_type &attrib,
-													 const tinyobj::shape_t &,
-													 graphics::object_group *,
-													 materials_type &,
-													 texture_map_type &,
-									 				 lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
-													 lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
-									 				 lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects);
+	static model_factory_mesh process_model_mesh(const vertex_attrib_type &attrib,
+												 const tinyobj::shape_t &,
+												 const graphics::mesh_optimizer::options &,
+												 graphics::mesh_optimizer::statistics *before,
+												 graphics::mesh_optimizer::statistics *after);
+	static void create_model_object(const ste_context &ctx,
+									graphics::scene_properties *,
+									const tinyobj::shape_t &,
+									graphics::object_group *,
+									materials_type &,
+									const texture_map_type &,
+									model_factory_mesh &&mesh,
+									std::mutex &bookkeeping_mutex,
+									lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
+									lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
+									lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects);
 
 public:
+	/**
+	 *	@brief	Loads an OBJ model asynchronously, creating its objects and materials and adding them to the object group.
+	 *
+	 *	@param	mesh_optimization	Vertex cache, overdraw and vertex fetch optimization of the processed meshes
+	 */
 	static ste::task_future<void> load_model_async(const ste_context &ctx,
 												   const std::experimental::filesystem::path &file_path,
 												   graphics::object_group *object_group,
@@ -103,7 +147,8 @@ public:
 												   float normal_map_bias,
 												   lib::vector<lib::unique_ptr<graphics::material>> &loaded_materials,
 												   lib::vector<lib::unique_ptr<graphics::material_layer>> &loaded_material_layers,
-												   lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects = nullptr);
+												   lib::vector<lib::shared_ptr<graphics::object>> *loaded_objects = nullptr,
+												   const graphics::mesh_optimizer::options &mesh_optimization = {});
 };
 
 }
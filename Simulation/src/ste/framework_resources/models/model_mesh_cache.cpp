@@ -0,0 +1,301 @@
+
+#include <stdafx.hpp>
+#include <model_mesh_cache.hpp>
+
+#include <mapped_file.hpp>
+#include <log.hpp>
+
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+
+using namespace ste;
+using namespace ste::resource;
+
+namespace ste::resource::_detail {
+
+struct model_mesh_cache_header {
+	static constexpr std::uint32_t magic_value = 0x4D455453;	// "STEM"
+
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t vertex_size;
+	std::uint32_t shapes_count;
+	std::int64_t source_mtime;
+	std::uint64_t source_size;
+	std::uint32_t materials_count;
+	std::uint32_t processing_key;
+};
+
+// Vertex data is aligned to the vertex size
+static constexpr std::size_t model_mesh_cache_data_alignment = 16;
+
+/**
+ *	@brief	Appends plain data to a byte buffer
+ */
+class model_mesh_cache_writer {
+private:
+	lib::vector<char> &buf;
+
+public:
+	model_mesh_cache_writer(lib::vector<char> &buf) : buf(buf) {}
+
+	void write(const void *data, std::size_t size) {
+		const auto *p = reinterpret_cast<const char*>(data);
+		buf.insert(buf.end(), p, p + size);
+	}
+	template <typename T>
+	void write(const T &t) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		write(&t, sizeof(T));
+	}
+	void write(const std::string &str) {
+		write(static_cast<std::uint32_t>(str.size()));
+		write(str.data(), str.size());
+	}
+	void align(std::size_t alignment) {
+		buf.resize((buf.size() + alignment - 1) / alignment * alignment, 0);
+	}
+};
+
+/**
+ *	@brief	Bounds checked reads of plain data from a memory range
+ */
+class model_mesh_cache_reader {
+private:
+	const char *begin;
+	const char *end;
+	const char *ptr;
+
+public:
+	model_mesh_cache_reader(const char *data, std::size_t size) : begin(data), end(data + size), ptr(data) {}
+
+	bool read(void *data, std::size_t size) {
+		if (static_cast<std::size_t>(end - ptr) < size)
+			return false;
+		std::memcpy(data, ptr, size);
+		ptr += size;
+		return true;
+	}
+	template <typename T>
+	bool read(T &t) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		return read(&t, sizeof(T));
+	}
+	bool read(std::string &str) {
+		std::uint32_t size;
+		if (!read(size) || static_cast<std::size_t>(end - ptr) < size)
+			return false;
+		str.assign(ptr, size);
+		ptr += size;
+		return true;
+	}
+	template <typename T>
+	bool read(lib::vector<T> &v, std::size_t count) {
+		if (static_cast<std::size_t>(end - ptr) / sizeof(T) < count)
+			return false;
+		v.resize(count);
+		return read(v.data(), count * sizeof(T));
+	}
+	bool align(std::size_t alignment) {
+		const auto offset = static_cast<std::size_t>(ptr - begin);
+		const auto aligned = (offset + alignment - 1) / alignment * alignment;
+		if (static_cast<std::size_t>(end - begin) < aligned)
+			return false;
+		ptr = begin + aligned;
+		return true;
+	}
+};
+
+auto model_mesh_cache_source_key(const std::experimental::filesystem::path &model_path) {
+	const auto mtime = std::experimental::filesystem::last_write_time(model_path).time_since_epoch().count();
+	const auto size = std::experimental::filesystem::file_size(model_path);
+
+	return std::make_pair(static_cast<std::int64_t>(mtime), static_cast<std::uint64_t>(size));
+}
+
+}
+
+std::experimental::filesystem::path model_mesh_cache::cache_path(const std::experimental::filesystem::path &model_path) {
+	auto p = model_path;
+	p += extension;
+	return p;
+}
+
+optional<model_mesh_cache::model> model_mesh_cache::read(const std::experimental::filesystem::path &model_path,
+														std::uint32_t processing_key) {
+	using namespace _detail;
+
+	const auto path = cache_path(model_path);
+
+	std::error_code err;
+	if (!std::experimental::filesystem::exists(path, err))
+		return none;
+
+	try {
+		const auto source_key = model_mesh_cache_source_key(model_path);
+
+		const mapped_file map(path, mapped_file::access::read_only);
+		if (!map.is_mapped())
+			return none;
+
+		model_mesh_cache_reader reader(map.data(), map.size());
+
+		model_mesh_cache_header header;
+		if (!reader.read(header) ||
+			header.magic != model_mesh_cache_header::magic_value ||
+			header.version != format_version ||
+			header.vertex_size != sizeof(graphics::object_vertex_data) ||
+			header.processing_key != processing_key ||
+			header.source_mtime != source_key.first ||
+			header.source_size != source_key.second) {
+			// Stale or foreign
+			return none;
+		}
+
+		model m;
+
+		// Materials
+		m.materials.resize(header.materials_count);
+		for (auto &mat : m.materials) {
+			std::uint32_t parameters_count;
+			if (!reader.read(mat.name) ||
+				!reader.read(mat.diffuse_texname) ||
+				!reader.read(mat.specular_texname) ||
+				!reader.read(mat.bump_texname) ||
+				!reader.read(mat.displacement_texname) ||
+				!reader.read(mat.alpha_texname) ||
+				!reader.read(parameters_count))
+				return none;
+
+			for (std::uint32_t i = 0; i < parameters_count; ++i) {
+				std::string k, v;
+				if (!reader.read(k) || !reader.read(v))
+					return none;
+				mat.unknown_parameter.emplace(std::move(k), std::move(v));
+			}
+		}
+
+		// Shapes and meshes
+		m.shapes.resize(header.shapes_count);
+		m.meshes.resize(header.shapes_count);
+		for (std::uint32_t s = 0; s < header.shapes_count; ++s) {
+			auto &shape = m.shapes[s];
+			auto &mesh = m.meshes[s];
+
+			std::int32_t material_id;
+			std::uint32_t vertices_count, indices_count, meshlets_count;
+			if (!reader.read(shape.name) ||
+				!reader.read(material_id) ||
+				!reader.read(vertices_count) ||
+				!reader.read(indices_count) ||
+				!reader.read(meshlets_count))
+				return none;
+			if (material_id >= static_cast<std::int32_t>(header.materials_count))
+				return none;
+			shape.mesh.material_ids.push_back(material_id);
+
+			if (!reader.align(model_mesh_cache_data_alignment) ||
+				!reader.read(mesh.vertices, vertices_count) ||
+				!reader.read(mesh.indices, indices_count) ||
+				!reader.read(mesh.meshlets, meshlets_count))
+				return none;
+
+			// Out-of-range indices in a corrupt cache would reach the GPU
+			for (auto &i : mesh.indices) {
+				if (i >= vertices_count)
+					return none;
+			}
+			for (auto &m : mesh.meshlets) {
+				if (m.first_index > indices_count || m.index_count > indices_count - m.first_index)
+					return none;
+			}
+		}
+
+		return std::move(m);
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't read model cache " << path.string() << ": " << e.what() << std::endl;
+	}
+
+	return none;
+}
+
+void model_mesh_cache::write(const std::experimental::filesystem::path &model_path,
+							 std::uint32_t processing_key,
+							 const std::vector<tinyobj::shape_t> &shapes,
+							 const std::vector<tinyobj::material_t> &materials,
+							 const lib::vector<mesh> &meshes) {
+	using namespace _detail;
+
+	assert(shapes.size() == meshes.size());
+
+	const auto path = cache_path(model_path);
+	auto temp_path = path;
+	temp_path += ".tmp";
+
+	try {
+		const auto source_key = model_mesh_cache_source_key(model_path);
+
+		lib::vector<char> buf;
+		model_mesh_cache_writer writer(buf);
+
+		model_mesh_cache_header header = {};
+		header.magic = model_mesh_cache_header::magic_value;
+		header.version = format_version;
+		header.vertex_size = sizeof(graphics::object_vertex_data);
+		header.shapes_count = static_cast<std::uint32_t>(shapes.size());
+		header.source_mtime = source_key.first;
+		header.source_size = source_key.second;
+		header.materials_count = static_cast<std::uint32_t>(materials.size());
+		header.processing_key = processing_key;
+		writer.write(header);
+
+		for (auto &mat : materials) {
+			writer.write(mat.name);
+			writer.write(mat.diffuse_texname);
+			writer.write(mat.specular_texname);
+			writer.write(mat.bump_texname);
+			writer.write(mat.displacement_texname);
+			writer.write(mat.alpha_texname);
+
+			writer.write(static_cast<std::uint32_t>(mat.unknown_parameter.size()));
+			for (auto &p : mat.unknown_parameter) {
+				writer.write(p.first);
+				writer.write(p.second);
+			}
+		}
+
+		for (std::size_t s = 0; s < shapes.size(); ++s) {
+			const auto &shape = shapes[s];
+			const auto &mesh = meshes[s];
+			const std::int32_t material_id = shape.mesh.material_ids.size() > 0 ? shape.mesh.material_ids[0] : -1;
+
+			writer.write(shape.name);
+			writer.write(material_id);
+			writer.write(static_cast<std::uint32_t>(mesh.vertices.size()));
+			writer.write(static_cast<std::uint32_t>(mesh.indices.size()));
+			writer.write(static_cast<std::uint32_t>(mesh.meshlets.size()));
+
+			writer.align(model_mesh_cache_data_alignment);
+			writer.write(mesh.vertices.data(), mesh.vertices.size() * sizeof(graphics::object_vertex_data));
+			writer.write(mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t));
+			writer.write(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(graphics::mesh_meshlet));
+		}
+
+		// Write to a temporary and rename, readers never see partially written caches
+		{
+			std::ofstream f(temp_path.string(), std::ios::binary | std::ios::trunc);
+			f.write(buf.data(), buf.size());
+			if (!f)
+				throw std::runtime_error("Write failed");
+		}
+		std::experimental::filesystem::rename(temp_path, path);
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't write model cache " << path.string() << ": " << e.what() << std::endl;
+
+		std::error_code err;
+		std::experimental::filesystem::remove(temp_path, err);
+	}
+}
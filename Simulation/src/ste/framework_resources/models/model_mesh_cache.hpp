@@ -0,0 +1,73 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <object_vertex_data.hpp>
+#include <mesh_meshlets.hpp>
+
+#include <filesystem>
+
+#include <optional.hpp>
+#include <lib/vector.hpp>
+
+#include <tiny_obj_loader.h>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	Versioned binary cache of a model's processed meshes and material texture references, allowing models to be
+ *			loaded without parsing the source file.
+ *
+ *	The cache file is stored beside the model and is keyed by the model's modification time and size, and by a key
+ *	identifying the mesh processing options, e.g. mesh_optimizer::options::key(). It stores, per
+ *	shape, the final vertex and index data, ready for upload, the meshlets and the shape's material. Materials keep only the texture
+ *	references model_factory uses.
+ *	Cache files are written once and read via a memory mapping. Stale, corrupt or foreign cache files are ignored.
+ */
+class model_mesh_cache {
+public:
+	static constexpr std::uint32_t format_version = 3;
+	static constexpr auto extension = ".stemesh";
+
+	struct mesh {
+		lib::vector<graphics::object_vertex_data> vertices;
+		lib::vector<std::uint32_t> indices;
+		lib::vector<graphics::mesh_meshlet> meshlets;
+	};
+
+	struct model {
+		// Shapes names and material ids
+		std::vector<tinyobj::shape_t> shapes;
+		// Materials texture references and unknown parameters
+		std::vector<tinyobj::material_t> materials;
+		// Per shape
+		lib::vector<mesh> meshes;
+	};
+
+private:
+	static std::experimental::filesystem::path cache_path(const std::experimental::filesystem::path &model_path);
+
+public:
+	/**
+	 *	@brief	Reads the cache of a model, if a valid cache exists.
+	 */
+	static optional<model> read(const std::experimental::filesystem::path &model_path,
+								std::uint32_t processing_key);
+
+	/**
+	 *	@brief	Writes the cache of a model. Failures are logged and are not fatal.
+	 *
+	 *	@param	meshes	Processed meshes, per shape
+	 */
+	static void write(const std::experimental::filesystem::path &model_path,
+					  std::uint32_t processing_key,
+					  const std::vector<tinyobj::shape_t> &shapes,
+					  const std::vector<tinyobj::material_t> &materials,
+					  const lib::vector<mesh> &meshes);
+};
+
+}
+}
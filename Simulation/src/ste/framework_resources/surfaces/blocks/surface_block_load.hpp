@@ -7,6 +7,7 @@
 #include <surface_block.hpp>
 
 #include <immintrin.h>
+#include <cstring>
 
 #ifndef __AVX2__
 #define __AVX2__
@@ -43,6 +44,36 @@ static constexpr block_load_8component_result_type block_load_8component_type_fo
 template <typename common_type>
 using block_load_8component_result_t = block_load_8component_result_impl<block_load_8component_type_for_block<common_type>, common_type>;
 
+/**
+*	@brief	Reads a component, of up to 32 bits, of count consecutive blocks into the lanes of an __m256i. The component
+*			is in the low bits of each lane, the remaining bits are unspecified.
+*			Gathers the 8 components when reading whole 32-bit words stays within the blocks, otherwise reads only the
+*			component's bytes of each block.
+*/
+template <unsigned offset_bits, unsigned size_bits>
+__m256i block_avx_8_load_lanes(const std::uint8_t *data, std::size_t stride, unsigned count) {
+	static constexpr unsigned shift = offset_bits % 8;
+	static constexpr unsigned bytes = (shift + size_bits + 7) / 8;
+	static_assert(bytes <= 8);
+
+	if constexpr (shift + size_bits <= 32) {
+		if (count == 8 && offset_bits / 8 + 4 <= stride) {
+			const auto index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+												  _mm256_set1_epi32(static_cast<std::int32_t>(stride)));
+			const auto words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data + offset_bits / 8), index, 1);
+			return _mm256_srli_epi32(words, shift);
+		}
+	}
+
+	alignas(32) std::int32_t lanes[8] = {};
+	for (unsigned i = 0; i < count; ++i) {
+		std::uint64_t b = 0;
+		std::memcpy(&b, data + i * stride + offset_bits / 8, bytes);
+		lanes[i] = static_cast<std::int32_t>(b >> shift);
+	}
+	return _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+}
+
 // Loader into an fp32 __m256. Source size limited to 32bit.
 template <block_type type, unsigned size_bits>
 struct block_avx_8_fp32_loader {
@@ -55,12 +86,7 @@ struct block_avx_8_fp32_loader<block_type::block_fp, 32> {
 
 	template <unsigned offset_bits>
 	static __m256 load(const std::uint8_t *data, std::size_t stride, unsigned count) {
-		__m256 res;
-		for (unsigned i = 0; i < count; ++i) {
-			auto b = *reinterpret_cast<const std::uint64_t*>(data + i * stride + offset_bits / 8) >> (offset_bits % 8);
-			res.m256_f32[i] = *reinterpret_cast<const float*>(&b);
-		}
-		return res;
+		return _mm256_castsi256_ps(block_avx_8_load_lanes<offset_bits, 32>(data, stride, count));
 	}
 };
 
@@ -71,11 +97,7 @@ struct block_avx_8_fp32_loader<block_type::block_sscaled, size_bits> {
 
 	template <unsigned offset_bits>
 	static __m256 load(const std::uint8_t *data, std::size_t stride, unsigned count) {
-		__m256i res;
-		for (unsigned i = 0; i < count; ++i) {
-			auto b = *reinterpret_cast<const std::uint64_t*>(data + i * stride + offset_bits / 8) >> (offset_bits % 8);
-			res.m256i_i32[i] = *reinterpret_cast<const std::int32_t*>(&b);
-		}
+		auto res = block_avx_8_load_lanes<offset_bits, size_bits>(data, stride, count);
 
 		// Convert
 		return _mm256_cvtepi32_ps(res);
@@ -90,11 +112,7 @@ struct block_avx_8_fp32_loader<block_type::block_unorm, size_bits> {
 	template <unsigned offset_bits>
 	static __m256 load(const std::uint8_t *data, std::size_t stride, unsigned count) {
 		const auto mask = (1ull << size_bits) - 1ull;
-		__m256i res;
-		for (unsigned i = 0; i < count; ++i) {
-			auto b = *reinterpret_cast<const std::uint64_t*>(data + i * stride + offset_bits / 8) >> (offset_bits % 8);
-			res.m256i_i32[i] = *reinterpret_cast<const std::int32_t*>(&b);
-		}
+		auto res = block_avx_8_load_lanes<offset_bits, size_bits>(data, stride, count);
 
 		// Mask
 		const auto mask256 = _mm256_set1_epi32(*reinterpret_cast<const std::int32_t*>(&mask));
@@ -159,11 +177,7 @@ struct block_avx_8_i32_loader<block_type::block_sint, size_bits> {
 	template <unsigned offset_bits>
 	static __m256i load(const std::uint8_t *data, std::size_t stride, unsigned count) {
 		const auto mask = (1ull << size_bits) - 1ull;
-		__m256i res;
-		for (unsigned i = 0; i < count; ++i) {
-			auto b = *reinterpret_cast<const std::uint64_t*>(data + i * stride + offset_bits / 8) >> (offset_bits % 8);
-			res.m256i_i32[i] = *reinterpret_cast<const std::int32_t*>(&b);
-		}
+		auto res = block_avx_8_load_lanes<offset_bits, size_bits>(data, stride, count);
 
 		// Mask
 		const auto mask256 = _mm256_set1_epi32(*reinterpret_cast<const std::int32_t*>(&mask));
@@ -196,11 +210,11 @@ __m256 load_block_8_components_fp32(const Block *block, unsigned count = 8) {
 		return _detail::block_avx_8_fp32_loader<type, size_bits>::template load<offset_bits>(data, stride, count);
 	}
 	else {
-		__m256 res;
+		alignas(32) float lanes[8] = {};
 		for (unsigned i = 0; i < count; ++i)
-			res.m256_f32[i] = (block + i)->template component<Block::template index_for_component<component>()>();
+			lanes[i] = (block + i)->template component<Block::template index_for_component<component>()>();
 
-		return res;
+		return _mm256_load_ps(lanes);
 	}
 }
 
@@ -229,11 +243,11 @@ __m256i load_block_8_components_i32(const Block *block, unsigned count = 8) {
 		return _detail::block_avx_8_i32_loader<type, size_bits>::template load<offset_bits>(data, stride, count);
 	}
 	else {
-		__m256i res;
+		alignas(32) std::int32_t lanes[8] = {};
 		for (unsigned i = 0; i < count; ++i)
-			res.m256i_i32[i] = (block + i)->template component<Block::template index_for_component<component>()>();
+			lanes[i] = (block + i)->template component<Block::template index_for_component<component>()>();
 
-		return res;
+		return _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
 	}
 }
 
@@ -7,6 +7,7 @@
 #include <surface_block.hpp>
 
 #include <immintrin.h>
+#include <cstring>
 
 #ifndef __AVX2__
 #define __AVX2__
@@ -21,6 +22,31 @@ namespace resource {
 
 namespace _detail {
 
+/**
+*	@brief	Writes the low size_bits bits of the first count lanes of an __m256i into a component, of up to 32 bits, of
+*			count consecutive blocks. Preserves the remaining bits of the blocks.
+*/
+template <unsigned offset_bits, unsigned size_bits>
+void block_avx_8_store_lanes(__m256i input, std::uint8_t *data, std::size_t stride, unsigned count) {
+	static constexpr unsigned shift = offset_bits % 8;
+	static constexpr unsigned bytes = (shift + size_bits + 7) / 8;
+	static_assert(bytes <= 8);
+
+	const auto m = ((1ull << size_bits) - 1ull) << shift;
+
+	alignas(32) std::uint32_t lanes[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), input);
+	for (unsigned i = 0; i < count; ++i) {
+		auto *dst = data + i * stride + offset_bits / 8;
+		std::uint64_t val = 0;
+		std::memcpy(&val, dst, bytes);
+
+		// Zero out bits and write new bits
+		val = (val & ~m) | ((static_cast<std::uint64_t>(lanes[i]) << shift) & m);
+		std::memcpy(dst, &val, bytes);
+	}
+}
+
 // Stores from an fp32 __m256. Source size limited to 32bit.
 template <block_type type, unsigned size_bits>
 struct block_avx_8_fp32_store {
@@ -34,18 +60,7 @@ struct block_avx_8_fp32_store<block_type::block_fp, 32> {
 
 	template <unsigned offset_bits>
 	static void store(__m256 input, std::uint8_t *data, std::size_t stride, unsigned count) {
-		const auto mask = (1ull << size_bits) - 1ull;
-		for (unsigned i = 0; i < count; ++i) {
-			const auto r = input.m256_f32[i];
-
-			auto m = mask << (offset_bits % 8);
-			auto &val = *reinterpret_cast<std::uint64_t*>(data + i * stride + offset_bits / 8);
-
-			// Zero out bits
-			val &= ~m;
-			// Write new bits
-			val += (*reinterpret_cast<const std::uint64_t*>(&r) << (offset_bits % 8)) & m;
-		}
+		block_avx_8_store_lanes<offset_bits, size_bits>(_mm256_castps_si256(input), data, stride, count);
 	}
 };
 
@@ -56,21 +71,9 @@ struct block_avx_8_fp32_store<block_type::block_sscaled, size_bits> {
 
 	template <unsigned offset_bits>
 	static void store(__m256 input, std::uint8_t *data, std::size_t stride, unsigned count) {
-		const auto mask = (1ull << size_bits) - 1ull;
-
 		// Round and convert to integers
 		const auto input_i256 = _mm256_cvtps_epi32(_mm256_round_ps(input, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
-		for (unsigned i = 0; i < count; ++i) {
-			const auto r = input_i256.m256i_i32[i];
-
-			auto m = mask << (offset_bits % 8);
-			auto &val = *reinterpret_cast<std::uint64_t*>(data + i * stride + offset_bits / 8);
-
-			// Zero out bits
-			val &= ~m;
-			// Write new bits
-			val += (*reinterpret_cast<const std::uint64_t*>(&r) << (offset_bits % 8)) & m;
-		}
+		block_avx_8_store_lanes<offset_bits, size_bits>(input_i256, data, stride, count);
 	}
 };
 
@@ -89,17 +92,7 @@ struct block_avx_8_fp32_store<block_type::block_unorm, size_bits> {
 		input = _mm256_mul_ps(input, _mm256_set1_ps(static_cast<float>(mask)));
 		const auto input_i256 = _mm256_cvtps_epi32(_mm256_round_ps(input, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
 
-		for (unsigned i = 0; i < count; ++i) {
-			const auto r = input_i256.m256i_i32[i];
-
-			auto m = mask << (offset_bits % 8);
-			auto &val = *reinterpret_cast<std::uint64_t*>(data + i * stride + offset_bits / 8);
-
-			// Zero out bits
-			val &= ~m;
-			// Write new bits
-			val += (*reinterpret_cast<const std::uint64_t*>(&r) << (offset_bits % 8)) & m;
-		}
+		block_avx_8_store_lanes<offset_bits, size_bits>(input_i256, data, stride, count);
 	}
 };
 
@@ -132,17 +125,7 @@ struct block_avx_8_fp32_store<block_type::block_srgb, size_bits> {
 		input = _mm256_mul_ps(input, _mm256_set1_ps(static_cast<float>(mask)));
 		const auto input_i256 = _mm256_cvtps_epi32(_mm256_round_ps(input, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
 
-		for (unsigned i = 0; i < count; ++i) {
-			const auto r = input_i256.m256i_i32[i];
-
-			auto m = mask << (offset_bits % 8);
-			auto &val = *reinterpret_cast<std::uint64_t*>(data + i * stride + offset_bits / 8);
-
-			// Zero out bits
-			val &= ~m;
-			// Write new bits
-			val += (*reinterpret_cast<const std::uint64_t*>(&r) << (offset_bits % 8)) & m;
-		}
+		block_avx_8_store_lanes<offset_bits, size_bits>(input_i256, data, stride, count);
 	}
 };
 
@@ -159,19 +142,7 @@ struct block_avx_8_i32_store<block_type::block_sint, size_bits> {
 
 	template <unsigned offset_bits>
 	static void store(__m256i input, std::uint8_t *data, std::size_t stride, unsigned count) {
-		const auto mask = (1ull << size_bits) - 1ull;
-
-		for (unsigned i = 0; i < count; ++i) {
-			const auto r = input.m256i_i32[i];
-
-			auto m = mask << (offset_bits % 8);
-			auto &val = *reinterpret_cast<std::uint64_t*>(data + i * stride + offset_bits / 8);
-
-			// Zero out bits
-			val &= ~m;
-			// Write new bits
-			val += (*reinterpret_cast<const std::uint64_t*>(&r) << (offset_bits % 8)) & m;
-		}
+		block_avx_8_store_lanes<offset_bits, size_bits>(input, data, stride, count);
 	}
 };
 
@@ -199,8 +170,10 @@ void store_block_8_components_fp32(Block *block, __m256 data, unsigned count = 8
 		return _detail::block_avx_8_fp32_store<type, size_bits>::template store<offset_bits>(data, dst, stride, count);
 	}
 	else {
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, data);
 		for (unsigned i = 0; i < count; ++i)
-			(block + i)->template component<Block::template index_for_component<component>()>() = static_cast<typename Block::common_type>(data.m256_f32[i]);
+			(block + i)->template component<Block::template index_for_component<component>()>() = static_cast<typename Block::common_type>(lanes[i]);
 	}
 }
 
@@ -227,12 +200,12 @@ void store_block_8_components_fp32(Block *block, __m256i data, unsigned count =
 */
 template <gl::component_swizzle component, typename src_type, typename Block>
 void store_block_8_components_f32(Block *block, const src_type data[8], unsigned count = 8) {
-	__m256 input;
-	for (int i = 0; i < count; ++i)
-		input.m256_f32[i] = static_cast<float>(data[i]);
+	alignas(32) float lanes[8] = {};
+	for (unsigned i = 0; i < count; ++i)
+		lanes[i] = static_cast<float>(data[i]);
 
 	store_block_8_components_f32(block,
-								 input,
+								 _mm256_load_ps(lanes),
 								 count);
 }
 
@@ -260,8 +233,10 @@ void store_block_8_components_i32(Block *block, __m256i data, unsigned count = 8
 		return _detail::block_avx_8_i32_store<type, size_bits>::template store<offset_bits>(data, dst, stride, count);
 	}
 	else {
+		alignas(32) std::int32_t lanes[8];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), data);
 		for (unsigned i = 0; i < count; ++i)
-			(block + i)->template component<Block::template index_for_component<component>()>() = static_cast<typename Block::common_type>(data.m256i_i32[i]);
+			(block + i)->template component<Block::template index_for_component<component>()>() = static_cast<typename Block::common_type>(lanes[i]);
 	}
 }
 
@@ -288,12 +263,12 @@ void store_block_8_components_i32(Block *block, __m256 data, unsigned count = 8)
 */
 template <gl::component_swizzle component, typename src_type, typename Block>
 void store_block_8_components_i32(Block *block, const src_type data[8], unsigned count = 8) {
-	__m256i input;
-	for (int i = 0; i < count; ++i)
-		input.m256i_i32[i] = static_cast<std::int32_t>(data[i]);
+	alignas(32) std::int32_t lanes[8] = {};
+	for (unsigned i = 0; i < count; ++i)
+		lanes[i] = static_cast<std::int32_t>(data[i]);
 
 	store_block_8_components_i32(block,
-								 input,
+								 _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes)),
 								 count);
 }
 
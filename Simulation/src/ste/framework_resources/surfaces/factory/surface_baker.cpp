@@ -0,0 +1,82 @@
+
+#include <stdafx.hpp>
+#include <surface_baker.hpp>
+
+#include <surface_io.hpp>
+#include <surface_utilities.hpp>
+
+#include <log.hpp>
+
+using namespace ste;
+using namespace ste::resource;
+
+std::experimental::filesystem::path surface_baker::cache_path(const std::experimental::filesystem::path &source_path) {
+	auto p = source_path;
+	p += extension;
+	return p;
+}
+
+gl::format surface_baker::baked_format(usage u) {
+	switch (u) {
+	case usage::albedo:
+		return gl::format::bc7_srgb_block;
+	case usage::normal_map:
+		return gl::format::bc5_unorm_block;
+	case usage::mask:
+		return gl::format::bc4_unorm_block;
+	case usage::generic:
+	default:
+		return gl::format::bc7_unorm_block;
+	}
+}
+
+void surface_baker::log_baked(const opaque_surface<2> &baked, std::chrono::high_resolution_clock::duration elapsed) {
+	const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+	ste_log() << "Baked surface (" << baked.extent().x << " X " << baked.extent().y << ", " << static_cast<std::uint32_t>(baked.levels()) << " levels) into "
+		<< static_cast<std::size_t>(baked.bytes()) << " bytes in " << ms.count() << "ms" << std::endl;
+}
+
+optional<opaque_surface<2>> surface_baker::read_cache(const std::experimental::filesystem::path &source_path) {
+	const auto path = cache_path(source_path);
+
+	std::error_code err;
+	if (!std::experimental::filesystem::exists(path, err))
+		return none;
+
+	try {
+		// Stale caches are ignored
+		if (std::experimental::filesystem::last_write_time(path) < std::experimental::filesystem::last_write_time(source_path))
+			return none;
+
+		auto surface = surface_io::load_surface_2d(path);
+		if (!surface_bc_encoder::is_supported(surface.surface_format()) ||
+			surface.levels() != surface_utilities::max_levels(surface.extent()))
+			return none;
+
+		return std::move(surface);
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't read baked surface " << path.string() << ": " << e.what() << std::endl;
+	}
+
+	return none;
+}
+
+void surface_baker::write_cache(const std::experimental::filesystem::path &source_path,
+								const opaque_surface<2> &surface) {
+	const auto path = cache_path(source_path);
+	auto temp_path = path;
+	temp_path += ".tmp";
+
+	try {
+		// Write to a temporary and rename, readers never see partially written caches
+		surface_io::write_surface(surface, temp_path, surface_write_file_format::ktx);
+		std::experimental::filesystem::rename(temp_path, path);
+	}
+	catch (const std::exception &e) {
+		ste_log_warn() << "Couldn't write baked surface " << path.string() << ": " << e.what() << std::endl;
+
+		std::error_code err;
+		std::experimental::filesystem::remove(temp_path, err);
+	}
+}
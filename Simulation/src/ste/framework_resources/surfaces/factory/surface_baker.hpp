@@ -0,0 +1,138 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <format.hpp>
+
+#include <surface_type_traits.hpp>
+#include <opaque_surface.hpp>
+#include <surface_convert.hpp>
+#include <surface_mipmap.hpp>
+#include <surface_bc_encoder.hpp>
+#include <surface_stream_decoder.hpp>
+#include <task_scheduler.hpp>
+
+#include <optional.hpp>
+#include <filesystem>
+#include <chrono>
+#include <type_traits>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	Offline baking of textures into block-compressed surfaces with complete mipmap chains.
+ *
+ *	Baking generates the mipmap chain on the CPU, see surface_mipmap, and encodes all levels with surface_bc_encoder,
+ *	choosing the block-compressed format by the texture's usage. Baked surfaces are cached beside the source file as
+ *	KTX files and are considered stale once the source is modified.
+ */
+class surface_baker {
+public:
+	static constexpr auto extension = ".baked.ktx";
+
+	enum class usage {
+		// sRGB color, encoded as BC7
+		albedo,
+		// Tangent-space normal map, encoded as BC5. Only the xy components are kept.
+		normal_map,
+		// Single component map, encoded as BC4
+		mask,
+		// Linear color, encoded as BC7
+		generic,
+	};
+
+private:
+	static std::experimental::filesystem::path cache_path(const std::experimental::filesystem::path &source_path);
+	static void log_baked(const opaque_surface<2> &baked, std::chrono::high_resolution_clock::duration elapsed);
+
+	template <gl::format format>
+	static auto encode(surface_2d<format> &&surface, usage u, task_scheduler &sched, bool normal_map = false) {
+		return surface_bc_encoder::encode_2d(baked_format(u),
+											 surface_mipmap::generate_2d(std::move(surface), normal_map),
+											 sched);
+	}
+
+	template <gl::format format>
+	using format_constant = std::integral_constant<gl::format, format>;
+
+	// Bakes the surface returned by load(format_constant<format>()), which loads the source in the format the usage is
+	// encoded from.
+	template <typename Loader>
+	static opaque_surface<2> bake_internal(Loader &&load,
+										   usage u,
+										   task_scheduler &sched) {
+		const auto start_time = std::chrono::high_resolution_clock::now();
+
+		auto baked = [&]() {
+			switch (u) {
+			case usage::albedo:
+				return encode(load(format_constant<gl::format::r8g8b8a8_srgb>()), u, sched);
+			case usage::normal_map:
+				return encode(load(format_constant<gl::format::r8g8b8a8_unorm>()), u, sched, true);
+			case usage::mask:
+				return encode(load(format_constant<gl::format::r8_unorm>()), u, sched);
+			case usage::generic:
+			default:
+				return encode(load(format_constant<gl::format::r8g8b8a8_unorm>()), u, sched);
+			}
+		}();
+
+		log_baked(baked, std::chrono::high_resolution_clock::now() - start_time);
+
+		return baked;
+	}
+
+public:
+	/**
+	 *	@brief	Returns the block-compressed format surfaces of the usage are baked into
+	 */
+	static gl::format baked_format(usage u);
+
+	/**
+	 *	@brief	Bakes a 2D surface, opaque or typed. Only the top level of the input surface is used.
+	 *
+	 *	@throws	surface_convert_format_mismatch_error	If the surface format can not be converted for the usage
+	 */
+	template <typename Surface>
+	static opaque_surface<2> bake(Surface &&surface,
+								  usage u,
+								  task_scheduler &sched) {
+		static_assert(is_surface_v<Surface> || is_opaque_surface_v<Surface>);
+
+		return bake_internal([&](auto target) {
+			return surface_convert::convert_2d<decltype(target)::value>(std::forward<Surface>(surface));
+		}, u, sched);
+	}
+
+	/**
+	 *	@brief	Bakes a 2D surface stream. The stream is decoded straight into the format the usage is encoded from.
+	 *
+	 *	@throws	surface_error							On decoding failures
+	 *	@throws	surface_convert_format_mismatch_error	If the surface format can not be converted for the usage
+	 */
+	static opaque_surface<2> bake(surface_stream_decoder_2d &decoder,
+								  usage u,
+								  task_scheduler &sched) {
+		return bake_internal([&](auto target) {
+			return decoder.decode_surface<decltype(target)::value>(sched);
+		}, u, sched);
+	}
+
+	/**
+	 *	@brief	Reads the baked surface of a source file, if a valid, up-to-date, cache exists.
+	 *			The caller should verify the baked format matches the intended usage, see baked_format().
+	 */
+	static optional<opaque_surface<2>> read_cache(const std::experimental::filesystem::path &source_path);
+
+	/**
+	 *	@brief	Writes the baked surface of a source file. Failures are logged and are not fatal.
+	 */
+	static void write_cache(const std::experimental::filesystem::path &source_path,
+							const opaque_surface<2> &surface);
+};
+
+}
+}
@@ -26,6 +26,8 @@
 #include <device_image_capabilities_query.hpp>
 
 #include <lib/string.hpp>
+#include <lib/unique_ptr.hpp>
+#include <chrono>
 
 namespace ste {
 namespace resource {
@@ -35,16 +37,15 @@ private:
 	using image_allocation_policy = gl::device_resource_allocation_policy_device;
 
 private:
-	// Create an image object, fills it with data from input surface and generates mipmap.
-	template <int dimensions, gl::format image_format, typename Surface>
-	static auto _image_from_surface_fill_internal(const ste_context& ctx,
-												  const lib::string &name,
-	                                              Surface&& source,
-	                                              const gl::image_usage& usage,
-	                                              const gl::image_layout& layout,
-	                                              bool generate_mipmaps = true) {
-		static_assert(resource::is_surface_v<Surface>);
-
+	// Create an image object, checking device support for the format, extent, levels and layers.
+	template <int dimensions>
+	static auto _image_create_internal(const ste_context& ctx,
+									   const lib::string &name,
+									   gl::format image_format,
+									   const gl::image_extent_type_t<dimensions> &extent,
+									   levels_t mip_levels,
+									   layers_t layers,
+									   const gl::image_usage& usage) {
 		// Check optimal tiling support
 		const auto format_properties = gl::device_image_format_query(ctx.device()->get_physical_device_descriptor(),
 																	 image_format,
@@ -53,15 +54,6 @@ private:
 			throw surface_unsupported_format_error("Required surface format with specified usages is unsupported by device");
 		}
 
-		// Convert surface to target image_format
-		auto surface = surface_convert::convert<image_format>(std::move(source));
-
-		auto layers = surface.layers();
-		auto extent = surface.extent();
-
-		auto m = surface.levels();
-		auto mip_levels = generate_mipmaps ? surface_utilities::max_levels(extent) : m;
-
 		gl::device_image_flags flags = gl::device_image_flags::none;
 		if (!format_properties.optimal_tiling)	flags = flags | gl::device_image_flags::linear_tiling;
 
@@ -80,23 +72,25 @@ private:
 		}
 
 		// Create image
-		gl::device_image<dimensions, image_allocation_policy>
-			image(ctx, gl::image_initial_layout::unused,
-			      image_format, extent, gl::image_usage::transfer_dst | gl::image_usage::transfer_src | usage,
-			      mip_levels, layers,
-				  name.data(), flags);
-
+		return gl::device_image<dimensions, image_allocation_policy>(ctx, gl::image_initial_layout::unused,
+																	 image_format, extent, gl::image_usage::transfer_dst | gl::image_usage::transfer_src | usage,
+																	 mip_levels, layers,
+																	 name.data(), flags);
+	}
 
-		if (m < mip_levels) {
+	// Fills an image with the filler and generates the remainder of the mipmap chain, if any.
+	// filler accepts the semaphores to signal once the image is filled.
+	template <int dimensions, typename Filler>
+	static void _image_fill_internal(const ste_context& ctx,
+									 const gl::device_image<dimensions, image_allocation_policy> &image,
+									 Filler &&filler,
+									 levels_t filled_levels,
+									 const gl::image_layout& layout) {
+		if (filled_levels < image.get_mips()) {
 			auto semaphore = ctx.device().get_sync_primitives_pools().semaphores().claim();
 
 			// Copy surface to image
-			gl::fill_image(image,
-						   std::move(surface),
-						   layout,
-						   gl::ste_queue_selector<gl::ste_queue_selector_policy_flexible>(gl::ste_queue_type::primary_queue),
-						   lib::vector<gl::wait_semaphore>{}, 
-						   { &semaphore.get() });
+			filler(lib::vector<gl::semaphore*>{ &semaphore.get() });
 
 			// Generate mipmaps
 			lib::vector<gl::wait_semaphore> generate_mipmaps_wait_semaphores;
@@ -104,16 +98,117 @@ private:
 			gl::generate_mipmaps(image,
 								 layout,
 								 layout,
-								 m,
+								 filled_levels,
 								 std::move(generate_mipmaps_wait_semaphores));
 		}
 		else {
 			// Copy surface to image
+			filler(lib::vector<gl::semaphore*>{});
+		}
+	}
+
+	// Create an image object, fills it with data from input surface and generates mipmap.
+	template <int dimensions, gl::format image_format, typename Surface>
+	static auto _image_from_surface_fill_internal(const ste_context& ctx,
+												  const lib::string &name,
+	                                              Surface&& source,
+	                                              const gl::image_usage& usage,
+	                                              const gl::image_layout& layout,
+	                                              bool generate_mipmaps = true) {
+		static_assert(resource::is_surface_v<Surface>);
+
+		// Convert surface to target image_format
+		auto surface = surface_convert::convert<image_format>(std::move(source));
+
+		auto layers = surface.layers();
+		auto extent = surface.extent();
+
+		auto m = surface.levels();
+		auto mip_levels = generate_mipmaps ? surface_utilities::max_levels(extent) : m;
+
+		// Create image
+		auto image = _image_create_internal<dimensions>(ctx,
+														name,
+														image_format,
+														extent,
+														mip_levels,
+														layers,
+														usage);
+
+		_image_fill_internal(ctx, image, [&](lib::vector<gl::semaphore*> &&signal_semaphores) {
 			gl::fill_image(image,
 						   std::move(surface),
 						   layout,
-						   gl::ste_queue_selector<gl::ste_queue_selector_policy_flexible>(gl::ste_queue_type::primary_queue));
-		}
+						   gl::ste_queue_selector<gl::ste_queue_selector_policy_flexible>(gl::ste_queue_type::primary_queue),
+						   lib::vector<gl::wait_semaphore>{},
+						   std::move(signal_semaphores));
+		}, m, layout);
+
+		return image;
+	}
+
+	// Create an image object, decodes the stream directly into the staging memory and generates mipmap.
+	template <gl::format image_format>
+	static auto _image_from_stream_fill_internal(const ste_context& ctx,
+												 const lib::string &name,
+												 lib::unique_ptr<surface_stream_decoder_2d> &&decoder,
+												 const gl::image_usage& usage,
+												 const gl::image_layout& layout,
+												 bool generate_mipmaps) {
+		using block_type = typename gl::format_traits<image_format>::block_type;
+
+		const auto extent = decoder->get_extent();
+		const auto mip_levels = generate_mipmaps ? surface_utilities::max_levels(extent) : 1_mip;
+
+		// Create image
+		auto image = _image_create_internal<2>(ctx,
+											   name,
+											   image_format,
+											   extent,
+											   mip_levels,
+											   1_layer,
+											   usage);
+
+		_image_fill_internal(ctx, image, [&](lib::vector<gl::semaphore*> &&signal_semaphores) {
+			gl::fill_image_from_writer<image_format>(image,
+													 [&](block_type *dst) {
+														 decoder->decode<image_format>(dst, ctx.engine().task_scheduler());
+													 },
+													 layout,
+													 gl::ste_queue_selector<gl::ste_queue_selector_policy_flexible>(gl::ste_queue_type::primary_queue),
+													 lib::vector<gl::wait_semaphore>{},
+													 std::move(signal_semaphores));
+		}, 1_mip, layout);
+
+		return image;
+	}
+
+	// Create an image object with the opaque surface's format, levels and layers and fills it. No mipmaps are generated.
+	template <int dimensions>
+	static auto _image_from_opaque_surface_fill_internal(const ste_context& ctx,
+														 const lib::string &name,
+														 opaque_surface<dimensions> &&surface,
+														 const gl::image_usage& usage,
+														 const gl::image_layout& layout) {
+		const auto levels = surface.levels();
+
+		// Create image
+		auto image = _image_create_internal<dimensions>(ctx,
+														name,
+														surface.surface_format(),
+														surface.extent(),
+														levels,
+														surface.layers(),
+														usage);
+
+		_image_fill_internal(ctx, image, [&](lib::vector<gl::semaphore*> &&signal_semaphores) {
+			gl::fill_image(image,
+						   std::move(surface),
+						   layout,
+						   gl::ste_queue_selector<gl::ste_queue_selector_policy_flexible>(gl::ste_queue_type::primary_queue),
+						   lib::vector<gl::wait_semaphore>{},
+						   std::move(signal_semaphores));
+		}, levels, layout);
 
 		return image;
 	}
@@ -133,6 +228,25 @@ private:
 			ctx,
 			[=, &ctx]() mutable
 		{
+			// Decode straight into the staging memory, if the file can be streamed
+			auto decoder = surface_io::open_surface_2d_stream(path, srgb);
+			if (decoder) {
+				using namespace text::attributes;
+
+				const auto start = std::chrono::high_resolution_clock::now();
+				const auto extent = decoder->get_extent();
+				auto image = _image_from_stream_fill_internal<image_format>(ctx,
+																			name,
+																			std::move(decoder),
+																			usage,
+																			layout,
+																			generate_mipmaps);
+
+				const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+				ste_log() << text::attributed_string("Streamed surface \"") + i(lib::to_string(path.string())) + "\" (" + lib::to_string(extent.x) + " X " + lib::to_string(extent.y) + ") in " + lib::to_string(elapsed.count()) + "ms." << std::endl;
+				return image;
+			}
+
 			auto surface = surface_io::load_surface_2d(path, srgb);
 			return _image_from_surface_fill_internal<2, image_format>(ctx,
 																	  name,
@@ -486,6 +600,73 @@ public:
 		                                                                                               true);
 	}
 
+	/**
+	*	@brief	Constructs and returns a ste_resource<device_image> object which asynchronously creates an image object,
+	*			decodes the surface stream straight into the staging memory and generates mipmaps.
+	*
+	*	@param	ctx			Context
+	*	@param	decoder		Surface stream decoder, see surface_io::open_surface_2d_stream()
+	*	@param	usage		Image usage flags
+	*	@param	layout		Image layout. This is the layout the image will be transformed to at the end of the loading process.
+	*	@param	name		Image debug marker
+	*	@param	generate_mipmaps	If set to true, will generate mipmaps for the remainder of the mipmap tail.
+	*/
+	template <gl::format image_format, class resource_deferred_policy = ste_resource_deferred_creation_policy_async<
+		          ste_resource_async_policy_task_scheduler>>
+	static auto image_from_surface_2d(const ste_context& ctx,
+									  lib::unique_ptr<surface_stream_decoder_2d> &&decoder,
+									  const gl::image_usage& usage,
+									  const gl::image_layout& layout,
+									  const lib::string &name,
+									  bool generate_mipmaps = true) {
+		assert(decoder);
+
+		return ste_resource<gl::device_image<2, image_allocation_policy>, resource_deferred_policy>(
+			ste_resource_create_with_lambda(),
+			ctx,
+			[=, &ctx, decoder = std::move(decoder)]() mutable
+		{
+			return _image_from_stream_fill_internal<image_format>(ctx,
+																  name,
+																  std::move(decoder),
+																  usage,
+																  layout,
+																  generate_mipmaps);
+		});
+	}
+
+	/**
+	*	@brief	Constructs and returns a ste_resource<device_image> object which asynchronously creates an image object with
+	*			the format, levels and layers of an opaque 2D surface and fills it. Opaque surfaces can hold block-compressed
+	*			formats. No mipmaps are generated, the surface is expected to hold its mipmap chain, e.g. a baked surface
+	*			created by surface_baker.
+	*
+	*	@param	ctx			Context
+	*	@param	surface		Surface to load from
+	*	@param	usage		Image usage flags
+	*	@param	layout		Image layout. This is the layout the image will be transformed to at the end of the loading process.
+	*	@param	name		Image debug marker
+	*/
+	template <class resource_deferred_policy = ste_resource_deferred_creation_policy_async<
+		          ste_resource_async_policy_task_scheduler>>
+	static auto image_from_opaque_surface_2d(const ste_context& ctx,
+											 opaque_surface<2> &&surface,
+											 const gl::image_usage& usage,
+											 const gl::image_layout& layout,
+											 const lib::string &name) {
+		return ste_resource<gl::device_image<2, image_allocation_policy>, resource_deferred_policy>(
+			ste_resource_create_with_lambda(),
+			ctx,
+			[=, &ctx, surface = std::move(surface)]() mutable
+		{
+			return _image_from_opaque_surface_fill_internal<2>(ctx,
+															   name,
+															   std::move(surface),
+															   usage,
+															   layout);
+		});
+	}
+
 	/**
 	*	@brief	Constructs and returns a ste_resource<device_image> object which asynchronously creates an empty image object and transforms it to the
 	*			desired layout.
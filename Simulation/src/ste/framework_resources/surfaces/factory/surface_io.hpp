@@ -13,6 +13,7 @@
 #include <fstream>
 #include <lib/unique_ptr.hpp>
 #include <ios>
+#include <array>
 
 #include <filesystem>
 
@@ -20,6 +21,7 @@
 #include <attributed_string.hpp>
 
 #include <surface_factory_exceptions.hpp>
+#include <surface_stream_decoder.hpp>
 
 #include <optional.hpp>
 
@@ -31,6 +33,9 @@ private:
 	static opaque_surface<2> load_png_2d(const std::experimental::filesystem::path &file_name, bool srgb);
 	static opaque_surface<2> load_tga_2d(const std::experimental::filesystem::path &file_name, bool srgb);
 	static opaque_surface<2> load_jpeg_2d(const std::experimental::filesystem::path &file_name, bool srgb);
+	static lib::unique_ptr<surface_stream_decoder_2d> open_png_2d_stream(const std::experimental::filesystem::path &file_name, bool srgb);
+	static lib::unique_ptr<surface_stream_decoder_2d> open_tga_2d_stream(const std::experimental::filesystem::path &file_name, bool srgb);
+	static lib::unique_ptr<surface_stream_decoder_2d> open_jpeg_2d_stream(const std::experimental::filesystem::path &file_name, bool srgb);
 	static opaque_surface<1> load_dds_1d(const std::experimental::filesystem::path &file_name);
 	static opaque_surface<2> load_dds_2d(const std::experimental::filesystem::path &file_name);
 	static opaque_surface<3> load_dds_3d(const std::experimental::filesystem::path &file_name);
@@ -42,17 +47,63 @@ private:
 	static void write_jpeg_2d(const std::experimental::filesystem::path &file_name, const std::uint8_t *image_data, int components, int width, int height);
 	static void write_dds(const std::experimental::filesystem::path &file_name, const std::uint8_t *image_data, byte_t bytes, 
 						  gl::format format, gl::image_type image_type, const glm::u32vec3 &extent, levels_t levels, layers_t layers);
+	static void write_ktx(const std::experimental::filesystem::path &file_name, const std::uint8_t *image_data, byte_t bytes, 
+						  gl::format format, gl::image_type image_type, const glm::u32vec3 &extent, levels_t levels, layers_t layers);
+
+	using surface_writer_t = void(*)(const std::experimental::filesystem::path &, const std::uint8_t*, byte_t, gl::format, gl::image_type, const glm::u32vec3&, levels_t, layers_t);
 
 	~surface_io() noexcept {}
 
+	static auto read_magic(const std::experimental::filesystem::path &path) {
+		std::array<unsigned char, 4> magic = { 0, 0, 0, 0 };
+
+		try {
+			std::ifstream f;
+			f.exceptions(f.exceptions() | std::ios::failbit);
+
+			f.open(path.string(), std::ios::binary | std::ios::in);
+			if (!f) {
+				ste_log_error() << "Can't open surface file: " << path.string() << std::endl;
+				throw resource_io_error("Resource IO error");
+			}
+			if (!f.read(reinterpret_cast<char*>(magic.data()), 4)) {
+				ste_log_error() << "Can't read surface file: " << path.string() << std::endl;
+				throw resource_io_error("Surface IO error");
+			}
+		}
+		catch (const std::ios_base::failure& e) {
+			ste_log_error() << "Unknown failure opening file: " << path.string() << " - " << e.what() << " " << std::strerror(errno) << std::endl;
+			throw resource_io_error("Resource IO error");
+		}
+
+		return magic;
+	}
+
 public:
 	enum class surface_write_file_format {
 		png,
 		tga,
 		jpeg,
-		dds
+		dds,
+		ktx,
 	};
 
+private:
+	static surface_writer_t select_surface_writer(const std::experimental::filesystem::path &path, 
+												  const surface_write_file_format &file_format) {
+		switch (file_format) {
+		case surface_write_file_format::dds:
+			return write_dds;
+		case surface_write_file_format::ktx:
+			return write_ktx;
+		default: {
+			using namespace text::attributes;
+			ste_log_error() << "Can not write image using selected file format: " << i(lib::to_string(path.string())) << std::endl;
+			throw surface_unsupported_format_error("Can not write image using selected file format");
+		}
+		}
+	}
+
 public:
 	/**
 	 *	@brief	Writes 2D surface to file. Converts the surface to a 8-bit srgb format if needed.
@@ -131,18 +182,7 @@ public:
 							  const surface_write_file_format &file_format = surface_write_file_format::dds) {
 		static constexpr auto dimensions = gl::image_dimensions_v<image_type>;
 
-		// Select writer
-		void(*writer)(const std::experimental::filesystem::path &, const std::uint8_t*, byte_t, gl::format, gl::image_type, const glm::u32vec3&, levels_t, layers_t);
-		switch (file_format) {
-		case surface_write_file_format::dds:
-			writer = write_dds;
-			break;
-		default: {
-			using namespace text::attributes;
-			ste_log_error() << "Can not write image using selected file format: " << i(lib::to_string(path.string())) << std::endl;
-			throw surface_unsupported_format_error("Can not write image using selected file format");
-		}
-		}
+		const auto writer = select_surface_writer(path, file_format);
 
 		// Write out
 		glm::u32vec3 extent = { 1,1,1 };
@@ -160,6 +200,35 @@ public:
 			   static_cast<std::uint32_t>(surface.layers()));
 	}
 
+	/**
+	*	@brief	Writes an opaque surface to file. Unlike typed surfaces, opaque surfaces can hold block-compressed formats.
+	*
+	*	@param	surface			Input surface
+	*	@param	path			Filesystem path of output
+	*	@param	file_format		Selects desired output file format
+	*/
+	template<int dimensions>
+	static void write_surface(const opaque_surface<dimensions> &surface,
+							  const std::experimental::filesystem::path &path,
+							  const surface_write_file_format &file_format = surface_write_file_format::dds) {
+		const auto writer = select_surface_writer(path, file_format);
+
+		// Write out
+		glm::u32vec3 extent = { 1,1,1 };
+		if constexpr (dimensions>0) extent.x = surface.extent().x;
+		if constexpr (dimensions>1) extent.y = surface.extent().y;
+		if constexpr (dimensions>2) extent.z = surface.extent().z;
+
+		writer(path, 
+			   surface.data(), 
+			   surface.bytes(), 
+			   surface.surface_format(), 
+			   surface.surface_image_type(), 
+			   extent, 
+			   surface.levels(),
+			   surface.layers());
+	}
+
 	/**
 	 *	@brief	Loads 2D surface from file
 	 *	
@@ -167,29 +236,8 @@ public:
 	 *	@param	srgb	Use sRGB non-linear color space
 	 */
 	static auto load_surface_2d(const std::experimental::filesystem::path &path, bool srgb = false) {
-		unsigned char magic[4] = { 0, 0, 0, 0 };
-
 		// Check image format
-		{
-			try {
-				std::ifstream f;
-				f.exceptions(f.exceptions() | std::ios::failbit);
-
-				f.open(path.string(), std::ios::binary | std::ios::in);
-				if (!f) {
-					ste_log_error() << "Can't open surface file: " << path.string() << std::endl;
-					throw resource_io_error("Resource IO error");
-				}
-				if (!f.read(reinterpret_cast<char*>(magic), 4)) {
-					ste_log_error() << "Can't read surface file: " << path.string() << std::endl;
-					throw resource_io_error("Surface IO error");
-				}
-			}
-			catch (const std::ios_base::failure& e) {
-				ste_log_error() << "Unknown failure opening file: " << path.string() << " - " << e.what() << " " << std::strerror(errno) << std::endl;
-				throw resource_io_error("Resource IO error");
-			}
-		}
+		const auto magic = read_magic(path);
 
 		// Load image
 		{
@@ -236,6 +284,35 @@ public:
 			throw surface_unsupported_format_error("Incompatible surface format");
 		}
 	}
+
+	/**
+	 *	@brief	Opens a streaming decoder of a 2D surface file, which decodes the surface in row strips directly into a
+	 *			destination without intermediate surfaces. See surface_stream_decoder_2d.
+	 *			Supports PNG, JPEG and uncompressed TGA files. Interlaced PNGs are not supported.
+	 *
+	 *	@param	path	Filesystem path of input file
+	 *	@param	srgb	Use sRGB non-linear color space
+	 *
+	 *	@return	The decoder, or nullptr if the file can not be streamed. Such files should be loaded with load_surface_2d().
+	 */
+	static lib::unique_ptr<surface_stream_decoder_2d> open_surface_2d_stream(const std::experimental::filesystem::path &path, bool srgb = false) {
+		const auto magic = read_magic(path);
+
+		if (magic[0] == 0xff && magic[1] == 0xd8) {
+			// JPEG
+			return open_jpeg_2d_stream(path, srgb);
+		}
+		if (magic[0] == 0x89 && magic[1] == 0x50 && magic[2] == 0x4e && magic[3] == 0x47) {
+			// PNG
+			return open_png_2d_stream(path, srgb);
+		}
+		if (magic[0] == 0 && magic[1] == 0 && magic[3] == 0) {
+			// TGA?
+			return open_tga_2d_stream(path, srgb);
+		}
+
+		return nullptr;
+	}
 };
 
 }
@@ -11,10 +11,106 @@
 
 #include <turbojpeg.h>
 
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+
 using namespace ste;
 using namespace ste::text;
 using namespace ste::resource;
 
+namespace ste::resource::_detail {
+
+/**
+ *	@brief	libjpeg error manager. libjpeg errors are fatal by default, instead long jump back to the decoder.
+ */
+struct surface_io_jpeg_error_mgr {
+	jpeg_error_mgr pub;
+	std::jmp_buf jmp;
+	char message[JMSG_LENGTH_MAX];
+
+	static void error_exit(j_common_ptr cinfo) {
+		auto *err = reinterpret_cast<surface_io_jpeg_error_mgr*>(cinfo->err);
+		(*cinfo->err->format_message)(cinfo, err->message);
+		std::longjmp(err->jmp, 1);
+	}
+	static void output_message(j_common_ptr) {}
+};
+
+/**
+ *	@brief	libjpeg decompression state. Kept at a stable address, libjpeg holds pointers into it.
+ */
+struct surface_io_jpeg_state {
+	lib::string content;
+	jpeg_decompress_struct cinfo;
+	surface_io_jpeg_error_mgr err;
+
+	surface_io_jpeg_state(lib::string &&content) : content(std::move(content)) {
+		cinfo.err = jpeg_std_error(&err.pub);
+		err.pub.error_exit = surface_io_jpeg_error_mgr::error_exit;
+		err.pub.output_message = surface_io_jpeg_error_mgr::output_message;
+		err.message[0] = 0;
+
+		// Can not fail
+		jpeg_create_decompress(&cinfo);
+		jpeg_mem_src(&cinfo,
+					 reinterpret_cast<const unsigned char*>(this->content.data()),
+					 static_cast<unsigned long>(this->content.size()));
+	}
+	~surface_io_jpeg_state() noexcept {
+		jpeg_destroy_decompress(&cinfo);
+	}
+
+	surface_io_jpeg_state(surface_io_jpeg_state&&) = delete;
+	surface_io_jpeg_state &operator=(surface_io_jpeg_state&&) = delete;
+};
+
+/**
+ *	@brief	Decodes JPEGs scanline by scanline
+ */
+class surface_io_jpeg_stream_decoder : public surface_stream_decoder_2d {
+private:
+	std::experimental::filesystem::path path;
+	lib::unique_ptr<surface_io_jpeg_state> state;
+
+	lib::vector<JSAMPROW> row_pointers;
+
+protected:
+	void decode_rows(std::uint8_t *dst, std::uint32_t rows) override final {
+		row_pointers.resize(rows);
+		for (std::uint32_t i = 0; i < rows; ++i)
+			row_pointers[i] = reinterpret_cast<JSAMPROW>(dst + i * row_bytes());
+
+		auto &cinfo = state->cinfo;
+		if (setjmp(state->err.jmp)) {
+			ste_log_error() << path << " libjpeg could not decompress JPEG image: " << state->err.message << std::endl;
+			throw surface_error("libjpeg could not decompress JPEG image");
+		}
+
+		std::uint32_t read = 0;
+		while (read < rows) {
+			const auto lines = jpeg_read_scanlines(&cinfo, row_pointers.data() + read, rows - read);
+			if (lines == 0) {
+				ste_log_error() << path << " libjpeg could not decompress JPEG image: Truncated image" << std::endl;
+				throw surface_error("libjpeg could not decompress JPEG image");
+			}
+			read += lines;
+		}
+	}
+
+public:
+	surface_io_jpeg_stream_decoder(const std::experimental::filesystem::path &path,
+								   lib::unique_ptr<surface_io_jpeg_state> &&state,
+								   gl::format format)
+		: surface_stream_decoder_2d(format, { state->cinfo.output_width, state->cinfo.output_height }),
+		path(path),
+		state(std::move(state))
+	{}
+	~surface_io_jpeg_stream_decoder() noexcept {}
+};
+
+}
+
 opaque_surface<2> surface_io::load_jpeg_2d(const std::experimental::filesystem::path &path, bool srgb) {
 	lib::string content;
 	{
@@ -153,3 +249,54 @@ void surface_io::write_jpeg_2d(const std::experimental::filesystem::path &path,
 		std::copy(buffer.data(), buffer.data() + dst_size, std::ostream_iterator<std::uint8_t>(fs));
 	}
 }
+
+lib::unique_ptr<surface_stream_decoder_2d> surface_io::open_jpeg_2d_stream(const std::experimental::filesystem::path &path, bool srgb) {
+	// The compressed image is small, read it whole
+	lib::string content;
+	{
+		std::ifstream fs(path.string(), std::ios::in | std::ios::binary);
+		if (!fs) {
+			using namespace attributes;
+			ste_log_error() << text::attributed_string("Can't open JPEG ") + i(lib::to_string(path.string())) + ": " + std::strerror(errno) << std::endl;
+			throw resource_io_error("Could not open file");
+		}
+
+		const std::size_t size = std::experimental::filesystem::file_size(path);
+		content.resize(size);
+		fs.read(content.data(), size);
+	}
+
+	if (content.size() == 0) {
+		ste_log_error() << "Can't open JPEG: " << path << std::endl;
+		throw resource_io_error("Reading file failed");
+	}
+
+	auto state = lib::allocate_unique<_detail::surface_io_jpeg_state>(std::move(content));
+	auto &cinfo = state->cinfo;
+
+	if (setjmp(state->err.jmp)) {
+		ste_log_error() << path << " libjpeg could not read JPEG header: " << state->err.message << std::endl;
+		throw surface_error("libjpeg could not read JPEG header");
+	}
+
+	jpeg_read_header(&cinfo, TRUE);
+
+	// Read colorspace and components
+	gl::format format;
+	switch (cinfo.jpeg_color_space) {
+	case JCS_GRAYSCALE:
+		format = srgb ? gl::format::r8_srgb : gl::format::r8_unorm;
+		cinfo.out_color_space = JCS_GRAYSCALE;
+		break;
+	default:
+		format = srgb ? gl::format::r8g8b8_srgb : gl::format::r8g8b8_unorm;
+		cinfo.out_color_space = JCS_RGB;
+		break;
+	}
+
+	jpeg_start_decompress(&cinfo);
+
+	return lib::allocate_unique<_detail::surface_io_jpeg_stream_decoder>(path,
+																		 std::move(state),
+																		 format);
+}
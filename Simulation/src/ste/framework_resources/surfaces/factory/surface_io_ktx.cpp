@@ -10,6 +10,8 @@
 #include <attrib.hpp>
 
 #include <lib/unique_ptr.hpp>
+#include <lib/vector.hpp>
+#include <optional.hpp>
 
 using namespace ste;
 using namespace ste::text;
@@ -30,6 +32,49 @@ inline gl::image_type ktx_image_type(const ktx_header10& header) {
 	return gl::image_type::image_2d;
 }
 
+struct ktx_gl_format {
+	std::uint32_t internal_format;
+	std::uint32_t external_format;
+	std::uint32_t type;
+	std::uint32_t type_size;
+};
+
+inline optional<ktx_gl_format> ktx_gl_format_for(gl::format format) {
+	switch (format) {
+	case gl::format::r8_unorm:					return ktx_gl_format{ INTERNAL_R8_UNORM, EXTERNAL_RED, TYPE_U8, 1 };
+	case gl::format::r8_srgb:					return ktx_gl_format{ INTERNAL_SR8, EXTERNAL_RED, TYPE_U8, 1 };
+	case gl::format::r8g8_unorm:				return ktx_gl_format{ INTERNAL_RG8_UNORM, EXTERNAL_RG, TYPE_U8, 1 };
+	case gl::format::r8g8_srgb:					return ktx_gl_format{ INTERNAL_SRG8, EXTERNAL_RG, TYPE_U8, 1 };
+	case gl::format::r8g8b8_unorm:				return ktx_gl_format{ INTERNAL_RGB8_UNORM, EXTERNAL_RGB, TYPE_U8, 1 };
+	case gl::format::r8g8b8a8_unorm:			return ktx_gl_format{ INTERNAL_RGBA8_UNORM, EXTERNAL_RGBA, TYPE_U8, 1 };
+	case gl::format::r8g8b8a8_srgb:				return ktx_gl_format{ INTERNAL_SRGB8_ALPHA8, EXTERNAL_RGBA, TYPE_U8, 1 };
+	case gl::format::r16_unorm:					return ktx_gl_format{ INTERNAL_R16_UNORM, EXTERNAL_RED, TYPE_U16, 2 };
+	case gl::format::r16_sfloat:				return ktx_gl_format{ INTERNAL_R16F, EXTERNAL_RED, TYPE_F16, 2 };
+	case gl::format::r16g16_sfloat:				return ktx_gl_format{ INTERNAL_RG16F, EXTERNAL_RG, TYPE_F16, 2 };
+	case gl::format::r16g16b16a16_unorm:		return ktx_gl_format{ INTERNAL_RGBA16_UNORM, EXTERNAL_RGBA, TYPE_U16, 2 };
+	case gl::format::r16g16b16a16_sfloat:		return ktx_gl_format{ INTERNAL_RGBA16F, EXTERNAL_RGBA, TYPE_F16, 2 };
+	case gl::format::r32_sfloat:				return ktx_gl_format{ INTERNAL_R32F, EXTERNAL_RED, TYPE_F32, 4 };
+	case gl::format::r32g32_sfloat:				return ktx_gl_format{ INTERNAL_RG32F, EXTERNAL_RG, TYPE_F32, 4 };
+	case gl::format::r32g32b32a32_sfloat:		return ktx_gl_format{ INTERNAL_RGBA32F, EXTERNAL_RGBA, TYPE_F32, 4 };
+	case gl::format::bc1_rgb_unorm_block:		return ktx_gl_format{ INTERNAL_RGB_DXT1, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc1_rgb_srgb_block:		return ktx_gl_format{ INTERNAL_SRGB_DXT1, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc1_rgba_unorm_block:		return ktx_gl_format{ INTERNAL_RGBA_DXT1, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc1_rgba_srgb_block:		return ktx_gl_format{ INTERNAL_SRGB_ALPHA_DXT1, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc2_unorm_block:			return ktx_gl_format{ INTERNAL_RGBA_DXT3, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc2_srgb_block:			return ktx_gl_format{ INTERNAL_SRGB_ALPHA_DXT3, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc3_unorm_block:			return ktx_gl_format{ INTERNAL_RGBA_DXT5, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc3_srgb_block:			return ktx_gl_format{ INTERNAL_SRGB_ALPHA_DXT5, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc4_unorm_block:			return ktx_gl_format{ INTERNAL_R_ATI1N_UNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc4_snorm_block:			return ktx_gl_format{ INTERNAL_R_ATI1N_SNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc5_unorm_block:			return ktx_gl_format{ INTERNAL_RG_ATI2N_UNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc5_snorm_block:			return ktx_gl_format{ INTERNAL_RG_ATI2N_SNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc7_unorm_block:			return ktx_gl_format{ INTERNAL_RGB_BP_UNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	case gl::format::bc7_srgb_block:			return ktx_gl_format{ INTERNAL_SRGB_BP_UNORM, EXTERNAL_NONE, TYPE_NONE, 1 };
+	default:
+		return none;
+	}
+}
+
 template <int dimensions>
 opaque_surface<dimensions> load_ktx(const std::experimental::filesystem::path &path) {
 	using surface_t = opaque_surface<dimensions>;
@@ -111,6 +156,7 @@ opaque_surface<dimensions> load_ktx(const std::experimental::filesystem::path &p
 	else if (header.GLInternalFormat == INTERNAL_RGBA8_SSCALED_GTC && header.GLFormat == EXTERNAL_RGBA && header.GLType == TYPE_I8)					format = gl::format::r8g8b8a8_sscaled;
 	else if (header.GLInternalFormat == INTERNAL_RGBA8U && header.GLFormat == EXTERNAL_RGBA_INTEGER && header.GLType == TYPE_U8)					format = gl::format::r8g8b8a8_uint;
 	else if (header.GLInternalFormat == INTERNAL_RGBA8I && header.GLFormat == EXTERNAL_RGBA_INTEGER && header.GLType == TYPE_I8)					format = gl::format::r8g8b8a8_sint;
+	else if (header.GLInternalFormat == INTERNAL_SRGB8_ALPHA8 && header.GLFormat == EXTERNAL_RGBA && header.GLType == TYPE_U8)						format = gl::format::r8g8b8a8_srgb;
 
 	else if (header.GLInternalFormat == INTERNAL_BGR_UNORM && header.GLFormat == EXTERNAL_BGR && header.GLType == TYPE_U8)							format = gl::format::b8g8r8_unorm;
 	else if (header.GLInternalFormat == INTERNAL_BGRA_UNORM && header.GLFormat == EXTERNAL_BGRA && header.GLType == TYPE_U8)						format = gl::format::b8g8r8a8_unorm;
@@ -192,9 +238,16 @@ opaque_surface<dimensions> load_ktx(const std::experimental::filesystem::path &p
 	else if (header.GLInternalFormat == INTERNAL_SRGB_DXT1 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc1_rgb_srgb_block;
 	else if (header.GLInternalFormat == INTERNAL_RGBA_DXT1 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc1_rgba_unorm_block;
 	else if (header.GLInternalFormat == INTERNAL_SRGB_ALPHA_DXT1 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc1_rgba_srgb_block;
-	else if (header.GLInternalFormat == INTERNAL_RGBA_DXT3 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc3_unorm_block;
-	else if (header.GLInternalFormat == INTERNAL_SRGB_ALPHA_DXT3 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc3_srgb_block;
-	else if (header.GLInternalFormat == INTERNAL_RGBA_DXT5 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc5_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_RGBA_DXT3 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc2_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_SRGB_ALPHA_DXT3 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc2_srgb_block;
+	else if (header.GLInternalFormat == INTERNAL_RGBA_DXT5 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc3_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_SRGB_ALPHA_DXT5 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc3_srgb_block;
+	else if (header.GLInternalFormat == INTERNAL_R_ATI1N_UNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc4_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_R_ATI1N_SNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc4_snorm_block;
+	else if (header.GLInternalFormat == INTERNAL_RG_ATI2N_UNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc5_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_RG_ATI2N_SNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc5_snorm_block;
+	else if (header.GLInternalFormat == INTERNAL_RGB_BP_UNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::bc7_unorm_block;
+	else if (header.GLInternalFormat == INTERNAL_SRGB_BP_UNORM && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)					format = gl::format::bc7_srgb_block;
 
 	else if (header.GLInternalFormat == INTERNAL_SRGB8_ETC2 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::etc2_r8g8b8_srgb_block;
 	else if (header.GLInternalFormat == INTERNAL_RGBA_ETC2 && header.GLFormat == EXTERNAL_NONE && header.GLType == TYPE_NONE)						format = gl::format::etc2_r8g8b8a1_unorm_block;
@@ -245,7 +298,7 @@ opaque_surface<dimensions> load_ktx(const std::experimental::filesystem::path &p
 	if constexpr (dimensions > 1)	extent.y = static_cast<std::uint32_t>(header.PixelHeight);
 	if constexpr (dimensions > 2)	extent.z = static_cast<std::uint32_t>(header.PixelDepth);
 	const auto arrays = std::max(1_layers, layers_t(header.NumberOfArrayElements));
-	const auto levels = levels_t(header.NumberOfMipmapLevels);
+	const auto levels = std::max(1_mip, levels_t(header.NumberOfMipmapLevels));
 	const auto layers = image_type == gl::image_type::image_cubemap || image_type == gl::image_type::image_cubemap_array ? 
 		arrays * header.NumberOfFaces : arrays;
 
@@ -262,39 +315,51 @@ opaque_surface<dimensions> load_ktx(const std::experimental::filesystem::path &p
 				  levels,
 				  layers);
 
-	// Read data into surface
-	auto read_bytes = 0_B;
+	// Read data into surface. Each level holds all of the layers, rows are padded to 4 bytes.
 	for (auto level = 0_mip; level < levels; ++level) {
 		offset = ((offset + 3) / 4) * 4;
+		if (offset + 4 > content.size()) {
+			using namespace attributes;
+			ste_log_error() << text::attributed_string("KTX ") + i(lib::to_string(path.string())) + ": Truncated file" << std::endl;
+			throw surface_error("KTX: Truncated file");
+		}
 
-		// Read level size
-		const auto image_size = byte_t(*reinterpret_cast<const std::uint32_t*>(data + offset));
+		// Read level size. Non-array cubemaps store the size of a single face.
+		const auto image_size = static_cast<std::size_t>(*reinterpret_cast<const std::uint32_t*>(data + offset));
 		offset += 4;
 
-		assert(tex.bytes(level) == image_size);
+		const auto row_bytes = static_cast<std::size_t>(tex.block_bytes()) * static_cast<std::size_t>(tex.extent_in_blocks(level).x);
+		const auto padded_row_bytes = (row_bytes + 3) / 4 * 4;
+		const auto rows = tex.blocks(level) / static_cast<std::size_t>(tex.extent_in_blocks(level).x);
+		const auto level_bytes = padded_row_bytes * rows * static_cast<std::size_t>(layers);
+
+		const auto expected_image_size = image_type == gl::image_type::image_cubemap ? 
+			level_bytes / 6 : 
+			level_bytes;
+		if (image_size != expected_image_size || offset + level_bytes > content.size()) {
+			using namespace attributes;
+			ste_log_error() << text::attributed_string("KTX ") + i(lib::to_string(path.string())) + ": Level size mismatch" << std::endl;
+			throw surface_error("KTX: Level size mismatch");
+		}
 
 		// Read all level data
-		auto level_bytes_read = 0_B;
+		const auto *src = data + offset;
 		for (auto layer = 0_layer; layer < layers; ++layer) {
-			const auto blocks = tex.blocks(level) / static_cast<std::size_t>(levels);
-			const auto bytes = blocks * tex.block_bytes();
-
 			auto image_data = tex.data_at(layer, level);
-			std::memcpy(image_data, 
-						data + offset + static_cast<std::size_t>(level_bytes_read), 
-						static_cast<std::size_t>(bytes));
-
-			level_bytes_read += bytes;
+			if (row_bytes == padded_row_bytes) {
+				std::memcpy(image_data, src, row_bytes * rows);
+			}
+			else {
+				for (std::size_t r = 0; r < rows; ++r)
+					std::memcpy(image_data + r * row_bytes, src + r * padded_row_bytes, row_bytes);
+			}
+
+			src += padded_row_bytes * rows;
 		}
 
-		assert(level_bytes_read == image_size);
-
-		read_bytes += image_size;
-		offset += static_cast<std::size_t>(image_size);
+		offset += level_bytes;
 	}
 
-	assert(tex.bytes() == read_bytes);
-
 	return tex;
 }
 
@@ -311,3 +376,104 @@ opaque_surface<2> surface_io::load_ktx_2d(const std::experimental::filesystem::p
 opaque_surface<3> surface_io::load_ktx_3d(const std::experimental::filesystem::path &file_name) {
 	return _detail::load_ktx<3>(file_name);
 }
+
+void surface_io::write_ktx(const std::experimental::filesystem::path &file_name, const std::uint8_t *image_data, byte_t bytes,
+						   gl::format format, gl::image_type image_type, const glm::u32vec3 &extent, levels_t levels, layers_t layers) {
+	const auto gl_format = _detail::ktx_gl_format_for(format);
+	if (!gl_format) {
+		ste_log_error() << "Surface format incompatible with KTX." << std::endl;
+		throw surface_unsupported_format_error("Surface format incompatible with KTX");
+	}
+
+	const auto format_traits = gl::format_id(format);
+	const auto dimensions = gl::image_dimensions_for_type(image_type);
+	const bool cubemap = gl::image_is_cubemap_for_type(image_type);
+	const bool array = image_type == gl::image_type::image_1d_array ||
+		image_type == gl::image_type::image_2d_array ||
+		image_type == gl::image_type::image_cubemap_array;
+
+	// Populate header. The base internal format of compressed formats is the uncompressed format with the same components.
+	static constexpr std::uint32_t base_formats[] = { EXTERNAL_RED, EXTERNAL_RG, EXTERNAL_RGB, EXTERNAL_RGBA };
+
+	ktx_header10 header;
+	header.Endianness = 0x04030201;
+	header.GLType = gl_format.get().type;
+	header.GLTypeSize = gl_format.get().type_size;
+	header.GLFormat = gl_format.get().external_format;
+	header.GLInternalFormat = gl_format.get().internal_format;
+	header.GLBaseInternalFormat = format_traits.is_compressed ? 
+		base_formats[format_traits.elements - 1] : 
+		gl_format.get().external_format;
+	header.PixelWidth = extent.x;
+	header.PixelHeight = dimensions > 1 ? extent.y : 0;
+	header.PixelDepth = dimensions > 2 ? extent.z : 0;
+	header.NumberOfFaces = cubemap ? 6 : 1;
+	header.NumberOfArrayElements = array ? static_cast<std::uint32_t>(layers) / header.NumberOfFaces : 0;
+	header.NumberOfMipmapLevels = static_cast<std::uint32_t>(levels);
+	header.BytesOfKeyValueData = 0;
+
+	// Surfaces store the levels of each layer consecutively, while KTX stores all of the layers of each level 
+	// consecutively, with rows padded to 4 bytes.
+	lib::vector<std::uint8_t> content;
+	content.reserve(sizeof(magic_ktx10) + sizeof(ktx_header10) + static_cast<std::size_t>(bytes) + 4 * static_cast<std::size_t>(levels));
+	content.insert(content.end(), std::begin(magic_ktx10), std::end(magic_ktx10));
+	content.insert(content.end(),
+				   reinterpret_cast<const std::uint8_t*>(&header),
+				   reinterpret_cast<const std::uint8_t*>(&header) + sizeof(ktx_header10));
+
+	const auto block_bytes = static_cast<std::size_t>(format_traits.block_bytes);
+	const auto level_blocks = [&](levels_t level) {
+		glm::u32vec3 blocks = glm::max(glm::u32vec3(1), extent >> static_cast<std::uint32_t>(level));
+		blocks.x = std::max(1u, blocks.x / format_traits.block_extent.x);
+		blocks.y = std::max(1u, blocks.y / format_traits.block_extent.y);
+		if (dimensions < 2) blocks.y = 1;
+		if (dimensions < 3) blocks.z = 1;
+		return blocks;
+	};
+	std::size_t layer_blocks = 0;
+	for (auto level = 0_mip; level < levels; ++level) {
+		const auto b = level_blocks(level);
+		layer_blocks += static_cast<std::size_t>(b.x) * b.y * b.z;
+	}
+	if (layer_blocks * block_bytes * static_cast<std::size_t>(layers) != static_cast<std::size_t>(bytes)) {
+		ste_log_error() << "Surface size mismatch writing KTX." << std::endl;
+		throw surface_opaque_storage_mismatch_error("Surface size mismatch writing KTX");
+	}
+
+	std::size_t level_offset = 0;
+	for (auto level = 0_mip; level < levels; ++level) {
+		const auto b = level_blocks(level);
+		const auto row_bytes = static_cast<std::size_t>(b.x) * block_bytes;
+		const auto padded_row_bytes = (row_bytes + 3) / 4 * 4;
+		const auto rows = static_cast<std::size_t>(b.y) * b.z;
+		const auto level_bytes = padded_row_bytes * rows * static_cast<std::size_t>(layers);
+
+		// Non-array cubemaps store the size of a single face
+		const auto image_size = static_cast<std::uint32_t>(cubemap && !array ? level_bytes / 6 : level_bytes);
+		content.insert(content.end(),
+					   reinterpret_cast<const std::uint8_t*>(&image_size),
+					   reinterpret_cast<const std::uint8_t*>(&image_size) + sizeof(image_size));
+
+		for (auto layer = 0_layer; layer < layers; ++layer) {
+			const auto *src = image_data + (layer_blocks * static_cast<std::size_t>(layer)) * block_bytes + level_offset;
+			for (std::size_t r = 0; r < rows; ++r) {
+				content.insert(content.end(), src + r * row_bytes, src + (r + 1) * row_bytes);
+				content.resize(content.size() + padded_row_bytes - row_bytes, 0);
+			}
+		}
+
+		level_offset += row_bytes * rows;
+	}
+
+	// Write out
+	{
+		std::ofstream fs(file_name.string(), std::ios::out | std::ios::binary);
+		if (!fs) {
+			using namespace attributes;
+			ste_log_error() << text::attributed_string("Can't open file ") + i(lib::to_string(file_name.string())) + " for writing: " + std::strerror(errno) << std::endl;
+			throw resource_io_error("Could not open file");
+		}
+
+		fs.write(reinterpret_cast<const char*>(content.data()), content.size());
+	}
+}
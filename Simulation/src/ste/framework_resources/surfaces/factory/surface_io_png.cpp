@@ -7,6 +7,7 @@
 #include <attrib.hpp>
 
 #include <lib/unique_ptr.hpp>
+#include <lib/vector.hpp>
 
 #include <libpng16/png.h>
 
@@ -14,6 +15,56 @@ using namespace ste;
 using namespace ste::text;
 using namespace ste::resource;
 
+namespace ste::resource::_detail {
+
+/**
+ *	@brief	Decodes non-interlaced PNGs row by row
+ */
+class surface_io_png_stream_decoder : public surface_stream_decoder_2d {
+private:
+	std::experimental::filesystem::path file_name;
+	FILE *fp;
+	png_structp png_ptr;
+	png_infop info_ptr;
+
+	lib::vector<png_bytep> row_pointers;
+
+protected:
+	void decode_rows(std::uint8_t *dst, std::uint32_t rows) override final {
+		row_pointers.resize(rows);
+		for (std::uint32_t i = 0; i < rows; ++i)
+			row_pointers[i] = reinterpret_cast<png_bytep>(dst + i * row_bytes());
+
+		// the code in this if statement gets called if libpng encounters an error
+		if (setjmp(png_jmpbuf(png_ptr))) {
+			ste_log_error() << file_name << " error from libpng" << std::endl;
+			throw surface_error("libpng error");
+		}
+
+		png_read_rows(png_ptr, row_pointers.data(), nullptr, rows);
+	}
+
+public:
+	surface_io_png_stream_decoder(const std::experimental::filesystem::path &file_name,
+								  FILE *fp,
+								  png_structp png_ptr,
+								  png_infop info_ptr,
+								  gl::format format,
+								  const glm::u32vec2 &extent)
+		: surface_stream_decoder_2d(format, extent),
+		file_name(file_name),
+		fp(fp),
+		png_ptr(png_ptr),
+		info_ptr(info_ptr)
+	{}
+	~surface_io_png_stream_decoder() noexcept {
+		png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+		fclose(fp);
+	}
+};
+
+}
+
 opaque_surface<2> surface_io::load_png_2d(const std::experimental::filesystem::path &file_name, bool srgb) {
 	png_byte header[8];
 
@@ -237,3 +288,103 @@ void surface_io::write_png_2d(const std::experimental::filesystem::path &file_na
 	fclose(fp);
 	
 }
+
+lib::unique_ptr<surface_stream_decoder_2d> surface_io::open_png_2d_stream(const std::experimental::filesystem::path &file_name, bool srgb) {
+	png_byte header[8];
+
+	FILE *fp = fopen(file_name.string().data(), "rb");
+	if (!fp) {
+		throw resource_io_error("Could not open file");
+	}
+
+	// read the header
+	if (fread(header, 1, 8, fp) != 8 || png_sig_cmp(header, 0, 8)) {
+		ste_log_error() << file_name << " is not a PNG" << std::endl;
+		fclose(fp);
+		throw surface_unsupported_format_error("Not a valid PNG");
+	}
+
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (!png_ptr) {
+		ste_log_error() << file_name << " png_create_read_struct returned 0" << std::endl;
+		fclose(fp);
+		throw surface_unsupported_format_error("Not a valid PNG");
+	}
+
+	// create png info struct
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		ste_log_error() << file_name << " png_create_info_struct returned 0" << std::endl;
+		png_destroy_read_struct(&png_ptr, nullptr, nullptr);
+		fclose(fp);
+		throw surface_unsupported_format_error("Not a valid PNG");
+	}
+
+	const auto close = [&]() {
+		png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+		fclose(fp);
+	};
+
+	// the code in this if statement gets called if libpng encounters an error
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		ste_log_error() << file_name << " error from libpng" << std::endl;
+		close();
+		throw surface_error("libpng error");
+	}
+
+	png_init_io(png_ptr, fp);
+	png_set_sig_bytes(png_ptr, 8);
+
+	// read all the info up to the image data
+	png_read_info(png_ptr, info_ptr);
+
+	int bit_depth, color_type, interlace_type;
+	png_uint_32 width, height;
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type,
+				 &interlace_type, nullptr, nullptr);
+
+	if (interlace_type != PNG_INTERLACE_NONE) {
+		// Interlaced images can not be decoded row by row
+		close();
+		return nullptr;
+	}
+
+	if (bit_depth != 8 && (bit_depth != 1 || color_type != PNG_COLOR_TYPE_GRAY)) {
+		ste_log_error() << file_name << " Unsupported bit depth " << bit_depth << ".  Must be 8" << std::endl;
+		close();
+		throw surface_unsupported_format_error("Unsupported bit depth");
+	}
+	if (bit_depth == 1) {
+		// Expand to 8-bit
+		png_set_expand_gray_1_2_4_to_8(png_ptr);
+	}
+
+	gl::format format;
+	switch (color_type) {
+	case PNG_COLOR_TYPE_GRAY:
+		format = srgb ? gl::format::r8_srgb : gl::format::r8_unorm;
+		break;
+	case PNG_COLOR_TYPE_RGB:
+		format = srgb ? gl::format::r8g8b8_srgb : gl::format::r8g8b8_unorm;
+		break;
+	case PNG_COLOR_TYPE_RGB_ALPHA:
+		format = srgb ? gl::format::r8g8b8a8_srgb : gl::format::r8g8b8a8_unorm;
+		break;
+	default:
+		ste_log_error() << file_name << " Unknown libpng color type " << color_type << std::endl;
+		close();
+		throw surface_unsupported_format_error("Unsupported PNG color type");
+	}
+
+	png_read_update_info(png_ptr, info_ptr);
+
+	auto decoder = lib::allocate_unique<_detail::surface_io_png_stream_decoder>(file_name,
+																				fp,
+																				png_ptr,
+																				info_ptr,
+																				format,
+																				glm::u32vec2{ width, height });
+	assert(png_get_rowbytes(png_ptr, info_ptr) == decoder->row_bytes());
+
+	return std::move(decoder);
+}
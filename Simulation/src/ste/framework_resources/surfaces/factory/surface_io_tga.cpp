@@ -11,10 +11,72 @@
 
 #include <tga.h>
 
+#include <algorithm>
+
 using namespace ste;
 using namespace ste::text;
 using namespace ste::resource;
 
+namespace ste::resource::_detail {
+
+/**
+ *	@brief	Decodes uncompressed TGAs by reading the scanlines directly from the file
+ */
+class surface_io_tga_stream_decoder : public surface_stream_decoder_2d {
+private:
+	std::experimental::filesystem::path file_name;
+	std::ifstream fs;
+	std::size_t data_offset;
+	bool bottom_up;
+
+	std::uint32_t next_row{ 0 };
+
+protected:
+	void decode_rows(std::uint8_t *dst, std::uint32_t rows) override final {
+		const auto height = get_extent().y;
+		const auto stride = row_bytes();
+		assert(next_row + rows <= height);
+
+		// Scanlines are stored bottom to top, unless the image is top-down
+		const auto first_scanline = bottom_up ? height - next_row - rows : next_row;
+		fs.seekg(data_offset + first_scanline * stride);
+		if (!fs.read(reinterpret_cast<char*>(dst), rows * stride)) {
+			ste_log_error() << file_name << " is not a valid TGA" << std::endl;
+			throw surface_error("Not a valid TGA");
+		}
+
+		if (bottom_up) {
+			// Flip vertical
+			for (std::uint32_t y = 0; y < rows / 2; ++y)
+				std::swap_ranges(dst + y * stride, dst + (y + 1) * stride, dst + (rows - y - 1) * stride);
+		}
+
+		next_row += rows;
+	}
+
+public:
+	surface_io_tga_stream_decoder(const std::experimental::filesystem::path &file_name,
+								  std::size_t data_offset,
+								  bool bottom_up,
+								  gl::format format,
+								  const glm::u32vec2 &extent)
+		: surface_stream_decoder_2d(format, extent),
+		file_name(file_name),
+		fs(file_name.string(), std::ios::in | std::ios::binary),
+		data_offset(data_offset),
+		bottom_up(bottom_up)
+	{
+		if (!fs) {
+			using namespace attributes;
+			ste_log_error() << text::attributed_string("Can't open TGA ") + i(lib::to_string(file_name.string())) + ": " + std::strerror(errno) << std::endl;
+			throw resource_io_error("Could not open file");
+		}
+	}
+	~surface_io_tga_stream_decoder() noexcept {}
+};
+
+}
+
 opaque_surface<2> surface_io::load_tga_2d(const std::experimental::filesystem::path &file_name, bool srgb) {
 	// Open for reading and read header
 	TGA *tga = TGAOpen(const_cast<char*>(file_name.string().data()), const_cast<char*>("rb"));
@@ -161,3 +223,59 @@ void surface_io::write_tga_2d(const std::experimental::filesystem::path &file_na
 
 	TGAClose(tga);
 }
+
+lib::unique_ptr<surface_stream_decoder_2d> surface_io::open_tga_2d_stream(const std::experimental::filesystem::path &file_name, bool srgb) {
+	// Open for reading and read header
+	TGA *tga = TGAOpen(const_cast<char*>(file_name.string().data()), const_cast<char*>("rb"));
+	if (!tga || tga->last != TGA_OK ||
+		TGAReadHeader(tga) != TGA_OK) {
+		if (tga)
+			TGAClose(tga);
+		ste_log_error() << file_name << " is not a valid 24-bit TGA" << std::endl;
+		throw surface_unsupported_format_error("Not a valid 24-bit TGA");
+	}
+
+	const unsigned w = tga->hdr.width;
+	const unsigned h = tga->hdr.height;
+	const auto data_offset = static_cast<std::size_t>(TGA_IMG_DATA_OFF(tga));
+	const bool bottom_up = tga->hdr.vert != TGA_TOP;
+	const auto img_t = tga->hdr.img_t;
+	const auto depth = tga->hdr.depth;
+	const auto alpha = tga->hdr.alpha;
+	TGAClose(tga);
+
+	if (img_t != 2 && img_t != 3) {
+		// Run-length encoded scanlines can not be located without decoding all preceding scanlines
+		return nullptr;
+	}
+
+	// Choose format. Scanlines are stored in BGR(A) order.
+	gl::format format;
+	if (depth == 8 &&
+		(alpha == 0 || alpha == 8)) {
+		if (alpha == 8) {
+			// 8-bit depth and 8-bit alpha textures are masks, height maps, etc. sRGB makes no sense.
+			assert(!srgb);
+		}
+
+		format = srgb ? gl::format::r8_srgb : gl::format::r8_unorm;
+	}
+	else if (depth == 24 &&
+			 alpha == 0) {
+		format = srgb ? gl::format::b8g8r8_srgb : gl::format::b8g8r8_unorm;
+	}
+	else if (depth == 32 &&
+			 alpha == 8) {
+		format = srgb ? gl::format::b8g8r8a8_srgb : gl::format::b8g8r8a8_unorm;
+	}
+	else {
+		ste_log_error() << file_name << " Unsupported libtga depth (" << static_cast<int>(depth) << ") and image type (" << static_cast<int>(img_t) << ") combination" << std::endl;
+		throw surface_unsupported_format_error("Unsupported TGA depth/type combination");
+	}
+
+	return lib::allocate_unique<_detail::surface_io_tga_stream_decoder>(file_name,
+																		data_offset,
+																		bottom_up,
+																		format,
+																		glm::u32vec2{ w, h });
+}
@@ -0,0 +1,149 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <format.hpp>
+#include <format_type_traits.hpp>
+#include <format_rtti.hpp>
+#include <surface.hpp>
+#include <surface_convert.hpp>
+
+#include <task_scheduler.hpp>
+#include <task_future.hpp>
+
+#include <lib/vector.hpp>
+#include <algorithm>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	Streaming decoder of 2D images. Decodes the image in row strips, straight into a caller provided destination,
+ *			e.g. a mapped staging region, without creating intermediate surfaces.
+ *
+ *	Decoding is sequential, the decoded strips are converted to the target format on the task scheduler's workers while
+ *	the next strips are decoded.
+ */
+class surface_stream_decoder_2d {
+public:
+	// Rows per strip
+	static constexpr std::uint32_t strip_rows = 64;
+	// Maximal count of decoded strips that await conversion
+	static constexpr std::size_t max_strips_in_flight = 4;
+
+private:
+	gl::format format;
+	glm::u32vec2 extent;
+
+protected:
+	surface_stream_decoder_2d(gl::format format, const glm::u32vec2 &extent)
+		: format(format), extent(extent)
+	{}
+
+	/**
+	 *	@brief	Decodes the next rows, in top to bottom order, into dst. Rows are tightly packed, in the decoder's format.
+	 *
+	 *	@throws	surface_error	On decoding failures
+	 */
+	virtual void decode_rows(std::uint8_t *dst, std::uint32_t rows) = 0;
+
+public:
+	virtual ~surface_stream_decoder_2d() noexcept {}
+
+	surface_stream_decoder_2d(surface_stream_decoder_2d&&) = delete;
+	surface_stream_decoder_2d &operator=(surface_stream_decoder_2d&&) = delete;
+
+	/**
+	 *	@brief	Format of the decoded image
+	 */
+	auto get_format() const { return format; }
+	/**
+	 *	@brief	Extent of the decoded image
+	 */
+	auto get_extent() const { return extent; }
+	/**
+	 *	@brief	Bytes per decoded row
+	 */
+	auto row_bytes() const {
+		return static_cast<std::size_t>(extent.x) * static_cast<std::size_t>(gl::format_id(format).block_bytes);
+	}
+
+	/**
+	 *	@brief	Decodes the complete image into dst, converting to target_format. Can be called once.
+	 *
+	 *	@param	dst		Destination, must hold extent.x * extent.y blocks. Rows are written tightly packed.
+	 *	@param	sched	Scheduler on which the strips are converted
+	 *
+	 *	@throws	surface_error							On decoding failures
+	 *	@throws	surface_convert_format_mismatch_error	If can not convert to target_format
+	 */
+	template <gl::format target_format>
+	void decode(typename gl::format_traits<target_format>::block_type *dst,
+				task_scheduler &sched) {
+		const auto width = static_cast<std::size_t>(extent.x);
+		const auto height = extent.y;
+
+		if (format == target_format) {
+			// No conversion required, decode straight into the destination
+			for (std::uint32_t row = 0; row < height; row += strip_rows) {
+				const auto rows = std::min(strip_rows, height - row);
+				decode_rows(reinterpret_cast<std::uint8_t*>(dst + row * width), rows);
+			}
+			return;
+		}
+
+		const auto src_format = format;
+		const auto strip_bytes = row_bytes();
+
+		lib::vector<task_future<void>> in_flight;
+		in_flight.reserve(max_strips_in_flight);
+		try {
+			for (std::uint32_t row = 0; row < height; row += strip_rows) {
+				// Bound the memory held by pending strips
+				if (in_flight.size() == max_strips_in_flight) {
+					in_flight.front().get();
+					in_flight.erase(in_flight.begin());
+				}
+
+				// Decode a strip and convert it on a worker
+				const auto rows = std::min(strip_rows, height - row);
+				lib::vector<std::uint8_t> strip(strip_bytes * rows);
+				decode_rows(strip.data(), rows);
+
+				in_flight.push_back(sched.schedule_now([src_format, strip = std::move(strip), strip_dst = dst + row * width, blocks = rows * width]() {
+					surface_convert::convert_blocks<target_format>(src_format, strip.data(), strip_dst, blocks);
+				}));
+			}
+		}
+		catch (...) {
+			// The pending strips write into dst, wait for them before unwinding
+			for (auto &f : in_flight) {
+				try { f.get(); }
+				catch (...) {}
+			}
+			throw;
+		}
+
+		for (auto &f : in_flight)
+			f.get();
+	}
+
+	/**
+	 *	@brief	Decodes the complete image into a new surface, converting to target_format. Can be called once.
+	 *			See decode().
+	 *
+	 *	@param	sched	Scheduler on which the strips are converted
+	 */
+	template <gl::format target_format>
+	auto decode_surface(task_scheduler &sched) {
+		surface_2d<target_format> surface(extent);
+		decode<target_format>(surface.data(), sched);
+
+		return surface;
+	}
+};
+
+}
+}
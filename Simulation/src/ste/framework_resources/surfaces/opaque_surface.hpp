@@ -118,13 +118,13 @@ public:
 	*	@brief	Returns a pointer to the surface layer's level data
 	*/
 	auto* data_at(layers_t layer, levels_t level = 0_mips) {
-		return data() + offset_blocks(layer, level);
+		return data() + offset_blocks(layer, level) * static_cast<std::size_t>(block_bytes());
 	}
 	/**
 	*	@brief	Returns a pointer to the surface layer's level data
 	*/
 	const auto* data_at(layers_t layer, levels_t level = 0_mips) const {
-		return data() + offset_blocks(layer, level);
+		return data() + offset_blocks(layer, level) * static_cast<std::size_t>(block_bytes());
 	}
 
 	/**
@@ -142,12 +142,12 @@ public:
 	*	@param	level	Surface level
 	*/
 	auto extent_in_blocks(levels_t level = 0_mips) const {
-		auto extent = surface_extent;
-		extent.x /= block_extent().x;
-		if constexpr (dimensions > 1) extent.y /= block_extent().y;
+		// Partial blocks on the edges are counted as whole blocks
+		auto blocks = extent(level);
+		blocks.x = (blocks.x + block_extent().x - 1) / block_extent().x;
+		if constexpr (dimensions > 1) blocks.y = (blocks.y + block_extent().y - 1) / block_extent().y;
 
-		return glm::max(extent_type(static_cast<typename extent_type::value_type>(1)),
-						extent >> static_cast<typename extent_type::value_type>(level));
+		return blocks;
 	}
 	/**
 	*	@brief	Returns the levels count in the surface
@@ -187,9 +187,11 @@ public:
 	auto blocks(levels_t level) const {
 		assert(level < levels());
 
+		const auto level_blocks = extent_in_blocks(level);
+
 		std::size_t b = 1;
 		for (std::remove_cv_t<decltype(dimensions)> i = 0; i < dimensions; ++i)
-			b *= extent(level)[i];
+			b *= level_blocks[i];
 
 		return b;
 	}
@@ -0,0 +1,439 @@
+
+#include <stdafx.hpp>
+#include <surface_bc_encoder.hpp>
+
+#include <lib/shared_ptr.hpp>
+#include <lib/vector.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+using namespace ste;
+using namespace ste::resource;
+
+namespace ste::resource::_detail {
+
+/**
+ *	@brief	Writes a block bit by bit, from the least significant bit
+ */
+class bc_block_bit_writer {
+private:
+	std::uint8_t *dst;
+	std::uint32_t bit{ 0 };
+
+public:
+	bc_block_bit_writer(std::uint8_t *dst, std::size_t bytes) : dst(dst) {
+		std::memset(dst, 0, bytes);
+	}
+
+	void write(std::uint32_t value, std::uint32_t bits) {
+		for (std::uint32_t b = 0; b < bits; ++b, ++bit) {
+			if ((value >> b) & 1)
+				dst[bit >> 3] |= static_cast<std::uint8_t>(1 << (bit & 7));
+		}
+	}
+};
+
+/**
+ *	@brief	BC4 block encoder, encodes a single component
+ */
+struct bc4_block_encoder {
+	// Encodes the block with the given endpoints, returns the squared error
+	static std::uint32_t encode_with_endpoints(const std::uint8_t *values, std::uint8_t e0, std::uint8_t e1, std::uint8_t *dst) {
+		// e0 > e1 selects 8 interpolated values, otherwise 6 interpolated values and the explicit 0 and 255
+		int palette[8];
+		palette[0] = e0;
+		palette[1] = e1;
+		if (e0 > e1) {
+			for (int i = 2; i < 8; ++i)
+				palette[i] = ((8 - i) * e0 + (i - 1) * e1 + 3) / 7;
+		}
+		else {
+			for (int i = 2; i < 6; ++i)
+				palette[i] = ((6 - i) * e0 + (i - 1) * e1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		std::uint64_t indices = 0;
+		std::uint32_t error = 0;
+		for (int t = 0; t < 16; ++t) {
+			int best = 0;
+			int best_error = std::numeric_limits<int>::max();
+			for (int i = 0; i < 8; ++i) {
+				const int d = static_cast<int>(values[t]) - palette[i];
+				if (d * d < best_error) {
+					best_error = d * d;
+					best = i;
+				}
+			}
+
+			indices |= static_cast<std::uint64_t>(best) << (3 * t);
+			error += static_cast<std::uint32_t>(best_error);
+		}
+
+		dst[0] = e0;
+		dst[1] = e1;
+		for (int b = 0; b < 6; ++b)
+			dst[2 + b] = static_cast<std::uint8_t>(indices >> (8 * b));
+
+		return error;
+	}
+
+	static void encode(const std::uint8_t *values, std::uint8_t *dst) {
+		std::uint8_t min = 255, max = 0;
+		std::uint8_t inner_min = 255, inner_max = 0;
+		for (int t = 0; t < 16; ++t) {
+			min = std::min(min, values[t]);
+			max = std::max(max, values[t]);
+			if (values[t] != 0 && values[t] != 255) {
+				inner_min = std::min(inner_min, values[t]);
+				inner_max = std::max(inner_max, values[t]);
+			}
+		}
+
+		if (min == max) {
+			encode_with_endpoints(values, max, min, dst);
+			return;
+		}
+
+		// 8 values spanning the whole range
+		std::uint8_t block[8];
+		const auto error = encode_with_endpoints(values, max, min, block);
+
+		// 6 values spanning the range without the extremes, which are represented explicitly
+		if (error > 0 && (min == 0 || max == 255)) {
+			if (inner_min > inner_max)
+				inner_min = inner_max = 0;
+
+			std::uint8_t block6[8];
+			if (encode_with_endpoints(values, inner_min, inner_max, block6) < error) {
+				std::memcpy(dst, block6, 8);
+				return;
+			}
+		}
+
+		std::memcpy(dst, block, 8);
+	}
+};
+
+/**
+ *	@brief	BC7 block encoder, using mode 6
+ */
+struct bc7_block_encoder {
+	static constexpr int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	static constexpr int refinement_passes = 2;
+
+	struct endpoints {
+		// 7-bit endpoints and p-bits
+		int q[2][4];
+		int p[2];
+
+		int value(int e, int c) const { return (q[e][c] << 1) | p[e]; }
+	};
+
+	struct candidate {
+		endpoints ep;
+		int indices[16];
+		std::uint32_t error;
+	};
+
+	// Selects the indices for quantized endpoints, returns the squared error
+	static std::uint32_t select_indices(const int(&texels)[16][4], const endpoints &ep, int(&indices)[16]) {
+		int e0[4], e1[4];
+		for (int c = 0; c < 4; ++c) {
+			e0[c] = ep.value(0, c);
+			e1[c] = ep.value(1, c);
+		}
+
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 4; ++c)
+				palette[i][c] = ((64 - weights[i]) * e0[c] + weights[i] * e1[c] + 32) >> 6;
+		}
+
+		const auto texel_error = [&](int t, int i) {
+			int e = 0;
+			for (int c = 0; c < 4; ++c) {
+				const int d = texels[t][c] - palette[i][c];
+				e += d * d;
+			}
+			return e;
+		};
+
+		// Project onto the endpoints' axis for an initial index, then test the neighbouring indices
+		int axis[4];
+		int axis_length2 = 0;
+		for (int c = 0; c < 4; ++c) {
+			axis[c] = e1[c] - e0[c];
+			axis_length2 += axis[c] * axis[c];
+		}
+
+		std::uint32_t error = 0;
+		for (int t = 0; t < 16; ++t) {
+			int guess = 0;
+			if (axis_length2 > 0) {
+				int dot = 0;
+				for (int c = 0; c < 4; ++c)
+					dot += (texels[t][c] - e0[c]) * axis[c];
+				guess = glm::clamp(static_cast<int>(std::lround(15.f * static_cast<float>(dot) / static_cast<float>(axis_length2))), 0, 15);
+			}
+
+			int best = guess;
+			int best_error = texel_error(t, guess);
+			for (int i = std::max(0, guess - 1); i <= std::min(15, guess + 1); ++i) {
+				const auto e = texel_error(t, i);
+				if (e < best_error) {
+					best_error = e;
+					best = i;
+				}
+			}
+
+			indices[t] = best;
+			error += static_cast<std::uint32_t>(best_error);
+		}
+
+		return error;
+	}
+
+	// Quantizes unquantized endpoints, trying all p-bit combinations, and keeps the best candidate
+	static void quantize(const int(&texels)[16][4], const float(&e)[2][4], candidate &best) {
+		for (int pbits = 0; pbits < 4; ++pbits) {
+			candidate c;
+			c.ep.p[0] = pbits & 1;
+			c.ep.p[1] = pbits >> 1;
+			for (int i = 0; i < 2; ++i) {
+				for (int ch = 0; ch < 4; ++ch) {
+					const auto v = (glm::clamp(e[i][ch], .0f, 255.f) - static_cast<float>(c.ep.p[i])) * .5f;
+					c.ep.q[i][ch] = glm::clamp(static_cast<int>(std::lround(v)), 0, 127);
+				}
+			}
+
+			c.error = select_indices(texels, c.ep, c.indices);
+			if (c.error < best.error)
+				best = c;
+		}
+	}
+
+	static void encode(const std::uint8_t *rgba, std::uint8_t *dst) {
+		int texels[16][4];
+		for (int t = 0; t < 16; ++t) {
+			for (int c = 0; c < 4; ++c)
+				texels[t][c] = rgba[4 * t + c];
+		}
+
+		// Principal axis of the texels
+		float mean[4] = { .0f, .0f, .0f, .0f };
+		for (int t = 0; t < 16; ++t) {
+			for (int c = 0; c < 4; ++c)
+				mean[c] += static_cast<float>(texels[t][c]) / 16.f;
+		}
+
+		float cov[4][4] = {};
+		for (int t = 0; t < 16; ++t) {
+			float d[4];
+			for (int c = 0; c < 4; ++c)
+				d[c] = static_cast<float>(texels[t][c]) - mean[c];
+			for (int i = 0; i < 4; ++i) {
+				for (int j = 0; j < 4; ++j)
+					cov[i][j] += d[i] * d[j];
+			}
+		}
+
+		float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+		for (int iteration = 0; iteration < 8; ++iteration) {
+			float a[4] = {};
+			for (int i = 0; i < 4; ++i) {
+				for (int j = 0; j < 4; ++j)
+					a[i] += cov[i][j] * axis[j];
+			}
+
+			float length2 = .0f;
+			for (int c = 0; c < 4; ++c)
+				length2 += a[c] * a[c];
+			if (length2 < 1e-12f)
+				break;
+
+			const auto rcp_length = 1.f / std::sqrt(length2);
+			for (int c = 0; c < 4; ++c)
+				axis[c] = a[c] * rcp_length;
+		}
+
+		// Endpoints at the extents of the texels' projections on the axis
+		float tmin = std::numeric_limits<float>::max();
+		float tmax = -std::numeric_limits<float>::max();
+		for (int t = 0; t < 16; ++t) {
+			float proj = .0f;
+			for (int c = 0; c < 4; ++c)
+				proj += (static_cast<float>(texels[t][c]) - mean[c]) * axis[c];
+			tmin = std::min(tmin, proj);
+			tmax = std::max(tmax, proj);
+		}
+
+		float e[2][4];
+		for (int c = 0; c < 4; ++c) {
+			e[0][c] = mean[c] + tmin * axis[c];
+			e[1][c] = mean[c] + tmax * axis[c];
+		}
+
+		candidate best;
+		best.error = std::numeric_limits<std::uint32_t>::max();
+		quantize(texels, e, best);
+
+		// Least squares refinement of the endpoints for the selected indices
+		for (int pass = 0; pass < refinement_passes && best.error > 0; ++pass) {
+			float aa = .0f, ab = .0f, bb = .0f;
+			float ax[4] = {}, bx[4] = {};
+			for (int t = 0; t < 16; ++t) {
+				const auto w = static_cast<float>(weights[best.indices[t]]) / 64.f;
+				const auto a = 1.f - w;
+				aa += a * a;
+				ab += a * w;
+				bb += w * w;
+				for (int c = 0; c < 4; ++c) {
+					ax[c] += a * static_cast<float>(texels[t][c]);
+					bx[c] += w * static_cast<float>(texels[t][c]);
+				}
+			}
+
+			const auto det = aa * bb - ab * ab;
+			if (std::abs(det) < 1e-6f)
+				break;
+
+			const auto rcp_det = 1.f / det;
+			float refined[2][4];
+			for (int c = 0; c < 4; ++c) {
+				refined[0][c] = (bb * ax[c] - ab * bx[c]) * rcp_det;
+				refined[1][c] = (aa * bx[c] - ab * ax[c]) * rcp_det;
+			}
+
+			const auto error = best.error;
+			quantize(texels, refined, best);
+			if (best.error >= error)
+				break;
+		}
+
+		// The most significant bit of the first index is implicitly 0, swap the endpoints if required
+		if (best.indices[0] & 8) {
+			std::swap(best.ep.q[0], best.ep.q[1]);
+			std::swap(best.ep.p[0], best.ep.p[1]);
+			for (auto &i : best.indices)
+				i = 15 - i;
+		}
+
+		// Write block
+		bc_block_bit_writer writer(dst, 16);
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c) {
+			writer.write(static_cast<std::uint32_t>(best.ep.q[0][c]), 7);
+			writer.write(static_cast<std::uint32_t>(best.ep.q[1][c]), 7);
+		}
+		writer.write(static_cast<std::uint32_t>(best.ep.p[0]), 1);
+		writer.write(static_cast<std::uint32_t>(best.ep.p[1]), 1);
+		writer.write(static_cast<std::uint32_t>(best.indices[0]), 3);
+		for (int t = 1; t < 16; ++t)
+			writer.write(static_cast<std::uint32_t>(best.indices[t]), 4);
+	}
+};
+
+/**
+ *	@brief	Runs encode_row for each row in [0, rows) in parallel.
+ *
+ *	The calling thread encodes rows as well, and waits only for rows already claimed by workers, so it never waits for
+ *	tasks that have not started, even if all workers are busy. Workers that start late find no rows left.
+ */
+template <typename F>
+void bc_parallel_rows(task_scheduler &sched, std::uint32_t rows, const F &encode_row) {
+	if (rows == 0)
+		return;
+
+	struct state_t {
+		std::atomic<std::uint32_t> next{ 0 };
+		std::atomic<std::uint32_t> done{ 0 };
+	};
+	auto state = lib::allocate_shared<state_t>();
+
+	auto work = [state, rows, &encode_row]() {
+		for (auto row = state->next++; row < rows; row = state->next++) {
+			encode_row(row);
+			++state->done;
+		}
+	};
+
+	const auto helpers = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, rows - 1);
+	for (std::uint32_t i = 0; i < helpers; ++i)
+		sched.schedule_now(work);
+
+	work();
+	while (state->done.load() < rows)
+		std::this_thread::yield();
+}
+
+}
+
+bool surface_bc_encoder::is_supported(gl::format target_format) {
+	switch (target_format) {
+	case gl::format::bc4_unorm_block:
+	case gl::format::bc5_unorm_block:
+	case gl::format::bc7_unorm_block:
+	case gl::format::bc7_srgb_block:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void surface_bc_encoder::encode_2d(gl::format target_format,
+								   const std::uint8_t *texels,
+								   std::size_t texel_bytes,
+								   const glm::u32vec2 &extent,
+								   std::uint8_t *dst,
+								   task_scheduler &sched) {
+	using namespace _detail;
+
+	if (!is_supported(target_format))
+		throw surface_convert_format_mismatch_error("Unsupported block-compressed target format");
+
+	const bool bc7 = target_format == gl::format::bc7_unorm_block || target_format == gl::format::bc7_srgb_block;
+	const std::size_t components = target_format == gl::format::bc4_unorm_block ? 1 : (target_format == gl::format::bc5_unorm_block ? 2 : 4);
+	if (texel_bytes < components || (bc7 && texel_bytes != 4))
+		throw surface_convert_format_mismatch_error("Source texels are incompatible with the block-compressed target format");
+
+	const auto block_bytes = target_format == gl::format::bc4_unorm_block ? 8 : 16;
+	const auto blocks_x = (extent.x + 3) / 4;
+	const auto blocks_y = (extent.y + 3) / 4;
+
+	bc_parallel_rows(sched, blocks_y, [&](std::uint32_t by) {
+		for (std::uint32_t bx = 0; bx < blocks_x; ++bx) {
+			// Gather the block's texels component-wise, replicating the edges
+			std::uint8_t block[4][16];
+			for (std::uint32_t y = 0; y < 4; ++y) {
+				const auto sy = std::min(by * 4 + y, extent.y - 1);
+				for (std::uint32_t x = 0; x < 4; ++x) {
+					const auto sx = std::min(bx * 4 + x, extent.x - 1);
+					const auto *texel = texels + (static_cast<std::size_t>(sy) * extent.x + sx) * texel_bytes;
+					for (std::size_t c = 0; c < components; ++c)
+						block[c][y * 4 + x] = texel[c];
+				}
+			}
+
+			auto *out = dst + (static_cast<std::size_t>(by) * blocks_x + bx) * block_bytes;
+			if (bc7) {
+				std::uint8_t rgba[64];
+				for (int t = 0; t < 16; ++t) {
+					for (int c = 0; c < 4; ++c)
+						rgba[4 * t + c] = block[c][t];
+				}
+				bc7_block_encoder::encode(rgba, out);
+			}
+			else {
+				for (std::size_t c = 0; c < components; ++c)
+					bc4_block_encoder::encode(block[c], out + 8 * c);
+			}
+		}
+	});
+}
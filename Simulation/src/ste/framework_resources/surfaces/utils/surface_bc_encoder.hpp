@@ -0,0 +1,98 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <format.hpp>
+#include <format_type_traits.hpp>
+
+#include <surface.hpp>
+#include <opaque_surface.hpp>
+#include <surface_exceptions.hpp>
+
+#include <task_scheduler.hpp>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	Block-compression encoder of 8-bit surfaces into BC4, BC5 and BC7 formats.
+ *
+ *	BC4 and BC5 blocks select the better of the 8-value and 6-value (with explicit 0 and 255) interpolation modes.
+ *	BC7 blocks are encoded with mode 6: a single subset with RGBA endpoints, fitted along the principal axis of the
+ *	block's texels and refined by least squares, and 4-bit indices. sRGB formats encode the stored, sRGB encoded,
+ *	values.
+ *
+ *	Rows of blocks are encoded in parallel on the task scheduler's workers.
+ */
+class surface_bc_encoder {
+public:
+	/**
+	 *	@brief	Returns true if the format can be encoded into
+	 */
+	static bool is_supported(gl::format target_format);
+
+	/**
+	 *	@brief	Encodes an image of 8-bit texels into blocks of the target format. Partial blocks on the image edges are
+	 *			padded by replicating the edge texels.
+	 *
+	 *	@param	target_format	Target block-compressed format, see is_supported()
+	 *	@param	texels			Source texels, tightly packed in row-major order. BC4 encodes the first component, BC5 the
+	 *							first two components and BC7 requires 4 components.
+	 *	@param	texel_bytes		Size of a source texel, in bytes
+	 *	@param	extent			Source image extent
+	 *	@param	dst				Destination blocks, tightly packed in row-major order
+	 *	@param	sched			Scheduler on which the block rows are encoded
+	 *
+	 *	@throws	surface_convert_format_mismatch_error	If can not encode into target_format, or the source texels are
+	 *													incompatible
+	 */
+	static void encode_2d(gl::format target_format,
+						  const std::uint8_t *texels,
+						  std::size_t texel_bytes,
+						  const glm::u32vec2 &extent,
+						  std::uint8_t *dst,
+						  task_scheduler &sched);
+
+	/**
+	 *	@brief	Encodes all levels of a 2D surface of an 8-bit per component format into an opaque surface of the
+	 *			target format.
+	 *
+	 *	@throws	surface_convert_format_mismatch_error	If can not encode into target_format
+	 *	@throws	surface_error							If the surface levels do not divide into whole blocks
+	 */
+	template <gl::format format>
+	static auto encode_2d(gl::format target_format,
+						  const surface_2d<format> &surface,
+						  task_scheduler &sched) {
+		using traits = gl::format_traits<format>;
+		static_assert(!traits::is_compressed && traits::block_bytes == byte_t(traits::elements),
+					  "Expected a format with 8-bit components");
+
+		opaque_surface<2> blocks(target_format,
+								 gl::image_type::image_2d,
+								 surface.extent(),
+								 surface.levels(),
+								 1_layer);
+
+		for (auto level = 0_mip; level < surface.levels(); ++level) {
+			const auto extent = surface.extent(level);
+			const auto level_blocks = static_cast<std::size_t>((extent.x + 3) / 4) * static_cast<std::size_t>((extent.y + 3) / 4);
+			if (level_blocks != blocks.blocks(level))
+				throw surface_error("Surface level does not divide into whole blocks");
+
+			encode_2d(target_format,
+					  reinterpret_cast<const std::uint8_t*>(surface.data_at(0_layer, level)),
+					  static_cast<std::size_t>(traits::block_bytes),
+					  extent,
+					  blocks.data_at(0_layer, level),
+					  sched);
+		}
+
+		return blocks;
+	}
+};
+
+}
+}
@@ -12,9 +12,11 @@
 
 #include <surface_block_load.hpp>
 #include <surface_block_store.hpp>
+#include <surface_convert_kernels.hpp>
 
 #include <lib/vector.hpp>
 #include <lib/shared_ptr.hpp>
+#include <cstring>
 
 namespace ste {
 namespace resource {
@@ -43,6 +45,71 @@ private:
 			}
 		}
 
+		template <gl::format target_format, typename common_type>
+		static void convert_blocks(gl::format src_format,
+								   const std::uint8_t *src_data,
+								   byte_t src_block_bytes,
+								   typename gl::format_traits<target_format>::block_type *dst_data,
+								   std::size_t blocks_count,
+								   block_load_8component_result_t<common_type>(*src_block_loader8_r)(const std::uint8_t*, unsigned),
+								   block_load_8component_result_t<common_type>(*src_block_loader8_g)(const std::uint8_t*, unsigned),
+								   block_load_8component_result_t<common_type>(*src_block_loader8_b)(const std::uint8_t*, unsigned),
+								   block_load_8component_result_t<common_type>(*src_block_loader8_a)(const std::uint8_t*, unsigned)) {
+			// Use a dedicated kernel, if available for the formats
+			const auto kernel = surface_convert_kernels::find(src_format, target_format);
+			if (kernel) {
+				kernel(src_data, reinterpret_cast<std::uint8_t*>(dst_data), blocks_count);
+				return;
+			}
+
+			for (std::size_t b = 0; b < blocks_count; b += 8) {
+				// Set source and destination
+				auto src = src_data + b * static_cast<std::size_t>(src_block_bytes);
+				auto dst = dst_data + b;
+
+				// Maximal count of blocks to decode (limited to 8)
+				unsigned count = std::min(static_cast<unsigned>(blocks_count - b), 8u);
+
+				// Load and store components
+				if constexpr (gl::format_traits<target_format>::elements > 0) {
+					// R
+					if (src_block_loader8_r) {
+						auto loader_result = src_block_loader8_r(src, count);
+						resource::store_block_8component<gl::component_swizzle::r>(dst, loader_result.data, count);
+					}
+					else
+						resource::store_block_8component_default<gl::component_swizzle::r>(dst, count);
+				}
+				if constexpr (gl::format_traits<target_format>::elements > 1) {
+					// G
+					if (src_block_loader8_g) {
+						auto loader_result = src_block_loader8_g(src, count);
+						resource::store_block_8component<gl::component_swizzle::g>(dst, loader_result.data, count);
+					}
+					else
+						resource::store_block_8component_default<gl::component_swizzle::g>(dst, count);
+				}
+				if constexpr (gl::format_traits<target_format>::elements > 2) {
+					// B
+					if (src_block_loader8_b) {
+						auto loader_result = src_block_loader8_b(src, count);
+						resource::store_block_8component<gl::component_swizzle::b>(dst, loader_result.data, count);
+					}
+					else
+						resource::store_block_8component_default<gl::component_swizzle::b>(dst, count);
+				}
+				if constexpr (gl::format_traits<target_format>::elements > 3) {
+					// A
+					if (src_block_loader8_a) {
+						auto loader_result = src_block_loader8_a(src, count);
+						resource::store_block_8component<gl::component_swizzle::a>(dst, loader_result.data, count);
+					}
+					else
+						resource::store_block_8component_default<gl::component_swizzle::a>(dst, count);
+				}
+			}
+		}
+
 		template <gl::format target_format, typename Target, typename common_type, typename Src>
 		static Target convert(Src &&surface,
 							  block_load_8component_result_t<common_type>(*src_block_loader8_r)(const std::uint8_t*, unsigned),
@@ -84,52 +151,15 @@ private:
 					auto src_layer_data = reinterpret_cast<const std::uint8_t*>(surface.data_at(a, l));
 					auto dst_layer_data = target.data_at(a, l);
 
-					for (std::size_t b = 0; b < src_blocks_count; b += 8) {
-						// Set source and destination
-						auto src = src_layer_data + b * static_cast<std::size_t>(src_traits.block_bytes);
-						auto dst = dst_layer_data + b;
-
-						// Maximal count of blocks to decode (limited to 8)
-						unsigned count = std::min(static_cast<unsigned>(src_blocks_count - b), 8u);
-
-						// Load and store components
-						if constexpr (gl::format_traits<target_format>::elements > 0) {
-							// R
-							if (src_block_loader8_r) {
-								auto loader_result = src_block_loader8_r(src, count);
-								resource::store_block_8component<gl::component_swizzle::r>(dst, loader_result.data, count);
-							}
-							else
-								resource::store_block_8component_default<gl::component_swizzle::r>(dst, count);
-						}
-						if constexpr (gl::format_traits<target_format>::elements > 1) {
-							// G
-							if (src_block_loader8_g) {
-								auto loader_result = src_block_loader8_g(src, count);
-								resource::store_block_8component<gl::component_swizzle::g>(dst, loader_result.data, count);
-							}
-							else
-								resource::store_block_8component_default<gl::component_swizzle::g>(dst, count);
-						}
-						if constexpr (gl::format_traits<target_format>::elements > 2) {
-							// B
-							if (src_block_loader8_b) {
-								auto loader_result = src_block_loader8_b(src, count);
-								resource::store_block_8component<gl::component_swizzle::b>(dst, loader_result.data, count);
-							}
-							else
-								resource::store_block_8component_default<gl::component_swizzle::b>(dst, count);
-						}
-						if constexpr (gl::format_traits<target_format>::elements > 3) {
-							// A
-							if (src_block_loader8_a) {
-								auto loader_result = src_block_loader8_a(src, count);
-								resource::store_block_8component<gl::component_swizzle::a>(dst, loader_result.data, count);
-							}
-							else
-								resource::store_block_8component_default<gl::component_swizzle::a>(dst, count);
-						}
-					}
+					convert_blocks<target_format, common_type>(surface.surface_format(),
+																src_layer_data,
+																src_traits.block_bytes,
+																dst_layer_data,
+																src_blocks_count,
+																src_block_loader8_r,
+																src_block_loader8_g,
+																src_block_loader8_b,
+																src_block_loader8_a);
 				}
 			}
 
@@ -205,6 +235,70 @@ private:
 			}
 			}
 		}
+
+		template <gl::format target_format>
+		static void convert_blocks_opaque(gl::format src_format,
+										  const std::uint8_t *src,
+										  typename gl::format_traits<target_format>::block_type *dst,
+										  std::size_t blocks_count) {
+			const auto src_traits = gl::format_id(src_format);
+			if (gl::format_traits<target_format>::is_compressed || src_traits.is_compressed) {
+				// Format is a compressed format
+				throw surface_convert_format_mismatch_error("Target or source format must not be a compressed type");
+			}
+			if (src_traits.block_extent.x != 1 || src_traits.block_extent.y != 1) {
+				// Block size isn't 1x1
+				throw surface_convert_format_mismatch_error("Source block size must be 1x1");
+			}
+
+			// Query format's block loader function pointer and convert
+			switch (src_traits.block_common_type_name) {
+			default:
+				assert(false);
+			case block_common_type::fp32: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_fp32<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_fp32<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_fp32<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_fp32<gl::component_swizzle::a>(src_traits));
+			}
+			case block_common_type::fp64: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_fp64<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_fp64<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_fp64<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_fp64<gl::component_swizzle::a>(src_traits));
+			}
+			case block_common_type::int32: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_i32<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_i32<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_i32<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_i32<gl::component_swizzle::a>(src_traits));
+			}
+			case block_common_type::int64: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_i64<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_i64<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_i64<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_i64<gl::component_swizzle::a>(src_traits));
+			}
+			case block_common_type::uint32: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_u32<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_u32<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_u32<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_u32<gl::component_swizzle::a>(src_traits));
+			}
+			case block_common_type::uint64: {
+				return convert_blocks<target_format>(src_format, src, src_traits.block_bytes, dst, blocks_count,
+													 gl::format_block_loader_8component_u64<gl::component_swizzle::r>(src_traits),
+													 gl::format_block_loader_8component_u64<gl::component_swizzle::g>(src_traits),
+													 gl::format_block_loader_8component_u64<gl::component_swizzle::b>(src_traits),
+													 gl::format_block_loader_8component_u64<gl::component_swizzle::a>(src_traits));
+			}
+			}
+		}
 	};
 
 public:
@@ -279,6 +373,31 @@ public:
 	}
 
 
+	/**
+	*	@brief	Converts blocks of source_format into blocks of target_format. Source and target formats must be uncompressed
+	*			formats with 1x1 blocks. Used to convert partial surfaces, e.g. decoded rows, without creating surfaces.
+	*
+	*	@param	source_format	Format of the source blocks
+	*	@param	src				Source blocks
+	*	@param	dst				Destination blocks
+	*	@param	blocks_count	Count of blocks to convert
+	*
+	*	@trows	surface_convert_format_mismatch_error	If can not convert input to target_format
+	*/
+	template <gl::format target_format>
+	static void convert_blocks(gl::format source_format,
+							   const std::uint8_t *src,
+							   typename gl::format_traits<target_format>::block_type *dst,
+							   std::size_t blocks_count) {
+		if (source_format == target_format) {
+			// Identical formats, no need to convert
+			std::memcpy(dst, src, blocks_count * static_cast<std::size_t>(gl::format_traits<target_format>::block_bytes));
+			return;
+		}
+
+		_impl::convert_blocks_opaque<target_format>(source_format, src, dst, blocks_count);
+	}
+
 	/**
 	*	@brief	Converts a surface from source format to specified target format
 	*
@@ -0,0 +1,594 @@
+
+#include <stdafx.hpp>
+#include <surface_convert_kernels.hpp>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace ste;
+using namespace ste::resource;
+
+// The kernels are compiled for their instruction set, and selected at runtime.
+#if defined(__GNUC__) || defined(__clang__)
+#define STE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define STE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define STE_TARGET_SSE41
+#define STE_TARGET_AVX2
+#endif
+
+namespace {
+
+surface_convert_kernels::isa detect_isa() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	const int ids = info[0];
+
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	// AVX2 requires the OS to preserve the YMM state
+	bool avx2 = false;
+	if (ids >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool sse41 = !!__builtin_cpu_supports("sse4.1");
+	const bool avx2 = !!__builtin_cpu_supports("avx2");
+#endif
+
+	if (avx2)
+		return surface_convert_kernels::isa::avx2;
+	if (sse41)
+		return surface_convert_kernels::isa::sse41;
+	return surface_convert_kernels::isa::scalar;
+}
+
+/*
+ *	sRGB lookup tables.
+ *	Decoding is a direct lookup of the 8-bit code. Encoding looks up the code of the lower bound of the linear value's
+ *	bucket, and increments it if the value is past the threshold to the next code. The buckets are narrower than the
+ *	distance between consecutive thresholds, so each bucket holds at most a single threshold.
+ */
+struct srgb_luts {
+	static constexpr std::int32_t encode_buckets = 4096;
+
+	alignas(32) float decode[256];
+	alignas(32) std::int32_t encode_code[encode_buckets];
+	// Linear value from which code+1 is encoded
+	alignas(32) float encode_threshold[256];
+
+	srgb_luts() {
+		const auto to_linear = [](double s) {
+			return s <= 0.04045 ?
+				s / 12.92 :
+				std::pow((s + 0.055) / 1.055, 2.4);
+		};
+
+		for (int c = 0; c < 256; ++c) {
+			decode[c] = static_cast<float>(to_linear(static_cast<double>(c) / 255.0));
+			encode_threshold[c] = c < 255 ?
+				static_cast<float>(to_linear((static_cast<double>(c) + .5) / 255.0)) :
+				std::numeric_limits<float>::infinity();
+		}
+
+		std::int32_t code = 0;
+		for (std::int32_t i = 0; i < encode_buckets; ++i) {
+			const auto x = static_cast<float>(i) / static_cast<float>(encode_buckets);
+			while (x >= encode_threshold[code])
+				++code;
+			encode_code[i] = code;
+		}
+	}
+
+	static const srgb_luts &get() {
+		static const srgb_luts luts;
+		return luts;
+	}
+};
+
+// Layout of a format with 8-bit components. Component offsets are in bytes.
+template <unsigned components, bool swap_rb>
+struct layout_8bit {
+	static constexpr unsigned bytes = components;
+	static constexpr unsigned r = swap_rb ? 2 : 0;
+	static constexpr unsigned g = 1;
+	static constexpr unsigned b = swap_rb ? 0 : 2;
+	static constexpr unsigned a = 3;
+
+	// Pixels that cover the bytes read by load_rgba8_x4 and load_rgba8_x8
+	static constexpr std::size_t x4_read_pixels = (16 + bytes - 1) / bytes;
+	static constexpr std::size_t x8_read_pixels = (4 * bytes + 16 + bytes - 1) / bytes;
+
+	// RGBA component stored at byte offset
+	static constexpr unsigned component_at(unsigned offset) {
+		return offset == r ? 0 : offset == g ? 1 : offset == b ? 2 : 3;
+	}
+	// Byte offset of RGBA component
+	static constexpr unsigned offset_of(unsigned component) {
+		return component == 0 ? r : component == 1 ? g : component == 2 ? b : a;
+	}
+};
+
+using rgba8_layout = layout_8bit<4, false>;
+using bgra8_layout = layout_8bit<4, true>;
+using rgb8_layout = layout_8bit<3, false>;
+using bgr8_layout = layout_8bit<3, true>;
+
+/*
+ *	Scalar encoders and decoders. The vectorized kernels produce identical results.
+ */
+
+float decode_unorm8(std::uint8_t v) {
+	return static_cast<float>(v) * (1.f / 255.f);
+}
+float clamp_unorm(float x) {
+	// NaNs are clamped to 0, like _mm_max_ps
+	x = x > .0f ? x : .0f;
+	return x < 1.f ? x : 1.f;
+}
+std::uint8_t encode_unorm8(float x) {
+	return static_cast<std::uint8_t>(std::nearbyint(clamp_unorm(x) * 255.f));
+}
+std::uint8_t encode_srgb8(const srgb_luts &luts, float x) {
+	x = clamp_unorm(x);
+	const auto bucket = std::min(static_cast<std::int32_t>(x * static_cast<float>(srgb_luts::encode_buckets)),
+								 srgb_luts::encode_buckets - 1);
+	auto code = luts.encode_code[bucket];
+	if (x >= luts.encode_threshold[code])
+		++code;
+	return static_cast<std::uint8_t>(code);
+}
+
+/*
+ *	Shuffles of 8-bit components
+ */
+
+// Shuffle mask that expands 4 pixels of layout L into 4 RGBA pixels. Missing alpha is zeroed.
+template <typename L>
+STE_TARGET_SSE41 __m128i expand_to_rgba8_mask() {
+	const auto index = [](unsigned i) -> char {
+		const auto pixel = i / 4;
+		const auto component = i % 4;
+		if (component >= L::bytes)
+			return static_cast<char>(0x80);
+		return static_cast<char>(pixel * L::bytes + L::offset_of(component));
+	};
+	return _mm_setr_epi8(index(0), index(1), index(2), index(3), index(4), index(5), index(6), index(7),
+						 index(8), index(9), index(10), index(11), index(12), index(13), index(14), index(15));
+}
+
+// Shuffle mask that compacts 4 RGBA pixels into 4 pixels of layout L
+template <typename L>
+STE_TARGET_SSE41 __m128i compact_from_rgba8_mask() {
+	const auto index = [](unsigned i) -> char {
+		const auto pixel = i / L::bytes;
+		const auto offset = i % L::bytes;
+		if (pixel >= 4)
+			return static_cast<char>(0x80);
+		return static_cast<char>(pixel * 4 + L::component_at(offset));
+	};
+	return _mm_setr_epi8(index(0), index(1), index(2), index(3), index(4), index(5), index(6), index(7),
+						 index(8), index(9), index(10), index(11), index(12), index(13), index(14), index(15));
+}
+
+// Loads 4 pixels of layout L as RGBA. Reads 16 bytes.
+template <typename L>
+STE_TARGET_SSE41 __m128i load_rgba8_x4(const std::uint8_t *src) {
+	auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	if constexpr (!std::is_same_v<L, rgba8_layout>)
+		v = _mm_shuffle_epi8(v, expand_to_rgba8_mask<L>());
+	if constexpr (L::bytes == 3)
+		v = _mm_or_si128(v, _mm_set1_epi32(static_cast<std::int32_t>(0xFF000000)));
+	return v;
+}
+
+// Loads 8 pixels of layout L as RGBA, 4 pixels per 128-bit lane. Reads 32 bytes for 4 component layouts and 28 bytes
+// otherwise.
+template <typename L>
+STE_TARGET_AVX2 __m256i load_rgba8_x8(const std::uint8_t *src) {
+	__m256i v;
+	if constexpr (L::bytes == 4)
+		v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+	else
+		v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+									_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * L::bytes)),
+									1);
+
+	if constexpr (!std::is_same_v<L, rgba8_layout>) {
+		const auto mask = expand_to_rgba8_mask<L>();
+		v = _mm256_shuffle_epi8(v, _mm256_inserti128_si256(_mm256_castsi128_si256(mask), mask, 1));
+	}
+	if constexpr (L::bytes == 3)
+		v = _mm256_or_si256(v, _mm256_set1_epi32(static_cast<std::int32_t>(0xFF000000)));
+	return v;
+}
+
+// Stores 4 RGBA pixels in layout L. Writes 4*L::bytes bytes.
+template <typename L>
+STE_TARGET_SSE41 void store_rgba8_x4(std::uint8_t *dst, __m128i v) {
+	if constexpr (std::is_same_v<L, rgba8_layout>) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+	}
+	else {
+		v = _mm_shuffle_epi8(v, compact_from_rgba8_mask<L>());
+		if constexpr (L::bytes == 4) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+		}
+		else {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), v);
+			const auto last = _mm_extract_epi32(v, 2);
+			std::memcpy(dst + 8, &last, 4);
+		}
+	}
+}
+
+// Stores 8 RGBA pixels, 4 pixels per 128-bit lane, in layout L. Writes 8*L::bytes bytes.
+template <typename L>
+STE_TARGET_AVX2 void store_rgba8_x8(std::uint8_t *dst, __m256i v) {
+	if constexpr (std::is_same_v<L, rgba8_layout>) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+	}
+	else {
+		const auto mask = compact_from_rgba8_mask<L>();
+		v = _mm256_shuffle_epi8(v, _mm256_inserti128_si256(_mm256_castsi128_si256(mask), mask, 1));
+		if constexpr (L::bytes == 4) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+		}
+		else {
+			// Each lane holds 12 bytes, pack them together
+			v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(v));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 16), _mm256_extracti128_si256(v, 1));
+		}
+	}
+}
+
+/*
+ *	Vectorized encoders and decoders
+ */
+
+// Decodes 4 RGBA 8-bit components, in the 4 low bytes of v
+template <bool srgb>
+STE_TARGET_SSE41 __m128 decode_rgba8_x1_sse41(const srgb_luts &luts, __m128i v) {
+	const auto i = _mm_cvtepu8_epi32(v);
+	const auto unorm = _mm_mul_ps(_mm_cvtepi32_ps(i), _mm_set1_ps(1.f / 255.f));
+	if constexpr (!srgb)
+		return unorm;
+
+	// Alpha is linear
+	const auto s = _mm_setr_ps(luts.decode[_mm_extract_epi32(i, 0)],
+							   luts.decode[_mm_extract_epi32(i, 1)],
+							   luts.decode[_mm_extract_epi32(i, 2)],
+							   .0f);
+	return _mm_blend_ps(s, unorm, 0x8);
+}
+
+// Decodes 2 RGBA pixels of 8-bit components, in the 8 low bytes of v
+template <bool srgb>
+STE_TARGET_AVX2 __m256 decode_rgba8_x2_avx2(const srgb_luts &luts, __m128i v) {
+	const auto i = _mm256_cvtepu8_epi32(v);
+	const auto unorm = _mm256_mul_ps(_mm256_cvtepi32_ps(i), _mm256_set1_ps(1.f / 255.f));
+	if constexpr (!srgb)
+		return unorm;
+
+	// Alpha is linear
+	const auto s = _mm256_i32gather_ps(luts.decode, i, 4);
+	return _mm256_blend_ps(s, unorm, 0x88);
+}
+
+// Encodes an RGBA pixel into 32-bit integer components
+template <bool srgb>
+STE_TARGET_SSE41 __m128i encode_rgba8_x1_sse41(const srgb_luts &luts, __m128 x) {
+	x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.f));
+	const auto unorm = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(255.f)));
+	if constexpr (!srgb)
+		return unorm;
+
+	alignas(16) float f[4];
+	_mm_store_ps(f, x);
+	const auto s = _mm_setr_epi32(encode_srgb8(luts, f[0]),
+								  encode_srgb8(luts, f[1]),
+								  encode_srgb8(luts, f[2]),
+								  0);
+	return _mm_blend_epi16(s, unorm, 0xC0);
+}
+
+// Encodes 2 RGBA pixels into 32-bit integer components
+template <bool srgb>
+STE_TARGET_AVX2 __m256i encode_rgba8_x2_avx2(const srgb_luts &luts, __m256 x) {
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+	const auto unorm = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(255.f)));
+	if constexpr (!srgb)
+		return unorm;
+
+	const auto bucket = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(static_cast<float>(srgb_luts::encode_buckets)))),
+										 _mm256_set1_epi32(srgb_luts::encode_buckets - 1));
+	const auto code = _mm256_i32gather_epi32(luts.encode_code, bucket, 4);
+	const auto threshold = _mm256_i32gather_ps(luts.encode_threshold, code, 4);
+	// Comparison mask is -1 where past the threshold
+	const auto past = _mm256_castps_si256(_mm256_cmp_ps(x, threshold, _CMP_GE_OQ));
+	const auto s = _mm256_sub_epi32(code, past);
+
+	// Alpha is linear
+	return _mm256_blend_epi32(s, unorm, 0x88);
+}
+
+/*
+ *	Kernels
+ */
+
+// 8-bit components of layout L to r32g32b32a32_sfloat
+template <typename L, bool srgb>
+struct kernel_8bit_to_rgba32f {
+	static void scalar(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		for (std::size_t i = 0; i < count; ++i, src += L::bytes, dst += 16) {
+			const float out[4] = {
+				srgb ? luts.decode[src[L::r]] : decode_unorm8(src[L::r]),
+				srgb ? luts.decode[src[L::g]] : decode_unorm8(src[L::g]),
+				srgb ? luts.decode[src[L::b]] : decode_unorm8(src[L::b]),
+				L::bytes == 4 ? decode_unorm8(src[L::a]) : 1.f,
+			};
+			// dst need not be aligned
+			std::memcpy(dst, out, sizeof(out));
+		}
+	}
+
+	STE_TARGET_SSE41 static void sse41(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		auto *out = reinterpret_cast<float*>(dst);
+
+		std::size_t i = 0;
+		for (; i + L::x4_read_pixels <= count; i += 4) {
+			const auto v = load_rgba8_x4<L>(src + i * L::bytes);
+			_mm_storeu_ps(out + i * 4 + 0,  decode_rgba8_x1_sse41<srgb>(luts, v));
+			_mm_storeu_ps(out + i * 4 + 4,  decode_rgba8_x1_sse41<srgb>(luts, _mm_srli_si128(v, 4)));
+			_mm_storeu_ps(out + i * 4 + 8,  decode_rgba8_x1_sse41<srgb>(luts, _mm_srli_si128(v, 8)));
+			_mm_storeu_ps(out + i * 4 + 12, decode_rgba8_x1_sse41<srgb>(luts, _mm_srli_si128(v, 12)));
+		}
+		scalar(src + i * L::bytes, dst + i * 16, count - i);
+	}
+
+	STE_TARGET_AVX2 static void avx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		auto *out = reinterpret_cast<float*>(dst);
+
+		std::size_t i = 0;
+		for (; i + L::x8_read_pixels <= count; i += 8) {
+			const auto v = load_rgba8_x8<L>(src + i * L::bytes);
+			const auto lo = _mm256_castsi256_si128(v);
+			const auto hi = _mm256_extracti128_si256(v, 1);
+			_mm256_storeu_ps(out + i * 4 + 0,  decode_rgba8_x2_avx2<srgb>(luts, lo));
+			_mm256_storeu_ps(out + i * 4 + 8,  decode_rgba8_x2_avx2<srgb>(luts, _mm_srli_si128(lo, 8)));
+			_mm256_storeu_ps(out + i * 4 + 16, decode_rgba8_x2_avx2<srgb>(luts, hi));
+			_mm256_storeu_ps(out + i * 4 + 24, decode_rgba8_x2_avx2<srgb>(luts, _mm_srli_si128(hi, 8)));
+		}
+		scalar(src + i * L::bytes, dst + i * 16, count - i);
+	}
+};
+
+// r32g32b32a32_sfloat to 8-bit components of layout L
+template <typename L, bool srgb>
+struct kernel_rgba32f_to_8bit {
+	static void scalar(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		for (std::size_t i = 0; i < count; ++i, src += 16, dst += L::bytes) {
+			// src need not be aligned
+			float in[4];
+			std::memcpy(in, src, sizeof(in));
+
+			dst[L::r] = srgb ? encode_srgb8(luts, in[0]) : encode_unorm8(in[0]);
+			dst[L::g] = srgb ? encode_srgb8(luts, in[1]) : encode_unorm8(in[1]);
+			dst[L::b] = srgb ? encode_srgb8(luts, in[2]) : encode_unorm8(in[2]);
+			if constexpr (L::bytes == 4)
+				dst[L::a] = encode_unorm8(in[3]);
+		}
+	}
+
+	STE_TARGET_SSE41 static void sse41(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		const auto *in = reinterpret_cast<const float*>(src);
+
+		std::size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const auto c0 = encode_rgba8_x1_sse41<srgb>(luts, _mm_loadu_ps(in + i * 4 + 0));
+			const auto c1 = encode_rgba8_x1_sse41<srgb>(luts, _mm_loadu_ps(in + i * 4 + 4));
+			const auto c2 = encode_rgba8_x1_sse41<srgb>(luts, _mm_loadu_ps(in + i * 4 + 8));
+			const auto c3 = encode_rgba8_x1_sse41<srgb>(luts, _mm_loadu_ps(in + i * 4 + 12));
+			const auto v = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+			store_rgba8_x4<L>(dst + i * L::bytes, v);
+		}
+		scalar(src + i * 16, dst + i * L::bytes, count - i);
+	}
+
+	STE_TARGET_AVX2 static void avx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		const auto &luts = srgb_luts::get();
+		const auto *in = reinterpret_cast<const float*>(src);
+
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const auto c01 = encode_rgba8_x2_avx2<srgb>(luts, _mm256_loadu_ps(in + i * 4 + 0));
+			const auto c23 = encode_rgba8_x2_avx2<srgb>(luts, _mm256_loadu_ps(in + i * 4 + 8));
+			const auto c45 = encode_rgba8_x2_avx2<srgb>(luts, _mm256_loadu_ps(in + i * 4 + 16));
+			const auto c67 = encode_rgba8_x2_avx2<srgb>(luts, _mm256_loadu_ps(in + i * 4 + 24));
+
+			// Packing is per 128-bit lane, leaving pixels 0,2,4,6 in the low lane and 1,3,5,7 in the high lane
+			auto v = _mm256_packus_epi16(_mm256_packs_epi32(c01, c23), _mm256_packs_epi32(c45, c67));
+			v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+			store_rgba8_x8<L>(dst + i * L::bytes, v);
+		}
+		scalar(src + i * 16, dst + i * L::bytes, count - i);
+	}
+};
+
+// 8-bit components of layout L to r8g8b8a8, with identical encoding
+template <typename L>
+struct kernel_8bit_to_rgba8 {
+	static void scalar(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i, src += L::bytes, dst += 4) {
+			dst[0] = src[L::r];
+			dst[1] = src[L::g];
+			dst[2] = src[L::b];
+			dst[3] = L::bytes == 4 ? src[L::a] : 0xFF;
+		}
+	}
+
+	STE_TARGET_SSE41 static void sse41(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + L::x4_read_pixels <= count; i += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), load_rgba8_x4<L>(src + i * L::bytes));
+		scalar(src + i * L::bytes, dst + i * 4, count - i);
+	}
+
+	STE_TARGET_AVX2 static void avx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + L::x8_read_pixels <= count; i += 8)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), load_rgba8_x8<L>(src + i * L::bytes));
+		scalar(src + i * L::bytes, dst + i * 4, count - i);
+	}
+};
+
+// r8_unorm to r16_unorm
+struct kernel_r8_to_r16 {
+	static void scalar(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto v = static_cast<std::uint16_t>(src[i] * 257);
+			std::memcpy(dst + i * 2, &v, sizeof(v));
+		}
+	}
+
+	STE_TARGET_SSE41 static void sse41(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const auto v = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_mullo_epi16(v, _mm_set1_epi16(257)));
+		}
+		scalar(src + i, dst + i * 2, count - i);
+	}
+
+	STE_TARGET_AVX2 static void avx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const auto v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), _mm256_mullo_epi16(v, _mm256_set1_epi16(257)));
+		}
+		scalar(src + i, dst + i * 2, count - i);
+	}
+};
+
+// r16_unorm to r8_unorm. round(x*255/65535) == (x*255 + 32895) >> 16 for all 16-bit x.
+struct kernel_r16_to_r8 {
+	static void scalar(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			std::uint16_t v;
+			std::memcpy(&v, src + i * 2, sizeof(v));
+			dst[i] = static_cast<std::uint8_t>((static_cast<std::uint32_t>(v) * 255 + 32895) >> 16);
+		}
+	}
+
+	STE_TARGET_SSE41 static __m128i narrow_x4(__m128i v) {
+		return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(255)), _mm_set1_epi32(32895)), 16);
+	}
+
+	STE_TARGET_SSE41 static void sse41(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+			const auto lo = narrow_x4(_mm_cvtepu16_epi32(v));
+			const auto hi = narrow_x4(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+			const auto w = _mm_packus_epi32(lo, hi);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(w, w));
+		}
+		scalar(src + i * 2, dst + i, count - i);
+	}
+
+	STE_TARGET_AVX2 static __m256i narrow_x8(__m256i v) {
+		return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(255)), _mm256_set1_epi32(32895)), 16);
+	}
+
+	STE_TARGET_AVX2 static void avx2(const std::uint8_t *src, std::uint8_t *dst, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const auto lo = narrow_x8(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2))));
+			const auto hi = narrow_x8(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16))));
+
+			// Packing is per 128-bit lane, restore the order
+			auto w = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+			w = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(w));
+		}
+		scalar(src + i * 2, dst + i, count - i);
+	}
+};
+
+struct kernel_entry {
+	gl::format source_format;
+	gl::format target_format;
+	surface_convert_kernels::kernel_t kernels[3];
+};
+
+template <typename Kernel>
+kernel_entry make_kernel_entry(gl::format source_format, gl::format target_format) {
+	return kernel_entry{ source_format, target_format, { &Kernel::scalar, &Kernel::sse41, &Kernel::avx2 } };
+}
+
+const kernel_entry kernel_entries[] = {
+	make_kernel_entry<kernel_8bit_to_rgba32f<rgba8_layout, false>>(gl::format::r8g8b8a8_unorm, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<rgba8_layout, true>>(gl::format::r8g8b8a8_srgb, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<bgra8_layout, false>>(gl::format::b8g8r8a8_unorm, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<bgra8_layout, true>>(gl::format::b8g8r8a8_srgb, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<rgb8_layout, false>>(gl::format::r8g8b8_unorm, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<rgb8_layout, true>>(gl::format::r8g8b8_srgb, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<bgr8_layout, false>>(gl::format::b8g8r8_unorm, gl::format::r32g32b32a32_sfloat),
+	make_kernel_entry<kernel_8bit_to_rgba32f<bgr8_layout, true>>(gl::format::b8g8r8_srgb, gl::format::r32g32b32a32_sfloat),
+
+	make_kernel_entry<kernel_rgba32f_to_8bit<rgba8_layout, false>>(gl::format::r32g32b32a32_sfloat, gl::format::r8g8b8a8_unorm),
+	make_kernel_entry<kernel_rgba32f_to_8bit<rgba8_layout, true>>(gl::format::r32g32b32a32_sfloat, gl::format::r8g8b8a8_srgb),
+	make_kernel_entry<kernel_rgba32f_to_8bit<bgra8_layout, false>>(gl::format::r32g32b32a32_sfloat, gl::format::b8g8r8a8_unorm),
+	make_kernel_entry<kernel_rgba32f_to_8bit<bgra8_layout, true>>(gl::format::r32g32b32a32_sfloat, gl::format::b8g8r8a8_srgb),
+	make_kernel_entry<kernel_rgba32f_to_8bit<rgb8_layout, false>>(gl::format::r32g32b32a32_sfloat, gl::format::r8g8b8_unorm),
+	make_kernel_entry<kernel_rgba32f_to_8bit<rgb8_layout, true>>(gl::format::r32g32b32a32_sfloat, gl::format::r8g8b8_srgb),
+	make_kernel_entry<kernel_rgba32f_to_8bit<bgr8_layout, false>>(gl::format::r32g32b32a32_sfloat, gl::format::b8g8r8_unorm),
+	make_kernel_entry<kernel_rgba32f_to_8bit<bgr8_layout, true>>(gl::format::r32g32b32a32_sfloat, gl::format::b8g8r8_srgb),
+
+	make_kernel_entry<kernel_8bit_to_rgba8<bgra8_layout>>(gl::format::b8g8r8a8_unorm, gl::format::r8g8b8a8_unorm),
+	make_kernel_entry<kernel_8bit_to_rgba8<bgra8_layout>>(gl::format::b8g8r8a8_srgb, gl::format::r8g8b8a8_srgb),
+	make_kernel_entry<kernel_8bit_to_rgba8<rgb8_layout>>(gl::format::r8g8b8_unorm, gl::format::r8g8b8a8_unorm),
+	make_kernel_entry<kernel_8bit_to_rgba8<rgb8_layout>>(gl::format::r8g8b8_srgb, gl::format::r8g8b8a8_srgb),
+	make_kernel_entry<kernel_8bit_to_rgba8<bgr8_layout>>(gl::format::b8g8r8_unorm, gl::format::r8g8b8a8_unorm),
+	make_kernel_entry<kernel_8bit_to_rgba8<bgr8_layout>>(gl::format::b8g8r8_srgb, gl::format::r8g8b8a8_srgb),
+
+	make_kernel_entry<kernel_r8_to_r16>(gl::format::r8_unorm, gl::format::r16_unorm),
+	make_kernel_entry<kernel_r16_to_r8>(gl::format::r16_unorm, gl::format::r8_unorm),
+};
+
+}
+
+surface_convert_kernels::isa surface_convert_kernels::supported_isa() {
+	static const isa supported = detect_isa();
+	return supported;
+}
+
+surface_convert_kernels::kernel_t surface_convert_kernels::find(gl::format source_format,
+																gl::format target_format,
+																isa instruction_set) {
+	for (auto &e : kernel_entries) {
+		if (e.source_format == source_format && e.target_format == target_format)
+			return e.kernels[static_cast<int>(instruction_set)];
+	}
+
+	return nullptr;
+}
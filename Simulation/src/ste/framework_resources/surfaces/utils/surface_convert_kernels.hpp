@@ -0,0 +1,59 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <format.hpp>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	Dedicated conversion kernels for common pairs of uncompressed formats. The kernels convert whole runs of blocks
+ *			with vectorized loads, shuffles and stores, instead of converting component by component via the block
+ *			loaders.
+ *
+ *	The kernel is selected at runtime, based on the instruction sets supported by the CPU (AVX2, SSE4.1, or a scalar
+ *	fallback). sRGB encoding and decoding are done with lookup tables.
+ */
+class surface_convert_kernels {
+public:
+	/**
+	 *	@brief	Conversion kernel. Converts blocks_count tightly packed blocks from src into dst. Unaligned buffers are
+	 *			allowed.
+	 */
+	using kernel_t = void(*)(const std::uint8_t *src, std::uint8_t *dst, std::size_t blocks_count);
+
+	/**
+	 *	@brief	Instruction sets a kernel can be selected for
+	 */
+	enum class isa {
+		scalar,
+		sse41,
+		avx2,
+	};
+
+public:
+	/**
+	 *	@brief	Returns the best instruction set supported by the CPU
+	 */
+	static isa supported_isa();
+
+	/**
+	 *	@brief	Returns a kernel that converts blocks from source_format to target_format, using the best instruction set
+	 *			supported by the CPU, or nullptr if no dedicated kernel exists for the format pair.
+	 */
+	static kernel_t find(gl::format source_format, gl::format target_format) {
+		return find(source_format, target_format, supported_isa());
+	}
+
+	/**
+	 *	@brief	Returns a kernel that converts blocks from source_format to target_format, using the specified instruction
+	 *			set, which must be supported by the CPU, or nullptr if no dedicated kernel exists for the format pair.
+	 */
+	static kernel_t find(gl::format source_format, gl::format target_format, isa instruction_set);
+};
+
+}
+}
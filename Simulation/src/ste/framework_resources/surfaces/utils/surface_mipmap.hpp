@@ -0,0 +1,120 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <surface.hpp>
+#include <surface_convert.hpp>
+#include <surface_utilities.hpp>
+
+#include <lib/vector.hpp>
+#include <algorithm>
+
+namespace ste {
+namespace resource {
+
+/**
+ *	@brief	CPU generation of mipmap chains.
+ *
+ *	Levels are filtered in linear space, sRGB surfaces are decoded before filtering and encoded afterwards, unlike
+ *	blits which filter the encoded values. Each level is downsampled from the previous level with a separable 4-tap
+ *	[1 3 3 1]/8 filter, which suppresses the aliasing a 2x2 box filter leaves in the lower levels.
+ */
+class surface_mipmap {
+	static constexpr auto linear_format = gl::format::r32g32b32a32_sfloat;
+
+	struct _impl {
+		// Downsamples a level of linear texels by two, clamping to the edges.
+		static void downsample(const glm::vec4 *src, const glm::u32vec2 &src_extent,
+							   glm::vec4 *dst, const glm::u32vec2 &dst_extent) {
+			static constexpr float weights[4] = { 1.f / 8.f, 3.f / 8.f, 3.f / 8.f, 1.f / 8.f };
+
+			const auto filter = [](const glm::vec4 *row, std::uint32_t size, std::size_t stride, std::uint32_t x) {
+				if (size == 1)
+					return row[0];
+
+				glm::vec4 t = glm::vec4(.0f);
+				for (int k = 0; k < 4; ++k) {
+					const auto i = glm::clamp(static_cast<int>(2 * x) - 1 + k, 0, static_cast<int>(size) - 1);
+					t += weights[k] * row[static_cast<std::size_t>(i) * stride];
+				}
+				return t;
+			};
+
+			// Horizontal pass
+			lib::vector<glm::vec4> temp(static_cast<std::size_t>(dst_extent.x) * src_extent.y);
+			for (std::uint32_t y = 0; y < src_extent.y; ++y) {
+				const auto *row = src + static_cast<std::size_t>(y) * src_extent.x;
+				for (std::uint32_t x = 0; x < dst_extent.x; ++x)
+					temp[static_cast<std::size_t>(y) * dst_extent.x + x] = filter(row, src_extent.x, 1, x);
+			}
+
+			// Vertical pass
+			for (std::uint32_t y = 0; y < dst_extent.y; ++y) {
+				for (std::uint32_t x = 0; x < dst_extent.x; ++x)
+					dst[static_cast<std::size_t>(y) * dst_extent.x + x] = filter(temp.data() + x, src_extent.y, dst_extent.x, y);
+			}
+		}
+
+		// Renormalizes normal vectors encoded in the RGB components as unsigned normalized values
+		static void renormalize(glm::vec4 *texels, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i) {
+				auto n = glm::vec3(texels[i]) * 2.f - 1.f;
+				const auto len = glm::length(n);
+				if (len > .0f)
+					n /= len;
+
+				texels[i] = glm::vec4(n * .5f + .5f, texels[i].w);
+			}
+		}
+	};
+
+public:
+	/**
+	 *	@brief	Generates a complete mipmap chain for the top level of a 2D surface.
+	 *
+	 *	@param	surface		Input surface. Only the top level is used.
+	 *	@param	normal_map	If set to true, the surface is treated as a tangent-space normal map, encoded as unsigned
+	 *						normalized values, and the filtered normals are renormalized.
+	 *
+	 *	@return	A surface of the same format holding the complete mipmap chain
+	 *
+	 *	@trows	surface_convert_format_mismatch_error	If the surface format can not be converted to a linear format
+	 */
+	template <gl::format format>
+	static auto generate_2d(surface_2d<format> &&surface, bool normal_map = false) {
+		const auto extent = surface.extent();
+		const auto levels = surface_utilities::max_levels(extent);
+
+		// Decode the top level into a linear floating-point chain
+		surface_2d<linear_format> chain(extent, levels);
+		surface_convert::convert_blocks<linear_format>(format,
+													   reinterpret_cast<const std::uint8_t*>(surface.data()),
+													   chain.data(),
+													   surface.blocks(0_mip));
+		if (normal_map)
+			_impl::renormalize(reinterpret_cast<glm::vec4*>(chain.data()), chain.blocks(0_mip));
+
+		// Filter levels
+		for (auto level = 1_mip; level < levels; ++level) {
+			auto *dst = reinterpret_cast<glm::vec4*>(chain.data_at(0_layer, level));
+			_impl::downsample(reinterpret_cast<const glm::vec4*>(chain.data_at(0_layer, level - 1_mip)),
+							  chain.extent(level - 1_mip),
+							  dst,
+							  chain.extent(level));
+			if (normal_map)
+				_impl::renormalize(dst, chain.blocks(level));
+		}
+
+		// Encode
+		if constexpr (format == linear_format)
+			return chain;
+		else
+			return surface_convert::convert_2d<format>(std::move(chain));
+	}
+};
+
+}
+}
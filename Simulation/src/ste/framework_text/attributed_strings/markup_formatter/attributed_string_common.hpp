@@ -139,6 +139,11 @@ public:
 
 	std::size_t length() const { return string.length(); }
 
+	/**
+	 *	@brief	Returns the attributes, sorted by the start of their ranges. Ranges of attributes of the same type never overlap.
+	 */
+	const attrib_storage &attribs() const { return text_attribs; }
+
 	const string_type &plain_string() const { return string; }
 	explicit operator string_type() const { return plain_string(); }
 
@@ -0,0 +1,296 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <lib/vector.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ste {
+namespace text {
+
+/**
+ *	@brief	Scratch memory for glyph_distance_transform. Grows as needed and is never shrunk, intended to be kept per thread
+ *			and reused for all glyphs generated by that thread.
+ */
+class glyph_distance_transform_scratch {
+	friend class glyph_distance_transform;
+
+private:
+	// Squared distances, nearest seed rows of the column pass and the inside distances
+	lib::vector<float> grid;
+	lib::vector<std::uint32_t> column_seeds;
+	lib::vector<float> inside;
+	// Coverage gradients, zero but at edge pixels, and the edge distances they yield
+	lib::vector<float> gx;
+	lib::vector<float> gy;
+	lib::vector<float> edge;
+
+	// 1D transform storage, sized to the larger image dimension
+	lib::vector<float> f;
+	lib::vector<float> d;
+	lib::vector<float> z;
+	lib::vector<std::uint32_t> v;
+	lib::vector<std::uint32_t> arg;
+
+	void reserve(std::uint32_t width, std::uint32_t height) {
+		const auto size = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+		const auto line = static_cast<std::size_t>(std::max(width, height));
+
+		if (grid.size() < size) {
+			grid.resize(size);
+			column_seeds.resize(size);
+			inside.resize(size);
+			gx.resize(size);
+			gy.resize(size);
+			edge.resize(size);
+		}
+		if (f.size() < line) {
+			f.resize(line);
+			d.resize(line);
+			z.resize(line + 1);
+			v.resize(line);
+			arg.resize(line);
+		}
+	}
+};
+
+/**
+ *	@brief	Anti-aliased signed Euclidean distance transform of glyph bitmaps.
+ *
+ *	Finds the nearest object pixel with Felzenszwalb and Huttenlocher's separable, linear-time, distance transform, keeping
+ *	track of the nearest seed. The distance to the edge is then estimated from the coverage and coverage gradient of the
+ *	seed and the edge pixels around it, as in Gustavson and Strand's anti-aliased EDT (edtaa3). Runs in single precision,
+ *	once for the background and once for the foreground, and allocates nothing once the scratch memory has grown to the
+ *	glyph's size.
+ */
+class glyph_distance_transform {
+private:
+	static constexpr float inf = 1e20f;
+	// Radius of the neighbourhood of the nearest seed searched for the nearest edge
+	static constexpr int seed_search_radius = 2;
+	// Bound on the magnitude of edge_distance(), sqrt(2)/2 rounded up
+	static constexpr float max_edge_distance = .7072f;
+	// Margin for rounding when culling seeds by a bound on their edge distance
+	static constexpr float cull_epsilon = 1e-4f;
+
+	/**
+	 *	@brief	1D squared distance transform of sampled function f, into d. Writes the index of the minimizing sample into arg.
+	 */
+	static void transform_1d(const float *f, float *d, std::uint32_t *arg, std::uint32_t *v, float *z, std::uint32_t n) {
+		std::uint32_t k = 0;
+		v[0] = 0;
+		z[0] = -std::numeric_limits<float>::infinity();
+		z[1] = +std::numeric_limits<float>::infinity();
+
+		// Lower envelope of the parabolas rooted at each sample
+		const auto intersection = [&](std::uint32_t q, std::uint32_t r) {
+			const auto fq = f[q] + static_cast<float>(q) * static_cast<float>(q);
+			const auto fr = f[r] + static_cast<float>(r) * static_cast<float>(r);
+			return (fq - fr) / (2.f * static_cast<float>(q) - 2.f * static_cast<float>(r));
+		};
+		for (std::uint32_t q = 1; q < n; ++q) {
+			auto s = intersection(q, v[k]);
+			// z[0] is -inf, terminates the loop
+			while (s <= z[k])
+				s = intersection(q, v[--k]);
+
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = +std::numeric_limits<float>::infinity();
+		}
+
+		// Sample the envelope
+		k = 0;
+		for (std::uint32_t q = 0; q < n; ++q) {
+			while (z[k + 1] < static_cast<float>(q))
+				++k;
+
+			const auto dq = static_cast<float>(q) - static_cast<float>(v[k]);
+			d[q] = dq * dq + f[v[k]];
+			arg[q] = v[k];
+		}
+	}
+
+	/**
+	 *	@brief	Approximates the distance from the center of an edge pixel, with coverage a, to the edge, given the edge's
+	 *			normal (gx,gy). Positive if the center lies outside the object.
+	 */
+	static float edge_distance(float gx, float gy, float a) {
+		if (gx == 0 || gy == 0)
+			return .5f - a;
+		return edge_distance(gx, gy, std::sqrt(gx * gx + gy * gy), a);
+	}
+	/**
+	 *	@brief	As above, given the normal's length l. Normal components must be non-zero.
+	 */
+	static float edge_distance(float gx, float gy, float l, float a) {
+		// Symmetric with respect to sign and transposition, move to the first octant
+		gx = std::abs(gx) / l;
+		gy = std::abs(gy) / l;
+		if (gx < gy)
+			std::swap(gx, gy);
+
+		const auto a1 = .5f * gy / gx;
+		if (a < a1)
+			return .5f * (gx + gy) - std::sqrt(2.f * gx * gy * a);
+		if (a < 1.f - a1)
+			return (.5f - a) * gx;
+		return -.5f * (gx + gy) + std::sqrt(2.f * gx * gy * (1.f - a));
+	}
+
+	/**
+	 *	@brief	Distance from each pixel to the edge of the object described by the coverage functor. Pixels with positive
+	 *			coverage are object pixels. Distances inside the object are non-positive.
+	 */
+	template <typename Coverage>
+	static void object_distance(std::uint32_t width,
+								std::uint32_t height,
+								const Coverage &coverage,
+								float *out,
+								glyph_distance_transform_scratch &scratch) {
+		auto *grid = scratch.grid.data();
+		auto *column_seeds = scratch.column_seeds.data();
+		auto *f = scratch.f.data();
+		auto *d = scratch.d.data();
+		auto *z = scratch.z.data();
+		auto *v = scratch.v.data();
+		auto *arg = scratch.arg.data();
+		auto *gx = scratch.gx.data();
+		auto *gy = scratch.gy.data();
+		auto *edge = scratch.edge.data();
+
+		// Edge pixels' coverage gradients. Edge distances of object pixels lacking a gradient are bounded by
+		// -max_edge_distance, background pixels are never seeds.
+		for (std::uint32_t y = 0; y < height; ++y) {
+			for (std::uint32_t x = 0; x < width; ++x) {
+				const auto i = static_cast<std::size_t>(y) * width + x;
+				gx[i] = gy[i] = 0;
+
+				const auto a = coverage(i);
+				edge[i] = a > 0 ? -max_edge_distance : inf;
+				if (a <= 0 || a >= 1.f || x == 0 || y == 0 || x + 1 == width || y + 1 == height)
+					continue;
+
+				constexpr float sqrt2 = 1.4142136f;
+				const auto c = [&](std::uint32_t i, std::uint32_t j) { return coverage(j * width + i); };
+				gx[i] = -c(x - 1, y - 1) - sqrt2 * c(x - 1, y) - c(x - 1, y + 1) + c(x + 1, y - 1) + sqrt2 * c(x + 1, y) + c(x + 1, y + 1);
+				gy[i] = -c(x - 1, y - 1) - sqrt2 * c(x, y - 1) - c(x + 1, y - 1) + c(x - 1, y + 1) + sqrt2 * c(x, y + 1) + c(x + 1, y + 1);
+				// Seeds are visited by many pixels, the edge distance along the gradient depends only on the seed
+				if (gx[i] != 0 || gy[i] != 0)
+					edge[i] = edge_distance(gx[i], gy[i], a);
+			}
+		}
+
+		// Columns
+		for (std::uint32_t x = 0; x < width; ++x) {
+			for (std::uint32_t y = 0; y < height; ++y)
+				f[y] = coverage(y * width + x) > 0 ? .0f : inf;
+			transform_1d(f, d, arg, v, z, height);
+			for (std::uint32_t y = 0; y < height; ++y) {
+				grid[y * width + x] = d[y];
+				column_seeds[y * width + x] = arg[y];
+			}
+		}
+
+		// Rows, and the distance to the edge
+		const auto max_distance = static_cast<float>(width + height);
+		for (std::uint32_t y = 0; y < height; ++y) {
+			const auto row = static_cast<std::size_t>(y) * width;
+			transform_1d(grid + row, d, arg, v, z, width);
+
+			for (std::uint32_t x = 0; x < width; ++x) {
+				if (d[x] >= inf) {
+					// No object pixels
+					out[row + x] = max_distance;
+					continue;
+				}
+
+				// The nearest seed need not be the seed whose edge is nearest, a barely covered seed's edge lies farther than
+				// its center. As edtaa3, which propagates the seed with the least edge distance, take the least edge
+				// distance of the object pixels around the nearest seed.
+				const auto px = static_cast<int>(arg[x]);
+				const auto py = static_cast<int>(column_seeds[row + arg[x]]);
+				const auto x0 = std::max(0, px - seed_search_radius);
+				const auto y0 = std::max(0, py - seed_search_radius);
+				const auto x1 = std::min(static_cast<int>(width) - 1, px + seed_search_radius);
+				const auto y1 = std::min(static_cast<int>(height) - 1, py + seed_search_radius);
+
+				const auto seed_edge_distance = [&](int sx, int sy) {
+					const auto seed = static_cast<std::size_t>(sy) * width + sx;
+					const auto dx = static_cast<float>(x) - static_cast<float>(sx);
+					const auto dy = static_cast<float>(y) - static_cast<float>(sy);
+					const auto l = std::sqrt(dx * dx + dy * dy);
+
+					// Edge direction is estimated by the seed's coverage gradient. Lacking one, by the direction to the
+					// seed, accurate for distant pixels.
+					if (gx[seed] != 0 || gy[seed] != 0)
+						return l + edge[seed];
+
+					const auto a = std::min(1.f, coverage(seed));
+					return l + (dx == 0 || dy == 0 ? .5f - a : edge_distance(dx, dy, l, a));
+				};
+
+				// Start with the nearest seed, it is usually the nearest edge. Skip seeds that are too far to improve on the
+				// distance, given a lower bound on their edge distance: Rows and columns beyond reach of any seed, then
+				// each seed by its own bound.
+				float distance = seed_edge_distance(px, py);
+				const auto reach = static_cast<int>(distance + max_edge_distance + cull_epsilon);
+				const auto sy0 = std::max(y0, static_cast<int>(y) - reach);
+				const auto sy1 = std::min(y1, static_cast<int>(y) + reach);
+				const auto sx0 = std::max(x0, static_cast<int>(x) - reach);
+				const auto sx1 = std::min(x1, static_cast<int>(x) + reach);
+				for (int sy = sy0; sy <= sy1; ++sy) {
+					for (int sx = sx0; sx <= sx1; ++sx) {
+						const auto seed = static_cast<std::size_t>(sy) * width + sx;
+						const auto dx = static_cast<float>(x) - static_cast<float>(sx);
+						const auto dy = static_cast<float>(y) - static_cast<float>(sy);
+						const auto bound = distance - edge[seed] + cull_epsilon;
+						if (bound <= 0 || dx * dx + dy * dy >= bound * bound || (sx == px && sy == py))
+							continue;
+
+						distance = std::min(distance, seed_edge_distance(sx, sy));
+					}
+				}
+				out[row + x] = distance;
+			}
+		}
+	}
+
+public:
+	/**
+	 *	@brief	Computes the signed distance field of a glyph bitmap. Distances are in pixels, positive outside the glyph
+	 *			and negative inside.
+	 *
+	 *	@param	img		8-bit coverage bitmap
+	 *	@param	out		Output distance field, width*height floats
+	 */
+	static void transform(const std::uint8_t *img,
+						  std::uint32_t width,
+						  std::uint32_t height,
+						  float *out,
+						  glyph_distance_transform_scratch &scratch) {
+		if (!width || !height)
+			return;
+
+		scratch.reserve(width, height);
+		auto *inside = scratch.inside.data();
+
+		// Background, distances to the glyph
+		object_distance(width, height, [img](std::size_t i) { return static_cast<float>(img[i]) / 255.f; }, out, scratch);
+		// Foreground, distances to the background
+		object_distance(width, height, [img](std::size_t i) { return 1.f - static_cast<float>(img[i]) / 255.f; }, inside, scratch);
+
+		const auto size = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+		for (std::size_t i = 0; i < size; ++i)
+			out[i] = std::max(.0f, out[i]) - std::max(.0f, inside[i]);
+	}
+};
+
+}
+}
@@ -0,0 +1,204 @@
+
+#include <stdafx.hpp>
+#include <glyph_atlas.hpp>
+
+#include <surface_factory.hpp>
+#include <device_buffer.hpp>
+#include <ste_device_upload_arena.hpp>
+#include <ste_engine_exceptions.hpp>
+
+#include <pipeline_barrier.hpp>
+#include <image_memory_barrier.hpp>
+#include <cmd_pipeline_barrier.hpp>
+#include <cmd_copy_buffer_to_image.hpp>
+
+#include <lib/shared_ptr.hpp>
+#include <cstring>
+#include <numeric>
+
+using namespace ste;
+using namespace text;
+
+void glyph_atlas::create_page() {
+	const lib::string name = lib::string("glyph_atlas page ") + lib::to_string(pages.size());
+	auto image = resource::surface_factory::image_empty_2d<page_format>(ctx.get(),
+																		gl::image_usage::sampled | gl::image_usage::transfer_dst,
+																		gl::image_layout::shader_read_only_optimal,
+																		name,
+																		{ page_extent, page_extent });
+
+	pages.push_back(lib::allocate_unique<page_t>(page_t{ glyph_atlas_packer({ page_extent, page_extent }),
+														 page_texture_t(std::move(image)) }));
+}
+
+glyph_atlas::allocation glyph_atlas::insert(distance_field_surface_t &&surface) {
+	const glm::u32vec2 extent = surface.extent();
+	if (extent.x > page_extent || extent.y > page_extent)
+		throw ste_engine_exception("Glyph larger than an atlas page");
+
+	allocation location;
+	location.extent = extent;
+
+	// Try the most recent pages first, older pages are likely full
+	bool placed = false;
+	for (auto i = pages.size(); i-- > 0 && !placed;) {
+		auto offset = pages[i]->packer.insert(extent);
+		if (offset) {
+			location.page = static_cast<std::uint32_t>(i);
+			location.offset = offset.get();
+			placed = true;
+		}
+	}
+	if (!placed) {
+		// Grow
+		create_page();
+
+		location.page = static_cast<std::uint32_t>(pages.size() - 1);
+		location.offset = pages.back()->packer.insert(extent).get();
+	}
+
+	pending_uploads.push_back({ location, std::move(surface) });
+	++glyphs_count;
+
+	return location;
+}
+
+bool glyph_atlas::record_uploads(gl::command_recorder &recorder) {
+	if (pending_uploads.empty())
+		return false;
+
+	using block_type = typename gl::format_traits<page_format>::block_type;
+	using staging_buffer_t = gl::device_buffer<block_type, gl::device_resource_allocation_policy_host_visible>;
+	static constexpr auto block_bytes = sizeof(block_type);
+
+	// Copy regions, per page and staging source
+	lib::vector<lib::vector<gl::buffer_image_copy_region_t>> arena_regions(pages.size());
+	lib::vector<lib::vector<gl::buffer_image_copy_region_t>> staging_regions(pages.size());
+	const auto add_region = [](auto &regions, const pending_upload_t &u, std::size_t buffer_offset) {
+		gl::buffer_image_copy_region_t r;
+		r.buffer_offset = buffer_offset;
+		r.image_offset = { static_cast<std::int32_t>(u.location.offset.x), static_cast<std::int32_t>(u.location.offset.y), 0 };
+		r.image_format = page_format;
+		r.extent = { u.location.extent.x, u.location.extent.y, 1 };
+
+		regions[u.location.page].push_back(r);
+	};
+
+	// Stage in the upload arena. Copy offsets must be multiples of the block size and 4 bytes.
+	// Arena buffer is addressed in bytes.
+	auto &arena = ctx.get().device().upload_arena();
+	lib::vector<ste_device_upload_arena::allocation_ptr> arena_allocations;
+	std::size_t staged = 0;
+	for (; staged < pending_uploads.size(); ++staged) {
+		auto &u = pending_uploads[staged];
+		const auto bytes = static_cast<std::size_t>(u.surface.bytes());
+
+		auto staging = arena.allocate(byte_t(bytes), std::lcm(static_cast<std::uint64_t>(block_bytes), std::uint64_t(4)));
+		if (!staging)
+			break;
+
+		std::memcpy(staging->data(), u.surface.data(), bytes);
+		add_region(arena_regions, u, static_cast<std::size_t>(staging->get_offset()));
+		arena_allocations.push_back(std::move(staging));
+	}
+
+	// Upload arena exhausted, stage the rest in a dedicated staging buffer. Staging buffer is addressed in blocks.
+	lib::shared_ptr<staging_buffer_t> staging_buffer;
+	if (staged < pending_uploads.size()) {
+		std::size_t blocks = 0;
+		for (auto i = staged; i < pending_uploads.size(); ++i)
+			blocks += static_cast<std::size_t>(pending_uploads[i].surface.bytes()) / block_bytes;
+
+		staging_buffer = lib::allocate_shared<staging_buffer_t>(ctx.get(),
+																blocks,
+																gl::buffer_usage::transfer_src,
+																"glyph_atlas staging buffer");
+		{
+			auto mmap_blocks_ptr = staging_buffer->get_underlying_memory().template mmap<block_type>(0, blocks);
+
+			std::size_t offset = 0;
+			for (auto i = staged; i < pending_uploads.size(); ++i) {
+				auto &u = pending_uploads[i];
+				const auto count = static_cast<std::size_t>(u.surface.bytes()) / block_bytes;
+
+				std::memcpy(mmap_blocks_ptr->get_mapped_ptr() + offset, u.surface.data(), count * block_bytes);
+				add_region(staging_regions, u, offset);
+				offset += count;
+			}
+
+			// Flush written memory
+			mmap_blocks_ptr->flush_ranges({ vk::vk_mapped_memory_range{ 0, blocks } });
+		}
+	}
+	pending_uploads.clear();
+
+	// Move the touched pages to transfer layout. Previous frames might still be sampling them.
+	lib::vector<gl::image_memory_barrier> to_transfer;
+	lib::vector<gl::image_memory_barrier> to_shader_read;
+	for (std::size_t p = 0; p < pages.size(); ++p) {
+		if (arena_regions[p].empty() && staging_regions[p].empty())
+			continue;
+
+		const auto &image = pages[p]->texture.get_image();
+		to_transfer.emplace_back(image,
+								 gl::image_layout::shader_read_only_optimal,
+								 gl::image_layout::transfer_dst_optimal,
+								 gl::access_flags::none,
+								 gl::access_flags::transfer_write);
+		to_shader_read.emplace_back(image,
+									gl::image_layout::transfer_dst_optimal,
+									gl::image_layout::shader_read_only_optimal,
+									gl::access_flags::transfer_write,
+									gl::access_flags::shader_read);
+	}
+	recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::fragment_shader,
+															  gl::pipeline_stage::transfer,
+															  {}, {}, to_transfer));
+
+	// Copy, a single command per page and staging source.
+	// The command buffer holds onto the staging memory till the device is done with it.
+	for (std::size_t p = 0; p < pages.size(); ++p) {
+		const auto &image = pages[p]->texture.get_image();
+
+		if (!arena_regions[p].empty()) {
+			auto cmd = gl::cmd_copy_buffer_to_image(arena.get_buffer(),
+													image,
+													gl::image_layout::transfer_dst_optimal,
+													arena_regions[p]);
+			for (auto &a : arena_allocations)
+				cmd.retain_resource(std::move(a));
+			arena_allocations.clear();
+
+			recorder << std::move(cmd);
+		}
+		if (!staging_regions[p].empty()) {
+			auto cmd = gl::cmd_copy_buffer_to_image(*staging_buffer,
+													image,
+													gl::image_layout::transfer_dst_optimal,
+													staging_regions[p]);
+			cmd.retain_resource(staging_buffer);
+
+			recorder << std::move(cmd);
+		}
+	}
+
+	recorder << gl::cmd_pipeline_barrier(gl::pipeline_barrier(gl::pipeline_stage::transfer,
+															  gl::pipeline_stage::fragment_shader,
+															  {}, {}, to_shader_read));
+
+	return true;
+}
+
+glyph_atlas::statistics glyph_atlas::get_statistics() const {
+	statistics s;
+	s.pages = pages_count();
+	s.glyphs = glyphs_count;
+	s.bytes = static_cast<std::uint64_t>(page_extent) * static_cast<std::uint64_t>(page_extent) * sizeof(typename gl::format_traits<page_format>::block_type) * pages.size();
+
+	float occupancy = 0;
+	for (auto &p : pages)
+		occupancy += p->packer.occupancy();
+	s.occupancy = pages.size() ? occupancy / static_cast<float>(pages.size()) : .0f;
+
+	return s;
+}
@@ -0,0 +1,115 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <ste_context.hpp>
+#include <glyph_atlas_packer.hpp>
+
+#include <command_recorder.hpp>
+#include <texture.hpp>
+#include <surface.hpp>
+#include <format.hpp>
+
+#include <lib/vector.hpp>
+#include <lib/unique_ptr.hpp>
+#include <alias.hpp>
+
+namespace ste {
+namespace text {
+
+/**
+ *	@brief	Dynamic glyph atlas. Packs glyph distance fields into a small amount of large pages.
+ *
+ *	Glyphs are packed with a glyph_atlas_packer, a new page is created once a glyph fits in none of the existing pages.
+ *	Distance fields are stored as half-floats. Uploads are queued on insertion and recorded with record_uploads().
+ *	Not thread-safe.
+ */
+class glyph_atlas {
+public:
+	static constexpr gl::format page_format = gl::format::r16_sfloat;
+	static constexpr std::uint32_t page_extent = 2048;
+
+	using page_texture_t = gl::texture<gl::image_type::image_2d>;
+	using distance_field_surface_t = resource::surface_2d<page_format>;
+
+	/**
+	 *	@brief	A glyph's location in the atlas
+	 */
+	struct allocation {
+		std::uint32_t page;
+		glm::u32vec2 offset;
+		glm::u32vec2 extent;
+
+		/**
+		 *	@brief	Normalized texture coordinates of the glyph's top-left and bottom-right texel centers
+		 */
+		glm::vec4 uv_rect() const {
+			const glm::vec2 a = (glm::vec2(offset) + glm::vec2(.5f)) / static_cast<float>(page_extent);
+			const glm::vec2 b = (glm::vec2(offset + extent) - glm::vec2(.5f)) / static_cast<float>(page_extent);
+			return { a.x, a.y, b.x, b.y };
+		}
+	};
+
+	struct statistics {
+		std::uint32_t pages;
+		std::uint32_t glyphs;
+		// Device memory used by the pages' texels
+		std::uint64_t bytes;
+		// Ratio of the pages' area covered by glyphs
+		float occupancy;
+	};
+
+private:
+	struct page_t {
+		glyph_atlas_packer packer;
+		page_texture_t texture;
+	};
+
+	struct pending_upload_t {
+		allocation location;
+		distance_field_surface_t surface;
+	};
+
+private:
+	alias<const ste_context> ctx;
+
+	lib::vector<lib::unique_ptr<page_t>> pages;
+	lib::vector<pending_upload_t> pending_uploads;
+	std::uint32_t glyphs_count{ 0 };
+
+private:
+	void create_page();
+
+public:
+	glyph_atlas(const ste_context &ctx) : ctx(ctx) {}
+	~glyph_atlas() noexcept {}
+
+	glyph_atlas(glyph_atlas&&) = default;
+	glyph_atlas &operator=(glyph_atlas&&) = default;
+
+	/**
+	 *	@brief	Allocates room for a glyph and queues its distance field for upload. Creates a new page if needed.
+	 *
+	 *	@throws	ste_engine_exception	If the glyph is larger than a page
+	 */
+	allocation insert(distance_field_surface_t &&surface);
+
+	/**
+	 *	@brief	Records the queued uploads. Uploads are staged in the device's upload arena, falling back to a dedicated
+	 *			staging buffer if the arena is exhausted. Pages are left in shader_read_only_optimal layout, ready to be
+	 *			sampled by fragment shaders.
+	 *
+	 *	@return	True if any uploads were recorded
+	 */
+	bool record_uploads(gl::command_recorder &recorder);
+
+	auto pages_count() const { return static_cast<std::uint32_t>(pages.size()); }
+	auto &page(std::uint32_t index) const { return pages[index]->texture; }
+
+	statistics get_statistics() const;
+};
+
+}
+}
@@ -0,0 +1,96 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <optional.hpp>
+#include <lib/vector.hpp>
+
+namespace ste {
+namespace text {
+
+/**
+ *	@brief	Shelf rectangle packer for a single atlas page.
+ *
+ *	Rectangles are placed left-to-right on horizontal shelves, new shelves are opened bottom of the last shelf.
+ *	A rectangle goes on the shelf that wastes the least height, glyphs of a font at a given size have similar heights,
+ *	so shelves fill up with little waste. Space is never reclaimed.
+ */
+class glyph_atlas_packer {
+private:
+	// Shelves heights are rounded up to a multiple of the granularity, allowing similar glyphs to share shelves.
+	static constexpr std::uint32_t shelf_height_granularity = 4;
+
+	struct shelf {
+		std::uint32_t y;
+		std::uint32_t height;
+		// Used width
+		std::uint32_t x;
+	};
+
+private:
+	glm::u32vec2 extent;
+	lib::vector<shelf> shelves;
+	// Start of the next shelf
+	std::uint32_t top{ 0 };
+
+	std::uint64_t used_area{ 0 };
+
+public:
+	glyph_atlas_packer(const glm::u32vec2 &extent) : extent(extent) {}
+
+	/**
+	 *	@brief	Allocates a rectangle.
+	 *
+	 *	@return	Offset of the allocated rectangle, or none if the page has no room for it.
+	 */
+	optional<glm::u32vec2> insert(const glm::u32vec2 &size) {
+		if (size.x > extent.x || size.y > extent.y)
+			return none;
+
+		// Find the fitting shelf that wastes the least height
+		shelf *best = nullptr;
+		for (auto &s : shelves) {
+			if (s.height < size.y || s.x + size.x > extent.x)
+				continue;
+			if (!best || s.height < best->height)
+				best = &s;
+		}
+
+		// Avoid placing short rectangles on tall shelves while there is still room for a new shelf
+		const auto shelf_height = std::min(extent.y,
+										   (size.y + shelf_height_granularity - 1) / shelf_height_granularity * shelf_height_granularity);
+		const bool room_for_shelf = top + shelf_height <= extent.y;
+		if (best && room_for_shelf && best->height > shelf_height * 2)
+			best = nullptr;
+
+		if (!best) {
+			if (!room_for_shelf)
+				return none;
+
+			shelves.push_back({ top, shelf_height, 0 });
+			top += shelf_height;
+			best = &shelves.back();
+		}
+
+		const glm::u32vec2 offset = { best->x, best->y };
+		best->x += size.x;
+		used_area += static_cast<std::uint64_t>(size.x) * static_cast<std::uint64_t>(size.y);
+
+		return offset;
+	}
+
+	/**
+	 *	@brief	Returns the ratio of the page's area covered by allocated rectangles
+	 */
+	float occupancy() const {
+		return static_cast<float>(used_area) / (static_cast<float>(extent.x) * static_cast<float>(extent.y));
+	}
+
+	auto& get_extent() const { return extent; }
+};
+
+}
+}
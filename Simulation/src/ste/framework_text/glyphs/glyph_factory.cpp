@@ -1,11 +1,12 @@
 
 #include <stdafx.hpp>
 #include <glyph_factory.hpp>
-#include <make_distance_map.hpp>
+#include <glyph_distance_transform.hpp>
 #include <text_font_key.hpp>
 #include <text_glyph_pair_key.hpp>
 
 #include <lib/flat_map.hpp>
+#include <lib/vector.hpp>
 #include <functional>
 
 #include <mutex>
@@ -90,29 +91,92 @@ public:
 	FT_Face get_face() const { return face; }
 };
 
+/**
+ *	@brief	Faces of a font. A FT_Face must not be used concurrently, so each thread rendering a font claims its own face.
+ *			Faces are returned to the pool after use and reused.
+ */
+class glyph_factory_font_faces {
+private:
+	lib::vector<glyph_factory_font> faces;
+	lib::vector<FT_Face> available;
+
+public:
+	glyph_factory_font_faces() = default;
+	glyph_factory_font_faces(glyph_factory_font_faces &&) = default;
+	glyph_factory_font_faces &operator=(glyph_factory_font_faces &&) = default;
+
+	FT_Face claim(const font &font, FT_Library ft_lib) {
+		if (available.empty()) {
+			faces.emplace_back(font, ft_lib);
+			return faces.back().get_face();
+		}
+
+		auto face = available.back();
+		available.pop_back();
+		return face;
+	}
+	void release(FT_Face face) {
+		available.push_back(face);
+	}
+};
+
 struct glyph_factory_impl {
+	/**
+	 *	@brief	A face claimed with claim_face(), returned to the font's pool on destruction.
+	 */
+	class claimed_face {
+	private:
+		glyph_factory_impl *impl;
+		const font &f;
+		FT_Face face;
+
+	public:
+		claimed_face(glyph_factory_impl *impl, const font &f)
+			: impl(impl), f(f), face(impl->claim_face(f))
+		{}
+		~claimed_face() noexcept {
+			impl->release_face(f, face);
+		}
+
+		claimed_face(const claimed_face &) = delete;
+		claimed_face &operator=(const claimed_face &) = delete;
+
+		FT_Face operator->() const { return face; }
+		operator FT_Face() const { return face; }
+	};
+
 	std::mutex m;
 	glyph_factory_ft_lib lib;
-	lib::flat_map<_internal::font_key, glyph_factory_font> fonts;
+	lib::flat_map<_internal::font_key, glyph_factory_font_faces> fonts;
+
+	/**
+	 *	@brief	Claims a face of the font for exclusive use by the caller. Creating faces requires synchronizing the library,
+	 *			so it is done under the lock, the face can then be used without locking.
+	 *			Must be returned with release_face(), prefer claimed_face.
+	 */
+	FT_Face claim_face(const font &font) {
+		std::unique_lock<std::mutex> l(m);
 
-	auto& get_factory_font(const font &font) {
 		auto it = fonts.lower_bound(font);
 		if (it == fonts.end() || it->first != font)
 			it = fonts.emplace_hint(it, 
-									std::make_pair(font, glyph_factory_font(font, lib.get_lib())));
-		return it->second;
+									std::make_pair(font, glyph_factory_font_faces()));
+		return it->second.claim(font, lib.get_lib());
+	}
+	void release_face(const font &font, FT_Face face) {
+		std::unique_lock<std::mutex> l(m);
+		fonts.find(font)->second.release(face);
 	}
 
-	lib::unique_ptr<std::uint8_t[]> render_glyph_with(const font&, wchar_t, int, int&, int&, int&, int&);
+	void render_glyph_with(const font&, wchar_t, int, int&, int&, int&, int&, lib::vector<std::uint8_t> &);
 };
 
 }
 }
 
-lib::unique_ptr<std::uint8_t[]> glyph_factory_impl::render_glyph_with(const font &font, wchar_t codepoint, int px_size, int &w, int &h, int &start_y, int &start_x) {
-	std::unique_lock<std::mutex> l(m);
-
-	auto face = get_factory_font(font).get_face();
+void glyph_factory_impl::render_glyph_with(const font &font, wchar_t codepoint, int px_size, int &w, int &h, int &start_y, int &start_x, 
+										   lib::vector<std::uint8_t> &glyph_buf) {
+	const claimed_face face(this, font);
 
 	const FT_UInt glyph_index = FT_Get_Char_Index(face, codepoint);
 	FT_Set_Pixel_Sizes(face, 0, px_size);
@@ -130,12 +194,9 @@ lib::unique_ptr<std::uint8_t[]> glyph_factory_impl::render_glyph_with(const font
 	const int padding_w = std::max<int>(0, (w - bm.width) >> 1);
 	const int padding_h = std::max<int>(0, (h - bm.rows) >> 1);
 
-	auto glyph_buf = lib::allocate_unique<std::uint8_t[]>(w*h);
-	memset(glyph_buf.get(), 0, w * h);
+	glyph_buf.assign(w * h, 0);
 	for (unsigned y = 0; y < bm.rows; ++y)
 		memcpy(&glyph_buf[padding_w + (y + padding_h) * w], &reinterpret_cast<char*>(bm.buffer)[(bm.rows - y - 1) * bm.pitch], std::min<int>(w, bm.pitch));
-
-	return glyph_buf;
 }
 
 
@@ -148,45 +209,56 @@ glyph glyph_factory::create_glyph(const font &font, wchar_t codepoint) const {
 	int start_x = 0, start_y = 0, w = 0, h = 0;
 	const int px_size = glyph::ttf_pixel_size;
 
-	auto glyph_buf = pimpl->render_glyph_with(font, codepoint, px_size, w, h, start_y, start_x);
+	// Glyphs are created concurrently by the loader workers, keep the bitmap and transform scratch memory per thread
+	thread_local lib::vector<std::uint8_t> glyph_buf;
+	thread_local glyph_distance_transform_scratch scratch;
+
+	pimpl->render_glyph_with(font, codepoint, px_size, w, h, start_y, start_x, glyph_buf);
 	g.metrics.start_x = start_x;
 	g.metrics.start_y = start_y;
 	g.metrics.width = w;
 	g.metrics.height = h;
 
 	g.glyph_distance_field = lib::allocate_unique<glyph::glyph_distance_field_surface_t>(glm::u32vec2{ static_cast<std::uint32_t>(w), static_cast<std::uint32_t>(h) });
-	make_distance_map(glyph_buf.get(), w, h, reinterpret_cast<float*>(g.glyph_distance_field->data()));
+	glyph_distance_transform::transform(glyph_buf.data(),
+										static_cast<std::uint32_t>(w),
+										static_cast<std::uint32_t>(h),
+										reinterpret_cast<float*>(g.glyph_distance_field->data()),
+										scratch);
 
 	return std::move(g);
 }
 
 std::uint32_t glyph_factory::read_kerning(const font &font, const std::pair<wchar_t, wchar_t> &p, std::uint32_t pixel_size) {
-	std::unique_lock<std::mutex> l(pimpl->m);
-
 	std::uint32_t spacing;
-	if (pimpl->lib.get_spacing(font, p.first, p.second, pixel_size, &spacing))
-		return spacing;
+	{
+		std::unique_lock<std::mutex> l(pimpl->m);
+		if (pimpl->lib.get_spacing(font, p.first, p.second, pixel_size, &spacing))
+			return spacing;
+	}
 
-	glyph_factory_font &fac_font = pimpl->get_factory_font(font);
-	auto face = fac_font.get_face();
+	{
+		const glyph_factory_impl::claimed_face face(pimpl.get(), font);
 
-	const FT_UInt left_index = FT_Get_Char_Index(face, p.first);
-	const FT_UInt right_index = FT_Get_Char_Index(face, p.second);
-	FT_Set_Pixel_Sizes(face, 0, pixel_size);
-	FT_Load_Glyph(face, left_index, FT_LOAD_DEFAULT);
+		const FT_UInt left_index = FT_Get_Char_Index(face, p.first);
+		const FT_UInt right_index = FT_Get_Char_Index(face, p.second);
+		FT_Set_Pixel_Sizes(face, 0, pixel_size);
+		FT_Load_Glyph(face, left_index, FT_LOAD_DEFAULT);
 
-	const bool has_kern = FT_HAS_KERNING(face);
+		const bool has_kern = FT_HAS_KERNING(face);
 
-	if (has_kern) {
-		FT_Vector delta;
-		FT_Get_Kerning(face, left_index, right_index, FT_KERNING_DEFAULT, &delta);
+		if (has_kern) {
+			FT_Vector delta;
+			FT_Get_Kerning(face, left_index, right_index, FT_KERNING_DEFAULT, &delta);
 
-		spacing = (face->glyph->advance.x + delta.x) >> 6;
-	}
-	else {
-		spacing = face->glyph->advance.x >> 6;
+			spacing = (face->glyph->advance.x + delta.x) >> 6;
+		}
+		else {
+			spacing = face->glyph->advance.x >> 6;
+		}
 	}
 
+	std::unique_lock<std::mutex> l(pimpl->m);
 	pimpl->lib.insert_into_spacing_cache(font, p.first, p.second, pixel_size, spacing);
 
 	return spacing;
@@ -6,14 +6,14 @@
 #include <glyph.hpp>
 #include <ste_context.hpp>
 #include <glyph_factory.hpp>
+#include <glyph_atlas.hpp>
 #include <font.hpp>
 #include <text_glyph_key.hpp>
 
 #include <command_recorder.hpp>
 
-#include <surface_factory.hpp>
+#include <surface_convert.hpp>
 #include <device_buffer.hpp>
-#include <device_image.hpp>
 #include <stable_vector.hpp>
 #include <sampler.hpp>
 #include <std430.hpp>
@@ -33,41 +33,43 @@ namespace ste {
 namespace text {
 
 /**
- *	@brief	Handles glyph storage, loading and generating the glyph buffer and glyph textures.
+ *	@brief	Handles glyph storage, loading and generating the glyph buffer and the glyph atlas.
  */
 class glyph_manager {
 	friend class text_manager;
 
 private:
-	struct buffer_glyph_descriptor : gl::std430<std::uint32_t, std::uint32_t, std::int32_t, std::int32_t, std::uint32_t> {
-		const glyph::glyph_metrics &metrics() const {
+	struct buffer_glyph_descriptor : gl::std430<glm::vec4, std::uint32_t, std::uint32_t, std::int32_t, std::int32_t, std::uint32_t> {
+		glyph::glyph_metrics metrics() const {
 			glyph::glyph_metrics m;
-			m.width = get<0>();
-			m.height = get<1>();
-			m.start_y = get<2>();
-			m.start_x = get<3>();
+			m.width = get<1>();
+			m.height = get<2>();
+			m.start_y = get<3>();
+			m.start_x = get<4>();
 
 			return m;
 		}
 
-		const auto &glyph_index() const { return get<4>(); }
+		// Atlas texture coordinates of the glyph's top-left and bottom-right texel centers
+		const auto &uv_rect() const { return get<0>(); }
+		const auto &atlas_page() const { return get<5>(); }
 
 		buffer_glyph_descriptor() = default;
 
 		buffer_glyph_descriptor(const glyph::glyph_metrics &metrics,
-								std::uint32_t glyph_index) {
-			get<0>() = metrics.width;
-			get<1>() = metrics.height;
-			get<2>() = metrics.start_y;
-			get<3>() = metrics.start_x;
+								const glyph_atlas::allocation &location) {
+			get<0>() = location.uv_rect();
 
-			get<4>() = glyph_index;
+			get<1>() = metrics.width;
+			get<2>() = metrics.height;
+			get<3>() = metrics.start_y;
+			get<4>() = metrics.start_x;
+
+			get<5>() = location.page;
 		}
 	};
 
 public:
-	using glyph_texture = gl::texture<gl::image_type::image_2d>;
-
 	struct glyph_properties {
 		glyph::glyph_metrics metrics{};
 		int buffer_index;
@@ -75,7 +77,7 @@ public:
 
 	struct glyph_loader_data {
 		glyph_properties properties{};
-		optional<glyph_texture> texture;
+		optional<glyph_atlas::distance_field_surface_t> distance_field;
 		_internal::glyph_key key;
 	};
 
@@ -93,7 +95,8 @@ private:
 	glyphs_t glyphs;
 	glyph_futures_t glyph_futures;
 	lib::vector<buffer_glyph_descriptor> pending_glyphs;
-	lib::vector<glyph_texture> glyph_textures;
+	std::uint32_t glyphs_count{ 0 };
+	glyph_atlas atlas;
 
 private:
 	/**
@@ -131,19 +134,10 @@ private:
 			return glyph_loader_data{};
 		}
 
-		// Create image
-		const lib::string name = lib::string("glyph '") + lib::to_string(codepoint) + "' image";
-		auto image = resource::surface_factory::image_from_surface_2d<gl::format::r32_sfloat>(context.get(),
-																							  std::move(*og.get().glyph_distance_field),
-																							  gl::image_usage::sampled,
-																							  gl::image_layout::shader_read_only_optimal,
-																							  name,
-																							  false);
-
-		// Create texture and descriptor
+		// Convert to the atlas' compact format
 		glyph_loader_data result;
 		result.key = _internal::glyph_key(font, codepoint);
-		result.texture.emplace(std::move(image));
+		result.distance_field.emplace(resource::surface_convert::convert_2d<glyph_atlas::page_format>(std::move(*og.get().glyph_distance_field)));
 		result.properties.metrics = og.get().metrics;
 
 		return result;
@@ -154,11 +148,12 @@ private:
 	 */
 	auto finalize_glyph_load(glyph_loader_data &&data) {
 		// Insert into pending glyph buffer
-		const auto index = static_cast<std::uint32_t>(glyph_textures.size());
+		const auto index = glyphs_count++;
 
-		// Add to glyph textures
-		if (data.texture)
-			glyph_textures.push_back(std::move(data.texture.get()));
+		// Pack into atlas
+		glyph_atlas::allocation location{};
+		if (data.distance_field)
+			location = atlas.insert(std::move(data.distance_field.get()));
 
 		// Add to glyphs map
 		data.properties.buffer_index = index;
@@ -166,7 +161,7 @@ private:
 		assert(ret.second && "Glyph already loaded?!");
 
 		// Add to pending glyphs
-		const buffer_glyph_descriptor bgd(data.properties.metrics, index);
+		const buffer_glyph_descriptor bgd(data.properties.metrics, location);
 		pending_glyphs.push_back(bgd);
 
 		// Returns pointer to the newly inserted glyph
@@ -185,7 +180,8 @@ public:
 															  gl::sampler_filter::linear),
 							 gl::sampler_parameter::address_mode(gl::sampler_address_mode::clamp_to_border,
 																 gl::sampler_address_mode::clamp_to_border),
-							 gl::sampler_parameter::anisotropy(16.f)) {}
+							 gl::sampler_parameter::anisotropy(16.f)),
+		  atlas(context) {}
 
 	/**
 	*	@brief	Returns the glyph descriptor for a specific font and codepoint. If not available, will load asynchronously and return none.
@@ -241,7 +237,8 @@ public:
 	}
 
 	/**
-	*	@brief	Should be called from a glyph renderer. Records update commands to upload newly loaded glyphs into device glyph buffer.
+	*	@brief	Should be called from a glyph renderer. Records update commands to upload newly loaded glyphs into the atlas and
+	*			the device glyph buffer.
 	*/
 	range<std::uint64_t> update_pending_glyphs(gl::command_recorder &recorder) {
 		std::unique_lock<std::mutex> l(mutex);
@@ -251,6 +248,9 @@ public:
 			return { 0,0 };
 		}
 
+		// Upload distance fields
+		atlas.record_uploads(recorder);
+
 		range<std::uint64_t> ret;
 		ret.start = buffer.size();
 		ret.length = pending_glyphs.size();
@@ -307,6 +307,14 @@ public:
 		});
 	}
 
+	/**
+	*	@brief	Returns glyph atlas usage statistics: Pages count, glyphs count and the pages' memory footprint.
+	*/
+	auto atlas_statistics() const {
+		std::unique_lock<std::mutex> l(mutex);
+		return atlas.get_statistics();
+	}
+
 	auto &sampler() const { return text_glyph_sampler; }
 	auto &ssbo() const { return buffer; }
 };
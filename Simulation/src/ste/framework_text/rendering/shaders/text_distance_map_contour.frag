@@ -3,12 +3,15 @@
 #version 450
 
 struct buffer_glyph_descriptor {
+	// Atlas texture coordinates of the glyph's top-left and bottom-right texel centers
+	vec4 uv_rect;
+
 	uint width;
 	uint height;
 	int start_y;
 	int start_x;
 
-	uint sampler_idx;
+	uint page;
 };
 
 layout(location = 0) in geo_out {
@@ -40,7 +43,7 @@ void main() {
 
 	vec2 uv = vin.tex_coords;
 
-	float D = textureLod(sampler2D(glyph_textures[glyph.sampler_idx], glyph_sampler), uv, 0).x;
+	float D = textureLod(sampler2D(glyph_textures[glyph.page], glyph_sampler), uv, 0).x;
 
 	D -= vin.weight;
 
@@ -0,0 +1,293 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+
+#include <font.hpp>
+#include <glyph_point.hpp>
+#include <attributed_string.hpp>
+
+#include <hash_combine.hpp>
+
+#include <lib/list.hpp>
+#include <lib/unordered_map.hpp>
+#include <lib/string.hpp>
+#include <lib/vector.hpp>
+#include <array>
+
+namespace ste {
+namespace text {
+
+/**
+ *	@brief	Text style of a run of characters, resolved from the string's attributes and the text manager's defaults
+ */
+struct text_layout_style {
+	// Interned by text_layout_cache
+	const font *f{ nullptr };
+	int size{ 0 };
+	int weight{ 400 };
+	glm::u8vec4 color{ 255, 255, 255, 255 };
+	glm::u8vec4 stroke_color{ 0, 0, 0, 0 };
+	float stroke_width{ .0f };
+	bool stroke{ false };
+
+	// Per line attributes, the first character in a line that has them decides the line's alignment and height
+	bool has_alignment{ false };
+	attributes::align::alignment alignment{ attributes::align::alignment::Left };
+	bool has_line_height{ false };
+	float line_height{ .0f };
+
+	bool operator==(const text_layout_style &rhs) const {
+		return f == rhs.f &&
+			size == rhs.size &&
+			weight == rhs.weight &&
+			color == rhs.color &&
+			stroke == rhs.stroke &&
+			stroke_color == rhs.stroke_color &&
+			stroke_width == rhs.stroke_width &&
+			has_alignment == rhs.has_alignment &&
+			alignment == rhs.alignment &&
+			has_line_height == rhs.has_line_height &&
+			line_height == rhs.line_height;
+	}
+	bool operator!=(const text_layout_style &rhs) const { return !(*this == rhs); }
+};
+
+/**
+ *	@brief	A maximal run of characters sharing a style
+ */
+struct text_layout_run {
+	range<std::uint32_t> chars;
+	text_layout_style style;
+
+	bool operator==(const text_layout_run &rhs) const { return chars == rhs.chars && style == rhs.style; }
+	bool operator!=(const text_layout_run &rhs) const { return !(*this == rhs); }
+};
+
+/**
+ *	@brief	Identifies a text layout: The string and its style runs.
+ *			Layouts are relative to the text origin, so the origin is not part of the key.
+ */
+struct text_layout_key {
+	lib::wstring string;
+	lib::vector<text_layout_run> runs;
+
+	bool operator==(const text_layout_key &rhs) const {
+		return string == rhs.string && runs == rhs.runs;
+	}
+};
+
+}
+}
+
+namespace std {
+
+template <>
+struct hash<ste::text::text_layout_key> {
+	std::size_t operator()(const ste::text::text_layout_key &k) const {
+		auto h = ste::hash_combine()(k.string);
+		for (auto &r : k.runs) {
+			h = ste::hash_combiner(h, ste::hash_combine()(r.chars.start,
+														  reinterpret_cast<std::uintptr_t>(r.style.f),
+														  r.style.size,
+														  r.style.weight,
+														  r.style.stroke_width));
+		}
+		return h;
+	}
+};
+
+}
+
+namespace ste {
+namespace text {
+
+/**
+ *	@brief	LRU cache of text layouts.
+ *
+ *	Resolves an attributed string into style runs with a single sweep over its sorted attributes, O(characters + attributes),
+ *	and maps the string and its runs to the glyph points laid out relative to the text origin. Unchanged text need not be
+ *	laid out again, even if moved. Fonts are interned, so runs can compare fonts by address.
+ *	Layouts depend only on the glyph metrics and kerning, which never change once a glyph is loaded.
+ *	Not thread-safe.
+ */
+class text_layout_cache {
+public:
+	static constexpr std::size_t default_max_entries = 256;
+
+private:
+	static constexpr auto attrib_types_count = static_cast<std::size_t>(attributes::attrib_type::link) + 1;
+
+	struct entry {
+		text_layout_key key;
+		lib::vector<glyph_point> points;
+	};
+	using lru_list_type = lib::list<entry>;
+
+private:
+	lib::list<font> fonts;
+
+	lru_list_type lru_list;
+	lib::unordered_map<text_layout_key, lru_list_type::iterator> map;
+	std::size_t max_entries;
+
+	std::uint64_t hits{ 0 };
+	std::uint64_t misses{ 0 };
+
+private:
+	const font *intern(const font &f) {
+		for (auto &i : fonts) {
+			if (i == f)
+				return &i;
+		}
+
+		fonts.push_back(f);
+		return &fonts.back();
+	}
+
+	using active_attribs_t = std::array<const attributed_wstring::attrib_storage::value_type*, attrib_types_count>;
+
+	text_layout_style resolve(const active_attribs_t &active,
+							  const font *default_font,
+							  int default_size) {
+		const auto get = [&](attributes::attrib_type t) {
+			const auto *a = active[static_cast<std::size_t>(t)];
+			return a ? &a->second : nullptr;
+		};
+
+		const auto font_attrib = attributes::font::bind(get(attributes::attrib_type::font));
+		const auto color_attrib = attributes::rgb::bind(get(attributes::attrib_type::color));
+		const auto size_attrib = attributes::size::bind(get(attributes::attrib_type::size));
+		const auto stroke_attrib = attributes::stroke::bind(get(attributes::attrib_type::stroke));
+		const auto weight_attrib = attributes::weight::bind(get(attributes::attrib_type::weight));
+		const auto alignment_attrib = attributes::align::bind(get(attributes::attrib_type::align));
+		const auto line_height_attrib = attributes::line_height::bind(get(attributes::attrib_type::line_height));
+
+		text_layout_style style;
+		style.f = font_attrib ? intern(font_attrib->get()) : default_font;
+		style.size = size_attrib ? size_attrib->get() : default_size;
+		if (weight_attrib)
+			style.weight = weight_attrib->get();
+		if (color_attrib)
+			style.color = color_attrib->get();
+		if (stroke_attrib) {
+			style.stroke = true;
+			style.stroke_color = stroke_attrib->get_color();
+			style.stroke_width = stroke_attrib->get_width();
+		}
+		if (alignment_attrib) {
+			style.has_alignment = true;
+			style.alignment = alignment_attrib->get();
+		}
+		if (line_height_attrib) {
+			style.has_line_height = true;
+			style.line_height = line_height_attrib->get();
+		}
+
+		return style;
+	}
+
+public:
+	text_layout_cache(std::size_t max_entries = default_max_entries) : max_entries(max_entries) {}
+
+	text_layout_cache(text_layout_cache&&) = default;
+	text_layout_cache &operator=(text_layout_cache&&) = default;
+
+	/**
+	 *	@brief	Creates the layout key of an attributed string, resolving its style runs.
+	 */
+	text_layout_key key(const attributed_wstring &wstr,
+						const font &default_font,
+						int default_size) {
+		text_layout_key k;
+		k.string = wstr.plain_string();
+
+		const auto *default_font_ptr = intern(default_font);
+		const auto &attribs = wstr.attribs();
+		const auto length = static_cast<std::uint32_t>(wstr.length());
+
+		// Sweep the attributes, sorted by range start. Attributes of a type do not overlap, so at most a single attribute
+		// of each type is active at a time.
+		active_attribs_t active{};
+		std::size_t next = 0;
+		std::uint32_t i = 0;
+		while (i < length) {
+			for (; next < attribs.size() && attribs[next].first.start <= i; ++next) {
+				const auto &a = attribs[next];
+				if (a.first.start + a.first.length > i)
+					active[static_cast<std::size_t>(a.second.type())] = &a;
+			}
+
+			// Next style change
+			std::uint32_t end = length;
+			if (next < attribs.size())
+				end = std::min(end, attribs[next].first.start);
+			for (auto &a : active) {
+				if (!a)
+					continue;
+				const auto a_end = a->first.start + a->first.length;
+				if (a_end <= i)
+					a = nullptr;
+				else
+					end = std::min(end, a_end);
+			}
+
+			auto style = resolve(active, default_font_ptr, default_size);
+			if (!k.runs.empty() && k.runs.back().style == style)
+				k.runs.back().chars.length += end - i;
+			else
+				k.runs.push_back({ { i, end - i }, style });
+
+			i = end;
+		}
+
+		return k;
+	}
+
+	/**
+	 *	@brief	Looks up a layout, and on hit marks it most recently used.
+	 *
+	 *	@return	The laid out glyph points, relative to the text origin, or nullptr on miss.
+	 */
+	const lib::vector<glyph_point> *get(const text_layout_key &k) {
+		auto it = map.find(k);
+		if (it == map.end()) {
+			++misses;
+			return nullptr;
+		}
+
+		++hits;
+		lru_list.splice(lru_list.begin(), lru_list, it->second);
+		return &it->second->points;
+	}
+
+	/**
+	 *	@brief	Inserts a layout, evicting the least recently used layout if the cache is full.
+	 */
+	void insert(text_layout_key &&k, const lib::vector<glyph_point> &points) {
+		if (!max_entries || map.find(k) != map.end())
+			return;
+
+		while (map.size() >= max_entries) {
+			map.erase(lru_list.back().key);
+			lru_list.pop_back();
+		}
+
+		lru_list.push_front({ std::move(k), points });
+		map.emplace(lru_list.front().key, lru_list.begin());
+	}
+
+	void clear() {
+		map.clear();
+		lru_list.clear();
+	}
+
+	auto size() const { return map.size(); }
+	auto get_hits_count() const { return hits; }
+	auto get_misses_count() const { return misses; }
+};
+
+}
+}
@@ -35,7 +35,7 @@ text_manager::text_manager(const ste_context &context,
 							 *geom,
 							 *frag))
 {
-	bind_pipeline_resources(0);
+	bind_pipeline_resources();
 
 	// Set framebuffer extent push constant, and keep it up to date.
 	pipeline["push_constants_t.fb_size"] = glm::vec2(context.device().get_surface().extent());
@@ -75,46 +75,70 @@ gl::device_pipeline_graphics text_manager::create_pipeline(const ste_context &ct
 }
 
 /**
- *	@brief	Binds current available resources. For glyph_textures, starts binding from first_offset.
+ *	@brief	Binds current available resources.
  */
-void text_manager::bind_pipeline_resources(std::uint32_t first_offset) {
+void text_manager::bind_pipeline_resources() {
 	pipeline["glyph_sampler"] = gl::bind(gm.sampler());
 
 	{
 		std::unique_lock<std::mutex> l(gm.mutex);
 
-		std::uint32_t texture_count = static_cast<std::uint32_t>(gm.glyph_textures.size());
-		if (texture_count) {
-			pipeline["glyph_texture_count"] = texture_count;
-			pipeline["glyph_data"] = gl::bind(gm.ssbo().get(), 0, texture_count);
-
-			lib::vector<gl::pipeline::image> textures;
-			textures.reserve(texture_count);
-			for (std::uint32_t i = first_offset; i < texture_count; ++i) {
-				auto &glyph_texture = gm.glyph_textures[i];
-				textures.emplace_back(glyph_texture);
-			}
-			pipeline["glyph_textures"] = gl::bind(textures);
-		}
+		const auto glyphs_count = static_cast<std::uint32_t>(gm.ssbo().size());
+		if (glyphs_count)
+			pipeline["glyph_data"] = gl::bind(gm.ssbo().get(), 0, glyphs_count);
+		bind_atlas_pages();
 	}
 }
 
-void text_manager::adjust_line(lib::vector<glyph_point> &points, const attributed_wstring &wstr, std::uint32_t line_start_index, float line_start, float line_height, const glm::vec2 &ortho_pos) {
+/**
+ *	@brief	Binds atlas pages created since the last call. Glyph manager's mutex must be held.
+ *			Pages are created rarely, so the texture array, and the pipeline specialization, rarely change.
+ */
+void text_manager::bind_atlas_pages() {
+	const auto pages_count = gm.atlas.pages_count();
+	if (pages_count == bound_atlas_pages)
+		return;
+
+	pipeline["glyph_texture_count"] = pages_count;
+
+	lib::vector<gl::pipeline::image> textures;
+	textures.reserve(pages_count - bound_atlas_pages);
+	for (auto i = bound_atlas_pages; i < pages_count; ++i)
+		textures.emplace_back(gm.atlas.page(i));
+	pipeline["glyph_textures"] = gl::bind(bound_atlas_pages,
+										  textures);
+
+	bound_atlas_pages = pages_count;
+}
+
+/**
+ *	@brief	Aligns the line and moves it down by the line height.
+ *
+ *	@param	alignment_style		Style of the line's first character with an alignment attribute, if any
+ *	@param	line_height_style	Style of the line's first character with a line height attribute, if any
+ */
+void text_manager::adjust_line(lib::vector<glyph_point> &points, 
+							   const text_layout_style *alignment_style,
+							   const text_layout_style *line_height_style,
+							   std::uint32_t line_start_index, 
+							   float line_start, 
+							   float line_height, 
+							   const glm::vec2 &ortho_pos) {
 	// Adjusts line height
 	if (points.size() - line_start_index) {
-		const auto alignment_attrib = attributes::align::bind(wstr.attrib_of_type(attributes::attrib_type::align, { line_start_index, static_cast<std::uint32_t>(points.size()) - line_start_index }));
-		const auto line_height_attrib = attributes::line_height::bind(wstr.attrib_of_type(attributes::attrib_type::line_height, { line_start_index, static_cast<std::uint32_t>(points.size()) - line_start_index }));
-
-		if (alignment_attrib && alignment_attrib->get() != attributes::align::alignment::Left) {
+		if (alignment_style && alignment_style->alignment != attributes::align::alignment::Left) {
 			const float line_len = ortho_pos.x - line_start;
-			const float offset = alignment_attrib->get() == attributes::align::alignment::Center ? -line_len*.5f : -line_len;
+			const float offset = alignment_style->alignment == attributes::align::alignment::Center ? -line_len*.5f : -line_len;
+			// Offset within the x field, positions wrap around and must not carry into y
+			const auto x_offset = static_cast<std::uint32_t>(static_cast<std::int32_t>(offset));
 			for (unsigned i = line_start_index; i < points.size(); ++i) {
-				points[i].data().x += static_cast<std::uint16_t>(offset);
+				auto &x = points[i].data().x;
+				x = (x & 0xFFFF0000) | ((x + x_offset) & 0xFFFF);
 			}
 		}
 
-		if (line_height_attrib && line_height > 0)
-			line_height = line_height_attrib->get();
+		if (line_height_style && line_height > 0)
+			line_height = line_height_style->line_height;
 	}
 	for (unsigned i = line_start_index; i < points.size(); ++i) {
 		*(reinterpret_cast<std::uint16_t*>(&points[i].data().x) + 1) -= static_cast<std::uint16_t>(line_height);
@@ -122,84 +146,131 @@ void text_manager::adjust_line(lib::vector<glyph_point> &points, const attribute
 }
 
 /**
- *	@brief	Creates points vector from attributed string.
+ *	@brief	Lays out the glyph points of a string, run by run, relative to the text origin.
+ *			Point coordinates wrap around within their 16-bit fields, see translate().
+ *
+ *	@return	False if some glyphs are not yet loaded, in which case they are skipped and the layout should not be reused.
  */
-lib::vector<glyph_point> text_manager::create_points(glm::vec2 ortho_pos, const attributed_wstring &wstr) {
+bool text_manager::layout(const text_layout_key &key, lib::vector<glyph_point> &points) {
+	const auto &str = key.string;
+	const auto length = static_cast<std::uint32_t>(str.length());
+
+	glm::vec2 ortho_pos = { .0f, .0f };
 	const float line_start = ortho_pos.x;
 	std::uint32_t line_start_index = 0;
 	float prev_line_height = 0;
 	float line_height = 0;
 	int num_lines = 1;
+	bool complete = true;
 
-	lib::vector<glyph_point> points;
-	for (unsigned i = 0; i < wstr.length(); ++i) {
-		if (wstr[i] == '\n') {
-			adjust_line(points, wstr, line_start_index, line_start, prev_line_height, ortho_pos);
+	const text_layout_style *line_alignment_style = nullptr;
+	const text_layout_style *line_height_style = nullptr;
 
-			ortho_pos.x = line_start;
-			ortho_pos.y -= prev_line_height;
-			prev_line_height = line_height;
-			line_height = 0;
-			line_start_index = static_cast<std::uint32_t>(points.size());
+	points.reserve(length);
+	for (auto &run : key.runs) {
+		const auto &style = run.style;
+		const font &font = *style.f;
+		const int size = style.size;
+		const glm::u8vec4 &color = style.color;
 
-			++num_lines;
+		const float f = static_cast<float>(size) / static_cast<float>(glyph::ttf_pixel_size);
+		const float weight = glm::clamp<float>(static_cast<float>(style.weight) - 400, -300, 500) * f * .003f;
+		const std::uint32_t osize = static_cast<std::uint32_t>(f * 2.f * glyph_point::size_scale + .5f);
 
-			continue;
-		}
+		for (auto i = run.chars.start; i < run.chars.start + run.chars.length; ++i) {
+			if (str[i] == '\n') {
+				adjust_line(points, line_alignment_style, line_height_style, line_start_index, line_start, prev_line_height, ortho_pos);
 
-		const auto font_attrib = attributes::font::bind(wstr.attrib_of_type(attributes::attrib_type::font, { i,1 }));
-		const auto color_attrib = attributes::rgb::bind(wstr.attrib_of_type(attributes::attrib_type::color, { i,1 }));
-		const auto size_attrib = attributes::size::bind(wstr.attrib_of_type(attributes::attrib_type::size, { i,1 }));
-		const auto stroke_attrib = attributes::stroke::bind(wstr.attrib_of_type(attributes::attrib_type::stroke, { i,1 }));
-		const auto weight_attrib = attributes::weight::bind(wstr.attrib_of_type(attributes::attrib_type::weight, { i,1 }));
+				ortho_pos.x = line_start;
+				ortho_pos.y -= prev_line_height;
+				prev_line_height = line_height;
+				line_height = 0;
+				line_start_index = static_cast<std::uint32_t>(points.size());
+				line_alignment_style = line_height_style = nullptr;
 
-		const font &font = font_attrib ? font_attrib->get() : default_font;
-		const int size = size_attrib ? size_attrib->get() : default_size;
-		const glm::u8vec4 color = color_attrib ? color_attrib->get() : glm::u8vec4{ 255, 255, 255, 255 };
+				++num_lines;
 
-		auto optional_g = gm.glyph_for_font(font, wstr[i]);
-		if (!optional_g) {
-			// No glyph found or loading
-			continue;
-		}
+				continue;
+			}
 
-		const auto& g = optional_g.get();
+			if (!line_alignment_style && style.has_alignment)
+				line_alignment_style = &style;
+			if (!line_height_style && style.has_line_height)
+				line_height_style = &style;
 
-		const float f = static_cast<float>(size) / static_cast<float>(glyph::ttf_pixel_size);
-		const float w = weight_attrib ? weight_attrib->get() : 400.f;
-		const float lh = (g->metrics.height + g->metrics.start_y) * f * 2 + 1;
+			auto optional_g = gm.glyph_for_font(font, str[i]);
+			if (!optional_g) {
+				// No glyph found or loading
+				complete = false;
+				continue;
+			}
 
-		float advance = static_cast<float>(i + 1 < wstr.length() ? gm.spacing(font, { wstr[i], wstr[i + 1] }, size) : 0);
+			const auto& g = optional_g.get();
 
-		const glm::u32vec2 pos = { static_cast<std::uint32_t>(ortho_pos.x + .5f), static_cast<std::uint32_t>(ortho_pos.y + .5f) };
-		const std::uint32_t osize = static_cast<std::uint32_t>(f * 2.f * glyph_point::size_scale + .5f);
-		const std::uint32_t glyph_index = static_cast<std::uint32_t>(g->buffer_index);
-		const float weight = glm::clamp<float>(w - 400, -300, 500) * f * .003f;
-
-		glyph_point p;
-		p.data().x = (pos.x & 0xFFFF) | (pos.y << 16);
-		p.data().y = (osize & 0xFFFF) | (glyph_index << 16);
-		p.data().z = glm::packUnorm4x8(glm::vec4(color.x / 255.0f, color.y / 255.0f, color.z / 255.0f,
-											   .5f + weight * glyph_point::weight_scale));
-		p.data().w = 0;
-
-		if (stroke_attrib) {
-			const float stroke_width = stroke_attrib->get_width();
-			advance += glm::floor(stroke_width * .5f);
-
-			const auto c = stroke_attrib->get_color();
-			p.data().w = glm::packUnorm4x8(glm::vec4(c.x / 255.0f, c.y / 255.0f, c.z / 255.0f,
-												   stroke_width * glyph_point::stroke_width_scale));
+			const float lh = (g->metrics.height + g->metrics.start_y) * f * 2 + 1;
+
+			float advance = static_cast<float>(i + 1 < length ? gm.spacing(font, { str[i], str[i + 1] }, size) : 0);
+
+			// Relative positions are negative left of and below the origin
+			const glm::u32vec2 pos = glm::u32vec2(glm::i32vec2(glm::floor(ortho_pos + .5f)));
+			const std::uint32_t glyph_index = static_cast<std::uint32_t>(g->buffer_index);
+
+			glyph_point p;
+			p.data().x = (pos.x & 0xFFFF) | (pos.y << 16);
+			p.data().y = (osize & 0xFFFF) | (glyph_index << 16);
+			p.data().z = glm::packUnorm4x8(glm::vec4(color.x / 255.0f, color.y / 255.0f, color.z / 255.0f,
+												   .5f + weight * glyph_point::weight_scale));
+			p.data().w = 0;
+
+			if (style.stroke) {
+				const float stroke_width = style.stroke_width;
+				advance += glm::floor(stroke_width * .5f);
+
+				const auto &c = style.stroke_color;
+				p.data().w = glm::packUnorm4x8(glm::vec4(c.x / 255.0f, c.y / 255.0f, c.z / 255.0f,
+													   stroke_width * glyph_point::stroke_width_scale));
+			}
+
+			points.push_back(p);
+
+			line_height = std::max(lh, line_height);
+			ortho_pos.x += advance;
 		}
+	}
+
+	adjust_line(points, line_alignment_style, line_height_style, line_start_index, line_start, num_lines > 1 ? line_height : 0, ortho_pos);
 
-		points.push_back(p);
+	return complete;
+}
 
-		line_height = std::max(lh, line_height);
-		ortho_pos.x += advance;
+/**
+ *	@brief	Moves laid out points from the text origin to ortho_pos, rounded to whole pixels.
+ */
+void text_manager::translate(lib::vector<glyph_point> &points, const glm::vec2 &ortho_pos) {
+	const glm::u32vec2 offset = glm::u32vec2(glm::i32vec2(glm::floor(ortho_pos + .5f)));
+	for (auto &p : points) {
+		const std::uint32_t x = (p.data().x + offset.x) & 0xFFFF;
+		const std::uint32_t y = ((p.data().x >> 16) + offset.y) & 0xFFFF;
+		p.data().x = x | (y << 16);
 	}
+}
 
-	adjust_line(points, wstr, line_start_index, line_start, num_lines > 1 ? line_height : 0, ortho_pos);
+/**
+ *	@brief	Creates points vector from attributed string. Reuses the cached layout if the string and its attributes are
+ *			unchanged, wherever the text is placed.
+ */
+lib::vector<glyph_point> text_manager::create_points(const glm::vec2 &ortho_pos, const attributed_wstring &wstr) {
+	auto key = layout_cache.key(wstr, default_font, default_size);
 
+	lib::vector<glyph_point> points;
+	if (auto *cached = layout_cache.get(key))
+		points = *cached;
+	else if (layout(key, points)) {
+		// Only layouts with all glyphs loaded are final
+		layout_cache.insert(std::move(key), points);
+	}
+
+	translate(points, ortho_pos);
 	return points;
 }
 
@@ -214,20 +285,10 @@ bool text_manager::update_glyphs(gl::command_recorder &recorder) {
 	{
 		std::unique_lock<std::mutex> l(gm.mutex);
 
-		std::uint32_t texture_count = static_cast<std::uint32_t>(gm.glyph_textures.size());
+		const auto glyphs_count = static_cast<std::uint32_t>(updated_range.start + updated_range.length);
+		pipeline["glyph_data"] = gl::bind(gm.ssbo().get(), 0, glyphs_count);
 
-		pipeline["glyph_texture_count"] = texture_count;
-		pipeline["glyph_data"] = gl::bind(gm.ssbo().get(), 0, texture_count);
-
-		lib::vector<gl::pipeline::image> textures;
-		textures.reserve(static_cast<std::size_t>(updated_range.length));
-		for (auto i = updated_range.start; i < updated_range.start + updated_range.length; ++i) {
-			const auto tex_idx = static_cast<std::size_t>(i);
-			auto &glyph_texture = gm.glyph_textures[tex_idx];
-			textures.emplace_back(glyph_texture);
-		}
-		pipeline["glyph_textures"] = gl::bind(static_cast<std::uint32_t>(updated_range.start),
-											  textures);
+		bind_atlas_pages();
 	}
 
 	return true;
@@ -14,6 +14,7 @@
 #include <font.hpp>
 #include <glyph_manager.hpp>
 #include <glyph_point.hpp>
+#include <text_layout_cache.hpp>
 
 #include <attributed_string.hpp>
 
@@ -38,9 +39,12 @@ private:
 	alias<const ste_context> context;
 
 	glyph_manager gm;
+	std::uint32_t bound_atlas_pages{ 0 };
 	font default_font;
 	int default_size;
 
+	text_layout_cache layout_cache;
+
 	ste_resource<gl::device_pipeline_shader_stage> vert;
 	ste_resource<gl::device_pipeline_shader_stage> geom;
 	ste_resource<gl::device_pipeline_shader_stage> frag;
@@ -49,15 +53,18 @@ private:
 	gl::ste_device::queues_and_surface_recreate_signal_type::connection_type surface_recreate_signal_connection;
 
 private:
-	static void adjust_line(lib::vector<glyph_point> &, const attributed_wstring &, std::uint32_t, float, float, const glm::vec2 &);
-	lib::vector<glyph_point> create_points(glm::vec2, const attributed_wstring &);
+	static void adjust_line(lib::vector<glyph_point> &, const text_layout_style *, const text_layout_style *, std::uint32_t, float, float, const glm::vec2 &);
+	static void translate(lib::vector<glyph_point> &, const glm::vec2 &);
+	bool layout(const text_layout_key &, lib::vector<glyph_point> &);
+	lib::vector<glyph_point> create_points(const glm::vec2 &, const attributed_wstring &);
 
 private:
 	static gl::device_pipeline_graphics create_pipeline(const ste_context &,
 														gl::device_pipeline_shader_stage &,
 														gl::device_pipeline_shader_stage &,
 														gl::device_pipeline_shader_stage &);
-	void bind_pipeline_resources(std::uint32_t);
+	void bind_pipeline_resources();
+	void bind_atlas_pages();
 	bool update_glyphs(gl::command_recorder &recorder);
 
 public:
@@ -223,6 +223,9 @@ void serialize(Archive &ar, ste::lib::basic_string<Elem, Traits> &str, const uns
 	std::copy(str.begin(), str.end(), stdstr.begin());
 
 	ar & stdstr;
+
+	if (Archive::is_loading::value)
+		str.assign(stdstr.begin(), stdstr.end());
 }
 
 }
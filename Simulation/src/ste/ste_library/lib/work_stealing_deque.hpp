@@ -0,0 +1,19 @@
+//	StE
+// © Shlomi Steinberg 2015-2017
+
+#pragma once
+
+#include <stdafx.hpp>
+#include <lib/allocator.hpp>
+#include <lib/unique_ptr.hpp>
+
+#include <concurrency/work_stealing_deque.hpp>
+
+namespace ste {
+namespace lib {
+
+template <typename T>
+using work_stealing_deque = ::ste::work_stealing_deque<T, allocator<T>, unique_ptr<T>>;
+
+}
+}
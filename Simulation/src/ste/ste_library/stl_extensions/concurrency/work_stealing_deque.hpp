@@ -0,0 +1,186 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdint>
+
+namespace ste {
+
+/*
+*	@brief	Concurrent lock-free single-producer/multi-consumer work-stealing deque.
+*			The owning thread pushes and pops at the bottom (LIFO), any other thread may steal from the top (FIFO).
+*
+*			Chase-Lev deque, with memory orderings as given by Lê et al., "Correct and Efficient Work-Stealing for Weak
+*			Memory Models". Retired circular buffers are kept alive until the deque is destroyed, as thieves may still
+*			be reading from them.
+*/
+template <
+	typename T,
+	typename Allocator = std::allocator<T>,
+	typename PointerType = std::unique_ptr<T>
+>
+class work_stealing_deque {
+public:
+	using allocator_type = Allocator;
+	using stored_ptr = PointerType;
+
+private:
+	using index_t = std::int64_t;
+	using slot_t = std::atomic<T*>;
+
+	struct buffer {
+		index_t capacity;
+		slot_t *data;
+		buffer *retired;
+
+		T* load(index_t i) const { return data[i & (capacity - 1)].load(std::memory_order_relaxed); }
+		void store(index_t i, T *p) { data[i & (capacity - 1)].store(p, std::memory_order_relaxed); }
+	};
+
+	using buffer_allocator_type = typename Allocator::template rebind<buffer>::other;
+	using slot_allocator_type = typename Allocator::template rebind<slot_t>::other;
+
+	static constexpr index_t initial_capacity = 64;
+
+private:
+	alignas(std::hardware_destructive_interference_size) std::atomic<index_t> top{ 0 };
+	alignas(std::hardware_destructive_interference_size) std::atomic<index_t> bottom{ 0 };
+	alignas(std::hardware_destructive_interference_size) std::atomic<buffer*> array{ nullptr };
+
+	allocator_type allocator;
+	buffer_allocator_type buffer_allocator;
+	slot_allocator_type slot_allocator;
+
+private:
+	buffer* allocate_buffer(index_t capacity, buffer *retired) {
+		auto ptr = buffer_allocator.allocate(1);
+		auto data = slot_allocator.allocate(static_cast<std::size_t>(capacity));
+		for (index_t i = 0; i < capacity; ++i)
+			::new (data + i) slot_t(nullptr);
+
+		::new (ptr) buffer{ capacity, data, retired };
+		return ptr;
+	}
+
+	void deallocate_buffer(buffer *ptr) {
+		for (index_t i = 0; i < ptr->capacity; ++i)
+			ptr->data[i].~slot_t();
+		slot_allocator.deallocate(ptr->data, static_cast<std::size_t>(ptr->capacity));
+
+		ptr->~buffer();
+		buffer_allocator.deallocate(ptr, 1);
+	}
+
+	buffer* grow(buffer *a, index_t b, index_t t) {
+		auto new_array = allocate_buffer(a->capacity * 2, a);
+		for (index_t i = t; i < b; ++i)
+			new_array->store(i, a->load(i));
+
+		array.store(new_array, std::memory_order_release);
+		return new_array;
+	}
+
+public:
+	work_stealing_deque() {
+		array.store(allocate_buffer(initial_capacity, nullptr));
+
+		assert(top.is_lock_free() && "top/bottom not lock free!");
+	}
+	~work_stealing_deque() {
+		while (pop() != nullptr) {}
+
+		for (auto ptr = array.load(); ptr != nullptr;) {
+			auto retired = ptr->retired;
+			deallocate_buffer(ptr);
+			ptr = retired;
+		}
+	}
+
+	work_stealing_deque(const work_stealing_deque &q) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque &q) = delete;
+
+	/*
+	*	@brief	Pushes a new element at the bottom. Must only be called by the owning thread.
+	*/
+	void push(T &&new_value) {
+		auto ptr = allocator.allocate(1);
+		::new (ptr) T(std::move(new_value));
+
+		stored_ptr new_data(ptr);
+
+		push(std::move(new_data));
+	}
+
+	/*
+	*	@brief	Pushes a new element at the bottom. Must only be called by the owning thread.
+	*/
+	void push(stored_ptr &&new_data) {
+		const index_t b = bottom.load(std::memory_order_relaxed);
+		const index_t t = top.load(std::memory_order_acquire);
+		buffer *a = array.load(std::memory_order_relaxed);
+		if (b - t > a->capacity - 1)
+			a = grow(a, b, t);
+
+		a->store(b, new_data.release());
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	/*
+	*	@brief	Pops an element from the bottom. Must only be called by the owning thread.
+	*/
+	stored_ptr pop() {
+		const index_t b = bottom.load(std::memory_order_relaxed) - 1;
+		buffer *a = array.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		index_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			// Empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T *res = a->load(b);
+		if (t == b) {
+			// Last element, race against thieves
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				res = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		return stored_ptr(res);
+	}
+
+	/*
+	*	@brief	Steals an element from the top. Can be called by any thread.
+	*			Returns nullptr only when the deque was observed empty, contention with other thieves is retried.
+	*/
+	stored_ptr steal() {
+		for (;;) {
+			index_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const index_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b)
+				return nullptr;
+
+			buffer *a = array.load(std::memory_order_acquire);
+			T *res = a->load(t);
+			if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return stored_ptr(res);
+		}
+	}
+
+	bool is_empty_hint(std::memory_order order = std::memory_order_acquire) const {
+		const index_t b = bottom.load(order);
+		const index_t t = top.load(order);
+		return b <= t;
+	}
+};
+
+}
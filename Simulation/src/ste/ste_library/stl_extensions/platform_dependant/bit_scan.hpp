@@ -0,0 +1,43 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined _linux
+#else
+#error Unsupported OS
+#endif
+
+#include <cstdint>
+
+namespace ste {
+
+/*
+ *	@brief	Returns the index of the most significant set bit. x must be non-zero.
+ */
+inline int bit_scan_reverse(std::uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanReverse64(&idx, x);
+	return static_cast<int>(idx);
+#elif defined _linux
+	return 63 - __builtin_clzll(x);
+#endif
+}
+
+/*
+ *	@brief	Returns the index of the least significant set bit. x must be non-zero.
+ */
+inline int bit_scan_forward(std::uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return static_cast<int>(idx);
+#elif defined _linux
+	return __builtin_ctzll(x);
+#endif
+}
+
+}
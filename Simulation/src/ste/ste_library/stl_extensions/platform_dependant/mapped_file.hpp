@@ -0,0 +1,192 @@
+// StE
+// © Shlomi Steinberg, 2015-2017
+
+#pragma once
+
+#ifdef _MSC_VER
+#include <windows.hpp>
+#elif defined _linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#error Unsupported OS
+#endif
+
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+namespace ste {
+
+/*
+ *	@brief	Memory mapping of an entire file.
+ *			Read-only mappings are private and require an existing file.
+ *			Read-write mappings are shared, the file is created if it does not exist, and extended to at least the
+ *			requested size.
+ *			Mapping failures leave the object unmapped, see is_mapped().
+ */
+class mapped_file {
+public:
+	enum class access {
+		read_only,
+		read_write,
+	};
+
+private:
+	char *ptr{ nullptr };
+	std::size_t length{ 0 };
+
+#ifdef _MSC_VER
+	HANDLE mapping{ nullptr };
+#endif
+
+private:
+	void unmap() {
+		if (ptr == nullptr)
+			return;
+
+#ifdef _MSC_VER
+		UnmapViewOfFile(ptr);
+		CloseHandle(mapping);
+		mapping = nullptr;
+#elif defined _linux
+		::munmap(ptr, length);
+#endif
+
+		ptr = nullptr;
+		length = 0;
+	}
+
+public:
+	mapped_file() = default;
+	/**
+	 *	@param path		File path
+	 *	@param mode		Mapping access. Writes to a read-only mapping are undefined.
+	 *	@param min_size	Minimal file size of a read-write mapping. The file is extended as needed.
+	 *					Ignored for read-only mappings.
+	 */
+	mapped_file(const std::experimental::filesystem::path &path, access mode, std::size_t min_size = 0) {
+		const bool writable = mode == access::read_write;
+		if (!writable)
+			min_size = 0;
+
+#ifdef _MSC_VER
+		HANDLE file = CreateFileW(path.wstring().c_str(),
+								  writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+								  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+								  nullptr,
+								  writable ? OPEN_ALWAYS : OPEN_EXISTING,
+								  FILE_ATTRIBUTE_NORMAL,
+								  nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size)) {
+			CloseHandle(file);
+			return;
+		}
+		const auto size = std::max<std::uint64_t>(static_cast<std::uint64_t>(file_size.QuadPart), min_size);
+		if (size == 0) {
+			CloseHandle(file);
+			return;
+		}
+
+		// Mapping a size larger than the file extends the file
+		mapping = CreateFileMappingW(file,
+									 nullptr,
+									 writable ? PAGE_READWRITE : PAGE_READONLY,
+									 static_cast<DWORD>(size >> 32),
+									 static_cast<DWORD>(size & 0xFFFFFFFF),
+									 nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return;
+
+		ptr = reinterpret_cast<char*>(MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0));
+		if (ptr == nullptr) {
+			CloseHandle(mapping);
+			mapping = nullptr;
+			return;
+		}
+		length = static_cast<std::size_t>(size);
+#elif defined _linux
+		const int fd = writable ?
+			::open(path.string().c_str(), O_RDWR | O_CREAT, 0644) :
+			::open(path.string().c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			::close(fd);
+			return;
+		}
+		auto size = static_cast<std::size_t>(st.st_size);
+		if (size < min_size) {
+			if (::ftruncate(fd, static_cast<off_t>(min_size)) != 0) {
+				::close(fd);
+				return;
+			}
+			size = min_size;
+		}
+		if (size == 0) {
+			::close(fd);
+			return;
+		}
+
+		void *p = writable ?
+			::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) :
+			::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED)
+			return;
+
+		ptr = reinterpret_cast<char*>(p);
+		length = size;
+#endif
+	}
+	~mapped_file() noexcept {
+		unmap();
+	}
+
+	mapped_file(mapped_file &&o) noexcept
+		: ptr(o.ptr),
+		length(o.length)
+#ifdef _MSC_VER
+		, mapping(o.mapping)
+#endif
+	{
+		o.ptr = nullptr;
+		o.length = 0;
+#ifdef _MSC_VER
+		o.mapping = nullptr;
+#endif
+	}
+	mapped_file &operator=(mapped_file &&o) noexcept {
+		unmap();
+
+		ptr = o.ptr;
+		length = o.length;
+		o.ptr = nullptr;
+		o.length = 0;
+#ifdef _MSC_VER
+		mapping = o.mapping;
+		o.mapping = nullptr;
+#endif
+
+		return *this;
+	}
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	bool is_mapped() const { return ptr != nullptr; }
+	char *data() { return ptr; }
+	const char *data() const { return ptr; }
+	std::size_t size() const { return length; }
+};
+
+}